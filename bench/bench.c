@@ -0,0 +1,678 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   bench/bench.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "postgres.h"
+#include "access/xact.h"
+
+#include "sequence/sequence.h"
+#include "sequence/stats.h"
+#include "sequence/code_set_creation.h"
+#include "sequence/compression.h"
+
+/*
+ * Micro-benchmark of the compression engine outside of a backend.
+ *
+ *	postbis_bench [length ...]
+ *
+ * For every input and length the sequence statistics and the optimal code
+ * are timed once. Then every kind of code that can express the input is
+ * built explicitly: a fixed code, a code of equal length codewords and
+ * Huffman codes without and with swapping and RLE. For each of them the
+ * code creation, the encoding, the decoding of the whole sequence and the
+ * decoding of short slices at random positions are timed, fixed codes are
+ * also encoded with encode_with_stats(). Each result is
+ * a line of tab separated values, the first line names the columns:
+ *
+ *	input	length	code	operation	variant	compressed_bytes	iterations	seconds	mb_per_s	ns_per_symbol
+ *
+ * variant is the function the operation ends up in, followed by the
+ * packing kernel for equal length codes, so changes of a single code path
+ * can be followed. Huffman codes get an index from PB_INDEX_PART_SIZE
+ * symbols on, so short lengths measure the variants without index and
+ * long lengths those with index. mb_per_s and ns_per_symbol refer to plain
+ * symbols of one byte. Inputs are pseudo-random with a fixed seed, every
+ * run measures the same sequences.
+ */
+
+/**
+ * Number of symbols processed by each timed operation, spread over as
+ * many iterations as needed.
+ */
+#define BENCH_SYMBOLS_PER_OPERATION	(32 * 1024 * 1024)
+
+/**
+ * Number and length of the slices decoded at random positions.
+ */
+#define BENCH_N_SLICES		1024
+#define BENCH_SLICE_LENGTH	100
+
+/**
+ * Generates a synthetic input of a given length into output.
+ */
+typedef void (*BenchGenerator) (uint8* output, uint32 length);
+
+typedef struct {
+	const char* name;
+	BenchGenerator generate;
+	int mode;
+} BenchInput;
+
+/**
+ * Builds a code of one kind for an input, or returns NULL if the kind
+ * cannot express it or brings no benefit, e.g. no symbol to swap.
+ */
+typedef PB_CodeSet* (*BenchCodeBuilder) (const PB_SequenceInfo* info);
+
+typedef struct {
+	const char* name;
+	const char* builder;
+	BenchCodeBuilder build;
+} BenchCode;
+
+static uint64 random_state = UINT64CONST(0x9E3779B97F4A7C15);
+
+/*
+ * local function declarations
+ */
+
+static uint32 next_random(void);
+static void generate_symbols(uint8* output, uint32 length, const char* symbols, const uint32* weights);
+static void generate_2bit(uint8* output, uint32 length);
+static void generate_iupac(uint8* output, uint32 length);
+static void generate_rle(uint8* output, uint32 length);
+static void generate_masked(uint8* output, uint32 length);
+static void generate_swap(uint8* output, uint32 length);
+static void generate_swap_rle(uint8* output, uint32 length);
+static PB_CodeSet* build_fixed_code(const PB_SequenceInfo* info);
+static PB_CodeSet* build_equal_length_code(const PB_SequenceInfo* info);
+static PB_CodeSet* build_huffman_code(const PB_SequenceInfo* info);
+static PB_CodeSet* build_swap_code(const PB_SequenceInfo* info);
+static PB_CodeSet* build_rle_code(const PB_SequenceInfo* info);
+static PB_CodeSet* build_swap_rle_code(const PB_SequenceInfo* info);
+static double now(void);
+static bool uses_avx2(void);
+static const char* get_kernel_name(const char* function, const char* kernel, int code_length);
+static const char* get_encoder_name(const PB_CodeSet* codeset, const PB_CompressedSequence* seq);
+static const char* get_fused_encoder_name(const PB_CodeSet* codeset);
+static const char* get_decoder_name(const PB_CodeSet* codeset);
+static void report(const char* input, uint32 length, const char* code, const char* operation, const char* variant,
+				   uint32 compressed_bytes, uint32 iterations, double seconds, uint64 symbols);
+static void check(const uint8* expected, const uint8* output, uint32 length, const BenchInput* input,
+				  const char* code, const char* operation);
+static void run_code(const BenchInput* input, uint32 length, uint8* plain, const PB_SequenceInfo* info,
+					 const uint32* positions, const BenchCode* code);
+static void run(const BenchInput* input, uint32 length);
+
+static const BenchInput inputs[] = {
+	{"2bit", generate_2bit, PB_SEQUENCE_INFO_CASE_INSENSITIVE},
+	{"iupac", generate_iupac, PB_SEQUENCE_INFO_CASE_INSENSITIVE},
+	{"rle", generate_rle, PB_SEQUENCE_INFO_CASE_INSENSITIVE | PB_SEQUENCE_INFO_WITH_RLE},
+	{"masked", generate_masked, PB_SEQUENCE_INFO_CASE_SENSITIVE},
+	{"swap", generate_swap, PB_SEQUENCE_INFO_CASE_SENSITIVE},
+	{"swap_rle", generate_swap_rle, PB_SEQUENCE_INFO_CASE_SENSITIVE | PB_SEQUENCE_INFO_WITH_RLE}
+};
+
+static const BenchCode codes[] = {
+	{"fixed", "get_equal_lengths_code", build_fixed_code},
+	{"equal_length", "get_equal_lengths_code", build_equal_length_code},
+	{"huffman", "get_huffman_code", build_huffman_code},
+	{"swap", "truncate_huffman_code", build_swap_code},
+	{"rle", "get_huffman_code_rle", build_rle_code},
+	{"swap_rle", "truncate_huffman_code", build_swap_rle_code}
+};
+
+/*
+ * 60000 is below PB_INDEX_PART_SIZE, so it measures the encoders without
+ * index for codes that only pay off on longer sequences, e.g. swapping.
+ */
+static const uint32 default_lengths[] = {1000, 60000, 10000000};
+
+/*
+ * local functions
+ */
+
+/**
+ * next_random()
+ * 		xorshift64*, reproducible on every platform unlike rand().
+ */
+static uint32 next_random(void)
+{
+	random_state ^= random_state >> 12;
+	random_state ^= random_state << 25;
+	random_state ^= random_state >> 27;
+
+	return (uint32) ((random_state * UINT64CONST(2685821657736338717)) >> 32);
+}
+
+/**
+ * generate_symbols()
+ * 		Draws symbols with the given weights, like generate_sequence()
+ * 		does with the probabilities of an alphabet.
+ */
+static void generate_symbols(uint8* output, uint32 length, const char* symbols, const uint32* weights)
+{
+	const int n_symbols = strlen(symbols);
+	uint32 sum = 0;
+	uint32 i;
+	int j;
+
+	for (j = 0; j < n_symbols; j++)
+		sum += weights[j];
+
+	for (i = 0; i < length; i++)
+	{
+		uint32 random_number = next_random() % sum;
+
+		for (j = 0; random_number >= weights[j]; j++)
+			random_number -= weights[j];
+
+		output[i] = symbols[j];
+	}
+}
+
+/**
+ * generate_2bit()
+ * 		Equally distributed nucleotides.
+ */
+static void generate_2bit(uint8* output, uint32 length)
+{
+	static const uint32 weights[] = {1, 1, 1, 1};
+
+	generate_symbols(output, length, "ACGT", weights);
+}
+
+/**
+ * generate_iupac()
+ * 		Nucleotides with a few ambiguity codes.
+ */
+static void generate_iupac(uint8* output, uint32 length)
+{
+	static const uint32 weights[] = {250, 250, 250, 250, 20, 5, 5, 2, 2, 2, 2, 1, 1, 1, 1};
+
+	generate_symbols(output, length, "ACGTNRYKMSWBDHV", weights);
+}
+
+/**
+ * generate_rle()
+ * 		Nucleotides interrupted by long runs of N, like assembled genomes.
+ */
+static void generate_rle(uint8* output, uint32 length)
+{
+	uint32 position = 0;
+
+	while (position < length)
+	{
+		const uint32 random_bases = 100 + next_random() % 2000;
+		const uint32 random_run = 50 + next_random() % 5000;
+		const uint32 bases = Min(length - position, random_bases);
+		const uint32 run = Min(length - bases - position, random_run);
+
+		generate_2bit(output + position, bases);
+		position += bases;
+		memset(output + position, 'N', run);
+		position += run;
+	}
+}
+
+/**
+ * generate_masked()
+ * 		Nucleotides with soft-masked repeats in lower case.
+ */
+static void generate_masked(uint8* output, uint32 length)
+{
+	uint32 position = 0;
+	bool lower = false;
+
+	while (position < length)
+	{
+		const uint32 random_block = 200 + next_random() % 3000;
+		const uint32 block = Min(length - position, random_block);
+		uint32 i;
+
+		generate_2bit(output + position, block);
+		if (lower)
+			for (i = position; i < position + block; i++)
+				output[i] |= 0x20;
+
+		position += block;
+		lower = !lower;
+	}
+}
+
+/**
+ * generate_swap()
+ * 		Amino acids with their natural frequencies and a rare symbol,
+ * 		that ends up as the sibling of a frequent one in the Huffman
+ * 		tree and gets swapped.
+ */
+static void generate_swap(uint8* output, uint32 length)
+{
+	static const uint32 weights[] = {990, 830, 710, 690, 680, 660, 590, 580, 550, 550,
+									 530, 470, 410, 390, 390, 290, 240, 230, 140, 110, 1};
+
+	generate_symbols(output, length, "LAGVESIKRDTPNQFYMHCWX", weights);
+}
+
+/**
+ * generate_swap_rle()
+ * 		Amino acids like generate_swap(), interrupted by low complexity
+ * 		runs of L, so that a swapped code with RLE is chosen.
+ */
+static void generate_swap_rle(uint8* output, uint32 length)
+{
+	uint32 position = 0;
+
+	while (position < length)
+	{
+		const uint32 random_residues = 100 + next_random() % 2000;
+		const uint32 random_run = 200 + next_random() % 2000;
+		const uint32 residues = Min(length - position, random_residues);
+		const uint32 run = Min(length - residues - position, random_run);
+
+		generate_swap(output + position, residues);
+		position += residues;
+		memset(output + position, 'L', run);
+		position += run;
+	}
+}
+
+/**
+ * build_fixed_code()
+ * 		Equal length code used as fixed code 0, like the four-letter
+ * 		code of dna_sequence(FLC). Only codes that encode_with_stats()
+ * 		packs in chunks are built, not those of a single symbol with
+ * 		empty codewords.
+ */
+static PB_CodeSet* build_fixed_code(const PB_SequenceInfo* info)
+{
+	PB_CodeSet* result = get_equal_lengths_code(info);
+
+	if (result->max_codeword_length == 0 ||
+		PB_COMPRESSION_BUFFER_BIT_SIZE % result->max_codeword_length != 0)
+	{
+		pfree(result);
+		return NULL;
+	}
+
+	result->is_fixed = TRUE;
+	result->fixed_id = 0;
+
+	return result;
+}
+
+/**
+ * build_equal_length_code()
+ * 		Sequence specific code of equal length codewords.
+ */
+static PB_CodeSet* build_equal_length_code(const PB_SequenceInfo* info)
+{
+	return get_equal_lengths_code(info);
+}
+
+/**
+ * build_huffman_code()
+ * 		Huffman code without swapping and RLE.
+ */
+static PB_CodeSet* build_huffman_code(const PB_SequenceInfo* info)
+{
+	return get_huffman_code(info);
+}
+
+/**
+ * build_swap_code()
+ * 		Huffman code with swapped symbols, without RLE.
+ */
+static PB_CodeSet* build_swap_code(const PB_SequenceInfo* info)
+{
+	PB_CodeSet* huffman_code = get_huffman_code(info);
+	PB_CodeSet* result;
+
+	if (!huffman_code)
+		return NULL;
+
+	result = truncate_huffman_code(huffman_code, info);
+	pfree(huffman_code);
+
+	return result;
+}
+
+/**
+ * build_rle_code()
+ * 		Huffman code with RLE, without swapping.
+ */
+static PB_CodeSet* build_rle_code(const PB_SequenceInfo* info)
+{
+	if (!info->rle_info)
+		return NULL;
+
+	return get_huffman_code_rle(info);
+}
+
+/**
+ * build_swap_rle_code()
+ * 		Huffman code with RLE and swapped symbols.
+ */
+static PB_CodeSet* build_swap_rle_code(const PB_SequenceInfo* info)
+{
+	PB_CodeSet* rle_code = build_rle_code(info);
+	PB_CodeSet* result;
+
+	if (!rle_code)
+		return NULL;
+
+	result = truncate_huffman_code(rle_code, info);
+	pfree(rle_code);
+
+	return result;
+}
+
+/**
+ * now()
+ * 		Returns a monotonic time in seconds.
+ */
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/**
+ * uses_avx2()
+ * 		Returns, whether packing.c packs 2-bit codes with AVX2.
+ */
+static bool uses_avx2(void)
+{
+#if !defined(PB_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+	__builtin_cpu_init();
+
+	return __builtin_cpu_supports("avx2") ? true : false;
+#else
+	return false;
+#endif
+}
+
+/**
+ * get_kernel_name()
+ * 		Returns the name of a function that packs or unpacks equal length
+ * 		codes, followed by the kernel packing.c uses for the code length.
+ */
+static const char* get_kernel_name(const char* function, const char* operation, int code_length)
+{
+	static char name[64];
+
+	if (code_length == 0 || PB_COMPRESSION_BUFFER_BIT_SIZE % code_length != 0)
+		snprintf(name, sizeof(name), "%s/%s_equal_length", function, operation);
+	else if (code_length == 2 && uses_avx2())
+		snprintf(name, sizeof(name), "%s/%s_blocks_2bit_avx2", function, operation);
+	else
+		snprintf(name, sizeof(name), "%s/%s_blocks", function, operation);
+
+	return name;
+}
+
+/**
+ * get_encoder_name()
+ * 		Returns the name of the function encode() uses.
+ */
+static const char* get_encoder_name(const PB_CodeSet* codeset, const PB_CompressedSequence* seq)
+{
+	if (seq->has_index)
+	{
+		if (codeset->n_swapped_symbols > 0)
+			return codeset->uses_rle ? "encode_pc_swp_rle_idx" : "encode_pc_swp_idx";
+		return codeset->uses_rle ? "encode_pc_rle_idx" : "encode_pc_idx";
+	}
+
+	if (codeset->n_swapped_symbols > 0)
+		return codeset->uses_rle ? "encode_pc_swp_rle" : "encode_pc_swp";
+	if (codeset->uses_rle)
+		return "encode_pc_rle";
+	if (codeset->has_equal_length)
+		return get_kernel_name("encode_pc_equal_length", "pack", codeset->max_codeword_length);
+	return "encode_pc";
+}
+
+/**
+ * get_fused_encoder_name()
+ * 		Returns the name of encode_with_stats() and its packing kernel.
+ */
+static const char* get_fused_encoder_name(const PB_CodeSet* codeset)
+{
+	return get_kernel_name("encode_with_stats", "pack", codeset->max_codeword_length);
+}
+
+/**
+ * get_decoder_name()
+ * 		Returns the name of the function decode() uses.
+ */
+static const char* get_decoder_name(const PB_CodeSet* codeset)
+{
+	if (codeset->n_swapped_symbols > 0)
+		return codeset->uses_rle ? "decode_pc_swp_rle_idx" : "decode_pc_swp_idx";
+	if (codeset->uses_rle)
+		return "decode_pc_rle_idx";
+	if (codeset->has_equal_length)
+		return get_kernel_name("decode_pc_idx", "unpack", codeset->max_codeword_length);
+	return "decode_pc_idx";
+}
+
+/**
+ * report()
+ * 		Prints one result line.
+ */
+static void report(const char* input, uint32 length, const char* code, const char* operation, const char* variant,
+				   uint32 compressed_bytes, uint32 iterations, double seconds, uint64 symbols)
+{
+	printf("%s\t%u\t%s\t%s\t%s\t%u\t%u\t%.6f\t%.2f\t%.3f\n",
+		   input, length, code, operation, variant, compressed_bytes, iterations, seconds,
+		   symbols / seconds / 1e6, seconds * 1e9 / symbols);
+	fflush(stdout);
+}
+
+/**
+ * check()
+ * 		Ends the run, if an operation did not reproduce its input.
+ */
+static void check(const uint8* expected, const uint8* output, uint32 length, const BenchInput* input,
+				  const char* code, const char* operation)
+{
+	if (memcmp(expected, output, length) != 0)
+	{
+		fprintf(stderr, "ERROR:  %s of %s with %s code does not reproduce its input\n", operation, input->name, code);
+		exit(1);
+	}
+}
+
+/**
+ * run_code()
+ * 		Times the operations of one kind of code on one input.
+ */
+static void run_code(const BenchInput* input, uint32 length, uint8* plain, const PB_SequenceInfo* info,
+					 const uint32* positions, const BenchCode* code)
+{
+	const uint32 iterations = Max(1, BENCH_SYMBOLS_PER_OPERATION / length);
+	const uint32 slice_length = Min(length, BENCH_SLICE_LENGTH);
+	uint8* output = palloc(length + 1);
+	PB_CodeSet* codeset = NULL;
+	PB_CodeSet** fixed_codesets;
+	PB_CompressedSequence* seq = NULL;
+	uint32 compressed_size;
+	double start;
+	uint32 i;
+
+	start = now();
+	for (i = 0; i < iterations; i++)
+	{
+		if (codeset)
+			pfree(codeset);
+		codeset = code->build(info);
+		if (!codeset)
+		{
+			pfree(output);
+			return;
+		}
+	}
+	compressed_size = get_compressed_size(info, codeset);
+	report(input->name, length, code->name, "code", code->builder, compressed_size, iterations, now() - start, (uint64) iterations * length);
+
+	fixed_codesets = codeset->is_fixed ? &codeset : NULL;
+
+	start = now();
+	for (i = 0; i < iterations; i++)
+	{
+		if (seq)
+			pfree(seq);
+		seq = encode(plain, compressed_size, codeset, (PB_SequenceInfo*) info);
+	}
+	report(input->name, length, code->name, "encode", get_encoder_name(codeset, seq), compressed_size, iterations, now() - start, (uint64) iterations * length);
+
+	if (codeset->is_fixed)
+	{
+		PB_CompressedSequence* fused = NULL;
+
+		start = now();
+		for (i = 0; i < iterations; i++)
+		{
+			PB_SequenceInfo* fused_info = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
+
+			fused_info->sequence_length = length;
+			fused_info->index_part_shift = info->index_part_shift;
+			fused_info->ignore_case = info->ignore_case;
+
+			if (fused)
+				pfree(fused);
+			fused = encode_with_stats(plain, codeset, fused_info);
+			complete_sequence_info(fused_info);
+
+			PB_SEQUENCE_INFO_PFREE(fused_info);
+		}
+		report(input->name, length, code->name, "encode", get_fused_encoder_name(codeset), compressed_size, iterations, now() - start, (uint64) iterations * length);
+
+		decode((Varlena*) fused, output, 0, length, fixed_codesets);
+		bench_end_transaction();
+		check(plain, output, length, input, code->name, "encode_with_stats");
+
+		pfree(fused);
+	}
+
+	start = now();
+	for (i = 0; i < iterations; i++)
+	{
+		decode((Varlena*) seq, output, 0, length, fixed_codesets);
+		bench_end_transaction();
+	}
+	report(input->name, length, code->name, "decode", get_decoder_name(codeset), compressed_size, iterations, now() - start, (uint64) iterations * length);
+
+	check(plain, output, length, input, code->name, "decoding");
+
+	start = now();
+	for (i = 0; i < BENCH_N_SLICES; i++)
+	{
+		decode((Varlena*) seq, output, positions[i], slice_length, fixed_codesets);
+		bench_end_transaction();
+	}
+	report(input->name, length, code->name, "decode_slice", get_decoder_name(codeset), compressed_size, BENCH_N_SLICES, now() - start, (uint64) BENCH_N_SLICES * slice_length);
+
+	check(plain + positions[BENCH_N_SLICES - 1], output, slice_length, input, code->name, "slice decoding");
+
+	pfree(seq);
+	pfree(codeset);
+	pfree(output);
+}
+
+/**
+ * run()
+ * 		Times all operations on one input of one length.
+ */
+static void run(const BenchInput* input, uint32 length)
+{
+	const uint32 iterations = Max(1, BENCH_SYMBOLS_PER_OPERATION / length);
+	const uint32 slice_length = Min(length, BENCH_SLICE_LENGTH);
+	uint8* plain = palloc(length + 1);
+	PB_SequenceInfo* info = NULL;
+	PB_CodeSet* codeset = NULL;
+	uint32 compressed_size = 0;
+	uint32* positions;
+	double start;
+	uint32 i;
+
+	input->generate(plain, length);
+	plain[length] = '\0';
+
+	positions = palloc(BENCH_N_SLICES * sizeof(uint32));
+	for (i = 0; i < BENCH_N_SLICES; i++)
+		positions[i] = next_random() % (length - slice_length + 1);
+
+	start = now();
+	for (i = 0; i < iterations; i++)
+	{
+		if (info)
+			PB_SEQUENCE_INFO_PFREE(info);
+		info = get_sequence_info_cstring(plain, input->mode);
+	}
+	report(input->name, length, "-", "stats", "get_sequence_info_cstring", 0, iterations, now() - start, (uint64) iterations * length);
+
+	start = now();
+	for (i = 0; i < iterations; i++)
+	{
+		if (codeset)
+			pfree(codeset);
+		codeset = get_optimal_code(info);
+		compressed_size = get_compressed_size(info, codeset);
+	}
+	report(input->name, length, "optimal", "code", "get_optimal_code", compressed_size, iterations, now() - start, (uint64) iterations * length);
+
+	for (i = 0; i < lengthof(codes); i++)
+		run_code(input, length, plain, info, positions, &codes[i]);
+
+	pfree(codeset);
+	PB_SEQUENCE_INFO_PFREE(info);
+	pfree(positions);
+	pfree(plain);
+}
+
+/*
+ * public functions
+ */
+
+int main(int argc, char** argv)
+{
+	uint32 i;
+	int j;
+
+	printf("input\tlength\tcode\toperation\tvariant\tcompressed_bytes\titerations\tseconds\tmb_per_s\tns_per_symbol\n");
+
+	for (i = 0; i < lengthof(inputs); i++)
+	{
+		if (argc > 1)
+		{
+			for (j = 1; j < argc; j++)
+				if (strtoul(argv[j], NULL, 10) > 0)
+					run(&inputs[i], (uint32) strtoul(argv[j], NULL, 10));
+		}
+		else
+		{
+			for (j = 0; j < lengthof(default_lengths); j++)
+				run(&inputs[i], default_lengths[j]);
+		}
+	}
+
+	return 0;
+}
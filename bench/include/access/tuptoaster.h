@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   bench/include/access/tuptoaster.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef BENCH_ACCESS_TUPTOASTER_H_
+#define BENCH_ACCESS_TUPTOASTER_H_
+
+#include "postgres.h"
+
+struct varatt_external
+{
+	int32 va_rawsize;
+	int32 va_extsize;
+};
+
+#define VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr) \
+	memset(&(toast_pointer), 0, sizeof(toast_pointer))
+#define VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer)	false
+
+#define toast_raw_datum_size(value)	((Size) VARSIZE(value))
+
+#endif /* BENCH_ACCESS_TUPTOASTER_H_ */
@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   bench/include/access/xact.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef BENCH_ACCESS_XACT_H_
+#define BENCH_ACCESS_XACT_H_
+
+#include "postgres.h"
+
+typedef enum
+{
+	XACT_EVENT_COMMIT,
+	XACT_EVENT_ABORT,
+	XACT_EVENT_PREPARE
+} XactEvent;
+
+typedef void (*XactCallback) (XactEvent event, void* arg);
+
+/*
+ * The callback is called by bench_end_transaction().
+ */
+extern void RegisterXactCallback(XactCallback callback, void* arg);
+extern void bench_end_transaction(void);
+
+#endif /* BENCH_ACCESS_XACT_H_ */
@@ -0,0 +1,19 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   bench/include/c.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef BENCH_C_H_
+#define BENCH_C_H_
+
+#include "postgres.h"
+
+#endif /* BENCH_C_H_ */
@@ -0,0 +1,36 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   bench/include/fmgr.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef BENCH_FMGR_H_
+#define BENCH_FMGR_H_
+
+#include "postgres.h"
+
+/*
+ * Values are never toasted, detoasting returns them or a copy of a slice.
+ */
+extern struct varlena* bench_detoast_slice(struct varlena* value, int32 offset, int32 length);
+
+/*
+ * Only the members used to cache data across calls.
+ */
+typedef struct FmgrInfo {
+	void* fn_extra;
+	MemoryContext fn_mcxt;
+} FmgrInfo;
+
+#define PG_DETOAST_DATUM(datum)		((struct varlena*) (datum))
+#define PG_DETOAST_DATUM_SLICE(datum, offset, length) \
+	bench_detoast_slice((struct varlena*) (datum), (offset), (length))
+
+#endif /* BENCH_FMGR_H_ */
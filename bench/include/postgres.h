@@ -0,0 +1,125 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   bench/include/postgres.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef BENCH_POSTGRES_H_
+#define BENCH_POSTGRES_H_
+
+/*
+ * Thin replacement of the server headers for the benchmark. It provides
+ * just what the compression engine uses: integer types, plain varlena
+ * values with 4-byte headers, memory allocation with malloc() and error
+ * reporting, that ends the process.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef int64_t int64;
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef size_t Size;
+typedef char* Pointer;
+typedef uintptr_t Datum;
+typedef void* MemoryContext;
+
+#ifndef TRUE
+#define TRUE	1
+#endif
+#ifndef FALSE
+#define FALSE	0
+#endif
+
+#define UINT64CONST(x)	UINT64_C(x)
+#define INT64CONST(x)	INT64_C(x)
+
+#define lengthof(array)	(sizeof(array) / sizeof((array)[0]))
+
+#define Min(x, y)		((x) < (y) ? (x) : (y))
+#define Max(x, y)		((x) > (y) ? (x) : (y))
+#define Assert(condition)
+#define likely(x)		__builtin_expect((x) != 0, 1)
+#define unlikely(x)		__builtin_expect((x) != 0, 0)
+
+/*
+ * Varlena values are always plain, never toasted.
+ */
+struct varlena
+{
+	char vl_len_[4];
+	char vl_dat[];
+};
+
+typedef struct varlena bytea;
+typedef struct varlena text;
+
+#define VARHDRSZ				((int32) sizeof(int32))
+#define VARSIZE(PTR)			(*((uint32*) (PTR)))
+#define SET_VARSIZE(PTR, len)	(*((uint32*) (PTR)) = (uint32) (len))
+#define VARDATA(PTR)			(((struct varlena*) (PTR))->vl_dat)
+#define VARSIZE_ANY(PTR)		VARSIZE(PTR)
+#define VARSIZE_ANY_EXHDR(PTR)	(VARSIZE(PTR) - VARHDRSZ)
+#define VARDATA_ANY(PTR)		VARDATA(PTR)
+
+#define VARATT_IS_EXTERNAL(PTR)			false
+#define VARATT_IS_EXTERNAL_ONDISK(PTR)	false
+#define VARATT_IS_COMPRESSED(PTR)		false
+#define VARATT_IS_EXTENDED(PTR)			false
+
+#define PointerGetDatum(X)	((Datum) (X))
+#define DatumGetPointer(X)	((Pointer) (X))
+
+/*
+ * Memory allocation
+ */
+extern void* palloc(Size size);
+extern void* palloc0(Size size);
+extern void* repalloc(void* pointer, Size size);
+extern void pfree(void* pointer);
+
+/*
+ * Error reporting
+ */
+#define DEBUG3		10
+#define DEBUG2		11
+#define DEBUG1		12
+#define LOG			15
+#define NOTICE		18
+#define WARNING		19
+#define ERROR		20
+
+extern int errmsg(const char* format, ...);
+extern int errdetail(const char* format, ...);
+extern int errhint(const char* format, ...);
+extern int errcode(int sqlerrcode);
+extern void bench_report(int level);
+
+#define ereport(level, rest) \
+	do { (void) rest; bench_report(level); } while (0)
+#define elog(level, ...) \
+	do { errmsg(__VA_ARGS__); bench_report(level); } while (0)
+
+#define ERRCODE_INVALID_PARAMETER_VALUE		0
+#define ERRCODE_INVALID_TEXT_REPRESENTATION	0
+#define ERRCODE_PROGRAM_LIMIT_EXCEEDED		0
+#define ERRCODE_DATA_CORRUPTED				0
+#define ERRCODE_INTERNAL_ERROR				0
+
+#endif /* BENCH_POSTGRES_H_ */
@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   bench/include/utils/memutils.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef BENCH_UTILS_MEMUTILS_H_
+#define BENCH_UTILS_MEMUTILS_H_
+
+#include "postgres.h"
+
+/*
+ * There is only one memory context, memory lives until it is freed.
+ */
+#define TopMemoryContext		((MemoryContext) NULL)
+#define CurrentMemoryContext	((MemoryContext) NULL)
+
+#define MemoryContextAlloc(context, size)			palloc(size)
+#define MemoryContextAllocZero(context, size)		palloc0(size)
+#define MemoryContextReset(context)					((void) (context))
+
+static inline MemoryContext MemoryContextSwitchTo(MemoryContext context)
+{
+	return context;
+}
+
+#define ALLOCSET_DEFAULT_SIZES	0
+#define AllocSetContextCreate(parent, name, sizes)	((MemoryContext) NULL)
+
+#endif /* BENCH_UTILS_MEMUTILS_H_ */
@@ -0,0 +1,168 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   bench/shim.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/xact.h"
+
+#include "sequence/sequence.h"
+#include "sequence/codebook.h"
+#include "utils/instrumentation.h"
+
+/*
+ * Implementation of the server functions declared by the headers in
+ * bench/include. Errors end the benchmark, other messages are dropped.
+ */
+
+PB_Counters pb_counters;
+
+static char message[1024];
+static XactCallback xact_callback = NULL;
+static void* xact_callback_arg = NULL;
+
+/*
+ * Memory allocation
+ */
+
+void* palloc(Size size)
+{
+	void* result = malloc(size ? size : 1);
+
+	if (result == NULL)
+	{
+		fprintf(stderr, "ERROR:  out of memory\n");
+		exit(1);
+	}
+
+	return result;
+}
+
+void* palloc0(Size size)
+{
+	void* result = palloc(size);
+
+	memset(result, 0, size);
+
+	return result;
+}
+
+void* repalloc(void* pointer, Size size)
+{
+	void* result = realloc(pointer, size ? size : 1);
+
+	if (result == NULL)
+	{
+		fprintf(stderr, "ERROR:  out of memory\n");
+		exit(1);
+	}
+
+	return result;
+}
+
+void pfree(void* pointer)
+{
+	free(pointer);
+}
+
+/*
+ * Error reporting
+ */
+
+int errmsg(const char* format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+
+	return 0;
+}
+
+int errdetail(const char* format, ...)
+{
+	return 0;
+}
+
+int errhint(const char* format, ...)
+{
+	return 0;
+}
+
+int errcode(int sqlerrcode)
+{
+	return 0;
+}
+
+void bench_report(int level)
+{
+	if (level >= ERROR)
+	{
+		fprintf(stderr, "ERROR:  %s\n", message);
+		exit(1);
+	}
+}
+
+/*
+ * Detoasting
+ */
+
+struct varlena* bench_detoast_slice(struct varlena* value, int32 offset, int32 length)
+{
+	const int32 data_size = VARSIZE(value) - VARHDRSZ;
+	struct varlena* result;
+
+	if (offset > data_size)
+		offset = data_size;
+	if (length < 0 || length > data_size - offset)
+		length = data_size - offset;
+
+	result = palloc(VARHDRSZ + length);
+	SET_VARSIZE(result, VARHDRSZ + length);
+	memcpy(VARDATA(result), VARDATA(value) + offset, length);
+
+	return result;
+}
+
+/*
+ * Transactions
+ */
+
+void RegisterXactCallback(XactCallback callback, void* arg)
+{
+	xact_callback = callback;
+	xact_callback_arg = arg;
+}
+
+void bench_end_transaction(void)
+{
+	if (xact_callback)
+		xact_callback(XACT_EVENT_COMMIT, xact_callback_arg);
+}
+
+/*
+ * Codebooks live in a table. Fixed codes are passed by the benchmark.
+ */
+
+PB_CodeSet* get_fixed_codeset(const PB_CompressedSequence* header,
+							  PB_CodeSet** fixed_codesets)
+{
+	if (PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(header) || fixed_codesets == NULL)
+		ereport(ERROR,(errmsg("fixed codes and codebooks are not available in the benchmark")));
+
+	return fixed_codesets[header->n_swapped_symbols];
+}
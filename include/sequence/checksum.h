@@ -0,0 +1,57 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/checksum.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_CHECKSUM_H_
+#define SEQUENCE_CHECKSUM_H_
+
+#include "sequence/sequence.h"
+
+/**
+ * Initial value and final transformation of a CRC32.
+ */
+#define PB_CRC32_INIT			(~((uint32) 0))
+#define PB_CRC32_FINAL(crc)		(~(crc))
+
+/**
+ * Size of stack buffers used for computing CRC32s of translated or
+ * decoded data in chunks.
+ */
+#define PB_CRC32_CHUNK_SIZE		4096
+
+/*
+ * crc32_update()
+ *		Continue a CRC32 over a block of data.
+ * 		This code implements the AUTODIN II polynomial, processing eight
+ * 		bytes at a time (slice-by-8).
+ * 		Original code by Spencer Garrett <srg@quick.com>
+ * 		Taken into PostBIS from pgsql/src/contrib/hstore/crc32.c
+ *
+ * 	uint32 crc : CRC so far, PB_CRC32_INIT for the first block
+ * 	uint8* data : block of data
+ * 	uint32 length : length of the block
+ */
+uint32 crc32_update(uint32 crc, const uint8* data, uint32 length);
+
+/*
+ * crc32_zeros()
+ *		Continue a CRC32 over a number of zero bytes without reading
+ * 		them. Together with the linearity of CRC32s, this allows to
+ * 		update the CRC32 of a sequence, if some of its characters are
+ * 		replaced.
+ *
+ * 	uint32 crc : CRC so far
+ * 	uint64 n_bytes : number of zero bytes
+ */
+uint32 crc32_zeros(uint32 crc, uint64 n_bytes);
+
+#endif /* SEQUENCE_CHECKSUM_H_ */
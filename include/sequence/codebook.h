@@ -0,0 +1,83 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/codebook.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_CODEBOOK_H_
+#define SEQUENCE_CODEBOOK_H_
+
+#include "postgres.h"
+
+#include "sequence/sequence.h"
+
+/**
+ * Version of the external representation of codebooks.
+ */
+#define PB_CODEBOOK_FORMAT_VERSION		1
+
+/**
+ * get_codebook()
+ * 		Returns the codebook with an id from the table postbis_codebook.
+ *
+ * 	Codebooks are loaded once per backend and kept for its lifetime.
+ * 	The result is a fixed code set with the id PB_CODEBOOK_FIXED_ID
+ * 	and must not be freed.
+ *
+ * 	uint32 id : id of the codebook
+ */
+PB_CodeSet* get_codebook(uint32 id);
+
+/**
+ * get_fixed_codeset()
+ * 		Returns the fixed code or the codebook of a sequence, that has
+ * 		is_fixed set.
+ *
+ * 	PB_CompressedSequence* header : detoasted prefix of at least
+ * 									PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE bytes
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+PB_CodeSet* get_fixed_codeset(const PB_CompressedSequence* header,
+							  PB_CodeSet** fixed_codesets);
+
+/**
+ * build_codebook()
+ * 		Trains a codebook from symbol counts, e.g. of a sample of a column,
+ * 		and returns its external representation.
+ *
+ * 	uint64* frequencies : number of occurrences of each symbol
+ */
+bytea* build_codebook(const uint64* frequencies);
+
+/**
+ * encode_with_codebook()
+ * 		Encodes a sequence with a codebook. Returns NULL, if the codebook
+ * 		does not contain all symbols of the sequence.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	uint32 id : id of the codebook
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+PB_CompressedSequence* encode_with_codebook(Varlena* raw_seq,
+											uint32 id,
+											PB_CodeSet** fixed_codesets);
+
+/**
+ * encode_without_codebook()
+ * 		Encodes a sequence, that uses a codebook, with a code of its own.
+ * 		Needed by functions, that rewrite the codewords of a sequence.
+ *
+ * 	PB_CompressedSequence* seq : detoasted sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+PB_CompressedSequence* encode_without_codebook(PB_CompressedSequence* seq,
+											   PB_CodeSet** fixed_codesets);
+
+#endif /* SEQUENCE_CODEBOOK_H_ */
@@ -17,6 +17,115 @@
 #include "postgres.h"
 
 #include "sequence/sequence.h"
+#include "sequence/detoast_cursor.h"
+
+/**
+ * Type for decoding map elements, so the symbol and the length
+ * of the code can be stored close to each other in one data
+ * structure. An actual decoding map would be an array of
+ * PB_DecodingMap of size PB_DECODE_MAP_SIZE (256 if PB_PrefixCode is
+ * uint8)
+ */
+typedef struct {
+	uint8 symbol;
+	uint8 code_length;
+} PB_DecodingMap;
+
+#define PB_DECODE_MAP_SIZE (1 << PB_PREFIX_CODE_BIT_SIZE)
+
+/**
+ * Number of bits that are looked up at once in a multi-symbol
+ * decoding map and the maximum number of symbols one lookup can
+ * return. With a four-letter code one lookup yields 6 symbols.
+ */
+#define PB_MULTI_DECODE_BIT_SIZE		12
+#define PB_MULTI_DECODE_MAP_SIZE		(1 << PB_MULTI_DECODE_BIT_SIZE)
+#define PB_MULTI_DECODE_MAX_SYMBOLS		6
+
+/**
+ * Building a multi-symbol decoding map costs about as much as decoding
+ * a few thousand symbols one by one. Below this number of symbols to
+ * decode (or skip) only the single-symbol map is used.
+ */
+#define PB_MULTI_DECODE_MIN_LENGTH		8192
+
+/**
+ * Type for multi-symbol decoding map elements. An entry holds all
+ * symbols whose codes lie completely within the looked up bits, up to
+ * PB_MULTI_DECODE_MAX_SYMBOLS, and the number of bits they take.
+ *
+ * Decoding stops in front of symbols that need special treatment, i.e.
+ * the run-length symbol and the swap master symbol. If the first code
+ * is such a symbol, n_symbols and code_length are zero and the caller
+ * has to fall back to the single-symbol decoding map.
+ */
+typedef struct {
+	uint8 symbols[PB_MULTI_DECODE_MAX_SYMBOLS];
+	uint8 n_symbols;
+	uint8 code_length;
+} PB_MultiDecodingMap;
+
+/**
+ * Decoding maps of one code set, as handed out by get_decoding_maps().
+ *
+ * Maps of fixed code sets are built once per backend and kept for its
+ * lifetime. Maps of sequence specific code sets are kept in a small
+ * cache keyed by the codewords, so rows sharing a code share the maps.
+ * While a caller holds the maps they are pinned and cannot be evicted.
+ */
+typedef struct {
+	PB_DecodingMap map[PB_DECODE_MAP_SIZE];
+	PB_DecodingMap swap_map[PB_DECODE_MAP_SIZE];
+	PB_MultiDecodingMap* multi_map;	/* built on demand, may be NULL */
+
+	bool uses_rle;
+	bool uses_swapping;
+	uint8 master_symbol;
+
+	bool is_cached;
+	int pin_count;
+
+	/*
+	 * cache key
+	 */
+	const PB_CodeSet* fixed_codeset;
+	uint32 hash;
+	uint8 n_symbols;
+	uint8 n_swapped_symbols;
+	PB_Codeword words[PB_ASCII_SIZE + 1];
+} PB_DecodingMaps;
+
+/**
+ * get_decoding_maps()
+ * 		Returns the decoding maps for a prefix code set.
+ *
+ * 	The result must be given back with release_decoding_maps().
+ *
+ * 	PB_CodeSet* codeset : codeset to get maps for
+ */
+PB_DecodingMaps* get_decoding_maps(const PB_CodeSet* codeset);
+
+/**
+ * get_multi_decoding_map()
+ * 		Returns the multi-symbol decoding map for a set of decoding maps.
+ *
+ * 	If the map has not been built yet it is only built if at least
+ * 	PB_MULTI_DECODE_MIN_LENGTH symbols are to be decoded, otherwise
+ * 	NULL is returned.
+ *
+ * 	PB_DecodingMaps* maps : decoding maps from get_decoding_maps()
+ * 	int64 n_symbols : number of symbols that will be decoded
+ */
+const PB_MultiDecodingMap* get_multi_decoding_map(PB_DecodingMaps* maps,
+												  int64 n_symbols);
+
+/**
+ * release_decoding_maps()
+ * 		Gives back decoding maps obtained by get_decoding_maps().
+ *
+ * 	PB_DecodingMaps* maps : decoding maps
+ */
+void release_decoding_maps(PB_DecodingMaps* maps);
 
 /**
  * get_compressed_size()
@@ -44,6 +153,71 @@ PB_CompressedSequence* encode(uint8* input,
 							  PB_CodeSet* codeset,
 							  PB_SequenceInfo* info);
 
+/**
+ * encode_with_stats()
+ * 		Encode a sequence with a fixed code of equal length codewords and
+ * 		collect its symbol frequencies in the same pass. The caller must
+ * 		complete the info with complete_sequence_info() and check, whether
+ * 		the code can express the sequence, before using the result.
+ *
+ * 	uint8* input : input sequence, not null-terminated
+ * 	PB_CodeSet* codeset : fixed code with equal length codewords and without RLE
+ * 	PB_SequenceInfo* info : info with sequence_length and index_part_shift set,
+ * 							symbol frequencies are added
+ */
+PB_CompressedSequence* encode_with_stats(uint8* input,
+										 PB_CodeSet* codeset,
+										 PB_SequenceInfo* info);
+
+/**
+ * splice_sequences()
+ * 		Concatenate two sequences encoded with the same fixed code of
+ * 		equal length codewords without encoding again. Returns NULL
+ * 		for other sequences.
+ *
+ * 	Varlena* raw_seq1 : first possibly toasted sequence
+ * 	Varlena* raw_seq2 : second possibly toasted sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_CompressedSequence* splice_sequences(Varlena* raw_seq1,
+										Varlena* raw_seq2,
+										PB_CodeSet** fixed_codesets);
+
+/**
+ * encode_reversed()
+ * 		Encode the reverse of a sequence with its own code, without
+ * 		decoding the whole sequence at once. Returns NULL for codes
+ * 		with swapping or RLE.
+ *
+ * 	PB_CompressedSequence* input : detoasted sequence
+ * 	uint32 compressed_size : size of the result, the streams have the same size
+ * 	PB_CodeSet* codeset : code of the sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_CompressedSequence* encode_reversed(PB_CompressedSequence* input,
+									   uint32 compressed_size,
+									   PB_CodeSet* codeset,
+									   PB_CodeSet** fixed_codesets);
+
+/**
+ * overlay_sequence()
+ * 		Replace characters of a sequence by as many others, encoding
+ * 		again at most the index parts holding them. Returns NULL for
+ * 		sequences of version 0, codes with swapping and characters the
+ * 		code cannot encode.
+ *
+ * 	PB_CompressedSequence* input : detoasted sequence
+ * 	uint32 position : first position to replace, the first position is 0
+ * 	uint8* replacement : new characters
+ * 	uint32 length : number of characters to replace, at least 1
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_CompressedSequence* overlay_sequence(PB_CompressedSequence* input,
+										uint32 position,
+										const uint8* replacement,
+										uint32 length,
+										PB_CodeSet** fixed_codesets);
+
 /**
  * decode()
  * 		Decode a compressed sequence.
@@ -60,4 +234,22 @@ void decode(Varlena* input,
 			uint32 out_length,
 			PB_CodeSet** fixed_codesets);
 
+/**
+ * decode_from_cursor()
+ * 		Decode a compressed sequence read through a detoast cursor. Callers
+ * 		decoding a sequence piece by piece keep the cursor open, so the
+ * 		header is fetched once and the stream is prefetched.
+ *
+ * 	PB_DetoastCursor* cursor : open cursor on the compressed sequence
+ * 	uint8* output : pointer to sufficient space to store the decoded sequence
+ * 	uint32 start_position : position to start decoding from, first is 0
+ * 	uint32 out_length : number of characters to decode
+ * 	PB_CodeSet** codeset : list of fixed codesets
+ */
+void decode_from_cursor(PB_DetoastCursor* cursor,
+						uint8* output,
+						uint32 start_position,
+						uint32 out_length,
+						PB_CodeSet** fixed_codesets);
+
 #endif /* SEQUENCE_COMPRESSION_H_ */
@@ -21,16 +21,11 @@
 
 #include "sequence/sequence.h"
 #include "sequence/compression.h"
+#include "sequence/codebook.h"
+#include "sequence/detoast_cursor.h"
 
 #include "utils/debug.h"
 
-typedef struct {
-	uint8 symbol;
-	uint8 code_length;
-} PB_DecodingMap;
-
-#define PB_DECODE_MAP_SIZE (1 << PB_PREFIX_CODE_BIT_SIZE)
-
 #define DECODE(input_pointer, buffer, bits_in_buffer, val, length, map) { \
 	val = buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - PB_PREFIX_CODE_BIT_SIZE); \
 	length = map[val].code_length; \
@@ -48,6 +43,39 @@ typedef struct {
 	} \
 }
 
+/**
+ * This macro reads as many characters as possible with one lookup
+ * in a multi-symbol decoding map. If there are less than
+ * PB_MULTI_DECODE_BIT_SIZE bits in the buffer, it peeks into the next
+ * block, so input_pointer must point to readable memory. If the entry
+ * found holds no symbols, nothing has been consumed.
+ *
+ * Parameters:
+ * 	PB_CompressionBuffer* input_pointer : compressed sequence
+ * 	PB_CompressionBuffer buffer : compression buffer
+ * 	int bits_in_buffer : bits in compression buffer
+ * 	PB_MultiDecodingMap* entry : decoded symbols
+ * 	PB_MultiDecodingMap* multi_map : multi-symbol decoding map
+ */
+#define MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map) { \
+	PB_CompressionBuffer window = buffer; \
+	int length; \
+	if (bits_in_buffer < PB_MULTI_DECODE_BIT_SIZE) \
+		window |= *input_pointer >> bits_in_buffer; \
+	entry = &multi_map[window >> (PB_COMPRESSION_BUFFER_BIT_SIZE - PB_MULTI_DECODE_BIT_SIZE)]; \
+	length = entry->code_length; \
+	if (length <= bits_in_buffer) { \
+		bits_in_buffer -= length; \
+		buffer = buffer << length; \
+	} else { \
+		PB_CompressionBuffer next = *input_pointer; \
+		bits_in_buffer -= length; \
+		buffer = next << (-bits_in_buffer); \
+		bits_in_buffer += PB_COMPRESSION_BUFFER_BIT_SIZE; \
+		input_pointer++; \
+	} \
+}
+
 /**
  * This macro reads a given number of bits into a target variable.
  *
@@ -74,51 +102,6 @@ typedef struct {
 	} \
 }
 
-#define PB_NO_SWAP_MAP		0
-#define PB_SWAP_MAP			1
-
-/**
- * get_decoding_map()
- * 		Creates a decoding map for a prefix code set.
- */
-static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
-{
-	PB_DecodingMap* map;
-	int i,j;
-	int from = 0;
-	int to = 0;
-
-	if (mode == PB_NO_SWAP_MAP)
-	{
-		from = 0;
-		to = codeset->n_symbols - codeset->n_swapped_symbols;
-	}
-	else if (mode == PB_SWAP_MAP)
-	{
-		from = codeset->n_symbols - codeset->n_swapped_symbols;
-		to = codeset->n_symbols;
-	}
-
-	map = (PB_DecodingMap*) palloc(PB_DECODE_MAP_SIZE * sizeof(PB_DecodingMap));
-	memset(map, 0xFF, PB_DECODE_MAP_SIZE * sizeof(PB_DecodingMap));
-
-	for (i = from; i < to; i++)
-	{
-		const int lower_bound = codeset->words[i].code;
-		const int upper_bound = lower_bound + (1 << (PB_PREFIX_CODE_BIT_SIZE - codeset->words[i].code_length));
-
-		for (j = lower_bound; j < upper_bound; j++)
-		{
-			map[j].symbol = codeset->words[i].symbol;
-			map[j].code_length = codeset->words[i].code_length;
-		}
-
-		PB_DEBUG3(errmsg("get_decoding_map(): i:%d lower_bound:%u upper_bound:%u symbol:%c code:%u length:%u/%ld",i,lower_bound,upper_bound,codeset->words[i].symbol,codeset->words[i].code,codeset->words[i].code_length, PB_PREFIX_CODE_BIT_SIZE));
-	}
-
-	return map;
-}
-
 /*
  * Iterate over a compressed sequence.
  *
@@ -135,36 +118,45 @@ static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
  *		} PB_END_DECODE
  */
 #define PB_BEGIN_DECODE(__pb_decode_input, __pb_decode_start_position, __pb_decode_output_length, __pb_decode_fixed_codesets, __pb_decode_output) {\
-	PB_CompressedSequence* __pb_decode_input_header;\
+	PB_DetoastCursor* __pb_decode_cursor;\
+	const PB_CompressedSequence* __pb_decode_input_header;\
 	PB_CodeSet* __pb_decode_codeset;\
-	PB_DecodingMap* __pb_decode_map;\
-	PB_DecodingMap* __pb_decode_swap_map;\
+	PB_DecodingMaps* __pb_decode_maps;\
+	const PB_DecodingMap* __pb_decode_map;\
+	const PB_DecodingMap* __pb_decode_swap_map;\
+	const PB_MultiDecodingMap* __pb_decode_multi_map;\
+	uint8 __pb_decode_pending[PB_MULTI_DECODE_MAX_SYMBOLS];\
+	int __pb_decode_n_pending = 0;\
+	int __pb_decode_pending_pos = 0;\
 	PB_IndexEntry* __pb_decode_start_entry = NULL;\
 	PB_CompressionBuffer __pb_decode_buffer;\
 	int __pb_decode_bits_in_buffer;\
 	int __pb_decode_i;\
 	int __pb_decode_swap_counter;\
 	int __pb_decode_stream_offset;\
-	Varlena* __pb_decode_input_slice;\
+	int __pb_decode_entry_offset;\
+	const uint8* __pb_decode_input_data;\
+	int32 __pb_decode_input_size;\
 	PB_CompressionBuffer* __pb_decode_input_pointer;\
+	PB_CompressionBuffer* __pb_decode_input_end;\
 	uint8 __pb_decode_current = 0;\
 	int __pb_decode_n_rle_out = 0;\
 	uint8 __pb_decode_master_symbol = 0;\
 	int __pb_decode_max_codeword_length ;\
-	const int __pb_decode_raw_size = toast_raw_datum_size((Datum)__pb_decode_input);\
+	int __pb_decode_raw_size;\
 \
 	PB_TRACE(errmsg("BEGIN_DECODE(%u,%u)", __pb_decode_start_position, __pb_decode_output_length));\
 \
-	__pb_decode_input_header = (PB_CompressedSequence*) PG_DETOAST_DATUM_SLICE(__pb_decode_input,\
-																			   0,\
-																			   sizeof(PB_CompressedSequence) - VARHDRSZ);\
+	__pb_decode_cursor = open_detoast_cursor(__pb_decode_input);\
+	__pb_decode_input_header = __pb_decode_cursor->header;\
+	__pb_decode_raw_size = __pb_decode_cursor->raw_size;\
 \
 	PB_DEBUG1(errmsg("PB_BEGIN_DECODE(): input header detoasted\n\tsequence_length:%u\n\tn_symbols:%u\n\tn_swapped_symbols:%u\n\thas_equal_length:%d\n\thas_index:%d\n\tis_fixed:%d\n\tuses_rle:%d",\
 			__pb_decode_input_header->sequence_length, __pb_decode_input_header->n_symbols, __pb_decode_input_header->n_swapped_symbols, __pb_decode_input_header->has_equal_length,\
 			__pb_decode_input_header->has_index, __pb_decode_input_header->is_fixed, __pb_decode_input_header->uses_rle));\
 \
 	if (__pb_decode_input_header->is_fixed) {\
-		__pb_decode_codeset = __pb_decode_fixed_codesets[__pb_decode_input_header->n_swapped_symbols];\
+		__pb_decode_codeset = get_fixed_codeset(__pb_decode_input_header, __pb_decode_fixed_codesets);\
 	} else {\
 		int __pb_decode_code_size = sizeof(PB_Codeword) * __pb_decode_input_header->n_symbols;\
 		PB_Codeword* __pb_decode_code;\
@@ -175,11 +167,6 @@ static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
 		__pb_decode_codeset->is_fixed = FALSE;\
 		__pb_decode_codeset->has_equal_length = __pb_decode_input_header->has_equal_length;\
 		__pb_decode_codeset->uses_rle = __pb_decode_input_header->uses_rle;\
-\
-		pfree(__pb_decode_input_header);\
-		__pb_decode_input_header = (PB_CompressedSequence*)\
-									PG_DETOAST_DATUM_SLICE(__pb_decode_input,0,sizeof(PB_CompressedSequence) - VARHDRSZ +\
-														   __pb_decode_code_size);\
 \
 		__pb_decode_code = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(__pb_decode_input_header);\
 		memcpy(__pb_decode_codeset->words, __pb_decode_code, __pb_decode_code_size);\
@@ -187,36 +174,31 @@ static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
 		PB_DEBUG1(errmsg("PB_BEGIN_DECODE():Sequence specific code copied"));\
 	}\
 \
-	__pb_decode_map = get_decoding_map(__pb_decode_codeset, PB_NO_SWAP_MAP);\
-	__pb_decode_swap_map = get_decoding_map(__pb_decode_codeset, PB_SWAP_MAP);\
+	__pb_decode_maps = get_decoding_maps(__pb_decode_codeset);\
+	__pb_decode_map = __pb_decode_maps->map;\
+	__pb_decode_swap_map = __pb_decode_maps->swap_map;\
+\
+	__pb_decode_multi_map = get_multi_decoding_map(__pb_decode_maps, __pb_decode_start_position + __pb_decode_output_length);\
+\
+	__pb_decode_max_codeword_length = 0;\
+	for (__pb_decode_i = 0; __pb_decode_i < __pb_decode_codeset->n_symbols; __pb_decode_i++)\
+		if (__pb_decode_max_codeword_length < __pb_decode_codeset->words[__pb_decode_i].code_length)\
+			__pb_decode_max_codeword_length = __pb_decode_codeset->words[__pb_decode_i].code_length;\
 \
 	if (__pb_decode_codeset->n_swapped_symbols > 0) {\
 		__pb_decode_master_symbol = __pb_decode_codeset->words[__pb_decode_codeset->n_symbols - __pb_decode_codeset->n_swapped_symbols].symbol;\
-		__pb_decode_max_codeword_length = __pb_decode_codeset->words[__pb_decode_codeset->n_symbols - 1].code_length +\
-										  __pb_decode_codeset->words[__pb_decode_master_symbol].code_length +\
+		__pb_decode_max_codeword_length = 2 * __pb_decode_max_codeword_length +\
 										  PB_SWAP_RUN_LENGTH_BIT_SIZE;\
-	} else {\
-		__pb_decode_max_codeword_length = __pb_decode_codeset->words[__pb_decode_codeset->n_symbols - 1].code_length;\
 	}\
 \
-	if (__pb_decode_input_header->has_index) {\
-		int __pb_decode_start_entry_no;\
+	__pb_decode_entry_offset = PB_COMPRESSED_SEQUENCE_INDEX_ENTRY_OFFSET(__pb_decode_input_header, __pb_decode_start_position);\
+	if (__pb_decode_entry_offset >= 0) {\
+		__pb_decode_start_entry = palloc0(sizeof(PB_IndexEntry));\
+		memcpy(__pb_decode_start_entry,\
+			   read_detoast_cursor(__pb_decode_cursor, __pb_decode_entry_offset - VARHDRSZ, sizeof(PB_IndexEntry), NULL),\
+			   sizeof(PB_IndexEntry));\
 \
-		__pb_decode_start_entry_no = (__pb_decode_start_position + 1) / PB_INDEX_PART_SIZE - 1;\
-		if (__pb_decode_start_entry_no >= 0) {\
-			Varlena* __pb_decode_data_slice = (Varlena*)\
-				PG_DETOAST_DATUM_SLICE(__pb_decode_input,\
-									   sizeof(PB_CompressedSequence) - VARHDRSZ +\
-									   sizeof(PB_Codeword) * __pb_decode_input_header->n_symbols +\
-									   sizeof(PB_IndexEntry) * __pb_decode_start_entry_no,\
-									   sizeof(PB_IndexEntry));\
-\
-			__pb_decode_start_entry = palloc0(sizeof(PB_IndexEntry));\
-			memcpy(__pb_decode_start_entry, VARDATA_ANY(__pb_decode_data_slice), sizeof(PB_IndexEntry));\
-			pfree(__pb_decode_data_slice);\
-\
-			PB_DEBUG1(errmsg("PB_BEGIN_DECODE(): index found, uses entry no %d", __pb_decode_start_entry_no));\
-		}\
+		PB_DEBUG1(errmsg("PB_BEGIN_DECODE(): index found, uses entry at offset %d", __pb_decode_entry_offset));\
 	}\
 \
 	__pb_decode_stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(__pb_decode_input_header) - VARHDRSZ;\
@@ -230,21 +212,21 @@ static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
 		if (__pb_decode_codeset->uses_rle)\
 			__pb_decode_slice_size += __pb_decode_max_codeword_length + 8;\
 \
-		__pb_decode_slice_size = __pb_decode_slice_size / PB_COMPRESSION_BUFFER_BIT_SIZE + 1;\
+		__pb_decode_slice_size = __pb_decode_slice_size / PB_COMPRESSION_BUFFER_BIT_SIZE + 2;\
 		__pb_decode_slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;\
 \
 		if (__pb_decode_slice_size + __pb_decode_stream_offset > __pb_decode_raw_size)\
 			__pb_decode_slice_size = __pb_decode_raw_size - __pb_decode_stream_offset;\
 \
-		__pb_decode_input_slice = (Varlena*)\
-				PG_DETOAST_DATUM_SLICE(__pb_decode_input,\
-									   __pb_decode_stream_offset,\
-									   __pb_decode_slice_size);\
+		__pb_decode_input_data = read_detoast_cursor(__pb_decode_cursor,\
+													 __pb_decode_stream_offset,\
+													 __pb_decode_slice_size,\
+													 &__pb_decode_input_size);\
 \
 		PB_DEBUG1(errmsg("PB_BEGIN_DECODE(): skipping through sequence\n\tslice size is %d bytes", __pb_decode_slice_size));\
 \
 		__pb_decode_i = __pb_decode_start_position - 1;\
-		__pb_decode_input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(__pb_decode_input_slice);\
+		__pb_decode_input_pointer = (PB_CompressionBuffer*) __pb_decode_input_data;\
 \
 		if (__pb_decode_codeset->n_swapped_symbols > 0) {\
 			__pb_decode_buffer = *__pb_decode_input_pointer;\
@@ -262,36 +244,39 @@ static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
 	} else {\
 		int __pb_decode_slice_start = __pb_decode_stream_offset +\
 									  __pb_decode_start_entry->block * PB_COMPRESSION_BUFFER_BYTE_SIZE;\
-		int __pb_decode_slice_size = (__pb_decode_output_length + (__pb_decode_start_position % PB_INDEX_PART_SIZE)) *\
+		int __pb_decode_slice_size = (__pb_decode_output_length + (__pb_decode_start_position % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(__pb_decode_input_header))) *\
 									  __pb_decode_max_codeword_length;\
 \
 		if (__pb_decode_codeset->uses_rle)\
 			__pb_decode_slice_size += __pb_decode_max_codeword_length + 8;\
 \
-		__pb_decode_slice_size = __pb_decode_slice_size / PB_COMPRESSION_BUFFER_BIT_SIZE + 1;\
+		__pb_decode_slice_size = __pb_decode_slice_size / PB_COMPRESSION_BUFFER_BIT_SIZE + 2;\
 		__pb_decode_slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;\
 \
 		if (__pb_decode_slice_size + __pb_decode_slice_start > __pb_decode_raw_size)\
 			__pb_decode_slice_size = __pb_decode_raw_size - __pb_decode_slice_start;\
 \
-		__pb_decode_input_slice = (Varlena*)\
-					PG_DETOAST_DATUM_SLICE(__pb_decode_input,\
-										   __pb_decode_slice_start,\
-										   __pb_decode_slice_size);\
+		__pb_decode_input_data = read_detoast_cursor(__pb_decode_cursor,\
+													 __pb_decode_slice_start,\
+													 __pb_decode_slice_size,\
+													 &__pb_decode_input_size);\
 \
 		PB_DEBUG1(errmsg("PB_BEGIN_DECODE(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes\nrle_shift:%u\nswap_shift:%u",\
 						 __pb_decode_start_entry->block, __pb_decode_slice_start, __pb_decode_slice_size, __pb_decode_start_entry->rle_shift, __pb_decode_start_entry->swap_shift));\
 \
-		__pb_decode_input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(__pb_decode_input_slice);\
+		__pb_decode_input_pointer = (PB_CompressionBuffer*) __pb_decode_input_data;\
 		__pb_decode_bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - __pb_decode_start_entry->bit;\
 		__pb_decode_buffer = *(__pb_decode_input_pointer) << __pb_decode_start_entry->bit;\
 		__pb_decode_input_pointer++;\
-		__pb_decode_i = ((__pb_decode_start_position + 1) % PB_INDEX_PART_SIZE) - 1 + __pb_decode_start_entry->rle_shift;\
+		__pb_decode_i = ((__pb_decode_start_position + 1) % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(__pb_decode_input_header)) - 1 + __pb_decode_start_entry->rle_shift;\
 		if (__pb_decode_codeset->n_swapped_symbols > 0)\
 			__pb_decode_swap_counter = __pb_decode_start_entry->swap_shift;\
 		else\
 			__pb_decode_swap_counter = __pb_decode_input_header->sequence_length + 1;\
 	}\
+\
+	__pb_decode_input_end = (PB_CompressionBuffer*) __pb_decode_input_data +\
+							__pb_decode_input_size / PB_COMPRESSION_BUFFER_BYTE_SIZE;\
 \
 	if (__pb_decode_input_header->is_fixed == FALSE)\
 		pfree(__pb_decode_codeset);\
@@ -306,6 +291,17 @@ static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
 	while (__pb_decode_i >= 0) {\
 		PB_PrefixCode __pb_decode_val;\
 		int __pb_decode_length;\
+\
+		if (__pb_decode_multi_map && __pb_decode_i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 &&\
+			__pb_decode_input_pointer < __pb_decode_input_end) {\
+			const PB_MultiDecodingMap* __pb_decode_entry;\
+\
+			MULTI_DECODE(__pb_decode_input_pointer, __pb_decode_buffer, __pb_decode_bits_in_buffer, __pb_decode_entry, __pb_decode_multi_map);\
+			if (__pb_decode_entry->n_symbols > 0) {\
+				__pb_decode_i -= __pb_decode_entry->n_symbols;\
+				continue;\
+			}\
+		}\
 \
 		DECODE(__pb_decode_input_pointer, __pb_decode_buffer, __pb_decode_bits_in_buffer, __pb_decode_val, __pb_decode_length, __pb_decode_map);\
 		__pb_decode_current = __pb_decode_map[__pb_decode_val].symbol;\
@@ -373,7 +369,20 @@ static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
 		__pb_decode_i--;\
 		__pb_decode_n_rle_out--;\
 \
-		if (__pb_decode_n_rle_out < 0) {\
+		if (__pb_decode_n_rle_out < 0 && __pb_decode_pending_pos >= __pb_decode_n_pending &&\
+			__pb_decode_multi_map && __pb_decode_input_pointer < __pb_decode_input_end) {\
+			const PB_MultiDecodingMap* __pb_decode_entry;\
+\
+			MULTI_DECODE(__pb_decode_input_pointer, __pb_decode_buffer, __pb_decode_bits_in_buffer, __pb_decode_entry, __pb_decode_multi_map);\
+			memcpy(__pb_decode_pending, __pb_decode_entry->symbols, PB_MULTI_DECODE_MAX_SYMBOLS);\
+			__pb_decode_n_pending = __pb_decode_entry->n_symbols;\
+			__pb_decode_pending_pos = 0;\
+		}\
+\
+		if (__pb_decode_n_rle_out < 0 && __pb_decode_pending_pos < __pb_decode_n_pending) {\
+			__pb_decode_current = __pb_decode_pending[__pb_decode_pending_pos];\
+			__pb_decode_pending_pos++;\
+		} else if (__pb_decode_n_rle_out < 0) {\
 			PB_PrefixCode __pb_decode_val;\
 			int __pb_decode_length;\
 \
@@ -429,8 +438,8 @@ static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
 #define PB_END_DECODE\
 	}\
 \
-	pfree((PB_DecodingMap*) __pb_decode_map);\
-	pfree((PB_DecodingMap*) __pb_decode_swap_map);\
+	release_decoding_maps(__pb_decode_maps);\
+	close_detoast_cursor(__pb_decode_cursor);\
 \
 	PB_TRACE(errmsg("<-PB_BEGIN_DECODE()"))\
 }
@@ -0,0 +1,124 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/delta.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_DELTA_H_
+#define SEQUENCE_DELTA_H_
+
+#include "sequence/sequence.h"
+
+/**
+ * Number of equal characters, which end an edit
+ */
+#define PB_DELTA_SEED_LENGTH		12
+
+/**
+ * Maximum number of characters searched ahead in each sequence for
+ * the end of a short edit
+ */
+#define PB_DELTA_MAX_SHIFT			32
+
+/**
+ * Maximum number of characters searched ahead in each sequence for
+ * the end of a long edit, e.g. an inserted gene. The seeds of this
+ * window of the reference are hashed.
+ */
+#define PB_DELTA_WINDOW_SIZE		65536
+
+/*
+ * Replaces deleted_length characters of the reference at
+ * reference_position by inserted_length characters, which are
+ * stored at inserted_offset of the inserted symbols. The first
+ * inserted character is at sequence_position of the sequence.
+ */
+typedef struct {
+	uint32 reference_position;
+	uint32 sequence_position;
+	uint32 deleted_length;
+	uint32 inserted_length;
+	uint32 inserted_offset;
+} PB_DeltaEdit;
+
+/*
+ * Stores a sequence as edits against a reference sequence.
+ *
+ *	uint32 _vl_len			:	pgsql specific 4-byte length field; must only be set and get
+ *								with pgsqls macros SET_VARSIZE() and VARSIZE()
+ *	uint32 sequence_length	:	number of characters in the original sequence
+ *	uint32 reference_length	:	number of characters in the reference sequence
+ *	int32 reference_id		:	id of the reference, its meaning is up to the type
+ *	uint32 reference_crc32	:	CRC32 of the reference sequence
+ *	uint32 n_edits			:	number of edits
+ *
+ * The layout of the variable part in 'data' member of this struct is:
+ * 	Variable member					|	size
+ * ----------------------------------------------------------------------------
+ * 	PB_DeltaEdit edits[];				|	sizeof(PB_DeltaEdit) * n_edits
+ * 	uint8 inserted[];					|	sum of inserted_length of all edits
+ *
+ * Edits are ordered by position and do not overlap. Characters between
+ * edits are copied from the reference.
+ */
+typedef struct {
+	uint32 _vl_len;
+	uint32 sequence_length;
+	uint32 reference_length;
+	int32 reference_id;
+	uint32 reference_crc32;
+	uint32 n_edits;
+	uint8 data[];
+} PB_DeltaSequence;
+
+#define PB_DELTA_SEQUENCE_EDIT_POINTER(seq) \
+	((PB_DeltaEdit*) ((PB_DeltaSequence*) seq)->data)
+
+#define PB_DELTA_SEQUENCE_INSERTED_POINTER(seq) \
+	(((PB_DeltaSequence*) seq)->data + sizeof(PB_DeltaEdit) * ((PB_DeltaSequence*) seq)->n_edits)
+
+/**
+ * delta_encode()
+ * 		Find the edits turning the reference into the input sequence.
+ * 		Edits end at the nearest PB_DELTA_SEED_LENGTH equal characters
+ * 		within PB_DELTA_MAX_SHIFT characters of both sequences, or else
+ * 		within PB_DELTA_WINDOW_SIZE characters. Differences without
+ * 		such a seed are replaced window by window.
+ *
+ * 	const uint8* reference : reference sequence
+ * 	uint32 reference_length : length of the reference sequence
+ * 	const uint8* input : input sequence
+ * 	uint32 length : length of the input sequence
+ */
+PB_DeltaSequence* delta_encode(const uint8* reference,
+							   uint32 reference_length,
+							   const uint8* input,
+							   uint32 length);
+
+/**
+ * delta_decode()
+ * 		Decode a part of a delta sequence. Only the part of the reference
+ * 		covered by the window is decoded.
+ *
+ * 	const PB_DeltaSequence* input : detoasted delta sequence
+ * 	Varlena* reference : possibly toasted compressed reference sequence
+ * 	uint8* output : pointer to sufficient space to store the decoded sequence
+ * 	uint32 start_position : position to start decoding from, first is 0
+ * 	uint32 out_length : number of characters to decode
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the reference
+ */
+void delta_decode(const PB_DeltaSequence* input,
+				  Varlena* reference,
+				  uint8* output,
+				  uint32 start_position,
+				  uint32 out_length,
+				  PB_CodeSet** fixed_codesets);
+
+#endif /* SEQUENCE_DELTA_H_ */
@@ -0,0 +1,121 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/detoast_cursor.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_DETOAST_CURSOR_H_
+#define SEQUENCE_DETOAST_CURSOR_H_
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "sequence/sequence.h"
+
+/**
+ * Size of the first slice prefetched after a miss and upper bound of
+ * the slices prefetched while reading forward. Every slice fetched
+ * from a TOAST table costs a lookup in its index, so forward reads
+ * double the slice size up to this bound.
+ */
+#define PB_DETOAST_CURSOR_MIN_PREFETCH_SIZE	(8 * 1024)
+#define PB_DETOAST_CURSOR_MAX_PREFETCH_SIZE	(1024 * 1024)
+
+/**
+ * Reads a possibly toasted sequence with as few TOAST fetches as
+ * possible.
+ *
+ * Values stored inline or compressed are detoasted as a whole once.
+ * Values stored out of line without compression are read in slices:
+ * the header, the code and the first index entries are fetched in one
+ * slice when the cursor is opened, further reads are served from a
+ * window of prefetched data.
+ *
+ * All offsets are relative to the data of the value, i.e. without
+ * the varlena header, like those of PG_DETOAST_DATUM_SLICE.
+ *
+ * 	MemoryContext context : context of the data read through the cursor
+ * 	bool is_cached : TRUE if the cursor is kept in fn_extra and must
+ * 					 not be closed
+ * 	Varlena* input : the value as passed
+ * 	Varlena* value : whole detoasted value or NULL
+ * 	bool free_value : TRUE if value was allocated by the cursor
+ * 	int32 raw_size : size of the detoasted value with varlena header
+ * 	PB_CompressedSequence* header : header, code and first index entries
+ * 	int32 header_size : bytes of data held by header
+ * 	Varlena* window : slice of prefetched data or NULL
+ * 	int32 window_start : offset of the window
+ * 	int32 window_size : bytes of data held by window
+ */
+typedef struct {
+	MemoryContext context;
+	bool is_cached;
+	Varlena* input;
+	Varlena* value;
+	bool free_value;
+	int32 raw_size;
+	PB_CompressedSequence* header;
+	int32 header_size;
+	Varlena* window;
+	int32 window_start;
+	int32 window_size;
+} PB_DetoastCursor;
+
+/**
+ * open_detoast_cursor()
+ * 		Opens a cursor on a sequence and reads its header.
+ *
+ * 	Varlena* input : possibly toasted sequence
+ */
+PB_DetoastCursor* open_detoast_cursor(Varlena* input);
+
+/**
+ * open_cached_detoast_cursor()
+ * 		Opens a cursor on a sequence or returns the cursor of the last
+ * 		call, if the sequence is the same. The cursor is kept in fn_extra
+ * 		with the data read through it, so repeated calls on one value
+ * 		neither fetch nor decompress it again. Values stored out of line
+ * 		are recognized by their TOAST pointer, compressed values by their
+ * 		data. Other values are cheap to open, they get a new cursor.
+ *
+ * 	The function must not use fn_extra otherwise. Closing the cursor
+ * 	does nothing, if it is cached.
+ *
+ * 	FmgrInfo* flinfo : function to cache the cursor for or NULL
+ * 	Varlena* input : possibly toasted sequence
+ */
+PB_DetoastCursor* open_cached_detoast_cursor(FmgrInfo* flinfo, Varlena* input);
+
+/**
+ * read_detoast_cursor()
+ * 		Returns a pointer to size bytes of data starting at offset. Fewer
+ * 		bytes are available at the end of the value. The data is valid
+ * 		until the next read or until the cursor is closed.
+ *
+ * 	PB_DetoastCursor* cursor : open cursor
+ * 	int32 offset : offset of the first byte, without varlena header
+ * 	int32 size : number of bytes to read
+ * 	int32* available : set to the number of bytes available, may be NULL
+ */
+const uint8* read_detoast_cursor(PB_DetoastCursor* cursor,
+								 int32 offset,
+								 int32 size,
+								 int32* available);
+
+/**
+ * close_detoast_cursor()
+ * 		Frees a cursor and the data read through it, unless the cursor
+ * 		is cached.
+ *
+ * 	PB_DetoastCursor* cursor : open cursor
+ */
+void close_detoast_cursor(PB_DetoastCursor* cursor);
+
+#endif /* SEQUENCE_DETOAST_CURSOR_H_ */
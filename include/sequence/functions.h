@@ -15,6 +15,12 @@
 #define SEQUENCE_FUNCTIONS_H_
 
 #include "sequence/sequence.h"
+#include "fmgr.h"
+
+/*
+ * Maximum length of a k-mer packed into an uint64
+ */
+#define PB_MAX_KMER_LENGTH	8
 
 /**
  * reverse()
@@ -43,24 +49,175 @@ int sequence_compare(Varlena* seq_a, Varlena* seq_b, PB_CodeSet** fixed_codesets
 
 /*
  * sequence_crc32()
- *		Compute CRC32 of a compressed sequence.
+ *		Get the CRC32 of a compressed sequence.
  * 		This code implements the AUTODIN II polynomial
  * 		Original code by Spencer Garrett <srg@quick.com>
  * 		Taken into PostBIS from pgsql/src/contrib/hstore/crc32.c
  *
- * 	PB_CompressedSequence* seq: detoasted input sequence
+ * 	Varlena* raw_seq : possibly toasted input sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+uint32 sequence_crc32(Varlena* raw_seq, PB_CodeSet** fixed_codesets);
+
+/*
+ * invalidate_sequence_crc32()
+ *		Marks the stored CRC32 of a detoasted sequence as unknown after
+ * 		its symbols have been changed in place.
+ *
+ * 	PB_CompressedSequence* seq : detoasted sequence
+ */
+void invalidate_sequence_crc32(PB_CompressedSequence* seq);
+
+/*
+ * sequence_symbol_count()
+ *		Counts the characters of a sequence, which are contained in a set
+ * 		of symbols. Uses the stored composition of long sequences.
+ *
+ * 	This function mimics substr() for the range. The first position is 1.
+ *
+ * 	Varlena* raw_seq : possibly toasted input sequence
+ * 	uint8* symbols : symbols to count
+ * 	int n_symbols : number of symbols to count
+ * 	int start : position to start from
+ * 	int length : number of characters to count
+ * 	uint32* n_counted : set to the number of characters in the range, if not NULL
  * 	PB_CodeSet** fixed_codesets : fixed codes
  */
-uint32 sequence_crc32(PB_CompressedSequence* seq, PB_CodeSet** fixed_codesets);
+uint32 sequence_symbol_count(Varlena* raw_seq,
+							 const uint8* symbols,
+							 int n_symbols,
+							 int start,
+							 int length,
+							 uint32* n_counted,
+							 PB_CodeSet** fixed_codesets);
 
 /*
  * sequence_strpos()
- * 		Find position of given string.
+ * 		Find position of given string. The first position is 1,
+ * 		0 is returned if the string is not found.
+ *
+ * 	The cursor on the sequence is cached in fn_extra of flinfo, see
+ * 	open_cached_detoast_cursor().
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence to search in
+ * 	uint8* pattern : string to search for
+ * 	uint32 pattern_length : length of the string
+ * 	FmgrInfo* flinfo : function to cache the cursor for or NULL
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+uint32 sequence_strpos(Varlena* raw_seq,
+					   const uint8* pattern,
+					   uint32 pattern_length,
+					   FmgrInfo* flinfo,
+					   PB_CodeSet** fixed_codesets);
+
+/*
+ * get_index_part_shift()
+ * 		Parses the index granularity type modifier, a power of two
+ * 		from PB_MIN_INDEX_PART_SIZE to PB_INDEX_PART_SIZE. Returns
+ * 		the shift of PB_INDEX_PART_SIZE giving this part size or -1,
+ * 		if the keyword is not a number. Raises an error for other numbers.
+ *
+ * 	char* keyword : type modifier keyword
+ */
+int get_index_part_shift(const char* keyword);
+
+/*
+ * sequence_composition()
+ * 		Counts the occurrences of each symbol in a sequence. Uses
+ * 		the stored composition of long sequences.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	uint64* frequencies : counts are added here, PB_SOURCE_ALPHABET_SIZE entries
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+void sequence_composition(Varlena* raw_seq, uint64* frequencies, PB_CodeSet** fixed_codesets);
+
+/*
+ * sequence_alphabet()
+ * 		Marks the symbols occurring in a sequence. Sequences not using
+ * 		a fixed code are not decoded.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	bool* symbol_set : set to TRUE for each symbol of the sequence,
+ * 					   PB_SOURCE_ALPHABET_SIZE entries
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+void sequence_alphabet(Varlena* raw_seq, bool* symbol_set, PB_CodeSet** fixed_codesets);
+
+/*
+ * string_kmers()
+ * 		Collects the distinct k-mers of a string. Each k-mer is packed
+ * 		into an integer, one byte per character, the first character
+ * 		in the most significant byte. Returns the k-mers in ascending
+ * 		order or NULL, if the string is shorter than k.
+ *
+ * 	uint8* string : input string
+ * 	uint32 length : length of the string
+ * 	int k : length of k-mers, at most PB_MAX_KMER_LENGTH
+ * 	int32* n_kmers : set to number of k-mers returned
+ */
+uint64* string_kmers(const uint8* string, uint32 length, int k, int32* n_kmers);
+
+/*
+ * sequence_kmers()
+ * 		Collects the distinct k-mers of a sequence, packed like
+ * 		string_kmers() does. The sequence is decoded chunk by chunk.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	int k : length of k-mers, at most PB_MAX_KMER_LENGTH
+ * 	int32* n_kmers : set to number of k-mers returned
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+uint64* sequence_kmers(Varlena* raw_seq, int k, int32* n_kmers, PB_CodeSet** fixed_codesets);
+
+/*
+ * sequence_concat()
+ * 		Concatenates two sequences. Sequences with the same fixed code of
+ * 		equal length codewords are spliced. Others are decoded into one
+ * 		buffer, which is compressed by the input function of their type.
+ *
+ * 	Varlena* raw_seq1 : first possibly toasted sequence
+ * 	Varlena* raw_seq2 : second possibly toasted sequence
+ * 	PGFunction input_function : input function of the type
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_CompressedSequence* sequence_concat(Varlena* raw_seq1,
+									   Varlena* raw_seq2,
+									   PGFunction input_function,
+									   PB_CodeSet** fixed_codesets);
+
+/*
+ * sequence_overlay()
+ * 		Replaces count characters of a sequence from start by a text,
+ * 		like overlay() does for texts. Replacing by as many characters
+ * 		encodes again at most the index parts holding them. Other
+ * 		sequences are decoded and compressed by the input function.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	text* replacement : new characters
+ * 	int32 start : first position to replace, the first position is 1
+ * 	int32 count : number of characters to replace
+ * 	PGFunction input_function : input function of the type
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_CompressedSequence* sequence_overlay(Varlena* raw_seq,
+										text* replacement,
+										int32 start,
+										int32 count,
+										PGFunction input_function,
+										PB_CodeSet** fixed_codesets);
+
+/*
+ * sequence_symbol_at()
+ * 		Returns the symbol at a position or -1 beyond the end. Only the
+ * 		part of the stream holding the symbol is decoded, it is found
+ * 		through the index.
  *
- * 	PB_CompressedSequence* seq : detoasted sequence to search in
- * 	Text* search : detoasted text to search for
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	uint32 position : position of the symbol, first is 0
  * 	PB_CodeSet** fixed_codesets : fixed codes
  */
-uint32 sequence_strpos(PB_CompressedSequence* seq, text* search, PB_CodeSet** fixed_codesets);
+int sequence_symbol_at(Varlena* raw_seq, uint32 position, PB_CodeSet** fixed_codesets);
 
 #endif /* SEQUENCE_FUNCTIONS_H_ */
@@ -0,0 +1,96 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/generation.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_GENERATION_H_
+#define SEQUENCE_GENERATION_H_
+
+#include "postgres.h"
+
+#include "sequence/sequence.h"
+#include "types/alphabet.h"
+
+/**
+ * Upper bound of the number of symbols in an alphabet.
+ */
+#define PB_MAX_ALPHABET_SIZE	128
+
+/**
+ * State of the pseudo random number generator, xorshift64*.
+ * The same seed gives the same numbers on every platform.
+ */
+typedef struct {
+	uint64 state;
+} PB_Random;
+
+/**
+ * Alias table of an alphabet, that draws a symbol with a single
+ * random number in constant time, regardless of the alphabet size.
+ *
+ * A random number is split into a column and a coin. The symbol of
+ * the column is drawn if the coin is below the threshold of the column,
+ * the alias otherwise.
+ *
+ * 	int n_symbols : number of columns
+ * 	PB_Symbol symbols : symbol of each column
+ * 	PB_Symbol aliases : alias of each column
+ * 	uint64 thresholds : probability of the symbol of each column
+ * 						times 2^32
+ */
+typedef struct {
+	int n_symbols;
+	PB_Symbol symbols[PB_MAX_ALPHABET_SIZE];
+	PB_Symbol aliases[PB_MAX_ALPHABET_SIZE];
+	uint64 thresholds[PB_MAX_ALPHABET_SIZE];
+} PB_AliasTable;
+
+/**
+ * init_random()
+ * 		Seeds a random number generator.
+ *
+ * 	PB_Random* rng : generator to seed
+ * 	int64 seed : any value
+ */
+void init_random(PB_Random* rng, int64 seed);
+
+/**
+ * next_random()
+ * 		Returns the next random number of a generator.
+ *
+ * 	PB_Random* rng : seeded generator
+ */
+uint64 next_random(PB_Random* rng);
+
+/**
+ * get_alias_table()
+ * 		Builds the alias table of an alphabet. Alphabets without
+ * 		probabilities are equally distributed.
+ *
+ * 	PB_Alphabet* alphabet : detoasted alphabet
+ */
+PB_AliasTable* get_alias_table(const PB_Alphabet* alphabet);
+
+/**
+ * generate_symbols()
+ * 		Draws length symbols from an alias table.
+ *
+ * 	PB_AliasTable* table : alias table of the alphabet
+ * 	PB_Random* rng : seeded generator
+ * 	uint8* output : space for length symbols
+ * 	uint32 length : number of symbols
+ */
+void generate_symbols(const PB_AliasTable* table,
+					  PB_Random* rng,
+					  uint8* output,
+					  uint32 length);
+
+#endif /* SEQUENCE_GENERATION_H_ */
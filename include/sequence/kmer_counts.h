@@ -0,0 +1,143 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/kmer_counts.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_KMER_COUNTS_H_
+#define SEQUENCE_KMER_COUNTS_H_
+
+#include "postgres.h"
+
+#include "sequence/sequence.h"
+
+/**
+ * Maximum length of counted k-mers, a k-mer is packed with 2 bits
+ * per nucleotide into a uint64.
+ */
+#define PB_MAX_COUNTED_KMER_LENGTH	32
+
+/**
+ * Number of occurrences of a k-mer. The k-mer is packed with 2 bits
+ * per nucleotide, A = 0, C = 1, G = 2 and T = 3, the last nucleotide
+ * in the lowest bits. So packed k-mers sort like their text.
+ */
+typedef struct {
+	uint64 kmer;
+	uint64 count;
+} PB_KmerCount;
+
+/**
+ * Counts k-mers in an open addressing hash table. The table and the
+ * counter live in a memory context of their own, which is freed at once.
+ *
+ * 	MemoryContext context : context of the counter and its table
+ * 	int k : length of the k-mers
+ * 	bool canonical : TRUE if a k-mer and its reverse complement are
+ * 					 counted as the smaller of both
+ * 	uint32 n_entries : number of distinct k-mers
+ * 	uint32 capacity : number of slots, a power of 2
+ * 	int capacity_bits : log2 of capacity
+ * 	PB_KmerCount* entries : slots, empty ones have count 0
+ */
+typedef struct {
+	MemoryContext context;
+	int k;
+	bool canonical;
+	uint32 n_entries;
+	uint32 capacity;
+	int capacity_bits;
+	PB_KmerCount* entries;
+} PB_KmerCounter;
+
+/**
+ * new_kmer_counter()
+ * 		Creates an empty counter in a new child of the current memory
+ * 		context.
+ *
+ * 	int k : length of k-mers, at most PB_MAX_COUNTED_KMER_LENGTH
+ * 	bool canonical : count canonical k-mers
+ */
+PB_KmerCounter* new_kmer_counter(int k, bool canonical);
+
+/**
+ * free_kmer_counter()
+ * 		Frees a counter including its table.
+ *
+ * 	PB_KmerCounter* counter : counter to free
+ */
+void free_kmer_counter(PB_KmerCounter* counter);
+
+/**
+ * count_sequence_kmers()
+ * 		Adds the k-mers of a sequence to a counter. k-mers containing
+ * 		other symbols than A, C, G and T are skipped. Streams of fixed
+ * 		codes of 2 bit codewords for these symbols are read without
+ * 		decoding, other sequences are decoded chunk by chunk.
+ *
+ * 	PB_KmerCounter* counter : counter to add to
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+void count_sequence_kmers(PB_KmerCounter* counter, Varlena* raw_seq, PB_CodeSet** fixed_codesets);
+
+/**
+ * merge_kmer_counters()
+ * 		Adds the counts of a counter to another one of the same k.
+ *
+ * 	PB_KmerCounter* counter : counter to add to
+ * 	PB_KmerCounter* other : counter to add
+ */
+void merge_kmer_counters(PB_KmerCounter* counter, const PB_KmerCounter* other);
+
+/**
+ * add_kmer_count()
+ * 		Adds occurrences of a k-mer to a counter.
+ *
+ * 	PB_KmerCounter* counter : counter to add to
+ * 	uint64 kmer : packed k-mer
+ * 	uint64 count : number of occurrences
+ */
+void add_kmer_count(PB_KmerCounter* counter, uint64 kmer, uint64 count);
+
+/**
+ * sort_kmer_counts()
+ * 		Moves the counts to the front of the table and sorts them by k-mer.
+ * 		Returns the table, which holds n_entries counts afterwards. No
+ * 		k-mers can be added any more.
+ *
+ * 	PB_KmerCounter* counter : counter
+ */
+PB_KmerCount* sort_kmer_counts(PB_KmerCounter* counter);
+
+/**
+ * get_kmer_spectrum()
+ * 		Returns the spectrum of the counts, i.e. for each number of
+ * 		occurrences the number of k-mers occurring that often, ordered
+ * 		by the number of occurrences. The kmer member holds the number
+ * 		of occurrences, count the number of k-mers. The rows are
+ * 		allocated in the current memory context.
+ *
+ * 	PB_KmerCounter* counter : counter
+ * 	uint32* n_rows : set to the number of rows of the spectrum
+ */
+PB_KmerCount* get_kmer_spectrum(const PB_KmerCounter* counter, uint32* n_rows);
+
+/**
+ * kmer_to_cstring()
+ * 		Writes the text of a packed k-mer.
+ *
+ * 	uint64 kmer : packed k-mer
+ * 	int k : length of the k-mer
+ * 	char* output : space for k + 1 characters
+ */
+void kmer_to_cstring(uint64 kmer, int k, char* output);
+
+#endif /* SEQUENCE_KMER_COUNTS_H_ */
@@ -0,0 +1,71 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/packing.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_PACKING_H_
+#define SEQUENCE_PACKING_H_
+
+#include "sequence/sequence.h"
+
+/*
+ * Kernels for codes, where all codewords have the same length
+ * (e.g. 2-bit DNA and RNA). No lookup of code lengths is necessary,
+ * so whole blocks are packed and unpacked at once. On x86 CPUs
+ * supporting AVX2, 2-bit codes are handled 32 symbols at a time.
+ * The instruction set is detected at runtime, the portable kernels
+ * are used otherwise. Compile with -DPB_NO_SIMD to disable the
+ * vectorized kernels altogether.
+ */
+
+/**
+ * Size of the map from symbols to codes, one entry for each byte.
+ */
+#define PB_PACK_MAP_SIZE	256
+
+/**
+ * pack_equal_length()
+ * 		Packs a sequence with a code of equal length codewords into
+ * 		a stream of PB_CompressionBuffer blocks.
+ *
+ * 	uint8* input : input sequence, all symbols must be in the code
+ * 	uint32 length : number of symbols to pack
+ * 	uint8* codes : right-aligned code for each symbol, PB_PACK_MAP_SIZE entries
+ * 	int code_length : length of all codewords
+ * 	PB_CompressionBuffer* output : stream to write to
+ */
+void pack_equal_length(const uint8* input,
+					   uint32 length,
+					   const uint8* codes,
+					   int code_length,
+					   PB_CompressionBuffer* output);
+
+/**
+ * unpack_equal_length()
+ * 		Unpacks symbols from a stream of PB_CompressionBuffer blocks encoded
+ * 		with a code of equal length codewords. Only blocks containing
+ * 		bits of the desired symbols are read.
+ *
+ * 	PB_CompressionBuffer* input : block containing the first symbol
+ * 	int start_bit : offset of the first symbol in this block
+ * 	uint32 length : number of symbols to unpack
+ * 	uint8* symbols : symbol for each right-aligned code, 2^code_length entries
+ * 	int code_length : length of all codewords
+ * 	uint8* output : pointer to sufficient space for length symbols
+ */
+void unpack_equal_length(const PB_CompressionBuffer* input,
+						 int start_bit,
+						 uint32 length,
+						 const uint8* symbols,
+						 int code_length,
+						 uint8* output);
+
+#endif /* SEQUENCE_PACKING_H_ */
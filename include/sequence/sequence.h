@@ -37,13 +37,24 @@
 #define PB_MAX_COMPRESSED_SEQUENCE_SIZE		1073741823
 
 /**
- * Number of characters between substring-index entries
+ * Default number of characters between substring-index entries
  * Smaller number -> denser index -> faster substring access
  * 									+ larger sequence in total
  * Larger number -> sparser index -> slower substring access
  * 										+ smaller sequence in total
+ *
+ * Sequences may use a denser index of PB_INDEX_PART_SIZE >> shift
+ * characters, with shift up to PB_MAX_INDEX_PART_SHIFT.
  */
 #define PB_INDEX_PART_SIZE 65536
+#define PB_MAX_INDEX_PART_SHIFT	7
+#define PB_MIN_INDEX_PART_SIZE	(PB_INDEX_PART_SIZE >> PB_MAX_INDEX_PART_SHIFT)
+
+/**
+ * Sequences of at least this length store the counts of their
+ * symbols for every PB_INDEX_PART_SIZE characters.
+ */
+#define PB_COMPOSITION_MIN_LENGTH	PB_INDEX_PART_SIZE
 
 /**
  * Type to buffer compressed data
@@ -178,6 +189,7 @@ typedef struct {
 	uint8 n_symbols;
 	bool ignore_case : 1;
 	uint8* symbols;
+	uint8 index_part_shift;
 } PB_SequenceInfo;
 
 /**
@@ -219,6 +231,7 @@ typedef struct {
 	bool uses_rle : 1;
 	bool ignore_case : 1;
 	uint8 fixed_id;
+	uint32 codebook_id;
 	uint64 swap_savings;
 	uint64 ascii_bitmap_low;
 	uint64 ascii_bitmap_high;
@@ -247,24 +260,44 @@ typedef struct {
  *	bool has_index			:	TRUE if index is included
  *	bool is_fixed			:	TRUE if fixed code was used
  *	bool uses_rle			:	TRUE if rle was used
- *	bool _align1			:	reserved for data alignment; might be used in future
- *	uint8 _align2			:	data alignment
+ *	bool has_composition	:	TRUE if symbol counts are included
+ *	uint8 index_part_shift	:	index entries every PB_INDEX_PART_SIZE >> index_part_shift characters
+ *	uint8 version			:	version of the layout, see PB_COMPRESSED_SEQUENCE_VERSION,
+ *								and PB_COMPRESSED_SEQUENCE_HASH_UNKNOWN
  *
  * The layout of the variable part in 'data' member of this struct is:
  * 	Variable member					|	size
  * ----------------------------------------------------------------------------
+ * 	uint32 hash;						|	h = version > 0 ? sizeof(uint32) : 0
+ * 	uint32 codebook_id;					|	k = codebook is used ? sizeof(uint32) : 0
  * 	PB_Codeword symbols[];				|	a = sizeof(PB_Codeword) * (n_symbols - n_swapped_symbols)
  *	PB_Codeword swapped_symbols[];		|	b = sizeof(PB_Codeword) * (n_swapped_symbols)
- *	PB_IndexEntry index[];				|	c = has_index == TRUE ? sizeof(PB_IndexEntry) * (sequence_length / PB_INDEX_PART_SIZE) : 0
- *	PB_CompressionBuffer stream[];		|	d = VARSIZE(_vl_len) - roundupto8(12 + a + b + c)
+ *	PB_IndexEntry index[];				|	c = has_index == TRUE ? sizeof(PB_IndexEntry) * (sequence_length / index_part_size) : 0
+ *	PB_CompressionBuffer stream[];		|	d = VARSIZE(_vl_len) - roundupto8(12 + h + k + a + b + c) - e
+ *	uint32 composition[][n];			|	e = has_composition == TRUE ? sizeof(uint32) * n * (sequence_length / PB_INDEX_PART_SIZE + 1) : 0
+ *
+ * The composition is stored behind the stream, so the offset of the stream
+ * does not depend on the code. Row k < sequence_length / PB_INDEX_PART_SIZE
+ * holds the number of occurrences of each symbol in the first
+ * (k + 1) * PB_INDEX_PART_SIZE characters, the last row holds the counts
+ * of the whole sequence. Column i belongs to codeword i of the n codewords
+ * of the code, including the fixed ones. Symbols occurring in more than
+ * one codeword are counted in the first of them.
+ *
+ * Sequences encoded with a codebook of the table postbis_codebook are
+ * flagged like fixed codes with the id PB_CODEBOOK_FIXED_ID and store
+ * the id of the codebook behind the hash, see sequence/codebook.h.
  *
  * Pointers to the variable members can be obtained by the following functions:
  * 	Variable member					|	function
  * ----------------------------------------------------------------------------
+ * 	uint32 hash;						|	PB_COMPRESSED_SEQUENCE_HASH_POINTER(seq)
+ * 	uint32 codebook_id;					|	PB_COMPRESSED_SEQUENCE_CODEBOOK_ID_POINTER(seq)
  * 	PB_Codeword symbols[];				|	PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(seq)
  *	PB_Codeword swapped_symbols[];		|	PB_COMPRESSED_SEQUENCE_SWAPPED_SYMBOL_POINTER(seq)
  *	PB_IndexEntry index[];				|	PB_COMPRESSED_SEQUENCE_INDEX_POINTER(seq)
  *	PB_CompressionBuffer stream[];		|	PB_COMPRESSED_SEQUENCE_STREAM_POINTER(seq)
+ *	uint32 composition[][n];			|	PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(seq,VARSIZE(seq),n)
  *
  */
 typedef struct {
@@ -276,27 +309,142 @@ typedef struct {
 	bool has_index : 1;
 	bool is_fixed : 1;
 	bool uses_rle : 1;
-	bool _align1 : 4;
-	uint8 _align2;
+	bool has_composition : 1;
+	uint8 index_part_shift : 3;
+	uint8 version;
 	uint8 data[];
 } PB_CompressedSequence;
 
+/**
+ * Current version of the layout of compressed sequences.
+ *
+ * 	0 : initial layout
+ * 	1 : CRC32 of the sequence is stored in front of the codewords
+ */
+#define PB_COMPRESSED_SEQUENCE_VERSION		1
+
+/**
+ * Flag in the version of sequences, whose stored hash is not valid,
+ * because their symbols were changed in place. The hash is computed
+ * by decoding, as for sequences of version 0.
+ */
+#define PB_COMPRESSED_SEQUENCE_HASH_UNKNOWN	0x80
+
+/**
+ * Version of the layout of a sequence.
+ */
+#define PB_COMPRESSED_SEQUENCE_LAYOUT_VERSION(seq) \
+	(((PB_CompressedSequence*)seq)->version & ~PB_COMPRESSED_SEQUENCE_HASH_UNKNOWN)
+
+/**
+ * TRUE if the stored hash of a sequence is valid.
+ */
+#define PB_COMPRESSED_SEQUENCE_HAS_HASH(seq) \
+	(((PB_CompressedSequence*)seq)->version > 0 && \
+	!(((PB_CompressedSequence*)seq)->version & PB_COMPRESSED_SEQUENCE_HASH_UNKNOWN))
+
+/**
+ * Fixed code id of sequences encoded with a codebook.
+ */
+#define PB_CODEBOOK_FIXED_ID				255
+
+/**
+ * TRUE if a sequence is encoded with a codebook.
+ */
+#define PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(seq) \
+	(((PB_CompressedSequence*)seq)->is_fixed && \
+	((PB_CompressedSequence*)seq)->n_swapped_symbols == PB_CODEBOOK_FIXED_ID)
+
+/**
+ * TRUE if a code set is a codebook.
+ */
+#define PB_CODESET_IS_CODEBOOK(codeset) \
+	((codeset)->is_fixed && (codeset)->fixed_id == PB_CODEBOOK_FIXED_ID)
+
+/**
+ * Size of the header including the stored hash and codebook id.
+ */
+#define PB_COMPRESSED_SEQUENCE_HEADER_SIZE(seq) \
+	(sizeof(PB_CompressedSequence) + \
+	(((PB_CompressedSequence*)seq)->version > 0 ? sizeof(uint32) : 0) + \
+	(PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(seq) ? sizeof(uint32) : 0))
+
+/**
+ * Size of the largest header of the current version.
+ */
+#define PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE \
+	(sizeof(PB_CompressedSequence) + 2 * sizeof(uint32))
+
+/**
+ * Size of the first slice of a sequence, that is detoasted for decoding.
+ * It contains the header, the largest possible code and the first index
+ * entries, but still fits into the first TOAST chunk.
+ */
+#define PB_COMPRESSED_SEQUENCE_PREFIX_SIZE \
+	(PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE + \
+	PB_SOURCE_ALPHABET_SIZE * sizeof(PB_Codeword) + \
+	64 * sizeof(PB_IndexEntry))
+
+/**
+ * Number of characters between index entries
+ */
+#define PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(seq) \
+	(PB_INDEX_PART_SIZE >> ((PB_CompressedSequence*)seq)->index_part_shift)
+
 /**
  * Number of elements in index table
  */
 #define PB_COMPRESSED_SEQUENCE_INDEX_N_ELEMENTS(seq) \
 	(((PB_CompressedSequence*)seq)->has_index ? \
-	(((PB_CompressedSequence*)seq)->sequence_length / PB_INDEX_PART_SIZE) : 0)
+	(((PB_CompressedSequence*)seq)->sequence_length / PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(seq)) : 0)
+
+/**
+ * Returns the offset of the index entry for a position, or (-1),
+ * if decoding has to start at the beginning of the stream.
+ * The index entry k points to position (k + 1) * index_part_size - 1.
+ */
+#define PB_COMPRESSED_SEQUENCE_INDEX_ENTRY_OFFSET(seq, position) \
+	((((PB_CompressedSequence*)seq)->has_index && \
+	((position) + 1) >= PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(seq)) ? \
+	(int)(PB_COMPRESSED_SEQUENCE_HEADER_SIZE(seq) + \
+	((PB_CompressedSequence*)seq)->n_symbols * sizeof(PB_Codeword) + \
+	(((position) + 1) / PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(seq) - 1) * sizeof(PB_IndexEntry)) : \
+	-1)
 
 /**
  * Returns the identifier of the employed fixed code. If
- * a sequence specific code is included it returns (-1).
+ * a sequence specific code or a codebook is used it returns (-1).
  */
 #define PB_COMPRESSED_SEQUENCE_FIXED_CODE_ID(seq) \
-	(((PB_CompressedSequence*)seq)->is_fixed ? \
+	((((PB_CompressedSequence*)seq)->is_fixed && \
+	!PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(seq)) ? \
 	((PB_CompressedSequence*)seq)->n_swapped_symbols : \
 	-1)
 
+/**
+ * Returns a (uint32*) pointer to the stored hash of the sequence.
+ * Returns NULL for sequences of version 0.
+ */
+#define PB_COMPRESSED_SEQUENCE_HASH_POINTER(seq) \
+	(((PB_CompressedSequence*)seq)->version > 0 ? \
+	((uint32*)(((PB_CompressedSequence*)seq)->data)) : \
+	NULL)
+
+/**
+ * Returns a (uint32*) pointer to the id of the codebook of
+ * the sequence. Returns NULL if no codebook is used.
+ */
+#define PB_COMPRESSED_SEQUENCE_CODEBOOK_ID_POINTER(seq) \
+	(PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(seq) ? \
+	((uint32*)(((PB_CompressedSequence*)seq)->data + sizeof(uint32))) : \
+	NULL)
+
+/**
+ * Returns a (uint8*) pointer to the variable part after the header.
+ */
+#define PB_COMPRESSED_SEQUENCE_DATA_POINTER(seq) \
+	(((uint8*) seq) + PB_COMPRESSED_SEQUENCE_HEADER_SIZE(seq))
+
 /**
  * Returns a (PB_Codeword*) pointer to sequence specific
  * codewords. Returns NULL if a fixed code was used.
@@ -304,7 +452,7 @@ typedef struct {
 #define PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(seq) \
 	((((PB_CompressedSequence*)seq)->is_fixed) ? \
 	NULL : \
-	((PB_Codeword*)(((PB_CompressedSequence*)seq)->data)))
+	((PB_Codeword*)PB_COMPRESSED_SEQUENCE_DATA_POINTER(seq)))
 
 /**
  * Returns a (PB_Codeword*) pointer to sequence specific
@@ -314,7 +462,7 @@ typedef struct {
 	(((((PB_CompressedSequence*)seq)->is_fixed) || \
 	((((PB_CompressedSequence*)seq)->n_swapped_symbols) == 0)) ? \
 	NULL : \
-	(((PB_Codeword*)(((PB_CompressedSequence*)seq)->data)) \
+	(((PB_Codeword*)PB_COMPRESSED_SEQUENCE_DATA_POINTER(seq)) \
 	+ (((PB_CompressedSequence*)seq)->n_symbols - ((PB_CompressedSequence*)seq)->n_swapped_symbols)))
 
 /**
@@ -324,7 +472,7 @@ typedef struct {
 #define PB_COMPRESSED_SEQUENCE_INDEX_POINTER(seq) \
 	(((((PB_CompressedSequence*)seq)->has_index) == FALSE) ? \
 	NULL : \
-	((PB_IndexEntry*)(((PB_Codeword*)(((PB_CompressedSequence*)seq)->data)) \
+	((PB_IndexEntry*)(((PB_Codeword*)PB_COMPRESSED_SEQUENCE_DATA_POINTER(seq)) \
 	+ ((PB_CompressedSequence*)seq)->n_symbols)))
 
 /**
@@ -332,7 +480,7 @@ typedef struct {
  */
 #define PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(seq) \
 	(PB_ALIGN_BYTE_SIZE(( \
-	sizeof(PB_CompressedSequence) + \
+	PB_COMPRESSED_SEQUENCE_HEADER_SIZE(seq) + \
 	((PB_CompressedSequence*)seq)->n_symbols * sizeof(PB_Codeword) + \
 	PB_COMPRESSED_SEQUENCE_INDEX_N_ELEMENTS(seq) * sizeof(PB_IndexEntry))))
 
@@ -345,6 +493,37 @@ typedef struct {
 	(((uint8*) seq) + \
 	PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(seq)))
 
+/**
+ * Number of rows of the composition of a sequence.
+ */
+#define PB_COMPOSITION_N_ROWS(sequence_length) \
+	((sequence_length) / PB_INDEX_PART_SIZE + 1)
+
+/**
+ * Size of the composition of a new sequence with a code of
+ * n_symbols codewords.
+ */
+#define PB_COMPOSITION_SIZE(sequence_length, n_symbols) \
+	((sequence_length) >= PB_COMPOSITION_MIN_LENGTH ? \
+	PB_COMPOSITION_N_ROWS(sequence_length) * (n_symbols) * sizeof(uint32) : \
+	0)
+
+/**
+ * Size of the composition stored in a sequence with a code of
+ * n_symbols codewords.
+ */
+#define PB_COMPRESSED_SEQUENCE_COMPOSITION_SIZE(seq, n_symbols) \
+	(((PB_CompressedSequence*)seq)->has_composition ? \
+	PB_COMPOSITION_N_ROWS(((PB_CompressedSequence*)seq)->sequence_length) * (n_symbols) * sizeof(uint32) : \
+	0)
+
+/**
+ * Returns the offset of the composition in a sequence of raw_size
+ * bytes with a code of n_symbols codewords.
+ */
+#define PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(seq, raw_size, n_symbols) \
+	((raw_size) - PB_COMPRESSED_SEQUENCE_COMPOSITION_SIZE(seq, n_symbols))
+
 /**
  * Checks if a codeset can encode a given sequence.
  */
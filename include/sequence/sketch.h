@@ -0,0 +1,121 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/sketch.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_SKETCH_H_
+#define SEQUENCE_SKETCH_H_
+
+#include "sequence/sequence.h"
+
+/**
+ * Maximum length of sketched k-mers, a k-mer is packed with 2 bits
+ * per nucleotide into a uint64.
+ */
+#define PB_SKETCH_MAX_KMER_LENGTH	32
+
+/**
+ * Maximum number of hashes of a sketch
+ */
+#define PB_SKETCH_MAX_SIZE			100000
+
+/**
+ * Set in flags of a signature, the GiST key of sketches.
+ */
+#define PB_SKETCH_SIGNATURE			0x01
+
+/**
+ * Bits of a signature.
+ */
+#define PB_SKETCH_SIGNATURE_BITS	4096
+#define PB_SKETCH_SIGNATURE_WORDS	(PB_SKETCH_SIGNATURE_BITS / 64)
+
+/*
+ * A bottom-s MinHash sketch of the canonical k-mers of a nucleotide
+ * sequence, as used by Mash. It holds the smallest distinct hashes of
+ * the k-mers, a k-mer and its reverse complement hash the same.
+ *
+ *	uint32 _vl_len		:	pgsql specific 4-byte length field; must only be set and get
+ *							with pgsqls macros SET_VARSIZE() and VARSIZE()
+ *	uint8 k				:	length of the k-mers
+ *	uint8 flags			:	PB_SKETCH_SIGNATURE or 0
+ *	uint16 unused		:	reserved, 0
+ *	uint32 size			:	maximum number of hashes
+ *	uint32 n_hashes		:	number of hashes, less than size only for
+ *							sequences with less distinct k-mers
+ *	uint64 data[]		:	hashes ascending
+ *
+ * Signatures have the same header, k is the largest and n_hashes the
+ * smallest of the summarized sketches. data holds PB_SKETCH_SIGNATURE_WORDS
+ * words, the bit of each hash is set.
+ */
+typedef struct {
+	uint32 _vl_len;
+	uint8 k;
+	uint8 flags;
+	uint16 unused;
+	uint32 size;
+	uint32 n_hashes;
+	uint64 data[];
+} PB_Sketch;
+
+#define PB_SKETCH_HEADER_SIZE	offsetof(PB_Sketch, data)
+
+#define PB_SKETCH_SIGNATURE_BIT(hash) \
+	((hash) % PB_SKETCH_SIGNATURE_BITS)
+
+/**
+ * sequence_sketch()
+ * 		Computes the sketch of a sequence. The sequence is decoded chunk
+ * 		by chunk, the hashes of the canonical k-mers are rolled along.
+ * 		k-mers containing other symbols than A, C, G, T and U are skipped.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	int k : length of k-mers, at most PB_SKETCH_MAX_KMER_LENGTH
+ * 	int size : maximum number of hashes, at most PB_SKETCH_MAX_SIZE
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_Sketch* sequence_sketch(Varlena* raw_seq, int k, int size, PB_CodeSet** fixed_codesets);
+
+/**
+ * sketch_shared_hashes()
+ * 		Counts the shared hashes among the smallest hashes of the union of
+ * 		two sketches. Returns the number of these hashes, which is the
+ * 		smaller n_hashes of both.
+ *
+ * 	PB_Sketch* a : detoasted sketch
+ * 	PB_Sketch* b : detoasted sketch of the same k
+ * 	uint32* n_shared : set to the number of shared hashes
+ */
+uint32 sketch_shared_hashes(const PB_Sketch* a, const PB_Sketch* b, uint32* n_shared);
+
+/**
+ * sketch_jaccard()
+ * 		Estimates the Jaccard index of the k-mer sets of two sketches.
+ * 		Sketches without hashes share nothing.
+ *
+ * 	PB_Sketch* a : detoasted sketch
+ * 	PB_Sketch* b : detoasted sketch of the same k
+ */
+double sketch_jaccard(const PB_Sketch* a, const PB_Sketch* b);
+
+/**
+ * jaccard_to_mash_distance()
+ * 		Converts a Jaccard index to the Mash distance, an estimate of the
+ * 		mutation rate between two sequences. It is 1 for sequences
+ * 		without shared k-mers.
+ *
+ * 	double jaccard : estimated Jaccard index
+ * 	int k : length of the k-mers
+ */
+double jaccard_to_mash_distance(double jaccard, int k);
+
+#endif /* SEQUENCE_SKETCH_H_ */
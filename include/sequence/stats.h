@@ -48,6 +48,29 @@ void collect_alphabet(uint32* frequencies,
  */
 void check_ascii(PB_SequenceInfo* sequence_info);
 
+/**
+ * count_symbols()
+ * 		Adds the symbol frequencies of an input to a histogram.
+ *
+ * 	uint8* input : input sequence
+ * 	uint32 length : length of the input sequence
+ * 	uint32* frequencies : histogram to add to
+ */
+void count_symbols(const uint8* input,
+				   uint32 length,
+				   uint32* frequencies);
+
+/**
+ * complete_sequence_info()
+ * 		Derives alphabet and ASCII bitmaps from the frequencies collected
+ * 		in a sequence info. Needed, if the frequencies were not collected
+ * 		by one of the get_sequence_info_??? functions.
+ *
+ * 	PB_SequenceInfo* info : info with sequence length, ignore_case and
+ * 							frequencies set
+ */
+void complete_sequence_info(PB_SequenceInfo* info);
+
 /**
  * get_sequence_info_??? will treat upper and lower case characters as different.
  */
@@ -0,0 +1,110 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/transfer.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_TRANSFER_H_
+#define SEQUENCE_TRANSFER_H_
+
+#include "sequence/sequence.h"
+#include "lib/stringinfo.h"
+
+/*
+ * External binary representation of compressed sequences
+ *
+ * The send functions of the sequence types transmit the code and the
+ * compressed stream of a sequence instead of its characters. The
+ * substring index and the composition are rebuilt by the receiver, so
+ * they are not transmitted. All integers are in network byte order.
+ *
+ * 	Member							|	size
+ * ----------------------------------------------------------------------------
+ * 	uint8 format_version			|	1, PB_TRANSFER_FORMAT_VERSION
+ * 	uint8 flags						|	1, PB_TRANSFER_FLAG_*
+ * 	uint8 index_part_shift			|	1, 0 to PB_MAX_INDEX_PART_SHIFT
+ * 	uint32 sequence_length			|	4
+ * 	uint32 crc32					|	4, CRC32 of the decoded sequence
+ * 	uint8 fixed_id					|	1, only with PB_TRANSFER_FLAG_FIXED
+ * 	uint8 n_symbols					|	1, only without PB_TRANSFER_FLAG_FIXED
+ * 	uint8 n_swapped_symbols			|	1, only without PB_TRANSFER_FLAG_FIXED
+ * 	codeword words[n_symbols]		|	3 * n_symbols, only without PB_TRANSFER_FLAG_FIXED
+ * 	uint32 n_blocks					|	4
+ * 	uint64 stream[n_blocks]			|	8 * n_blocks
+ *
+ * Each codeword consists of its symbol, the length of its code in bits
+ * and the code itself, left-aligned in a byte. The first n_symbols -
+ * n_swapped_symbols codewords form the main code, the others the swap
+ * code. The symbol of the first codeword of the swap code is called the
+ * master symbol. Fixed codes are identified by the position of the code
+ * in the list of fixed codes of the type, e.g. get_fixed_dna_code().
+ *
+ * Decoding
+ *
+ * The stream is read bit by bit, starting at the most significant bit
+ * of the first block, until sequence_length characters are decoded:
+ *
+ * 	1. If the code has swapped symbols, the stream starts with a 16 bit
+ * 	   swap counter.
+ * 	2. The next codeword of the main code is read. That is the only
+ * 	   codeword, whose code equals the next code_length bits.
+ * 	3. If its symbol is the master symbol, and the swap counter is zero,
+ * 	   the symbol is replaced by the one of the next codeword of the swap
+ * 	   code, and the swap counter is set to the next 16 bits. If the swap
+ * 	   counter is not zero, it is decremented.
+ * 	4. With PB_TRANSFER_FLAG_RLE, a symbol 0x1A is followed by an 8 bit
+ * 	   run-length r and another symbol read like in steps 2 and 3. This
+ * 	   symbol is repeated r + 8 times.
+ * 	5. Any other symbol is a character of the sequence.
+ *
+ * Codes with equal length codewords, neither swapped symbols nor RLE
+ * pack the characters, e.g. 32 characters of the DNA four-letter code
+ * fill one block. Unused bits at the end of the stream are zero.
+ */
+
+/**
+ * Current version of the external binary representation.
+ */
+#define PB_TRANSFER_FORMAT_VERSION	1
+
+/**
+ * Flags of the external binary representation.
+ */
+#define PB_TRANSFER_FLAG_FIXED			0x01
+#define PB_TRANSFER_FLAG_EQUAL_LENGTH	0x02
+#define PB_TRANSFER_FLAG_RLE			0x04
+
+/**
+ * send_sequence()
+ * 		Writes the external binary representation of a sequence.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+bytea* send_sequence(Varlena* raw_seq, PB_CodeSet** fixed_codesets);
+
+/**
+ * receive_sequence()
+ * 		Reads the external binary representation of a sequence.
+ *
+ * 	The stream is decoded with bounds checks and verified against the
+ * 	CRC32. The characters are then encoded again with the transmitted
+ * 	code, so no statistics have to be collected and no code has to be
+ * 	built. Invalid input raises an error.
+ *
+ * 	StringInfo buf : message buffer
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ * 	unsigned int n_fixed_codesets : number of fixed codes
+ */
+PB_CompressedSequence* receive_sequence(StringInfo buf,
+										PB_CodeSet** fixed_codesets,
+										unsigned int n_fixed_codesets);
+
+#endif /* SEQUENCE_TRANSFER_H_ */
@@ -0,0 +1,101 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/sequence/translation.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef SEQUENCE_TRANSLATION_H_
+#define SEQUENCE_TRANSLATION_H_
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "sequence/sequence.h"
+
+/**
+ * Number of codons, i.e. the length of a translation table.
+ */
+#define PB_N_CODONS				64
+
+/**
+ * Amino acid of codons with other symbols than nucleotides.
+ */
+#define PB_UNKNOWN_AMINO_ACID	'X'
+
+/**
+ * Amino acid of stop codons in translation tables.
+ */
+#define PB_STOP_CODON			'*'
+
+/**
+ * A validated translation table. Codons are numbered 16 * first +
+ * 4 * second + third nucleotide, where U (or T) is 0, C is 1, A is 2
+ * and G is 3. This is the order of the tables returned by
+ * standard_code() and get_transl_table().
+ */
+typedef struct {
+	uint8 amino_acids[PB_N_CODONS];
+} PB_TranslationTable;
+
+/**
+ * get_translation_table()
+ * 		Validates a translation table given as text of 64 characters.
+ *
+ * 	The last table is cached in fn_extra, so it is validated only once
+ * 	per call site. Without flinfo, e.g. in set-returning functions, that
+ * 	use fn_extra themselves, the table is allocated in the current
+ * 	memory context.
+ *
+ * 	FmgrInfo* flinfo : function call info or NULL
+ * 	text* table : translation table
+ */
+PB_TranslationTable* get_translation_table(FmgrInfo* flinfo, text* table);
+
+/**
+ * translate_sequence()
+ * 		Translates a nucleotide sequence up to its first stop codon.
+ * 		Returns the number of amino acids written to output.
+ *
+ * 	Codes of four equal length codewords, e.g. the four-letter code,
+ * 	are translated codon by codon from the stream, any other code is
+ * 	decoded window by window. Decoding stops at the first stop codon.
+ *
+ * 	Varlena* raw_seq : possibly toasted DNA or RNA sequence
+ * 	PB_TranslationTable* table : translation table
+ * 	uint8* output : space for sequence_length / 3 amino acids
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+uint32 translate_sequence(Varlena* raw_seq,
+						  const PB_TranslationTable* table,
+						  uint8* output,
+						  PB_CodeSet** fixed_codesets);
+
+/**
+ * translate_six_frames()
+ * 		Translates all six reading frames of a nucleotide sequence,
+ * 		including stop codons.
+ *
+ * 	Frames 0 to 2 start at the first, second and third nucleotide of the
+ * 	sequence, frames 3 to 5 at the first, second and third nucleotide of
+ * 	its reverse complement. Frame k holds (sequence_length - k % 3) / 3
+ * 	amino acids. The sequence is read only once.
+ *
+ * 	Varlena* raw_seq : possibly toasted DNA or RNA sequence
+ * 	PB_TranslationTable* table : translation table
+ * 	uint8** frames : six outputs of sequence_length / 3 + 1 bytes each,
+ * 					 which are null-terminated
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+void translate_six_frames(Varlena* raw_seq,
+						  const PB_TranslationTable* table,
+						  uint8** frames,
+						  PB_CodeSet** fixed_codesets);
+
+#endif /* SEQUENCE_TRANSLATION_H_ */
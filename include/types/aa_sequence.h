@@ -31,6 +31,7 @@
 typedef struct {
 	uint32 case_sensitive : 1;
 	uint32 restricting_alphabet : 2;
+	uint32 index_part_shift : 3;
 } PB_AaSequenceTypMod;
 
 #define PB_AA_TYPMOD_CASE_INSENSITIVE 0
@@ -205,6 +206,24 @@ Datum aa_sequence_out (PG_FUNCTION_ARGS);
  */
 Datum aa_sequence_out_varlena (PG_FUNCTION_ARGS);
 
+/**
+ * aa_sequence_send()
+ * 		Convert a sequence to its external binary representation.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+Datum aa_sequence_send (PG_FUNCTION_ARGS);
+
+/**
+ * aa_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+Datum aa_sequence_recv (PG_FUNCTION_ARGS);
+
 /**
  * aa_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -322,10 +341,34 @@ Datum hash_aa(PG_FUNCTION_ARGS);
  */
 Datum strpos_aa(PG_FUNCTION_ARGS);
 
+/**
+ * strpos_aa_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+Datum strpos_aa_seq(PG_FUNCTION_ARGS);
+
 /**
  * octet_length_aa()
  * 		Returns byte size of datum.
  */
 Datum octet_length_aa(PG_FUNCTION_ARGS);
 
+/**
+ * symbol_count_aa()
+ * 		Counts the occurrences of symbols in an AA sequence.
+ */
+Datum symbol_count_aa(PG_FUNCTION_ARGS);
+
+/**
+ * concat_aa()
+ * 		Concatenates two AA sequences.
+ */
+Datum concat_aa(PG_FUNCTION_ARGS);
+
+/**
+ * overlay_aa()
+ * 		Replaces characters of a AA sequence.
+ */
+Datum overlay_aa(PG_FUNCTION_ARGS);
+
 #endif /* TYPES_AA_SEQUENCE_H_ */
@@ -32,6 +32,7 @@
 typedef struct {
 	uint32 case_sensitive : 1;
 	uint32 restricting_alphabet : 2;
+	uint32 compression_strategy : 1;
 } PB_AlignedAaSequenceTypMod;
 
 #define PB_ALIGNED_AA_TYPMOD_CASE_INSENSITIVE 0
@@ -40,6 +41,14 @@ typedef struct {
 #define PB_ALIGNED_AA_TYPMOD_IUPAC			0
 #define PB_ALIGNED_AA_TYPMOD_ASCII			1
 
+/**
+ * DEFAULT run-length encodes runs of equal symbols, mostly gaps in
+ * multiple sequence alignments, if that is shorter. SHORT skips
+ * counting runs, which does not pay off for short rows.
+ */
+#define PB_ALIGNED_AA_TYPMOD_DEFAULT		0
+#define PB_ALIGNED_AA_TYPMOD_SHORT			1
+
 /**
  * aligned_aa_sequence_typmod_to_int()
  * 		Convert from PB_AlignedAaSequenceTypMod to int
@@ -187,6 +196,24 @@ Datum aligned_aa_sequence_out (PG_FUNCTION_ARGS);
  */
 Datum aligned_aa_sequence_out_varlena (PG_FUNCTION_ARGS);
 
+/**
+ * aligned_aa_sequence_send()
+ * 		Convert a sequence to its external binary representation.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+Datum aligned_aa_sequence_send (PG_FUNCTION_ARGS);
+
+/**
+ * aligned_aa_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+Datum aligned_aa_sequence_recv (PG_FUNCTION_ARGS);
+
 /**
  * aligned_aa_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -304,10 +331,34 @@ Datum hash_aligned_aa(PG_FUNCTION_ARGS);
  */
 Datum strpos_aligned_aa(PG_FUNCTION_ARGS);
 
+/**
+ * strpos_aligned_aa_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+Datum strpos_aligned_aa_seq(PG_FUNCTION_ARGS);
+
 /**
  * octet_length_aligned_aa()
  * 		Returns byte size of datum.
  */
 Datum octet_length_aligned_aa(PG_FUNCTION_ARGS);
 
+/**
+ * symbol_count_aligned_aa()
+ * 		Counts the occurrences of symbols in an aligned AA sequence.
+ */
+Datum symbol_count_aligned_aa(PG_FUNCTION_ARGS);
+
+/**
+ * concat_aligned_aa()
+ * 		Concatenates two aligned AA sequences.
+ */
+Datum concat_aligned_aa(PG_FUNCTION_ARGS);
+
+/**
+ * overlay_aligned_aa()
+ * 		Replaces characters of a aligned AA sequence.
+ */
+Datum overlay_aligned_aa(PG_FUNCTION_ARGS);
+
 #endif /* TYPES_ALIGNED_AA_SEQUENCE_H_ */
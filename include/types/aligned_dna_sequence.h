@@ -28,6 +28,7 @@
 typedef struct {
 	uint32 case_sensitive : 1;
 	uint32 restricting_alphabet : 2;
+	uint32 compression_strategy : 1;
 } PB_AlignedDnaSequenceTypMod;
 
 #define PB_ALIGNED_DNA_TYPMOD_CASE_INSENSITIVE	0
@@ -37,6 +38,14 @@ typedef struct {
 #define PB_ALIGNED_DNA_TYPMOD_FLC			1
 #define PB_ALIGNED_DNA_TYPMOD_ASCII			2
 
+/**
+ * DEFAULT run-length encodes runs of equal symbols, mostly gaps in
+ * multiple sequence alignments, if that is shorter. SHORT skips
+ * counting runs, which does not pay off for short rows.
+ */
+#define PB_ALIGNED_DNA_TYPMOD_DEFAULT		0
+#define PB_ALIGNED_DNA_TYPMOD_SHORT			1
+
 /*
  * Section 2 - public functions
  */
@@ -194,6 +203,24 @@ Datum aligned_dna_sequence_out (PG_FUNCTION_ARGS);
  */
 Datum aligned_dna_sequence_out_varlena (PG_FUNCTION_ARGS);
 
+/**
+ * aligned_dna_sequence_send()
+ * 		Convert a sequence to its external binary representation.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+Datum aligned_dna_sequence_send (PG_FUNCTION_ARGS);
+
+/**
+ * aligned_dna_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+Datum aligned_dna_sequence_recv (PG_FUNCTION_ARGS);
+
 /**
  * aligned_dna_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -326,10 +353,34 @@ Datum hash_aligned_dna(PG_FUNCTION_ARGS);
  */
 Datum strpos_aligned_dna(PG_FUNCTION_ARGS);
 
+/**
+ * strpos_aligned_dna_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+Datum strpos_aligned_dna_seq(PG_FUNCTION_ARGS);
+
 /**
  * octet_length_aligned_dna()
  * 		Returns byte size of datum.
  */
 Datum octet_length_aligned_dna(PG_FUNCTION_ARGS);
 
+/**
+ * symbol_count_aligned_dna()
+ * 		Counts the occurrences of symbols in an aligned DNA sequence.
+ */
+Datum symbol_count_aligned_dna(PG_FUNCTION_ARGS);
+
+/**
+ * concat_aligned_dna()
+ * 		Concatenates two aligned DNA sequences.
+ */
+Datum concat_aligned_dna(PG_FUNCTION_ARGS);
+
+/**
+ * overlay_aligned_dna()
+ * 		Replaces characters of a aligned DNA sequence.
+ */
+Datum overlay_aligned_dna(PG_FUNCTION_ARGS);
+
 #endif /* TYPES_ALIGNED_DNA_SEQUENCE_H_ */
@@ -29,6 +29,7 @@
 typedef struct {
 	uint32 case_sensitive : 1;
 	uint32 restricting_alphabet : 2;
+	uint32 compression_strategy : 1;
 } PB_AlignedRnaSequenceTypMod;
 
 #define PB_ALIGNED_RNA_TYPMOD_CASE_INSENSITIVE 0
@@ -38,6 +39,14 @@ typedef struct {
 #define PB_ALIGNED_RNA_TYPMOD_FLC				1
 #define PB_ALIGNED_RNA_TYPMOD_ASCII			2
 
+/**
+ * DEFAULT run-length encodes runs of equal symbols, mostly gaps in
+ * multiple sequence alignments, if that is shorter. SHORT skips
+ * counting runs, which does not pay off for short rows.
+ */
+#define PB_ALIGNED_RNA_TYPMOD_DEFAULT		0
+#define PB_ALIGNED_RNA_TYPMOD_SHORT			1
+
 /**
  * aligned_rna_sequence_typmod_to_int()
  * 		Convert from PB_AlignedRnaSequenceTypMod to int
@@ -191,6 +200,24 @@ Datum aligned_rna_sequence_out (PG_FUNCTION_ARGS);
  */
 Datum aligned_rna_sequence_out_varlena (PG_FUNCTION_ARGS);
 
+/**
+ * aligned_rna_sequence_send()
+ * 		Convert a sequence to its external binary representation.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+Datum aligned_rna_sequence_send (PG_FUNCTION_ARGS);
+
+/**
+ * aligned_rna_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+Datum aligned_rna_sequence_recv (PG_FUNCTION_ARGS);
+
 /**
  * aligned_rna_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -324,10 +351,34 @@ Datum hash_aligned_rna(PG_FUNCTION_ARGS);
  */
 Datum strpos_aligned_rna(PG_FUNCTION_ARGS);
 
+/**
+ * strpos_aligned_rna_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+Datum strpos_aligned_rna_seq(PG_FUNCTION_ARGS);
+
 /**
  * octet_length_aligned_rna()
  * 		Returns byte size of datum.
  */
 Datum octet_length_aligned_rna(PG_FUNCTION_ARGS);
 
+/**
+ * symbol_count_aligned_rna()
+ * 		Counts the occurrences of symbols in an aligned RNA sequence.
+ */
+Datum symbol_count_aligned_rna(PG_FUNCTION_ARGS);
+
+/**
+ * concat_aligned_rna()
+ * 		Concatenates two aligned RNA sequences.
+ */
+Datum concat_aligned_rna(PG_FUNCTION_ARGS);
+
+/**
+ * overlay_aligned_rna()
+ * 		Replaces characters of a aligned RNA sequence.
+ */
+Datum overlay_aligned_rna(PG_FUNCTION_ARGS);
+
 #endif /* ALIGNED_RNA_SEQUENCE_H_ */
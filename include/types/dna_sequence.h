@@ -36,6 +36,7 @@ typedef struct {
 	uint32 case_sensitive : 1;
 	uint32 restricting_alphabet : 2;
 	uint32 compression_strategy : 2;
+	uint32 index_part_shift : 3;
 } PB_DnaSequenceTypMod;
 
 #define PB_DNA_TYPMOD_CASE_INSENSITIVE 0
@@ -49,6 +50,19 @@ typedef struct {
 #define PB_DNA_TYPMOD_SHORT			1
 #define PB_DNA_TYPMOD_REFERENCE		2
 
+/**
+ * Sequences with these type modifiers are compressed
+ * by compress_flc_dna_sequence().
+ */
+#define PB_DNA_TYPMOD_IS_FLC_CASE_INSENSITIVE(typmod) \
+	((typmod).restricting_alphabet == PB_DNA_TYPMOD_FLC && \
+	 (typmod).case_sensitive == PB_DNA_TYPMOD_CASE_INSENSITIVE)
+
+/**
+ * Type modifier used for sequences without type modifiers
+ */
+extern PB_DnaSequenceTypMod non_restricting_dna_typmod;
+
 /*
  * Section 2 - public functions
  */
@@ -69,6 +83,15 @@ int dna_sequence_typmod_to_int(PB_DnaSequenceTypMod typmod);
  */
 PB_DnaSequenceTypMod int_to_dna_sequence_typmod(int typmod);
 
+/**
+ * text_to_dna_sequence_typmod()
+ * 		Converts comma-separated type modifiers, as written in
+ * 		dna_sequence(...), to the type modifier structure.
+ *
+ * 	text* modifiers : e.g. 'REFERENCE, CASE_SENSITIVE', may be empty
+ */
+PB_DnaSequenceTypMod text_to_dna_sequence_typmod(text* modifiers);
+
 /**
  * get_fixed_dna_code()
  * 		Returns a fixed code for the specified id.
@@ -124,6 +147,19 @@ PB_CompressedSequence* compress_dna_sequence(uint8* input,
 											 PB_DnaSequenceTypMod typmod,
 											 PB_SequenceInfo* info);
 
+/**
+ * compress_flc_dna_sequence()
+ * 		Compress a DNA sequence with type modifiers FLC and
+ * 		CASE_INSENSITIVE, collecting statistics while encoding.
+ *
+ * 	uint8* input : unterminated or null-terminated input sequence
+ * 	uint32 length : length of the input sequence
+ * 	PB_DnaSequenceTypMod typmod : target type modifier
+ */
+PB_CompressedSequence* compress_flc_dna_sequence(uint8* input,
+												 uint32 length,
+												 PB_DnaSequenceTypMod typmod);
+
 /**
  * decompress_dna_sequence()
  * 		Decompress a DNA sequence
@@ -138,6 +174,15 @@ void decompress_dna_sequence(PB_CompressedSequence* input,
 							 uint32 from_position,
 							 uint32 length);
 
+/**
+ * complement_dna_symbol()
+ * 		Returns the complement of a nucleotide, including IUPAC codes
+ * 		and lower case. Other symbols are returned unchanged.
+ *
+ * 	uint8 symbol : nucleotide
+ */
+uint8 complement_dna_symbol(uint8 symbol);
+
 /*
  * Section 3 - Interface functions for pgsql
  *
@@ -221,6 +266,24 @@ Datum dna_sequence_out (PG_FUNCTION_ARGS);
  */
 Datum dna_sequence_out_varlena (PG_FUNCTION_ARGS);
 
+/**
+ * dna_sequence_send()
+ * 		Convert a sequence to its external binary representation.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+Datum dna_sequence_send (PG_FUNCTION_ARGS);
+
+/**
+ * dna_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+Datum dna_sequence_recv (PG_FUNCTION_ARGS);
+
 /**
  * dna_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -354,10 +417,40 @@ Datum hash_dna(PG_FUNCTION_ARGS);
  */
 Datum strpos_dna(PG_FUNCTION_ARGS);
 
+/**
+ * strpos_dna_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+Datum strpos_dna_seq(PG_FUNCTION_ARGS);
+
 /**
  * octet_length_dna()
  * 		Returns byte size of datum.
  */
 Datum octet_length_dna(PG_FUNCTION_ARGS);
 
+/**
+ * symbol_count_dna()
+ * 		Counts the occurrences of symbols in a DNA sequence.
+ */
+Datum symbol_count_dna(PG_FUNCTION_ARGS);
+
+/**
+ * gc_content_dna()
+ * 		Returns the fraction of G and C in a DNA sequence.
+ */
+Datum gc_content_dna(PG_FUNCTION_ARGS);
+
+/**
+ * concat_dna()
+ * 		Concatenates two DNA sequences.
+ */
+Datum concat_dna(PG_FUNCTION_ARGS);
+
+/**
+ * overlay_dna()
+ * 		Replaces characters of a DNA sequence.
+ */
+Datum overlay_dna(PG_FUNCTION_ARGS);
+
 #endif /* TYPES_DNA_SEQUENCE_H_ */
@@ -32,6 +32,7 @@
 typedef struct {
 	uint32 case_sensitive : 1;
 	uint32 restricting_alphabet : 2;
+	uint32 index_part_shift : 3;
 } PB_RnaSequenceTypMod;
 
 #define PB_RNA_TYPMOD_CASE_INSENSITIVE 0
@@ -206,6 +207,24 @@ Datum rna_sequence_out (PG_FUNCTION_ARGS);
  */
 Datum rna_sequence_out_varlena (PG_FUNCTION_ARGS);
 
+/**
+ * rna_sequence_send()
+ * 		Convert a sequence to its external binary representation.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+Datum rna_sequence_send (PG_FUNCTION_ARGS);
+
+/**
+ * rna_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+Datum rna_sequence_recv (PG_FUNCTION_ARGS);
+
 /**
  * rna_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -339,10 +358,40 @@ Datum hash_rna(PG_FUNCTION_ARGS);
  */
 Datum strpos_rna(PG_FUNCTION_ARGS);
 
+/**
+ * strpos_rna_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+Datum strpos_rna_seq(PG_FUNCTION_ARGS);
+
 /**
  * octet_length_rna()
  * 		Returns byte size of datum.
  */
 Datum octet_length_rna(PG_FUNCTION_ARGS);
 
+/**
+ * symbol_count_rna()
+ * 		Counts the occurrences of symbols in an RNA sequence.
+ */
+Datum symbol_count_rna(PG_FUNCTION_ARGS);
+
+/**
+ * gc_content_rna()
+ * 		Returns the fraction of G and C in an RNA sequence.
+ */
+Datum gc_content_rna(PG_FUNCTION_ARGS);
+
+/**
+ * concat_rna()
+ * 		Concatenates two RNA sequences.
+ */
+Datum concat_rna(PG_FUNCTION_ARGS);
+
+/**
+ * overlay_rna()
+ * 		Replaces characters of a RNA sequence.
+ */
+Datum overlay_rna(PG_FUNCTION_ARGS);
+
 #endif /* TYPES_RNA_SEQUENCE_H_ */
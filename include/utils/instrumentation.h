@@ -0,0 +1,91 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   include/utils/instrumentation.h
+*
+*-------------------------------------------------------------------------
+*/
+#ifndef UTILS_INSTRUMENTATION_H_
+#define UTILS_INSTRUMENTATION_H_
+
+#include "postgres.h"
+
+/*
+ * Counters of the work done by the compression engine. Unlike the
+ * messages of debug.h they are always compiled, an increment of a
+ * backend local variable is all they cost. They are shown by
+ * postbis_stat() and the view pg_stat_postbis.
+ */
+
+/**
+ * Kinds of codes, the symbols encoded and decoded are counted for.
+ * They correspond to the encoding and decoding functions.
+ */
+#define PB_CODE_KIND_EQUAL_LENGTH	0
+#define PB_CODE_KIND_HUFFMAN		1
+#define PB_CODE_KIND_RLE			2
+#define PB_CODE_KIND_SWAPPED		3
+#define PB_CODE_KIND_SWAPPED_RLE	4
+#define PB_N_CODE_KINDS				5
+
+/**
+ * Kind of a PB_CodeSet.
+ */
+#define PB_CODE_KIND(codeset) \
+	((codeset)->n_swapped_symbols > 0 ? \
+	 ((codeset)->uses_rle ? PB_CODE_KIND_SWAPPED_RLE : PB_CODE_KIND_SWAPPED) : \
+	 ((codeset)->uses_rle ? PB_CODE_KIND_RLE : \
+	  ((codeset)->has_equal_length ? PB_CODE_KIND_EQUAL_LENGTH : PB_CODE_KIND_HUFFMAN)))
+
+/**
+ * Counters of one backend since its start or the last reset.
+ *
+ * 	uint64 symbols_encoded : symbols encoded per kind of code
+ * 	uint64 symbols_decoded : symbols decoded per kind of code
+ * 	uint64 bytes_detoasted : bytes detoasted by detoast cursors
+ * 	uint64 bytes_read : bytes read by the decoders through detoast cursors
+ * 	uint64 toast_slice_fetches : slices fetched by detoast cursors
+ * 	uint64 cursor_cache_hits : detoast cursors reused from fn_extra
+ * 	uint64 decoding_map_builds : decoding maps built, i.e. cache misses
+ * 	uint64 huffman_code_builds : huffman trees built for codes
+ * 	uint64 strpos_searches : search states allocated by sequence_strpos()
+ * 	uint64 strpos_state_bytes : bytes of these search states
+ */
+typedef struct {
+	uint64 symbols_encoded[PB_N_CODE_KINDS];
+	uint64 symbols_decoded[PB_N_CODE_KINDS];
+	uint64 bytes_detoasted;
+	uint64 bytes_read;
+	uint64 toast_slice_fetches;
+	uint64 cursor_cache_hits;
+	uint64 decoding_map_builds;
+	uint64 huffman_code_builds;
+	uint64 strpos_searches;
+	uint64 strpos_state_bytes;
+} PB_Counters;
+
+#define PB_N_COUNTERS	(sizeof(PB_Counters) / sizeof(uint64))
+
+extern PB_Counters pb_counters;
+
+/**
+ * Adds n to a counter.
+ */
+#define PB_COUNT(counter, n) \
+	(pb_counters.counter += (n))
+
+/**
+ * init_shared_counters()
+ * 		Requests shared memory for counters of all backends, if the
+ * 		library is loaded through shared_preload_libraries. Otherwise
+ * 		only backend local counters are kept.
+ */
+void init_shared_counters(void);
+
+#endif /* UTILS_INSTRUMENTATION_H_ */
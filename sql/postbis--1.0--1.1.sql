@@ -0,0 +1,1674 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   sql/postbis--1.0--1.1.sql
+*
+*-------------------------------------------------------------------------
+*/
+\echo Use "ALTER EXTENSION postbis UPDATE TO '1.1'" to load this file. \quit
+
+/*
+*	Existing types get their binary input and output by setting receive
+*	and send in pg_type, as CREATE TYPE cannot change a type. The btree
+*	operator families get their sortsupport functions added.
+*/
+
+/*
+*	Type: dna_sequence
+*/
+CREATE FUNCTION dna_sequence_recv(internal, oid, int4)
+  RETURNS dna_sequence
+  AS '$libdir/postbis', 'dna_sequence_recv'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION dna_sequence_send(dna_sequence)
+  RETURNS bytea
+  AS '$libdir/postbis', 'dna_sequence_send'
+  LANGUAGE c IMMUTABLE STRICT;
+
+UPDATE pg_catalog.pg_type
+  SET typreceive = 'dna_sequence_recv'::regproc,
+      typsend = 'dna_sequence_send'::regproc
+  WHERE oid = 'dna_sequence'::regtype;
+
+CREATE FUNCTION sortsupport_dna(internal)
+  RETURNS void AS
+  '$libdir/postbis', 'sortsupport_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+ALTER OPERATOR FAMILY dna_sequence_btree_ops USING btree
+  ADD FUNCTION 2 (dna_sequence, dna_sequence) sortsupport_dna(internal);
+
+CREATE OR REPLACE FUNCTION concat_dna(dna_sequence, dna_sequence)
+  RETURNS dna_sequence AS
+  '$libdir/postbis', 'concat_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(dna_sequence, text, int4)
+  RETURNS dna_sequence AS
+  '$libdir/postbis', 'overlay_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(dna_sequence, text, int4, int4)
+  RETURNS dna_sequence AS
+  '$libdir/postbis', 'overlay_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION strpos(dna_sequence, dna_sequence)
+  RETURNS int4 AS
+  '$libdir/postbis', 'strpos_dna_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION contains_dna(dna_sequence, text)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = dna_sequence,
+  rightarg = text,
+  procedure = contains_dna,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION contains_dna(dna_sequence, dna_sequence)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_dna_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = dna_sequence,
+  rightarg = dna_sequence,
+  procedure = contains_dna,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION gin_extract_value_dna(dna_sequence, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_value_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_extract_query_dna(dna_sequence, internal, int2, internal, internal, internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_query_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_kmer_consistent(internal, int2, dna_sequence, int4, internal, internal, internal, internal)
+  RETURNS bool AS
+  '$libdir/postbis', 'gin_kmer_consistent'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR CLASS dna_sequence_kmer_ops
+  FOR TYPE dna_sequence USING gin AS
+    OPERATOR 1 @> (dna_sequence, text),
+    OPERATOR 2 @> (dna_sequence, dna_sequence),
+    FUNCTION 1 btint8cmp(int8, int8),
+    FUNCTION 2 gin_extract_value_dna(dna_sequence, internal),
+    FUNCTION 3 gin_extract_query_dna(dna_sequence, internal, int2, internal, internal, internal, internal),
+    FUNCTION 4 gin_kmer_consistent(internal, int2, dna_sequence, int4, internal, internal, internal, internal),
+    STORAGE int8;
+
+CREATE FUNCTION symbol_count(dna_sequence, text)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION symbol_count(dna_sequence, text, int4, int4)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION gc_content(dna_sequence)
+  RETURNS real AS
+  '$libdir/postbis', 'gc_content_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gc_content(dna_sequence, int4, int4)
+  RETURNS real AS
+  '$libdir/postbis', 'gc_content_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Type: rna_sequence
+*/
+CREATE FUNCTION rna_sequence_recv(internal, oid, int4)
+  RETURNS rna_sequence
+  AS '$libdir/postbis', 'rna_sequence_recv'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION rna_sequence_send(rna_sequence)
+  RETURNS bytea
+  AS '$libdir/postbis', 'rna_sequence_send'
+  LANGUAGE c IMMUTABLE STRICT;
+
+UPDATE pg_catalog.pg_type
+  SET typreceive = 'rna_sequence_recv'::regproc,
+      typsend = 'rna_sequence_send'::regproc
+  WHERE oid = 'rna_sequence'::regtype;
+
+CREATE FUNCTION sortsupport_rna(internal)
+  RETURNS void AS
+  '$libdir/postbis', 'sortsupport_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+ALTER OPERATOR FAMILY rna_sequence_btree_ops USING btree
+  ADD FUNCTION 2 (rna_sequence, rna_sequence) sortsupport_rna(internal);
+
+CREATE OR REPLACE FUNCTION concat_rna(rna_sequence, rna_sequence)
+  RETURNS rna_sequence AS
+  '$libdir/postbis', 'concat_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(rna_sequence, text, int4)
+  RETURNS rna_sequence AS
+  '$libdir/postbis', 'overlay_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(rna_sequence, text, int4, int4)
+  RETURNS rna_sequence AS
+  '$libdir/postbis', 'overlay_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION strpos(rna_sequence, rna_sequence)
+  RETURNS int4 AS
+  '$libdir/postbis', 'strpos_rna_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION contains_rna(rna_sequence, text)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = rna_sequence,
+  rightarg = text,
+  procedure = contains_rna,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION contains_rna(rna_sequence, rna_sequence)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_rna_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = rna_sequence,
+  rightarg = rna_sequence,
+  procedure = contains_rna,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION gin_extract_value_rna(rna_sequence, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_value_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_extract_query_rna(rna_sequence, internal, int2, internal, internal, internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_query_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_kmer_consistent(internal, int2, rna_sequence, int4, internal, internal, internal, internal)
+  RETURNS bool AS
+  '$libdir/postbis', 'gin_kmer_consistent'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR CLASS rna_sequence_kmer_ops
+  FOR TYPE rna_sequence USING gin AS
+    OPERATOR 1 @> (rna_sequence, text),
+    OPERATOR 2 @> (rna_sequence, rna_sequence),
+    FUNCTION 1 btint8cmp(int8, int8),
+    FUNCTION 2 gin_extract_value_rna(rna_sequence, internal),
+    FUNCTION 3 gin_extract_query_rna(rna_sequence, internal, int2, internal, internal, internal, internal),
+    FUNCTION 4 gin_kmer_consistent(internal, int2, rna_sequence, int4, internal, internal, internal, internal),
+    STORAGE int8;
+
+CREATE FUNCTION symbol_count(rna_sequence, text)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION symbol_count(rna_sequence, text, int4, int4)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION gc_content(rna_sequence)
+  RETURNS real AS
+  '$libdir/postbis', 'gc_content_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gc_content(rna_sequence, int4, int4)
+  RETURNS real AS
+  '$libdir/postbis', 'gc_content_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Type: aa_sequence
+*/
+CREATE FUNCTION aa_sequence_recv(internal, oid, int4)
+  RETURNS aa_sequence
+  AS '$libdir/postbis', 'aa_sequence_recv'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION aa_sequence_send(aa_sequence)
+  RETURNS bytea
+  AS '$libdir/postbis', 'aa_sequence_send'
+  LANGUAGE c IMMUTABLE STRICT;
+
+UPDATE pg_catalog.pg_type
+  SET typreceive = 'aa_sequence_recv'::regproc,
+      typsend = 'aa_sequence_send'::regproc
+  WHERE oid = 'aa_sequence'::regtype;
+
+CREATE FUNCTION sortsupport_aa(internal)
+  RETURNS void AS
+  '$libdir/postbis', 'sortsupport_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+ALTER OPERATOR FAMILY aa_sequence_btree_ops USING btree
+  ADD FUNCTION 2 (aa_sequence, aa_sequence) sortsupport_aa(internal);
+
+CREATE OR REPLACE FUNCTION concat_aa(aa_sequence, aa_sequence)
+  RETURNS aa_sequence AS
+  '$libdir/postbis', 'concat_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(aa_sequence, text, int4)
+  RETURNS aa_sequence AS
+  '$libdir/postbis', 'overlay_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(aa_sequence, text, int4, int4)
+  RETURNS aa_sequence AS
+  '$libdir/postbis', 'overlay_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION strpos(aa_sequence, aa_sequence)
+  RETURNS int4 AS
+  '$libdir/postbis', 'strpos_aa_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION contains_aa(aa_sequence, text)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = aa_sequence,
+  rightarg = text,
+  procedure = contains_aa,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION contains_aa(aa_sequence, aa_sequence)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_aa_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = aa_sequence,
+  rightarg = aa_sequence,
+  procedure = contains_aa,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION gin_extract_value_aa(aa_sequence, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_value_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_extract_query_aa(aa_sequence, internal, int2, internal, internal, internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_query_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_kmer_consistent(internal, int2, aa_sequence, int4, internal, internal, internal, internal)
+  RETURNS bool AS
+  '$libdir/postbis', 'gin_kmer_consistent'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR CLASS aa_sequence_kmer_ops
+  FOR TYPE aa_sequence USING gin AS
+    OPERATOR 1 @> (aa_sequence, text),
+    OPERATOR 2 @> (aa_sequence, aa_sequence),
+    FUNCTION 1 btint8cmp(int8, int8),
+    FUNCTION 2 gin_extract_value_aa(aa_sequence, internal),
+    FUNCTION 3 gin_extract_query_aa(aa_sequence, internal, int2, internal, internal, internal, internal),
+    FUNCTION 4 gin_kmer_consistent(internal, int2, aa_sequence, int4, internal, internal, internal, internal),
+    STORAGE int8;
+
+CREATE FUNCTION symbol_count(aa_sequence, text)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION symbol_count(aa_sequence, text, int4, int4)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION six_frame_translate(sequence rna_sequence, translation_table text DEFAULT standard_code(), OUT frame int4, OUT translation aa_sequence)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'six_frame_translate_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Translation of DNA
+*
+*	DNA is read as the coding strand, i.e. T is translated like U.
+*	translate() stops at the first stop codon. six_frame_translate()
+*	translates all six frames in one pass and keeps stop codons as '*'.
+*/
+CREATE FUNCTION translate(dna_sequence, text)
+  RETURNS aa_sequence AS
+  '$libdir/postbis', 'translate_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION translate(dna_sequence)
+  RETURNS aa_sequence AS $$
+    SELECT translate($1, standard_code());
+  $$ LANGUAGE sql IMMUTABLE STRICT;
+
+CREATE FUNCTION six_frame_translate(sequence dna_sequence, translation_table text DEFAULT standard_code(), OUT frame int4, OUT translation aa_sequence)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'six_frame_translate_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Type: aligned_dna_sequence
+*/
+CREATE FUNCTION aligned_dna_sequence_recv(internal, oid, int4)
+  RETURNS aligned_dna_sequence
+  AS '$libdir/postbis', 'aligned_dna_sequence_recv'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION aligned_dna_sequence_send(aligned_dna_sequence)
+  RETURNS bytea
+  AS '$libdir/postbis', 'aligned_dna_sequence_send'
+  LANGUAGE c IMMUTABLE STRICT;
+
+UPDATE pg_catalog.pg_type
+  SET typreceive = 'aligned_dna_sequence_recv'::regproc,
+      typsend = 'aligned_dna_sequence_send'::regproc
+  WHERE oid = 'aligned_dna_sequence'::regtype;
+
+CREATE FUNCTION sortsupport_aligned_dna(internal)
+  RETURNS void AS
+  '$libdir/postbis', 'sortsupport_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+ALTER OPERATOR FAMILY aligned_dna_sequence_btree_ops USING btree
+  ADD FUNCTION 2 (aligned_dna_sequence, aligned_dna_sequence) sortsupport_aligned_dna(internal);
+
+CREATE OR REPLACE FUNCTION concat_aligned_dna(aligned_dna_sequence, aligned_dna_sequence)
+  RETURNS aligned_dna_sequence AS
+  '$libdir/postbis', 'concat_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(aligned_dna_sequence, text, int4)
+  RETURNS aligned_dna_sequence AS
+  '$libdir/postbis', 'overlay_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(aligned_dna_sequence, text, int4, int4)
+  RETURNS aligned_dna_sequence AS
+  '$libdir/postbis', 'overlay_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION strpos(aligned_dna_sequence, aligned_dna_sequence)
+  RETURNS int4 AS
+  '$libdir/postbis', 'strpos_aligned_dna_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION contains_aligned_dna(aligned_dna_sequence, text)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = aligned_dna_sequence,
+  rightarg = text,
+  procedure = contains_aligned_dna,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION contains_aligned_dna(aligned_dna_sequence, aligned_dna_sequence)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_aligned_dna_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = aligned_dna_sequence,
+  rightarg = aligned_dna_sequence,
+  procedure = contains_aligned_dna,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION gin_extract_value_aligned_dna(aligned_dna_sequence, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_value_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_extract_query_aligned_dna(aligned_dna_sequence, internal, int2, internal, internal, internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_query_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_kmer_consistent(internal, int2, aligned_dna_sequence, int4, internal, internal, internal, internal)
+  RETURNS bool AS
+  '$libdir/postbis', 'gin_kmer_consistent'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR CLASS aligned_dna_sequence_kmer_ops
+  FOR TYPE aligned_dna_sequence USING gin AS
+    OPERATOR 1 @> (aligned_dna_sequence, text),
+    OPERATOR 2 @> (aligned_dna_sequence, aligned_dna_sequence),
+    FUNCTION 1 btint8cmp(int8, int8),
+    FUNCTION 2 gin_extract_value_aligned_dna(aligned_dna_sequence, internal),
+    FUNCTION 3 gin_extract_query_aligned_dna(aligned_dna_sequence, internal, int2, internal, internal, internal, internal),
+    FUNCTION 4 gin_kmer_consistent(internal, int2, aligned_dna_sequence, int4, internal, internal, internal, internal),
+    STORAGE int8;
+
+CREATE FUNCTION symbol_count(aligned_dna_sequence, text)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION symbol_count(aligned_dna_sequence, text, int4, int4)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Type: aligned_rna_sequence
+*/
+CREATE FUNCTION aligned_rna_sequence_recv(internal, oid, int4)
+  RETURNS aligned_rna_sequence
+  AS '$libdir/postbis', 'aligned_rna_sequence_recv'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION aligned_rna_sequence_send(aligned_rna_sequence)
+  RETURNS bytea
+  AS '$libdir/postbis', 'aligned_rna_sequence_send'
+  LANGUAGE c IMMUTABLE STRICT;
+
+UPDATE pg_catalog.pg_type
+  SET typreceive = 'aligned_rna_sequence_recv'::regproc,
+      typsend = 'aligned_rna_sequence_send'::regproc
+  WHERE oid = 'aligned_rna_sequence'::regtype;
+
+CREATE FUNCTION sortsupport_aligned_rna(internal)
+  RETURNS void AS
+  '$libdir/postbis', 'sortsupport_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+ALTER OPERATOR FAMILY aligned_rna_sequence_btree_ops USING btree
+  ADD FUNCTION 2 (aligned_rna_sequence, aligned_rna_sequence) sortsupport_aligned_rna(internal);
+
+CREATE OR REPLACE FUNCTION concat_aligned_rna(aligned_rna_sequence, aligned_rna_sequence)
+  RETURNS aligned_rna_sequence AS
+  '$libdir/postbis', 'concat_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(aligned_rna_sequence, text, int4)
+  RETURNS aligned_rna_sequence AS
+  '$libdir/postbis', 'overlay_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(aligned_rna_sequence, text, int4, int4)
+  RETURNS aligned_rna_sequence AS
+  '$libdir/postbis', 'overlay_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION strpos(aligned_rna_sequence, aligned_rna_sequence)
+  RETURNS int4 AS
+  '$libdir/postbis', 'strpos_aligned_rna_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION contains_aligned_rna(aligned_rna_sequence, text)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = aligned_rna_sequence,
+  rightarg = text,
+  procedure = contains_aligned_rna,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION contains_aligned_rna(aligned_rna_sequence, aligned_rna_sequence)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_aligned_rna_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = aligned_rna_sequence,
+  rightarg = aligned_rna_sequence,
+  procedure = contains_aligned_rna,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION gin_extract_value_aligned_rna(aligned_rna_sequence, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_value_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_extract_query_aligned_rna(aligned_rna_sequence, internal, int2, internal, internal, internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_query_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_kmer_consistent(internal, int2, aligned_rna_sequence, int4, internal, internal, internal, internal)
+  RETURNS bool AS
+  '$libdir/postbis', 'gin_kmer_consistent'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR CLASS aligned_rna_sequence_kmer_ops
+  FOR TYPE aligned_rna_sequence USING gin AS
+    OPERATOR 1 @> (aligned_rna_sequence, text),
+    OPERATOR 2 @> (aligned_rna_sequence, aligned_rna_sequence),
+    FUNCTION 1 btint8cmp(int8, int8),
+    FUNCTION 2 gin_extract_value_aligned_rna(aligned_rna_sequence, internal),
+    FUNCTION 3 gin_extract_query_aligned_rna(aligned_rna_sequence, internal, int2, internal, internal, internal, internal),
+    FUNCTION 4 gin_kmer_consistent(internal, int2, aligned_rna_sequence, int4, internal, internal, internal, internal),
+    STORAGE int8;
+
+CREATE FUNCTION symbol_count(aligned_rna_sequence, text)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION symbol_count(aligned_rna_sequence, text, int4, int4)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Type: aligned_aa_sequence
+*/
+CREATE FUNCTION aligned_aa_sequence_recv(internal, oid, int4)
+  RETURNS aligned_aa_sequence
+  AS '$libdir/postbis', 'aligned_aa_sequence_recv'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION aligned_aa_sequence_send(aligned_aa_sequence)
+  RETURNS bytea
+  AS '$libdir/postbis', 'aligned_aa_sequence_send'
+  LANGUAGE c IMMUTABLE STRICT;
+
+UPDATE pg_catalog.pg_type
+  SET typreceive = 'aligned_aa_sequence_recv'::regproc,
+      typsend = 'aligned_aa_sequence_send'::regproc
+  WHERE oid = 'aligned_aa_sequence'::regtype;
+
+CREATE FUNCTION sortsupport_aligned_aa(internal)
+  RETURNS void AS
+  '$libdir/postbis', 'sortsupport_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+ALTER OPERATOR FAMILY aligned_aa_sequence_btree_ops USING btree
+  ADD FUNCTION 2 (aligned_aa_sequence, aligned_aa_sequence) sortsupport_aligned_aa(internal);
+
+CREATE OR REPLACE FUNCTION concat_aligned_aa(aligned_aa_sequence, aligned_aa_sequence)
+  RETURNS aligned_aa_sequence AS
+  '$libdir/postbis', 'concat_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(aligned_aa_sequence, text, int4)
+  RETURNS aligned_aa_sequence AS
+  '$libdir/postbis', 'overlay_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_overlay(aligned_aa_sequence, text, int4, int4)
+  RETURNS aligned_aa_sequence AS
+  '$libdir/postbis', 'overlay_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION strpos(aligned_aa_sequence, aligned_aa_sequence)
+  RETURNS int4 AS
+  '$libdir/postbis', 'strpos_aligned_aa_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION contains_aligned_aa(aligned_aa_sequence, text)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = aligned_aa_sequence,
+  rightarg = text,
+  procedure = contains_aligned_aa,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION contains_aligned_aa(aligned_aa_sequence, aligned_aa_sequence)
+  RETURNS bool AS
+  '$libdir/postbis', 'contains_aligned_aa_seq'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR @> (
+  leftarg = aligned_aa_sequence,
+  rightarg = aligned_aa_sequence,
+  procedure = contains_aligned_aa,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION gin_extract_value_aligned_aa(aligned_aa_sequence, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_value_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_extract_query_aligned_aa(aligned_aa_sequence, internal, int2, internal, internal, internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gin_extract_query_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gin_kmer_consistent(internal, int2, aligned_aa_sequence, int4, internal, internal, internal, internal)
+  RETURNS bool AS
+  '$libdir/postbis', 'gin_kmer_consistent'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR CLASS aligned_aa_sequence_kmer_ops
+  FOR TYPE aligned_aa_sequence USING gin AS
+    OPERATOR 1 @> (aligned_aa_sequence, text),
+    OPERATOR 2 @> (aligned_aa_sequence, aligned_aa_sequence),
+    FUNCTION 1 btint8cmp(int8, int8),
+    FUNCTION 2 gin_extract_value_aligned_aa(aligned_aa_sequence, internal),
+    FUNCTION 3 gin_extract_query_aligned_aa(aligned_aa_sequence, internal, int2, internal, internal, internal, internal),
+    FUNCTION 4 gin_kmer_consistent(internal, int2, aligned_aa_sequence, int4, internal, internal, internal, internal),
+    STORAGE int8;
+
+CREATE FUNCTION symbol_count(aligned_aa_sequence, text)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION symbol_count(aligned_aa_sequence, text, int4, int4)
+  RETURNS int8 AS
+  '$libdir/postbis', 'symbol_count_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Aggregates
+*/
+CREATE FUNCTION composition_agg_combinefn(internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'composition_agg_combinefn'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION composition_agg_serialfn(internal)
+  RETURNS bytea AS
+  '$libdir/postbis', 'composition_agg_serialfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION composition_agg_deserialfn(bytea, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'composition_agg_deserialfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION composition_agg_finalfn(internal)
+  RETURNS alphabet AS
+  '$libdir/postbis', 'composition_agg_finalfn'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION alphabet_agg_finalfn(internal)
+  RETURNS alphabet AS
+  '$libdir/postbis', 'alphabet_agg_finalfn'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION composition_agg_transfn(internal, dna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'composition_agg_transfn_dna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE sequence_composition_agg(dna_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = composition_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION alphabet_agg_transfn(internal, dna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'alphabet_agg_transfn_dna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE alphabet_union_agg(dna_sequence) (
+  sfunc = alphabet_agg_transfn,
+  stype = internal,
+  finalfunc = alphabet_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION total_length_agg_transfn(int8, dna_sequence)
+  RETURNS int8 AS
+  '$libdir/postbis', 'total_length_agg_transfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE total_length_agg(dna_sequence) (
+  sfunc = total_length_agg_transfn,
+  stype = int8,
+  initcond = '0',
+  combinefunc = int8pl,
+  parallel = safe
+);
+
+CREATE FUNCTION concat_agg_transfn(internal, dna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'concat_agg_transfn_dna'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION concat_agg_finalfn_dna(internal)
+  RETURNS dna_sequence AS
+  '$libdir/postbis', 'concat_agg_finalfn'
+  LANGUAGE c IMMUTABLE;
+
+CREATE AGGREGATE sequence_concat_agg(dna_sequence) (
+  sfunc = concat_agg_transfn,
+  stype = internal,
+  finalfunc = concat_agg_finalfn_dna
+);
+
+CREATE FUNCTION composition_agg_transfn(internal, rna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'composition_agg_transfn_rna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE sequence_composition_agg(rna_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = composition_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION alphabet_agg_transfn(internal, rna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'alphabet_agg_transfn_rna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE alphabet_union_agg(rna_sequence) (
+  sfunc = alphabet_agg_transfn,
+  stype = internal,
+  finalfunc = alphabet_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION total_length_agg_transfn(int8, rna_sequence)
+  RETURNS int8 AS
+  '$libdir/postbis', 'total_length_agg_transfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE total_length_agg(rna_sequence) (
+  sfunc = total_length_agg_transfn,
+  stype = int8,
+  initcond = '0',
+  combinefunc = int8pl,
+  parallel = safe
+);
+
+CREATE FUNCTION concat_agg_transfn(internal, rna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'concat_agg_transfn_rna'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION concat_agg_finalfn_rna(internal)
+  RETURNS rna_sequence AS
+  '$libdir/postbis', 'concat_agg_finalfn'
+  LANGUAGE c IMMUTABLE;
+
+CREATE AGGREGATE sequence_concat_agg(rna_sequence) (
+  sfunc = concat_agg_transfn,
+  stype = internal,
+  finalfunc = concat_agg_finalfn_rna
+);
+
+CREATE FUNCTION composition_agg_transfn(internal, aa_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'composition_agg_transfn_aa'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE sequence_composition_agg(aa_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = composition_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION alphabet_agg_transfn(internal, aa_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'alphabet_agg_transfn_aa'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE alphabet_union_agg(aa_sequence) (
+  sfunc = alphabet_agg_transfn,
+  stype = internal,
+  finalfunc = alphabet_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION total_length_agg_transfn(int8, aa_sequence)
+  RETURNS int8 AS
+  '$libdir/postbis', 'total_length_agg_transfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE total_length_agg(aa_sequence) (
+  sfunc = total_length_agg_transfn,
+  stype = int8,
+  initcond = '0',
+  combinefunc = int8pl,
+  parallel = safe
+);
+
+CREATE FUNCTION concat_agg_transfn(internal, aa_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'concat_agg_transfn_aa'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION concat_agg_finalfn_aa(internal)
+  RETURNS aa_sequence AS
+  '$libdir/postbis', 'concat_agg_finalfn'
+  LANGUAGE c IMMUTABLE;
+
+CREATE AGGREGATE sequence_concat_agg(aa_sequence) (
+  sfunc = concat_agg_transfn,
+  stype = internal,
+  finalfunc = concat_agg_finalfn_aa
+);
+
+CREATE FUNCTION composition_agg_transfn(internal, aligned_dna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'composition_agg_transfn_aligned_dna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE sequence_composition_agg(aligned_dna_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = composition_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION alphabet_agg_transfn(internal, aligned_dna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'alphabet_agg_transfn_aligned_dna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE alphabet_union_agg(aligned_dna_sequence) (
+  sfunc = alphabet_agg_transfn,
+  stype = internal,
+  finalfunc = alphabet_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION total_length_agg_transfn(int8, aligned_dna_sequence)
+  RETURNS int8 AS
+  '$libdir/postbis', 'total_length_agg_transfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE total_length_agg(aligned_dna_sequence) (
+  sfunc = total_length_agg_transfn,
+  stype = int8,
+  initcond = '0',
+  combinefunc = int8pl,
+  parallel = safe
+);
+
+CREATE FUNCTION concat_agg_transfn(internal, aligned_dna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'concat_agg_transfn_aligned_dna'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION concat_agg_finalfn_aligned_dna(internal)
+  RETURNS aligned_dna_sequence AS
+  '$libdir/postbis', 'concat_agg_finalfn'
+  LANGUAGE c IMMUTABLE;
+
+CREATE AGGREGATE sequence_concat_agg(aligned_dna_sequence) (
+  sfunc = concat_agg_transfn,
+  stype = internal,
+  finalfunc = concat_agg_finalfn_aligned_dna
+);
+
+CREATE FUNCTION composition_agg_transfn(internal, aligned_rna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'composition_agg_transfn_aligned_rna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE sequence_composition_agg(aligned_rna_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = composition_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION alphabet_agg_transfn(internal, aligned_rna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'alphabet_agg_transfn_aligned_rna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE alphabet_union_agg(aligned_rna_sequence) (
+  sfunc = alphabet_agg_transfn,
+  stype = internal,
+  finalfunc = alphabet_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION total_length_agg_transfn(int8, aligned_rna_sequence)
+  RETURNS int8 AS
+  '$libdir/postbis', 'total_length_agg_transfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE total_length_agg(aligned_rna_sequence) (
+  sfunc = total_length_agg_transfn,
+  stype = int8,
+  initcond = '0',
+  combinefunc = int8pl,
+  parallel = safe
+);
+
+CREATE FUNCTION concat_agg_transfn(internal, aligned_rna_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'concat_agg_transfn_aligned_rna'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION concat_agg_finalfn_aligned_rna(internal)
+  RETURNS aligned_rna_sequence AS
+  '$libdir/postbis', 'concat_agg_finalfn'
+  LANGUAGE c IMMUTABLE;
+
+CREATE AGGREGATE sequence_concat_agg(aligned_rna_sequence) (
+  sfunc = concat_agg_transfn,
+  stype = internal,
+  finalfunc = concat_agg_finalfn_aligned_rna
+);
+
+CREATE FUNCTION composition_agg_transfn(internal, aligned_aa_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'composition_agg_transfn_aligned_aa'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE sequence_composition_agg(aligned_aa_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = composition_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION alphabet_agg_transfn(internal, aligned_aa_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'alphabet_agg_transfn_aligned_aa'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE alphabet_union_agg(aligned_aa_sequence) (
+  sfunc = alphabet_agg_transfn,
+  stype = internal,
+  finalfunc = alphabet_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION total_length_agg_transfn(int8, aligned_aa_sequence)
+  RETURNS int8 AS
+  '$libdir/postbis', 'total_length_agg_transfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE total_length_agg(aligned_aa_sequence) (
+  sfunc = total_length_agg_transfn,
+  stype = int8,
+  initcond = '0',
+  combinefunc = int8pl,
+  parallel = safe
+);
+
+CREATE FUNCTION concat_agg_transfn(internal, aligned_aa_sequence)
+  RETURNS internal AS
+  '$libdir/postbis', 'concat_agg_transfn_aligned_aa'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION concat_agg_finalfn_aligned_aa(internal)
+  RETURNS aligned_aa_sequence AS
+  '$libdir/postbis', 'concat_agg_finalfn'
+  LANGUAGE c IMMUTABLE;
+
+CREATE AGGREGATE sequence_concat_agg(aligned_aa_sequence) (
+  sfunc = concat_agg_transfn,
+  stype = internal,
+  finalfunc = concat_agg_finalfn_aligned_aa
+);
+
+/*
+*	Type: dna_delta
+*
+*	Sequences stored as edits against a reference sequence of
+*	postbis_reference, e.g. strains of a species against its reference
+*	genome. Register a reference with
+*	  INSERT INTO postbis_reference (name, sequence) VALUES (...);
+*	and compress with delta_compress(sequence, name). Delta sequences
+*	refer to the reference by id and detect changes of its sequence.
+*/
+CREATE TABLE postbis_reference (
+  id serial PRIMARY KEY,
+  name text NOT NULL UNIQUE,
+  sequence dna_sequence NOT NULL
+);
+
+SELECT pg_catalog.pg_extension_config_dump('postbis_reference', '');
+SELECT pg_catalog.pg_extension_config_dump('postbis_reference_id_seq', '');
+
+CREATE TYPE dna_delta;
+
+CREATE FUNCTION dna_delta_in(cstring)
+  RETURNS dna_delta AS
+  '$libdir/postbis', 'dna_delta_in'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION dna_delta_out(dna_delta)
+  RETURNS cstring AS
+  '$libdir/postbis', 'dna_delta_out'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE TYPE dna_delta (
+  input = dna_delta_in,
+  output = dna_delta_out,
+  internallength = VARIABLE,
+  alignment = int4,
+  storage = EXTENDED
+);
+
+CREATE FUNCTION delta_compress(dna_sequence, reference text)
+  RETURNS dna_delta AS
+  '$libdir/postbis', 'delta_compress_dna'
+  LANGUAGE c STABLE STRICT;
+
+CREATE FUNCTION dna_delta_to_dna_sequence(dna_delta)
+  RETURNS dna_sequence AS
+  '$libdir/postbis', 'dna_delta_to_dna_sequence'
+  LANGUAGE c STABLE STRICT;
+
+CREATE CAST (dna_delta AS dna_sequence)
+  WITH FUNCTION dna_delta_to_dna_sequence(dna_delta) AS ASSIGNMENT;
+
+CREATE FUNCTION substr(dna_delta, int4, int4)
+  RETURNS text AS
+  '$libdir/postbis', 'dna_delta_substring'
+  LANGUAGE c STABLE STRICT;
+
+CREATE FUNCTION char_length(dna_delta)
+  RETURNS int4 AS
+  '$libdir/postbis', 'dna_delta_char_length'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION compression_ratio(dna_delta)
+  RETURNS float8 AS
+  '$libdir/postbis', 'dna_delta_compression_ratio'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Type: sequence_sketch
+*
+*	MinHash sketches of the canonical k-mers of nucleotide sequences.
+*	sketch(seq, k, size) keeps the size smallest k-mer hashes, a k-mer
+*	and its reverse complement hash the same. Sketches of the same k
+*	estimate the Jaccard index of the k-mer sets and the Mash distance,
+*	which approximates the mutation rate. The GiST operator class finds
+*	nearest neighbours with ORDER BY sketch <-> query.
+*/
+CREATE TYPE sequence_sketch;
+
+CREATE FUNCTION sequence_sketch_in(cstring)
+  RETURNS sequence_sketch AS
+  '$libdir/postbis', 'sequence_sketch_in'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_sketch_out(sequence_sketch)
+  RETURNS cstring AS
+  '$libdir/postbis', 'sequence_sketch_out'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE TYPE sequence_sketch (
+  input = sequence_sketch_in,
+  output = sequence_sketch_out,
+  internallength = VARIABLE,
+  alignment = double,
+  storage = EXTENDED
+);
+
+CREATE FUNCTION sketch(dna_sequence, k int4 DEFAULT 21, size int4 DEFAULT 1000)
+  RETURNS sequence_sketch AS
+  '$libdir/postbis', 'sketch_dna'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sketch(rna_sequence, k int4 DEFAULT 21, size int4 DEFAULT 1000)
+  RETURNS sequence_sketch AS
+  '$libdir/postbis', 'sketch_rna'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_length(sequence_sketch)
+  RETURNS int4 AS
+  '$libdir/postbis', 'sketch_k'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION n_hashes(sequence_sketch)
+  RETURNS int4 AS
+  '$libdir/postbis', 'sketch_n_hashes'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION jaccard(sequence_sketch, sequence_sketch)
+  RETURNS float8 AS
+  '$libdir/postbis', 'sketch_jaccard_index'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION mash_distance(sequence_sketch, sequence_sketch)
+  RETURNS float8 AS
+  '$libdir/postbis', 'sketch_mash_distance'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR <-> (
+  leftarg = sequence_sketch,
+  rightarg = sequence_sketch,
+  procedure = mash_distance,
+  commutator = <->
+);
+
+CREATE FUNCTION sketch_overlap(sequence_sketch, sequence_sketch)
+  RETURNS bool AS
+  '$libdir/postbis', 'sketch_overlap'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR && (
+  leftarg = sequence_sketch,
+  rightarg = sequence_sketch,
+  procedure = sketch_overlap,
+  commutator = &&,
+  restrict = contsel,
+  join = contjoinsel
+);
+
+CREATE FUNCTION gist_sketch_compress(internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gist_sketch_compress'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gist_sketch_decompress(internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gist_sketch_decompress'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gist_sketch_consistent(internal, sequence_sketch, int2, oid, internal)
+  RETURNS bool AS
+  '$libdir/postbis', 'gist_sketch_consistent'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gist_sketch_union(internal, internal)
+  RETURNS sequence_sketch AS
+  '$libdir/postbis', 'gist_sketch_union'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gist_sketch_penalty(internal, internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gist_sketch_penalty'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gist_sketch_picksplit(internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gist_sketch_picksplit'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gist_sketch_same(sequence_sketch, sequence_sketch, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'gist_sketch_same'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION gist_sketch_distance(internal, sequence_sketch, int2, oid, internal)
+  RETURNS float8 AS
+  '$libdir/postbis', 'gist_sketch_distance'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE OPERATOR CLASS sequence_sketch_ops
+  DEFAULT FOR TYPE sequence_sketch USING gist AS
+    OPERATOR 3 && (sequence_sketch, sequence_sketch),
+    OPERATOR 15 <-> (sequence_sketch, sequence_sketch) FOR ORDER BY float_ops,
+    FUNCTION 1 gist_sketch_consistent(internal, sequence_sketch, int2, oid, internal),
+    FUNCTION 2 gist_sketch_union(internal, internal),
+    FUNCTION 3 gist_sketch_compress(internal),
+    FUNCTION 4 gist_sketch_decompress(internal),
+    FUNCTION 5 gist_sketch_penalty(internal, internal, internal),
+    FUNCTION 6 gist_sketch_picksplit(internal, internal),
+    FUNCTION 7 gist_sketch_same(sequence_sketch, sequence_sketch, internal),
+    FUNCTION 8 gist_sketch_distance(internal, sequence_sketch, int2, oid, internal);
+
+/*
+*	k-mer counting
+*
+*	kmer_counts() returns the distinct k-mers of a dna_sequence with
+*	their number of occurrences, ordered by k-mer. kmer_spectrum()
+*	returns how many distinct k-mers occur how often. k is at most 32,
+*	k-mers containing other symbols than A, C, G and T are skipped. A
+*	canonical k-mer is the smaller of a k-mer and its reverse
+*	complement. kmer_spectrum_agg() returns the spectrum of all rows as
+*	int8[][] of {multiplicity, n_kmers}.
+*/
+CREATE FUNCTION kmer_counts(sequence dna_sequence, k int4, canonical bool DEFAULT false, OUT kmer text, OUT count int8)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'kmer_counts_dna'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_spectrum(sequence dna_sequence, k int4, canonical bool DEFAULT false, OUT multiplicity int8, OUT n_kmers int8)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'kmer_spectrum_dna'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_spectrum_agg_transfn(internal, dna_sequence, int4, bool)
+  RETURNS internal AS
+  '$libdir/postbis', 'kmer_spectrum_agg_transfn_dna'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION kmer_spectrum_agg_combinefn(internal, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'kmer_spectrum_agg_combinefn'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION kmer_spectrum_agg_serialfn(internal)
+  RETURNS bytea AS
+  '$libdir/postbis', 'kmer_spectrum_agg_serialfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_spectrum_agg_deserialfn(bytea, internal)
+  RETURNS internal AS
+  '$libdir/postbis', 'kmer_spectrum_agg_deserialfn'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_spectrum_agg_finalfn(internal)
+  RETURNS int8[] AS
+  '$libdir/postbis', 'kmer_spectrum_agg_finalfn'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE kmer_spectrum_agg(dna_sequence, int4, bool) (
+  sfunc = kmer_spectrum_agg_transfn,
+  stype = internal,
+  finalfunc = kmer_spectrum_agg_finalfn,
+  combinefunc = kmer_spectrum_agg_combinefn,
+  serialfunc = kmer_spectrum_agg_serialfn,
+  deserialfunc = kmer_spectrum_agg_deserialfn,
+  parallel = safe
+);
+
+/*
+*	Loading FASTA and FASTQ files
+*
+*	The files are read by the server, which requires superuser rights.
+*	type_modifiers are those of dna_sequence, e.g. 'REFERENCE' or
+*	'FLC, SHORT'. Insert into a column without type modifiers, as the
+*	cast to a column with type modifiers compresses the sequences
+*	again.
+*/
+CREATE FUNCTION read_fasta(path text, type_modifiers text DEFAULT '', OUT id text, OUT sequence dna_sequence)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'read_fasta'
+  LANGUAGE c VOLATILE STRICT;
+
+CREATE FUNCTION read_fastq(path text, type_modifiers text DEFAULT '', OUT id text, OUT sequence dna_sequence, OUT quality text)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'read_fastq'
+  LANGUAGE c VOLATILE STRICT;
+
+/*
+*	Reading sequences in chunks
+*
+*	sequence_chunks() returns a sequence as rows of chunk_size
+*	characters, the last one may be shorter. position is the first
+*	position of a chunk, starting at 1. Only a few chunks are decoded
+*	at a time, so long sequences can be streamed with bounded memory.
+*/
+CREATE FUNCTION sequence_chunks(sequence dna_sequence, chunk_size int4, OUT position int4, OUT chunk text)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'sequence_chunks_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_chunks(sequence rna_sequence, chunk_size int4, OUT position int4, OUT chunk text)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'sequence_chunks_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_chunks(sequence aa_sequence, chunk_size int4, OUT position int4, OUT chunk text)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'sequence_chunks_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_chunks(sequence aligned_dna_sequence, chunk_size int4, OUT position int4, OUT chunk text)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'sequence_chunks_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_chunks(sequence aligned_rna_sequence, chunk_size int4, OUT position int4, OUT chunk text)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'sequence_chunks_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION sequence_chunks(sequence aligned_aa_sequence, chunk_size int4, OUT position int4, OUT chunk text)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'sequence_chunks_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Extracting many intervals
+*
+*	substr_multi() returns the intervals of a sequence given as ranges
+*	of positions, starting at 1, e.g. '[1,11)' for the first 10
+*	characters. The bounds are clipped like those of substr(). n is
+*	the position of a range in the array, NULL ranges give a NULL
+*	subsequence. The rows are ordered by start, so the sequence is
+*	decoded from front to back only once. Intervals with TRUE in
+*	reverse_complement are returned as reverse complement.
+*/
+CREATE FUNCTION substr_multi(sequence dna_sequence, ranges int4range[], reverse_complement bool[] DEFAULT '{}', OUT n int4, OUT subsequence text)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'substr_multi_dna'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	Shared codebooks
+*
+*	A codebook is a code trained on a sample of a column, e.g.
+*	  SELECT register_codebook(codebook_agg(sequence))
+*	    FROM (SELECT sequence FROM t LIMIT 1000) sample;
+*	codebook_compress(sequence, id) encodes a sequence with a codebook
+*	of postbis_codebook, so the rows refer to it instead of storing
+*	their own codewords. Sequences with symbols the codebook does not
+*	contain are returned unchanged. Use columns without type modifiers,
+*	as the cast to a column with type modifiers compresses the sequences
+*	again. Codebooks cannot be changed or deleted, because stored
+*	sequences refer to them.
+*/
+CREATE TABLE postbis_codebook (
+  id serial PRIMARY KEY,
+  code bytea NOT NULL
+);
+
+SELECT pg_catalog.pg_extension_config_dump('postbis_codebook', '');
+SELECT pg_catalog.pg_extension_config_dump('postbis_codebook_id_seq', '');
+
+CREATE FUNCTION postbis_codebook_immutable()
+  RETURNS trigger AS $$
+    BEGIN
+      RAISE EXCEPTION 'codebooks of postbis_codebook cannot be changed or deleted';
+    END;
+  $$ LANGUAGE plpgsql;
+
+CREATE TRIGGER postbis_codebook_immutable
+  BEFORE UPDATE OR DELETE ON postbis_codebook
+  FOR EACH ROW EXECUTE PROCEDURE postbis_codebook_immutable();
+
+CREATE TRIGGER postbis_codebook_immutable_truncate
+  BEFORE TRUNCATE ON postbis_codebook
+  FOR EACH STATEMENT EXECUTE PROCEDURE postbis_codebook_immutable();
+
+CREATE FUNCTION register_codebook(code bytea)
+  RETURNS int4 AS $$
+    INSERT INTO postbis_codebook (code) VALUES ($1) RETURNING id;
+  $$ LANGUAGE sql VOLATILE STRICT;
+
+CREATE FUNCTION codebook_agg_finalfn(internal)
+  RETURNS bytea AS
+  '$libdir/postbis', 'codebook_agg_finalfn'
+  LANGUAGE c IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE codebook_agg(dna_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = codebook_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE AGGREGATE codebook_agg(rna_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = codebook_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE AGGREGATE codebook_agg(aa_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = codebook_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE AGGREGATE codebook_agg(aligned_dna_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = codebook_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE AGGREGATE codebook_agg(aligned_rna_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = codebook_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE AGGREGATE codebook_agg(aligned_aa_sequence) (
+  sfunc = composition_agg_transfn,
+  stype = internal,
+  finalfunc = codebook_agg_finalfn,
+  combinefunc = composition_agg_combinefn,
+  serialfunc = composition_agg_serialfn,
+  deserialfunc = composition_agg_deserialfn,
+  parallel = safe
+);
+
+CREATE FUNCTION codebook_compress(sequence dna_sequence, codebook int4)
+  RETURNS dna_sequence AS
+  '$libdir/postbis', 'codebook_compress_dna'
+  LANGUAGE c STABLE STRICT;
+
+CREATE FUNCTION codebook_compress(sequence rna_sequence, codebook int4)
+  RETURNS rna_sequence AS
+  '$libdir/postbis', 'codebook_compress_rna'
+  LANGUAGE c STABLE STRICT;
+
+CREATE FUNCTION codebook_compress(sequence aa_sequence, codebook int4)
+  RETURNS aa_sequence AS
+  '$libdir/postbis', 'codebook_compress_aa'
+  LANGUAGE c STABLE STRICT;
+
+CREATE FUNCTION codebook_compress(sequence aligned_dna_sequence, codebook int4)
+  RETURNS aligned_dna_sequence AS
+  '$libdir/postbis', 'codebook_compress_aligned_dna'
+  LANGUAGE c STABLE STRICT;
+
+CREATE FUNCTION codebook_compress(sequence aligned_rna_sequence, codebook int4)
+  RETURNS aligned_rna_sequence AS
+  '$libdir/postbis', 'codebook_compress_aligned_rna'
+  LANGUAGE c STABLE STRICT;
+
+CREATE FUNCTION codebook_compress(sequence aligned_aa_sequence, codebook int4)
+  RETURNS aligned_aa_sequence AS
+  '$libdir/postbis', 'codebook_compress_aligned_aa'
+  LANGUAGE c STABLE STRICT;
+
+/*
+*	Alignment columns
+*
+*	alignment_column(sequence, position) returns the symbol of a row of a
+*	multiple sequence alignment at a column, counted from 1. The
+*	aggregate alignment_column_agg(sequence, position) collects the
+*	symbols of all rows at a column, e.g.
+*	  SELECT alignment_column_agg(sequence, 42 ORDER BY id) FROM msa;
+*	Only the part of each row holding the symbol is decoded.
+*/
+
+CREATE FUNCTION alignment_column(sequence aligned_dna_sequence, position int4)
+  RETURNS text AS
+  '$libdir/postbis', 'alignment_column_aligned_dna'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION alignment_column_agg_transfn(internal, aligned_dna_sequence, int4)
+  RETURNS internal AS
+  '$libdir/postbis', 'alignment_column_agg_transfn_aligned_dna'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION alignment_column(sequence aligned_rna_sequence, position int4)
+  RETURNS text AS
+  '$libdir/postbis', 'alignment_column_aligned_rna'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION alignment_column_agg_transfn(internal, aligned_rna_sequence, int4)
+  RETURNS internal AS
+  '$libdir/postbis', 'alignment_column_agg_transfn_aligned_rna'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION alignment_column(sequence aligned_aa_sequence, position int4)
+  RETURNS text AS
+  '$libdir/postbis', 'alignment_column_aligned_aa'
+  LANGUAGE c IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION alignment_column_agg_transfn(internal, aligned_aa_sequence, int4)
+  RETURNS internal AS
+  '$libdir/postbis', 'alignment_column_agg_transfn_aligned_aa'
+  LANGUAGE c IMMUTABLE;
+
+CREATE FUNCTION alignment_column_agg_finalfn(internal)
+  RETURNS text AS
+  '$libdir/postbis', 'alignment_column_agg_finalfn'
+  LANGUAGE c IMMUTABLE;
+
+CREATE AGGREGATE alignment_column_agg(aligned_dna_sequence, int4) (
+  sfunc = alignment_column_agg_transfn,
+  stype = internal,
+  finalfunc = alignment_column_agg_finalfn
+);
+
+CREATE AGGREGATE alignment_column_agg(aligned_rna_sequence, int4) (
+  sfunc = alignment_column_agg_transfn,
+  stype = internal,
+  finalfunc = alignment_column_agg_finalfn
+);
+
+CREATE AGGREGATE alignment_column_agg(aligned_aa_sequence, int4) (
+  sfunc = alignment_column_agg_transfn,
+  stype = internal,
+  finalfunc = alignment_column_agg_finalfn
+);
+
+/*
+*	Instrumentation
+*
+*	postbis_stat() returns counters of the work done by the compression
+*	engine in this backend and, if postbis is in shared_preload_libraries,
+*	in all backends. The view pg_stat_postbis shows them.
+*	postbis_stat_reset() sets them to zero. Like pg_stat_statements_reset()
+*	it may only be called by superusers, unless it is granted to a role.
+*/
+
+CREATE FUNCTION postbis_stat(OUT counter text, OUT backend int8, OUT cluster int8)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'postbis_stat'
+  LANGUAGE c VOLATILE STRICT;
+
+CREATE FUNCTION postbis_stat_reset()
+  RETURNS void AS
+  '$libdir/postbis', 'postbis_stat_reset'
+  LANGUAGE c VOLATILE STRICT;
+
+REVOKE ALL ON FUNCTION postbis_stat_reset() FROM PUBLIC;
+
+CREATE VIEW pg_stat_postbis AS
+  SELECT * FROM postbis_stat();
+
+/*
+*	Test functions
+*/
+
+/*
+*	The same seed gives the same sequence on every platform.
+*/
+CREATE FUNCTION generate_sequence(alphabet, int, seed int8)
+  RETURNS text AS
+  '$libdir/postbis', 'generate_sequence_seeded'
+  LANGUAGE c IMMUTABLE STRICT;
+
+/*
+*	generate_dna_sequence() returns a random sequence, that is the same
+*	for the same arguments. generate_dna_sequences() returns n of them,
+*	the first one is the result of generate_dna_sequence().
+*/
+CREATE FUNCTION generate_dna_sequence(alphabet alphabet, length int4, type_modifiers text DEFAULT '', seed int8 DEFAULT 0)
+  RETURNS dna_sequence AS
+  '$libdir/postbis', 'generate_dna_sequence'
+  LANGUAGE c IMMUTABLE STRICT;
+
+CREATE FUNCTION generate_dna_sequences(alphabet alphabet, length int4, n int4, type_modifiers text DEFAULT '', seed int8 DEFAULT 0, OUT id int4, OUT sequence dna_sequence)
+  RETURNS SETOF record AS
+  '$libdir/postbis', 'generate_dna_sequences'
+  LANGUAGE c IMMUTABLE STRICT;
@@ -17,3 +17,16 @@
 #ifdef PG_MODULE_MAGIC
 PG_MODULE_MAGIC;
 #endif
+
+#include "utils/instrumentation.h"
+
+void _PG_init(void);
+
+/**
+ * _PG_init()
+ * 		Called when the library is loaded.
+ */
+void _PG_init(void)
+{
+	init_shared_counters();
+}
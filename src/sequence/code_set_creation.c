@@ -17,6 +17,7 @@
 #include "sequence/sequence.h"
 #include "sequence/compression.h"
 #include "utils/debug.h"
+#include "utils/instrumentation.h"
 
 #include "sequence/code_set_creation.h"
 
@@ -366,6 +367,7 @@ PB_CodeSet* get_huffman_code(const PB_SequenceInfo* info)
 	if (info->n_symbols > 0)
 	{
 		tree = get_huffman_tree(info->n_symbols, info->symbols, info->frequencies);
+		PB_COUNT(huffman_code_builds, 1);
 		result = get_huffman_code_dfs(tree, info->n_symbols);
 		pfree(tree);
 	}
@@ -404,6 +406,7 @@ PB_CodeSet* get_huffman_code_rle(const PB_SequenceInfo* info) {
 			tree = get_huffman_tree(info->rle_info->n_symbols,
 											info->rle_info->symbols,
 											info->rle_info->rle_frequencies);
+			PB_COUNT(huffman_code_builds, 1);
 			result = get_huffman_code_dfs(tree, info->rle_info->n_symbols);
 			pfree(tree);
 		}
@@ -668,7 +671,11 @@ PB_CodeSet* get_optimal_code(const PB_SequenceInfo* info)
 			}
 		}
 
-		if (get_compressed_size(info, result) < get_compressed_size(info, rle_code))
+		if (!rle_code)
+		{
+			/* no huffman code for runs, keep the code without RLE */
+		}
+		else if (get_compressed_size(info, result) < get_compressed_size(info, rle_code))
 			pfree(rle_code);
 		else
 		{
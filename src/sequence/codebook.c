@@ -0,0 +1,445 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/sequence/codebook.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "catalog/pg_type.h"
+#include "commands/extension.h"
+#include "executor/spi.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+#include "sequence/sequence.h"
+#include "sequence/stats.h"
+#include "sequence/code_set_creation.h"
+#include "sequence/compression.h"
+#include "sequence/codebook.h"
+#include "utils/debug.h"
+
+/*
+ * Codebooks are prefix codes shared by many sequences, e.g. trained on
+ * a sample of a column. They are stored in the table postbis_codebook,
+ * which does not allow to change or delete them. Sequences refer to a
+ * codebook by its id instead of storing their own codewords, which saves
+ * the codewords in every row and building a code for every row at insert.
+ *
+ * A codebook behaves like a fixed code: it is flagged with is_fixed and
+ * may contain symbols a sequence does not. It is loaded once per backend,
+ * so its decoding maps are cached like those of the fixed codes.
+ *
+ * The external representation of a codebook is a bytea of
+ *
+ * 	uint8 version;					PB_CODEBOOK_FORMAT_VERSION
+ * 	uint8 n_symbols;
+ * 	{uint8 symbol; uint8 code_length; uint8 code;}[n_symbols]
+ *
+ * with codes left-aligned like those of PB_Codeword.
+ */
+
+#define PB_CODEBOOK_TABLE			"postbis_codebook"
+
+/**
+ * Size of the external representation of a codebook.
+ */
+#define PB_CODEBOOK_SIZE(n_symbols)	(2 + 3 * (n_symbols))
+
+/*
+ * Codebooks loaded by this backend. They are never freed, because
+ * cached decoding maps refer to them.
+ */
+static PB_CodeSet** codebooks = NULL;
+static int n_codebooks = 0;
+static int max_codebooks = 0;
+
+/*
+ * local function declarations
+ */
+
+static PB_CodeSet* read_codebook(uint32 id, const uint8* data, Size size);
+static PB_CodeSet* load_codebook(uint32 id);
+
+/*
+ * local functions
+ */
+
+/**
+ * read_codebook()
+ * 		Checks the external representation of a codebook and builds its
+ * 		code set in TopMemoryContext.
+ *
+ * 	uint32 id : id of the codebook
+ * 	uint8* data : external representation
+ * 	Size size : size of the external representation
+ */
+static PB_CodeSet* read_codebook(uint32 id, const uint8* data, Size size)
+{
+	PB_CodeSet* result;
+	PB_CodeSet* copy;
+	bool seen[PB_ASCII_SIZE];
+	int n_symbols;
+	int i;
+	int j;
+
+	if (size < 2 || data[0] != PB_CODEBOOK_FORMAT_VERSION)
+		goto invalid;
+
+	n_symbols = data[1];
+	if (n_symbols == 0 || n_symbols > PB_ASCII_SIZE || size != PB_CODEBOOK_SIZE(n_symbols))
+		goto invalid;
+
+	result = palloc0(sizeof(PB_CodeSet) + n_symbols * sizeof(PB_Codeword));
+	result->n_symbols = n_symbols;
+	result->is_fixed = TRUE;
+	result->fixed_id = PB_CODEBOOK_FIXED_ID;
+	result->codebook_id = id;
+	result->has_equal_length = TRUE;
+
+	memset(seen, 0, sizeof(seen));
+
+	for (i = 0; i < n_symbols; i++)
+	{
+		PB_Codeword* word = &result->words[i];
+
+		word->symbol = data[2 + 3 * i];
+		word->code_length = data[3 + 3 * i];
+		word->code = data[4 + 3 * i];
+
+		if (word->symbol == 0 || word->symbol >= PB_ASCII_SIZE || seen[word->symbol])
+			goto invalid;
+		seen[word->symbol] = TRUE;
+
+		/* codewords have at least one bit, see build_codebook() */
+		if (word->code_length == 0 ||
+			word->code_length > PB_PREFIX_CODE_BIT_SIZE ||
+			((word->code << word->code_length) & ((1 << PB_PREFIX_CODE_BIT_SIZE) - 1)) != 0)
+			goto invalid;
+
+		if (word->symbol >= 64)
+			result->ascii_bitmap_high |= ((uint64) 1) << (word->symbol - 64);
+		else
+			result->ascii_bitmap_low |= ((uint64) 1) << word->symbol;
+
+		if (result->max_codeword_length < word->code_length)
+			result->max_codeword_length = word->code_length;
+		if (word->code_length != result->words[0].code_length)
+			result->has_equal_length = FALSE;
+	}
+
+	/*
+	 * No codeword may be a prefix of another one.
+	 */
+	for (i = 0; i < n_symbols; i++)
+	{
+		for (j = i + 1; j < n_symbols; j++)
+		{
+			const int length = Min(result->words[i].code_length, result->words[j].code_length);
+			const PB_PrefixCode mask = (PB_PrefixCode) (0xFF << (PB_PREFIX_CODE_BIT_SIZE - length));
+
+			if (((result->words[i].code ^ result->words[j].code) & mask) == 0)
+				goto invalid;
+		}
+	}
+
+	copy = MemoryContextAlloc(TopMemoryContext, sizeof(PB_CodeSet) + n_symbols * sizeof(PB_Codeword));
+	memcpy(copy, result, sizeof(PB_CodeSet) + n_symbols * sizeof(PB_Codeword));
+	pfree(result);
+
+	return copy;
+
+invalid:
+	ereport(ERROR,
+			(errcode(ERRCODE_DATA_CORRUPTED),
+			 errmsg("codebook %u is invalid", id)));
+
+	return NULL;
+}
+
+/**
+ * load_codebook()
+ * 		Reads a codebook from the table postbis_codebook.
+ *
+ * 	uint32 id : id of the codebook
+ */
+static PB_CodeSet* load_codebook(uint32 id)
+{
+	PB_CodeSet* result;
+	char* table;
+	Oid extension;
+	Oid argtypes[1];
+	Datum values[1];
+	Datum code;
+	bytea* detoasted;
+	bool isnull;
+	int ret;
+
+	PB_TRACE(errmsg("->load_codebook(%u)", id));
+
+	/*
+	 * The extension is relocatable, so the table is qualified with
+	 * the schema of the extension.
+	 */
+	extension = get_extension_oid("postbis", false);
+	table = quote_qualified_identifier(get_namespace_name(get_extension_schema(extension)),
+									   PB_CODEBOOK_TABLE);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	argtypes[0] = INT4OID;
+	values[0] = Int32GetDatum((int32) id);
+	ret = SPI_execute_with_args(psprintf("SELECT code FROM %s WHERE id = $1", table),
+								1, argtypes, values, NULL, true, 1);
+
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "SPI_execute_with_args returned %d", ret);
+
+	if (SPI_processed != 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_OBJECT),
+				 errmsg("codebook %u does not exist", id)));
+
+	code = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
+	if (isnull)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("codebook %u is invalid", id)));
+
+	detoasted = DatumGetByteaPP(code);
+	result = read_codebook(id, (uint8*) VARDATA_ANY(detoasted), VARSIZE_ANY_EXHDR(detoasted));
+
+	SPI_finish();
+
+	PB_TRACE(errmsg("<-load_codebook() with %u symbols", result->n_symbols));
+
+	return result;
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * get_codebook()
+ * 		Returns the codebook with an id from the table postbis_codebook.
+ *
+ * 	uint32 id : id of the codebook
+ */
+PB_CodeSet* get_codebook(uint32 id)
+{
+	PB_CodeSet* result;
+	int i;
+
+	for (i = 0; i < n_codebooks; i++)
+		if (codebooks[i]->codebook_id == id)
+			return codebooks[i];
+
+	result = load_codebook(id);
+
+	if (n_codebooks == max_codebooks)
+	{
+		max_codebooks = Max(8, 2 * max_codebooks);
+
+		if (codebooks == NULL)
+			codebooks = MemoryContextAlloc(TopMemoryContext, max_codebooks * sizeof(PB_CodeSet*));
+		else
+			codebooks = repalloc(codebooks, max_codebooks * sizeof(PB_CodeSet*));
+	}
+
+	codebooks[n_codebooks++] = result;
+
+	PB_DEBUG1(errmsg("get_codebook(): cached codebook %u", id));
+
+	return result;
+}
+
+/**
+ * get_fixed_codeset()
+ * 		Returns the fixed code or the codebook of a sequence, that has
+ * 		is_fixed set.
+ *
+ * 	PB_CompressedSequence* header : detoasted prefix of the sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+PB_CodeSet* get_fixed_codeset(const PB_CompressedSequence* header,
+							  PB_CodeSet** fixed_codesets)
+{
+	if (PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(header))
+		return get_codebook(*PB_COMPRESSED_SEQUENCE_CODEBOOK_ID_POINTER(header));
+
+	return fixed_codesets[header->n_swapped_symbols];
+}
+
+/**
+ * build_codebook()
+ * 		Trains a codebook from symbol counts and returns its
+ * 		external representation.
+ *
+ * 	The counts are scaled down to fit the 32 bit frequencies of the
+ * 	code creation. A Huffman code is built, if its codewords fit into
+ * 	PB_PrefixCode, otherwise a code of equal length codewords.
+ *
+ * 	uint64* frequencies : number of occurrences of each symbol
+ */
+bytea* build_codebook(const uint64* frequencies)
+{
+	PB_SequenceInfo* info;
+	PB_CodeSet* codeset;
+	bytea* result;
+	uint8* data;
+	uint64 total = 0;
+	int shift = 0;
+	int i;
+
+	PB_TRACE(errmsg("->build_codebook()"));
+
+	for (i = 1; i < PB_ASCII_SIZE; i++)
+		total += frequencies[i];
+
+	/* leave room for rounding small counts up to one */
+	while ((total >> shift) > PG_UINT32_MAX - PB_ASCII_SIZE)
+		shift++;
+
+	info = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
+	info->ignore_case = FALSE;
+
+	for (i = 1; i < PB_ASCII_SIZE; i++)
+	{
+		if (frequencies[i] > 0)
+		{
+			info->frequencies[i] = Max(frequencies[i] >> shift, 1);
+			info->sequence_length += info->frequencies[i];
+		}
+	}
+
+	complete_sequence_info(info);
+
+	if (info->n_symbols == 0)
+		ereport(ERROR,(errmsg("cannot train a codebook without any symbols")));
+
+	codeset = get_huffman_code(info);
+	if (!codeset)
+		codeset = get_equal_lengths_code(info);
+
+	/*
+	 * The code of a single symbol has an empty codeword. The codebook
+	 * gets a codeword of one bit instead, so sequences encoded with it
+	 * have a stream like those of every other codebook.
+	 */
+	if (codeset->max_codeword_length == 0)
+	{
+		codeset->words[0].code_length = 1;
+		codeset->max_codeword_length = 1;
+	}
+
+	result = palloc(VARHDRSZ + PB_CODEBOOK_SIZE(codeset->n_symbols));
+	SET_VARSIZE(result, VARHDRSZ + PB_CODEBOOK_SIZE(codeset->n_symbols));
+
+	data = (uint8*) VARDATA(result);
+	data[0] = PB_CODEBOOK_FORMAT_VERSION;
+	data[1] = codeset->n_symbols;
+
+	for (i = 0; i < codeset->n_symbols; i++)
+	{
+		data[2 + 3 * i] = codeset->words[i].symbol;
+		data[3 + 3 * i] = codeset->words[i].code_length;
+		data[4 + 3 * i] = codeset->words[i].code;
+	}
+
+	pfree(codeset);
+	PB_SEQUENCE_INFO_PFREE(info);
+
+	PB_TRACE(errmsg("<-build_codebook()"));
+
+	return result;
+}
+
+/**
+ * encode_with_codebook()
+ * 		Encodes a sequence with a codebook. Returns NULL, if the codebook
+ * 		does not contain all symbols of the sequence.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	uint32 id : id of the codebook
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+PB_CompressedSequence* encode_with_codebook(Varlena* raw_seq,
+											uint32 id,
+											PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* header;
+	PB_CompressedSequence* result = NULL;
+	PB_CodeSet* codebook = get_codebook(id);
+	PB_SequenceInfo* info;
+	uint8* plain;
+
+	PB_TRACE(errmsg("->encode_with_codebook(%u)", id));
+
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(raw_seq, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
+
+	plain = palloc(header->sequence_length + 1);
+	decode(raw_seq, plain, 0, header->sequence_length, fixed_codesets);
+	plain[header->sequence_length] = '\0';
+
+	info = get_sequence_info_cstring(plain, PB_SEQUENCE_INFO_CASE_SENSITIVE | PB_SEQUENCE_INFO_WITHOUT_RLE);
+	info->index_part_shift = header->index_part_shift;
+
+	if (PB_CHECK_CODESET(codebook, info))
+		result = encode(plain, get_compressed_size(info, codebook), codebook, info);
+
+	PB_SEQUENCE_INFO_PFREE(info);
+	pfree(plain);
+	pfree(header);
+
+	PB_TRACE(errmsg("<-encode_with_codebook()"));
+
+	return result;
+}
+
+/**
+ * encode_without_codebook()
+ * 		Encodes a sequence, that uses a codebook, with a code of its own.
+ *
+ * 	PB_CompressedSequence* seq : detoasted sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+PB_CompressedSequence* encode_without_codebook(PB_CompressedSequence* seq,
+											   PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* result;
+	PB_CodeSet* codeset;
+	PB_SequenceInfo* info;
+	uint8* plain;
+
+	PB_TRACE(errmsg("->encode_without_codebook()"));
+
+	plain = palloc(seq->sequence_length + 1);
+	decode((Varlena*) seq, plain, 0, seq->sequence_length, fixed_codesets);
+	plain[seq->sequence_length] = '\0';
+
+	info = get_sequence_info_cstring(plain, PB_SEQUENCE_INFO_CASE_SENSITIVE | PB_SEQUENCE_INFO_WITHOUT_RLE);
+	info->index_part_shift = seq->index_part_shift;
+
+	codeset = get_optimal_code(info);
+	result = encode(plain, get_compressed_size(info, codeset), codeset, info);
+
+	pfree(codeset);
+	PB_SEQUENCE_INFO_PFREE(info);
+	pfree(plain);
+
+	PB_TRACE(errmsg("<-encode_without_codebook()"));
+
+	return result;
+}
@@ -14,31 +14,35 @@
 #include "postgres.h"
 #include "fmgr.h"
 #include "access/tuptoaster.h"
+#include "access/xact.h"
+#include "utils/memutils.h"
 #include "c.h"
 
 #include "sequence/sequence.h"
 #include "sequence/stats.h"
+#include "sequence/checksum.h"
+#include "sequence/packing.h"
+#include "sequence/codebook.h"
 #include "utils/debug.h"
+#include "utils/instrumentation.h"
 
 #include "sequence/compression.h"
 
-/*
- * local types
+/**
+ * Number of symbols processed at once by encode_with_stats(). Must divide
+ * PB_INDEX_PART_SIZE and be a multiple of the number of symbols per block.
  */
+#define PB_FUSED_CHUNK_SIZE		16384
 
 /**
- * Type for decoding map elements, so the symbol and the length
- * of the code can be stored close to each other in one data
- * structure. An actual decoding map would be an array of
- * PB_DecodingMap of size PB_DECODE_MAP_SIZE (256 if PB_PrefixCode is
- * uint8)
-  */
-typedef struct {
-	uint8 symbol;
-	uint8 code_length;
-} PB_DecodingMap;
+ * Position of an index entry in the stream in bits.
+ */
+#define PB_INDEX_ENTRY_BIT(entry) \
+	((uint64) (entry).block * PB_COMPRESSION_BUFFER_BIT_SIZE + (entry).bit)
 
-#define PB_DECODE_MAP_SIZE (1 << PB_PREFIX_CODE_BIT_SIZE)
+/*
+ * local types
+ */
 
 /*
  * Type for encoding map elements, so the code and its length
@@ -53,16 +57,106 @@ typedef struct {
 	uint8 code_length;
 } PB_EncodingMap;
 
+/*
+ * State of a prefix code encoder, which is given the input chunk by
+ * chunk. It writes the same stream and index as encode_pc_idx() or,
+ * without index, as encode_pc().
+ */
+typedef struct {
+	const PB_EncodingMap* map;
+	PB_CompressionBuffer buffer;
+	int bits_free;
+	PB_CompressionBuffer* stream_start;
+	PB_CompressionBuffer* output_pointer;
+	PB_IndexEntry* index_pointer;	/* NULL without index */
+	int index_part_size;
+	int index_counter;
+} PB_ChunkEncoder;
+
 /*
  * local function declarations
  */
 
 static PB_EncodingMap* get_encoding_map(const PB_CodeSet* codeset, int mode);
-static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode);
+static void fill_decoding_map(PB_DecodingMap* map,
+							  const PB_CodeSet* codeset,
+							  int mode);
+static PB_MultiDecodingMap* get_multi_decoding_map_from_maps(const PB_DecodingMaps* maps,
+															 MemoryContext context);
+static uint32 get_code_hash(const PB_CodeSet* codeset);
+static void init_decoding_maps(PB_DecodingMaps* maps,
+							   const PB_CodeSet* codeset);
+static void decoding_maps_xact_callback(XactEvent event, void* arg);
 
 static void encode_pc(uint8* input,
 					  PB_CompressedSequence* output,
 					  PB_CodeSet* codeset);
+static uint32 get_input_crc32(const uint8* input,
+							  uint32 length,
+							  const PB_CodeSet* codeset);
+static void get_crc32_symbols(const PB_CodeSet* codeset,
+							  uint8* symbols);
+static uint32 update_input_crc32(uint32 crc,
+								 const uint8* input,
+								 uint32 length,
+								 const uint8* symbols);
+static void encode_composition(const uint8* input,
+							   PB_CompressedSequence* output,
+							   const PB_CodeSet* codeset);
+static void write_composition_row(uint32* row,
+								  const uint32* counts,
+								  const PB_CodeSet* codeset);
+static PB_CompressedSequence* init_compressed_sequence(uint32 compressed_size,
+													   PB_CodeSet* codeset,
+													   PB_SequenceInfo* info);
+static PB_CodeSet* get_sequence_codeset(const PB_CompressedSequence* header,
+										PB_CodeSet** fixed_codesets);
+static void get_equal_length_codes(PB_CodeSet* codeset,
+								   uint8* codes);
+static void append_stream(PB_CompressionBuffer* stream,
+						  uint64 stream_bits,
+						  uint64 total_bits,
+						  const PB_CompressionBuffer* source);
+static PB_CompressionBuffer reverse_fields(PB_CompressionBuffer block,
+										   int field_bits);
+static void reverse_packed_stream(const PB_CompressedSequence* input,
+								  PB_CompressedSequence* output,
+								  int code_length);
+static void copy_stream_bits(PB_CompressionBuffer* stream,
+							 uint64 stream_bit,
+							 const PB_CompressionBuffer* source,
+							 uint64 source_bit,
+							 uint64 n_bits);
+static void overlay_packed_stream(PB_CompressedSequence* seq,
+								  const PB_EncodingMap* map,
+								  int code_length,
+								  uint32 position,
+								  const uint8* replacement,
+								  uint32 length);
+static PB_CompressedSequence* overlay_index_parts(const PB_CompressedSequence* input,
+												  PB_CodeSet* codeset,
+												  const PB_EncodingMap* map,
+												  uint32 position,
+												  const uint8* replacement,
+												  uint8* replaced,
+												  uint32 length,
+												  PB_CodeSet** fixed_codesets);
+static void overlay_composition(PB_CompressedSequence* seq,
+								const PB_CodeSet* codeset,
+								uint32 position,
+								const uint8* replacement,
+								const uint8* replaced,
+								uint32 length);
+static void init_chunk_encoder(PB_ChunkEncoder* encoder,
+							   PB_CompressedSequence* output,
+							   PB_CodeSet* codeset);
+static void encode_chunk(PB_ChunkEncoder* encoder,
+						 const uint8* input,
+						 uint32 length);
+static void finish_chunk_encoder(PB_ChunkEncoder* encoder);
+static void encode_pc_equal_length(uint8* input,
+								   PB_CompressedSequence* output,
+								   PB_CodeSet* codeset);
 static void encode_pc_idx(uint8* input,
 						  PB_CompressedSequence* output,
 						  PB_CodeSet* codeset);
@@ -72,6 +166,13 @@ static void encode_pc_rle(uint8* input,
 static void encode_pc_rle_idx(uint8* input,
 							  PB_CompressedSequence* output,
 							  PB_CodeSet* codeset);
+static uint64 encode_pc_rle_part(const uint8* input,
+								 uint32 length,
+								 const PB_EncodingMap* map,
+								 PB_CompressionBuffer* stream,
+								 PB_IndexEntry* index_pointer,
+								 int index_part_size,
+								 int index_counter);
 static void encode_pc_swp(uint8* input,
 						  PB_CompressedSequence* output,
 						  PB_CodeSet* codeset);
@@ -85,25 +186,29 @@ static void encode_pc_swp_rle_idx(uint8* input,
 								  PB_CompressedSequence* output,
 								  PB_CodeSet* codeset);
 
-static void decode_pc_idx(Varlena* input,
+static void decode_pc_idx(PB_DetoastCursor* cursor,
+						  const PB_CompressedSequence* header,
 						  uint8* output,
 						  uint32 start_position,
 						  uint32 output_length,
 						  PB_IndexEntry* start_entry,
 						  PB_CodeSet* codeset);
-static void decode_pc_rle_idx(Varlena* input,
+static void decode_pc_rle_idx(PB_DetoastCursor* cursor,
+							  const PB_CompressedSequence* header,
 							  uint8* output,
 							  uint32 start_position,
 							  uint32 output_length,
 							  PB_IndexEntry* start_entry,
 							  PB_CodeSet* codeset);
-static void decode_pc_swp_idx(Varlena* input,
+static void decode_pc_swp_idx(PB_DetoastCursor* cursor,
+							  const PB_CompressedSequence* header,
 							  uint8* output,
 							  uint32 start_position,
 							  uint32 output_length,
 							  PB_IndexEntry* start_entry,
 							  PB_CodeSet* codeset);
-static void decode_pc_swp_rle_idx(Varlena* input,
+static void decode_pc_swp_rle_idx(PB_DetoastCursor* cursor,
+								  const PB_CompressedSequence* header,
 								  uint8* output,
 								  uint32 start_position,
 								  uint32 output_length,
@@ -212,6 +317,39 @@ static void decode_pc_swp_rle_idx(Varlena* input,
 	} \
 }
 
+/**
+ * This macro reads as many characters as possible with one lookup
+ * in a multi-symbol decoding map. Unlike DECODE it always peeks into
+ * the next block, if there are less than PB_MULTI_DECODE_BIT_SIZE
+ * bits in the buffer, so input_pointer must point to readable memory.
+ * If the entry found holds no symbols, nothing has been consumed.
+ *
+ * Parameters:
+ * 	PB_CompressionBuffer* input_pointer : compressed sequence
+ * 	PB_CompressionBuffer buffer : compression buffer
+ * 	int bits_in_buffer : bits in compression buffer
+ * 	PB_MultiDecodingMap* entry : decoded symbols
+ * 	PB_MultiDecodingMap* multi_map : multi-symbol decoding map
+ */
+#define MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map) { \
+	PB_CompressionBuffer window = buffer; \
+	int length; \
+	if (bits_in_buffer < PB_MULTI_DECODE_BIT_SIZE) \
+		window |= *input_pointer >> bits_in_buffer; \
+	entry = &multi_map[window >> (PB_COMPRESSION_BUFFER_BIT_SIZE - PB_MULTI_DECODE_BIT_SIZE)]; \
+	length = entry->code_length; \
+	if (length <= bits_in_buffer) { \
+		bits_in_buffer -= length; \
+		buffer = buffer << length; \
+	} else { \
+		PB_CompressionBuffer next = *input_pointer; \
+		bits_in_buffer -= length; \
+		buffer = next << (-bits_in_buffer); \
+		bits_in_buffer += PB_COMPRESSION_BUFFER_BIT_SIZE; \
+		input_pointer++; \
+	} \
+}
+
 /**
  * This macro reads a given number of bits into a target variable.
  *
@@ -308,12 +446,18 @@ static PB_EncodingMap* get_encoding_map(const PB_CodeSet* codeset, int mode)
 }
 
 /**
- * get_decoding_map()
- * 		Creates a decoding map for a prefix code set.
+ * fill_decoding_map()
+ * 		Fills a decoding map for a prefix code set.
+ *
+ * 	PB_DecodingMap* map : map of size PB_DECODE_MAP_SIZE to fill
+ * 	PB_CodeSet* codeset : codeset to create map from
+ * 	int mode : PB_NO_SWAP_MAP fills normal map
+ * 			   PB_SWAP_MAP fills swap map
  */
- static PB_DecodingMap* get_decoding_map(const PB_CodeSet* codeset, int mode)
- {
-	PB_DecodingMap* map;
+static void fill_decoding_map(PB_DecodingMap* map,
+							  const PB_CodeSet* codeset,
+							  int mode)
+{
 	int i,j;
 	int from = 0;
 	int to = 0;
@@ -329,7 +473,6 @@ static PB_EncodingMap* get_encoding_map(const PB_CodeSet* codeset, int mode)
 		to = codeset->n_symbols;
 	}
 
-	map = (PB_DecodingMap*) palloc(PB_DECODE_MAP_SIZE * sizeof(PB_DecodingMap));
 	memset(map, 0xFF, PB_DECODE_MAP_SIZE * sizeof(PB_DecodingMap));
 
 	for (i = from; i < to; i++)
@@ -343,10 +486,151 @@ static PB_EncodingMap* get_encoding_map(const PB_CodeSet* codeset, int mode)
 			map[j].code_length = codeset->words[i].code_length;
 		}
 
-		PB_DEBUG2(errmsg("get_decoding_map(): i:%d lower_bound:%u upper_bound:%u symbol:%c code:%u length:%u/%ld",i,lower_bound,upper_bound,codeset->words[i].symbol,codeset->words[i].code,codeset->words[i].code_length, PB_PREFIX_CODE_BIT_SIZE));
+		PB_DEBUG2(errmsg("fill_decoding_map(): i:%d lower_bound:%u upper_bound:%u symbol:%c code:%u length:%u/%ld",i,lower_bound,upper_bound,codeset->words[i].symbol,codeset->words[i].code,codeset->words[i].code_length, PB_PREFIX_CODE_BIT_SIZE));
 	}
+}
 
-	return map;
+/**
+ * get_multi_decoding_map_from_maps()
+ * 		Creates a multi-symbol decoding map.
+ *
+ * 	The entries are derived from the single-symbol map by decoding
+ * 	every possible PB_MULTI_DECODE_BIT_SIZE-bit pattern greedily.
+ *
+ * 	PB_DecodingMaps* maps : decoding maps to derive the map from
+ * 	MemoryContext context : memory context to allocate the map in
+ */
+static PB_MultiDecodingMap* get_multi_decoding_map_from_maps(const PB_DecodingMaps* maps,
+															 MemoryContext context)
+{
+	PB_MultiDecodingMap* multi_map;
+	uint32 pattern;
+
+	PB_TRACE(errmsg("->get_multi_decoding_map_from_maps()"));
+
+	multi_map = (PB_MultiDecodingMap*) MemoryContextAllocZero(context,
+												PB_MULTI_DECODE_MAP_SIZE * sizeof(PB_MultiDecodingMap));
+
+	for (pattern = 0; pattern < PB_MULTI_DECODE_MAP_SIZE; pattern++)
+	{
+		PB_MultiDecodingMap* entry = &multi_map[pattern];
+		int bits_used = 0;
+
+		while (entry->n_symbols < PB_MULTI_DECODE_MAX_SYMBOLS)
+		{
+			/*
+			 * Bits beyond the pattern are zero, but only codes that lie
+			 * completely within the pattern are accepted.
+			 */
+			const PB_DecodingMap* word = &maps->map[((pattern << bits_used) & (PB_MULTI_DECODE_MAP_SIZE - 1)) >>
+												   (PB_MULTI_DECODE_BIT_SIZE - PB_PREFIX_CODE_BIT_SIZE)];
+
+			if (word->code_length == 0 ||
+				word->code_length > PB_MULTI_DECODE_BIT_SIZE - bits_used)
+				break;
+
+			if ((maps->uses_rle && word->symbol == PB_RUN_LENGTH_SYMBOL) ||
+				(maps->uses_swapping && word->symbol == maps->master_symbol))
+				break;
+
+			entry->symbols[entry->n_symbols] = word->symbol;
+			entry->n_symbols++;
+			bits_used += word->code_length;
+		}
+
+		entry->code_length = bits_used;
+	}
+
+	PB_TRACE(errmsg("<-get_multi_decoding_map_from_maps()"));
+
+	return multi_map;
+}
+
+/*
+ * Decoding map cache
+ *
+ * Fixed code sets are static, so their maps are looked up by address.
+ * Maps of sequence specific code sets are looked up by the content of
+ * the code and replaced round-robin. Pins are dropped at the end of
+ * each transaction, that way maps pinned by an aborted decoding are
+ * not lost for the cache.
+ */
+#define PB_MAX_CACHED_FIXED_CODES	64
+#define PB_MAX_CACHED_CODES			16
+
+static PB_DecodingMaps* fixed_decoding_maps[PB_MAX_CACHED_FIXED_CODES];
+static int n_fixed_decoding_maps = 0;
+
+static PB_DecodingMaps* cached_decoding_maps[PB_MAX_CACHED_CODES];
+static int next_decoding_maps_victim = 0;
+static bool decoding_maps_callback_registered = FALSE;
+
+/**
+ * get_code_hash()
+ * 		FNV-1a hash of the codewords of a code set.
+ */
+static uint32 get_code_hash(const PB_CodeSet* codeset)
+{
+	const uint8* pointer = (const uint8*) codeset->words;
+	const uint8* end = pointer + codeset->n_symbols * sizeof(PB_Codeword);
+	uint32 hash = 2166136261u;
+
+	hash = (hash ^ codeset->n_swapped_symbols) * 16777619u;
+	hash = (hash ^ codeset->uses_rle) * 16777619u;
+
+	while (pointer < end)
+	{
+		hash = (hash ^ *pointer) * 16777619u;
+		pointer++;
+	}
+
+	return hash;
+}
+
+/**
+ * init_decoding_maps()
+ * 		Builds the single-symbol maps and stores the cache key.
+ */
+static void init_decoding_maps(PB_DecodingMaps* maps,
+							   const PB_CodeSet* codeset)
+{
+	PB_COUNT(decoding_map_builds, 1);
+
+	fill_decoding_map(maps->map, codeset, PB_NO_SWAP_MAP);
+	fill_decoding_map(maps->swap_map, codeset, PB_SWAP_MAP);
+
+	maps->multi_map = NULL;
+	maps->uses_rle = codeset->uses_rle;
+	maps->uses_swapping = codeset->n_swapped_symbols > 0;
+	maps->master_symbol = maps->uses_swapping ?
+						  codeset->words[codeset->n_symbols - codeset->n_swapped_symbols].symbol :
+						  0;
+	maps->is_cached = FALSE;
+	maps->pin_count = 0;
+
+	maps->fixed_codeset = codeset->is_fixed ? codeset : NULL;
+	maps->hash = get_code_hash(codeset);
+	maps->n_symbols = codeset->n_symbols;
+	maps->n_swapped_symbols = codeset->n_swapped_symbols;
+	memcpy(maps->words, codeset->words, codeset->n_symbols * sizeof(PB_Codeword));
+}
+
+/**
+ * decoding_maps_xact_callback()
+ * 		Drops all pins at the end of a transaction.
+ */
+static void decoding_maps_xact_callback(XactEvent event, void* arg)
+{
+	int i;
+
+	if (event != XACT_EVENT_COMMIT &&
+		event != XACT_EVENT_ABORT &&
+		event != XACT_EVENT_PREPARE)
+		return;
+
+	for (i = 0; i < PB_MAX_CACHED_CODES; i++)
+		if (cached_decoding_maps[i])
+			cached_decoding_maps[i]->pin_count = 0;
 }
 
 /**
@@ -416,250 +700,1063 @@ static void encode_pc(uint8* input,
  }
 
 /**
- * encode_pc_idx()
- *	 	Encode a sequence with a huffman code and an index.
+ * get_input_crc32()
+ * 		Computes the CRC32 of a sequence before encoding. Symbols are
+ * 		mapped to the symbols of their codewords, so the result is the
+ * 		CRC32 of the decoded sequence.
+ *
+ * 	uint8* input : input sequence
+ * 	uint32 length : length of the input sequence
+ * 	PB_CodeSet* codeset : codeset for encoding
  */
-static void encode_pc_idx(uint8* input,
-						  PB_CompressedSequence* output,
-						  PB_CodeSet* codeset)
+static uint32 get_input_crc32(const uint8* input,
+							  uint32 length,
+							  const PB_CodeSet* codeset)
 {
-	const PB_EncodingMap* map = get_encoding_map(codeset, PB_NO_SWAP_MAP);
+	uint8 symbols[PB_PACK_MAP_SIZE];
 
-	PB_CompressionBuffer buffer = 0;
-	int bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
-	int i = output->sequence_length - 1;
-	int index_counter = PB_INDEX_PART_SIZE - 1;
+	if (codeset->ignore_case)
+	{
+		get_crc32_symbols(codeset, symbols);
+		return PB_CRC32_FINAL(update_input_crc32(PB_CRC32_INIT, input, length, symbols));
+	}
 
-	uint8* input_pointer = input;
-	PB_CompressionBuffer* stream_start = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output);
-	PB_CompressionBuffer* output_pointer = stream_start;
-	PB_IndexEntry* index_pointer = PB_COMPRESSED_SEQUENCE_INDEX_POINTER(output);
+	return PB_CRC32_FINAL(update_input_crc32(PB_CRC32_INIT, input, length, NULL));
+}
 
-	PB_TRACE(errmsg("->encode_pc_idx()\n\toutput at:%p\n\tstream at:%p\n\tindex at:%p", output, stream_start, index_pointer));
+/**
+ * get_crc32_symbols()
+ * 		Maps both cases of the symbols of a code ignoring case to the
+ * 		symbols of their codewords.
+ *
+ * 	PB_CodeSet* codeset : codeset ignoring case
+ * 	uint8* symbols : output parameter, PB_PACK_MAP_SIZE entries
+ */
+static void get_crc32_symbols(const PB_CodeSet* codeset,
+							  uint8* symbols)
+{
+	int i;
 
-	while (i >= 0)
+	for (i = 0; i < PB_PACK_MAP_SIZE; i++)
+		symbols[i] = i;
+
+	for (i = 0; i < codeset->n_symbols; i++)
 	{
-		const uint8 current = *input_pointer;
-		const PB_PrefixCode code = map[current].code;
-		const int code_length = map[current].code_length;
+		const uint8 symbol = codeset->words[i].symbol;
 
-		index_counter--;
-		if (index_counter < 0)
-		{
-			index_counter += PB_INDEX_PART_SIZE;
-			if (bits_free > 0)
-			{
-				index_pointer->bit = PB_COMPRESSION_BUFFER_BIT_SIZE - bits_free;
-				index_pointer->block = output_pointer - stream_start;
-			}
-			else
-			{
-				index_pointer->bit = 0;
-				index_pointer->block = (output_pointer + 1) - stream_start;
-			}
-			PB_DEBUG3(errmsg("IDX block:%u bit:%d", index_pointer->block, index_pointer->bit));
-			index_pointer++;
-		}
+		symbols[TO_UPPER(symbol)] = symbol;
+		symbols[TO_LOWER(symbol)] = symbol;
+	}
+}
 
-		ENCODE(code, code_length, buffer, bits_free, output_pointer);
-		input_pointer++;
-		i--;
+/**
+ * update_input_crc32()
+ * 		Adds part of a sequence to a running CRC32.
+ *
+ * 	uint32 crc : running CRC32
+ * 	uint8* input : part of the input sequence
+ * 	uint32 length : length of the part
+ * 	uint8* symbols : map from get_crc32_symbols() or NULL
+ */
+static uint32 update_input_crc32(uint32 crc,
+								 const uint8* input,
+								 uint32 length,
+								 const uint8* symbols)
+{
+	uint8 chunk[PB_CRC32_CHUNK_SIZE];
+	int i;
 
-		PB_DEBUG3(errmsg("OUT i:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, code, code_length, current, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_free));
+	if (!symbols)
+		return crc32_update(crc, input, length);
+
+	while (length > 0)
+	{
+		const uint32 chunk_length = Min(length, PB_CRC32_CHUNK_SIZE);
+
+		for (i = 0; i < chunk_length; i++)
+			chunk[i] = symbols[input[i]];
+
+		crc = crc32_update(crc, chunk, chunk_length);
+		input += chunk_length;
+		length -= chunk_length;
 	}
 
-	/*
-	 * Flush buffer.
-	 */
-	if (bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
-		*output_pointer = (buffer << bits_free);
+	return crc;
+}
 
-	pfree((PB_EncodingMap*) map);
+/**
+ * encode_composition()
+ * 		Counts the symbols of a sequence before encoding and stores
+ * 		the counts behind the stream.
+ *
+ * 	uint8* input : input sequence
+ * 	PB_CompressedSequence* output : sequence with has_composition set
+ * 	PB_CodeSet* codeset : codeset for encoding
+ */
+static void encode_composition(const uint8* input,
+							   PB_CompressedSequence* output,
+							   const PB_CodeSet* codeset)
+{
+	const uint32 length = output->sequence_length;
+	const int n_rows = PB_COMPOSITION_N_ROWS(length);
+	uint32 counts[PB_SOURCE_ALPHABET_SIZE];
+	uint32* row;
+	uint32 position = 0;
+	int r;
 
-#ifdef DEBUG
-	if (((uint8*)output_pointer) - ((uint8*) output) >= VARSIZE(output)
-			&& bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
+	PB_TRACE(errmsg("->encode_composition()"));
+
+	row = (uint32*) (((uint8*) output) +
+		  PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(output, VARSIZE(output), codeset->n_symbols));
+
+	memset(counts, 0, sizeof(counts));
+
+	for (r = 0; r < n_rows; r++)
 	{
-		ereport(ERROR,(errmsg("segmentation fault"),
-				errhint("Recognized in %s at line %d.", __FILE__, __LINE__),
-				errdetail("Output pointer %p is %ld bytes after a block of size %u.",
-				output_pointer,
-				(((uint8*)output_pointer) - ((uint8*) output))- VARSIZE(output),
-				VARSIZE(output))));
-	}
-#endif
+		const uint32 row_end = (r == n_rows - 1) ? length : position + PB_INDEX_PART_SIZE;
 
-	PB_TRACE(errmsg("<-encode_pc_idx(), output at %p (%d bits free)", output_pointer, bits_free));
+		for (; position < row_end; position++)
+			counts[input[position]]++;
+
+		write_composition_row(row, counts, codeset);
+
+		row += codeset->n_symbols;
+	}
 
+	PB_TRACE(errmsg("<-encode_composition()"));
 }
 
- /**
-  * encode_pc_rle()
-  * 		Encode a sequence with a huffman code and rle.
+/**
+ * write_composition_row()
+ * 		Stores the symbol counts of a prefix of a sequence as one row of
+ * 		the composition. Codes ignoring case count both cases for the
+ * 		symbol of their codeword.
+ *
+ * 	uint32* row : row to write, one entry per codeword
+ * 	uint32* counts : counts of all input symbols in the prefix
+ * 	PB_CodeSet* codeset : codeset for encoding
+ */
+static void write_composition_row(uint32* row,
+								  const uint32* counts,
+								  const PB_CodeSet* codeset)
+{
+	uint8 other_case[PB_SOURCE_ALPHABET_SIZE];
+	bool counted[PB_SOURCE_ALPHABET_SIZE];
+	int i;
 
-  */
-static void encode_pc_rle(uint8* input,
-						  PB_CompressedSequence* output,
-						  PB_CodeSet* codeset)
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+		other_case[i] = i;
+	if (codeset->ignore_case)
+		for (i = 0; i < codeset->n_symbols; i++)
+		{
+			const uint8 symbol = codeset->words[i].symbol;
+
+			other_case[symbol] = (TO_UPPER(symbol) == symbol) ? TO_LOWER(symbol) : TO_UPPER(symbol);
+		}
+
+	memset(counted, 0, sizeof(counted));
+	for (i = 0; i < codeset->n_symbols; i++)
+	{
+		const uint8 symbol = codeset->words[i].symbol;
+
+		if (counted[symbol])
+		{
+			row[i] = 0;
+		}
+		else
+		{
+			row[i] = counts[symbol];
+			if (other_case[symbol] != symbol)
+				row[i] += counts[other_case[symbol]];
+			counted[symbol] = TRUE;
+		}
+	}
+}
+
+/**
+ * get_equal_length_codes()
+ * 		Builds the map from symbols to codes used by pack_equal_length().
+ *
+ * 	PB_CodeSet* codeset : code with equal length codewords
+ * 	uint8* codes : output parameter, PB_PACK_MAP_SIZE entries
+ */
+static void get_equal_length_codes(PB_CodeSet* codeset,
+								   uint8* codes)
 {
 	const PB_EncodingMap* map = get_encoding_map(codeset, PB_NO_SWAP_MAP);
-	const int rlecode_length = map[PB_RUN_LENGTH_SYMBOL].code_length;
-
-	PB_CompressionBuffer buffer = 0;
-	int bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
-	int i = output->sequence_length - 1;
-	int repeated_chars = 0;
+	int i;
 
-	uint8 recent = 0;
+	memset(codes, 0, PB_PACK_MAP_SIZE);
+	for (i = 0; i < PB_ASCII_SIZE; i++)
+		if (map[i].code_length != 0xFF)
+			codes[i] = map[i].code;
 
-	uint8* input_pointer = input;
-	PB_CompressionBuffer* output_pointer = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output);
+	pfree((PB_EncodingMap*) map);
+}
 
-	PB_TRACE(errmsg("->encode_pc_rle()"));
+/**
+ * append_stream()
+ * 		Appends the stream of a sequence to a stream, which ends with
+ * 		zeroed padding.
+ *
+ * 	PB_CompressionBuffer* stream : stream to append to, with space for total_bits
+ * 	uint64 stream_bits : number of bits already in the stream
+ * 	uint64 total_bits : number of bits after appending
+ * 	PB_CompressionBuffer* source : stream to append, with zeroed padding
+ */
+static void append_stream(PB_CompressionBuffer* stream,
+						  uint64 stream_bits,
+						  uint64 total_bits,
+						  const PB_CompressionBuffer* source)
+{
+	const uint64 first_block = stream_bits / PB_COMPRESSION_BUFFER_BIT_SIZE;
+	const uint64 n_blocks = PB_ALIGN_BIT_SIZE(total_bits) / PB_COMPRESSION_BUFFER_BIT_SIZE;
+	const uint64 n_source_bits = total_bits - stream_bits;
+	const uint64 n_source_blocks = PB_ALIGN_BIT_SIZE(n_source_bits) / PB_COMPRESSION_BUFFER_BIT_SIZE;
+	const int shift = stream_bits % PB_COMPRESSION_BUFFER_BIT_SIZE;
+	uint64 i;
+
+	if (shift == 0)
+	{
+		memcpy(stream + first_block, source, n_source_blocks * sizeof(PB_CompressionBuffer));
+		return;
+	}
 
 	/*
-	 * Read first char.
+	 * Each block of the source fills the free end of one block and
+	 * starts the next one. Spills beyond the stream only hold padding.
 	 */
-	recent = *input_pointer;
-	input_pointer++;
-	i--;
-
-	while (i >= 0)
+	for (i = 0; i < n_source_blocks; i++)
 	{
-		const uint8 current = *input_pointer;
-		input_pointer++;
-		repeated_chars++;
-		i--;
-
-		if (current != recent || repeated_chars >= PB_MAX_RUN_LENGTH - 1)
-		{
-			encode_pc_rle_out:
-			if (repeated_chars < PB_MIN_RUN_LENGTH)
-			{
-				/*
-				 * too few repeated chars to write an RLE word -> write out sequentially
-				 */
-				const PB_PrefixCode code = map[recent].code;
-				const int code_length = map[recent].code_length;
-					int k = repeated_chars - 1;
+		stream[first_block + i] |= source[i] >> shift;
+		if (first_block + i + 1 < n_blocks)
+			stream[first_block + i + 1] = source[i] << (PB_COMPRESSION_BUFFER_BIT_SIZE - shift);
+	}
+}
 
-				while (k >= 0)
-				{
-					k--;
-					ENCODE(code, code_length, buffer, bits_free, output_pointer);
-					PB_DEBUG3(errmsg("OUT i:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, code, code_length, recent, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_free));
-				}
-			}
-			else
-			{
-				/*
-				 * enough repeated chars to write an RLE word
-				 */
-				const int recent_length = map[recent].code_length;
-				const int code_length = recent_length +
-									rlecode_length +
-									PB_RUN_LENGTH_BIT_SIZE;
-				const PB_CompressionBuffer code = ((PB_CompressionBuffer) map[PB_RUN_LENGTH_SYMBOL].code <<
-													(
-														PB_RUN_LENGTH_BIT_SIZE +
-														recent_length
-													)
-												) |
-												(((PB_CompressionBuffer) (repeated_chars - PB_MIN_RUN_LENGTH)) <<
-														recent_length
-												) |
-												((PB_CompressionBuffer) map[recent].code
-												);
-				ENCODE(code, code_length, buffer, bits_free, output_pointer);
-				PB_DEBUG3(errmsg("RLE i:%d val:%lu len:%u s:%c buf:%08X%08X bib:%d", i, code, code_length, recent, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_free));
-			}
-			recent = current;
-			repeated_chars = 0;
+/**
+ * reverse_fields()
+ * 		Reverses the order of the fields of a block, keeping the
+ * 		order of the bits in each field.
+ *
+ * 	PB_CompressionBuffer block : block to reverse
+ * 	int field_bits : size of a field, a power of two smaller than the block
+ */
+static PB_CompressionBuffer reverse_fields(PB_CompressionBuffer block,
+										   int field_bits)
+{
+	if (field_bits < 2)
+		block = ((block >> 1) & UINT64CONST(0x5555555555555555)) |
+				((block & UINT64CONST(0x5555555555555555)) << 1);
+	if (field_bits < 4)
+		block = ((block >> 2) & UINT64CONST(0x3333333333333333)) |
+				((block & UINT64CONST(0x3333333333333333)) << 2);
+	if (field_bits < 8)
+		block = ((block >> 4) & UINT64CONST(0x0F0F0F0F0F0F0F0F)) |
+				((block & UINT64CONST(0x0F0F0F0F0F0F0F0F)) << 4);
+	if (field_bits < 16)
+		block = ((block >> 8) & UINT64CONST(0x00FF00FF00FF00FF)) |
+				((block & UINT64CONST(0x00FF00FF00FF00FF)) << 8);
+	if (field_bits < 32)
+		block = ((block >> 16) & UINT64CONST(0x0000FFFF0000FFFF)) |
+				((block & UINT64CONST(0x0000FFFF0000FFFF)) << 16);
+
+	return (block >> 32) | (block << 32);
+}
+
+/**
+ * reverse_packed_stream()
+ * 		Writes the reversed stream of a sequence encoded with a code of
+ * 		equal length codewords, whose length divides the block size.
+ * 		Blocks are reversed field by field in reverse order. Then the
+ * 		padding, which is in front now, is shifted out.
+ *
+ * 	PB_CompressedSequence* input : detoasted sequence
+ * 	PB_CompressedSequence* output : sequence of the same length and code
+ * 	int code_length : length of the codewords
+ */
+static void reverse_packed_stream(const PB_CompressedSequence* input,
+								  PB_CompressedSequence* output,
+								  int code_length)
+{
+	const uint64 n_bits = (uint64) input->sequence_length * code_length;
+	const uint32 n_blocks = PB_ALIGN_BIT_SIZE(n_bits) / PB_COMPRESSION_BUFFER_BIT_SIZE;
+	const int padding = (uint64) n_blocks * PB_COMPRESSION_BUFFER_BIT_SIZE - n_bits;
+	const PB_CompressionBuffer* in = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(input);
+	PB_CompressionBuffer* out = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output);
+	uint32 i;
+
+	for (i = 0; i < n_blocks; i++)
+		out[i] = reverse_fields(in[n_blocks - 1 - i], code_length);
+
+	if (padding > 0)
+	{
+		for (i = 0; i + 1 < n_blocks; i++)
+			out[i] = (out[i] << padding) | (out[i + 1] >> (PB_COMPRESSION_BUFFER_BIT_SIZE - padding));
+		out[n_blocks - 1] <<= padding;
+	}
+}
+
+/**
+ * copy_stream_bits()
+ * 		Copies bits of a stream into a zeroed stream at any bit offset.
+ *
+ * 	PB_CompressionBuffer* stream : zeroed stream to copy to
+ * 	uint64 stream_bit : first bit to write
+ * 	PB_CompressionBuffer* source : stream to copy from
+ * 	uint64 source_bit : first bit to copy
+ * 	uint64 n_bits : number of bits to copy
+ */
+static void copy_stream_bits(PB_CompressionBuffer* stream,
+							 uint64 stream_bit,
+							 const PB_CompressionBuffer* source,
+							 uint64 source_bit,
+							 uint64 n_bits)
+{
+	while (n_bits > 0)
+	{
+		const int n = Min(n_bits, PB_COMPRESSION_BUFFER_BIT_SIZE);
+		const uint64 source_block = source_bit / PB_COMPRESSION_BUFFER_BIT_SIZE;
+		const int source_shift = source_bit % PB_COMPRESSION_BUFFER_BIT_SIZE;
+		const uint64 block = stream_bit / PB_COMPRESSION_BUFFER_BIT_SIZE;
+		const int shift = stream_bit % PB_COMPRESSION_BUFFER_BIT_SIZE;
+		PB_CompressionBuffer bits;
+
+		/*
+		 * Gather the next n bits left-aligned, without reading blocks
+		 * behind them.
+		 */
+		bits = source[source_block] << source_shift;
+		if (source_shift > 0 && source_shift + n > PB_COMPRESSION_BUFFER_BIT_SIZE)
+			bits |= source[source_block + 1] >> (PB_COMPRESSION_BUFFER_BIT_SIZE - source_shift);
+		if (n < PB_COMPRESSION_BUFFER_BIT_SIZE)
+			bits &= ~(~((PB_CompressionBuffer) 0) >> n);
+
+		stream[block] |= bits >> shift;
+		if (shift > 0 && shift + n > PB_COMPRESSION_BUFFER_BIT_SIZE)
+			stream[block + 1] |= bits << (PB_COMPRESSION_BUFFER_BIT_SIZE - shift);
+
+		source_bit += n;
+		stream_bit += n;
+		n_bits -= n;
+	}
+}
+
+/**
+ * overlay_packed_stream()
+ * 		Replaces characters of a sequence encoded with a code of equal
+ * 		length codewords and without RLE in place. Each character has
+ * 		its fixed place in the stream.
+ *
+ * 	PB_CompressedSequence* seq : detoasted copy of the sequence
+ * 	PB_EncodingMap* map : encoding map of the code
+ * 	int code_length : length of the codewords
+ * 	uint32 position : first position to replace, the first position is 0
+ * 	uint8* replacement : new characters, all with a codeword
+ * 	uint32 length : number of characters to replace
+ */
+static void overlay_packed_stream(PB_CompressedSequence* seq,
+								  const PB_EncodingMap* map,
+								  int code_length,
+								  uint32 position,
+								  const uint8* replacement,
+								  uint32 length)
+{
+	const PB_CompressionBuffer mask = (((PB_CompressionBuffer) 1) << code_length) - 1;
+	PB_CompressionBuffer* stream = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(seq);
+	uint64 bit = (uint64) position * code_length;
+	uint32 i;
+
+	for (i = 0; i < length; i++, bit += code_length)
+	{
+		const PB_CompressionBuffer code = map[replacement[i]].code;
+		const uint64 block = bit / PB_COMPRESSION_BUFFER_BIT_SIZE;
+		const int shift = bit % PB_COMPRESSION_BUFFER_BIT_SIZE;
+
+		if (shift + code_length <= PB_COMPRESSION_BUFFER_BIT_SIZE)
+		{
+			const int low = PB_COMPRESSION_BUFFER_BIT_SIZE - shift - code_length;
+
+			stream[block] = (stream[block] & ~(mask << low)) | (code << low);
+		}
+		else
+		{
+			const int spill = shift + code_length - PB_COMPRESSION_BUFFER_BIT_SIZE;
+
+			stream[block] = (stream[block] & ~(mask >> spill)) | (code >> spill);
+			stream[block + 1] = (stream[block + 1] & ~(mask << (PB_COMPRESSION_BUFFER_BIT_SIZE - spill))) |
+								(code << (PB_COMPRESSION_BUFFER_BIT_SIZE - spill));
 		}
 	}
+}
+
+/**
+ * overlay_index_parts()
+ * 		Replaces characters of a sequence encoded with a prefix code
+ * 		without swapping by encoding again only the index parts holding
+ * 		them. Returns NULL, if the result would be too large.
+ *
+ * 		Index entries without rle_shift start a codeword at their
+ * 		position, so the stream can be cut there. The parts holding the
+ * 		replaced characters are widened to such entries, decoded, patched
+ * 		and encoded from a fresh start. The streams in front and behind
+ * 		them are copied, later index entries are moved by the change of
+ * 		size. Without RLE the result is the same as encoding the patched
+ * 		sequence, with RLE runs are not joined across the cuts.
+ *
+ * 	PB_CompressedSequence* input : detoasted sequence
+ * 	PB_CodeSet* codeset : code of the sequence
+ * 	PB_EncodingMap* map : encoding map of the code
+ * 	uint32 position : first position to replace, the first position is 0
+ * 	uint8* replacement : new characters, all with a codeword
+ * 	uint8* replaced : output parameter, the replaced characters
+ * 	uint32 length : number of characters to replace, at least 1
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+static PB_CompressedSequence* overlay_index_parts(const PB_CompressedSequence* input,
+												  PB_CodeSet* codeset,
+												  const PB_EncodingMap* map,
+												  uint32 position,
+												  const uint8* replacement,
+												  uint8* replaced,
+												  uint32 length,
+												  PB_CodeSet** fixed_codesets)
+{
+	const uint32 sequence_length = input->sequence_length;
+	const int index_part_size = PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(input);
+	const int n_entries = PB_COMPRESSED_SEQUENCE_INDEX_N_ELEMENTS(input);
+	const PB_IndexEntry* index = PB_COMPRESSED_SEQUENCE_INDEX_POINTER(input);
+	const uint32 stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(input);
+	const uint32 composition_size = PB_COMPRESSED_SEQUENCE_COMPOSITION_SIZE(input, codeset->n_symbols);
+	PB_CompressedSequence* result;
+	PB_CompressionBuffer* part_stream;
+	PB_IndexEntry* part_index;
+	PB_IndexEntry* result_index;
+	uint8* part;
+	uint64 stream_bits;
+	uint64 start_bit;
+	uint64 end_bit;
+	uint64 part_bits;
+	uint64 result_size;
+	uint32 part_start;
+	uint32 part_end;
+	int first_part;
+	int last_part;
+	int index_counter;
+	int i;
 
 	/*
-	 * Last symbol.
-	 *
-	 * This is ugly. But the alternatives are:
-	 * 		a. another cmp + jmp in the loop -> cost 5% performance
-	 * 		b. repeating a bunch of lines -> even uglier
+	 * Part k ends in front of the position of entry k, the last part
+	 * ends with the sequence.
 	 */
-	if (i == (-1)) {
-		i--;
-		repeated_chars++;
-		PB_DEBUG3(errmsg("last symbol"));
-		goto encode_pc_rle_out;
+	first_part = Min((position + 1) / index_part_size, n_entries);
+	last_part = Min((position + length) / index_part_size, n_entries);
+
+	while (first_part > 0 && index[first_part - 1].rle_shift > 0)
+		first_part--;
+	while (last_part < n_entries && index[last_part].rle_shift > 0)
+		last_part++;
+
+	/*
+	 * The end of the stream is known from the composition without RLE.
+	 * RLE streams are copied including their padding.
+	 */
+	if (codeset->uses_rle)
+		stream_bits = (uint64) (VARSIZE(input) - stream_offset - composition_size) * 8;
+	else if (input->has_composition)
+	{
+		const uint32* last_row = (uint32*) (((uint8*) input) +
+			PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(input, VARSIZE(input), codeset->n_symbols)) +
+			(PB_COMPOSITION_N_ROWS(sequence_length) - 1) * codeset->n_symbols;
+
+		stream_bits = 0;
+		for (i = 0; i < codeset->n_symbols; i++)
+			stream_bits += (uint64) last_row[i] * codeset->words[i].code_length;
 	}
+	else
+	{
+		stream_bits = 0;
+		last_part = n_entries;
+	}
+
+	part_start = (first_part == 0) ? 0 : first_part * index_part_size - 1;
+	part_end = (last_part == n_entries) ? sequence_length : (last_part + 1) * index_part_size - 1;
+	start_bit = (first_part == 0) ? 0 : PB_INDEX_ENTRY_BIT(index[first_part - 1]);
+	end_bit = (last_part == n_entries) ? stream_bits : PB_INDEX_ENTRY_BIT(index[last_part]);
+
+	if (end_bit > stream_bits)
+		stream_bits = end_bit;
+
+	PB_DEBUG1(errmsg("overlay_index_parts(): encodes parts %d to %d, characters %u to %u",
+					 first_part, last_part, part_start, part_end));
+
+	part = palloc(part_end - part_start);
+	decode((Varlena*) input, part, part_start, part_end - part_start, fixed_codesets);
+	memcpy(replaced, part + (position - part_start), length);
+	memcpy(part + (position - part_start), replacement, length);
 
 	/*
-	 * Flush buffer.
+	 * A run still takes more bits than its characters would, if
+	 * codewords have one bit.
 	 */
-	if (bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
-		*output_pointer = (buffer << bits_free);
+	part_stream = palloc0(PB_ALIGN_BIT_SIZE(((uint64) (part_end - part_start) *
+						  (codeset->max_codeword_length + (codeset->uses_rle ? 2 : 0)))) / 8 +
+						  sizeof(PB_CompressionBuffer));
+	part_index = palloc0(Max(last_part - first_part, 1) * sizeof(PB_IndexEntry));
+	index_counter = (first_part < n_entries) ?
+					(first_part + 1) * index_part_size - 1 - part_start :
+					part_end - part_start;
 
-	pfree((PB_EncodingMap*) map);
+	if (codeset->uses_rle)
+	{
+		part_bits = encode_pc_rle_part(part,
+									   part_end - part_start,
+									   map,
+									   part_stream,
+									   part_index,
+									   index_part_size,
+									   index_counter);
+	}
+	else
+	{
+		PB_ChunkEncoder encoder;
+
+		encoder.map = get_encoding_map(codeset, PB_NO_SWAP_MAP);
+		encoder.buffer = 0;
+		encoder.bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
+		encoder.stream_start = part_stream;
+		encoder.output_pointer = part_stream;
+		encoder.index_pointer = part_index;
+		encoder.index_part_size = index_part_size;
+		encoder.index_counter = index_counter;
+
+		encode_chunk(&encoder, part, part_end - part_start);
+		finish_chunk_encoder(&encoder);
+
+		part_bits = (uint64) (encoder.output_pointer - part_stream) * PB_COMPRESSION_BUFFER_BIT_SIZE +
+					(PB_COMPRESSION_BUFFER_BIT_SIZE - encoder.bits_free);
+	}
 
-#ifdef DEBUG
-	if (((uint8*)output_pointer) - ((uint8*) output) >= VARSIZE(output)
-			&& bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE) {
-		ereport(ERROR,(errmsg("segmentation fault"),
-				errhint("Recognized in %s at line %d.", __FILE__, __LINE__),
-				errdetail("Output pointer %p is %ld bytes after a block of size %u.",
-				output_pointer,
-				(((uint8*)output_pointer) - ((uint8*) output))- VARSIZE(output),
-				VARSIZE(output))));
+	pfree(part);
+
+	result_size = (uint64) stream_offset +
+				  PB_ALIGN_BIT_SIZE((start_bit + part_bits + (stream_bits - end_bit))) / 8 +
+				  composition_size;
+	if (result_size > PB_MAX_COMPRESSED_SEQUENCE_SIZE)
+	{
+		pfree(part_stream);
+		pfree(part_index);
+		return NULL;
 	}
-#endif
 
-	PB_TRACE(errmsg("<-encode_pc_rle()--%d", bits_free));
- }
+	result = palloc0(result_size);
+	memcpy(result, input, stream_offset);
+	SET_VARSIZE(result, result_size);
 
- /**
-  * encode_pc_rle_idx()
-  * 		Encode a sequence with a huffman code, run-length encoding and an index
-  *
+	copy_stream_bits(PB_COMPRESSED_SEQUENCE_STREAM_POINTER(result), 0,
+					 PB_COMPRESSED_SEQUENCE_STREAM_POINTER(input), 0,
+					 start_bit);
+	copy_stream_bits(PB_COMPRESSED_SEQUENCE_STREAM_POINTER(result), start_bit,
+					 part_stream, 0,
+					 part_bits);
+	copy_stream_bits(PB_COMPRESSED_SEQUENCE_STREAM_POINTER(result), start_bit + part_bits,
+					 PB_COMPRESSED_SEQUENCE_STREAM_POINTER(input), end_bit,
+					 stream_bits - end_bit);
+
+	memcpy(((uint8*) result) + PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(result, result_size, codeset->n_symbols),
+		   ((uint8*) input) + PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(input, VARSIZE(input), codeset->n_symbols),
+		   composition_size);
+
+	/*
+	 * Entries of the encoded parts count from their start, later
+	 * entries move with the end of the parts.
+	 */
+	result_index = PB_COMPRESSED_SEQUENCE_INDEX_POINTER(result);
+	for (i = first_part; i < n_entries; i++)
+	{
+		const PB_IndexEntry* entry = (i < last_part) ? &part_index[i - first_part] : &index[i];
+		const uint64 bit = (i < last_part) ?
+						   start_bit + PB_INDEX_ENTRY_BIT(*entry) :
+						   PB_INDEX_ENTRY_BIT(*entry) - end_bit + start_bit + part_bits;
+
+		result_index[i].block = bit / PB_COMPRESSION_BUFFER_BIT_SIZE;
+		result_index[i].bit = bit % PB_COMPRESSION_BUFFER_BIT_SIZE;
+		result_index[i].rle_shift = entry->rle_shift;
+		result_index[i].swap_shift = 0;
+	}
+
+	pfree(part_stream);
+	pfree(part_index);
+
+	return result;
+}
+
+/**
+ * overlay_composition()
+ * 		Updates the rows of the composition of a sequence holding
+ * 		replaced characters.
+ *
+ * 	PB_CompressedSequence* seq : sequence, possibly without composition
+ * 	PB_CodeSet* codeset : code of the sequence
+ * 	uint32 position : first replaced position, the first position is 0
+ * 	uint8* replacement : new characters, symbols of codewords
+ * 	uint8* replaced : old characters
+ * 	uint32 length : number of replaced characters
  */
-static void encode_pc_rle_idx(uint8* input,
-							  PB_CompressedSequence* output,
-							  PB_CodeSet* codeset)
+static void overlay_composition(PB_CompressedSequence* seq,
+								const PB_CodeSet* codeset,
+								uint32 position,
+								const uint8* replacement,
+								const uint8* replaced,
+								uint32 length)
+{
+	const int n_rows = PB_COMPOSITION_N_ROWS(seq->sequence_length);
+	const uint32 end = position + length;
+	int column[PB_SOURCE_ALPHABET_SIZE];
+	int32* delta;
+	uint32* row;
+	uint32 p = position;
+	int r;
+	int i;
+
+	if (!seq->has_composition)
+		return;
+
+	row = (uint32*) (((uint8*) seq) +
+		  PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(seq, VARSIZE(seq), codeset->n_symbols));
+	delta = palloc0(codeset->n_symbols * sizeof(int32));
+
+	for (i = codeset->n_symbols - 1; i >= 0; i--)
+		column[codeset->words[i].symbol] = i;
+
+	/*
+	 * Row r counts the first (r + 1) * PB_INDEX_PART_SIZE characters,
+	 * the last one all.
+	 */
+	for (r = position / PB_INDEX_PART_SIZE; r < n_rows; r++)
+	{
+		const uint32 row_end = (r == n_rows - 1) ? end : Min(end, (uint64) (r + 1) * PB_INDEX_PART_SIZE);
+
+		for (; p < row_end; p++)
+		{
+			delta[column[replaced[p - position]]]--;
+			delta[column[replacement[p - position]]]++;
+		}
+
+		for (i = 0; i < codeset->n_symbols; i++)
+			row[r * codeset->n_symbols + i] += delta[i];
+	}
+
+	pfree(delta);
+}
+
+/**
+ * init_chunk_encoder()
+ * 		Prepares encoding a sequence chunk by chunk with a prefix code
+ * 		without swapping and RLE.
+ *
+ * 	PB_ChunkEncoder* encoder : encoder to initialize
+ * 	PB_CompressedSequence* output : sequence from init_compressed_sequence()
+ * 	PB_CodeSet* codeset : codeset for encoding
+ */
+static void init_chunk_encoder(PB_ChunkEncoder* encoder,
+							   PB_CompressedSequence* output,
+							   PB_CodeSet* codeset)
+{
+	encoder->map = get_encoding_map(codeset, PB_NO_SWAP_MAP);
+	encoder->buffer = 0;
+	encoder->bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
+	encoder->stream_start = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output);
+	encoder->output_pointer = encoder->stream_start;
+	encoder->index_pointer = output->has_index ? PB_COMPRESSED_SEQUENCE_INDEX_POINTER(output) : NULL;
+	encoder->index_part_size = PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(output);
+	encoder->index_counter = encoder->index_part_size - 1;
+}
+
+/**
+ * encode_chunk()
+ * 		Encodes the next chunk of a sequence.
+ *
+ * 	PB_ChunkEncoder* encoder : encoder from init_chunk_encoder()
+ * 	uint8* input : next chunk of the input sequence
+ * 	uint32 length : length of the chunk
+ */
+static void encode_chunk(PB_ChunkEncoder* encoder,
+						 const uint8* input,
+						 uint32 length)
+{
+	const PB_EncodingMap* map = encoder->map;
+	PB_CompressionBuffer buffer = encoder->buffer;
+	int bits_free = encoder->bits_free;
+	PB_CompressionBuffer* output_pointer = encoder->output_pointer;
+	uint32 i;
+
+	for (i = 0; i < length; i++)
+	{
+		const PB_PrefixCode code = map[input[i]].code;
+		const int code_length = map[input[i]].code_length;
+
+		if (encoder->index_pointer && --encoder->index_counter < 0)
+		{
+			encoder->index_counter += encoder->index_part_size;
+			if (bits_free > 0)
+			{
+				encoder->index_pointer->bit = PB_COMPRESSION_BUFFER_BIT_SIZE - bits_free;
+				encoder->index_pointer->block = output_pointer - encoder->stream_start;
+			}
+			else
+			{
+				encoder->index_pointer->bit = 0;
+				encoder->index_pointer->block = (output_pointer + 1) - encoder->stream_start;
+			}
+			encoder->index_pointer++;
+		}
+
+		ENCODE(code, code_length, buffer, bits_free, output_pointer);
+	}
+
+	encoder->buffer = buffer;
+	encoder->bits_free = bits_free;
+	encoder->output_pointer = output_pointer;
+}
+
+/**
+ * finish_chunk_encoder()
+ * 		Flushes the buffer of an encoder and frees it.
+ *
+ * 	PB_ChunkEncoder* encoder : encoder from init_chunk_encoder()
+ */
+static void finish_chunk_encoder(PB_ChunkEncoder* encoder)
+{
+	if (encoder->bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
+		*encoder->output_pointer = (encoder->buffer << encoder->bits_free);
+
+	pfree((PB_EncodingMap*) encoder->map);
+}
+
+/**
+ * encode_pc_equal_length()
+ * 		Encodes a sequence with a code, where all codewords have
+ * 		the same length.
+ */
+static void encode_pc_equal_length(uint8* input,
+								   PB_CompressedSequence* output,
+								   PB_CodeSet* codeset)
+{
+	uint8 codes[PB_PACK_MAP_SIZE];
+
+	PB_TRACE(errmsg("->encode_pc_equal_length(), len=%d", output->sequence_length));
+
+	get_equal_length_codes(codeset, codes);
+
+	pack_equal_length(input,
+					  output->sequence_length,
+					  codes,
+					  codeset->max_codeword_length,
+					  PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output));
+
+	PB_TRACE(errmsg("<-encode_pc_equal_length()"));
+}
+
+/**
+ * encode_pc_idx()
+ *	 	Encode a sequence with a huffman code and an index.
+ */
+static void encode_pc_idx(uint8* input,
+						  PB_CompressedSequence* output,
+						  PB_CodeSet* codeset)
 {
 	const PB_EncodingMap* map = get_encoding_map(codeset, PB_NO_SWAP_MAP);
-	const int rlecode_length = map[PB_RUN_LENGTH_SYMBOL].code_length;
 
 	PB_CompressionBuffer buffer = 0;
 	int bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
 	int i = output->sequence_length - 1;
-	int index_counter = PB_INDEX_PART_SIZE - 1;
-	int repeated_chars = 0;
-
-	uint8 recent = 0;
+	const int index_part_size = PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(output);
+	int index_counter = index_part_size - 1;
 
 	uint8* input_pointer = input;
 	PB_CompressionBuffer* stream_start = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output);
 	PB_CompressionBuffer* output_pointer = stream_start;
 	PB_IndexEntry* index_pointer = PB_COMPRESSED_SEQUENCE_INDEX_POINTER(output);
 
-	PB_TRACE(errmsg("->encode_pc_rle_idx()"));
-
-	/*
-	 * Read first char.
-	 */
-	recent = *input_pointer;
-	input_pointer++;
-	i--;
+	PB_TRACE(errmsg("->encode_pc_idx()\n\toutput at:%p\n\tstream at:%p\n\tindex at:%p", output, stream_start, index_pointer));
 
 	while (i >= 0)
 	{
 		const uint8 current = *input_pointer;
+		const PB_PrefixCode code = map[current].code;
+		const int code_length = map[current].code_length;
 
-		repeated_chars++;
+		index_counter--;
+		if (index_counter < 0)
+		{
+			index_counter += index_part_size;
+			if (bits_free > 0)
+			{
+				index_pointer->bit = PB_COMPRESSION_BUFFER_BIT_SIZE - bits_free;
+				index_pointer->block = output_pointer - stream_start;
+			}
+			else
+			{
+				index_pointer->bit = 0;
+				index_pointer->block = (output_pointer + 1) - stream_start;
+			}
+			PB_DEBUG3(errmsg("IDX block:%u bit:%d", index_pointer->block, index_pointer->bit));
+			index_pointer++;
+		}
+
+		ENCODE(code, code_length, buffer, bits_free, output_pointer);
 		input_pointer++;
 		i--;
 
-		if (current != recent || repeated_chars >= PB_MAX_RUN_LENGTH - 1)
-		{
-			encode_pc_rle_idx_out:
+		PB_DEBUG3(errmsg("OUT i:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, code, code_length, current, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_free));
+	}
+
+	/*
+	 * Flush buffer.
+	 */
+	if (bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
+		*output_pointer = (buffer << bits_free);
+
+	pfree((PB_EncodingMap*) map);
+
+#ifdef DEBUG
+	if (((uint8*)output_pointer) - ((uint8*) output) >= VARSIZE(output)
+			&& bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
+	{
+		ereport(ERROR,(errmsg("segmentation fault"),
+				errhint("Recognized in %s at line %d.", __FILE__, __LINE__),
+				errdetail("Output pointer %p is %ld bytes after a block of size %u.",
+				output_pointer,
+				(((uint8*)output_pointer) - ((uint8*) output))- VARSIZE(output),
+				VARSIZE(output))));
+	}
+#endif
+
+	PB_TRACE(errmsg("<-encode_pc_idx(), output at %p (%d bits free)", output_pointer, bits_free));
+
+}
+
+ /**
+  * encode_pc_rle()
+  * 		Encode a sequence with a huffman code and rle.
+
+  */
+static void encode_pc_rle(uint8* input,
+						  PB_CompressedSequence* output,
+						  PB_CodeSet* codeset)
+{
+	const PB_EncodingMap* map = get_encoding_map(codeset, PB_NO_SWAP_MAP);
+	const int rlecode_length = map[PB_RUN_LENGTH_SYMBOL].code_length;
+
+	PB_CompressionBuffer buffer = 0;
+	int bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
+	int i = output->sequence_length - 1;
+	int repeated_chars = 0;
+
+	uint8 recent = 0;
+
+	uint8* input_pointer = input;
+	PB_CompressionBuffer* output_pointer = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output);
+
+	PB_TRACE(errmsg("->encode_pc_rle()"));
+
+	/*
+	 * Read first char.
+	 */
+	recent = *input_pointer;
+	input_pointer++;
+	i--;
+
+	while (i >= 0)
+	{
+		const uint8 current = *input_pointer;
+		input_pointer++;
+		repeated_chars++;
+		i--;
+
+		if (current != recent || repeated_chars >= PB_MAX_RUN_LENGTH - 1)
+		{
+			encode_pc_rle_out:
+			if (repeated_chars < PB_MIN_RUN_LENGTH)
+			{
+				/*
+				 * too few repeated chars to write an RLE word -> write out sequentially
+				 */
+				const PB_PrefixCode code = map[recent].code;
+				const int code_length = map[recent].code_length;
+					int k = repeated_chars - 1;
+
+				while (k >= 0)
+				{
+					k--;
+					ENCODE(code, code_length, buffer, bits_free, output_pointer);
+					PB_DEBUG3(errmsg("OUT i:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, code, code_length, recent, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_free));
+				}
+			}
+			else
+			{
+				/*
+				 * enough repeated chars to write an RLE word
+				 */
+				const int recent_length = map[recent].code_length;
+				const int code_length = recent_length +
+									rlecode_length +
+									PB_RUN_LENGTH_BIT_SIZE;
+				const PB_CompressionBuffer code = ((PB_CompressionBuffer) map[PB_RUN_LENGTH_SYMBOL].code <<
+													(
+														PB_RUN_LENGTH_BIT_SIZE +
+														recent_length
+													)
+												) |
+												(((PB_CompressionBuffer) (repeated_chars - PB_MIN_RUN_LENGTH)) <<
+														recent_length
+												) |
+												((PB_CompressionBuffer) map[recent].code
+												);
+				ENCODE(code, code_length, buffer, bits_free, output_pointer);
+				PB_DEBUG3(errmsg("RLE i:%d val:%lu len:%u s:%c buf:%08X%08X bib:%d", i, code, code_length, recent, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_free));
+			}
+			recent = current;
+			repeated_chars = 0;
+		}
+	}
+
+	/*
+	 * Last symbol.
+	 *
+	 * This is ugly. But the alternatives are:
+	 * 		a. another cmp + jmp in the loop -> cost 5% performance
+	 * 		b. repeating a bunch of lines -> even uglier
+	 */
+	if (i == (-1)) {
+		i--;
+		repeated_chars++;
+		PB_DEBUG3(errmsg("last symbol"));
+		goto encode_pc_rle_out;
+	}
+
+	/*
+	 * Flush buffer.
+	 */
+	if (bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
+		*output_pointer = (buffer << bits_free);
+
+	pfree((PB_EncodingMap*) map);
+
+#ifdef DEBUG
+	if (((uint8*)output_pointer) - ((uint8*) output) >= VARSIZE(output)
+			&& bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE) {
+		ereport(ERROR,(errmsg("segmentation fault"),
+				errhint("Recognized in %s at line %d.", __FILE__, __LINE__),
+				errdetail("Output pointer %p is %ld bytes after a block of size %u.",
+				output_pointer,
+				(((uint8*)output_pointer) - ((uint8*) output))- VARSIZE(output),
+				VARSIZE(output))));
+	}
+#endif
+
+	PB_TRACE(errmsg("<-encode_pc_rle()--%d", bits_free));
+ }
+
+ /**
+  * encode_pc_rle_idx()
+  * 		Encode a sequence with a huffman code, run-length encoding and an index
+  *
+ */
+static void encode_pc_rle_idx(uint8* input,
+							  PB_CompressedSequence* output,
+							  PB_CodeSet* codeset)
+{
+	const PB_EncodingMap* map = get_encoding_map(codeset, PB_NO_SWAP_MAP);
+	const int index_part_size = PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(output);
+	uint64 n_bits;
+
+	PB_TRACE(errmsg("->encode_pc_rle_idx()"));
+
+	n_bits = encode_pc_rle_part(input,
+								output->sequence_length,
+								map,
+								PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output),
+								PB_COMPRESSED_SEQUENCE_INDEX_POINTER(output),
+								index_part_size,
+								index_part_size - 1);
+
+	pfree((PB_EncodingMap*) map);
+
+#ifdef DEBUG
+	if (PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(output) + PB_ALIGN_BIT_SIZE(n_bits) / 8 > VARSIZE(output)) {
+		ereport(ERROR,(errmsg("segmentation fault"),
+				errhint("Recognized in %s at line %d.", __FILE__, __LINE__),
+				errdetail("Stream of %lu bits does not fit into a block of size %u.",
+				n_bits,
+				VARSIZE(output))));
+	}
+#else
+	(void) n_bits;
+#endif
+
+	PB_TRACE(errmsg("<-encode_pc_rle_idx()"));
+ }
+
+ /**
+  * encode_pc_rle_part()
+  * 		Encode part of a sequence with a huffman code, run-length encoding
+  * 		and an index. Returns the number of bits written.
+  *
+  * 		The part starts with a new run, so a part with equal characters
+  * 		in front of it or behind it is encoded like a sequence of its own.
+  * 		Index entries are written for every index_part_size characters
+  * 		after the first one at index_counter.
+  *
+  * 	uint8* input : part of the input sequence
+  * 	uint32 length : length of the part, at least 1
+  * 	PB_EncodingMap* map : encoding map of the code
+  * 	PB_CompressionBuffer* stream : zeroed stream to write to
+  * 	PB_IndexEntry* index_pointer : first index entry to write, bits are
+  * 								   counted from the start of the stream
+  * 	int index_part_size : number of characters between index entries
+  * 	int index_counter : characters in front of the first index entry
+  */
+static uint64 encode_pc_rle_part(const uint8* input,
+								 uint32 length,
+								 const PB_EncodingMap* map,
+								 PB_CompressionBuffer* stream,
+								 PB_IndexEntry* index_pointer,
+								 int index_part_size,
+								 int index_counter)
+{
+	const int rlecode_length = map[PB_RUN_LENGTH_SYMBOL].code_length;
+
+	PB_CompressionBuffer buffer = 0;
+	int bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
+	int i = length - 1;
+	int repeated_chars = 0;
+
+	uint8 recent = 0;
+
+	const uint8* input_pointer = input;
+	PB_CompressionBuffer* stream_start = stream;
+	PB_CompressionBuffer* output_pointer = stream_start;
+
+	/*
+	 * Read first char.
+	 */
+	recent = *input_pointer;
+	input_pointer++;
+	i--;
+
+	while (i >= 0)
+	{
+		const uint8 current = *input_pointer;
+
+		repeated_chars++;
+		input_pointer++;
+		i--;
+
+		if (current != recent || repeated_chars >= PB_MAX_RUN_LENGTH - 1)
+		{
+			encode_pc_rle_part_out:
 			if (repeated_chars < PB_MIN_RUN_LENGTH)
 			{
 				/*
@@ -675,7 +1772,7 @@ static void encode_pc_rle_idx(uint8* input,
 					index_counter--;
 					if (index_counter < 0)
 					{
-						index_counter += PB_INDEX_PART_SIZE;
+						index_counter += index_part_size;
 						if (bits_free > 0)
 						{
 							index_pointer->bit = PB_COMPRESSION_BUFFER_BIT_SIZE - bits_free;
@@ -730,7 +1827,7 @@ static void encode_pc_rle_idx(uint8* input,
 						index_pointer->block = (output_pointer + 1)- stream_start;
 					}
 					index_pointer->rle_shift = (uint16) index_counter;
-					index_counter += PB_INDEX_PART_SIZE;
+					index_counter += index_part_size;
 					PB_DEBUG3(errmsg("IDX block:%u bit:%d", index_pointer->block, index_pointer->bit));
 					index_pointer++;
 				}
@@ -757,7 +1854,7 @@ static void encode_pc_rle_idx(uint8* input,
 		i--;
 		repeated_chars++;
 		PB_DEBUG3(errmsg("last symbol"));
-		goto encode_pc_rle_idx_out;
+		goto encode_pc_rle_part_out;
 	}
 
 	/*
@@ -766,21 +1863,8 @@ static void encode_pc_rle_idx(uint8* input,
 	if (bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
 		*output_pointer = (buffer << bits_free);
 
-	pfree((PB_EncodingMap*) map);
-
-#ifdef DEBUG
-	if (((uint8*)output_pointer) - ((uint8*) output) >= VARSIZE(output)
-			&& bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE) {
-		ereport(ERROR,(errmsg("segmentation fault"),
-				errhint("Recognized in %s at line %d.", __FILE__, __LINE__),
-				errdetail("Output pointer %p is %ld bytes after a block of size %u.",
-				output_pointer,
-				(((uint8*)output_pointer) - ((uint8*) output))- VARSIZE(output),
-				VARSIZE(output))));
-	}
-#endif
-
-	PB_TRACE(errmsg("<-encode_pc_rle_idx()"));
+	return (uint64) (output_pointer - stream_start) * PB_COMPRESSION_BUFFER_BIT_SIZE +
+		   (PB_COMPRESSION_BUFFER_BIT_SIZE - bits_free);
  }
 
  /**
@@ -933,7 +2017,8 @@ static void encode_pc_swp_idx(uint8* input,
 	int bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
 	int i = output->sequence_length - 1;
 	int swap_counter = PB_MAX_SWAP_RUN_LENGTH;
-	int index_counter = PB_INDEX_PART_SIZE - 1;
+	const int index_part_size = PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(output);
+	int index_counter = index_part_size - 1;
 
 	uint8* input_pointer = input;
 	PB_CompressionBuffer* stream_start = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output);
@@ -960,7 +2045,7 @@ static void encode_pc_swp_idx(uint8* input,
 		index_counter--;
 		if (index_counter < 0)
 		{
-			index_counter += PB_INDEX_PART_SIZE;
+			index_counter += index_part_size;
 			if (bits_free > 0)
 			{
 				index_pointer->bit = PB_COMPRESSION_BUFFER_BIT_SIZE - bits_free;
@@ -1443,7 +2528,8 @@ static void encode_pc_swp_rle_idx(uint8* input,
 	PB_CompressionBuffer* swap_pointer;
 	int swap_bits;
 
-	int index_counter = PB_INDEX_PART_SIZE - 1;
+	const int index_part_size = PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(output);
+	int index_counter = index_part_size - 1;
 	PB_IndexEntry* index_pointer = PB_COMPRESSED_SEQUENCE_INDEX_POINTER(output);
 	int n_swap_index_pointers = 0;
 
@@ -1496,7 +2582,7 @@ static void encode_pc_swp_rle_idx(uint8* input,
 						index_counter--;
 						if (index_counter < 0)
 						{
-							index_counter += PB_INDEX_PART_SIZE;
+							index_counter += index_part_size;
 							if (bits_free > 0)
 							{
 								index_pointer->bit = PB_COMPRESSION_BUFFER_BIT_SIZE - bits_free;;
@@ -1532,7 +2618,7 @@ static void encode_pc_swp_rle_idx(uint8* input,
 						index_counter--;
 						if (index_counter < 0)
 						{
-							index_counter += PB_INDEX_PART_SIZE;
+							index_counter += index_part_size;
 							if (bits_free > 0)
 							{
 								index_pointer->bit = PB_COMPRESSION_BUFFER_BIT_SIZE - bits_free;;
@@ -1613,7 +2699,7 @@ static void encode_pc_swp_rle_idx(uint8* input,
 					index_pointer->swap_shift = swap_counter;
 					n_swap_index_pointers++;
 					index_pointer++;
-					index_counter += PB_INDEX_PART_SIZE;
+					index_counter += index_part_size;
 				}
 				index_counter -= repeated_chars;
 
@@ -1773,278 +2859,768 @@ static void encode_pc_swp_rle_idx(uint8* input,
 	}
 
 	/*
-	 * Last symbol.
-	 *
-	 * This is ugly. But the alternatives are:
-	 * 		a. another cmp + jmp in the loop -> cost 5% performance
-	 * 		b. repeating a bunch of lines -> even uglier
-	 *
+	 * Last symbol.
+	 *
+	 * This is ugly. But the alternatives are:
+	 * 		a. another cmp + jmp in the loop -> cost 5% performance
+	 * 		b. repeating a bunch of lines -> even uglier
+	 *
+	 */
+	if (i == (-1)) {
+		i--;
+		repeated_chars++;
+		PB_DEBUG3(errmsg("last symbol"));
+		goto encode_pc_swp_rle_idx_out;
+	}
+
+	/*
+	 * Flush buffer.
+	 */
+	if (bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
+		*output_pointer |= (buffer << bits_free);
+
+	if (swap_bits < 0)
+	{
+		*swap_pointer = *swap_pointer | ((PB_CompressionBuffer) 0xFFFF >> (-swap_bits));
+		*(swap_pointer+1) = *(swap_pointer+1) | ((PB_CompressionBuffer) 0xFFFF << (swap_bits + PB_COMPRESSION_BUFFER_BIT_SIZE));
+	}
+	else
+	{
+		*swap_pointer = *swap_pointer | ((PB_CompressionBuffer) 0xFFFF << swap_bits);
+	}
+
+	if (n_swap_index_pointers > 0)
+	{
+		int index_entry_it;
+		for (index_entry_it = 1; index_entry_it <= n_swap_index_pointers; index_entry_it++)
+		{
+			(index_pointer - index_entry_it)->swap_shift -= swap_counter;
+		}
+	}
+
+	PB_DEBUG1(errmsg("encode_pc_swp_rle_idx(): pos:%ld", (output_pointer - PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output))*8));
+
+	pfree((PB_EncodingMap*) master_map);
+	pfree((PB_EncodingMap*) swap_map);
+
+#ifdef DEBUG
+	if (((uint8*)output_pointer) - ((uint8*) output) >= VARSIZE(output)
+			&& bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE) {
+		ereport(ERROR,(errmsg("segmentation fault"),
+				errhint("Recognized in %s at line %d.", __FILE__, __LINE__),
+				errdetail("Output pointer %p is %ld bytes after a block of size %u.",
+				output_pointer,
+				(((uint8*)output_pointer) - ((uint8*) output))- VARSIZE(output),
+				VARSIZE(output))));
+	}
+#endif
+
+	PB_TRACE(errmsg("<-encode_pc_swp_rle_idx()"));
+}
+
+
+/**
+ * decode_pc_idx()
+ * 		Decode a sequence, possibly indexed
+ *
+ */
+static void decode_pc_idx(PB_DetoastCursor* cursor,
+						  const PB_CompressedSequence* header,
+						  uint8* output,
+						  uint32 start_position,
+						  uint32 output_length,
+						  PB_IndexEntry* start_entry,
+						  PB_CodeSet* codeset)
+{
+	PB_CompressionBuffer buffer;
+	int bits_in_buffer;
+	int i;
+
+	int stream_offset;
+
+	const uint8* input_data;
+	int32 input_size;
+	PB_CompressionBuffer* input_pointer;
+	PB_CompressionBuffer* input_end;
+	uint8* output_pointer = output;
+	uint8 symbols[PB_DECODE_MAP_SIZE];
+
+	PB_DecodingMaps* maps = get_decoding_maps(codeset);
+	const PB_DecodingMap* map = maps->map;
+	const PB_MultiDecodingMap* multi_map;
+
+	PB_TRACE(errmsg("->decode_pc_idx()"));
+
+	/*
+	 * Calculate the offset of the stream in the compressed data.
+	 */
+	stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(header) - VARHDRSZ;
+
+	PB_DEBUG3(errmsg("decode_pc_idx():calculated stream offset:%u", stream_offset));
+
+	/*
+	 * Detoast the data slice that contains the desired substring.
+	 */
+	if (codeset->has_equal_length)
+	{
+		/*
+		 * All codes have equal length.
+		 *  -> exact slice, that contains the desired sequence can be computed
+		 */
+		int code_length = codeset->words[0].code_length;
+		int64 bits_to_skip = start_position * code_length;
+		int64 slice_start = bits_to_skip / PB_COMPRESSION_BUFFER_BIT_SIZE;
+		int64 slice_size = (bits_to_skip + output_length * code_length)
+								/ PB_COMPRESSION_BUFFER_BIT_SIZE + 1 - slice_start;
+
+		slice_start *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+		slice_start += stream_offset;
+		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+		input_data = read_detoast_cursor(cursor, slice_start, slice_size, NULL);
+
+		PB_DEBUG1(errmsg("decode_pc_idx(): all codes have equal length\n\tskipping %ld bits\n\tslice starts at byte %ld\n\tslice size is %ld bytes", bits_to_skip, slice_start,slice_size));
+
+		/*
+		 * Without varying code lengths the symbols can be unpacked
+		 * block by block.
+		 */
+		memset(symbols, 0, PB_DECODE_MAP_SIZE);
+		for (i = 0; i < codeset->n_symbols; i++)
+			symbols[codeset->words[i].code >> (PB_PREFIX_CODE_BIT_SIZE - code_length)] = codeset->words[i].symbol;
+
+		unpack_equal_length((PB_CompressionBuffer*) input_data,
+							bits_to_skip % PB_COMPRESSION_BUFFER_BIT_SIZE,
+							output_length,
+							symbols,
+							code_length,
+							output);
+
+		release_decoding_maps(maps);
+
+		PB_TRACE(errmsg("<-decode_pc_idx()"));
+		return;
+	}
+	else
+	{
+		/*
+		 * Cannot compute the exact slice.
+		 */
+		int max_codeword_length = codeset->words[codeset->n_symbols - 1].code_length;
+		int raw_size = cursor->raw_size;
+
+		if (!start_entry)
+		{
+			/*
+			 * Compute upper bound for slice size.
+			 */
+			int slice_size = (start_position + output_length) *
+							 max_codeword_length /
+							 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
+			slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+
+			/*
+			 * If upper bound exceeds raw size, limit slice size.
+			 */
+			if (slice_size + stream_offset > raw_size)
+				slice_size = raw_size - stream_offset;
+
+			input_data = read_detoast_cursor(cursor, stream_offset, slice_size, &input_size);
+
+			PB_DEBUG1(errmsg("decode_pc_idx(): skipping through sequence\n\tslice size is %d bytes", slice_size));
+
+			bits_in_buffer = 0;
+			buffer = 0;
+			i = start_position - 1;
+			input_pointer = (PB_CompressionBuffer*) input_data;
+		}
+		else
+		{
+			/*
+			 * An index entry is defined.
+			 *  -> get the slice starting at indexed position.
+			 */
+			int slice_start = stream_offset +
+							  start_entry->block * PB_COMPRESSION_BUFFER_BYTE_SIZE;
+			int slice_size = (output_length + (start_position % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(header))) *
+							 max_codeword_length /
+							 PB_COMPRESSION_BUFFER_BIT_SIZE + 2;
+			slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+
+			/*
+			 * If upper bound exceeds raw size, limit slice size.
+			 */
+			if (slice_size + slice_start > raw_size)
+				slice_size = raw_size - slice_start;
+
+			input_data = read_detoast_cursor(cursor, slice_start, slice_size, &input_size);
+
+			PB_DEBUG1(errmsg("decode_pc_idx(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes", start_entry->block, slice_start, slice_size));
+
+			input_pointer = (PB_CompressionBuffer*) input_data;
+			bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - start_entry->bit;
+			buffer = *(input_pointer) << start_entry->bit;
+			input_pointer++;
+			i = ((start_position + 1) % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(header)) - 1;
+		}
+	}
+
+	/*
+	 * Long runs of symbols are decoded several symbols at a time. The
+	 * multi-symbol map peeks one block ahead, so it is only used as long
+	 * as there is a block left in the slice.
+	 */
+	input_end = (PB_CompressionBuffer*) input_data +
+				input_size / PB_COMPRESSION_BUFFER_BYTE_SIZE;
+
+	multi_map = get_multi_decoding_map(maps, i + 1 + output_length);
+
+	PB_DEBUG1(errmsg("decode_pc_idx(): reading %d chars to skip", i + 1));
+
+	while (i >= 0)
+	{
+		PB_PrefixCode val;
+		int length;
+
+		if (multi_map && i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 && input_pointer < input_end)
+		{
+			const PB_MultiDecodingMap* entry;
+
+			MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map);
+			if (entry->n_symbols > 0)
+			{
+				i -= entry->n_symbols;
+				continue;
+			}
+		}
+
+		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+		i--;
+	}
+
+	i += output_length;
+
+	PB_DEBUG1(errmsg("decode_pc_idx(): decoding %d chars",i));
+
+	while (i >= 0)
+	{
+		PB_PrefixCode val;
+		int length;
+
+		if (multi_map && i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 && input_pointer < input_end)
+		{
+			const PB_MultiDecodingMap* entry;
+
+			MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map);
+			if (entry->n_symbols > 0)
+			{
+				/*
+				 * At least PB_MULTI_DECODE_MAX_SYMBOLS chars are left
+				 * in output, so the whole entry can be copied.
+				 */
+				memcpy(output_pointer, entry->symbols, PB_MULTI_DECODE_MAX_SYMBOLS);
+				output_pointer += entry->n_symbols;
+				i -= entry->n_symbols;
+				continue;
+			}
+		}
+
+		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+
+		PB_DEBUG3(errmsg("decode_pc_idx(): i=%d val=%u len=%u s=%c buf=%08X%08X bib=%d", i, val, length, map[val].symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
+
+		*output_pointer = map[val].symbol;
+		output_pointer++;
+		i--;
+	}
+
+	release_decoding_maps(maps);
+
+	PB_TRACE(errmsg("<-decode_pc_idx()"));
+}
+
+/**
+ * decode_pc_rle_idx()
+ * 		Decode a rle sequence, possibly indexed
+ *
+ */
+static void decode_pc_rle_idx(PB_DetoastCursor* cursor,
+							  const PB_CompressedSequence* header,
+							  uint8* output,
+							  uint32 start_position,
+							  uint32 output_length,
+							  PB_IndexEntry* start_entry,
+							  PB_CodeSet* codeset)
+{
+	PB_CompressionBuffer buffer;
+	int bits_in_buffer;
+	int i;
+
+	int stream_offset;
+
+	const uint8* input_data;
+	int32 input_size;
+	PB_CompressionBuffer* input_pointer;
+	PB_CompressionBuffer* input_end;
+	uint8* output_pointer = output;
+
+	PB_DecodingMaps* maps = get_decoding_maps(codeset);
+	const PB_DecodingMap* map = maps->map;
+	const PB_MultiDecodingMap* multi_map;
+
+	const int max_codeword_length = codeset->words[codeset->n_symbols - 1].code_length;
+	const int raw_size = cursor->raw_size;
+
+	PB_TRACE(errmsg("->decode_pc_rle_idx()"));
+
+	/*
+	 * Calculate the offset of the stream in the compressed data.
+	 */
+	stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(header) - VARHDRSZ;
+
+	PB_DEBUG1(errmsg("decode_pc_rle_idx():calculated stream offset:%u", stream_offset));
+
+	/*
+	 * Detoast the data slice that contains the desired substring.
+	 */
+	if (!start_entry)
+	{
+		/*
+		 * Calculate upper bound for slice size.
+		 */
+		int slice_size = ((start_position + output_length + 1) *
+						 max_codeword_length + 8) /
+						 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
+		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+
+		/*
+		 * If upper bound exceeds raw size, limit slice size.
+		 */
+		if (slice_size + stream_offset > raw_size)
+			slice_size = raw_size - stream_offset;
+
+		input_data = read_detoast_cursor(cursor, stream_offset, slice_size, &input_size);
+
+		PB_DEBUG1(errmsg("decode_pc_rle_idx(): skipping through sequence\n\tslice size is %d bytes", slice_size));
+
+		bits_in_buffer = 0;
+		buffer = 0;
+		i = start_position - 1;
+		input_pointer = (PB_CompressionBuffer*) input_data;
+	}
+	else
+	{
+		/*
+		 * An index entry is defined.
+		 *  -> get the slice starting at indexed position.
+		 */
+		int slice_start = stream_offset +
+						  start_entry->block * PB_COMPRESSION_BUFFER_BYTE_SIZE;
+		int slice_size = ((output_length + (start_position % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(header)) + 1) *
+						 max_codeword_length  + 8) /
+						 PB_COMPRESSION_BUFFER_BIT_SIZE + 2;
+		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+
+		/*
+		 * If upper bound exceeds raw size, limit slice size.
+		 */
+		if (slice_size + slice_start > raw_size)
+			slice_size = raw_size - slice_start;
+
+		input_data = read_detoast_cursor(cursor, slice_start, slice_size, &input_size);
+
+		PB_DEBUG1(errmsg("decode_pc_rle_idx(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes", start_entry->block, slice_start, slice_size));
+
+		input_pointer = (PB_CompressionBuffer*) input_data;
+		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - start_entry->bit;
+		buffer = *(input_pointer) << start_entry->bit;
+		input_pointer++;
+		i = ((start_position + 1) % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(header)) - 1 + start_entry->rle_shift;
+	}
+
+	input_end = (PB_CompressionBuffer*) input_data +
+				input_size / PB_COMPRESSION_BUFFER_BYTE_SIZE;
+
+	multi_map = get_multi_decoding_map(maps, i + 1 + output_length);
+
+	PB_DEBUG1(errmsg("decode_pc_rle_idx(): reading %d chars to skip", i + 1));
+
+	while (i >= 0)
+	{
+		PB_PrefixCode val;
+		int length;
+
+		if (multi_map && i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 && input_pointer < input_end)
+		{
+			const PB_MultiDecodingMap* entry;
+
+			MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map);
+			if (entry->n_symbols > 0)
+			{
+				i -= entry->n_symbols;
+				continue;
+			}
+		}
+
+		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+
+		i--;
+		if (map[val].symbol == PB_RUN_LENGTH_SYMBOL)
+		{
+			int repeated_chars = 0;
+			READ_N_BITS(input_pointer, buffer, bits_in_buffer, repeated_chars, PB_RUN_LENGTH_BIT_SIZE);
+
+			i -= repeated_chars + PB_MIN_RUN_LENGTH - 2;
+			/*
+			 * Note: (-2) because 1 has been deducted in this iteration above and
+			 * 			1 will be deducted in the next iteration, when the symbol
+			 * 			after the RLE is read.
+			 */
+		}
+	}
+
+	/*
+	 * Write out last run-length if there was one.
 	 */
-	if (i == (-1)) {
+	if (i < -1)
+	{
+		int repeated_chars = -i;
+		PB_PrefixCode val;
+		int length;
+		uint8 current;
+
+		if (repeated_chars >= output_length)
+		{
+			repeated_chars = output_length;
+		}
+
+		PB_DEBUG1(errmsg("decode_pc_rle_idx(): %d remaining chars from last run-length", i + 1));
+
+		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
 		i--;
-		repeated_chars++;
-		PB_DEBUG3(errmsg("last symbol"));
-		goto encode_pc_swp_rle_idx_out;
-	}
 
-	/*
-	 * Flush buffer.
-	 */
-	if (bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
-		*output_pointer |= (buffer << bits_free);
+		current = map[val].symbol;
 
-	if (swap_bits < 0)
-	{
-		*swap_pointer = *swap_pointer | ((PB_CompressionBuffer) 0xFFFF >> (-swap_bits));
-		*(swap_pointer+1) = *(swap_pointer+1) | ((PB_CompressionBuffer) 0xFFFF << (swap_bits + PB_COMPRESSION_BUFFER_BIT_SIZE));
-	}
-	else
-	{
-		*swap_pointer = *swap_pointer | ((PB_CompressionBuffer) 0xFFFF << swap_bits);
+		memset(output_pointer, current, repeated_chars);
+		output_pointer += repeated_chars;
 	}
 
-	if (n_swap_index_pointers > 0)
+	i += output_length;
+
+	PB_DEBUG1(errmsg("decode_pc_rle_idx(): decoding %d chars", i + 1));
+
+	while (i >= 0)
 	{
-		int index_entry_it;
-		for (index_entry_it = 1; index_entry_it <= n_swap_index_pointers; index_entry_it++)
+		PB_PrefixCode val;
+		int length;
+
+		if (multi_map && i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 && input_pointer < input_end)
 		{
-			(index_pointer - index_entry_it)->swap_shift -= swap_counter;
+			const PB_MultiDecodingMap* entry;
+
+			MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map);
+			if (entry->n_symbols > 0)
+			{
+				memcpy(output_pointer, entry->symbols, PB_MULTI_DECODE_MAX_SYMBOLS);
+				output_pointer += entry->n_symbols;
+				i -= entry->n_symbols;
+				continue;
+			}
 		}
-	}
 
-	PB_DEBUG1(errmsg("encode_pc_swp_rle_idx(): pos:%ld", (output_pointer - PB_COMPRESSED_SEQUENCE_STREAM_POINTER(output))*8));
+		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
 
-	pfree((PB_EncodingMap*) master_map);
-	pfree((PB_EncodingMap*) swap_map);
+		PB_DEBUG3(errmsg("decode_pc_rle_idx(): i=%d val=%u len=%u s=%c buf=%08X%08X bib=%d", i, val, length, map[val].symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
 
-#ifdef DEBUG
-	if (((uint8*)output_pointer) - ((uint8*) output) >= VARSIZE(output)
-			&& bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE) {
-		ereport(ERROR,(errmsg("segmentation fault"),
-				errhint("Recognized in %s at line %d.", __FILE__, __LINE__),
-				errdetail("Output pointer %p is %ld bytes after a block of size %u.",
-				output_pointer,
-				(((uint8*)output_pointer) - ((uint8*) output))- VARSIZE(output),
-				VARSIZE(output))));
+		if (map[val].symbol != PB_RUN_LENGTH_SYMBOL)
+		{
+			*output_pointer = map[val].symbol;
+			output_pointer++;
+			i--;
+		}
+		else
+		{
+			PB_CompressionBuffer repeated_chars = 0;
+			uint8 out;
+
+			READ_N_BITS(input_pointer, buffer, bits_in_buffer, repeated_chars, PB_RUN_LENGTH_BIT_SIZE);
+
+			DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+
+			repeated_chars += PB_MIN_RUN_LENGTH;
+			out = map[val].symbol;
+
+			PB_DEBUG3(errmsg("decode_pc_rle_idx(): write %lu times %c", repeated_chars, out));
+
+			i -= (int) repeated_chars;
+			if (i < (-1))
+			{
+				repeated_chars -= (PB_CompressionBuffer) (-(i + 1));
+			}
+
+			memset(output_pointer, out, repeated_chars);
+			output_pointer += repeated_chars;
+		}
 	}
-#endif
 
-	PB_TRACE(errmsg("<-encode_pc_swp_rle_idx()"));
-}
+	release_decoding_maps(maps);
 
+	PB_TRACE(errmsg("<-decode_pc_rle_idx()"));
+}
 
 /**
- * decode_pc_idx()
- * 		Decode a sequence, possibly indexed
+ * decode_pc_swp_idx()
+ * 		Decode a sequence from encode_pc_swp or encode_pc_swp_idx
  *
  */
-static void decode_pc_idx(Varlena* input,
-						  uint8* output,
-						  uint32 start_position,
-						  uint32 output_length,
-						  PB_IndexEntry* start_entry,
-						  PB_CodeSet* codeset)
+static void decode_pc_swp_idx(PB_DetoastCursor* cursor,
+							  const PB_CompressedSequence* header,
+							  uint8* output,
+							  uint32 start_position,
+							  uint32 output_length,
+							  PB_IndexEntry* start_entry,
+							  PB_CodeSet* codeset)
 {
 	PB_CompressionBuffer buffer;
 	int bits_in_buffer;
 	int i;
+	int swap_counter;
 
-	PB_CompressedSequence* sequence_header;
 	int stream_offset;
 
-	Varlena* input_slice;
+	const uint8* input_data;
+	int32 input_size;
 	PB_CompressionBuffer* input_pointer;
+	PB_CompressionBuffer* input_end;
 	uint8* output_pointer = output;
 
-	PB_DecodingMap* map = get_decoding_map(codeset, PB_NO_SWAP_MAP);
+	PB_DecodingMaps* maps = get_decoding_maps(codeset);
+	const PB_DecodingMap* map = maps->map;
+	const PB_DecodingMap* swap_map = maps->swap_map;
+	const PB_MultiDecodingMap* multi_map;
 
-	PB_TRACE(errmsg("->decode_pc_idx()"));
+	const uint8 master_symbol = codeset->words[codeset->n_symbols - codeset->n_swapped_symbols].symbol;
+
+	const int max_codeword_length = 2 * codeset->max_codeword_length +
+									PB_SWAP_RUN_LENGTH_BIT_SIZE;
+	const int raw_size = cursor->raw_size;
+
+	PB_TRACE(errmsg("->decode_pc_swp_idx()"));
 
 	/*
 	 * Calculate the offset of the stream in the compressed data.
 	 */
-	sequence_header = (PB_CompressedSequence*)
-					  PG_DETOAST_DATUM_SLICE(input, 0, sizeof(PB_CompressedSequence) - VARHDRSZ);
-	stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(sequence_header) - VARHDRSZ;
-	pfree(sequence_header);
+	stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(header) - VARHDRSZ;
 
-	PB_DEBUG3(errmsg("decode_pc_idx():calculated stream offset:%u", stream_offset));
+	PB_DEBUG1(errmsg("decode_pc_swp_idx():calculated stream offset:%u", stream_offset));
 
 	/*
 	 * Detoast the data slice that contains the desired substring.
 	 */
-	if (codeset->has_equal_length)
+	if (!start_entry)
 	{
 		/*
-		 * All codes have equal length.
-		 *  -> exact slice, that contains the desired sequence can be computed
+		 * Calculate upper bound for slice size.
 		 */
-		int code_length = codeset->words[0].code_length;
-		int64 bits_to_skip = start_position * code_length;
-		int64 slice_start = bits_to_skip / PB_COMPRESSION_BUFFER_BIT_SIZE;
-		int64 slice_size = (bits_to_skip + output_length * code_length)
-								/ PB_COMPRESSION_BUFFER_BIT_SIZE + 1 - slice_start;
-
-		slice_start *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
-		slice_start += stream_offset;
+		int slice_size = ((start_position + output_length) *
+						 max_codeword_length + PB_SWAP_RUN_LENGTH_BIT_SIZE) /
+						 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
 		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
-		input_slice = (Varlena*)
-					  PG_DETOAST_DATUM_SLICE(input,
-											 slice_start,
-											 slice_size);
 
-		PB_DEBUG1(errmsg("decode_pc_idx(): all codes have equal length\n\tskipping %ld bits\n\tslice starts at byte %ld\n\tslice size is %ld bytes", bits_to_skip, slice_start,slice_size));
+		/*
+		 * If upper bound exceeds raw size, limit slice size.
+		 */
+		if (slice_size + stream_offset > raw_size)
+			slice_size = raw_size - stream_offset;
+
+		input_data = read_detoast_cursor(cursor, stream_offset, slice_size, &input_size);
 
-		i = -1;
-		input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
-		bits_in_buffer = bits_to_skip % PB_COMPRESSION_BUFFER_BIT_SIZE;
-		buffer = *input_pointer << bits_in_buffer;
-		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - bits_in_buffer;
+		PB_DEBUG1(errmsg("decode_pc_swp_idx(): skipping through sequence\n\tslice size is %d bytes", slice_size));
+
+		i = start_position - 1;
+		input_pointer = (PB_CompressionBuffer*) input_data;
+
+		buffer = *input_pointer;
 		input_pointer++;
+		swap_counter = buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - PB_SWAP_RUN_LENGTH_BIT_SIZE);
+		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - PB_SWAP_RUN_LENGTH_BIT_SIZE;
+		buffer = buffer << PB_SWAP_RUN_LENGTH_BIT_SIZE;
 	}
 	else
 	{
 		/*
-		 * Cannot compute the exact slice.
+		 * An index entry is defined.
+		 *  -> get the slice starting at indexed position.
 		 */
-		int max_codeword_length = codeset->words[codeset->n_symbols - 1].code_length;
-		int raw_size = toast_raw_datum_size((Datum)input);
+		int slice_start = stream_offset +
+						  start_entry->block * PB_COMPRESSION_BUFFER_BYTE_SIZE;
+		int slice_size = (output_length + (start_position % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(header))) *
+						 max_codeword_length /
+						 PB_COMPRESSION_BUFFER_BIT_SIZE + 2;
+		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
 
-		if (!start_entry)
-		{
-			/*
-			 * Compute upper bound for slice size.
-			 */
-			int slice_size = (start_position + output_length) *
-							 max_codeword_length /
-							 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
-			slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+		/*
+		 * If upper bound exceeds raw size, limit slice size.
+		 */
+		if (slice_size + slice_start > raw_size)
+			slice_size = raw_size - slice_start;
 
-			/*
-			 * If upper bound exceeds raw size, limit slice size.
-			 */
-			if (slice_size + stream_offset > raw_size)
-				slice_size = raw_size - stream_offset;
+		input_data = read_detoast_cursor(cursor, slice_start, slice_size, &input_size);
 
-			input_slice = (Varlena*)
-						  PG_DETOAST_DATUM_SLICE(input,
-												 stream_offset,
-												 slice_size);
+		PB_DEBUG1(errmsg("decode_pc_swp_idx(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes\n\tswap shift:%d", start_entry->block, slice_start, slice_size,start_entry->swap_shift));
 
-			PB_DEBUG1(errmsg("decode_pc_idx(): skipping through sequence\n\tslice size is %d bytes", slice_size));
+		input_pointer = (PB_CompressionBuffer*) input_data;
+		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - start_entry->bit;
+		buffer = *(input_pointer) << start_entry->bit;
+		input_pointer++;
+		i = ((start_position + 1) % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(header)) - 1;
+		swap_counter = start_entry->swap_shift;
+	}
 
-			bits_in_buffer = 0;
-			buffer = 0;
-			i = start_position - 1;
-			input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
-		}
-		else
-		{
-			/*
-			 * An index entry is defined.
-			 *  -> get the slice starting at indexed position.
-			 */
-			int slice_start = stream_offset +
-							  start_entry->block * PB_COMPRESSION_BUFFER_BYTE_SIZE;
-			int slice_size = (output_length + (start_position % PB_INDEX_PART_SIZE)) *
-							 max_codeword_length /
-							 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
-			slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+	PB_DEBUG1(errmsg("decode_pc_swp_idx(): reading %d chars to skip, swap_counter = %d, bib=%d", i + 1, swap_counter, bits_in_buffer));
 
-			/*
-			 * If upper bound exceeds raw size, limit slice size.
-			 */
-			if (slice_size + slice_start > raw_size)
-				slice_size = raw_size - slice_start;
+	input_end = (PB_CompressionBuffer*) input_data +
+				input_size / PB_COMPRESSION_BUFFER_BYTE_SIZE;
 
-			input_slice = (Varlena*)
-						  PG_DETOAST_DATUM_SLICE(input,
-												 slice_start,
-												 slice_size);
+	multi_map = get_multi_decoding_map(maps, i + 1 + output_length);
 
-			PB_DEBUG1(errmsg("decode_pc_idx(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes", start_entry->block, slice_start, slice_size));
+	/*
+	 * Skipping start of sequence.
+	 */
+	while (i >= 0)
+	{
+		PB_PrefixCode val;
+		int length;
 
-			input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
-			bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - start_entry->bit;
-			buffer = *(input_pointer) << start_entry->bit;
-			input_pointer++;
-			i = ((start_position + 1) % PB_INDEX_PART_SIZE) - 1;
-		}
+		if (multi_map && i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 && input_pointer < input_end)
+		{
+			const PB_MultiDecodingMap* entry;
 
-		PB_DEBUG1(errmsg("decode_pc_idx(): reading %d chars to skip", i + 1));
+			MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map);
+			if (entry->n_symbols > 0)
+			{
+				i -= entry->n_symbols;
+				continue;
+			}
+		}
 
-		while (i >= 0)
+		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+		i--;
+		if (map[val].symbol == master_symbol)
 		{
-			PB_PrefixCode val;
-			int length;
-
-			DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
-			i--;
+			swap_counter--;
+			if (swap_counter < 0)
+			{
+				DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
+				READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+			}
 		}
 	}
 
 	i += output_length;
 
-	PB_DEBUG1(errmsg("decode_pc_idx(): decoding %d chars",i));
+	PB_DEBUG1(errmsg("decode_pc_swp_idx(): reading %d chars, swap_counter = %d, bib=%d", i + 1, swap_counter, bits_in_buffer));
+
+	while (i >= 0)
+	{
+		PB_PrefixCode val;
+		int length;
+
+		if (multi_map && i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 && input_pointer < input_end)
+		{
+			const PB_MultiDecodingMap* entry;
+
+			MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map);
+			if (entry->n_symbols > 0)
+			{
+				memcpy(output_pointer, entry->symbols, PB_MULTI_DECODE_MAX_SYMBOLS);
+				output_pointer += entry->n_symbols;
+				i -= entry->n_symbols;
+				continue;
+			}
+		}
 
-	while (i >= 0)
-	{
-		PB_PrefixCode val;
-		int length;
 		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+		if (map[val].symbol != master_symbol)
+		{
+			PB_DEBUG3(errmsg("NORMAL: i:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, val, length, map[val].symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
 
-		PB_DEBUG3(errmsg("decode_pc_idx(): i=%d val=%u len=%u s=%c buf=%08X%08X bib=%d", i, val, length, map[val].symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
+			*output_pointer = map[val].symbol;
+			output_pointer++;
+			i--;
+		}
+		else
+		{
+			if (swap_counter > 0)
+			{
+				PB_DEBUG3(errmsg("MASTER: i:%d swap_counter:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, swap_counter, val, length, master_symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
 
-		*output_pointer = map[val].symbol;
-		output_pointer++;
-		i--;
+				*output_pointer = master_symbol;
+				output_pointer++;
+				i--;
+				swap_counter--;
+			}
+			else
+			{
+				DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
+				PB_DEBUG3(errmsg("SLAVE i:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, val, length, swap_map[val].symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
+
+				*output_pointer = swap_map[val].symbol;
+				output_pointer++;
+				i--;
+				READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+			}
+		}
 	}
 
-	pfree(map);
-	pfree(input_slice);
+	release_decoding_maps(maps);
 
-	PB_TRACE(errmsg("<-decode_pc_idx()"));
+	PB_TRACE(errmsg("<-decode_pc_swp_idx()"));
 }
 
 /**
- * decode_pc_rle_idx()
- * 		Decode a rle sequence, possibly indexed
+ * decode_pc_swp_rle_idx()
+ * 		Decode a sequence from encode_pc_swp_rle or encode_pc_swp_rle_idx
  *
  */
-static void decode_pc_rle_idx(Varlena* input,
-							  uint8* output,
-							  uint32 start_position,
-							  uint32 output_length,
-							  PB_IndexEntry* start_entry,
-							  PB_CodeSet* codeset)
+static void decode_pc_swp_rle_idx(PB_DetoastCursor* cursor,
+								  const PB_CompressedSequence* header,
+								  uint8* output,
+								  uint32 start_position,
+								  uint32 output_length,
+								  PB_IndexEntry* start_entry,
+								  PB_CodeSet* codeset)
 {
 	PB_CompressionBuffer buffer;
 	int bits_in_buffer;
 	int i;
+	int swap_counter;
 
-	PB_CompressedSequence* sequence_header;
 	int stream_offset;
 
-	Varlena* input_slice;
+	const uint8* input_data;
+	int32 input_size;
 	PB_CompressionBuffer* input_pointer;
+	PB_CompressionBuffer* input_end;
 	uint8* output_pointer = output;
 
-	PB_DecodingMap* map = get_decoding_map(codeset, PB_NO_SWAP_MAP);
+	PB_DecodingMaps* maps = get_decoding_maps(codeset);
+	const PB_DecodingMap* map = maps->map;
+	const PB_DecodingMap* swap_map = maps->swap_map;
+	const PB_MultiDecodingMap* multi_map;
 
-	const int max_codeword_length = codeset->words[codeset->n_symbols - 1].code_length;
-	const int raw_size = toast_raw_datum_size((Datum)input);
+	const uint8 master_symbol = codeset->words[codeset->n_symbols - codeset->n_swapped_symbols].symbol;
+	const int max_codeword_length = 2 * codeset->max_codeword_length +
+									PB_SWAP_RUN_LENGTH_BIT_SIZE;
+	const int raw_size = cursor->raw_size;
 
-	PB_TRACE(errmsg("->decode_pc_rle_idx()"));
+	PB_TRACE(errmsg("->decode_pc_swp_rle_idx(%u,%u)", start_position, output_length));
 
 	/*
 	 * Calculate the offset of the stream in the compressed data.
 	 */
-	sequence_header = (PB_CompressedSequence*)
-					  PG_DETOAST_DATUM_SLICE(input, 0, sizeof(PB_CompressedSequence) - VARHDRSZ);
-	stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(sequence_header) - VARHDRSZ;
-	pfree(sequence_header);
+	stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(header) - VARHDRSZ;
 
-	PB_DEBUG1(errmsg("decode_pc_rle_idx():calculated stream offset:%u", stream_offset));
+	PB_DEBUG1(errmsg("decode_pc_swp_rle_idx():calculated stream offset:%u", stream_offset));
 
 	/*
 	 * Detoast the data slice that contains the desired substring.
@@ -2054,8 +3630,8 @@ static void decode_pc_rle_idx(Varlena* input,
 		/*
 		 * Calculate upper bound for slice size.
 		 */
-		int slice_size = ((start_position + output_length + 1) *
-						 max_codeword_length + 8) /
+		int slice_size = ((start_position + output_length) *
+						 max_codeword_length + PB_SWAP_RUN_LENGTH_BIT_SIZE) /
 						 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
 		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
 
@@ -2065,17 +3641,20 @@ static void decode_pc_rle_idx(Varlena* input,
 		if (slice_size + stream_offset > raw_size)
 			slice_size = raw_size - stream_offset;
 
-		input_slice = (Varlena*)
-					  PG_DETOAST_DATUM_SLICE(input,
-											 stream_offset,
-											 slice_size);
+		input_data = read_detoast_cursor(cursor, stream_offset, slice_size, &input_size);
 
-		PB_DEBUG1(errmsg("decode_pc_rle_idx(): skipping through sequence\n\tslice size is %d bytes", slice_size));
+		PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): skipping through sequence\n\tslice size is %d bytes", slice_size));
 
-		bits_in_buffer = 0;
-		buffer = 0;
 		i = start_position - 1;
-		input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
+		input_pointer = (PB_CompressionBuffer*) input_data;
+
+		buffer = *input_pointer;
+		input_pointer++;
+		swap_counter = buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - PB_SWAP_RUN_LENGTH_BIT_SIZE);
+		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - PB_SWAP_RUN_LENGTH_BIT_SIZE;
+		buffer = buffer << PB_SWAP_RUN_LENGTH_BIT_SIZE;
+
+		PB_DEBUG1(errmsg("buf:%08X%08X bib:%d", (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
 	}
 	else
 	{
@@ -2085,9 +3664,9 @@ static void decode_pc_rle_idx(Varlena* input,
 		 */
 		int slice_start = stream_offset +
 						  start_entry->block * PB_COMPRESSION_BUFFER_BYTE_SIZE;
-		int slice_size = ((output_length + (start_position % PB_INDEX_PART_SIZE) + 1) *
-						 max_codeword_length  + 8) /
-						 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
+		int slice_size = (output_length + (start_position % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(header))) *
+						 max_codeword_length /
+						 PB_COMPRESSION_BUFFER_BIT_SIZE + 2;
 		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
 
 		/*
@@ -2096,32 +3675,65 @@ static void decode_pc_rle_idx(Varlena* input,
 		if (slice_size + slice_start > raw_size)
 			slice_size = raw_size - slice_start;
 
-		input_slice = (Varlena*)
-					  PG_DETOAST_DATUM_SLICE(input,
-											 slice_start,
-											 slice_size);
+		input_data = read_detoast_cursor(cursor, slice_start, slice_size, &input_size);
 
-		PB_DEBUG1(errmsg("decode_pc_rle_idx(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes", start_entry->block, slice_start, slice_size));
+		PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes\nrle_shift:%u\nswap_shift:%u", start_entry->block, slice_start, slice_size,start_entry->rle_shift, start_entry->swap_shift));
 
-		input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
+		input_pointer = (PB_CompressionBuffer*) input_data;
 		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - start_entry->bit;
 		buffer = *(input_pointer) << start_entry->bit;
 		input_pointer++;
-		i = ((start_position + 1) % PB_INDEX_PART_SIZE) - 1 + start_entry->rle_shift;
+		i = ((start_position + 1) % PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(header)) - 1 + start_entry->rle_shift;
+		swap_counter = start_entry->swap_shift;
 	}
 
-	PB_DEBUG1(errmsg("decode_pc_rle_idx(): reading %d chars to skip", i + 1));
+	PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): reading %d chars to skip, swap_counter = %d, bib=%d, rle_shift=%u", i + 1, swap_counter, bits_in_buffer, start_entry == NULL ? -1 : start_entry->rle_shift));
+
+	input_end = (PB_CompressionBuffer*) input_data +
+				input_size / PB_COMPRESSION_BUFFER_BYTE_SIZE;
 
+	multi_map = get_multi_decoding_map(maps, i + 1 + output_length);
+
+	/*
+	 * Skipping.
+	 */
 	while (i >= 0)
 	{
 		PB_PrefixCode val;
 		int length;
-		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+		uint8 current;
+
+		if (multi_map && i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 && input_pointer < input_end)
+		{
+			const PB_MultiDecodingMap* entry;
+
+			MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map);
+			if (entry->n_symbols > 0)
+			{
+				i -= entry->n_symbols;
+				continue;
+			}
+		}
 
+		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+		current = map[val].symbol;
 		i--;
-		if (map[val].symbol == PB_RUN_LENGTH_SYMBOL)
+
+		if (current == master_symbol)
+		{
+			swap_counter--;
+			if (swap_counter < 0)
+			{
+				DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
+				current = swap_map[val].symbol;
+				READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+			}
+		}
+
+		if (current == PB_RUN_LENGTH_SYMBOL)
 		{
 			int repeated_chars = 0;
+
 			READ_N_BITS(input_pointer, buffer, bits_in_buffer, repeated_chars, PB_RUN_LENGTH_BIT_SIZE);
 
 			i -= repeated_chars + PB_MIN_RUN_LENGTH - 2;
@@ -2133,11 +3745,11 @@ static void decode_pc_rle_idx(Varlena* input,
 		}
 	}
 
-	/*
-	 * Write out last run-length if there was one.
-	 */
 	if (i < -1)
 	{
+		/*
+		 * The symbol read was an RLE symbol. Write out remaining chars.
+		 */
 		int repeated_chars = -i;
 		PB_PrefixCode val;
 		int length;
@@ -2148,12 +3760,27 @@ static void decode_pc_rle_idx(Varlena* input,
 			repeated_chars = output_length;
 		}
 
-		PB_DEBUG1(errmsg("decode_pc_rle_idx(): %d remaining chars from last run-length", i + 1));
+		PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): %d remaining chars from last rle", repeated_chars));
 
 		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
 		i--;
-
 		current = map[val].symbol;
+		if (current == master_symbol)
+		{
+			swap_counter--;
+			if (swap_counter < 0)
+			{
+				PB_PrefixCode val;
+				int length;
+
+				DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
+				current = swap_map[val].symbol;
+
+				READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+			}
+		}
+
+		PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): write %dx%c", repeated_chars,current));
 
 		memset(output_pointer, current, repeated_chars);
 		output_pointer += repeated_chars;
@@ -2161,712 +3788,1023 @@ static void decode_pc_rle_idx(Varlena* input,
 
 	i += output_length;
 
-	PB_DEBUG1(errmsg("decode_pc_rle_idx(): decoding %d chars", i + 1));
+	PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): reading %d chars, swap_counter = %d, bib=%d", i + 1, swap_counter, bits_in_buffer));
 
 	while (i >= 0)
 	{
 		PB_PrefixCode val;
 		int length;
-		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+		uint8 current;
 
-		PB_DEBUG3(errmsg("decode_pc_rle_idx(): i=%d val=%u len=%u s=%c buf=%08X%08X bib=%d", i, val, length, map[val].symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
+		if (multi_map && i >= PB_MULTI_DECODE_MAX_SYMBOLS - 1 && input_pointer < input_end)
+		{
+			const PB_MultiDecodingMap* entry;
 
-		if (map[val].symbol != PB_RUN_LENGTH_SYMBOL)
+			MULTI_DECODE(input_pointer, buffer, bits_in_buffer, entry, multi_map);
+			if (entry->n_symbols > 0)
+			{
+				memcpy(output_pointer, entry->symbols, PB_MULTI_DECODE_MAX_SYMBOLS);
+				output_pointer += entry->n_symbols;
+				i -= entry->n_symbols;
+				continue;
+			}
+		}
+
+		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+		current = map[val].symbol;
+
+		if (current != master_symbol && current != PB_RUN_LENGTH_SYMBOL)
 		{
-			*output_pointer = map[val].symbol;
+			*output_pointer = current;
 			output_pointer++;
 			i--;
+
+			PB_DEBUG3(errmsg("NSNRLE %c (%d) code:%u len:%u i:%d swap_counter:%d bitsInBuffer:%d buffer:%08X%08X", current, current,val, length,  i, swap_counter, bits_in_buffer, (uint32) (buffer >> 32), (uint32) buffer));
 		}
 		else
 		{
-			PB_CompressionBuffer repeated_chars = 0;
-			uint8 out;
-
-			READ_N_BITS(input_pointer, buffer, bits_in_buffer, repeated_chars, PB_RUN_LENGTH_BIT_SIZE);
-
-			DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+			if (current == master_symbol)
+			{
+				swap_counter--;
+				if (swap_counter < 0)
+				{
+					PB_PrefixCode val;
+					int length;
 
-			repeated_chars += PB_MIN_RUN_LENGTH;
-			out = map[val].symbol;
+					DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
+					current = swap_map[val].symbol;
 
-			PB_DEBUG3(errmsg("decode_pc_rle_idx(): write %lu times %c", repeated_chars, out));
+					READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+				}
+			}
 
-			i -= (int) repeated_chars;
-			if (i < (-1))
+			if (current != PB_RUN_LENGTH_SYMBOL)
 			{
-				repeated_chars -= (PB_CompressionBuffer) (-(i + 1));
+				*output_pointer = current;
+				output_pointer++;
+				i--;
+
+				PB_DEBUG3(errmsg("SNRLE %c (%d) code:%u len:%u i:%d swap_counter:%d bitsInBuffer:%d buffer:%08X%08X", current, current,val, length,  i, swap_counter, bits_in_buffer, (uint32) (buffer >> 32), (uint32) buffer));
 			}
+			else
+			{
+				PB_CompressionBuffer repeated_chars = 0;
 
-			memset(output_pointer, out, repeated_chars);
-			output_pointer += repeated_chars;
+				READ_N_BITS(input_pointer, buffer, bits_in_buffer, repeated_chars, PB_RUN_LENGTH_BIT_SIZE);
+
+				DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
+				repeated_chars += PB_MIN_RUN_LENGTH;
+				current = map[val].symbol;
+
+				if (current == master_symbol)
+				{
+					swap_counter--;
+					if (swap_counter < 0)
+					{
+						PB_PrefixCode val;
+						int length;
+
+						DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
+						current = swap_map[val].symbol;
+
+						READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+					}
+				}
+
+				PB_DEBUG3(errmsg("SRLE %c (%d) code:%u len:%u i:%d swap_counter:%lu bitsInBuffer:%d buffer:%08X%08X", current, current,val, length,  i, repeated_chars, bits_in_buffer, (uint32) (buffer >> 32), (uint32) buffer));
+
+				i -= (int) repeated_chars;
+				if (i < (-1))
+				{
+					repeated_chars -= (PB_CompressionBuffer) (-(i + 1));
+				}
+
+				memset(output_pointer, current, repeated_chars);
+				output_pointer += repeated_chars;
+			}
 		}
 	}
 
-	pfree(map);
-	pfree(input_slice);
+	release_decoding_maps(maps);
+
+	PB_TRACE(errmsg("<-decode_pc_swp_rle_idx()"))
+}
+
+/**
+ * init_compressed_sequence()
+ * 		Allocates a compressed sequence and fills in its header and code.
+ *
+ * 	uint32 compressed_size : size calculated with get_compressed_size()
+ * 	PB_CodeSet* codeset : codeset for encoding
+ * 	PB_SequenceInfo* info : info about the sequence to compress
+ */
+static PB_CompressedSequence* init_compressed_sequence(uint32 compressed_size,
+													   PB_CodeSet* codeset,
+													   PB_SequenceInfo* info)
+{
+	PB_CompressedSequence* result;
+
+	result = palloc0(compressed_size);
+	SET_VARSIZE(result, compressed_size);
+	result->version = PB_COMPRESSED_SEQUENCE_VERSION;
+	result->sequence_length = info->sequence_length;
+	if (codeset->is_fixed)
+	{
+		result->is_fixed = TRUE;
+		result->n_symbols = 0;
+		result->n_swapped_symbols = codeset->fixed_id;
+		if (PB_CODESET_IS_CODEBOOK(codeset))
+			*PB_COMPRESSED_SEQUENCE_CODEBOOK_ID_POINTER(result) = codeset->codebook_id;
+		PB_DEBUG1(errmsg("encode(): uses fix code with id %d", codeset->fixed_id));
+	}
+	else
+	{
+		PB_Codeword* code = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(result);
+
+		result->is_fixed = FALSE;
+		result->n_symbols = codeset->n_symbols;
+		result->n_swapped_symbols = codeset->n_swapped_symbols;
+		memcpy(code,
+			   codeset->words,
+			   codeset->n_symbols * sizeof(PB_Codeword));
+		PB_DEBUG1(errmsg("encode(): copied sequence specific code"));
+	}
+
+	result->has_equal_length = codeset->has_equal_length;
+	result->uses_rle = codeset->uses_rle;
 
-	PB_TRACE(errmsg("<-decode_pc_rle_idx()"));
+	result->index_part_shift = info->index_part_shift;
+	if (codeset->has_equal_length || info->sequence_length < PB_COMPRESSED_SEQUENCE_INDEX_PART_SIZE(result))
+		result->has_index = FALSE;
+	else
+		result->has_index = TRUE;
+
+	result->has_composition = info->sequence_length >= PB_COMPOSITION_MIN_LENGTH;
+
+	return result;
 }
 
 /**
- * decode_pc_swp_idx()
- * 		Decode a sequence from encode_pc_swp or encode_pc_swp_idx
+ * get_sequence_codeset()
+ * 		Restores the code of a compressed sequence. Sequence specific
+ * 		codes are copied and must be freed by the caller.
  *
+ * 	PB_CompressedSequence* header : detoasted header including the code
+ * 	PB_CodeSet** fixed_codesets : fixed codes
  */
-static void decode_pc_swp_idx(Varlena* input,
-							  uint8* output,
-							  uint32 start_position,
-							  uint32 output_length,
-							  PB_IndexEntry* start_entry,
-							  PB_CodeSet* codeset)
+static PB_CodeSet* get_sequence_codeset(const PB_CompressedSequence* header,
+										PB_CodeSet** fixed_codesets)
 {
-	PB_CompressionBuffer buffer;
-	int bits_in_buffer;
-	int i;
-	int swap_counter;
-
-	PB_CompressedSequence* sequence_header;
-	int stream_offset;
-
-	Varlena* input_slice;
-	PB_CompressionBuffer* input_pointer;
-	uint8* output_pointer = output;
-
-	PB_DecodingMap* map = get_decoding_map(codeset, PB_NO_SWAP_MAP);
-	PB_DecodingMap* swap_map = get_decoding_map(codeset, PB_SWAP_MAP);
+	PB_CodeSet* codeset;
 
-	const uint8 master_symbol = codeset->words[codeset->n_symbols - codeset->n_swapped_symbols].symbol;
+	if (header->is_fixed)
+	{
+		codeset = get_fixed_codeset(header, fixed_codesets);
 
-	const int max_codeword_length = codeset->words[codeset->n_symbols - 1].code_length +
-									codeset->words[master_symbol].code_length +
-									PB_SWAP_RUN_LENGTH_BIT_SIZE;
-	const int raw_size = toast_raw_datum_size((Datum)input);
+		PB_DEBUG1(errmsg("decode():uses fixed code with id %u", header->n_swapped_symbols));
+	}
+	else
+	{
+		int code_size = sizeof(PB_Codeword) * header->n_symbols;
+		PB_Codeword* code;
+		int i;
 
-	PB_TRACE(errmsg("->decode_pc_swp_idx()"));
+		codeset = palloc0(sizeof(PB_CodeSet) + code_size);
+		codeset->n_symbols = header->n_symbols;
+		codeset->n_swapped_symbols = header->n_swapped_symbols;
+		codeset->is_fixed = FALSE;
+		codeset->has_equal_length = header->has_equal_length;
+		codeset->uses_rle = header->uses_rle;
 
-	/*
-	 * Calculate the offset of the stream in the compressed data.
-	 */
-	sequence_header = (PB_CompressedSequence*)
-					  PG_DETOAST_DATUM_SLICE(input, 0, sizeof(PB_CompressedSequence) - VARHDRSZ);
-	stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(sequence_header) - VARHDRSZ;
-	pfree(sequence_header);
+		code = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(header);
+		memcpy(codeset->words, code, code_size);
 
-	PB_DEBUG1(errmsg("decode_pc_swp_idx():calculated stream offset:%u", stream_offset));
+		for (i = 0; i < codeset->n_symbols - codeset->n_swapped_symbols; i++)
+			if (codeset->max_codeword_length < codeset->words[i].code_length)
+				codeset->max_codeword_length = codeset->words[i].code_length;
 
-	/*
-	 * Detoast the data slice that contains the desired substring.
-	 */
-	if (!start_entry)
-	{
-		/*
-		 * Calculate upper bound for slice size.
-		 */
-		int slice_size = (start_position + output_length) *
-						 max_codeword_length /
-						 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
-		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+		for (i = codeset->n_symbols - codeset->n_swapped_symbols; i < codeset->n_symbols; i++)
+			if (codeset->max_codeword_length < codeset->words[i].code_length)
+				codeset->max_codeword_length = codeset->words[i].code_length;
 
-		/*
-		 * If upper bound exceeds raw size, limit slice size.
-		 */
-		if (slice_size + stream_offset > raw_size)
-			slice_size = raw_size - stream_offset;
+		PB_DEBUG1(errmsg("decode():Sequence specific code copied"));
+	}
 
-		input_slice = (Varlena*)
-					  PG_DETOAST_DATUM_SLICE(input,
-											 stream_offset,
-											 slice_size);
+	return codeset;
+}
 
-		PB_DEBUG1(errmsg("decode_pc_swp_idx(): skipping through sequence\n\tslice size is %d bytes", slice_size));
+/*
+ * public functions
+ */
 
-		i = start_position - 1;
-		input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
+/**
+ * get_decoding_maps()
+ * 		Returns the decoding maps for a prefix code set.
+ *
+ * 	The result must be given back with release_decoding_maps().
+ *
+ * 	PB_CodeSet* codeset : codeset to get maps for
+ */
+PB_DecodingMaps* get_decoding_maps(const PB_CodeSet* codeset)
+{
+	PB_DecodingMaps* maps;
+	int i;
 
-		buffer = *input_pointer;
-		input_pointer++;
-		swap_counter = buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - PB_SWAP_RUN_LENGTH_BIT_SIZE);
-		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - PB_SWAP_RUN_LENGTH_BIT_SIZE;
-		buffer = buffer << PB_SWAP_RUN_LENGTH_BIT_SIZE;
-	}
-	else
+	if (codeset->is_fixed)
 	{
-		/*
-		 * An index entry is defined.
-		 *  -> get the slice starting at indexed position.
-		 */
-		int slice_start = stream_offset +
-						  start_entry->block * PB_COMPRESSION_BUFFER_BYTE_SIZE;
-		int slice_size = (output_length + (start_position % PB_INDEX_PART_SIZE)) *
-						 max_codeword_length /
-						 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
-		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+		for (i = 0; i < n_fixed_decoding_maps; i++)
+			if (fixed_decoding_maps[i]->fixed_codeset == codeset)
+				return fixed_decoding_maps[i];
 
-		/*
-		 * If upper bound exceeds raw size, limit slice size.
-		 */
-		if (slice_size + slice_start > raw_size)
-			slice_size = raw_size - slice_start;
+		if (n_fixed_decoding_maps < PB_MAX_CACHED_FIXED_CODES)
+		{
+			maps = (PB_DecodingMaps*) MemoryContextAlloc(TopMemoryContext, sizeof(PB_DecodingMaps));
+			init_decoding_maps(maps, codeset);
+			maps->is_cached = TRUE;
 
-		input_slice = (Varlena*)
-					  PG_DETOAST_DATUM_SLICE(input,
-											 slice_start,
-											 slice_size);
+			fixed_decoding_maps[n_fixed_decoding_maps] = maps;
+			n_fixed_decoding_maps++;
 
-		PB_DEBUG1(errmsg("decode_pc_swp_idx(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes\n\tswap shift:%d", start_entry->block, slice_start, slice_size,start_entry->swap_shift));
+			PB_DEBUG1(errmsg("get_decoding_maps(): cached maps for fixed code %d", n_fixed_decoding_maps - 1));
 
-		input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
-		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - start_entry->bit;
-		buffer = *(input_pointer) << start_entry->bit;
-		input_pointer++;
-		i = ((start_position + 1) % PB_INDEX_PART_SIZE) - 1;
-		swap_counter = start_entry->swap_shift;
+			return maps;
+		}
 	}
-
-	PB_DEBUG1(errmsg("decode_pc_swp_idx(): reading %d chars to skip, swap_counter = %d, bib=%d", i + 1, swap_counter, bits_in_buffer));
-
-	/*
-	 * Skipping start of sequence.
-	 */
-	while (i >= 0)
+	else
 	{
-		PB_PrefixCode val;
-		int length;
+		const uint32 hash = get_code_hash(codeset);
 
-		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
-		i--;
-		if (map[val].symbol == master_symbol)
+		for (i = 0; i < PB_MAX_CACHED_CODES; i++)
 		{
-			swap_counter--;
-			if (swap_counter < 0)
+			maps = cached_decoding_maps[i];
+
+			if (maps &&
+				maps->hash == hash &&
+				maps->n_symbols == codeset->n_symbols &&
+				maps->n_swapped_symbols == codeset->n_swapped_symbols &&
+				maps->uses_rle == codeset->uses_rle &&
+				memcmp(maps->words, codeset->words, codeset->n_symbols * sizeof(PB_Codeword)) == 0)
 			{
-				DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
-				READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+				maps->pin_count++;
+				return maps;
 			}
 		}
-	}
 
-	i += output_length;
+		/*
+		 * Replace the next unpinned entry.
+		 */
+		for (i = 0; i < PB_MAX_CACHED_CODES; i++)
+		{
+			const int slot = (next_decoding_maps_victim + i) % PB_MAX_CACHED_CODES;
 
-	PB_DEBUG1(errmsg("decode_pc_swp_idx(): reading %d chars, swap_counter = %d, bib=%d", i + 1, swap_counter, bits_in_buffer));
+			maps = cached_decoding_maps[slot];
 
-	while (i >= 0)
-	{
-		PB_PrefixCode val;
-		int length;
+			if (maps == NULL || maps->pin_count == 0)
+			{
+				if (!decoding_maps_callback_registered)
+				{
+					RegisterXactCallback(decoding_maps_xact_callback, NULL);
+					decoding_maps_callback_registered = TRUE;
+				}
 
-		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
-		if (map[val].symbol != master_symbol)
-		{
-			PB_DEBUG3(errmsg("NORMAL: i:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, val, length, map[val].symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
+				if (maps == NULL)
+					maps = (PB_DecodingMaps*) MemoryContextAlloc(TopMemoryContext, sizeof(PB_DecodingMaps));
+				else if (maps->multi_map)
+					pfree(maps->multi_map);
 
-			*output_pointer = map[val].symbol;
-			output_pointer++;
-			i--;
-		}
-		else
-		{
-			if (swap_counter > 0)
-			{
-				PB_DEBUG3(errmsg("MASTER: i:%d swap_counter:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, swap_counter, val, length, master_symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
+				init_decoding_maps(maps, codeset);
+				maps->is_cached = TRUE;
+				maps->pin_count = 1;
 
-				*output_pointer = master_symbol;
-				output_pointer++;
-				i--;
-				swap_counter--;
-			}
-			else
-			{
-				DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
-				PB_DEBUG3(errmsg("SLAVE i:%d val:%u len:%u s:%c buf:%08X%08X bib:%d", i, val, length, swap_map[val].symbol, (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
+				cached_decoding_maps[slot] = maps;
+				next_decoding_maps_victim = (slot + 1) % PB_MAX_CACHED_CODES;
 
-				*output_pointer = swap_map[val].symbol;
-				output_pointer++;
-				i--;
-				READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+				PB_DEBUG1(errmsg("get_decoding_maps(): cached maps in slot %d", slot));
+
+				return maps;
 			}
 		}
 	}
 
-	pfree(map);
-	pfree(swap_map);
-	pfree(input_slice);
+	/*
+	 * Cache is full, build maps for this call only.
+	 */
+	maps = (PB_DecodingMaps*) palloc(sizeof(PB_DecodingMaps));
+	init_decoding_maps(maps, codeset);
 
-	PB_TRACE(errmsg("<-decode_pc_swp_idx()"));
+	return maps;
 }
 
 /**
- * decode_pc_swp_rle_idx()
- * 		Decode a sequence from encode_pc_swp_rle or encode_pc_swp_rle_idx
+ * get_multi_decoding_map()
+ * 		Returns the multi-symbol decoding map for a set of decoding maps.
  *
+ * 	PB_DecodingMaps* maps : decoding maps from get_decoding_maps()
+ * 	int64 n_symbols : number of symbols that will be decoded
  */
-static void decode_pc_swp_rle_idx(Varlena* input,
-								  uint8* output,
-								  uint32 start_position,
-								  uint32 output_length,
-								  PB_IndexEntry* start_entry,
-								  PB_CodeSet* codeset)
+const PB_MultiDecodingMap* get_multi_decoding_map(PB_DecodingMaps* maps,
+												  int64 n_symbols)
 {
-	PB_CompressionBuffer buffer;
-	int bits_in_buffer;
-	int i;
-	int swap_counter;
-
-	PB_CompressedSequence* sequence_header;
-	int stream_offset;
-
-	Varlena* input_slice;
-	PB_CompressionBuffer* input_pointer;
-	uint8* output_pointer = output;
-
-	PB_DecodingMap* map = get_decoding_map(codeset, PB_NO_SWAP_MAP);
-	PB_DecodingMap* swap_map = get_decoding_map(codeset, PB_SWAP_MAP);
-
-	const uint8 master_symbol = codeset->words[codeset->n_symbols - codeset->n_swapped_symbols].symbol;
-	const int max_codeword_length = codeset->words[codeset->n_symbols - 1].code_length +
-									codeset->words[master_symbol].code_length +
-									PB_SWAP_RUN_LENGTH_BIT_SIZE;
-	const int raw_size = toast_raw_datum_size((Datum)input);
+	if (maps->multi_map == NULL && n_symbols >= PB_MULTI_DECODE_MIN_LENGTH)
+		maps->multi_map = get_multi_decoding_map_from_maps(maps,
+														   maps->is_cached ? TopMemoryContext : CurrentMemoryContext);
 
-	PB_TRACE(errmsg("->decode_pc_swp_rle_idx(%u,%u)", start_position, output_length));
-
-	/*
-	 * Calculate the offset of the stream in the compressed data.
-	 */
-	sequence_header = (PB_CompressedSequence*)
-					  PG_DETOAST_DATUM_SLICE(input, 0, sizeof(PB_CompressedSequence) - VARHDRSZ);
-	stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(sequence_header) - VARHDRSZ;
-	pfree(sequence_header);
-
-	PB_DEBUG1(errmsg("decode_pc_swp_rle_idx():calculated stream offset:%u", stream_offset));
+	return maps->multi_map;
+}
 
-	/*
-	 * Detoast the data slice that contains the desired substring.
-	 */
-	if (!start_entry)
+/**
+ * release_decoding_maps()
+ * 		Gives back decoding maps obtained by get_decoding_maps().
+ *
+ * 	PB_DecodingMaps* maps : decoding maps
+ */
+void release_decoding_maps(PB_DecodingMaps* maps)
+{
+	if (!maps->is_cached)
 	{
-		/*
-		 * Calculate upper bound for slice size.
-		 */
-		int slice_size = (start_position + output_length) *
-						 max_codeword_length /
-						 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
-		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
-
-		/*
-		 * If upper bound exceeds raw size, limit slice size.
-		 */
-		if (slice_size + stream_offset > raw_size)
-			slice_size = raw_size - stream_offset;
-
-		input_slice = (Varlena*)
-					  PG_DETOAST_DATUM_SLICE(input,
-											 stream_offset,
-											 slice_size);
-
-		PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): skipping through sequence\n\tslice size is %d bytes", slice_size));
-
-		i = start_position - 1;
-		input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
-
-		buffer = *input_pointer;
-		input_pointer++;
-		swap_counter = buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - PB_SWAP_RUN_LENGTH_BIT_SIZE);
-		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - PB_SWAP_RUN_LENGTH_BIT_SIZE;
-		buffer = buffer << PB_SWAP_RUN_LENGTH_BIT_SIZE;
-
-		PB_DEBUG1(errmsg("buf:%08X%08X bib:%d", (unsigned int) (buffer >> 32), (unsigned int) buffer, bits_in_buffer));
+		if (maps->multi_map)
+			pfree(maps->multi_map);
+		pfree(maps);
 	}
-	else
-	{
-		/*
-		 * An index entry is defined.
-		 *  -> get the slice starting at indexed position.
-		 */
-		int slice_start = stream_offset +
-						  start_entry->block * PB_COMPRESSION_BUFFER_BYTE_SIZE;
-		int slice_size = (output_length + (start_position % PB_INDEX_PART_SIZE)) *
-						 max_codeword_length /
-						 PB_COMPRESSION_BUFFER_BIT_SIZE + 1;
-		slice_size *= PB_COMPRESSION_BUFFER_BYTE_SIZE;
+	else if (maps->pin_count > 0)
+		maps->pin_count--;
+}
 
-		/*
-		 * If upper bound exceeds raw size, limit slice size.
-		 */
-		if (slice_size + slice_start > raw_size)
-			slice_size = raw_size - slice_start;
+/**
+ * get_compressed_size()
+ * 		Compute the size of a compressed sequence.
+ *
+ * 	PB_SequenceInfo* info : stats of input sequence
+ * 	PB_CodeSet* codeset : code to test
+ */
+uint32 get_compressed_size(const PB_SequenceInfo* info,
+						   PB_CodeSet* codeset)
+{
+	uint64 total_stream_size_bits = 0;
+	uint32 total_size = 0;
 
-		input_slice = (Varlena*)
-					  PG_DETOAST_DATUM_SLICE(input,
-											 slice_start,
-											 slice_size);
+	int i;
 
-		PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): index entry given\n\tstarting in block %u\n\tslice starts at byte %d\n\tslice size is %d bytes\nrle_shift:%u\nswap_shift:%u", start_entry->block, slice_start, slice_size,start_entry->rle_shift, start_entry->swap_shift));
+	const uint32* frequencies;
 
-		input_pointer = (PB_CompressionBuffer*) VARDATA_ANY(input_slice);
-		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - start_entry->bit;
-		buffer = *(input_pointer) << start_entry->bit;
-		input_pointer++;
-		i = ((start_position + 1) % PB_INDEX_PART_SIZE) - 1 + start_entry->rle_shift;
-		swap_counter = start_entry->swap_shift;
-	}
+	PB_TRACE(errmsg("->get_compressed_stream_size()"));
 
-	PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): reading %d chars to skip, swap_counter = %d, bib=%d, rle_shift=%u", i + 1, swap_counter, bits_in_buffer, start_entry == NULL ? -1 : start_entry->rle_shift));
+	if (info->n_symbols > codeset->n_symbols)
+		ereport(ERROR,(errmsg("code set can not express given sequence")));
 
-	/*
-	 * Skipping.
-	 */
-	while (i >= 0)
+	if (codeset->uses_rle)
 	{
-		PB_PrefixCode val;
-		int length;
-		uint8 current;
+		frequencies = info->rle_info->rle_frequencies;
+		total_stream_size_bits += frequencies[PB_RUN_LENGTH_SYMBOL] * PB_RUN_LENGTH_BIT_SIZE;
+	}
+	else
+		frequencies = info->frequencies;
 
-		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
-		current = map[val].symbol;
-		i--;
+	if (codeset->is_fixed && codeset->has_equal_length && !codeset->uses_rle)
+	{
+		/*
+		 * Independent of the frequencies, which encode_with_stats()
+		 * collects during encoding only.
+		 */
+		total_stream_size_bits += (uint64) info->sequence_length * codeset->max_codeword_length;
+	}
+	else if (codeset->n_swapped_symbols > 0 && codeset->is_fixed == FALSE)
+	{
+		/*
+		 * If code set is swapped
+		 */
+		uint8 master_symbol = codeset->words[codeset->n_symbols - codeset->n_swapped_symbols].symbol;
+		uint8 master_symbol_length = 0;
 
-		if (current == master_symbol)
+		for (i = 0; i < codeset->n_symbols - codeset->n_swapped_symbols; i++)
 		{
-			swap_counter--;
-			if (swap_counter < 0)
+			total_stream_size_bits += frequencies[codeset->words[i].symbol] * codeset->words[i].code_length;
+			if (codeset->words[i].symbol == master_symbol)
 			{
-				DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
-				current = swap_map[val].symbol;
-				READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+				master_symbol_length = codeset->words[i].code_length + PB_SWAP_RUN_LENGTH_BIT_SIZE;
 			}
+
+			PB_DEBUG1(errmsg("M %c: %u x %u = %u", codeset->words[i].symbol,frequencies[codeset->words[i].symbol], codeset->words[i].code_length, frequencies[codeset->words[i].symbol] * codeset->words[i].code_length));
 		}
 
-		if (current == PB_RUN_LENGTH_SYMBOL)
+		for (i = codeset->n_symbols - codeset->n_swapped_symbols + 1; i < codeset->n_symbols; i++)
 		{
-			int repeated_chars = 0;
-
-			READ_N_BITS(input_pointer, buffer, bits_in_buffer, repeated_chars, PB_RUN_LENGTH_BIT_SIZE);
+			total_stream_size_bits += frequencies[codeset->words[i].symbol] *
+					(codeset->words[i].code_length + master_symbol_length);
 
-			i -= repeated_chars + PB_MIN_RUN_LENGTH - 2;
-			/*
-			 * Note: (-2) because 1 has been deducted in this iteration above and
-			 * 			1 will be deducted in the next iteration, when the symbol
-			 * 			after the RLE is read.
-			 */
+			PB_DEBUG1(errmsg("S %c: %u x %u = %u", codeset->words[i].symbol,frequencies[codeset->words[i].symbol], codeset->words[i].code_length + master_symbol_length, frequencies[codeset->words[i].symbol] * (codeset->words[i].code_length + master_symbol_length)));
 		}
-	}
 
-	if (i < -1)
+		total_stream_size_bits += PB_SWAP_RUN_LENGTH_BIT_SIZE;
+		total_stream_size_bits += (frequencies[master_symbol] / PB_MAX_SWAP_RUN_LENGTH) * (PB_SWAP_RUN_LENGTH_BIT_SIZE + 1);
+	}
+	else
 	{
-		/*
-		 * The symbol read was an RLE symbol. Write out remaining chars.
-		 */
-		int repeated_chars = -i;
-		PB_PrefixCode val;
-		int length;
-		uint8 current;
-
-		if (repeated_chars >= output_length)
+		for (i = 0; i < codeset->n_symbols; i++)
 		{
-			repeated_chars = output_length;
-		}
+			total_stream_size_bits += frequencies[codeset->words[i].symbol] * codeset->words[i].code_length;
 
-		PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): %d remaining chars from last rle", repeated_chars));
+			PB_DEBUG1(errmsg("P %c: %u x %u = %u", codeset->words[i].symbol,frequencies[codeset->words[i].symbol], codeset->words[i].code_length, frequencies[codeset->words[i].symbol] * codeset->words[i].code_length));
+		}
+	}
 
-		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
-		i--;
-		current = map[val].symbol;
-		if (current == master_symbol)
-		{
-			swap_counter--;
-			if (swap_counter < 0)
-			{
-				PB_PrefixCode val;
-				int length;
+	total_stream_size_bits = PB_ALIGN_BIT_SIZE(total_stream_size_bits);
 
-				DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
-				current = swap_map[val].symbol;
+	total_size = sizeof(PB_CompressedSequence) + sizeof(uint32);
+	if (PB_CODESET_IS_CODEBOOK(codeset))
+		total_size += sizeof(uint32);
+	else if (!codeset->is_fixed)
+		total_size += sizeof(PB_Codeword) * codeset->n_symbols;
+	total_size += codeset->has_equal_length ? 0 : info->sequence_length / (PB_INDEX_PART_SIZE >> info->index_part_shift) * sizeof(PB_IndexEntry);
+	total_size = PB_ALIGN_BYTE_SIZE(total_size);
+	total_size +=  total_stream_size_bits / 8;
+	total_size += PB_COMPOSITION_SIZE(info->sequence_length, codeset->n_symbols);
 
-				READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
-			}
-		}
+	PB_DEBUG1(errmsg("get_compressed_stream_size(): totalsize in byte:%u (%lu bits)", total_size, total_stream_size_bits));
 
-		PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): write %dx%c", repeated_chars,current));
+	PB_TRACE(errmsg("<-get_compressed_stream_size()"));
 
-		memset(output_pointer, current, repeated_chars);
-		output_pointer += repeated_chars;
-	}
+	return total_size;
+}
 
-	i += output_length;
 
-	PB_DEBUG1(errmsg("decode_pc_swp_rle_idx(): reading %d chars, swap_counter = %d, bib=%d", i + 1, swap_counter, bits_in_buffer));
+/**
+ * encode()
+ * 		Encode a sequence.
+ *
+ * 	uint8* input : input sequence, not null-terminated
+ * 					length must be in info
+ * 	uint32 compressed_size : length of the compressed stream, calculated
+ * 									with get_compressed_stream_size()
+ * 	PB_CodeSet* codeset : codeset for encoding
+ * 	PB_SequenceInfo* info : info about the sequence to compresss
+ */
+PB_CompressedSequence* encode(uint8* input,
+							  uint32 compressed_size,
+							  PB_CodeSet* codeset,
+							  PB_SequenceInfo* info)
+{
+	PB_CompressedSequence* result;
 
-	while (i >= 0)
-	{
-		PB_PrefixCode val;
-		int length;
-		uint8 current;
+	PB_TRACE(errmsg("->encode(): compressed size:%u, uncompressed size:%u", compressed_size, info->sequence_length));
 
-		DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
-		current = map[val].symbol;
+	result = init_compressed_sequence(compressed_size, codeset, info);
 
-		if (current != master_symbol && current != PB_RUN_LENGTH_SYMBOL)
+	/*
+	 * Choose the encoding function
+	 */
+	if (result->has_index)
+	{
+		if (codeset->n_swapped_symbols > 0)
 		{
-			*output_pointer = current;
-			output_pointer++;
-			i--;
-
-			PB_DEBUG3(errmsg("NSNRLE %c (%d) code:%u len:%u i:%d swap_counter:%d bitsInBuffer:%d buffer:%08X%08X", current, current,val, length,  i, swap_counter, bits_in_buffer, (uint32) (buffer >> 32), (uint32) buffer));
+			if (codeset->uses_rle)
+				encode_pc_swp_rle_idx(input, result, codeset);
+			else
+				encode_pc_swp_idx(input, result, codeset);
 		}
 		else
 		{
-			if (current == master_symbol)
-			{
-				swap_counter--;
-				if (swap_counter < 0)
-				{
-					PB_PrefixCode val;
-					int length;
+			if (codeset->uses_rle)
+				encode_pc_rle_idx(input, result, codeset);
+			else
+				encode_pc_idx(input, result, codeset);
+		}
+	}
+	else
+	{
+		if (codeset->n_swapped_symbols > 0)
+		{
+			if (codeset->uses_rle)
+				encode_pc_swp_rle(input, result, codeset);
+			else
+				encode_pc_swp(input, result, codeset);
+		}
+		else
+		{
+			if (codeset->uses_rle)
+				encode_pc_rle(input, result, codeset);
+			else if (codeset->has_equal_length)
+				encode_pc_equal_length(input, result, codeset);
+			else
+				encode_pc(input, result, codeset);
+		}
+	}
 
-					DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
-					current = swap_map[val].symbol;
+	*PB_COMPRESSED_SEQUENCE_HASH_POINTER(result) = get_input_crc32(input, info->sequence_length, codeset);
 
-					READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
-				}
-			}
+	if (result->has_composition)
+		encode_composition(input, result, codeset);
 
-			if (current != PB_RUN_LENGTH_SYMBOL)
-			{
-				*output_pointer = current;
-				output_pointer++;
-				i--;
+	PB_COUNT(symbols_encoded[PB_CODE_KIND(codeset)], info->sequence_length);
 
-				PB_DEBUG3(errmsg("SNRLE %c (%d) code:%u len:%u i:%d swap_counter:%d bitsInBuffer:%d buffer:%08X%08X", current, current,val, length,  i, swap_counter, bits_in_buffer, (uint32) (buffer >> 32), (uint32) buffer));
-			}
-			else
-			{
-				PB_CompressionBuffer repeated_chars = 0;
+	PB_TRACE(errmsg("<-encode()"));
 
-				READ_N_BITS(input_pointer, buffer, bits_in_buffer, repeated_chars, PB_RUN_LENGTH_BIT_SIZE);
+	return result;
+}
 
-				DECODE(input_pointer, buffer, bits_in_buffer, val, length, map);
-				repeated_chars += PB_MIN_RUN_LENGTH;
-				current = map[val].symbol;
+/**
+ * encode_with_stats()
+ * 		Encode a sequence with a fixed code of equal length codewords and
+ * 		collect its symbol frequencies in the same pass.
+ *
+ * 		The input is processed in chunks of PB_FUSED_CHUNK_SIZE symbols.
+ * 		Each chunk is counted, packed, checksummed and added to the
+ * 		composition while it is in the CPU cache, so the input is read
+ * 		from memory once. The caller must complete the info and check,
+ * 		whether the code can express the sequence, before using the result.
+ *
+ * 	uint8* input : input sequence, not null-terminated
+ * 	PB_CodeSet* codeset : fixed code with equal length codewords and without RLE
+ * 	PB_SequenceInfo* info : info with sequence_length and index_part_shift set,
+ * 							symbol frequencies are added
+ */
+PB_CompressedSequence* encode_with_stats(uint8* input,
+										 PB_CodeSet* codeset,
+										 PB_SequenceInfo* info)
+{
+	const uint32 length = info->sequence_length;
+	const int code_length = codeset->max_codeword_length;
+	PB_CompressedSequence* result;
+	PB_CompressionBuffer* stream;
+	uint8 codes[PB_PACK_MAP_SIZE];
+	uint8 symbols[PB_PACK_MAP_SIZE];
+	uint32* row = NULL;
+	uint32 crc = PB_CRC32_INIT;
+	uint32 position = 0;
+	uint32 row_end = PB_INDEX_PART_SIZE;
 
-				if (current == master_symbol)
-				{
-					swap_counter--;
-					if (swap_counter < 0)
-					{
-						PB_PrefixCode val;
-						int length;
+	PB_TRACE(errmsg("->encode_with_stats(), len=%u", length));
 
-						DECODE(input_pointer, buffer, bits_in_buffer, val, length, swap_map);
-						current = swap_map[val].symbol;
+	/*
+	 * Chunks must end on block boundaries.
+	 */
+	if (PB_COMPRESSION_BUFFER_BIT_SIZE % code_length != 0)
+	{
+		count_symbols(input, length, info->frequencies);
+		result = encode(input, get_compressed_size(info, codeset), codeset, info);
 
-						READ_N_BITS(input_pointer, buffer, bits_in_buffer, swap_counter, PB_SWAP_RUN_LENGTH_BIT_SIZE);
-					}
-				}
+		PB_TRACE(errmsg("<-encode_with_stats()"));
 
-				PB_DEBUG3(errmsg("SRLE %c (%d) code:%u len:%u i:%d swap_counter:%lu bitsInBuffer:%d buffer:%08X%08X", current, current,val, length,  i, repeated_chars, bits_in_buffer, (uint32) (buffer >> 32), (uint32) buffer));
+		return result;
+	}
 
-				i -= (int) repeated_chars;
-				if (i < (-1))
-				{
-					repeated_chars -= (PB_CompressionBuffer) (-(i + 1));
-				}
+	result = init_compressed_sequence(get_compressed_size(info, codeset), codeset, info);
+	stream = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(result);
 
-				memset(output_pointer, current, repeated_chars);
-				output_pointer += repeated_chars;
-			}
+	get_equal_length_codes(codeset, codes);
+	if (codeset->ignore_case)
+		get_crc32_symbols(codeset, symbols);
+	if (result->has_composition)
+		row = (uint32*) (((uint8*) result) +
+			  PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(result, VARSIZE(result), codeset->n_symbols));
+
+	while (position < length)
+	{
+		const uint32 chunk_length = Min(length - position, PB_FUSED_CHUNK_SIZE);
+		const uint8* chunk = input + position;
+
+		count_symbols(chunk, chunk_length, info->frequencies);
+		pack_equal_length(chunk,
+						  chunk_length,
+						  codes,
+						  code_length,
+						  stream + position / (PB_COMPRESSION_BUFFER_BIT_SIZE / code_length));
+		crc = update_input_crc32(crc, chunk, chunk_length, codeset->ignore_case ? symbols : NULL);
+
+		position += chunk_length;
+
+		/*
+		 * Rows of the composition end at multiples of PB_INDEX_PART_SIZE,
+		 * which is a multiple of PB_FUSED_CHUNK_SIZE.
+		 */
+		if (row && position == row_end)
+		{
+			write_composition_row(row, info->frequencies, codeset);
+			row += codeset->n_symbols;
+			row_end += PB_INDEX_PART_SIZE;
 		}
 	}
 
-	pfree((PB_DecodingMap*) map);
-	pfree((PB_DecodingMap*) swap_map);
+	if (row)
+		write_composition_row(row, info->frequencies, codeset);
+
+	*PB_COMPRESSED_SEQUENCE_HASH_POINTER(result) = PB_CRC32_FINAL(crc);
 
-	PB_TRACE(errmsg("<-decode_pc_swp_rle_idx()"))
-}
+	PB_COUNT(symbols_encoded[PB_CODE_KIND_EQUAL_LENGTH], length);
 
-/*
- * public functions
- */
+	PB_TRACE(errmsg("<-encode_with_stats()"));
+
+	return result;
+}
 
 /**
- * get_compressed_size()
- * 		Compute the size of a compressed sequence.
+ * splice_sequences()
+ * 		Concatenate two sequences encoded with the same fixed code of
+ * 		equal length codewords without encoding again. Returns NULL
+ * 		for other sequences.
  *
- * 	PB_SequenceInfo* info : stats of input sequence
- * 	PB_CodeSet* codeset : code to test
+ * 		Such sequences have no index, so the stream of the second
+ * 		sequence is shifted behind the stream of the first one. The
+ * 		CRC32 and the composition of the first sequence are continued
+ * 		with the decoded second sequence. The result is the same as
+ * 		encoding the concatenation with the same code.
+ *
+ * 	Varlena* raw_seq1 : first possibly toasted sequence
+ * 	Varlena* raw_seq2 : second possibly toasted sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
  */
-uint32 get_compressed_size(const PB_SequenceInfo* info,
-						   PB_CodeSet* codeset)
+PB_CompressedSequence* splice_sequences(Varlena* raw_seq1,
+										Varlena* raw_seq2,
+										PB_CodeSet** fixed_codesets)
 {
-	uint64 total_stream_size_bits = 0;
-	uint32 total_size = 0;
-
+	PB_CompressedSequence* header1;
+	PB_CompressedSequence* header2;
+	PB_CompressedSequence* seq1;
+	PB_CompressedSequence* seq2;
+	PB_CompressedSequence* result;
+	PB_CodeSet* codeset;
+	PB_SequenceInfo info;
+	uint32 counts[PB_SOURCE_ALPHABET_SIZE];
+	uint32* base_row = NULL;
+	uint32* row = NULL;
+	uint8* chunk;
+	uint32 length1;
+	uint32 length2;
+	uint32 crc;
+	uint32 position;
+	uint32 row_end;
+	int code_length;
 	int i;
 
-	const uint32* frequencies;
+	PB_TRACE(errmsg("->splice_sequences()"));
 
-	PB_TRACE(errmsg("->get_compressed_stream_size()"));
+	header1 = (PB_CompressedSequence*)
+			  PG_DETOAST_DATUM_SLICE(raw_seq1, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
+	header2 = (PB_CompressedSequence*)
+			  PG_DETOAST_DATUM_SLICE(raw_seq2, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
 
-	if (info->n_symbols > codeset->n_symbols)
-		ereport(ERROR,(errmsg("code set can not express given sequence")));
+	codeset = NULL;
+	if (header1->is_fixed && header2->is_fixed &&
+		header1->n_swapped_symbols == header2->n_swapped_symbols &&
+		PB_COMPRESSED_SEQUENCE_HAS_HASH(header1) &&
+		(!PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(header1) ||
+		 *PB_COMPRESSED_SEQUENCE_CODEBOOK_ID_POINTER(header1) == *PB_COMPRESSED_SEQUENCE_CODEBOOK_ID_POINTER(header2)))
+	{
+		codeset = get_fixed_codeset(header1, fixed_codesets);
+		if (!codeset->has_equal_length || codeset->uses_rle)
+			codeset = NULL;
+	}
 
-	if (codeset->uses_rle)
+	length1 = header1->sequence_length;
+	length2 = header2->sequence_length;
+
+	pfree(header1);
+	pfree(header2);
+
+	if (!codeset)
 	{
-		frequencies = info->rle_info->rle_frequencies;
-		total_stream_size_bits += frequencies[PB_RUN_LENGTH_SYMBOL] * PB_RUN_LENGTH_BIT_SIZE;
+		PB_TRACE(errmsg("<-splice_sequences(): codes differ"));
+		return NULL;
 	}
-	else
-		frequencies = info->frequencies;
 
-	if (codeset->n_swapped_symbols > 0 && codeset->is_fixed == FALSE)
+	code_length = codeset->max_codeword_length;
+
+	memset(&info, 0, sizeof(PB_SequenceInfo));
+	info.sequence_length = length1 + length2;
+	info.index_part_shift = 0;
+
+	result = init_compressed_sequence(get_compressed_size(&info, codeset), codeset, &info);
+
+	/*
+	 * Splice the streams.
+	 */
+	seq1 = (PB_CompressedSequence*) PG_DETOAST_DATUM(raw_seq1);
+	seq2 = (PB_CompressedSequence*) PG_DETOAST_DATUM(raw_seq2);
+
+	memcpy(PB_COMPRESSED_SEQUENCE_STREAM_POINTER(result),
+		   PB_COMPRESSED_SEQUENCE_STREAM_POINTER(seq1),
+		   PB_ALIGN_BIT_SIZE((uint64) length1 * code_length) / 8);
+	append_stream(PB_COMPRESSED_SEQUENCE_STREAM_POINTER(result),
+				  (uint64) length1 * code_length,
+				  (uint64) info.sequence_length * code_length,
+				  PB_COMPRESSED_SEQUENCE_STREAM_POINTER(seq2));
+
+	/*
+	 * Rows of the composition ending in the first sequence are copied.
+	 * The others add the counts of the first sequence to those of a
+	 * prefix of the second one.
+	 */
+	if (result->has_composition)
 	{
-		/*
-		 * If code set is swapped
-		 */
-		uint8 master_symbol = codeset->words[codeset->n_symbols - codeset->n_swapped_symbols].symbol;
-		uint8 master_symbol_length = 0;
+		row = (uint32*) (((uint8*) result) +
+			  PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(result, VARSIZE(result), codeset->n_symbols));
+		base_row = palloc0(codeset->n_symbols * sizeof(uint32));
 
-		for (i = 0; i < codeset->n_symbols - codeset->n_swapped_symbols; i++)
+		if (seq1->has_composition)
 		{
-			total_stream_size_bits += frequencies[codeset->words[i].symbol] * codeset->words[i].code_length;
-			if (codeset->words[i].symbol == master_symbol)
-			{
-				master_symbol_length = codeset->words[i].code_length + PB_SWAP_RUN_LENGTH_BIT_SIZE;
-			}
+			const int n_rows = length1 / PB_INDEX_PART_SIZE;
+			const uint32* rows1 = (uint32*) (((uint8*) seq1) +
+				PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(seq1, VARSIZE(seq1), codeset->n_symbols));
 
-			PB_DEBUG1(errmsg("M %c: %u x %u = %u", codeset->words[i].symbol,frequencies[codeset->words[i].symbol], codeset->words[i].code_length, frequencies[codeset->words[i].symbol] * codeset->words[i].code_length));
+			memcpy(row, rows1, n_rows * codeset->n_symbols * sizeof(uint32));
+			memcpy(base_row, rows1 + n_rows * codeset->n_symbols, codeset->n_symbols * sizeof(uint32));
+			row += n_rows * codeset->n_symbols;
 		}
-
-		for (i = codeset->n_symbols - codeset->n_swapped_symbols + 1; i < codeset->n_symbols; i++)
+		else
 		{
-			total_stream_size_bits += frequencies[codeset->words[i].symbol] *
-					(codeset->words[i].code_length + master_symbol_length);
+			chunk = palloc(length1);
+			decode((Varlena*) seq1, chunk, 0, length1, fixed_codesets);
 
-			PB_DEBUG1(errmsg("S %c: %u x %u = %u", codeset->words[i].symbol,frequencies[codeset->words[i].symbol], codeset->words[i].code_length + master_symbol_length, frequencies[codeset->words[i].symbol] * (codeset->words[i].code_length + master_symbol_length)));
-		}
+			memset(counts, 0, sizeof(counts));
+			count_symbols(chunk, length1, counts);
+			write_composition_row(base_row, counts, codeset);
 
-		total_stream_size_bits += PB_SWAP_RUN_LENGTH_BIT_SIZE;
-		total_stream_size_bits += (frequencies[master_symbol] / PB_MAX_SWAP_RUN_LENGTH) * (PB_SWAP_RUN_LENGTH_BIT_SIZE + 1);
+			pfree(chunk);
+		}
 	}
-	else
+
+	/*
+	 * Continue CRC32 and composition with the second sequence. Decoded
+	 * characters are the symbols of the codewords already. Inverting the
+	 * stored CRC32 undoes its final transformation.
+	 */
+	crc = ~(*PB_COMPRESSED_SEQUENCE_HASH_POINTER(seq1));
+	chunk = palloc(PB_INDEX_PART_SIZE);
+	memset(counts, 0, sizeof(counts));
+	position = 0;
+	row_end = (length1 / PB_INDEX_PART_SIZE + 1) * PB_INDEX_PART_SIZE - length1;
+
+	while (position < length2)
 	{
-		for (i = 0; i < codeset->n_symbols; i++)
+		const uint32 chunk_length = Min(length2, row_end) - position;
+
+		decode((Varlena*) seq2, chunk, position, chunk_length, fixed_codesets);
+		crc = crc32_update(crc, chunk, chunk_length);
+
+		position += chunk_length;
+
+		if (row)
 		{
-			total_stream_size_bits += frequencies[codeset->words[i].symbol] * codeset->words[i].code_length;
+			count_symbols(chunk, chunk_length, counts);
 
-			PB_DEBUG1(errmsg("P %c: %u x %u = %u", codeset->words[i].symbol,frequencies[codeset->words[i].symbol], codeset->words[i].code_length, frequencies[codeset->words[i].symbol] * codeset->words[i].code_length));
+			if (position == row_end)
+			{
+				write_composition_row(row, counts, codeset);
+				for (i = 0; i < codeset->n_symbols; i++)
+					row[i] += base_row[i];
+				row += codeset->n_symbols;
+				row_end += PB_INDEX_PART_SIZE;
+			}
 		}
+		else if (position == row_end)
+			row_end += PB_INDEX_PART_SIZE;
 	}
 
-	total_stream_size_bits = PB_ALIGN_BIT_SIZE(total_stream_size_bits);
+	if (row)
+	{
+		write_composition_row(row, counts, codeset);
+		for (i = 0; i < codeset->n_symbols; i++)
+			row[i] += base_row[i];
+		pfree(base_row);
+	}
 
-	total_size = sizeof(PB_CompressedSequence);
-	total_size += codeset->is_fixed ? 0 : sizeof(PB_Codeword) * codeset->n_symbols;
-	total_size += codeset->has_equal_length ? 0 : info->sequence_length / PB_INDEX_PART_SIZE * sizeof(PB_IndexEntry);
-	total_size = PB_ALIGN_BYTE_SIZE(total_size);
-	total_size +=  total_stream_size_bits / 8;
+	*PB_COMPRESSED_SEQUENCE_HASH_POINTER(result) = PB_CRC32_FINAL(crc);
 
-	PB_DEBUG1(errmsg("get_compressed_stream_size(): totalsize in byte:%u (%lu bits)", total_size, total_stream_size_bits));
+	pfree(chunk);
+	if ((Pointer) seq1 != (Pointer) raw_seq1)
+		pfree(seq1);
+	if ((Pointer) seq2 != (Pointer) raw_seq2)
+		pfree(seq2);
 
-	PB_TRACE(errmsg("<-get_compressed_stream_size()"));
+	PB_TRACE(errmsg("<-splice_sequences()"));
 
-	return total_size;
+	return result;
 }
 
-
 /**
- * encode()
- * 		Encode a sequence.
+ * encode_reversed()
+ * 		Encode the reverse of a sequence with its own code, without
+ * 		decoding the whole sequence at once. Returns NULL for codes
+ * 		with swapping or RLE.
  *
- * 	uint8* input : input sequence, not null-terminated
- * 					length must be in info
- * 	uint32 compressed_size : length of the compressed stream, calculated
- * 									with get_compressed_stream_size()
- * 	PB_CodeSet* codeset : codeset for encoding
- * 	PB_SequenceInfo* info : info about the sequence to compresss
+ * 		The sequence is decoded backwards in chunks, which are reversed
+ * 		and added to CRC32, composition and, for prefix codes, encoded.
+ * 		Codes of equal length codewords dividing the block size reverse
+ * 		the stream directly instead. The result is the same as encoding
+ * 		the reversed sequence with the same code.
+ *
+ * 	PB_CompressedSequence* input : detoasted sequence
+ * 	uint32 compressed_size : size of the result, the streams have the same size
+ * 	PB_CodeSet* codeset : code of the sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
  */
-PB_CompressedSequence* encode(uint8* input,
-							  uint32 compressed_size,
-							  PB_CodeSet* codeset,
-							  PB_SequenceInfo* info)
+PB_CompressedSequence* encode_reversed(PB_CompressedSequence* input,
+									   uint32 compressed_size,
+									   PB_CodeSet* codeset,
+									   PB_CodeSet** fixed_codesets)
 {
+	const uint32 length = input->sequence_length;
+	const int code_length = codeset->max_codeword_length;
 	PB_CompressedSequence* result;
-
-	PB_TRACE(errmsg("->encode(): compressed size:%u, uncompressed size:%u", compressed_size, info->sequence_length));
+	PB_ChunkEncoder encoder;
+	PB_SequenceInfo info;
+	uint32 counts[PB_SOURCE_ALPHABET_SIZE];
+	uint32* row = NULL;
+	uint8* chunk;
+	uint32 crc = PB_CRC32_INIT;
+	uint32 position = length;
+	bool packed;
+
+	PB_TRACE(errmsg("->encode_reversed(), len=%u", length));
+
+	if (codeset->uses_rle || codeset->n_swapped_symbols > 0)
+	{
+		PB_TRACE(errmsg("<-encode_reversed(): not supported by code"));
+		return NULL;
+	}
 
 	/*
-	 * Initialization of result
+	 * Equal length codes of sequences with less than two symbols
+	 * have codewords of length 0, which cannot be packed.
 	 */
-	result = palloc0(compressed_size);
-	SET_VARSIZE(result, compressed_size);
-	result->sequence_length = info->sequence_length;
-	if (codeset->is_fixed)
-	{
-		result->is_fixed = TRUE;
-		result->n_symbols = 0;
-		result->n_swapped_symbols = codeset->fixed_id;
-		PB_DEBUG1(errmsg("encode(): uses fix code with id %d", codeset->fixed_id));
-	}
-	else
-	{
-		PB_Codeword* code = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(result);
+	packed = code_length > 0 && codeset->has_equal_length &&
+			 PB_COMPRESSION_BUFFER_BIT_SIZE % code_length == 0;
 
-		result->is_fixed = FALSE;
-		result->n_symbols = codeset->n_symbols;
-		result->n_swapped_symbols = codeset->n_swapped_symbols;
-		memcpy(code,
-			   codeset->words,
-			   codeset->n_symbols * sizeof(PB_Codeword));
-		PB_DEBUG1(errmsg("encode(): copied sequence specific code"));
-	}
+	memset(&info, 0, sizeof(PB_SequenceInfo));
+	info.sequence_length = length;
+	info.index_part_shift = input->index_part_shift;
 
-	result->has_equal_length = codeset->has_equal_length;
-	result->uses_rle = codeset->uses_rle;
+	result = init_compressed_sequence(compressed_size, codeset, &info);
 
-	if (codeset->has_equal_length || info->sequence_length < PB_INDEX_PART_SIZE)
-		result->has_index = FALSE;
+	if (packed)
+		reverse_packed_stream(input, result, code_length);
 	else
-		result->has_index = TRUE;
+		init_chunk_encoder(&encoder, result, codeset);
+
+	if (result->has_composition)
+		row = (uint32*) (((uint8*) result) +
+			  PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(result, VARSIZE(result), codeset->n_symbols));
+
+	memset(counts, 0, sizeof(counts));
+	chunk = palloc(Min(length, PB_INDEX_PART_SIZE) + 1);
 
 	/*
-	 * Choose the encoding function
+	 * Chunks end at multiples of PB_INDEX_PART_SIZE in the result,
+	 * where the rows of the composition end.
 	 */
-	if (result->has_index)
+	while (position > 0)
 	{
-		if (codeset->n_swapped_symbols > 0)
+		const uint32 chunk_length = Min(position, PB_INDEX_PART_SIZE);
+		uint32 i;
+
+		position -= chunk_length;
+		decode((Varlena*) input, chunk, position, chunk_length, fixed_codesets);
+
+		for (i = 0; i < chunk_length / 2; i++)
 		{
-			if (codeset->uses_rle)
-				encode_pc_swp_rle_idx(input, result, codeset);
-			else
-				encode_pc_swp_idx(input, result, codeset);
+			const uint8 symbol = chunk[i];
+
+			chunk[i] = chunk[chunk_length - 1 - i];
+			chunk[chunk_length - 1 - i] = symbol;
 		}
-		else
+
+		crc = crc32_update(crc, chunk, chunk_length);
+		if (!packed)
+			encode_chunk(&encoder, chunk, chunk_length);
+
+		if (row)
 		{
-			if (codeset->uses_rle)
-				encode_pc_rle_idx(input, result, codeset);
-			else
-				encode_pc_idx(input, result, codeset);
+			count_symbols(chunk, chunk_length, counts);
+			if ((length - position) % PB_INDEX_PART_SIZE == 0)
+			{
+				write_composition_row(row, counts, codeset);
+				row += codeset->n_symbols;
+			}
 		}
 	}
+
+	if (row)
+		write_composition_row(row, counts, codeset);
+
+	if (!packed)
+		finish_chunk_encoder(&encoder);
+
+	*PB_COMPRESSED_SEQUENCE_HASH_POINTER(result) = PB_CRC32_FINAL(crc);
+
+	pfree(chunk);
+
+	PB_TRACE(errmsg("<-encode_reversed()"));
+
+	return result;
+}
+
+/**
+ * overlay_sequence()
+ * 		Replace characters of a sequence by as many others without
+ * 		encoding it again. Returns NULL for sequences of version 0,
+ * 		codes with swapping and replacements with characters the code
+ * 		cannot encode.
+ *
+ * 		Codes of equal length codewords without RLE overwrite the
+ * 		codewords in place. Other codes encode the index parts holding
+ * 		the replaced characters again, see overlay_index_parts(). The
+ * 		composition is updated by the difference of the counts and the
+ * 		CRC32 by the CRC32 of the difference of the characters, which is
+ * 		continued over the rest of the sequence as zero bytes.
+ *
+ * 	PB_CompressedSequence* input : detoasted sequence
+ * 	uint32 position : first position to replace, the first position is 0
+ * 	uint8* replacement : new characters
+ * 	uint32 length : number of characters to replace, at least 1, with
+ * 					position + length not behind the end of the sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_CompressedSequence* overlay_sequence(PB_CompressedSequence* input,
+										uint32 position,
+										const uint8* replacement,
+										uint32 length,
+										PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* result = NULL;
+	PB_CodeSet* codeset;
+	PB_EncodingMap* map;
+	uint8 symbols[PB_PACK_MAP_SIZE];
+	uint8* patch;
+	uint8* replaced;
+	uint32 i;
+
+	PB_TRACE(errmsg("->overlay_sequence(), pos=%u, len=%u", position, length));
+
+	if (!PB_COMPRESSED_SEQUENCE_HAS_HASH(input))
+	{
+		PB_TRACE(errmsg("<-overlay_sequence(): no CRC32 stored"));
+		return NULL;
+	}
+
+	codeset = get_sequence_codeset(input, fixed_codesets);
+	map = get_encoding_map(codeset, PB_NO_SWAP_MAP);
+
+	/*
+	 * Codes ignoring case store the symbols of their codewords.
+	 */
+	if (codeset->ignore_case)
+		get_crc32_symbols(codeset, symbols);
 	else
+		for (i = 0; i < PB_PACK_MAP_SIZE; i++)
+			symbols[i] = i;
+
+	patch = palloc(length);
+	replaced = palloc(length);
+
+	for (i = 0; i < length; i++)
 	{
-		if (codeset->n_swapped_symbols > 0)
+		const uint8 symbol = replacement[i];
+
+		if (symbol >= PB_ASCII_SIZE || map[symbol].code_length == 0xFF ||
+			(codeset->uses_rle && symbol == PB_RUN_LENGTH_SYMBOL))
+			break;
+
+		patch[i] = symbols[symbol];
+	}
+
+	if (i == length && codeset->n_swapped_symbols == 0)
+	{
+		if (codeset->has_equal_length && !codeset->uses_rle)
 		{
-			if (codeset->uses_rle)
-				encode_pc_swp_rle(input, result, codeset);
-			else
-				encode_pc_swp(input, result, codeset);
+			decode((Varlena*) input, replaced, position, length, fixed_codesets);
+
+			result = palloc(VARSIZE(input));
+			memcpy(result, input, VARSIZE(input));
+			overlay_packed_stream(result, map, codeset->max_codeword_length, position, patch, length);
 		}
 		else
 		{
-			if (codeset->uses_rle)
-				encode_pc_rle(input, result, codeset);
-			else
-				encode_pc(input, result, codeset);
+			result = overlay_index_parts(input, codeset, map, position, patch, replaced, length, fixed_codesets);
 		}
 	}
 
-	PB_TRACE(errmsg("<-encode()"));
+	if (result)
+	{
+		uint32* hash = PB_COMPRESSED_SEQUENCE_HASH_POINTER(result);
+
+		overlay_composition(result, codeset, position, patch, replaced, length);
+
+		/*
+		 * CRC32s without initial and final inversion are linear.
+		 */
+		for (i = 0; i < length; i++)
+			replaced[i] ^= patch[i];
+		*hash ^= crc32_zeros(crc32_update(0, replaced, length),
+							 (uint64) input->sequence_length - position - length);
+	}
+
+	pfree(patch);
+	pfree(replaced);
+	pfree(map);
+	if (!input->is_fixed)
+		pfree(codeset);
+
+	PB_TRACE(errmsg("<-overlay_sequence(): %s", result ? "replaced" : "not supported"));
 
 	return result;
 }
@@ -2887,96 +4825,88 @@ void decode(Varlena* input,
 		uint32 out_length,
 		PB_CodeSet** fixed_codesets)
 {
-	PB_CompressedSequence* input_header;
-	PB_CodeSet* codeset;
-	PB_IndexEntry* start_entry = NULL;
+	PB_DetoastCursor* cursor;
 
 	PB_TRACE(errmsg("->decode()"));
 
 	/*
-	 * detoast only the header of the sequence
-	 */
-	input_header = (PB_CompressedSequence*) PG_DETOAST_DATUM_SLICE(input,
-																   0,
-																   sizeof(PB_CompressedSequence) - VARHDRSZ);
-
-	PB_DEBUG1(errmsg("decode(): input header detoasted\n\tsequence_length:%u\n\tn_symbols:%u\n\tn_swapped_symbols:%u\n\thas_equal_length:%d\n\thas_index:%d\n\tis_fixed:%d\n\tuses_rle:%d",
-							input_header->sequence_length, input_header->n_symbols, input_header->n_swapped_symbols, input_header->has_equal_length, input_header->has_index, input_header->is_fixed, input_header->uses_rle));
-
-
-	/*
-	 * Restore codeset.
+	 * Empty sequences have no stream to read from.
 	 */
-	if (input_header->is_fixed)
+	if (out_length == 0)
 	{
-		codeset = fixed_codesets[input_header->n_swapped_symbols];
-
-		PB_DEBUG1(errmsg("decode():uses fixed code with id %u", input_header->n_swapped_symbols));
+		PB_TRACE(errmsg("<-decode()"));
+		return;
 	}
-	else
-	{
-		int code_size = sizeof(PB_Codeword) * input_header->n_symbols;
-		PB_Codeword* code;
-		int i;
-
-		codeset = palloc0(sizeof(PB_CodeSet) + code_size);
-		codeset->n_symbols = input_header->n_symbols;
-		codeset->n_swapped_symbols = input_header->n_swapped_symbols;
-		codeset->is_fixed = FALSE;
-		codeset->has_equal_length = input_header->has_equal_length;
-		codeset->uses_rle = input_header->uses_rle;
 
-		pfree(input_header);
-		input_header = (PB_CompressedSequence*)
-					   PG_DETOAST_DATUM_SLICE(input,0,sizeof(PB_CompressedSequence) - VARHDRSZ +
-													  code_size);
+	cursor = open_detoast_cursor(input);
+	decode_from_cursor(cursor, output, start_position, out_length, fixed_codesets);
+	close_detoast_cursor(cursor);
 
-		code = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(input_header);
-		memcpy(codeset->words, code, code_size);
+	PB_TRACE(errmsg("<-decode()"));
+}
 
-		for (i = 0; i < codeset->n_symbols - codeset->n_swapped_symbols; i++)
-			if (codeset->max_codeword_length < codeset->words[i].code_length)
-				codeset->max_codeword_length = codeset->words[i].code_length;
+/**
+ * decode_from_cursor()
+ * 		Decode a compressed sequence read through a detoast cursor.
+ *
+ * 	PB_DetoastCursor* cursor : open cursor on the compressed sequence
+ * 	uint8* output : pointer to sufficient space to store the decoded sequence
+ * 	uint32 start_position : position to start decoding from, first is 0
+ * 	uint32 out_length : number of characters to decode
+ * 	PB_CodeSet** codeset : list of fixed codesets
+ */
+void decode_from_cursor(PB_DetoastCursor* cursor,
+						uint8* output,
+						uint32 start_position,
+						uint32 out_length,
+						PB_CodeSet** fixed_codesets)
+{
+	const PB_CompressedSequence* input_header = cursor->header;
+	PB_CodeSet* codeset;
+	PB_IndexEntry* start_entry = NULL;
+	int entry_offset;
 
-		for (i = codeset->n_symbols - codeset->n_swapped_symbols; i < codeset->n_symbols; i++)
-			if (codeset->max_codeword_length < codeset->words[i].code_length)
-				codeset->max_codeword_length = codeset->words[i].code_length;
+	PB_TRACE(errmsg("->decode_from_cursor()"));
 
-		PB_DEBUG1(errmsg("decode():Sequence specific code copied"));
+	if (out_length == 0)
+	{
+		PB_TRACE(errmsg("<-decode_from_cursor()"));
+		return;
 	}
 
-	if (input_header->has_index)
-	{
-		int start_entry_no;
+	PB_DEBUG1(errmsg("decode(): input header detoasted\n\tsequence_length:%u\n\tn_symbols:%u\n\tn_swapped_symbols:%u\n\thas_equal_length:%d\n\thas_index:%d\n\tis_fixed:%d\n\tuses_rle:%d",
+							input_header->sequence_length, input_header->n_symbols, input_header->n_swapped_symbols, input_header->has_equal_length, input_header->has_index, input_header->is_fixed, input_header->uses_rle));
 
-		start_entry_no = (start_position + 1) / PB_INDEX_PART_SIZE - 1;
-		if (start_entry_no >= 0)
-		{
-			Varlena* data_slice = (Varlena*) PG_DETOAST_DATUM_SLICE(input,
-													  sizeof(PB_CompressedSequence) - VARHDRSZ +
-													  sizeof(PB_Codeword) * input_header->n_symbols +
-													  sizeof(PB_IndexEntry) * start_entry_no,
-													  sizeof(PB_IndexEntry));
 
-			start_entry = palloc0(sizeof(PB_IndexEntry));
-			memcpy(start_entry, VARDATA_ANY(data_slice), sizeof(PB_IndexEntry));
-			pfree(data_slice);
+	/*
+	 * Restore codeset.
+	 */
+	codeset = get_sequence_codeset(input_header, fixed_codesets);
+
+	entry_offset = PB_COMPRESSED_SEQUENCE_INDEX_ENTRY_OFFSET(input_header, start_position);
+	if (entry_offset >= 0)
+	{
+		start_entry = palloc0(sizeof(PB_IndexEntry));
+		memcpy(start_entry,
+			   read_detoast_cursor(cursor, entry_offset - VARHDRSZ, sizeof(PB_IndexEntry), NULL),
+			   sizeof(PB_IndexEntry));
 
-			PB_DEBUG1(errmsg("decode(): index found, uses entry no %d", start_entry_no));
-		}
+		PB_DEBUG1(errmsg("decode(): index found, uses entry at offset %d", entry_offset));
 	}
 
 	if (codeset->n_swapped_symbols > 0)
 	{
 		if (codeset->uses_rle)
-			decode_pc_swp_rle_idx(input,
+			decode_pc_swp_rle_idx(cursor,
+								  input_header,
 								  output,
 								  start_position,
 								  out_length,
 								  start_entry,
 								  codeset);
 		else
-			decode_pc_swp_idx(input,
+			decode_pc_swp_idx(cursor,
+							  input_header,
 							  output,
 							  start_position,
 							  out_length,
@@ -2986,14 +4916,16 @@ void decode(Varlena* input,
 	else
 	{
 		if (codeset->uses_rle)
-			decode_pc_rle_idx(input,
+			decode_pc_rle_idx(cursor,
+							  input_header,
 							  output,
 							  start_position,
 							  out_length,
 							  start_entry,
 							  codeset);
 		else
-			decode_pc_idx(input,
+			decode_pc_idx(cursor,
+						  input_header,
 						  output,
 						  start_position,
 						  out_length,
@@ -3001,14 +4933,14 @@ void decode(Varlena* input,
 						  codeset);
 	}
 
+	PB_COUNT(symbols_decoded[PB_CODE_KIND(codeset)], out_length);
+
 	if (start_entry)
 		pfree(start_entry);
 
 	if (codeset->is_fixed == FALSE)
 		pfree(codeset);
 
-	PB_TRACE(errmsg("<-decode()"));
-
-	pfree(input_header);
+	PB_TRACE(errmsg("<-decode_from_cursor()"));
 }
 
@@ -0,0 +1,539 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/sequence/delta.c
+*
+*-------------------------------------------------------------------------
+*/
+#include "postgres.h"
+#include "lib/stringinfo.h"
+
+#include "sequence/sequence.h"
+#include "sequence/compression.h"
+#include "utils/debug.h"
+
+#include "sequence/delta.h"
+
+/**
+ * Number of bits of seed hashes and maximum number of equal hashes
+ * compared for each seed of the input
+ */
+#define PB_DELTA_HASH_BITS			17
+#define PB_DELTA_MAX_CHAIN			16
+
+/*
+ * Hash table of the seeds in a window of the reference. Entries are
+ * positions in the window plus one, 0 ends a chain.
+ */
+typedef struct {
+	uint32* heads;
+	uint32* next;
+} PB_SeedTable;
+
+/*
+ * local function declarations
+ */
+static bool is_seed(const uint8* reference,
+					uint32 reference_length,
+					uint32 reference_position,
+					const uint8* input,
+					uint32 length,
+					uint32 position);
+
+static uint32 hash_seed(const uint8* seed);
+
+static bool find_seed(const uint8* reference,
+					  uint32 reference_length,
+					  uint32 reference_position,
+					  const uint8* input,
+					  uint32 length,
+					  uint32 position,
+					  uint32* reference_shift,
+					  uint32* shift);
+
+static bool find_distant_seed(PB_SeedTable* table,
+							  const uint8* reference,
+							  uint32 reference_length,
+							  uint32 reference_position,
+							  const uint8* input,
+							  uint32 length,
+							  uint32 position,
+							  uint32* reference_shift,
+							  uint32* shift);
+
+static void add_edit(StringInfo edits,
+					 StringInfo inserted,
+					 uint32 reference_position,
+					 uint32 deleted_length,
+					 const uint8* input,
+					 uint32 sequence_position,
+					 uint32 inserted_length);
+
+static PB_DeltaEdit get_edit(const PB_DeltaSequence* input, uint32 edit);
+
+static uint32 find_edit(const PB_DeltaSequence* input, uint32 position);
+
+static void assemble_window(const PB_DeltaSequence* input,
+							uint32 start_position,
+							uint32 end_position,
+							const uint8* reference_window,
+							uint32* reference_start,
+							uint32* reference_end,
+							uint8* output);
+
+/*
+ * local functions
+ */
+
+/*
+ * is_seed()
+ * 		Check whether two positions start PB_DELTA_SEED_LENGTH equal
+ * 		characters or equal ends of both sequences.
+ */
+static bool is_seed(const uint8* reference,
+					uint32 reference_length,
+					uint32 reference_position,
+					const uint8* input,
+					uint32 length,
+					uint32 position)
+{
+	uint32 n = Min(PB_DELTA_SEED_LENGTH,
+				   Min(reference_length - reference_position, length - position));
+
+	if (n < PB_DELTA_SEED_LENGTH &&
+		(reference_length - reference_position != n || length - position != n))
+		return FALSE;
+
+	return memcmp(reference + reference_position, input + position, n) == 0;
+}
+
+/*
+ * hash_seed()
+ * 		Hash PB_DELTA_SEED_LENGTH characters.
+ */
+static uint32 hash_seed(const uint8* seed)
+{
+	uint64 a = 0;
+	uint32 b = 0;
+
+	memcpy(&a, seed, sizeof(uint64));
+	memcpy(&b, seed + sizeof(uint64), PB_DELTA_SEED_LENGTH - sizeof(uint64));
+
+	return (uint32) (((a * UINT64CONST(0x9E3779B97F4A7C15)) ^ (b * UINT64CONST(0xC2B2AE3D27D4EB4F)))
+					 >> (64 - PB_DELTA_HASH_BITS));
+}
+
+/*
+ * find_seed()
+ * 		Search the nearest seed within PB_DELTA_MAX_SHIFT characters
+ * 		of both sequences, preferring short edits.
+ */
+static bool find_seed(const uint8* reference,
+					  uint32 reference_length,
+					  uint32 reference_position,
+					  const uint8* input,
+					  uint32 length,
+					  uint32 position,
+					  uint32* reference_shift,
+					  uint32* shift)
+{
+	uint32 total;
+	uint32 di;
+
+	for (total = 1; total <= 2 * PB_DELTA_MAX_SHIFT; total++)
+	{
+		for (di = total > PB_DELTA_MAX_SHIFT ? total - PB_DELTA_MAX_SHIFT : 0;
+			 di <= Min(total, PB_DELTA_MAX_SHIFT);
+			 di++)
+		{
+			uint32 dj = total - di;
+
+			if (reference_position + di > reference_length || position + dj > length)
+				continue;
+
+			if (is_seed(reference, reference_length, reference_position + di, input, length, position + dj))
+			{
+				*reference_shift = di;
+				*shift = dj;
+				return TRUE;
+			}
+		}
+	}
+
+	return FALSE;
+}
+
+/*
+ * find_distant_seed()
+ * 		Search the nearest seed within PB_DELTA_WINDOW_SIZE characters
+ * 		of both sequences. The seeds of the reference window are hashed
+ * 		and looked up for each position of the input window.
+ */
+static bool find_distant_seed(PB_SeedTable* table,
+							  const uint8* reference,
+							  uint32 reference_length,
+							  uint32 reference_position,
+							  const uint8* input,
+							  uint32 length,
+							  uint32 position,
+							  uint32* reference_shift,
+							  uint32* shift)
+{
+	uint32 reference_end = Min(reference_length, reference_position + PB_DELTA_WINDOW_SIZE);
+	uint32 end = Min(length, position + PB_DELTA_WINDOW_SIZE);
+	uint32 best = PG_UINT32_MAX;
+	uint32 p;
+	uint32 q;
+
+	if (reference_end - reference_position < PB_DELTA_SEED_LENGTH ||
+		end - position < PB_DELTA_SEED_LENGTH)
+		return FALSE;
+
+	if (table->heads == NULL)
+	{
+		table->heads = palloc(sizeof(uint32) << PB_DELTA_HASH_BITS);
+		table->next = palloc(sizeof(uint32) * PB_DELTA_WINDOW_SIZE);
+	}
+	memset(table->heads, 0, sizeof(uint32) << PB_DELTA_HASH_BITS);
+
+	/*
+	 * Insert backwards, so chains are ordered by position.
+	 */
+	for (p = reference_end - PB_DELTA_SEED_LENGTH + 1; p-- > reference_position;)
+	{
+		uint32 hash = hash_seed(reference + p);
+
+		table->next[p - reference_position] = table->heads[hash];
+		table->heads[hash] = p - reference_position + 1;
+	}
+
+	for (q = position; q + PB_DELTA_SEED_LENGTH <= end && q - position < best; q++)
+	{
+		uint32 entry = table->heads[hash_seed(input + q)];
+		int chain;
+
+		for (chain = 0; entry != 0 && chain < PB_DELTA_MAX_CHAIN; chain++)
+		{
+			uint32 di = entry - 1;
+
+			if (di + (q - position) >= best)
+				break;
+
+			/*
+			 * Random seeds are common in a window this large, distant
+			 * seeds must be followed by another one.
+			 */
+			if (memcmp(reference + reference_position + di, input + q, PB_DELTA_SEED_LENGTH) == 0 &&
+				is_seed(reference, reference_length, reference_position + di + PB_DELTA_SEED_LENGTH,
+						input, length, q + PB_DELTA_SEED_LENGTH))
+			{
+				best = di + (q - position);
+				*reference_shift = di;
+				*shift = q - position;
+				break;
+			}
+
+			entry = table->next[di];
+		}
+	}
+
+	return best != PG_UINT32_MAX;
+}
+
+/*
+ * add_edit()
+ * 		Append an edit, adjacent edits are merged.
+ */
+static void add_edit(StringInfo edits,
+					 StringInfo inserted,
+					 uint32 reference_position,
+					 uint32 deleted_length,
+					 const uint8* input,
+					 uint32 sequence_position,
+					 uint32 inserted_length)
+{
+	PB_DeltaEdit* last = NULL;
+
+	if (edits->len > 0)
+		last = (PB_DeltaEdit*) (edits->data + edits->len - sizeof(PB_DeltaEdit));
+
+	if (last != NULL &&
+		last->reference_position + last->deleted_length == reference_position &&
+		last->sequence_position + last->inserted_length == sequence_position)
+	{
+		last->deleted_length += deleted_length;
+		last->inserted_length += inserted_length;
+	}
+	else
+	{
+		PB_DeltaEdit edit;
+
+		edit.reference_position = reference_position;
+		edit.sequence_position = sequence_position;
+		edit.deleted_length = deleted_length;
+		edit.inserted_length = inserted_length;
+		edit.inserted_offset = inserted->len;
+
+		appendBinaryStringInfo(edits, (char*) &edit, sizeof(PB_DeltaEdit));
+	}
+
+	appendBinaryStringInfo(inserted, (const char*) input + sequence_position, inserted_length);
+}
+
+/*
+ * get_edit()
+ * 		Returns an edit. The edit behind the last one is an empty edit
+ * 		at the end of both sequences.
+ */
+static PB_DeltaEdit get_edit(const PB_DeltaSequence* input, uint32 edit)
+{
+	PB_DeltaEdit result;
+
+	if (edit < input->n_edits)
+		return PB_DELTA_SEQUENCE_EDIT_POINTER(input)[edit];
+
+	result.reference_position = input->reference_length;
+	result.sequence_position = input->sequence_length;
+	result.deleted_length = 0;
+	result.inserted_length = 0;
+	result.inserted_offset = 0;
+
+	return result;
+}
+
+/*
+ * find_edit()
+ * 		Binary search for the first edit ending behind a position of
+ * 		the sequence. The position is copied from the reference in front
+ * 		of this edit or inserted by it.
+ */
+static uint32 find_edit(const PB_DeltaSequence* input, uint32 position)
+{
+	const PB_DeltaEdit* edits = PB_DELTA_SEQUENCE_EDIT_POINTER(input);
+	uint32 low = 0;
+	uint32 high = input->n_edits;
+
+	while (low < high)
+	{
+		uint32 middle = low + (high - low) / 2;
+
+		if (edits[middle].sequence_position + edits[middle].inserted_length > position)
+			high = middle;
+		else
+			low = middle + 1;
+	}
+
+	return low;
+}
+
+/*
+ * assemble_window()
+ * 		Walk the parts of a window of the sequence. Without output, the
+ * 		range of the reference covered by the window is determined. With
+ * 		output, the window is assembled from the decoded reference range
+ * 		and the inserted characters.
+ */
+static void assemble_window(const PB_DeltaSequence* input,
+							uint32 start_position,
+							uint32 end_position,
+							const uint8* reference_window,
+							uint32* reference_start,
+							uint32* reference_end,
+							uint8* output)
+{
+	const uint8* inserted = PB_DELTA_SEQUENCE_INSERTED_POINTER(input);
+	uint32 position = start_position;
+	uint32 edit = find_edit(input, start_position);
+	bool has_reference = FALSE;
+
+	while (position < end_position)
+	{
+		PB_DeltaEdit current = get_edit(input, edit);
+		uint32 n;
+
+		/*
+		 * Characters copied from the reference in front of the edit.
+		 */
+		if (position < current.sequence_position)
+		{
+			uint32 from;
+
+			n = Min(end_position, current.sequence_position) - position;
+			from = current.reference_position - (current.sequence_position - position);
+
+			if (output == NULL)
+			{
+				if (!has_reference)
+					*reference_start = from;
+				*reference_end = from + n;
+				has_reference = TRUE;
+			}
+			else
+			{
+				memcpy(output, reference_window + (from - *reference_start), n);
+				output += n;
+			}
+
+			position += n;
+		}
+
+		/*
+		 * Characters inserted by the edit.
+		 */
+		if (position < end_position && position < current.sequence_position + current.inserted_length)
+		{
+			n = Min(end_position, current.sequence_position + current.inserted_length) - position;
+
+			if (output != NULL)
+			{
+				memcpy(output,
+					   inserted + current.inserted_offset + (position - current.sequence_position),
+					   n);
+				output += n;
+			}
+
+			position += n;
+		}
+
+		edit++;
+	}
+
+	if (output == NULL && !has_reference)
+		*reference_start = *reference_end = 0;
+}
+
+/*
+ * public functions
+ */
+
+/*
+ * delta_encode()
+ * 		Find the edits turning the reference into the input sequence.
+ */
+PB_DeltaSequence* delta_encode(const uint8* reference,
+							   uint32 reference_length,
+							   const uint8* input,
+							   uint32 length)
+{
+	StringInfoData edits;
+	StringInfoData inserted;
+	PB_SeedTable table = {NULL, NULL};
+	PB_DeltaSequence* result;
+	uint32 result_size;
+	uint32 i = 0;
+	uint32 j = 0;
+
+	PB_TRACE(errmsg("->delta_encode()"));
+
+	initStringInfo(&edits);
+	initStringInfo(&inserted);
+
+	while (i < reference_length && j < length)
+	{
+		uint32 di;
+		uint32 dj;
+
+		if (reference[i] == input[j])
+		{
+			i++;
+			j++;
+			continue;
+		}
+
+		if (!find_seed(reference, reference_length, i, input, length, j, &di, &dj) &&
+			!find_distant_seed(&table, reference, reference_length, i, input, length, j, &di, &dj))
+		{
+			di = Min(PB_DELTA_WINDOW_SIZE, reference_length - i);
+			dj = Min(PB_DELTA_WINDOW_SIZE, length - j);
+		}
+
+		add_edit(&edits, &inserted, i, di, input, j, dj);
+
+		i += di;
+		j += dj;
+	}
+
+	if (i < reference_length || j < length)
+		add_edit(&edits, &inserted, i, reference_length - i, input, j, length - j);
+
+	result_size = sizeof(PB_DeltaSequence) + edits.len + inserted.len;
+	result = palloc0(result_size);
+	SET_VARSIZE(result, result_size);
+
+	result->sequence_length = length;
+	result->reference_length = reference_length;
+	result->n_edits = edits.len / sizeof(PB_DeltaEdit);
+
+	memcpy(PB_DELTA_SEQUENCE_EDIT_POINTER(result), edits.data, edits.len);
+	memcpy(PB_DELTA_SEQUENCE_INSERTED_POINTER(result), inserted.data, inserted.len);
+
+	pfree(edits.data);
+	pfree(inserted.data);
+	if (table.heads != NULL)
+	{
+		pfree(table.heads);
+		pfree(table.next);
+	}
+
+	PB_TRACE(errmsg("<-delta_encode() exits with %u edits", result->n_edits));
+
+	return result;
+}
+
+/*
+ * delta_decode()
+ * 		Decode a part of a delta sequence.
+ */
+void delta_decode(const PB_DeltaSequence* input,
+				  Varlena* reference,
+				  uint8* output,
+				  uint32 start_position,
+				  uint32 out_length,
+				  PB_CodeSet** fixed_codesets)
+{
+	uint32 reference_start;
+	uint32 reference_end;
+	uint8* reference_window = NULL;
+
+	PB_TRACE(errmsg("->delta_decode()"));
+
+	if (out_length == 0)
+		return;
+
+	assemble_window(input,
+					start_position,
+					start_position + out_length,
+					NULL,
+					&reference_start,
+					&reference_end,
+					NULL);
+
+	if (reference_end > reference_start)
+	{
+		reference_window = palloc(reference_end - reference_start);
+		decode(reference,
+			   reference_window,
+			   reference_start,
+			   reference_end - reference_start,
+			   fixed_codesets);
+	}
+
+	assemble_window(input,
+					start_position,
+					start_position + out_length,
+					reference_window,
+					&reference_start,
+					&reference_end,
+					output);
+
+	if (reference_window != NULL)
+		pfree(reference_window);
+
+	PB_TRACE(errmsg("<-delta_decode()"));
+}
@@ -0,0 +1,254 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/sequence/detoast_cursor.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/tuptoaster.h"
+#include "utils/memutils.h"
+
+#include "sequence/sequence.h"
+#include "sequence/detoast_cursor.h"
+#include "utils/debug.h"
+#include "utils/instrumentation.h"
+
+/*
+ * Decoding a sequence stored out of line used to fetch a slice for the
+ * header, another one for an index entry and another one for the stream,
+ * and chunk by chunk comparisons fetched the header again for every
+ * chunk. Each of these fetches is a lookup in the index of the TOAST
+ * table. A cursor fetches the metadata once and prefetches the stream in
+ * growing slices, so reading a sequence from front to back takes a
+ * logarithmic number of fetches.
+ *
+ * Compressed values cannot be sliced without decompressing them from the
+ * start, so they are detoasted as a whole, like values stored inline.
+ *
+ * Functions called again and again on the same value, e.g. substr() in a
+ * loop over the features of a chromosome, keep their cursor in fn_extra.
+ * The value as passed is copied for comparison: for values stored out of
+ * line this is just the TOAST pointer, which identifies the value, for
+ * compressed values it is the compressed data.
+ */
+
+/**
+ * A cursor kept in fn_extra.
+ *
+ * 	MemoryContext context : context of the cursor, reset for a new value
+ * 	Varlena* input : copy of the value as passed
+ * 	PB_DetoastCursor* cursor : cursor on input or NULL
+ */
+typedef struct {
+	MemoryContext context;
+	Varlena* input;
+	PB_DetoastCursor* cursor;
+} PB_CachedDetoastCursor;
+
+/*
+ * public functions
+ */
+
+/**
+ * open_detoast_cursor()
+ * 		Opens a cursor on a sequence and reads its header.
+ *
+ * 	Varlena* input : possibly toasted sequence
+ */
+PB_DetoastCursor* open_detoast_cursor(Varlena* input)
+{
+	PB_DetoastCursor* cursor;
+	bool read_whole = TRUE;
+
+	PB_TRACE(errmsg("->open_detoast_cursor()"));
+
+	cursor = palloc0(sizeof(PB_DetoastCursor));
+	cursor->context = CurrentMemoryContext;
+	cursor->input = input;
+	cursor->raw_size = toast_raw_datum_size((Datum) input);
+
+	if (VARATT_IS_EXTERNAL_ONDISK(input) &&
+		cursor->raw_size > PB_COMPRESSED_SEQUENCE_PREFIX_SIZE)
+	{
+		struct varatt_external toast_pointer;
+
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, input);
+		read_whole = VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer);
+	}
+
+	if (read_whole)
+	{
+		cursor->value = (Varlena*) PG_DETOAST_DATUM(input);
+		cursor->free_value = (Pointer) cursor->value != (Pointer) input;
+		cursor->header = (PB_CompressedSequence*) cursor->value;
+	}
+	else
+	{
+		cursor->header = (PB_CompressedSequence*)
+						 PG_DETOAST_DATUM_SLICE(input,
+												0,
+												PB_COMPRESSED_SEQUENCE_PREFIX_SIZE - VARHDRSZ);
+	}
+	cursor->header_size = VARSIZE(cursor->header) - VARHDRSZ;
+
+	PB_COUNT(bytes_detoasted, cursor->header_size);
+	PB_COUNT(bytes_read, PB_COMPRESSED_SEQUENCE_HEADER_SIZE(cursor->header) - VARHDRSZ);
+	if (!read_whole)
+		PB_COUNT(toast_slice_fetches, 1);
+
+	PB_DEBUG1(errmsg("open_detoast_cursor(): raw size %d, %s", cursor->raw_size, read_whole ? "detoasted" : "read in slices"));
+
+	PB_TRACE(errmsg("<-open_detoast_cursor()"));
+
+	return cursor;
+}
+
+/**
+ * open_cached_detoast_cursor()
+ * 		Opens a cursor on a sequence or returns the cursor of the last
+ * 		call, if the sequence is the same.
+ */
+PB_DetoastCursor* open_cached_detoast_cursor(FmgrInfo* flinfo, Varlena* input)
+{
+	PB_CachedDetoastCursor* cache;
+	MemoryContext oldcontext;
+	Size size;
+
+	if (flinfo == NULL || !(VARATT_IS_EXTERNAL_ONDISK(input) || VARATT_IS_COMPRESSED(input)))
+		return open_detoast_cursor(input);
+
+	cache = (PB_CachedDetoastCursor*) flinfo->fn_extra;
+	size = VARSIZE_ANY(input);
+
+	if (cache != NULL &&
+		cache->cursor != NULL &&
+		VARSIZE_ANY(cache->input) == size &&
+		memcmp(cache->input, input, size) == 0)
+	{
+		PB_COUNT(cursor_cache_hits, 1);
+		return cache->cursor;
+	}
+
+	if (cache == NULL)
+	{
+		cache = MemoryContextAllocZero(flinfo->fn_mcxt, sizeof(PB_CachedDetoastCursor));
+		cache->context = AllocSetContextCreate(flinfo->fn_mcxt,
+											   "postbis detoast cursor",
+											   ALLOCSET_DEFAULT_SIZES);
+		flinfo->fn_extra = cache;
+	}
+	else
+	{
+		cache->cursor = NULL;
+		MemoryContextReset(cache->context);
+	}
+
+	oldcontext = MemoryContextSwitchTo(cache->context);
+	cache->input = palloc(size);
+	memcpy(cache->input, input, size);
+	cache->cursor = open_detoast_cursor(cache->input);
+	cache->cursor->is_cached = TRUE;
+	MemoryContextSwitchTo(oldcontext);
+
+	PB_DEBUG1(errmsg("open_cached_detoast_cursor(): cached cursor on %u bytes", (uint32) size));
+
+	return cache->cursor;
+}
+
+/**
+ * read_detoast_cursor()
+ * 		Returns a pointer to size bytes of data starting at offset.
+ *
+ * 	A read behind the current window, that overlaps or touches it,
+ * 	prefetches twice as much as the window held.
+ *
+ * 	PB_DetoastCursor* cursor : open cursor
+ * 	int32 offset : offset of the first byte, without varlena header
+ * 	int32 size : number of bytes to read
+ * 	int32* available : set to the number of bytes available, may be NULL
+ */
+const uint8* read_detoast_cursor(PB_DetoastCursor* cursor,
+								 int32 offset,
+								 int32 size,
+								 int32* available)
+{
+	const int32 data_size = cursor->raw_size - VARHDRSZ;
+	MemoryContext oldcontext;
+	int32 prefetch_size;
+
+	if (offset > data_size)
+		offset = data_size;
+	if (size > data_size - offset)
+		size = data_size - offset;
+	if (size < 0)
+		size = 0;
+	if (available)
+		*available = size;
+
+	PB_COUNT(bytes_read, size);
+
+	if (offset + size <= cursor->header_size)
+		return (uint8*) VARDATA(cursor->header) + offset;
+
+	if (cursor->window &&
+		offset >= cursor->window_start &&
+		offset + size <= cursor->window_start + cursor->window_size)
+		return (uint8*) VARDATA_ANY(cursor->window) + (offset - cursor->window_start);
+
+	if (cursor->window &&
+		offset >= cursor->window_start &&
+		offset <= cursor->window_start + cursor->window_size)
+		prefetch_size = Min(2 * cursor->window_size, PB_DETOAST_CURSOR_MAX_PREFETCH_SIZE);
+	else
+		prefetch_size = PB_DETOAST_CURSOR_MIN_PREFETCH_SIZE;
+
+	prefetch_size = Min(Max(prefetch_size, size), data_size - offset);
+
+	PB_DEBUG1(errmsg("read_detoast_cursor(): fetching %d bytes at %d for %d bytes", prefetch_size, offset, size));
+
+	if (cursor->window)
+		pfree(cursor->window);
+
+	oldcontext = MemoryContextSwitchTo(cursor->context);
+	cursor->window = (Varlena*) PG_DETOAST_DATUM_SLICE(cursor->input, offset, prefetch_size);
+	MemoryContextSwitchTo(oldcontext);
+	cursor->window_start = offset;
+	cursor->window_size = VARSIZE_ANY_EXHDR(cursor->window);
+
+	PB_COUNT(bytes_detoasted, cursor->window_size);
+	PB_COUNT(toast_slice_fetches, 1);
+
+	return (uint8*) VARDATA_ANY(cursor->window);
+}
+
+/**
+ * close_detoast_cursor()
+ * 		Frees a cursor and the data read through it, unless the cursor
+ * 		is cached.
+ *
+ * 	PB_DetoastCursor* cursor : open cursor
+ */
+void close_detoast_cursor(PB_DetoastCursor* cursor)
+{
+	if (cursor->is_cached)
+		return;
+
+	if (cursor->window)
+		pfree(cursor->window);
+
+	if (cursor->value == NULL)
+		pfree(cursor->header);
+	else if (cursor->free_value)
+		pfree(cursor->value);
+
+	pfree(cursor);
+}
@@ -24,13 +24,534 @@
 #include "sequence/code_set_creation.h"
 #include "sequence/sequence.h"
 #include "sequence/decompression_iteration.h"
+#include "sequence/checksum.h"
+#include "sequence/codebook.h"
 #include "utils/debug.h"
+#include "utils/instrumentation.h"
 
 #include "sequence/functions.h"
 
+/*
+ * Sequences are compared in chunks, so comparison stops reading data at the
+ * first difference. The first chunk is small, as most comparisons of
+ * different sequences end there. Following chunks of decoded characters end
+ * at index entries, so no chunk has to skip through the sequence.
+ */
+#define PB_COMPARE_FIRST_CHUNK_SIZE		1024
+#define PB_COMPARE_CHUNK_SIZE			PB_INDEX_PART_SIZE
+
+/*
+ * Sequences are searched in chunks of decoded characters ending at index
+ * entries, so the search stops reading data at the first match.
+ */
+#define PB_STRPOS_CHUNK_SIZE			PB_INDEX_PART_SIZE
+
+/*
+ * Initial number of k-mers collected before duplicates are removed.
+ */
+#define PB_KMER_BUFFER_SIZE				65536
+
+/*
+ * local function declarations
+ */
+
+static bool is_order_preserving(const PB_CodeSet* codeset);
+static bool packed_equal(PB_DetoastCursor* cursor1, PB_DetoastCursor* cursor2);
+static int packed_compare(PB_DetoastCursor* cursor1,
+						  int stream_offset1,
+						  PB_DetoastCursor* cursor2,
+						  int stream_offset2,
+						  uint64 n_bits);
+static int decoded_compare(PB_DetoastCursor* cursor1,
+						   PB_DetoastCursor* cursor2,
+						   uint32 length,
+						   PB_CodeSet** fixed_codesets);
+static uint32 decoded_crc32(Varlena* raw_seq,
+						   uint32 length,
+						   PB_CodeSet** fixed_codesets);
+static uint32 decoded_symbol_count(PB_DetoastCursor* cursor,
+								   const bool* symbol_set,
+								   uint32 start,
+								   uint32 length,
+								   PB_CodeSet** fixed_codesets);
+static uint32 stored_symbol_count(PB_DetoastCursor* cursor,
+								  const bool* symbol_set,
+								  uint32 position,
+								  const PB_CompressedSequence* header,
+								  const PB_Codeword* words,
+								  int n_words);
+static void decoded_composition(PB_DetoastCursor* cursor,
+								uint32 length,
+								uint64* frequencies,
+								PB_CodeSet** fixed_codesets);
+static int compare_kmers(const void* a, const void* b);
+static int32 unique_kmers(uint64* kmers, int32 n_kmers);
+static uint64* add_kmer(uint64* kmers, int32* n_kmers, int32* capacity, uint64 kmer);
+
+/*
+ * local functions
+ */
+
+/**
+ * is_order_preserving()
+ * 		Checks, whether the order of the codewords is the order of their
+ * 		symbols.
+ *
+ * 	PB_CodeSet* codeset : codeset to check
+ */
+static bool is_order_preserving(const PB_CodeSet* codeset)
+{
+	int i;
+	int j;
+
+	for (i = 0; i < codeset->n_symbols; i++)
+		for (j = 0; j < codeset->n_symbols; j++)
+			if ((codeset->words[i].symbol < codeset->words[j].symbol) !=
+				(codeset->words[i].code < codeset->words[j].code))
+				return FALSE;
+
+	return TRUE;
+}
+
+/**
+ * packed_equal()
+ * 		Compares the compressed representations of two sequences chunk by
+ * 		chunk. Returns TRUE if they are equal.
+ *
+ * 	PB_DetoastCursor* cursor1 : cursor on the first sequence
+ * 	PB_DetoastCursor* cursor2 : cursor on the second sequence
+ */
+static bool packed_equal(PB_DetoastCursor* cursor1, PB_DetoastCursor* cursor2)
+{
+	const int32 size = cursor1->raw_size - VARHDRSZ;
+	int32 offset = 0;
+	int32 chunk_size = PB_COMPARE_FIRST_CHUNK_SIZE;
+	bool result = TRUE;
+
+	PB_TRACE(errmsg("->packed_equal()"));
+
+	if (size != cursor2->raw_size - VARHDRSZ)
+	{
+		PB_TRACE(errmsg("<-packed_equal(): exits due to different size"));
+		return FALSE;
+	}
+
+	while (result && offset < size)
+	{
+		if (chunk_size > size - offset)
+			chunk_size = size - offset;
+
+		result = memcmp(read_detoast_cursor(cursor1, offset, chunk_size, NULL),
+						read_detoast_cursor(cursor2, offset, chunk_size, NULL),
+						chunk_size) == 0;
+
+		offset += chunk_size;
+		chunk_size = PB_COMPARE_CHUNK_SIZE;
+	}
+
+	PB_TRACE(errmsg("<-packed_equal() exits with %d at byte %d", result, offset));
+
+	return result;
+}
+
+/**
+ * packed_compare()
+ * 		Compares the streams of two sequences encoded with the same order
+ * 		preserving code of equal length codewords.
+ * 		Returns a negative value if the first stream is smaller, 0 if both
+ * 		are equal, a positive value if the second one is smaller.
+ *
+ * 	PB_DetoastCursor* cursor1 : cursor on the first sequence
+ * 	int stream_offset1 : offset of the first stream without varlena header
+ * 	PB_DetoastCursor* cursor2 : cursor on the second sequence
+ * 	int stream_offset2 : offset of the second stream without varlena header
+ * 	uint64 n_bits : number of bits to compare
+ */
+static int packed_compare(PB_DetoastCursor* cursor1,
+						  int stream_offset1,
+						  PB_DetoastCursor* cursor2,
+						  int stream_offset2,
+						  uint64 n_bits)
+{
+	const int64 n_blocks = PB_ALIGN_BIT_SIZE(n_bits) / PB_COMPRESSION_BUFFER_BIT_SIZE;
+	int64 block = 0;
+	int64 chunk_blocks = PB_COMPARE_FIRST_CHUNK_SIZE / PB_COMPRESSION_BUFFER_BYTE_SIZE;
+	int result = 0;
+
+	PB_TRACE(errmsg("->packed_compare(): comparing %ld bits", n_bits));
+
+	while (result == 0 && block < n_blocks)
+	{
+		const PB_CompressionBuffer* pointer1;
+		const PB_CompressionBuffer* pointer2;
+		int64 i;
+
+		if (chunk_blocks > n_blocks - block)
+			chunk_blocks = n_blocks - block;
+
+		pointer1 = (const PB_CompressionBuffer*)
+				   read_detoast_cursor(cursor1,
+									   stream_offset1 + block * PB_COMPRESSION_BUFFER_BYTE_SIZE,
+									   chunk_blocks * PB_COMPRESSION_BUFFER_BYTE_SIZE,
+									   NULL);
+		pointer2 = (const PB_CompressionBuffer*)
+				   read_detoast_cursor(cursor2,
+									   stream_offset2 + block * PB_COMPRESSION_BUFFER_BYTE_SIZE,
+									   chunk_blocks * PB_COMPRESSION_BUFFER_BYTE_SIZE,
+									   NULL);
+
+		for (i = 0; i < chunk_blocks; i++)
+		{
+			PB_CompressionBuffer buffer1 = pointer1[i];
+			PB_CompressionBuffer buffer2 = pointer2[i];
+
+			/*
+			 * Ignore bits after the end of the shorter sequence.
+			 */
+			if (block + i == n_blocks - 1 && n_bits % PB_COMPRESSION_BUFFER_BIT_SIZE)
+			{
+				const PB_CompressionBuffer mask = ~((PB_CompressionBuffer) 0) <<
+						(PB_COMPRESSION_BUFFER_BIT_SIZE - n_bits % PB_COMPRESSION_BUFFER_BIT_SIZE);
+
+				buffer1 &= mask;
+				buffer2 &= mask;
+			}
+
+			if (buffer1 != buffer2)
+			{
+				result = buffer1 < buffer2 ? (-1) : 1;
+				break;
+			}
+		}
+
+		block += chunk_blocks;
+		chunk_blocks = PB_COMPARE_CHUNK_SIZE / PB_COMPRESSION_BUFFER_BYTE_SIZE;
+	}
+
+	PB_TRACE(errmsg("<-packed_compare() exits with %d", result));
+
+	return result;
+}
+
+/**
+ * decoded_compare()
+ * 		Decodes two sequences chunk by chunk and compares them.
+ * 		Returns a negative value if the first sequence is smaller, 0 if both
+ * 		are equal, a positive value if the second one is smaller.
+ *
+ * 	PB_DetoastCursor* cursor1 : cursor on the first sequence
+ * 	PB_DetoastCursor* cursor2 : cursor on the second sequence
+ * 	uint32 length : number of characters to compare
+ */
+static int decoded_compare(PB_DetoastCursor* cursor1,
+						   PB_DetoastCursor* cursor2,
+						   uint32 length,
+						   PB_CodeSet** fixed_codesets)
+{
+	uint8* chunk1;
+	uint8* chunk2;
+	uint32 position = 0;
+	uint32 chunk_length = PB_COMPARE_FIRST_CHUNK_SIZE;
+	int result = 0;
+
+	PB_TRACE(errmsg("->decoded_compare(): comparing %u chars", length));
+
+	chunk1 = palloc(Min(length, PB_COMPARE_CHUNK_SIZE) + 1);
+	chunk2 = palloc(Min(length, PB_COMPARE_CHUNK_SIZE) + 1);
+
+	while (result == 0 && position < length)
+	{
+		if (chunk_length > length - position)
+			chunk_length = length - position;
+
+		decode_from_cursor(cursor1, chunk1, position, chunk_length, fixed_codesets);
+		decode_from_cursor(cursor2, chunk2, position, chunk_length, fixed_codesets);
+
+		result = memcmp(chunk1, chunk2, chunk_length);
+
+		position += chunk_length;
+
+		/*
+		 * The index entry i points to position (i + 1) * PB_INDEX_PART_SIZE - 1.
+		 */
+		chunk_length = PB_COMPARE_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	}
+
+	pfree(chunk1);
+	pfree(chunk2);
+
+	PB_TRACE(errmsg("<-decoded_compare() exits with %d at position %u", result, position));
+
+	return result;
+}
+
+/**
+ * decoded_crc32()
+ * 		Decodes a sequence chunk by chunk and computes its CRC32.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	uint32 length : length of the sequence
+ */
+static uint32 decoded_crc32(Varlena* raw_seq,
+						   uint32 length,
+						   PB_CodeSet** fixed_codesets)
+{
+	PB_DetoastCursor* cursor;
+	uint8* chunk;
+	uint32 position = 0;
+	uint32 chunk_length = PB_COMPARE_CHUNK_SIZE - 1;
+	uint32 crc = PB_CRC32_INIT;
+
+	PB_TRACE(errmsg("->decoded_crc32(): decoding %u chars", length));
+
+	cursor = open_detoast_cursor(raw_seq);
+	chunk = palloc(Min(length, PB_COMPARE_CHUNK_SIZE) + 1);
+
+	while (position < length)
+	{
+		if (chunk_length > length - position)
+			chunk_length = length - position;
+
+		decode_from_cursor(cursor, chunk, position, chunk_length, fixed_codesets);
+		crc = crc32_update(crc, chunk, chunk_length);
+
+		position += chunk_length;
+		chunk_length = PB_COMPARE_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	}
+
+	pfree(chunk);
+	close_detoast_cursor(cursor);
+
+	PB_TRACE(errmsg("<-decoded_crc32()"));
+
+	return PB_CRC32_FINAL(crc);
+}
+
+/**
+ * decoded_symbol_count()
+ * 		Decodes part of a sequence chunk by chunk and counts the
+ * 		characters contained in a set of symbols.
+ *
+ * 	PB_DetoastCursor* cursor : cursor on the sequence
+ * 	bool* symbol_set : TRUE for each symbol to count, PB_SOURCE_ALPHABET_SIZE entries
+ * 	uint32 start : first position to count, starting at 0
+ * 	uint32 length : number of characters to count
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+static uint32 decoded_symbol_count(PB_DetoastCursor* cursor,
+								   const bool* symbol_set,
+								   uint32 start,
+								   uint32 length,
+								   PB_CodeSet** fixed_codesets)
+{
+	uint8* chunk;
+	const uint32 end = start + length;
+	uint32 position = start;
+	uint32 chunk_length;
+	uint32 result = 0;
+	uint32 i;
+
+	PB_TRACE(errmsg("->decoded_symbol_count(): counting %u chars from %u", length, start));
+
+	if (length == 0)
+		return 0;
+
+	chunk = palloc(Min(length, PB_COMPARE_CHUNK_SIZE) + 1);
+
+	/*
+	 * The index entry i points to position (i + 1) * PB_INDEX_PART_SIZE - 1.
+	 */
+	chunk_length = PB_COMPARE_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	while (position < end)
+	{
+		if (chunk_length > end - position)
+			chunk_length = end - position;
+
+		decode_from_cursor(cursor, chunk, position, chunk_length, fixed_codesets);
+
+		for (i = 0; i < chunk_length; i++)
+			result += symbol_set[chunk[i]];
+
+		position += chunk_length;
+		chunk_length = PB_COMPARE_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	}
+
+	pfree(chunk);
+
+	PB_TRACE(errmsg("<-decoded_symbol_count() exits with %u", result));
+
+	return result;
+}
+
+/**
+ * stored_symbol_count()
+ * 		Reads the number of characters contained in a set of symbols
+ * 		in front of a position from the composition of a sequence.
+ *
+ * 	PB_DetoastCursor* cursor : cursor on the sequence
+ * 	bool* symbol_set : TRUE for each symbol to count, PB_SOURCE_ALPHABET_SIZE entries
+ * 	uint32 position : multiple of PB_INDEX_PART_SIZE or length of the sequence
+ * 	PB_CompressedSequence* header : header of the sequence
+ * 	PB_Codeword* words : codewords of the sequence
+ * 	int n_words : number of codewords
+ */
+static uint32 stored_symbol_count(PB_DetoastCursor* cursor,
+								  const bool* symbol_set,
+								  uint32 position,
+								  const PB_CompressedSequence* header,
+								  const PB_Codeword* words,
+								  int n_words)
+{
+	const int raw_size = cursor->raw_size;
+	uint32 row[PB_SOURCE_ALPHABET_SIZE];
+	int row_no;
+	uint32 result = 0;
+	int i;
+
+	if (position == 0)
+		return 0;
+
+	if (position == header->sequence_length)
+		row_no = PB_COMPOSITION_N_ROWS(header->sequence_length) - 1;
+	else
+		row_no = position / PB_INDEX_PART_SIZE - 1;
+
+	/*
+	 * Data read through a cursor may be unaligned, so the row is copied.
+	 */
+	memcpy(row,
+		   read_detoast_cursor(cursor,
+							   PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(header, raw_size, n_words) - VARHDRSZ +
+							   row_no * n_words * sizeof(uint32),
+							   n_words * sizeof(uint32),
+							   NULL),
+		   n_words * sizeof(uint32));
+
+	for (i = 0; i < n_words; i++)
+		if (symbol_set[words[i].symbol])
+			result += row[i];
+
+	return result;
+}
+
+/**
+ * decoded_composition()
+ * 		Decodes a sequence chunk by chunk and counts each symbol.
+ *
+ * 	PB_DetoastCursor* cursor : cursor on the sequence
+ * 	uint32 length : length of the sequence
+ * 	uint64* frequencies : counts are added here, PB_SOURCE_ALPHABET_SIZE entries
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+static void decoded_composition(PB_DetoastCursor* cursor,
+								uint32 length,
+								uint64* frequencies,
+								PB_CodeSet** fixed_codesets)
+{
+	uint8* chunk;
+	uint32 position = 0;
+	uint32 chunk_length = PB_COMPARE_CHUNK_SIZE - 1;
+	uint32 i;
+
+	PB_TRACE(errmsg("->decoded_composition(): decoding %u chars", length));
+
+	if (length == 0)
+		return;
+
+	chunk = palloc(Min(length, PB_COMPARE_CHUNK_SIZE) + 1);
+
+	while (position < length)
+	{
+		if (chunk_length > length - position)
+			chunk_length = length - position;
+
+		decode_from_cursor(cursor, chunk, position, chunk_length, fixed_codesets);
+
+		for (i = 0; i < chunk_length; i++)
+			frequencies[chunk[i]]++;
+
+		position += chunk_length;
+		chunk_length = PB_COMPARE_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	}
+
+	pfree(chunk);
+
+	PB_TRACE(errmsg("<-decoded_composition()"));
+}
+
+/**
+ * compare_kmers()
+ * 		qsort() comparator for packed k-mers.
+ */
+static int compare_kmers(const void* a, const void* b)
+{
+	const uint64 x = *((const uint64*) a);
+	const uint64 y = *((const uint64*) b);
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * unique_kmers()
+ * 		Sorts k-mers and removes duplicates. Returns the new number of k-mers.
+ *
+ * 	uint64* kmers : k-mers
+ * 	int32 n_kmers : number of k-mers
+ */
+static int32 unique_kmers(uint64* kmers, int32 n_kmers)
+{
+	int32 n_unique = 0;
+	int32 i;
+
+	qsort(kmers, n_kmers, sizeof(uint64), compare_kmers);
+	for (i = 0; i < n_kmers; i++)
+		if (n_unique == 0 || kmers[n_unique - 1] != kmers[i])
+			kmers[n_unique++] = kmers[i];
+
+	return n_unique;
+}
+
+/**
+ * add_kmer()
+ * 		Appends a k-mer to a buffer. A full buffer is sorted and
+ * 		duplicates are removed, it grows if this does not free
+ * 		half of it. Returns the possibly moved buffer.
+ *
+ * 	uint64* kmers : buffer
+ * 	int32* n_kmers : number of k-mers in buffer
+ * 	int32* capacity : size of buffer
+ * 	uint64 kmer : k-mer to append
+ */
+static uint64* add_kmer(uint64* kmers, int32* n_kmers, int32* capacity, uint64 kmer)
+{
+	if (*n_kmers == *capacity)
+	{
+		*n_kmers = unique_kmers(kmers, *n_kmers);
+
+		if (*n_kmers > *capacity / 2)
+		{
+			*capacity *= 2;
+			kmers = repalloc(kmers, *capacity * sizeof(uint64));
+		}
+	}
+
+	kmers[(*n_kmers)++] = kmer;
+
+	return kmers;
+}
+
+/*
+ * public functions
+ */
+
 /**
  * reverse()
  * 		Reverses a detoasted compressed sequence.
+ *
+ * 	Prefix codes without swapping and RLE, which includes all codes of
+ * 	equal length codewords, are encoded chunk by chunk with
+ * 	encode_reversed(). Other sequences are decoded into a reversed copy,
+ * 	which is encoded again.
  */
 PB_CompressedSequence* reverse(PB_CompressedSequence* sequence, PB_CodeSet** fixed_codesets)
 {
@@ -40,21 +561,14 @@ PB_CompressedSequence* reverse(PB_CompressedSequence* sequence, PB_CodeSet** fix
 	uint8* output_pointer;
 	PB_CodeSet* codeset;
 	PB_SequenceInfo info;
+	PB_CompressedSequence header;
+	uint32 compressed_size;
 
 	PB_TRACE(errmsg("->reverse()"));
 
-	temp = palloc0(sequence->sequence_length + 1);
-
-	output_pointer = temp;
-	output_pointer += sequence->sequence_length- 1;
-
-	PB_BEGIN_DECODE((Varlena*) sequence, 0, sequence->sequence_length, fixed_codesets, (*output_pointer)) {
-		output_pointer--;
-	} PB_END_DECODE
-
 	if (sequence->is_fixed)
 	{
-		codeset = fixed_codesets[sequence->n_swapped_symbols];
+		codeset = get_fixed_codeset(sequence, fixed_codesets);
 
 		PB_DEBUG1(errmsg("reverse():uses fixed code with id %u", sequence->n_swapped_symbols));
 	}
@@ -84,10 +598,38 @@ PB_CompressedSequence* reverse(PB_CompressedSequence* sequence, PB_CodeSet** fix
 	}
 
 	info.sequence_length = sequence->sequence_length;
+	info.index_part_shift = sequence->index_part_shift;
+
+	/*
+	 * The result has the same stream, but maybe a newer header
+	 * and a composition.
+	 */
+	header = *sequence;
+	header.version = PB_COMPRESSED_SEQUENCE_VERSION;
+	compressed_size = VARSIZE(sequence) -
+					  PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(sequence) -
+					  PB_COMPRESSED_SEQUENCE_COMPOSITION_SIZE(sequence, codeset->n_symbols) +
+					  PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(&header) +
+					  PB_COMPOSITION_SIZE(sequence->sequence_length, codeset->n_symbols);
+
+	result = encode_reversed(sequence, compressed_size, codeset, fixed_codesets);
+
+	if (!result)
+	{
+		temp = palloc0(sequence->sequence_length + 1);
 
-	result = encode(temp, VARSIZE(sequence), codeset, &info);
+		output_pointer = temp;
+		output_pointer += sequence->sequence_length- 1;
+
+		PB_BEGIN_DECODE((Varlena*) sequence, 0, sequence->sequence_length, fixed_codesets, (*output_pointer)) {
+			output_pointer--;
+		} PB_END_DECODE
+
+		result = encode(temp, compressed_size, codeset, &info);
+
+		pfree(temp);
+	}
 
-	pfree(temp);
 	if (!codeset->is_fixed)
 		pfree(codeset);
 
@@ -107,56 +649,65 @@ PB_CompressedSequence* reverse(PB_CompressedSequence* sequence, PB_CodeSet** fix
  */
 bool sequence_equal(Varlena* raw_seq1, Varlena* raw_seq2, PB_CodeSet** fixed_codesets)
 {
-	PB_CompressedSequence* input_header;
-	PB_CompressedSequence* seq1;
-	PB_CompressedSequence* seq2;
-	uint8* decompressed_sequence;
-	int len;
-
-	uint8 c;
-	uint8* output_pointer;
+	PB_DetoastCursor* cursor1;
+	PB_DetoastCursor* cursor2;
+	const PB_CompressedSequence* header1;
+	const PB_CompressedSequence* header2;
+	bool result;
 
 	PB_TRACE(errmsg("->sequence_equal()"));
 
-	/* Get length of first sequence */
-	input_header = (PB_CompressedSequence*)
-					PG_DETOAST_DATUM_SLICE(raw_seq1,0,4);
-
-	len = input_header->sequence_length;
-
-	/* Get length of second sequence */
-	input_header = (PB_CompressedSequence*)
-					PG_DETOAST_DATUM_SLICE(raw_seq2,0,4);
+	/*
+	 * The headers stay available for the comparison of the streams, so
+	 * they are not fetched again.
+	 */
+	cursor1 = open_detoast_cursor(raw_seq1);
+	cursor2 = open_detoast_cursor(raw_seq2);
+	header1 = cursor1->header;
+	header2 = cursor2->header;
 
 	/* Compare length */
-	if (len != input_header->sequence_length)
+	if (header1->sequence_length != header2->sequence_length)
 	{
+		close_detoast_cursor(cursor1);
+		close_detoast_cursor(cursor2);
+
 		PB_TRACE(errmsg("<-sequence_equal(): exits due to different length"));
 		return FALSE;
 	}
 
-	seq1 = (PB_CompressedSequence*) PG_DETOAST_DATUM(raw_seq1);
-	seq2 = (PB_CompressedSequence*) PG_DETOAST_DATUM(raw_seq2);
-
-	decompressed_sequence = palloc0(len);
-	decode((Varlena*) seq1, decompressed_sequence, 0, len, fixed_codesets);
+	/* Compare stored hashes */
+	if (PB_COMPRESSED_SEQUENCE_HAS_HASH(header1) && PB_COMPRESSED_SEQUENCE_HAS_HASH(header2) &&
+		*PB_COMPRESSED_SEQUENCE_HASH_POINTER(header1) != *PB_COMPRESSED_SEQUENCE_HASH_POINTER(header2))
+	{
+		close_detoast_cursor(cursor1);
+		close_detoast_cursor(cursor2);
 
-	output_pointer = decompressed_sequence;
+		PB_TRACE(errmsg("<-sequence_equal(): exits due to different hash"));
+		return FALSE;
+	}
 
-	PB_BEGIN_DECODE((Varlena*) seq2, 0, len, fixed_codesets, (c)) {
-		if (c != *output_pointer)
-		{
-			PB_TRACE(errmsg("<-sequence_equal(): exits due to different char at position %ld", output_pointer - decompressed_sequence));
-			return FALSE;
-		}
-		output_pointer++;
-	} PB_END_DECODE
+	if (PB_COMPRESSED_SEQUENCE_FIXED_CODE_ID(header1) >= 0 &&
+		PB_COMPRESSED_SEQUENCE_FIXED_CODE_ID(header1) == PB_COMPRESSED_SEQUENCE_FIXED_CODE_ID(header2) &&
+		PB_COMPRESSED_SEQUENCE_LAYOUT_VERSION(header1) == PB_COMPRESSED_SEQUENCE_LAYOUT_VERSION(header2))
+	{
+		/*
+		 * Encoding with a fixed code is deterministic, so equal sequences
+		 * have equal compressed representations.
+		 */
+		result = packed_equal(cursor1, cursor2);
+	}
+	else
+	{
+		result = (decoded_compare(cursor1, cursor2, header1->sequence_length, fixed_codesets) == 0);
+	}
 
-	pfree(decompressed_sequence);
+	close_detoast_cursor(cursor1);
+	close_detoast_cursor(cursor2);
 
-	PB_TRACE(errmsg("<-sequence_equal()"));
+	PB_TRACE(errmsg("<-sequence_equal() exits with %d", result));
 
-	return TRUE;
+	return result;
 }
 
 /**
@@ -169,375 +720,814 @@ bool sequence_equal(Varlena* raw_seq1, Varlena* raw_seq2, PB_CodeSet** fixed_cod
  */
 int sequence_compare(Varlena* seq_a, Varlena* seq_b, PB_CodeSet** fixed_codesets)
 {
-	PB_CompressedSequence* seq1 = (PB_CompressedSequence*) PG_DETOAST_DATUM(seq_a);
-	PB_CompressedSequence* seq2 = (PB_CompressedSequence*) PG_DETOAST_DATUM(seq_b);
-	int swap = 1;
+	PB_DetoastCursor* cursor1;
+	PB_DetoastCursor* cursor2;
+	const PB_CompressedSequence* header1;
+	const PB_CompressedSequence* header2;
+	uint32 length;
+	int fixed_id;
+	int result;
 
-	uint8* decompressed_sequence;
+	PB_TRACE(errmsg("->sequence_compare()"));
 
-	uint8 c;
-	uint8* output_pointer;
+	cursor1 = open_detoast_cursor(seq_a);
+	cursor2 = open_detoast_cursor(seq_b);
+	header1 = cursor1->header;
+	header2 = cursor2->header;
 
-	PB_TRACE(errmsg("->sequence_compare()"));
+	length = Min(header1->sequence_length, header2->sequence_length);
+	fixed_id = PB_COMPRESSED_SEQUENCE_FIXED_CODE_ID(header1);
 
-	/*
-	 * seq1 should be the shorter sequence, as it will be fully decompressed
-	 */
-	if (seq1->sequence_length > seq2->sequence_length)
+	if (fixed_id >= 0 &&
+		fixed_id == PB_COMPRESSED_SEQUENCE_FIXED_CODE_ID(header2) &&
+		fixed_codesets[fixed_id]->has_equal_length &&
+		is_order_preserving(fixed_codesets[fixed_id]))
 	{
-		PB_CompressedSequence* swapseq = seq1;
-		seq1 = seq2;
-		seq2 = swapseq;
-		swap = (-1);
+		/*
+		 * The order of the packed codes is the order of the sequences.
+		 */
+		result = packed_compare(cursor1,
+								PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(header1) - VARHDRSZ,
+								cursor2,
+								PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(header2) - VARHDRSZ,
+								(uint64) length * fixed_codesets[fixed_id]->words[0].code_length);
+	}
+	else
+	{
+		result = decoded_compare(cursor1, cursor2, length, fixed_codesets);
 	}
 
-	decompressed_sequence = palloc0(seq1->sequence_length);
-	decode((Varlena*) seq1, decompressed_sequence, 0, seq1->sequence_length, fixed_codesets);
+	if (result == 0 && header1->sequence_length != header2->sequence_length)
+	{
+		PB_TRACE(errmsg("sequence_compare(): shorter sequence is a prefix"));
 
-	output_pointer = decompressed_sequence;
+		result = header1->sequence_length - header2->sequence_length;
+	}
 
-	PB_BEGIN_DECODE((Varlena*) seq2, 0, seq1->sequence_length, fixed_codesets, (c)) {
-		if (c != *output_pointer)
-		{
-			int result = 1;
+	close_detoast_cursor(cursor1);
+	close_detoast_cursor(cursor2);
 
-			if (c > *output_pointer)
-				result = (-1);
+	PB_TRACE(errmsg("<-sequence_compare() exits with %d", result));
 
-			result *= swap;
+	return (result > 0) - (result < 0);
+}
 
-			PB_TRACE(errmsg("<-sequence_compare(): exits due to different char at position %ld", output_pointer - decompressed_sequence));
+/*
+ * sequence_crc32()
+ *		Get the CRC32 of a compressed sequence. It is stored in the header
+ * 		since version 1. Older sequences and those, whose stored CRC32 is
+ * 		unknown, are decoded chunk by chunk.
+ *
+ * 	Varlena* raw_seq : possibly toasted input sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+uint32 sequence_crc32(Varlena* raw_seq, PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* header;
+	uint32 result;
 
-			return result;
-		}
-		output_pointer++;
-	} PB_END_DECODE
+	PB_TRACE(errmsg("->sequence_crc32()"));
 
-	pfree(decompressed_sequence);
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(raw_seq, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
 
-	if (seq1->sequence_length < seq2->sequence_length)
-	{
-		PB_TRACE(errmsg("<-sequence_compare(): exits, seq1 is shorter"));
+	if (PB_COMPRESSED_SEQUENCE_HAS_HASH(header))
+		result = *PB_COMPRESSED_SEQUENCE_HASH_POINTER(header);
+	else
+		result = decoded_crc32(raw_seq, header->sequence_length, fixed_codesets);
 
-		return (-swap);
-	}
+	pfree(header);
 
-	PB_TRACE(errmsg("<-sequence_compare()"));
+	PB_TRACE(errmsg("<-sequence_crc32() exits with %u", result));
 
-	return 0;
+	return result;
 }
 
-/* generated using the AUTODIN II polynomial
- * x^32 + x^26 + x^23 + x^22 + x^16 +
- * x^12 + x^11 + x^10 + x^8 + x^7 + x^5 + x^4 + x^2 + x^1 + 1
- */
-
-static const unsigned int crc32tab[256] = {
- 0x00000000, 0x77073096, 0xee0e612c, 0x990951ba,
- 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
- 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
- 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
- 0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de,
- 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
- 0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec,
- 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
- 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
- 0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
- 0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940,
- 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
- 0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116,
- 0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
- 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
- 0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
- 0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a,
- 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
- 0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818,
- 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
- 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
- 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
- 0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c,
- 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
- 0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2,
- 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
- 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
- 0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
- 0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086,
- 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
- 0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4,
- 0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
- 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
- 0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
- 0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8,
- 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
- 0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe,
- 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
- 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
- 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
- 0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252,
- 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
- 0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60,
- 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
- 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
- 0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
- 0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04,
- 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
- 0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a,
- 0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
- 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
- 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
- 0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e,
- 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
- 0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c,
- 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
- 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
- 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
- 0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0,
- 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
- 0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6,
- 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
- 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
- 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
-};
-
-#define _CRC32_(crc, ch) (crc = (crc >> 8) ^ crc32tab[(crc ^ (ch)) & 0xff])
+/*
+ * invalidate_sequence_crc32()
+ *		Marks the stored CRC32 of a detoasted sequence as unknown after
+ * 		its symbols have been changed in place. sequence_crc32() decodes
+ * 		the sequence then, instead of doing it here for every change.
+ *
+ * 	PB_CompressedSequence* seq : detoasted sequence
+ */
+void invalidate_sequence_crc32(PB_CompressedSequence* seq)
+{
+	if (seq->version > 0)
+		seq->version |= PB_COMPRESSED_SEQUENCE_HASH_UNKNOWN;
+}
 
 /*
- * sequence_crc32()
- *		Compute CRC32 of a compressed sequence.
- * 		This code implements the AUTODIN II polynomial
- * 		Original code by Spencer Garrett <srg@quick.com>
- * 		Taken into PostBIS from pgsql/src/contrib/hstore/crc32.c
+ * sequence_symbol_count()
+ *		Counts the characters of a sequence, which are contained in a set
+ * 		of symbols. Whole blocks of PB_INDEX_PART_SIZE characters are
+ * 		counted with the stored composition, only partial blocks at the
+ * 		edges of the range are decoded.
  *
- * 	PB_CompressedSequence* seq: detoasted input sequence
+ * 	This function mimics substr() for the range. The first position is 1.
+ *
+ * 	Varlena* raw_seq : possibly toasted input sequence
+ * 	uint8* symbols : symbols to count
+ * 	int n_symbols : number of symbols to count
+ * 	int start : position to start from
+ * 	int length : number of characters to count
+ * 	uint32* n_counted : set to the number of characters in the range, if not NULL
  * 	PB_CodeSet** fixed_codesets : fixed codes
  */
-uint32 sequence_crc32(PB_CompressedSequence* seq, PB_CodeSet** fixed_codesets)
+uint32 sequence_symbol_count(Varlena* raw_seq,
+							 const uint8* symbols,
+							 int n_symbols,
+							 int start,
+							 int length,
+							 uint32* n_counted,
+							 PB_CodeSet** fixed_codesets)
 {
-	uint32 crc32 = ~((uint32) 0);
-	uint8 c;
+	PB_DetoastCursor* cursor;
+	const PB_CompressedSequence* header;
+	bool symbol_set[PB_SOURCE_ALPHABET_SIZE];
+	uint32 result;
+	int i;
 
-	PB_BEGIN_DECODE((Varlena*) seq, 0, seq->sequence_length, fixed_codesets, (c)) {
-		_CRC32_(crc32, c);
-	} PB_END_DECODE
+	PB_TRACE(errmsg("->sequence_symbol_count()"));
 
-	return ~crc32;
-}
+	if (length < 0)
+		ereport(ERROR,(errmsg("negative length not allowed")));
 
-typedef struct {
-	uint32 pos;
-	uint32 len;
-	void* next;
-} PB_PartialMatch;
+	cursor = open_detoast_cursor(raw_seq);
+	header = cursor->header;
 
-/*
+	/*
+	 * SQL's first position is 1, our first position is 0
+	 */
+	start--;
+	if (start < 0)
+	{
+		length += start;
+		start = 0;
+	}
+	if (start >= header->sequence_length || length < 1)
+		length = 0;
+	else if (length > header->sequence_length - start)
+		length = header->sequence_length - start;
+
+	memset(symbol_set, 0, sizeof(symbol_set));
+	for (i = 0; i < n_symbols; i++)
+		symbol_set[symbols[i]] = TRUE;
+
+	if (header->has_composition && length >= 2 * PB_INDEX_PART_SIZE)
+	{
+		const PB_Codeword* words;
+		int n_words;
+		const uint32 end = start + length;
+		uint32 first_block;
+		uint32 last_block;
+
+		if (header->is_fixed)
+		{
+			const PB_CodeSet* codeset = get_fixed_codeset(header, fixed_codesets);
+
+			words = codeset->words;
+			n_words = codeset->n_symbols;
+		}
+		else
+		{
+			words = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(header);
+			n_words = header->n_symbols;
+		}
+
+		/*
+		 * Count whole blocks from the composition, the rest by decoding.
+		 */
+		first_block = (start + PB_INDEX_PART_SIZE - 1) / PB_INDEX_PART_SIZE * PB_INDEX_PART_SIZE;
+		if (end == header->sequence_length)
+			last_block = end;
+		else
+			last_block = end / PB_INDEX_PART_SIZE * PB_INDEX_PART_SIZE;
+
+		result = stored_symbol_count(cursor, symbol_set, last_block, header, words, n_words) -
+				 stored_symbol_count(cursor, symbol_set, first_block, header, words, n_words);
+		result += decoded_symbol_count(cursor, symbol_set, start, first_block - start, fixed_codesets);
+		result += decoded_symbol_count(cursor, symbol_set, last_block, end - last_block, fixed_codesets);
+	}
+	else
+	{
+		result = decoded_symbol_count(cursor, symbol_set, start, length, fixed_codesets);
+	}
+
+	if (n_counted)
+		*n_counted = length;
+
+	close_detoast_cursor(cursor);
+
+	PB_TRACE(errmsg("<-sequence_symbol_count() exits with %u", result));
+
+	return result;
+}
+
+/**
  * sequence_strpos()
  * 		Find position of given string.
- * 		Baeza-Yates-Gonnet implementation.
+ * 		Multi-word Baeza-Yates-Gonnet (Shift-And) implementation.
  *
- * 	PB_CompressedSequence* seq : detoasted sequence to search in
- * 	Text* search : detoasted text to search for
- * 	PB_CodeSet** fixed_codesets : fixed codes
+ * 	The pattern is split into words of 64 characters. Only words up to
+ * 	the highest one holding a partial match are updated, so long patterns
+ * 	cost little more than short ones unless the sequence is repetitive.
+ * 	The sequence is decoded chunk by chunk starting at index entries,
+ * 	so no more data than necessary is read up to the first match.
  */
-uint32 sequence_strpos(PB_CompressedSequence* seq, text* search, PB_CodeSet** fixed_codesets)
+uint32 sequence_strpos(Varlena* raw_seq,
+					   const uint8* pattern,
+					   uint32 pattern_length,
+					   FmgrInfo* flinfo,
+					   PB_CodeSet** fixed_codesets)
 {
-	uint64 search_vector = 0;
+	PB_DetoastCursor* cursor;
+	const PB_CompressedSequence* header;
+	const PB_Codeword* words;
+	int n_words;
+
+	uint16 rows[PB_SOURCE_ALPHABET_SIZE];
+	int n_rows = 1;
+	uint64* masks;
+	uint64* state;
+	int n_state_words;
+	int top = 0;
 	uint64 match;
-	uint64* specific_vectors;
-	int search_vector_length = 64;
-
-	PB_SequenceInfo* search_str_info;
-	uint32 pos = 0;
-
-	PB_PartialMatch* first_match = NULL;
-	PB_PartialMatch* last_match = NULL;
 
-	uint8 c;
+	uint8* chunk;
+	uint32 position = 0;
+	uint32 chunk_length = PB_STRPOS_CHUNK_SIZE - 1;
+	uint32 result = 0;
+	uint32 i;
 
 	PB_TRACE(errmsg("->sequence_strpos()"));
 
-	/* collect info about pattern */
-	search_str_info = get_sequence_info_text(search, PB_SEQUENCE_INFO_CASE_SENSITIVE);
+	/*
+	 * The sequence is searched chunk by chunk through one cursor, so the
+	 * stream is prefetched in growing slices.
+	 */
+	cursor = open_cached_detoast_cursor(flinfo, raw_seq);
+	header = cursor->header;
 
 	/* terminate if pattern is longer than sequence */
-	if (search_str_info->sequence_length > seq->sequence_length || search_str_info->n_symbols > (seq->is_fixed ? fixed_codesets[seq->n_swapped_symbols]->n_symbols : seq->n_symbols))
+	if (pattern_length == 0 || pattern_length > header->sequence_length)
 	{
-		PB_TRACE(errmsg("<-sequence_strpos(): too short pl:%u sl:%u ps:%u ss:%u", search_str_info->sequence_length, seq->sequence_length, search_str_info->n_symbols, (seq->is_fixed ? fixed_codesets[seq->n_swapped_symbols]->n_symbols : seq->n_symbols)));
+		PB_TRACE(errmsg("<-sequence_strpos(): too short pl:%u sl:%u", pattern_length, header->sequence_length));
 
+		close_detoast_cursor(cursor);
 		return 0;
 	}
 
-	/* terminate if pattern contains characters the sequence does not */
+	if (header->is_fixed)
 	{
-		int i = 0;
-		PB_Codeword* codewords = (seq->is_fixed ? fixed_codesets[seq->n_swapped_symbols]->words : PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(seq));
-		uint64 bitmap_high = 0;
-		uint64 bitmap_low = 0;
-		int n_symbols =  (seq->is_fixed ? fixed_codesets[seq->n_swapped_symbols]->n_symbols : seq->n_symbols);
+		const PB_CodeSet* codeset = get_fixed_codeset(header, fixed_codesets);
 
-		for (i = 0; i < n_symbols; i++) {
-			uint8 c = codewords[i].symbol;
-			if (c >= 64)
-				bitmap_high = bitmap_high | ((uint64) 1) << (c - 64);
-			else
-				bitmap_low = bitmap_low | ((uint64) 1) << c;
-		}
-		PB_DEBUG2(errmsg("alphabet matching pl:%lu sl:%lu ph:%lu sh:%lu", search_str_info->ascii_bitmap_high, bitmap_high, search_str_info->ascii_bitmap_low, bitmap_low));
+		words = codeset->words;
+		n_words = codeset->n_symbols;
+	}
+	else
+	{
+		words = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(header);
+		n_words = header->n_symbols;
+	}
 
-		if (((search_str_info->ascii_bitmap_high ^ bitmap_high) & search_str_info->ascii_bitmap_high) ||
-			((search_str_info->ascii_bitmap_low ^ bitmap_low) & search_str_info->ascii_bitmap_low))
+	/*
+	 * Give each symbol of the pattern its own row of masks. Symbols the
+	 * sequence does not contain share row 0, which has no bit set.
+	 */
+	memset(rows, 0, sizeof(rows));
+	for (i = 0; i < pattern_length; i++)
+		rows[pattern[i]] = 1;
+
+	for (i = 0; i < n_words; i++)
+	{
+		if (rows[words[i].symbol] == 1)
+			rows[words[i].symbol] = 2;
+	}
+
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+	{
+		if (rows[i] == 1)
 		{
-			PB_TRACE(errmsg("<-sequence_strpos(): alphabet mismatch pl:%lu sl:%lu ph:%lu sh:%lu", search_str_info->ascii_bitmap_high, bitmap_high, search_str_info->ascii_bitmap_low, bitmap_low));
+			/* terminate if pattern contains characters the sequence does not */
+			PB_TRACE(errmsg("<-sequence_strpos(): alphabet mismatch at %c", (char) i));
 
+			close_detoast_cursor(cursor);
 			return 0;
 		}
+		rows[i] = rows[i] ? n_rows++ : 0;
 	}
 
-	/*
-	 * Determine search window length
-	 */
-	if (search_str_info->sequence_length < search_vector_length)
-		search_vector_length = search_str_info->sequence_length;
-
 	/*
 	 * Build specific vectors
 	 */
+	n_state_words = (pattern_length + 63) / 64;
+	masks = palloc0(sizeof(uint64) * n_state_words * n_rows);
+	state = palloc0(sizeof(uint64) * n_state_words);
+
+	PB_COUNT(strpos_searches, 1);
+	PB_COUNT(strpos_state_bytes, sizeof(uint64) * n_state_words * (n_rows + 1));
+
+	for (i = 0; i < pattern_length; i++)
+		masks[rows[pattern[i]] * n_state_words + i / 64] |= ((uint64) 1) << (i % 64);
+
+	match = ((uint64) 1) << ((pattern_length - 1) % 64);
+
+	PB_DEBUG2(errmsg("sequence_strpos(): %d words, %d rows, match:%lx", n_state_words, n_rows, match));
+
+	chunk = palloc(Min(header->sequence_length, PB_STRPOS_CHUNK_SIZE));
+
+	while (position < header->sequence_length && !result)
 	{
-		uint64 position_bit = 1;
-		int i;
-		uint8* input_pointer = (uint8*) VARDATA_ANY(search);
+		if (chunk_length > header->sequence_length - position)
+			chunk_length = header->sequence_length - position;
 
-		specific_vectors = palloc0(sizeof(uint64) * PB_ASCII_SIZE);
+		decode_from_cursor(cursor, chunk, position, chunk_length, fixed_codesets);
 
-		for (i = 0; i < search_vector_length; i++, input_pointer++)
+		if (n_state_words == 1)
 		{
-			specific_vectors[*input_pointer] |= position_bit;
-			position_bit <<= 1;
-		}
-		match = position_bit >> 1;
+			uint64 search_vector = state[0];
 
-		for (i = 0; i < PB_ASCII_SIZE; i++)
-		{
-			if (specific_vectors[i]) {
-				PB_DEBUG2(errmsg("%c: %lx", i, specific_vectors[i]));
+			for (i = 0; i < chunk_length; i++)
+			{
+				search_vector = ((search_vector << 1) | 1) & masks[rows[chunk[i]]];
+
+				if (search_vector & match)
+				{
+					result = position + i + 2 - pattern_length;
+					break;
+				}
 			}
-		}
 
-		PB_DEBUG2(errmsg("match:%lx", match));
-	}
+			state[0] = search_vector;
+		}
+		else
+		{
+			for (i = 0; i < chunk_length; i++)
+			{
+				const uint64* mask = masks + rows[chunk[i]] * n_state_words;
+				uint64 carry = 1;
+				int w;
 
-	PB_BEGIN_DECODE((Varlena*) seq, 0, seq->sequence_length, fixed_codesets, (c)) {
-		/*
-		 * Extend partial matches
-		 */
-		if (first_match) {
-			PB_PartialMatch* current = first_match;
-			last_match = NULL;
+				/* shift-and over all words holding partial matches */
+				for (w = 0; w <= top; w++)
+				{
+					uint64 word = state[w];
 
-			while (1) {
-				uint8* search_str = (uint8*) VARDATA(search) + current->len;
+					state[w] = ((word << 1) | carry) & mask[w];
+					carry = word >> 63;
+				}
 
-				if (*search_str == c)
+				/* partial matches growing into the next word */
+				if (carry && top < n_state_words - 1)
 				{
-					/* extend match */
-					current->len++;
-					last_match = current;
-
-					/* check if match long enough to terminate */
-					if (current->len == search_str_info->sequence_length)
-					{
-						int result = current->pos;
-
-						/* free all matches */
-						while (first_match) {
-							PB_PartialMatch* next = first_match->next;
-							pfree(first_match);
-							first_match = next;
-						}
-
-						pfree(specific_vectors);
-						PB_SEQUENCE_INFO_PFREE(search_str_info);
-
-						return result;
-					}
-
-					/* go to next in list */
-					if (current->next)
-						current = current->next;
-					else
-						break;
+					state[top + 1] = mask[top + 1] & 1;
+					top++;
 				}
-				else
+
+				while (top > 0 && !state[top])
+					top--;
+
+				if (state[n_state_words - 1] & match)
 				{
-					/* delete match */
-					if (current->next)
-					{
-						/* current has predecessor in list */
-						PB_PartialMatch* next = current->next;
-
-						if (current == first_match)
-							first_match = next;
-						else
-							last_match->next = next;
-
-						pfree(current);
-
-						current = next;
-					}
-					else
-					{
-						/* current is last element in list */
-						if (current == first_match)
-							first_match = NULL;
-
-						pfree(current);
-
-						break;
-					}
+					result = position + i + 2 - pattern_length;
+					break;
 				}
 			}
 		}
 
-		/* shift-and */
-		search_vector = ((search_vector << 1) | 1) & specific_vectors[c];
-		pos++;
+		position += chunk_length;
+		chunk_length = PB_STRPOS_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	}
+
+	pfree(chunk);
+	pfree(state);
+	pfree(masks);
+	close_detoast_cursor(cursor);
+
+	PB_TRACE(errmsg("<-sequence_strpos() exits with %u", result));
+
+	return result;
+}
+
+/**
+ * get_index_part_shift()
+ * 		Parses the index granularity type modifier.
+ *
+ * 	char* keyword : type modifier keyword
+ */
+int get_index_part_shift(const char* keyword)
+{
+	const char* c;
+	long part_size;
+	int shift;
+
+	for (c = keyword; *c; c++)
+		if (*c < '0' || *c > '9')
+			return -1;
+
+	if (c == keyword)
+		return -1;
+
+	part_size = c - keyword > 6 ? 0 : atol(keyword);
+
+	for (shift = 0; shift <= PB_MAX_INDEX_PART_SHIFT; shift++)
+		if (part_size == (PB_INDEX_PART_SIZE >> shift))
+			return shift;
 
-		PB_DEBUG3(errmsg("pos: %u, c:%c sv:%lx", pos, c, search_vector));
+	ereport(ERROR,(errmsg("type modifier invalid"),
+			errdetail("Index part size must be a power of two from %d to %d, not \"%s\".",
+					  PB_MIN_INDEX_PART_SIZE, PB_INDEX_PART_SIZE, keyword)));
 
-		if ((search_vector & match) && pos >= search_vector_length)
+	return -1;
+}
+
+/**
+ * sequence_composition()
+ * 		Counts the occurrences of each symbol in a sequence.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	uint64* frequencies : counts are added here
+ */
+void sequence_composition(Varlena* raw_seq, uint64* frequencies, PB_CodeSet** fixed_codesets)
+{
+	PB_DetoastCursor* cursor;
+	const PB_CompressedSequence* header;
+
+	PB_TRACE(errmsg("->sequence_composition()"));
+
+	cursor = open_detoast_cursor(raw_seq);
+	header = cursor->header;
+
+	if (header->has_composition)
+	{
+		const int raw_size = cursor->raw_size;
+		const PB_Codeword* words;
+		uint32 row[PB_SOURCE_ALPHABET_SIZE];
+		int n_words;
+		int i;
+
+		if (header->is_fixed)
 		{
-			PB_DEBUG2(errmsg("found partial match at pos %u", pos));
+			const PB_CodeSet* codeset = get_fixed_codeset(header, fixed_codesets);
 
-			/* partial match found */
-			if (search_str_info->sequence_length > search_vector_length)
-			{
-				/* add partial match to end of list */
-				PB_PartialMatch* new_match = palloc0(sizeof(PB_PartialMatch));
+			words = codeset->words;
+			n_words = codeset->n_symbols;
+		}
+		else
+		{
+			words = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(header);
+			n_words = header->n_symbols;
+		}
 
-				new_match->pos = pos - search_vector_length + 1;
-				new_match->len = (uint32) search_vector_length;
+		/*
+		 * The last row holds the counts of the whole sequence.
+		 */
+		memcpy(row,
+			   read_detoast_cursor(cursor,
+								   PB_COMPRESSED_SEQUENCE_COMPOSITION_OFFSET(header, raw_size, n_words) - VARHDRSZ +
+								   (PB_COMPOSITION_N_ROWS(header->sequence_length) - 1) * n_words * sizeof(uint32),
+								   n_words * sizeof(uint32),
+								   NULL),
+			   n_words * sizeof(uint32));
+
+		for (i = 0; i < n_words; i++)
+			frequencies[words[i].symbol] += row[i];
+	}
+	else
+	{
+		decoded_composition(cursor, header->sequence_length, frequencies, fixed_codesets);
+	}
 
-				if (last_match)
-					last_match->next = new_match;
-				else
-					last_match = new_match;
+	close_detoast_cursor(cursor);
 
-				if (!first_match)
-					first_match = new_match;
-			}
-			else
-			{
-				/* partial match is indeed full match */
-				pfree(specific_vectors);
-				PB_SEQUENCE_INFO_PFREE(search_str_info);
-				return pos - search_vector_length + 1;
-			}
+	PB_TRACE(errmsg("<-sequence_composition()"));
+}
+
+/**
+ * sequence_alphabet()
+ * 		Marks the symbols occurring in a sequence.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	bool* symbol_set : set to TRUE for each symbol of the sequence
+ */
+void sequence_alphabet(Varlena* raw_seq, bool* symbol_set, PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* header;
+
+	PB_TRACE(errmsg("->sequence_alphabet()"));
+
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(raw_seq, 0, PB_COMPRESSED_SEQUENCE_PREFIX_SIZE - VARHDRSZ);
+
+	if (header->is_fixed)
+	{
+		/*
+		 * Fixed codes may contain symbols the sequence does not.
+		 */
+		uint64 frequencies[PB_SOURCE_ALPHABET_SIZE];
+		int i;
+
+		memset(frequencies, 0, sizeof(frequencies));
+		sequence_composition(raw_seq, frequencies, fixed_codesets);
+
+		for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+			if (frequencies[i])
+				symbol_set[i] = TRUE;
+	}
+	else
+	{
+		/*
+		 * Other codes are built from the sequence, so every
+		 * codeword occurs. Only the run-length symbol is no character.
+		 */
+		const PB_Codeword* words = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(header);
+		int i;
+
+		for (i = 0; i < header->n_symbols; i++)
+			if (!header->uses_rle || words[i].symbol != PB_RUN_LENGTH_SYMBOL)
+				symbol_set[words[i].symbol] = TRUE;
+	}
+
+	pfree(header);
+
+	PB_TRACE(errmsg("<-sequence_alphabet()"));
+}
+
+/**
+ * string_kmers()
+ * 		Collects the distinct k-mers of a string.
+ *
+ * 	uint8* string : input string
+ * 	uint32 length : length of the string
+ * 	int k : length of k-mers, at most PB_MAX_KMER_LENGTH
+ * 	int32* n_kmers : set to number of k-mers returned
+ */
+uint64* string_kmers(const uint8* string, uint32 length, int k, int32* n_kmers)
+{
+	const uint64 mask = k == PB_MAX_KMER_LENGTH ? ~((uint64) 0) : (((uint64) 1) << (k * 8)) - 1;
+	int32 capacity = PB_KMER_BUFFER_SIZE;
+	uint64* result;
+	uint64 kmer = 0;
+	uint32 i;
+
+	*n_kmers = 0;
+	if (length < k)
+		return NULL;
+
+	capacity = Min(capacity, length - k + 1);
+	result = palloc(capacity * sizeof(uint64));
+
+	for (i = 0; i < length; i++)
+	{
+		kmer = ((kmer << 8) | string[i]) & mask;
+		if (i + 1 >= k)
+			result = add_kmer(result, n_kmers, &capacity, kmer);
+	}
+
+	*n_kmers = unique_kmers(result, *n_kmers);
+
+	return result;
+}
+
+/**
+ * sequence_kmers()
+ * 		Collects the distinct k-mers of a sequence.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	int k : length of k-mers, at most PB_MAX_KMER_LENGTH
+ * 	int32* n_kmers : set to number of k-mers returned
+ */
+uint64* sequence_kmers(Varlena* raw_seq, int k, int32* n_kmers, PB_CodeSet** fixed_codesets)
+{
+	const uint64 mask = k == PB_MAX_KMER_LENGTH ? ~((uint64) 0) : (((uint64) 1) << (k * 8)) - 1;
+	PB_DetoastCursor* cursor;
+	int32 capacity = PB_KMER_BUFFER_SIZE;
+	uint64* result;
+	uint64 kmer = 0;
+	uint8* chunk;
+	uint32 length;
+	uint32 position = 0;
+	uint32 chunk_length = PB_COMPARE_CHUNK_SIZE - 1;
+	uint32 i;
+
+	PB_TRACE(errmsg("->sequence_kmers()"));
+
+	cursor = open_detoast_cursor(raw_seq);
+	length = cursor->header->sequence_length;
+
+	*n_kmers = 0;
+	if (length < k)
+	{
+		close_detoast_cursor(cursor);
+		return NULL;
+	}
+
+	capacity = Min(capacity, length - k + 1);
+	result = palloc(capacity * sizeof(uint64));
+	chunk = palloc(Min(length, PB_COMPARE_CHUNK_SIZE) + 1);
+
+	while (position < length)
+	{
+		if (chunk_length > length - position)
+			chunk_length = length - position;
+
+		decode_from_cursor(cursor, chunk, position, chunk_length, fixed_codesets);
+
+		for (i = 0; i < chunk_length; i++)
+		{
+			kmer = ((kmer << 8) | chunk[i]) & mask;
+			if (position + i + 1 >= k)
+				result = add_kmer(result, n_kmers, &capacity, kmer);
 		}
-	} PB_END_DECODE
 
-	pfree(specific_vectors);
-	PB_SEQUENCE_INFO_PFREE(search_str_info);
+		position += chunk_length;
+		chunk_length = PB_COMPARE_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	}
+
+	pfree(chunk);
+	close_detoast_cursor(cursor);
+
+	*n_kmers = unique_kmers(result, *n_kmers);
+
+	PB_TRACE(errmsg("<-sequence_kmers() exits with %d k-mers", *n_kmers));
+
+	return result;
+}
+
+/*
+ * sequence_concat()
+ * 		Concatenates two sequences. Sequences with the same fixed code of
+ * 		equal length codewords are spliced. Others are decoded into one
+ * 		buffer, which is compressed by the input function of their type.
+ *
+ * 	Varlena* raw_seq1 : first possibly toasted sequence
+ * 	Varlena* raw_seq2 : second possibly toasted sequence
+ * 	PGFunction input_function : input function of the type
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_CompressedSequence* sequence_concat(Varlena* raw_seq1,
+									   Varlena* raw_seq2,
+									   PGFunction input_function,
+									   PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* header;
+	PB_CompressedSequence* result;
+	uint32 length1;
+	uint32 length2;
+	uint8* plain;
+
+	PB_TRACE(errmsg("->sequence_concat()"));
+
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(raw_seq1, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
+	length1 = header->sequence_length;
+	pfree(header);
+
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(raw_seq2, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
+	length2 = header->sequence_length;
+	pfree(header);
+
+	if ((uint64) length1 + length2 > PB_MAX_COMPRESSED_SEQUENCE_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("sequences are limited to %d characters", PB_MAX_COMPRESSED_SEQUENCE_SIZE)));
+
+	result = splice_sequences(raw_seq1, raw_seq2, fixed_codesets);
+
+	if (!result)
+	{
+		plain = palloc(length1 + length2 + 1);
+		decode(raw_seq1, plain, 0, length1, fixed_codesets);
+		decode(raw_seq2, plain + length1, 0, length2, fixed_codesets);
+		plain[length1 + length2] = '\0';
+
+		result = (PB_CompressedSequence*) DatumGetPointer(DirectFunctionCall3(input_function,
+																			  CStringGetDatum((char*) plain),
+																			  ObjectIdGetDatum(InvalidOid),
+																			  Int32GetDatum(-1)));
+
+		pfree(plain);
+	}
+
+	PB_TRACE(errmsg("<-sequence_concat()"));
+
+	return result;
+}
+
+/*
+ * sequence_overlay()
+ * 		Replaces count characters of a sequence from start by a text,
+ * 		like overlay() does for texts. Replacing by as many characters
+ * 		encodes again at most the index parts holding them, see
+ * 		overlay_sequence(). Other sequences are decoded into one buffer,
+ * 		which is compressed by the input function of their type.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	text* replacement : new characters
+ * 	int32 start : first position to replace, the first position is 1
+ * 	int32 count : number of characters to replace
+ * 	PGFunction input_function : input function of the type
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+PB_CompressedSequence* sequence_overlay(Varlena* raw_seq,
+										text* replacement,
+										int32 start,
+										int32 count,
+										PGFunction input_function,
+										PB_CodeSet** fixed_codesets)
+{
+	const uint8* replacement_data = (uint8*) VARDATA_ANY(replacement);
+	const uint32 replacement_length = VARSIZE_ANY_EXHDR(replacement);
+	PB_CompressedSequence* header;
+	PB_CompressedSequence* result = NULL;
+	uint32 length;
+	uint32 position;
+	uint32 end;
+	uint64 result_length;
+	uint8* plain;
+
+	PB_TRACE(errmsg("->sequence_overlay()"));
+
+	if (start < 1 || count < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_SUBSTRING_ERROR),
+				 errmsg("negative substring length not allowed")));
+
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(raw_seq, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
+	length = header->sequence_length;
+	pfree(header);
+
+	position = Min((uint32) start - 1, length);
+	end = Min((uint64) position + count, length);
+	result_length = (uint64) length - (end - position) + replacement_length;
+
+	if (result_length > PB_MAX_COMPRESSED_SEQUENCE_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("sequences are limited to %d characters", PB_MAX_COMPRESSED_SEQUENCE_SIZE)));
+
+	if (replacement_length > 0 && end - position == replacement_length)
+	{
+		PB_CompressedSequence* seq = (PB_CompressedSequence*) PG_DETOAST_DATUM(raw_seq);
+
+		result = overlay_sequence(seq, position, replacement_data, replacement_length, fixed_codesets);
+
+		if ((Pointer) seq != (Pointer) raw_seq)
+			pfree(seq);
+	}
+
+	if (!result)
+	{
+		plain = palloc(result_length + 1);
+		if (position > 0)
+			decode(raw_seq, plain, 0, position, fixed_codesets);
+		memcpy(plain + position, replacement_data, replacement_length);
+		if (end < length)
+			decode(raw_seq, plain + position + replacement_length, end, length - end, fixed_codesets);
+		plain[result_length] = '\0';
+
+		result = (PB_CompressedSequence*) DatumGetPointer(DirectFunctionCall3(input_function,
+																			  CStringGetDatum((char*) plain),
+																			  ObjectIdGetDatum(InvalidOid),
+																			  Int32GetDatum(-1)));
+
+		pfree(plain);
+	}
+
+	PB_TRACE(errmsg("<-sequence_overlay()"));
 
-	PB_TRACE(errmsg("<-sequence_strpos()"));
+	return result;
+}
+
+/**
+ * sequence_symbol_at()
+ * 		Returns the symbol at a position or -1 beyond the end.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	uint32 position : position of the symbol, first is 0
+ */
+int sequence_symbol_at(Varlena* raw_seq, uint32 position, PB_CodeSet** fixed_codesets)
+{
+	PB_DetoastCursor* cursor;
+	uint8 symbol;
+	int result = -1;
+
+	PB_TRACE(errmsg("->sequence_symbol_at()"));
 
-	return 0;
+	cursor = open_detoast_cursor(raw_seq);
+
+	if (position < cursor->header->sequence_length)
+	{
+		decode_from_cursor(cursor, &symbol, position, 1, fixed_codesets);
+		result = symbol;
+	}
+
+	close_detoast_cursor(cursor);
+
+	PB_TRACE(errmsg("<-sequence_symbol_at()"));
+
+	return result;
 }
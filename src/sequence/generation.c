@@ -15,12 +15,291 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
 
 #include "sequence/sequence.h"
+#include "sequence/stats.h"
 #include "types/alphabet.h"
+#include "types/dna_sequence.h"
 #include "utils/debug.h"
 
-Datum generate_sequence (PG_FUNCTION_ARGS);
+#include "sequence/generation.h"
+
+/*
+ * Random sequences for tests and load tests.
+ *
+ * generate_sequence() draws symbols with rand() and the cumulative
+ * probabilities, as it always did. The other functions draw symbols from
+ * an alias table with one random number each, so generating takes constant
+ * time per symbol for any alphabet. They are seeded: generate_sequence()
+ * with a seed returns text, generate_dna_sequence() and
+ * generate_dna_sequences() return compressed sequences. Their results are
+ * the same for the same arguments on every platform. The symbols are
+ * generated into a buffer, that is reused for all rows, and compressed
+ * from there like read_fasta() does, so they are never materialized as
+ * text.
+ */
+
+/**
+ * Range of the coin of the alias method.
+ */
+#define PB_ALIAS_COIN_RANGE		(UINT64CONST(1) << 32)
+
+/**
+ * State of a DNA sequence generator, kept across calls of
+ * the set-returning function.
+ */
+typedef struct {
+	PB_AliasTable* table;
+	PB_Random rng;
+	uint32 length;
+	PB_DnaSequenceTypMod typmod;
+	int mode;
+	uint8* buffer;
+	int32 n_sequences;
+} PB_DnaSequenceGenerator;
+
+Datum generate_sequence(PG_FUNCTION_ARGS);
+Datum generate_sequence_seeded(PG_FUNCTION_ARGS);
+Datum generate_dna_sequence(PG_FUNCTION_ARGS);
+Datum generate_dna_sequences(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static PB_DnaSequenceGenerator* open_dna_sequence_generator(PB_Alphabet* alphabet,
+															int32 length,
+															text* modifiers,
+															int64 seed);
+static PB_CompressedSequence* generate_compressed_dna_sequence(PB_DnaSequenceGenerator* generator);
+
+/*
+ * local functions
+ */
+
+/**
+ * open_dna_sequence_generator()
+ * 		Builds the alias table, seeds the generator and allocates the
+ * 		buffer reused for all sequences. Must be called in a memory context
+ * 		living until the last sequence has been generated.
+ *
+ * 	PB_Alphabet* alphabet : detoasted alphabet
+ * 	int32 length : length of each sequence
+ * 	text* modifiers : type modifiers of the resulting sequences
+ * 	int64 seed : seed of the random number generator
+ */
+static PB_DnaSequenceGenerator* open_dna_sequence_generator(PB_Alphabet* alphabet,
+															int32 length,
+															text* modifiers,
+															int64 seed)
+{
+	PB_DnaSequenceGenerator* generator;
+
+	if (length < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sequence length must not be negative")));
+
+	generator = palloc0(sizeof(PB_DnaSequenceGenerator));
+	generator->table = get_alias_table(alphabet);
+	generator->length = length;
+	generator->typmod = text_to_dna_sequence_typmod(modifiers);
+
+	/*
+	 * Determine sequence info collection mode, as dna_sequence_in() does.
+	 */
+	if (generator->typmod.compression_strategy == PB_DNA_TYPMOD_REFERENCE)
+		generator->mode = PB_SEQUENCE_INFO_WITH_RLE;
+	if (generator->typmod.case_sensitive == PB_DNA_TYPMOD_CASE_SENSITIVE)
+		generator->mode |= PB_SEQUENCE_INFO_CASE_SENSITIVE;
+
+	init_random(&generator->rng, seed);
+
+	generator->buffer = palloc(length + 1);
+	generator->buffer[length] = '\0';
+
+	return generator;
+}
+
+/**
+ * generate_compressed_dna_sequence()
+ * 		Generates the next sequence and compresses it.
+ *
+ * 	Sequences with type modifiers FLC and CASE_INSENSITIVE are packed
+ * 	while their statistics are collected, so the buffer is read once.
+ */
+static PB_CompressedSequence* generate_compressed_dna_sequence(PB_DnaSequenceGenerator* generator)
+{
+	PB_SequenceInfo* info;
+	PB_CompressedSequence* result;
+
+	generate_symbols(generator->table, &generator->rng, generator->buffer, generator->length);
+
+	if (PB_DNA_TYPMOD_IS_FLC_CASE_INSENSITIVE(generator->typmod))
+		return compress_flc_dna_sequence(generator->buffer, generator->length, generator->typmod);
+
+	info = get_sequence_info_cstring(generator->buffer, generator->mode);
+
+	result = compress_dna_sequence(generator->buffer, generator->typmod, info);
+
+	PB_SEQUENCE_INFO_PFREE(info);
+
+	return result;
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * init_random()
+ * 		Seeds a random number generator. The seed is scrambled with
+ * 		splitmix64, so similar seeds give unrelated numbers and no seed
+ * 		gives the state 0, which xorshift never leaves.
+ *
+ * 	PB_Random* rng : generator to seed
+ * 	int64 seed : any value
+ */
+void init_random(PB_Random* rng, int64 seed)
+{
+	uint64 z = (uint64) seed + UINT64CONST(0x9E3779B97F4A7C15);
+
+	z = (z ^ (z >> 30)) * UINT64CONST(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * UINT64CONST(0x94D049BB133111EB);
+	z = z ^ (z >> 31);
+
+	rng->state = z ? z : UINT64CONST(0x9E3779B97F4A7C15);
+}
+
+/**
+ * next_random()
+ * 		Returns the next random number of a generator, xorshift64*.
+ *
+ * 	PB_Random* rng : seeded generator
+ */
+uint64 next_random(PB_Random* rng)
+{
+	rng->state ^= rng->state >> 12;
+	rng->state ^= rng->state << 25;
+	rng->state ^= rng->state >> 27;
+
+	return rng->state * UINT64CONST(2685821657736338717);
+}
+
+/**
+ * get_alias_table()
+ * 		Builds the alias table of an alphabet with Vose's method.
+ * 		Negative probabilities count as 0, the probabilities need not
+ * 		sum up to 1.
+ *
+ * 	PB_Alphabet* alphabet : detoasted alphabet
+ */
+PB_AliasTable* get_alias_table(const PB_Alphabet* alphabet)
+{
+	const int n_symbols = PB_ALPHABET_SIZE(alphabet);
+	const PB_Symbol* symbols = PB_ALPHABET_SYMBOL_POINTER(alphabet);
+	const PB_SymbolProbability* probabilities = PB_ALPHABET_SYMBOL_PROBABILITY_POINTER(alphabet);
+
+	PB_AliasTable* result;
+	double scaled[PB_MAX_ALPHABET_SIZE];
+	int small[PB_MAX_ALPHABET_SIZE];
+	int large[PB_MAX_ALPHABET_SIZE];
+	int n_small = 0;
+	int n_large = 0;
+	double sum = 0.0;
+	int i;
+
+	PB_TRACE(errmsg("->get_alias_table()"));
+
+	for (i = 0; i < n_symbols; i++)
+	{
+		scaled[i] = probabilities ? Max(probabilities[i], 0.0) : 1.0;
+		sum += scaled[i];
+	}
+
+	if (sum <= 0.0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("alphabet has no symbol with a positive probability")));
+
+	result = palloc0(sizeof(PB_AliasTable));
+	result->n_symbols = n_symbols;
+
+	/*
+	 * Scale the probabilities to an average of 1. Columns below 1 are
+	 * filled up with the excess of columns above 1.
+	 */
+	for (i = 0; i < n_symbols; i++)
+	{
+		scaled[i] = scaled[i] * n_symbols / sum;
+		result->symbols[i] = symbols[i];
+		result->aliases[i] = symbols[i];
+
+		if (scaled[i] < 1.0)
+			small[n_small++] = i;
+		else
+			large[n_large++] = i;
+	}
+
+	while (n_small > 0 && n_large > 0)
+	{
+		const int s = small[--n_small];
+		const int l = large[n_large - 1];
+
+		result->thresholds[s] = (uint64) (scaled[s] * PB_ALIAS_COIN_RANGE);
+		result->aliases[s] = symbols[l];
+
+		scaled[l] -= 1.0 - scaled[s];
+		if (scaled[l] < 1.0)
+		{
+			n_large--;
+			small[n_small++] = l;
+		}
+	}
+
+	/*
+	 * The remaining columns are full, up to rounding errors.
+	 */
+	while (n_large > 0)
+		result->thresholds[large[--n_large]] = PB_ALIAS_COIN_RANGE;
+	while (n_small > 0)
+		result->thresholds[small[--n_small]] = PB_ALIAS_COIN_RANGE;
+
+	PB_TRACE(errmsg("<-get_alias_table()"));
+
+	return result;
+}
+
+/**
+ * generate_symbols()
+ * 		Draws length symbols from an alias table. The high half of each
+ * 		random number chooses the column, the low half is the coin.
+ *
+ * 	PB_AliasTable* table : alias table of the alphabet
+ * 	PB_Random* rng : seeded generator
+ * 	uint8* output : space for length symbols
+ * 	uint32 length : number of symbols
+ */
+void generate_symbols(const PB_AliasTable* table,
+					  PB_Random* rng,
+					  uint8* output,
+					  uint32 length)
+{
+	const uint64 n_symbols = table->n_symbols;
+	uint32 i;
+
+	for (i = 0; i < length; i++)
+	{
+		const uint64 random_number = next_random(rng);
+		const uint32 column = (uint32) (((random_number >> 32) * n_symbols) >> 32);
+
+		output[i] = (random_number & 0xFFFFFFFF) < table->thresholds[column] ?
+					table->symbols[column] :
+					table->aliases[column];
+	}
+}
 
 /**
  * generate_sequence()
@@ -113,3 +392,148 @@ Datum generate_sequence (PG_FUNCTION_ARGS) {
 	PG_RETURN_TEXT_P(result);
 }
 
+/**
+ * generate_sequence_seeded()
+ * 		Generate a random sequence for a seed.
+ *
+ * 	Symbols are drawn from an alias table, so the probabilities are
+ * 	normalized and the same seed gives the same sequence on every platform.
+ *
+ * 	PB_Alphabet* input : Alphabet
+ * 	int32 : sequence length
+ * 	int64 : seed of the random number generator
+ */
+PG_FUNCTION_INFO_V1 (generate_sequence_seeded);
+Datum generate_sequence_seeded (PG_FUNCTION_ARGS) {
+	PB_Alphabet* input =
+			(PB_Alphabet*) PG_DETOAST_DATUM(PG_GETARG_POINTER(0));
+	int32 sequence_length = PG_GETARG_INT32(1);
+	int64 seed = PG_GETARG_INT64(2);
+
+	text* result;
+	PB_AliasTable* table;
+	PB_Random rng;
+
+	int mem_size;
+
+	PB_TRACE(errmsg("->generate_sequence_seeded() of length %d", sequence_length));
+
+	if (sequence_length < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sequence length must not be negative")));
+
+	table = get_alias_table(input);
+	init_random(&rng, seed);
+
+	mem_size = VARHDRSZ + sequence_length * sizeof(PB_Symbol);
+	result = palloc(mem_size);
+	SET_VARSIZE(result,mem_size);
+
+	generate_symbols(table, &rng, (uint8*) VARDATA(result), sequence_length);
+
+	pfree(table);
+
+	PB_TRACE(errmsg("<-generate_sequence_seeded()"));
+
+	PG_RETURN_TEXT_P(result);
+}
+
+/**
+ * generate_dna_sequence()
+ * 		Generates a random DNA sequence for a seed.
+ *
+ * 	PB_Alphabet* alphabet : alphabet, possibly with probabilities
+ * 	int32 length : sequence length
+ * 	text* modifiers : comma-separated dna_sequence type modifiers
+ * 	int64 seed : seed of the random number generator
+ */
+PG_FUNCTION_INFO_V1 (generate_dna_sequence);
+Datum generate_dna_sequence(PG_FUNCTION_ARGS)
+{
+	PB_DnaSequenceGenerator* generator;
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->generate_dna_sequence()"));
+
+	generator = open_dna_sequence_generator((PB_Alphabet*) PG_DETOAST_DATUM(PG_GETARG_POINTER(0)),
+											PG_GETARG_INT32(1),
+											PG_GETARG_TEXT_PP(2),
+											PG_GETARG_INT64(3));
+
+	result = generate_compressed_dna_sequence(generator);
+
+	pfree(generator->buffer);
+	pfree(generator->table);
+	pfree(generator);
+
+	PB_TRACE(errmsg("<-generate_dna_sequence()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * generate_dna_sequences()
+ * 		Returns n random DNA sequences for a seed as (id, sequence).
+ * 		All sequences are drawn from one generator, so the first one
+ * 		is the result of generate_dna_sequence() for the same seed.
+ *
+ * 	PB_Alphabet* alphabet : alphabet, possibly with probabilities
+ * 	int32 length : length of each sequence
+ * 	int32 n : number of sequences
+ * 	text* modifiers : comma-separated dna_sequence type modifiers
+ * 	int64 seed : seed of the random number generator
+ */
+PG_FUNCTION_INFO_V1 (generate_dna_sequences);
+Datum generate_dna_sequences(PG_FUNCTION_ARGS)
+{
+	FuncCallContext* funcctx;
+	PB_DnaSequenceGenerator* generator;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		PB_TRACE(errmsg("->generate_dna_sequences()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		if (PG_GETARG_INT32(2) < 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("number of sequences must not be negative")));
+
+		generator = open_dna_sequence_generator((PB_Alphabet*) PG_DETOAST_DATUM(PG_GETARG_POINTER(0)),
+												PG_GETARG_INT32(1),
+												PG_GETARG_TEXT_PP(3),
+												PG_GETARG_INT64(4));
+		generator->n_sequences = PG_GETARG_INT32(2);
+		funcctx->user_fctx = generator;
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	generator = (PB_DnaSequenceGenerator*) funcctx->user_fctx;
+
+	if (funcctx->call_cntr < generator->n_sequences)
+	{
+		Datum values[2];
+		bool nulls[2] = {false, false};
+
+		values[0] = Int32GetDatum(funcctx->call_cntr + 1);
+		values[1] = PointerGetDatum(generate_compressed_dna_sequence(generator));
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	PB_TRACE(errmsg("<-generate_dna_sequences()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
@@ -0,0 +1,519 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/sequence/kmer_counts.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+
+#include "postgres.h"
+#include "utils/memutils.h"
+
+#include "sequence/sequence.h"
+#include "sequence/compression.h"
+#include "sequence/detoast_cursor.h"
+#include "sequence/kmer_counts.h"
+#include "utils/debug.h"
+
+/*
+ * The k-mers are rolled along the sequence: each symbol shifts the
+ * packed forward k-mer left and its reverse complement right. Streams
+ * of fixed 2 bit codes, e.g. of dna_flc, already hold packed symbols,
+ * so the next symbol is just the top bits of the current block. No
+ * symbol is decoded and no plain text buffer is needed.
+ *
+ * The counts are kept in an open addressing hash table with linear
+ * probing, all slots in one allocation. It doubles when it is three
+ * quarters full.
+ */
+
+/**
+ * Bytes of the stream read at once and symbols decoded at once.
+ */
+#define PB_KMER_SLICE_SIZE			(64 * 1024)
+#define PB_KMER_CHUNK_SIZE			PB_INDEX_PART_SIZE
+
+/**
+ * Initial and maximum log2 of the number of slots.
+ */
+#define PB_KMER_MIN_CAPACITY_BITS	10
+#define PB_KMER_MAX_CAPACITY_BITS	31
+
+/**
+ * The last k symbols seen.
+ *
+ * 	uint64 forward : packed k-mer
+ * 	uint64 reverse : packed reverse complement of the k-mer
+ * 	int valid : number of symbols since the last skipped one
+ */
+typedef struct {
+	uint64 forward;
+	uint64 reverse;
+	int valid;
+} PB_KmerWindow;
+
+/*
+ * local function declarations
+ */
+
+static int nucleotide_code(uint8 symbol);
+static void grow_table(PB_KmerCounter* counter);
+static inline void add_symbol(PB_KmerCounter* counter, PB_KmerWindow* window, int code);
+static bool get_packed_codes(const PB_CodeSet* codeset, int* codes);
+static void count_packed_kmers(PB_KmerCounter* counter,
+							   PB_DetoastCursor* cursor,
+							   const int* codes);
+static void count_decoded_kmers(PB_KmerCounter* counter,
+								PB_DetoastCursor* cursor,
+								PB_CodeSet** fixed_codesets);
+static uint32 compact_table(PB_KmerCounter* counter);
+static int compare_by_kmer(const void* a, const void* b);
+static int compare_counts(const void* a, const void* b);
+
+/*
+ * local functions
+ */
+
+/**
+ * nucleotide_code()
+ * 		Returns the 2 bit code of a nucleotide, the complement of a
+ * 		code c is 3 - c. Returns -1 for other symbols.
+ */
+static int nucleotide_code(uint8 symbol)
+{
+	switch (symbol)
+	{
+		case 'A':
+		case 'a':
+			return 0;
+		case 'C':
+		case 'c':
+			return 1;
+		case 'G':
+		case 'g':
+			return 2;
+		case 'T':
+		case 't':
+			return 3;
+		default:
+			return -1;
+	}
+}
+
+/**
+ * grow_table()
+ * 		Doubles the number of slots of a counter.
+ */
+static void grow_table(PB_KmerCounter* counter)
+{
+	PB_KmerCount* old_entries = counter->entries;
+	const uint32 old_capacity = counter->capacity;
+	uint32 i;
+
+	if (counter->capacity_bits == PB_KMER_MAX_CAPACITY_BITS)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("too many distinct k-mers")));
+
+	counter->capacity_bits++;
+	counter->capacity = ((uint32) 1) << counter->capacity_bits;
+	counter->entries = MemoryContextAllocExtended(counter->context,
+												  (Size) counter->capacity * sizeof(PB_KmerCount),
+												  MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+	counter->n_entries = 0;
+
+	PB_DEBUG1(errmsg("grow_table(): %u slots", counter->capacity));
+
+	if (old_entries == NULL)
+		return;
+
+	for (i = 0; i < old_capacity; i++)
+		if (old_entries[i].count > 0)
+			add_kmer_count(counter, old_entries[i].kmer, old_entries[i].count);
+
+	pfree(old_entries);
+}
+
+/**
+ * add_symbol()
+ * 		Moves the window by one symbol and counts the k-mer ending there.
+ *
+ * 	int code : 2 bit code of the symbol or -1 to skip it
+ */
+static inline void add_symbol(PB_KmerCounter* counter, PB_KmerWindow* window, int code)
+{
+	const int k = counter->k;
+	const uint64 mask = k == PB_MAX_COUNTED_KMER_LENGTH ? ~((uint64) 0) : (((uint64) 1) << (k * 2)) - 1;
+
+	if (code < 0)
+	{
+		window->valid = 0;
+		return;
+	}
+
+	window->forward = ((window->forward << 2) | code) & mask;
+	window->reverse = (window->reverse >> 2) | (((uint64) (3 - code)) << ((k - 1) * 2));
+
+	if (++window->valid < k)
+		return;
+
+	if (counter->canonical && window->reverse < window->forward)
+		add_kmer_count(counter, window->reverse, 1);
+	else
+		add_kmer_count(counter, window->forward, 1);
+}
+
+/**
+ * get_packed_codes()
+ * 		Returns TRUE, if the stream of a code holds 2 bit codewords of
+ * 		A, C, G and T only. Sets the nucleotide code of each codeword.
+ *
+ * 	PB_CodeSet* codeset : code of the sequence
+ * 	int* codes : space for 4 nucleotide codes
+ */
+static bool get_packed_codes(const PB_CodeSet* codeset, int* codes)
+{
+	int i;
+
+	if (!codeset->has_equal_length || codeset->uses_rle ||
+		codeset->n_swapped_symbols > 0 || codeset->n_symbols != 4 ||
+		codeset->words[0].code_length != 2)
+		return FALSE;
+
+	for (i = 0; i < 4; i++)
+		codes[i] = -1;
+
+	for (i = 0; i < 4; i++)
+		codes[codeset->words[i].code >> (PB_PREFIX_CODE_BIT_SIZE - 2)] = nucleotide_code(codeset->words[i].symbol);
+
+	for (i = 0; i < 4; i++)
+		if (codes[i] < 0)
+			return FALSE;
+
+	return TRUE;
+}
+
+/**
+ * count_packed_kmers()
+ * 		Counts the k-mers of a stream of 2 bit codewords block by block.
+ *
+ * 	PB_DetoastCursor* cursor : cursor on the sequence
+ * 	int* codes : nucleotide code of each codeword
+ */
+static void count_packed_kmers(PB_KmerCounter* counter,
+							   PB_DetoastCursor* cursor,
+							   const int* codes)
+{
+	const uint32 length = cursor->header->sequence_length;
+	const int32 stream_offset = PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(cursor->header) - VARHDRSZ;
+	const int64 n_blocks = ((int64) length * 2 + PB_COMPRESSION_BUFFER_BIT_SIZE - 1) / PB_COMPRESSION_BUFFER_BIT_SIZE;
+	const int symbols_per_block = PB_COMPRESSION_BUFFER_BIT_SIZE / 2;
+	PB_KmerWindow window = {0, 0, 0};
+	uint32 position = 0;
+	int64 block = 0;
+
+	PB_TRACE(errmsg("->count_packed_kmers()"));
+
+	while (block < n_blocks)
+	{
+		const int32 size = Min(PB_KMER_SLICE_SIZE, (n_blocks - block) * PB_COMPRESSION_BUFFER_BYTE_SIZE);
+		const PB_CompressionBuffer* input;
+		int32 i;
+
+		input = (const PB_CompressionBuffer*) read_detoast_cursor(cursor,
+																  stream_offset + block * PB_COMPRESSION_BUFFER_BYTE_SIZE,
+																  size,
+																  NULL);
+
+		for (i = 0; i < size / (int32) PB_COMPRESSION_BUFFER_BYTE_SIZE; i++)
+		{
+			PB_CompressionBuffer buffer = input[i];
+			const int n_symbols = Min(symbols_per_block, length - position);
+			int j;
+
+			for (j = 0; j < n_symbols; j++)
+			{
+				add_symbol(counter, &window, codes[buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - 2)]);
+				buffer <<= 2;
+			}
+
+			position += n_symbols;
+		}
+
+		block += size / PB_COMPRESSION_BUFFER_BYTE_SIZE;
+	}
+
+	PB_TRACE(errmsg("<-count_packed_kmers()"));
+}
+
+/**
+ * count_decoded_kmers()
+ * 		Counts the k-mers of a sequence decoded chunk by chunk.
+ *
+ * 	PB_DetoastCursor* cursor : cursor on the sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes
+ */
+static void count_decoded_kmers(PB_KmerCounter* counter,
+								PB_DetoastCursor* cursor,
+								PB_CodeSet** fixed_codesets)
+{
+	const uint32 length = cursor->header->sequence_length;
+	PB_KmerWindow window = {0, 0, 0};
+	uint8* chunk;
+	uint32 position = 0;
+	uint32 chunk_length = PB_KMER_CHUNK_SIZE - 1;
+	uint32 i;
+
+	PB_TRACE(errmsg("->count_decoded_kmers()"));
+
+	chunk = palloc(Min(length, PB_KMER_CHUNK_SIZE) + 1);
+
+	while (position < length)
+	{
+		if (chunk_length > length - position)
+			chunk_length = length - position;
+
+		decode_from_cursor(cursor, chunk, position, chunk_length, fixed_codesets);
+
+		for (i = 0; i < chunk_length; i++)
+			add_symbol(counter, &window, nucleotide_code(chunk[i]));
+
+		position += chunk_length;
+		chunk_length = PB_KMER_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	}
+
+	pfree(chunk);
+
+	PB_TRACE(errmsg("<-count_decoded_kmers()"));
+}
+
+/**
+ * compact_table()
+ * 		Moves the counts to the front of the table. Returns their number.
+ */
+static uint32 compact_table(PB_KmerCounter* counter)
+{
+	uint32 n = 0;
+	uint32 i;
+
+	for (i = 0; i < counter->capacity; i++)
+		if (counter->entries[i].count > 0)
+			counter->entries[n++] = counter->entries[i];
+
+	return n;
+}
+
+/**
+ * compare_by_kmer()
+ * 		qsort() comparator for counts by k-mer.
+ */
+static int compare_by_kmer(const void* a, const void* b)
+{
+	const uint64 x = ((const PB_KmerCount*) a)->kmer;
+	const uint64 y = ((const PB_KmerCount*) b)->kmer;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * compare_counts()
+ * 		qsort() comparator for numbers of occurrences.
+ */
+static int compare_counts(const void* a, const void* b)
+{
+	const uint64 x = *((const uint64*) a);
+	const uint64 y = *((const uint64*) b);
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * new_kmer_counter()
+ * 		Creates an empty counter.
+ */
+PB_KmerCounter* new_kmer_counter(int k, bool canonical)
+{
+	MemoryContext context;
+	PB_KmerCounter* result;
+
+	if (k < 1 || k > PB_MAX_COUNTED_KMER_LENGTH)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("k-mer length must be between 1 and %d", PB_MAX_COUNTED_KMER_LENGTH)));
+
+	context = AllocSetContextCreate(CurrentMemoryContext,
+									"postbis k-mer counts",
+									ALLOCSET_DEFAULT_SIZES);
+
+	result = MemoryContextAllocZero(context, sizeof(PB_KmerCounter));
+	result->context = context;
+	result->k = k;
+	result->canonical = canonical;
+	result->capacity_bits = PB_KMER_MIN_CAPACITY_BITS - 1;
+
+	grow_table(result);
+
+	return result;
+}
+
+/**
+ * free_kmer_counter()
+ * 		Frees a counter including its table.
+ */
+void free_kmer_counter(PB_KmerCounter* counter)
+{
+	MemoryContextDelete(counter->context);
+}
+
+/**
+ * count_sequence_kmers()
+ * 		Adds the k-mers of a sequence to a counter.
+ */
+void count_sequence_kmers(PB_KmerCounter* counter, Varlena* raw_seq, PB_CodeSet** fixed_codesets)
+{
+	PB_DetoastCursor* cursor;
+	int fixed_id;
+	int codes[4];
+
+	PB_TRACE(errmsg("->count_sequence_kmers()"));
+
+	cursor = open_detoast_cursor(raw_seq);
+	fixed_id = PB_COMPRESSED_SEQUENCE_FIXED_CODE_ID(cursor->header);
+
+	if (fixed_id >= 0 && get_packed_codes(fixed_codesets[fixed_id], codes))
+		count_packed_kmers(counter, cursor, codes);
+	else
+		count_decoded_kmers(counter, cursor, fixed_codesets);
+
+	close_detoast_cursor(cursor);
+
+	PB_TRACE(errmsg("<-count_sequence_kmers() exits with %u distinct k-mers", counter->n_entries));
+}
+
+/**
+ * merge_kmer_counters()
+ * 		Adds the counts of a counter to another one.
+ */
+void merge_kmer_counters(PB_KmerCounter* counter, const PB_KmerCounter* other)
+{
+	uint32 i;
+
+	if (counter->k != other->k || counter->canonical != other->canonical)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("k-mer counts of different k-mer lengths cannot be merged")));
+
+	for (i = 0; i < other->capacity; i++)
+		if (other->entries[i].count > 0)
+			add_kmer_count(counter, other->entries[i].kmer, other->entries[i].count);
+}
+
+/**
+ * add_kmer_count()
+ * 		Adds occurrences of a k-mer to a counter.
+ */
+void add_kmer_count(PB_KmerCounter* counter, uint64 kmer, uint64 count)
+{
+	uint32 slot;
+
+	if (counter->n_entries >= counter->capacity / 4 * 3)
+		grow_table(counter);
+
+	/*
+	 * Fibonacci hashing, the top bits of the product are well mixed.
+	 */
+	slot = (uint32) ((kmer * UINT64CONST(0x9E3779B97F4A7C15)) >> (64 - counter->capacity_bits));
+
+	while (counter->entries[slot].count > 0 && counter->entries[slot].kmer != kmer)
+		slot = (slot + 1) & (counter->capacity - 1);
+
+	if (counter->entries[slot].count == 0)
+	{
+		counter->entries[slot].kmer = kmer;
+		counter->n_entries++;
+	}
+
+	counter->entries[slot].count += count;
+}
+
+/**
+ * sort_kmer_counts()
+ * 		Moves the counts to the front of the table and sorts them by k-mer.
+ */
+PB_KmerCount* sort_kmer_counts(PB_KmerCounter* counter)
+{
+	const uint32 n = compact_table(counter);
+
+	qsort(counter->entries, n, sizeof(PB_KmerCount), compare_by_kmer);
+
+	return counter->entries;
+}
+
+/**
+ * get_kmer_spectrum()
+ * 		Returns the spectrum of the counts.
+ */
+PB_KmerCount* get_kmer_spectrum(const PB_KmerCounter* counter, uint32* n_rows)
+{
+	uint64* counts;
+	PB_KmerCount* result;
+	uint32 n = 0;
+	uint32 i;
+
+	counts = palloc(Max(counter->n_entries, 1) * sizeof(uint64));
+	for (i = 0; i < counter->capacity; i++)
+		if (counter->entries[i].count > 0)
+			counts[n++] = counter->entries[i].count;
+
+	qsort(counts, n, sizeof(uint64), compare_counts);
+
+	result = palloc(Max(n, 1) * sizeof(PB_KmerCount));
+	*n_rows = 0;
+	for (i = 0; i < n; i++)
+	{
+		if (*n_rows > 0 && result[*n_rows - 1].kmer == counts[i])
+		{
+			result[*n_rows - 1].count++;
+		}
+		else
+		{
+			result[*n_rows].kmer = counts[i];
+			result[*n_rows].count = 1;
+			(*n_rows)++;
+		}
+	}
+
+	pfree(counts);
+
+	return result;
+}
+
+/**
+ * kmer_to_cstring()
+ * 		Writes the text of a packed k-mer.
+ */
+void kmer_to_cstring(uint64 kmer, int k, char* output)
+{
+	static const char nucleotides[] = "ACGT";
+	int i;
+
+	for (i = k - 1; i >= 0; i--)
+	{
+		output[i] = nucleotides[kmer & 3];
+		kmer >>= 2;
+	}
+
+	output[k] = '\0';
+}
@@ -0,0 +1,505 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/sequence/packing.c
+*
+*-------------------------------------------------------------------------
+*/
+#include "postgres.h"
+
+#include "sequence/sequence.h"
+#include "utils/debug.h"
+
+#include "sequence/packing.h"
+
+#if !defined(PB_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define PB_USE_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+ * local function declarations
+ */
+
+static inline void pack_blocks(const uint8* input,
+							   uint32 n_blocks,
+							   const uint8* codes,
+							   const int code_length,
+							   PB_CompressionBuffer* output);
+static inline void unpack_blocks(const PB_CompressionBuffer* input,
+								 uint32 n_blocks,
+								 const uint8* symbols,
+								 const int code_length,
+								 uint8* output);
+static inline void unpack_buffer(PB_CompressionBuffer buffer,
+								 uint32 n_symbols,
+								 const uint8* symbols,
+								 int code_length,
+								 uint8* output);
+
+#ifdef PB_USE_AVX2
+static bool cpu_supports_avx2(void);
+static void pack_blocks_2bit_avx2(const uint8* input,
+								  uint32 n_blocks,
+								  const uint8* codes,
+								  PB_CompressionBuffer* output);
+static void unpack_blocks_2bit_avx2(const PB_CompressionBuffer* input,
+									uint32 n_blocks,
+									const uint8* symbols,
+									uint8* output);
+#endif
+
+/*
+ * local functions
+ */
+
+/**
+ * pack_blocks()
+ * 		Packs whole blocks, code_length must divide the block size.
+ * 		Called with constant code lengths, so the compiler can unroll
+ * 		the inner loop.
+ *
+ * 	uint8* input : input sequence
+ * 	uint32 n_blocks : number of blocks to fill
+ * 	uint8* codes : right-aligned code for each symbol
+ * 	int code_length : length of all codewords
+ * 	PB_CompressionBuffer* output : stream to write to
+ */
+static inline void pack_blocks(const uint8* input,
+							   uint32 n_blocks,
+							   const uint8* codes,
+							   const int code_length,
+							   PB_CompressionBuffer* output)
+{
+	const int symbols_per_block = PB_COMPRESSION_BUFFER_BIT_SIZE / code_length;
+
+	while (n_blocks > 0)
+	{
+		PB_CompressionBuffer buffer = 0;
+		int i;
+
+		for (i = 0; i < symbols_per_block; i++)
+			buffer = (buffer << code_length) | codes[input[i]];
+
+		*output = buffer;
+		output++;
+		input += symbols_per_block;
+		n_blocks--;
+	}
+}
+
+/**
+ * unpack_blocks()
+ * 		Unpacks whole blocks, code_length must divide the block size.
+ * 		Called with constant code lengths, so the compiler can unroll
+ * 		the inner loop.
+ *
+ * 	PB_CompressionBuffer* input : first block to unpack
+ * 	uint32 n_blocks : number of blocks to unpack
+ * 	uint8* symbols : symbol for each right-aligned code
+ * 	int code_length : length of all codewords
+ * 	uint8* output : pointer to sufficient space
+ */
+static inline void unpack_blocks(const PB_CompressionBuffer* input,
+								 uint32 n_blocks,
+								 const uint8* symbols,
+								 const int code_length,
+								 uint8* output)
+{
+	const int symbols_per_block = PB_COMPRESSION_BUFFER_BIT_SIZE / code_length;
+	const PB_CompressionBuffer mask = (1 << code_length) - 1;
+
+	while (n_blocks > 0)
+	{
+		const PB_CompressionBuffer buffer = *input;
+		int i;
+
+		for (i = 0; i < symbols_per_block; i++)
+			output[i] = symbols[(buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - (i + 1) * code_length)) & mask];
+
+		input++;
+		output += symbols_per_block;
+		n_blocks--;
+	}
+}
+
+/**
+ * unpack_buffer()
+ * 		Unpacks symbols from a single left-aligned buffer.
+ *
+ * 	PB_CompressionBuffer buffer : left-aligned codes
+ * 	uint32 n_symbols : number of symbols to unpack, must fit into the buffer
+ * 	uint8* symbols : symbol for each right-aligned code
+ * 	int code_length : length of all codewords
+ * 	uint8* output : pointer to sufficient space
+ */
+static inline void unpack_buffer(PB_CompressionBuffer buffer,
+								 uint32 n_symbols,
+								 const uint8* symbols,
+								 int code_length,
+								 uint8* output)
+{
+	while (n_symbols > 0)
+	{
+		*output = symbols[buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - code_length)];
+		buffer <<= code_length;
+		output++;
+		n_symbols--;
+	}
+}
+
+#ifdef PB_USE_AVX2
+/**
+ * cpu_supports_avx2()
+ * 		Checks once, whether the CPU supports AVX2.
+ */
+static bool cpu_supports_avx2(void)
+{
+	static int supported = -1;
+
+	if (supported < 0)
+	{
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+
+		PB_DEBUG1(errmsg("cpu_supports_avx2(): %d", supported));
+	}
+
+	return supported;
+}
+
+/**
+ * pack_blocks_2bit_avx2()
+ * 		Packs whole blocks of 2-bit codes, 32 symbols at a time.
+ *
+ * 		Symbols are translated to codes with one byte shuffle for each
+ * 		group of 16 ASCII characters, that contains symbols with a non-zero
+ * 		code. Four codes are then combined into one byte with multiply-adds
+ * 		and the bytes are ordered, so that the first symbol ends up in the
+ * 		most significant bits of the block.
+ *
+ * 	uint8* input : input sequence
+ * 	uint32 n_blocks : number of blocks to fill
+ * 	uint8* codes : right-aligned code for each symbol
+ * 	PB_CompressionBuffer* output : stream to write to
+ */
+__attribute__((target("avx2")))
+static void pack_blocks_2bit_avx2(const uint8* input,
+								  uint32 n_blocks,
+								  const uint8* codes,
+								  PB_CompressionBuffer* output)
+{
+	__m256i lookup[PB_ASCII_SIZE / 16];
+	__m256i group[PB_ASCII_SIZE / 16];
+	int n_groups = 0;
+	int i;
+
+	const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+	const __m256i pair_factors = _mm256_set1_epi16(0x0104);
+	const __m256i quad_factors = _mm256_set1_epi32(0x00010010);
+	const __m256i gather = _mm256_setr_epi8(12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+											12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	for (i = 0; i < PB_ASCII_SIZE / 16; i++)
+	{
+		int j;
+
+		for (j = 0; j < 16; j++)
+			if (codes[i * 16 + j])
+				break;
+
+		if (j < 16)
+		{
+			lookup[n_groups] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) (codes + i * 16)));
+			group[n_groups] = _mm256_set1_epi8(i);
+			n_groups++;
+		}
+	}
+
+	while (n_blocks > 0)
+	{
+		const __m256i symbols = _mm256_loadu_si256((const __m256i*) input);
+		const __m256i low = _mm256_and_si256(symbols, low_nibble);
+		const __m256i high = _mm256_and_si256(_mm256_srli_epi16(symbols, 4), low_nibble);
+		__m256i code = _mm256_setzero_si256();
+		__m256i packed;
+
+		for (i = 0; i < n_groups; i++)
+			code = _mm256_or_si256(code,
+								   _mm256_and_si256(_mm256_shuffle_epi8(lookup[i], low),
+								   _mm256_cmpeq_epi8(high, group[i])));
+
+		/*
+		 * 2 codes -> 4 bits in 16 bit words, 4 codes -> 8 bits in 32 bit words
+		 */
+		packed = _mm256_maddubs_epi16(code, pair_factors);
+		packed = _mm256_madd_epi16(packed, quad_factors);
+		packed = _mm256_shuffle_epi8(packed, gather);
+
+		*output = ((PB_CompressionBuffer) (uint32) _mm_cvtsi128_si32(_mm256_castsi256_si128(packed)) << 32) |
+				  (PB_CompressionBuffer) (uint32) _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+
+		input += 32;
+		output++;
+		n_blocks--;
+	}
+}
+
+/**
+ * unpack_blocks_2bit_avx2()
+ * 		Unpacks whole blocks of 2-bit codes, 32 symbols at a time.
+ *
+ * 		Each byte of the block is spread to the four positions of its
+ * 		symbols, the codes are shifted into place and translated to symbols
+ * 		with one byte shuffle.
+ *
+ * 	PB_CompressionBuffer* input : first block to unpack
+ * 	uint32 n_blocks : number of blocks to unpack
+ * 	uint8* symbols : symbol for each right-aligned code
+ * 	uint8* output : pointer to sufficient space
+ */
+__attribute__((target("avx2")))
+static void unpack_blocks_2bit_avx2(const PB_CompressionBuffer* input,
+									uint32 n_blocks,
+									const uint8* symbols,
+									uint8* output)
+{
+	const __m256i lookup = _mm256_setr_epi8(symbols[0], symbols[1], symbols[2], symbols[3], 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+											symbols[0], symbols[1], symbols[2], symbols[3], 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i spread = _mm256_setr_epi8(7, 7, 7, 7, 6, 6, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4,
+											3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0);
+	const __m256i mask_0 = _mm256_set1_epi32(0x000000FF);
+	const __m256i mask_1 = _mm256_set1_epi32(0x0000FF00);
+	const __m256i mask_2 = _mm256_set1_epi32(0x00FF0000);
+	const __m256i mask_3 = _mm256_set1_epi32((int) 0xFF000000);
+	const __m256i code_mask = _mm256_set1_epi8(0x03);
+
+	while (n_blocks > 0)
+	{
+		const __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi64x((long long) *input), spread);
+		__m256i code;
+
+		code = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(bytes, 6), mask_0),
+											   _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask_1)),
+							   _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(bytes, 2), mask_2),
+											   _mm256_and_si256(bytes, mask_3)));
+		code = _mm256_and_si256(code, code_mask);
+
+		_mm256_storeu_si256((__m256i*) output, _mm256_shuffle_epi8(lookup, code));
+
+		input++;
+		output += 32;
+		n_blocks--;
+	}
+}
+#endif
+
+/*
+ * public functions
+ */
+
+/**
+ * pack_equal_length()
+ * 		Packs a sequence with a code of equal length codewords.
+ */
+void pack_equal_length(const uint8* input,
+					   uint32 length,
+					   const uint8* codes,
+					   int code_length,
+					   PB_CompressionBuffer* output)
+{
+	PB_CompressionBuffer buffer = 0;
+	int bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE;
+
+	PB_TRACE(errmsg("->pack_equal_length(), code_length=%d, len=%u", code_length, length));
+
+	/*
+	 * The code of a single symbol has codewords of length 0,
+	 * which leave the stream empty.
+	 */
+	if (length == 0 || code_length < 1)
+		return;
+
+	if (PB_COMPRESSION_BUFFER_BIT_SIZE % code_length == 0)
+	{
+		/*
+		 * No codeword crosses a block boundary.
+		 */
+		const uint32 symbols_per_block = PB_COMPRESSION_BUFFER_BIT_SIZE / code_length;
+		const uint32 n_blocks = length / symbols_per_block;
+
+		switch (code_length)
+		{
+			case 1:
+				pack_blocks(input, n_blocks, codes, 1, output);
+				break;
+			case 2:
+#ifdef PB_USE_AVX2
+				if (cpu_supports_avx2())
+					pack_blocks_2bit_avx2(input, n_blocks, codes, output);
+				else
+#endif
+					pack_blocks(input, n_blocks, codes, 2, output);
+				break;
+			case 4:
+				pack_blocks(input, n_blocks, codes, 4, output);
+				break;
+			default:
+				pack_blocks(input, n_blocks, codes, 8, output);
+				break;
+		}
+
+		input += n_blocks * symbols_per_block;
+		output += n_blocks;
+		length -= n_blocks * symbols_per_block;
+	}
+
+	while (length > 0)
+	{
+		const PB_CompressionBuffer code = codes[*input];
+
+		if (code_length <= bits_free)
+		{
+			buffer = (buffer << code_length) | code;
+			bits_free -= code_length;
+		}
+		else
+		{
+			const int overlap = code_length - bits_free;
+
+			*output = (buffer << bits_free) | (code >> overlap);
+			output++;
+			buffer = code & ((1 << overlap) - 1);
+			bits_free = PB_COMPRESSION_BUFFER_BIT_SIZE - overlap;
+		}
+
+		input++;
+		length--;
+	}
+
+	if (bits_free < PB_COMPRESSION_BUFFER_BIT_SIZE)
+		*output = buffer << bits_free;
+
+	PB_TRACE(errmsg("<-pack_equal_length()"));
+}
+
+/**
+ * unpack_equal_length()
+ * 		Unpacks symbols encoded with a code of equal length codewords.
+ */
+void unpack_equal_length(const PB_CompressionBuffer* input,
+						 int start_bit,
+						 uint32 length,
+						 const uint8* symbols,
+						 int code_length,
+						 uint8* output)
+{
+	PB_CompressionBuffer buffer;
+	int bits_in_buffer;
+
+	PB_TRACE(errmsg("->unpack_equal_length(), code_length=%d, start_bit=%d, len=%u", code_length, start_bit, length));
+
+	if (length == 0)
+		return;
+
+	/*
+	 * Codewords of length 0 all decode to the single symbol.
+	 */
+	if (code_length < 1)
+	{
+		memset(output, symbols[0], length);
+		return;
+	}
+
+	if (PB_COMPRESSION_BUFFER_BIT_SIZE % code_length == 0)
+	{
+		/*
+		 * No codeword crosses a block boundary, so start_bit is a multiple
+		 * of code_length.
+		 */
+		const uint32 symbols_per_block = PB_COMPRESSION_BUFFER_BIT_SIZE / code_length;
+		uint32 n_blocks;
+
+		if (start_bit > 0)
+		{
+			uint32 n_symbols = (PB_COMPRESSION_BUFFER_BIT_SIZE - start_bit) / code_length;
+
+			if (n_symbols > length)
+				n_symbols = length;
+
+			unpack_buffer(*input << start_bit, n_symbols, symbols, code_length, output);
+			input++;
+			output += n_symbols;
+			length -= n_symbols;
+		}
+
+		n_blocks = length / symbols_per_block;
+
+		switch (code_length)
+		{
+			case 1:
+				unpack_blocks(input, n_blocks, symbols, 1, output);
+				break;
+			case 2:
+#ifdef PB_USE_AVX2
+				if (cpu_supports_avx2())
+					unpack_blocks_2bit_avx2(input, n_blocks, symbols, output);
+				else
+#endif
+					unpack_blocks(input, n_blocks, symbols, 2, output);
+				break;
+			case 4:
+				unpack_blocks(input, n_blocks, symbols, 4, output);
+				break;
+			default:
+				unpack_blocks(input, n_blocks, symbols, 8, output);
+				break;
+		}
+
+		input += n_blocks;
+		output += n_blocks * symbols_per_block;
+		length -= n_blocks * symbols_per_block;
+
+		if (length > 0)
+			unpack_buffer(*input, length, symbols, code_length, output);
+	}
+	else
+	{
+		/*
+		 * Codewords may cross block boundaries.
+		 */
+		buffer = *input << start_bit;
+		bits_in_buffer = PB_COMPRESSION_BUFFER_BIT_SIZE - start_bit;
+		input++;
+
+		while (length > 0)
+		{
+			if (code_length <= bits_in_buffer)
+			{
+				*output = symbols[buffer >> (PB_COMPRESSION_BUFFER_BIT_SIZE - code_length)];
+				buffer <<= code_length;
+				bits_in_buffer -= code_length;
+			}
+			else
+			{
+				const PB_CompressionBuffer next = *input;
+
+				*output = symbols[(buffer | (next >> bits_in_buffer)) >> (PB_COMPRESSION_BUFFER_BIT_SIZE - code_length)];
+				buffer = next << (code_length - bits_in_buffer);
+				bits_in_buffer += PB_COMPRESSION_BUFFER_BIT_SIZE - code_length;
+				input++;
+			}
+
+			output++;
+			length--;
+		}
+	}
+
+	PB_TRACE(errmsg("<-unpack_equal_length()"));
+}
@@ -0,0 +1,308 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/sequence/sketch.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "postgres.h"
+
+#include "sequence/sequence.h"
+#include "sequence/compression.h"
+#include "sequence/detoast_cursor.h"
+#include "sequence/sketch.h"
+#include "utils/debug.h"
+
+/*
+ * The k-mers are packed with 2 bits per nucleotide. The forward k-mer
+ * and its reverse complement are shifted along the sequence, each symbol
+ * costs two shifts, the smaller of both is hashed. The hashes smaller
+ * than the largest hash kept so far are collected in a buffer of twice
+ * the sketch size, which is sorted and cut to the sketch size when full.
+ */
+
+/**
+ * Symbols decoded at once, the chunks end at index parts.
+ */
+#define PB_SKETCH_CHUNK_SIZE	PB_INDEX_PART_SIZE
+
+/*
+ * local function declarations
+ */
+
+static inline int nucleotide_code(uint8 symbol);
+static inline uint64 hash_kmer(uint64 kmer);
+static int compare_hashes(const void* a, const void* b);
+static uint32 bottom_hashes(uint64* hashes, uint32 n_hashes, uint32 size);
+
+/*
+ * local functions
+ */
+
+/**
+ * nucleotide_code()
+ * 		Returns the 2 bit code of a nucleotide, the complement of a
+ * 		code c is 3 - c. Returns -1 for other symbols.
+ */
+static inline int nucleotide_code(uint8 symbol)
+{
+	switch (symbol)
+	{
+		case 'A':
+		case 'a':
+			return 0;
+		case 'C':
+		case 'c':
+			return 1;
+		case 'G':
+		case 'g':
+			return 2;
+		case 'T':
+		case 't':
+		case 'U':
+		case 'u':
+			return 3;
+		default:
+			return -1;
+	}
+}
+
+/**
+ * hash_kmer()
+ * 		Hashes a packed k-mer with the finalizer of MurmurHash3. It is a
+ * 		bijection, so distinct k-mers never collide.
+ */
+static inline uint64 hash_kmer(uint64 kmer)
+{
+	kmer ^= kmer >> 33;
+	kmer *= UINT64CONST(0xff51afd7ed558ccd);
+	kmer ^= kmer >> 33;
+	kmer *= UINT64CONST(0xc4ceb9fe1a85ec53);
+	kmer ^= kmer >> 33;
+
+	return kmer;
+}
+
+/**
+ * compare_hashes()
+ * 		qsort() comparator for hashes.
+ */
+static int compare_hashes(const void* a, const void* b)
+{
+	const uint64 x = *((const uint64*) a);
+	const uint64 y = *((const uint64*) b);
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * bottom_hashes()
+ * 		Sorts hashes, removes duplicates and keeps the smallest ones.
+ * 		Returns the new number of hashes.
+ *
+ * 	uint64* hashes : hashes
+ * 	uint32 n_hashes : number of hashes
+ * 	uint32 size : maximum number of hashes to keep
+ */
+static uint32 bottom_hashes(uint64* hashes, uint32 n_hashes, uint32 size)
+{
+	uint32 n_unique = 0;
+	uint32 i;
+
+	qsort(hashes, n_hashes, sizeof(uint64), compare_hashes);
+	for (i = 0; i < n_hashes && n_unique < size; i++)
+		if (n_unique == 0 || hashes[n_unique - 1] != hashes[i])
+			hashes[n_unique++] = hashes[i];
+
+	return n_unique;
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * sequence_sketch()
+ * 		Computes the sketch of a sequence.
+ */
+PB_Sketch* sequence_sketch(Varlena* raw_seq, int k, int size, PB_CodeSet** fixed_codesets)
+{
+	const uint64 mask = k == PB_SKETCH_MAX_KMER_LENGTH ? ~((uint64) 0) : (((uint64) 1) << (k * 2)) - 1;
+	const int reverse_shift = (k - 1) * 2;
+	const uint32 capacity = size * 2;
+	PB_DetoastCursor* cursor;
+	PB_Sketch* result;
+	uint64* hashes;
+	uint32 n_hashes = 0;
+	uint64 threshold = 0;
+	bool full = false;
+	uint64 forward = 0;
+	uint64 reverse = 0;
+	int valid = 0;
+	uint8* chunk;
+	uint32 length;
+	uint32 position = 0;
+	uint32 chunk_length = PB_SKETCH_CHUNK_SIZE - 1;
+	uint32 i;
+
+	PB_TRACE(errmsg("->sequence_sketch()"));
+
+	if (k < 1 || k > PB_SKETCH_MAX_KMER_LENGTH)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("k-mer length must be between 1 and %d", PB_SKETCH_MAX_KMER_LENGTH)));
+
+	if (size < 1 || size > PB_SKETCH_MAX_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sketch size must be between 1 and %d", PB_SKETCH_MAX_SIZE)));
+
+	cursor = open_detoast_cursor(raw_seq);
+	length = cursor->header->sequence_length;
+
+	hashes = palloc(capacity * sizeof(uint64));
+	chunk = palloc(Min(length, PB_SKETCH_CHUNK_SIZE) + 1);
+
+	while (position < length)
+	{
+		if (chunk_length > length - position)
+			chunk_length = length - position;
+
+		decode_from_cursor(cursor, chunk, position, chunk_length, fixed_codesets);
+
+		for (i = 0; i < chunk_length; i++)
+		{
+			const int code = nucleotide_code(chunk[i]);
+			uint64 hash;
+
+			if (code < 0)
+			{
+				valid = 0;
+				continue;
+			}
+
+			forward = ((forward << 2) | code) & mask;
+			reverse = (reverse >> 2) | (((uint64) (3 - code)) << reverse_shift);
+
+			if (++valid < k)
+				continue;
+
+			hash = hash_kmer(Min(forward, reverse));
+			if (full && hash >= threshold)
+				continue;
+
+			hashes[n_hashes++] = hash;
+			if (n_hashes == capacity)
+			{
+				n_hashes = bottom_hashes(hashes, n_hashes, size);
+				full = n_hashes == size;
+				if (full)
+					threshold = hashes[size - 1];
+			}
+		}
+
+		position += chunk_length;
+		chunk_length = PB_SKETCH_CHUNK_SIZE - (position + 1) % PB_INDEX_PART_SIZE;
+	}
+
+	close_detoast_cursor(cursor);
+	pfree(chunk);
+
+	n_hashes = bottom_hashes(hashes, n_hashes, size);
+
+	result = palloc0(PB_SKETCH_HEADER_SIZE + n_hashes * sizeof(uint64));
+	SET_VARSIZE(result, PB_SKETCH_HEADER_SIZE + n_hashes * sizeof(uint64));
+	result->k = k;
+	result->size = size;
+	result->n_hashes = n_hashes;
+	memcpy(result->data, hashes, n_hashes * sizeof(uint64));
+
+	pfree(hashes);
+
+	PB_TRACE(errmsg("<-sequence_sketch() exits with %u hashes", n_hashes));
+
+	return result;
+}
+
+/**
+ * sketch_shared_hashes()
+ * 		Counts the shared hashes among the smallest hashes of the union
+ * 		of two sketches.
+ */
+uint32 sketch_shared_hashes(const PB_Sketch* a, const PB_Sketch* b, uint32* n_shared)
+{
+	const uint32 n_union = Min(a->n_hashes, b->n_hashes);
+	uint32 i = 0;
+	uint32 j = 0;
+	uint32 n;
+
+	if (a->k != b->k)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sketches of %d-mers and %d-mers cannot be compared", a->k, b->k)));
+
+	/*
+	 * The smallest n_union hashes of the union of both sketches are in
+	 * both sketches, each has at least n_union hashes.
+	 */
+	*n_shared = 0;
+	for (n = 0; n < n_union; n++)
+	{
+		if (a->data[i] == b->data[j])
+		{
+			(*n_shared)++;
+			i++;
+			j++;
+		}
+		else if (a->data[i] < b->data[j])
+			i++;
+		else
+			j++;
+	}
+
+	return n_union;
+}
+
+/**
+ * sketch_jaccard()
+ * 		Estimates the Jaccard index of the k-mer sets of two sketches.
+ */
+double sketch_jaccard(const PB_Sketch* a, const PB_Sketch* b)
+{
+	uint32 n_shared;
+	const uint32 n_union = sketch_shared_hashes(a, b, &n_shared);
+
+	if (n_union == 0)
+		return 0.0;
+
+	return (double) n_shared / n_union;
+}
+
+/**
+ * jaccard_to_mash_distance()
+ * 		Converts a Jaccard index to the Mash distance.
+ */
+double jaccard_to_mash_distance(double jaccard, int k)
+{
+	double distance;
+
+	if (jaccard <= 0.0)
+		return 1.0;
+
+	if (jaccard >= 1.0)
+		return 0.0;
+
+	distance = -log(2.0 * jaccard / (1.0 + jaccard)) / k;
+
+	return Min(distance, 1.0);
+}
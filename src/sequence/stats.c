@@ -18,18 +18,35 @@
 
 #include "sequence/stats.h"
 
+#if !defined(PB_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define PB_USE_AVX2
+#include <immintrin.h>
+#endif
+
+/**
+ * Number of interleaved histograms used by count_symbols().
+ */
+#define PB_N_HISTOGRAMS		4
+
 /*
  * local function declarations
  */
 
-static PB_SequenceInfo* get_sequence_info_cstring_rle_case_sensitive(const uint8* input);
-static PB_SequenceInfo* get_sequence_info_cstring_rle_case_insensitive(const uint8* input);
-static PB_SequenceInfo* get_sequence_info_cstring_case_sensitive(const uint8* input);
-static PB_SequenceInfo* get_sequence_info_cstring_case_insensitive(const uint8* input);
-static PB_SequenceInfo* get_sequence_info_text_rle_case_sensitive(const text* input);
-static PB_SequenceInfo* get_sequence_info_text_rle_case_insensitive(const text* input);
-static PB_SequenceInfo* get_sequence_info_text_case_sensitive(const text* input);
-static PB_SequenceInfo* get_sequence_info_text_case_insensitive(const text* input);
+static inline void add_run(uint32* rle_frequencies,
+						   uint8 symbol,
+						   uint32 run_length);
+static void count_runs(const uint8* input,
+					   uint32 length,
+					   bool ignore_case,
+					   uint32* rle_frequencies);
+static PB_SequenceInfo* get_sequence_info_buffer(const uint8* input,
+												 uint32 length,
+												 int mode);
+
+#ifdef PB_USE_AVX2
+static bool cpu_supports_avx2(void);
+static uint32 get_run_starts_avx2(const uint8* input, bool ignore_case);
+#endif
 
 /*
  * macros for heap-sort
@@ -224,607 +241,281 @@ void check_ascii(PB_SequenceInfo* sequence_info)
 	PB_TRACE(errmsg("<-check_ascii()"));
 }
 
-static PB_SequenceInfo* get_sequence_info_cstring_rle_case_sensitive(const uint8* input)
-{
-	uint8 current = '\000';
-	uint8 recent = '\000';
-	unsigned int repeated_chars = -1;
-	uint8* input_pointer = (uint8*) input;
-	int64 temp_len;
-
-	PB_SequenceInfo* result;
-
-	uint32* frequencies;
-	uint32* rle_frequencies;
-
-	result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
-	result->rle_info = (PB_RleInfo*) palloc0(sizeof(PB_RleInfo));
-	result->ignore_case = FALSE;
-
-	frequencies = (uint32*) &(result->frequencies);
-	rle_frequencies = (uint32*) &(result->rle_info->rle_frequencies);
-
-	while (*input_pointer != '\000')
-	{
-		current = *input_pointer;
-		input_pointer++;
-		frequencies[current]++;
-		repeated_chars++;
-
-		if (current != recent)
-		{
-			/*
-			 * a series of length 'repeated_chars' equal characters ends
-			 */
-			if (repeated_chars < PB_MIN_RUN_LENGTH)
-			{
-				/*
-				 * the series is too short for using rle
-				 */
-				rle_frequencies[recent] += repeated_chars;
-				recent = current;
-				repeated_chars = 0;
-			}
-			else
-			{
-				 /*
-				  * number of full PB_MAX_RUN_LENGTH rle 'blocks' needed
-				  */
-				const int rle_blocks = repeated_chars / (PB_MAX_RUN_LENGTH - 1);
-				/*
-				 *  remaining characters, that are not covered by full rle blocks
-				 */
-				const int remainder = repeated_chars % (PB_MAX_RUN_LENGTH - 1);
-
-				rle_frequencies[PB_RUN_LENGTH_SYMBOL] += rle_blocks;
-				rle_frequencies[recent] += rle_blocks;
-
-				if (remainder >= PB_MIN_RUN_LENGTH)
-				{
-					/*
-					 * enough remaining characters to put them into an rle block
-					 */
-					rle_frequencies[PB_RUN_LENGTH_SYMBOL]++;
-					rle_frequencies[recent]++;
-				}
-				else
-				{
-					/*
-					 * too few remaining characters to use RLE
-					 */
-					rle_frequencies[recent] += remainder;
-				}
-
-				recent = current;
-				repeated_chars = 0;
-			}
-		}
-	}
+/*
+ * local functions
+ */
 
-	/*
-	 * processing last character
-	 */
-	repeated_chars++;
-	if (repeated_chars < PB_MIN_RUN_LENGTH)
+/**
+ * add_run()
+ * 		Accounts a run of equal symbols in the RLE frequencies. Runs of
+ * 		PB_MIN_RUN_LENGTH or more symbols are split into blocks of at most
+ * 		PB_MAX_RUN_LENGTH - 1 symbols, each encoded as run-length symbol
+ * 		followed by the symbol. Shorter remainders are not run-length
+ * 		encoded.
+ *
+ * 	uint32* rle_frequencies : frequencies to update
+ * 	uint8 symbol : repeated symbol
+ * 	uint32 run_length : number of repetitions
+ */
+static inline void add_run(uint32* rle_frequencies,
+						   uint8 symbol,
+						   uint32 run_length)
+{
+	if (run_length < PB_MIN_RUN_LENGTH)
 	{
-		rle_frequencies[recent] += repeated_chars;
+		rle_frequencies[symbol] += run_length;
 	}
 	else
 	{
-		const int rle_blocks = repeated_chars / (PB_MAX_RUN_LENGTH - 1);
-		const int remainder = repeated_chars % (PB_MAX_RUN_LENGTH - 1);
+		const uint32 rle_blocks = run_length / (PB_MAX_RUN_LENGTH - 1);
+		const uint32 remainder = run_length % (PB_MAX_RUN_LENGTH - 1);
 
 		rle_frequencies[PB_RUN_LENGTH_SYMBOL] += rle_blocks;
-		rle_frequencies[recent] += rle_blocks;
+		rle_frequencies[symbol] += rle_blocks;
 
 		if (remainder >= PB_MIN_RUN_LENGTH)
 		{
 			rle_frequencies[PB_RUN_LENGTH_SYMBOL]++;
-			rle_frequencies[recent]++;
+			rle_frequencies[symbol]++;
 		}
 		else
 		{
-			rle_frequencies[recent] += remainder;
+			rle_frequencies[symbol] += remainder;
 		}
 	}
-
-	temp_len = (input_pointer - (uint8*) input);
-
-	if (temp_len >= PB_MAX_INPUT_SEQUENCE_LENGTH)
-	{
-		ereport(ERROR,(errmsg("input sequence violates length constraints"),
-				errdetail("Maximum is %ld characters. This sequence has %ld characters,", PB_MAX_INPUT_SEQUENCE_LENGTH, temp_len)));
-	}
-
-	check_ascii(result);
-
-	result->sequence_length = (uint32) temp_len;
-	result->ignore_case = FALSE;
-	collect_alphabet((uint32*) &(result->frequencies), &(result->n_symbols), &(result->symbols), &(result->ascii_bitmap_low), &(result->ascii_bitmap_high));
-	collect_alphabet((uint32*) &(result->rle_info->rle_frequencies), &(result->rle_info->n_symbols), &(result->rle_info->symbols), NULL, NULL);
-
-	return result;
 }
 
-static PB_SequenceInfo* get_sequence_info_cstring_rle_case_insensitive(const uint8* input)
-{
-	uint8 current = '\000';
-	uint8 recent = '\000';
-	unsigned int repeated_chars = -1;
-	uint8* input_pointer = (uint8*) input;
-	int64 temp_len;
-
-	PB_SequenceInfo* result;
-
-	uint32* frequencies;
-	uint32* rle_frequencies;
-
-	result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
-	result->rle_info = (PB_RleInfo*) palloc0(sizeof(PB_RleInfo));
-	result->ignore_case = TRUE;
-
-	frequencies = (uint32*) &(result->frequencies);
-	rle_frequencies = (uint32*) &(result->rle_info->rle_frequencies);
-
-	while (*input_pointer != '\000')
-	{
-		current = TO_UPPER(*input_pointer);
-		input_pointer++;
-		frequencies[current]++;
-		repeated_chars++;
-
-		if (current != recent)
-		{
-			/*
-			 * a series of length 'repeated_chars' equal characters ends
-			 */
-			if (repeated_chars < PB_MIN_RUN_LENGTH)
-			{
-				/*
-				 * the series is too short for using rle
-				 */
-				rle_frequencies[recent] += repeated_chars;
-				recent = current;
-				repeated_chars = 0;
-			}
-			else
-			{
-				/*
-				 * number of full PB_MAX_RUN_LENGTH rle 'blocks' needed
-				 */
-				const int rle_blocks = repeated_chars / (PB_MAX_RUN_LENGTH - 1);
-				/*
-				 *  remaining characters, that are not covered by full rle blocks
-				 */
-				const int remainder = repeated_chars % (PB_MAX_RUN_LENGTH - 1);
-
-				rle_frequencies[PB_RUN_LENGTH_SYMBOL] += rle_blocks;
-				rle_frequencies[recent] += rle_blocks;
-
-				if (remainder >= PB_MIN_RUN_LENGTH)
-				{
-					/*
-					 * enough remaining characters to put them into an rle block
-					 */
-					rle_frequencies[PB_RUN_LENGTH_SYMBOL]++;
-					rle_frequencies[recent]++;
-				}
-				else
-				{
-					/*
-					 * too few remaining characters to use RLE
-					 */
-					rle_frequencies[recent] += remainder;
-				}
-				recent = current;
-				repeated_chars = 0;
-			}
-		}
-	}
-
-	/*
-	 * processing last character
-	 */
-	repeated_chars++;
-	if (repeated_chars < PB_MIN_RUN_LENGTH)
-	{
-		rle_frequencies[recent] += repeated_chars;
-	}
-	else
-	{
-		const int rle_blocks = repeated_chars / (PB_MAX_RUN_LENGTH - 1);
-		const int remainder = repeated_chars % (PB_MAX_RUN_LENGTH - 1);
-		rle_frequencies[PB_RUN_LENGTH_SYMBOL] += rle_blocks;
-		rle_frequencies[recent] += rle_blocks;
-		if (remainder >= PB_MIN_RUN_LENGTH)
-		{
-			rle_frequencies[PB_RUN_LENGTH_SYMBOL]++;
-			rle_frequencies[recent]++;
-		}
-		else
-		{
-			rle_frequencies[recent] += remainder;
-		}
-	}
-
-	temp_len = (input_pointer - (uint8*) input);
-
-	if (temp_len >= PB_MAX_INPUT_SEQUENCE_LENGTH)
-	{
-		ereport(ERROR,(errmsg("input sequence violates length constraints"),
-				errdetail("Maximum is %ld characters. This sequence has %ld characters,", PB_MAX_INPUT_SEQUENCE_LENGTH, temp_len)));
-	}
-
-	check_ascii(result);
-
-	result->sequence_length = (uint32) temp_len;
-	result->ignore_case = TRUE;
-	collect_alphabet((uint32*) &(result->frequencies), &(result->n_symbols), &(result->symbols), &(result->ascii_bitmap_low), &(result->ascii_bitmap_high));
-	collect_alphabet((uint32*) &(result->rle_info->rle_frequencies), &(result->rle_info->n_symbols), &(result->rle_info->symbols), NULL, NULL);
-
-	return result;
-}
-
-static PB_SequenceInfo* get_sequence_info_cstring_case_sensitive(const uint8* input)
+#ifdef PB_USE_AVX2
+/**
+ * cpu_supports_avx2()
+ * 		Checks once, whether the CPU supports AVX2.
+ */
+static bool cpu_supports_avx2(void)
 {
-	uint8* input_pointer = (uint8*) input;
-
-	int64 temp_len;
-
-	PB_SequenceInfo* result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
-
-	uint32* frequencies = (uint32*) &(result->frequencies);
-
-	while (*input_pointer != '\000')
-	{
-		frequencies[*input_pointer]++;
-		input_pointer++;
-	}
-
-	temp_len = (input_pointer - (uint8*) input);
+	static int supported = -1;
 
-	if (temp_len >= PB_MAX_INPUT_SEQUENCE_LENGTH)
+	if (supported < 0)
 	{
-		ereport(ERROR,(errmsg("input sequence violates length constraints"),
-				errdetail("Maximum is %ld characters. This sequence has %ld characters,", PB_MAX_INPUT_SEQUENCE_LENGTH, temp_len)));
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("avx2") ? 1 : 0;
 	}
 
-	check_ascii(result);
-
-	result->sequence_length = (uint32) temp_len;
-	result->ignore_case = FALSE;
-	collect_alphabet((uint32*) &(result->frequencies),&(result->n_symbols),&(result->symbols), &(result->ascii_bitmap_low), &(result->ascii_bitmap_high));
-
-	return result;
+	return supported;
 }
 
-/*
- * local functions
+/**
+ * get_run_starts_avx2()
+ * 		Returns a bitmap of the 32 symbols starting at input, in which
+ * 		bit i is set, if symbol i differs from its predecessor. Letters
+ * 		are compared in upper case, if case is ignored. input[-1] must
+ * 		be readable.
+ *
+ * 	uint8* input : first of the 32 symbols
+ * 	bool ignore_case : compare case-insensitive
  */
-static PB_SequenceInfo* get_sequence_info_cstring_case_insensitive(const uint8* input)
+__attribute__((target("avx2")))
+static uint32 get_run_starts_avx2(const uint8* input, bool ignore_case)
 {
-	uint8* input_pointer = (uint8*) input;
-
-	int64 temp_len;
-	int i;
-
-	PB_SequenceInfo* result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
-
-	uint32* frequencies = (uint32*) &(result->frequencies);
+	__m256i current = _mm256_loadu_si256((const __m256i*) input);
+	__m256i previous = _mm256_loadu_si256((const __m256i*) (input - 1));
 
-	while (*input_pointer != '\000')
+	if (ignore_case)
 	{
-		frequencies[*input_pointer]++;
-		input_pointer++;
-	}
-
-	temp_len = (input_pointer - (uint8*) input);
-
-	if (temp_len >= PB_MAX_INPUT_SEQUENCE_LENGTH)
-	{
-		ereport(ERROR,(errmsg("input sequence violates length constraints"),
-				errdetail("Maximum is %ld characters. This sequence has %ld characters,", PB_MAX_INPUT_SEQUENCE_LENGTH, temp_len)));
-	}
+		const __m256i before_a = _mm256_set1_epi8('a' - 1);
+		const __m256i after_z = _mm256_set1_epi8('z' + 1);
+		const __m256i case_bit = _mm256_set1_epi8(0x20);
 
-	for (i = 97; i <= 122; i++)
-	{
-		frequencies[i - 32] += frequencies[i];
-		frequencies[i] = 0;
+		/*
+		 * Signed comparison, bytes above 127 are never lower case.
+		 */
+		current = _mm256_sub_epi8(current,
+								  _mm256_and_si256(case_bit,
+												   _mm256_and_si256(_mm256_cmpgt_epi8(current, before_a),
+																	_mm256_cmpgt_epi8(after_z, current))));
+		previous = _mm256_sub_epi8(previous,
+								   _mm256_and_si256(case_bit,
+													_mm256_and_si256(_mm256_cmpgt_epi8(previous, before_a),
+																	 _mm256_cmpgt_epi8(after_z, previous))));
 	}
 
-	check_ascii(result);
-
-	result->sequence_length = (uint32) temp_len;
-	result->ignore_case = TRUE;
-	collect_alphabet((uint32*) &(result->frequencies),&(result->n_symbols),&(result->symbols), &(result->ascii_bitmap_low), &(result->ascii_bitmap_high));
-
-	return result;
+	return ~((uint32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(current, previous)));
 }
+#endif
 
-static PB_SequenceInfo* get_sequence_info_text_rle_case_sensitive(const text* input)
+/**
+ * count_runs()
+ * 		Collects the frequencies of symbols and run-length symbols
+ * 		after run-length encoding.
+ *
+ * 		The AVX2 kernel compares 32 symbols with their predecessors at
+ * 		once and visits the starts of runs only. Long runs, as found in
+ * 		assembled genomes, are skipped 32 symbols at a time.
+ *
+ * 	uint8* input : input sequence
+ * 	uint32 length : length of the input sequence
+ * 	bool ignore_case : count upper and lower case letters as one symbol
+ * 	uint32* rle_frequencies : output parameter for the frequencies
+ */
+static void count_runs(const uint8* input,
+					   uint32 length,
+					   bool ignore_case,
+					   uint32* rle_frequencies)
 {
-	uint8 current = '\000';
-	uint8 recent = '\000';
-	unsigned int repeated_chars = -1;
-	int i = VARSIZE_ANY_EXHDR(input) - 1;
-	uint8* input_pointer = (uint8*) VARDATA_ANY(input);
-
-	PB_SequenceInfo* result;
-
-	uint32* frequencies;
-	uint32* rle_frequencies;
+	uint32 run_start = 0;
+	uint32 position = 1;
+	uint8 symbol;
 
-	result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
-	result->rle_info = (PB_RleInfo*) palloc0(sizeof(PB_RleInfo));
-	result->ignore_case = FALSE;
+	if (length == 0)
+		return;
 
-	frequencies = (uint32*) &(result->frequencies);
-	rle_frequencies = (uint32*) &(result->rle_info->rle_frequencies);
+	symbol = ignore_case ? TO_UPPER(input[0]) : input[0];
 
-	while (i >= 0)
+#ifdef PB_USE_AVX2
+	if (cpu_supports_avx2())
 	{
-		current = *input_pointer;
-		input_pointer++;
-		i--;
-		frequencies[current]++;
-		repeated_chars++;
-
-		if (current != recent)
+		for (; position + 32 <= length; position += 32)
 		{
-			/*
-			 * a series of length 'repeated_chars' equal characters ends
-			 */
-			if (repeated_chars < PB_MIN_RUN_LENGTH)
-			{
-				/*
-				 * the series is too short for using rle
-				 */
-				rle_frequencies[recent] += repeated_chars;
-				recent = current;
-				repeated_chars = 0;
-			}
-			else
+			uint32 run_starts = get_run_starts_avx2(input + position, ignore_case);
+
+			while (run_starts)
 			{
-				/*
-				 * number of full PB_MAX_RUN_LENGTH rle 'blocks' needed
-				 */
-				const int rle_blocks = repeated_chars / (PB_MAX_RUN_LENGTH - 1);
-				/*
-				 *  remaining characters, that are not covered by full rle blocks
-				 */
-				const int remainder = repeated_chars % (PB_MAX_RUN_LENGTH - 1);
-
-				rle_frequencies[PB_RUN_LENGTH_SYMBOL] += rle_blocks;
-				rle_frequencies[recent] += rle_blocks;
-
-				if (remainder >= PB_MIN_RUN_LENGTH)
-				{
-					/*
-					 * enough remaining characters to put them into an rle block
-					 */
-					rle_frequencies[PB_RUN_LENGTH_SYMBOL]++;
-					rle_frequencies[recent]++;
-				}
-				else
-				{
-					/*
-					 * too few remaining characters to use RLE
-					 */
-					rle_frequencies[recent] += remainder;
-				}
-				recent = current;
-				repeated_chars = 0;
+				const uint32 next_start = position + __builtin_ctz(run_starts);
+
+				add_run(rle_frequencies, symbol, next_start - run_start);
+				run_start = next_start;
+				symbol = ignore_case ? TO_UPPER(input[next_start]) : input[next_start];
+				run_starts &= run_starts - 1;
 			}
 		}
 	}
+#endif
 
-	/*
-	 * processing last character
-	 */
-	repeated_chars++;
-	if (repeated_chars < PB_MIN_RUN_LENGTH)
+	for (; position < length; position++)
 	{
-		rle_frequencies[recent] += repeated_chars;
-	}
-	else
-	{
-		const int rle_blocks = repeated_chars / (PB_MAX_RUN_LENGTH - 1);
-		const int remainder = repeated_chars % (PB_MAX_RUN_LENGTH - 1);
-		rle_frequencies[PB_RUN_LENGTH_SYMBOL] += rle_blocks;
-		rle_frequencies[recent] += rle_blocks;
-		if (remainder >= PB_MIN_RUN_LENGTH)
-		{
-			rle_frequencies[PB_RUN_LENGTH_SYMBOL]++;
-			rle_frequencies[recent]++;
-		}
-		else
+		const uint8 current = ignore_case ? TO_UPPER(input[position]) : input[position];
+
+		if (current != symbol)
 		{
-			rle_frequencies[recent] += remainder;
+			add_run(rle_frequencies, symbol, position - run_start);
+			run_start = position;
+			symbol = current;
 		}
 	}
 
-	check_ascii(result);
-
-	result->sequence_length = VARSIZE_ANY_EXHDR(input);
-	result->ignore_case = FALSE;
-	collect_alphabet((uint32*) &(result->frequencies), &(result->n_symbols), &(result->symbols), &(result->ascii_bitmap_low), &(result->ascii_bitmap_high));
-	collect_alphabet((uint32*) &(result->rle_info->rle_frequencies), &(result->rle_info->n_symbols), &(result->rle_info->symbols), NULL, NULL);
-
-	return result;
+	add_run(rle_frequencies, symbol, length - run_start);
 }
 
-static PB_SequenceInfo* get_sequence_info_text_rle_case_insensitive(const text* input)
+/**
+ * get_sequence_info_buffer()
+ * 		Obtain sequence length, symbol frequencies and alphabet of
+ * 		an input of known length.
+ *
+ * 	uint8* input : input sequence
+ * 	uint32 length : length of the input sequence
+ * 	int mode : see get_sequence_info_cstring()
+ */
+static PB_SequenceInfo* get_sequence_info_buffer(const uint8* input,
+												 uint32 length,
+												 int mode)
 {
-	uint8 current = '\000';
-	uint8 recent = '\000';
-	unsigned int repeated_chars = -1;
-	int i = VARSIZE_ANY_EXHDR(input) - 1;
-	uint8* input_pointer = (uint8*) VARDATA_ANY(input);
-
-	PB_SequenceInfo* result;
-
-	uint32* frequencies;
-	uint32* rle_frequencies;
-
-	result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
-	result->rle_info = (PB_RleInfo*) palloc0(sizeof(PB_RleInfo));
-	result->ignore_case = TRUE;
+	PB_SequenceInfo* result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
 
-	frequencies = (uint32*) &(result->frequencies);
-	rle_frequencies = (uint32*) &(result->rle_info->rle_frequencies);
+	result->sequence_length = length;
+	result->ignore_case = (mode & PB_SEQUENCE_INFO_CASE_SENSITIVE) ? FALSE : TRUE;
 
-	while (i >= 0)
-	{
-		current = TO_UPPER(*input_pointer);
-		input_pointer++;
-		i--;
-		frequencies[current]++;
-		repeated_chars++;
+	count_symbols(input, length, result->frequencies);
 
-		if (current != recent)
-		{
-			/*
-			 * a series of length 'repeated_chars' equal characters ends
-			 */
-			if (repeated_chars < PB_MIN_RUN_LENGTH)
-			{
-				/*
-				 * the series is too short for using rle
-				 */
-				rle_frequencies[recent] += repeated_chars;
-				recent = current;
-				repeated_chars = 0;
-			}
-			else
-			{
-				/*
-				 * number of full PB_MAX_RUN_LENGTH rle 'blocks' needed
-				 */
-				const int rle_blocks = repeated_chars / (PB_MAX_RUN_LENGTH - 1);
-				/*
-				 *  remaining characters, that are not covered by full rle blocks
-				 */
-				const int remainder = repeated_chars % (PB_MAX_RUN_LENGTH - 1);
-
-				rle_frequencies[PB_RUN_LENGTH_SYMBOL] += rle_blocks;
-				rle_frequencies[recent] += rle_blocks;
-
-				if (remainder >= PB_MIN_RUN_LENGTH)
-				{
-					/*
-					 * enough remaining characters to put them into an rle block
-					 */
-					rle_frequencies[PB_RUN_LENGTH_SYMBOL]++;
-					rle_frequencies[recent]++;
-				}
-				else
-				{
-					/*
-					 * too few remaining characters to use RLE
-					 */
-					rle_frequencies[recent] += remainder;
-				}
-				recent = current;
-				repeated_chars = 0;
-			}
-		}
-	}
-
-	/*
-	 * processing last character
-	 */
-	repeated_chars++;
-	if (repeated_chars < PB_MIN_RUN_LENGTH)
-	{
-		rle_frequencies[recent] += repeated_chars;
-	}
-	else
+	if (mode & PB_SEQUENCE_INFO_WITH_RLE)
 	{
-		const int rle_blocks = repeated_chars / (PB_MAX_RUN_LENGTH - 1);
-		const int remainder = repeated_chars % (PB_MAX_RUN_LENGTH - 1);
-		rle_frequencies[PB_RUN_LENGTH_SYMBOL] += rle_blocks;
-		rle_frequencies[recent] += rle_blocks;
-		if (remainder >= PB_MIN_RUN_LENGTH)
-		{
-			rle_frequencies[PB_RUN_LENGTH_SYMBOL]++;
-			rle_frequencies[recent]++;
-		}
-		else
-		{
-			rle_frequencies[recent] += remainder;
-		}
+		result->rle_info = (PB_RleInfo*) palloc0(sizeof(PB_RleInfo));
+		count_runs(input, length, result->ignore_case, result->rle_info->rle_frequencies);
 	}
 
-	check_ascii(result);
-
-	result->sequence_length = VARSIZE_ANY_EXHDR(input);
-	result->ignore_case = TRUE;
-	collect_alphabet((uint32*) &(result->frequencies), &(result->n_symbols), &(result->symbols), &(result->ascii_bitmap_low), &(result->ascii_bitmap_high));
-	collect_alphabet((uint32*) &(result->rle_info->rle_frequencies), &(result->rle_info->n_symbols), &(result->rle_info->symbols), NULL, NULL);
+	complete_sequence_info(result);
 
 	return result;
 }
 
-static PB_SequenceInfo* get_sequence_info_text_case_sensitive(const text* input)
-{
-	uint8* input_pointer = (uint8*) VARDATA_ANY(input);
-	int i = VARSIZE_ANY_EXHDR(input) - 1;
+/*
+ * public functions
+ */
 
-	PB_SequenceInfo* result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
+/**
+ * count_symbols()
+ * 		Adds the symbol frequencies of an input to a histogram.
+ *
+ * 		Incrementing a single histogram stalls on repeated symbols, as
+ * 		each increment has to wait for the previous one of the same
+ * 		counter. Eight symbols are loaded at once and spread over
+ * 		PB_N_HISTOGRAMS interleaved histograms, which are summed up at
+ * 		the end.
+ *
+ * 	uint8* input : input sequence
+ * 	uint32 length : length of the input sequence
+ * 	uint32* frequencies : histogram to add to
+ */
+void count_symbols(const uint8* input,
+				   uint32 length,
+				   uint32* frequencies)
+{
+	uint32 histograms[PB_N_HISTOGRAMS][PB_SOURCE_ALPHABET_SIZE];
+	uint32 i;
+	int j;
 
-	uint32* frequencies = (uint32*) &(result->frequencies);
+	memset(histograms, 0, sizeof(histograms));
 
-	while (i >= 0)
+	for (i = 0; i + 8 <= length; i += 8)
 	{
-		frequencies[*input_pointer]++;
-		input_pointer++;
-		i--;
-	}
+		uint64 block;
 
-	check_ascii(result);
+		memcpy(&block, input + i, sizeof(uint64));
 
-	result->sequence_length = VARSIZE_ANY_EXHDR(input);
-	result->ignore_case = FALSE;
-	collect_alphabet((uint32*) &(result->frequencies), &(result->n_symbols), &(result->symbols), &(result->ascii_bitmap_low), &(result->ascii_bitmap_high));
+		histograms[0][block & 0xFF]++;
+		histograms[1][(block >> 8) & 0xFF]++;
+		histograms[2][(block >> 16) & 0xFF]++;
+		histograms[3][(block >> 24) & 0xFF]++;
+		histograms[0][(block >> 32) & 0xFF]++;
+		histograms[1][(block >> 40) & 0xFF]++;
+		histograms[2][(block >> 48) & 0xFF]++;
+		histograms[3][block >> 56]++;
+	}
 
-	return result;
+	for (; i < length; i++)
+		histograms[0][input[i]]++;
+
+	for (j = 0; j < PB_SOURCE_ALPHABET_SIZE; j++)
+		frequencies[j] += histograms[0][j] + histograms[1][j] + histograms[2][j] + histograms[3][j];
 }
 
-static PB_SequenceInfo* get_sequence_info_text_case_insensitive(const text* input)
+/**
+ * complete_sequence_info()
+ * 		Derives alphabet and ASCII bitmaps from the frequencies collected
+ * 		in a sequence info. If case is ignored, lower case letters are
+ * 		folded into upper case ones here, once for the whole histogram.
+ *
+ * 	PB_SequenceInfo* info : info with sequence length, ignore_case and
+ * 							frequencies set
+ */
+void complete_sequence_info(PB_SequenceInfo* info)
 {
-	uint8* input_pointer = (uint8*) VARDATA_ANY(input);
-	int i = VARSIZE_ANY_EXHDR(input) - 1;
-
-	PB_SequenceInfo* result = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
-
-	uint32* frequencies = (uint32*) &(result->frequencies);
-
-	while (i >= 0)
-	{
-		frequencies[*input_pointer]++;
-		input_pointer++;
-		i--;
-	}
+	int i;
 
-	for (i = 97; i <= 122; i++)
+	if (info->ignore_case)
 	{
-		frequencies[i - 32] += frequencies[i];
-		frequencies[i] = 0;
+		for (i = 'a'; i <= 'z'; i++)
+		{
+			info->frequencies[i - 32] += info->frequencies[i];
+			info->frequencies[i] = 0;
+		}
 	}
 
-	check_ascii(result);
+	check_ascii(info);
 
-	result->sequence_length = VARSIZE_ANY_EXHDR(input);
-	result->ignore_case = TRUE;
-	collect_alphabet((uint32*) &(result->frequencies), &(result->n_symbols), &(result->symbols), &(result->ascii_bitmap_low), &(result->ascii_bitmap_high));
-
-	return result;
+	collect_alphabet(info->frequencies, &(info->n_symbols), &(info->symbols), &(info->ascii_bitmap_low), &(info->ascii_bitmap_high));
+	if (info->rle_info)
+		collect_alphabet(info->rle_info->rle_frequencies, &(info->rle_info->n_symbols), &(info->rle_info->symbols), NULL, NULL);
 }
 
-/*
- * public functions
- */
-
 /**
  * get_sequence_info_cstring()
  * 		Obtain sequence length, symbol frequencies and alphabet.
@@ -842,31 +533,21 @@ static PB_SequenceInfo* get_sequence_info_text_case_insensitive(const text* inpu
 PB_SequenceInfo* get_sequence_info_cstring(uint8* input,
 										   int mode)
 {
-	PB_SequenceInfo* result = NULL;
+	PB_SequenceInfo* result;
+	size_t length;
 
 	PB_TRACE(errmsg("->get_sequence_info_cstring(): mode = %d", mode));
 
-	if (mode & PB_SEQUENCE_INFO_WITH_RLE)
-	{
-		if (mode & PB_SEQUENCE_INFO_CASE_SENSITIVE) {
-			result = get_sequence_info_cstring_rle_case_sensitive(input);
-		}
-		else
-		{
-			result = get_sequence_info_cstring_rle_case_insensitive(input);
-		}
-	}
-	else
+	length = strlen((char*) input);
+
+	if (length >= PB_MAX_INPUT_SEQUENCE_LENGTH)
 	{
-		if (mode & PB_SEQUENCE_INFO_CASE_SENSITIVE) {
-			result = get_sequence_info_cstring_case_sensitive(input);
-		}
-		else
-		{
-			result = get_sequence_info_cstring_case_insensitive(input);
-		}
+		ereport(ERROR,(errmsg("input sequence violates length constraints"),
+				errdetail("Maximum is %ld characters. This sequence has %ld characters,", PB_MAX_INPUT_SEQUENCE_LENGTH, (int64) length)));
 	}
 
+	result = get_sequence_info_buffer(input, (uint32) length, mode);
+
 	PB_TRACE(errmsg("<-get_sequence_info_cstring()"))
 
 	return result;
@@ -889,30 +570,11 @@ PB_SequenceInfo* get_sequence_info_cstring(uint8* input,
 PB_SequenceInfo* get_sequence_info_text(text* input,
 										int mode)
 {
-	PB_SequenceInfo* result = NULL;
+	PB_SequenceInfo* result;
 
 	PB_TRACE(errmsg("->get_sequence_info_text(): mode = %d", mode))
 
-	if (mode & PB_SEQUENCE_INFO_WITH_RLE)
-	{
-		if (mode & PB_SEQUENCE_INFO_CASE_SENSITIVE) {
-			result = get_sequence_info_text_rle_case_sensitive(input);
-		}
-		else
-		{
-			result = get_sequence_info_text_rle_case_insensitive(input);
-		}
-	}
-	else
-	{
-		if (mode & PB_SEQUENCE_INFO_CASE_SENSITIVE) {
-			result = get_sequence_info_text_case_sensitive(input);
-		}
-		else
-		{
-			result = get_sequence_info_text_case_insensitive(input);
-		}
-	}
+	result = get_sequence_info_buffer((uint8*) VARDATA_ANY(input), VARSIZE_ANY_EXHDR(input), mode);
 
 	PB_TRACE(errmsg("<-get_sequence_info_text()"))
 
@@ -0,0 +1,663 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/sequence/transfer.c
+*
+*-------------------------------------------------------------------------
+*/
+#include "postgres.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+#include "libpq/pqformat.h"
+
+#include "sequence/sequence.h"
+#include "sequence/stats.h"
+#include "sequence/compression.h"
+#include "sequence/checksum.h"
+#include "sequence/codebook.h"
+#include "sequence/functions.h"
+#include "utils/debug.h"
+
+#include "sequence/transfer.h"
+
+/**
+ * Number of entries of a transfer map, one for each byte
+ */
+#define PB_TRANSFER_MAP_SIZE		(1 << PB_PREFIX_CODE_BIT_SIZE)
+
+/**
+ * Code length of unused entries of a transfer map
+ */
+#define PB_TRANSFER_MAP_UNUSED		0xFF
+
+/*
+ * Reads a received stream bit by bit.
+ */
+typedef struct {
+	const PB_CompressionBuffer* stream;
+	uint32 n_blocks;
+	uint64 position;
+} PB_BitReader;
+
+/*
+ * Maps the next byte of a stream to a symbol and its code length.
+ */
+typedef struct {
+	uint8 symbols[PB_TRANSFER_MAP_SIZE];
+	uint8 code_lengths[PB_TRANSFER_MAP_SIZE];
+} PB_TransferMap;
+
+/*
+ * local function declarations
+ */
+static void check_codewords(const PB_Codeword* words,
+							int n_words,
+							bool uses_rle,
+							PB_TransferMap* map);
+
+static void check_code(const PB_CodeSet* codeset,
+					   PB_TransferMap* map,
+					   PB_TransferMap* swap_map);
+
+static uint32 read_bits(PB_BitReader* reader,
+						int n_bits);
+
+static uint8 read_symbol(PB_BitReader* reader,
+						 const PB_TransferMap* map);
+
+static uint8 read_swapped_symbol(PB_BitReader* reader,
+								 const PB_CodeSet* codeset,
+								 const PB_TransferMap* map,
+								 const PB_TransferMap* swap_map,
+								 int* swap_counter);
+
+static void decode_stream(PB_BitReader* reader,
+						  const PB_CodeSet* codeset,
+						  const PB_TransferMap* map,
+						  const PB_TransferMap* swap_map,
+						  uint8* output,
+						  uint32 length);
+
+/*
+ * local functions
+ */
+
+/**
+ * check_codewords()
+ * 		Checks the received codewords of a code and fills a transfer map
+ * 		with them. Raises an error, if codewords are malformed, if they
+ * 		are not prefix-free or if symbols are repeated.
+ *
+ * 	PB_Codeword* words : codewords
+ * 	int n_words : number of codewords
+ * 	bool uses_rle : TRUE, if the code uses RLE
+ * 	PB_TransferMap* map : map to fill
+ */
+static void check_codewords(const PB_Codeword* words,
+							int n_words,
+							bool uses_rle,
+							PB_TransferMap* map)
+{
+	bool seen[PB_ASCII_SIZE];
+	int i, j;
+
+	memset(seen, 0, sizeof(seen));
+	memset(map->code_lengths, PB_TRANSFER_MAP_UNUSED, PB_TRANSFER_MAP_SIZE);
+
+	for (i = 0; i < n_words; i++)
+	{
+		const int code_length = words[i].code_length;
+		const uint8 symbol = words[i].symbol;
+		int n_entries;
+
+		if (symbol == 0 || symbol >= PB_ASCII_SIZE ||
+			(symbol == PB_RUN_LENGTH_SYMBOL && !uses_rle) ||
+			seen[symbol])
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid symbol %u in external sequence", symbol)));
+
+		if (code_length > PB_PREFIX_CODE_BIT_SIZE ||
+			(code_length == 0 && n_words > 1) ||
+			(code_length < PB_PREFIX_CODE_BIT_SIZE &&
+			 (words[i].code & ((1 << (PB_PREFIX_CODE_BIT_SIZE - code_length)) - 1)) != 0))
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid codeword in external sequence")));
+
+		seen[symbol] = TRUE;
+
+		n_entries = 1 << (PB_PREFIX_CODE_BIT_SIZE - code_length);
+		for (j = words[i].code; j < words[i].code + n_entries; j++)
+		{
+			if (map->code_lengths[j] != PB_TRANSFER_MAP_UNUSED)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						 errmsg("codewords of external sequence are not prefix-free")));
+
+			map->symbols[j] = symbol;
+			map->code_lengths[j] = code_length;
+		}
+	}
+}
+
+/**
+ * check_code()
+ * 		Checks a received sequence specific code and fills the transfer
+ * 		maps of its main and swap code. Besides the checks of
+ * 		check_codewords() the code must satisfy the assumptions of the
+ * 		encoders and decoders.
+ *
+ * 	PB_CodeSet* codeset : received code
+ * 	PB_TransferMap* map : map of the main code
+ * 	PB_TransferMap* swap_map : map of the swap code
+ */
+static void check_code(const PB_CodeSet* codeset,
+					   PB_TransferMap* map,
+					   PB_TransferMap* swap_map)
+{
+	const int n_main_symbols = codeset->n_symbols - codeset->n_swapped_symbols;
+	bool is_valid = TRUE;
+	int i;
+
+	if (codeset->n_swapped_symbols > codeset->n_symbols ||
+		(n_main_symbols == 0 && codeset->n_symbols > 0))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid number of symbols in external sequence")));
+
+	check_codewords(codeset->words, n_main_symbols, codeset->uses_rle, map);
+	check_codewords(codeset->words + n_main_symbols, codeset->n_swapped_symbols, codeset->uses_rle, swap_map);
+
+	for (i = 1; i < n_main_symbols; i++)
+	{
+		/*
+		 * Decoders take the last codeword as the longest one.
+		 */
+		if (codeset->words[i].code_length < codeset->words[i - 1].code_length &&
+			codeset->n_swapped_symbols == 0)
+			is_valid = FALSE;
+
+		if (codeset->words[i].code_length != codeset->words[0].code_length &&
+			codeset->has_equal_length)
+			is_valid = FALSE;
+	}
+
+	/*
+	 * Equal length codewords are packed, which needs at least one bit
+	 * per character.
+	 */
+	if (codeset->has_equal_length &&
+		(codeset->uses_rle || codeset->n_swapped_symbols > 0 ||
+		 (n_main_symbols > 0 && codeset->words[0].code_length == 0)))
+		is_valid = FALSE;
+
+	if (codeset->n_swapped_symbols > 0)
+	{
+		/*
+		 * The master symbol must be in the main code, the other swapped
+		 * symbols must not.
+		 */
+		const uint8 master_symbol = codeset->words[n_main_symbols].symbol;
+		bool found = FALSE;
+		int j;
+
+		for (i = 0; i < n_main_symbols; i++)
+		{
+			found |= codeset->words[i].symbol == master_symbol;
+
+			for (j = n_main_symbols + 1; j < codeset->n_symbols; j++)
+				if (codeset->words[i].symbol == codeset->words[j].symbol)
+					is_valid = FALSE;
+		}
+
+		is_valid &= found;
+	}
+
+	if (!is_valid)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid code in external sequence")));
+}
+
+/**
+ * read_bits()
+ * 		Reads up to 32 bits from a received stream. Raises an error at the
+ * 		end of the stream.
+ *
+ * 	PB_BitReader* reader : reader of the stream
+ * 	int n_bits : number of bits to read
+ */
+static uint32 read_bits(PB_BitReader* reader,
+						int n_bits)
+{
+	const uint64 block = reader->position / PB_COMPRESSION_BUFFER_BIT_SIZE;
+	const int offset = reader->position % PB_COMPRESSION_BUFFER_BIT_SIZE;
+	PB_CompressionBuffer window;
+
+	if (reader->position + n_bits > (uint64) reader->n_blocks * PB_COMPRESSION_BUFFER_BIT_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("stream of external sequence is too short")));
+
+	if (n_bits == 0)
+		return 0;
+
+	window = reader->stream[block] << offset;
+	if (offset + n_bits > PB_COMPRESSION_BUFFER_BIT_SIZE)
+		window |= reader->stream[block + 1] >> (PB_COMPRESSION_BUFFER_BIT_SIZE - offset);
+
+	reader->position += n_bits;
+
+	return (uint32) (window >> (PB_COMPRESSION_BUFFER_BIT_SIZE - n_bits));
+}
+
+/**
+ * read_symbol()
+ * 		Reads the next codeword of a code from a received stream. Raises
+ * 		an error, if the stream ends or the bits match no codeword.
+ *
+ * 	PB_BitReader* reader : reader of the stream
+ * 	PB_TransferMap* map : map of the code
+ */
+static uint8 read_symbol(PB_BitReader* reader,
+						 const PB_TransferMap* map)
+{
+	const uint64 n_bits = (uint64) reader->n_blocks * PB_COMPRESSION_BUFFER_BIT_SIZE;
+	const int n_peek = Min(n_bits - reader->position, PB_PREFIX_CODE_BIT_SIZE);
+	uint8 next;
+
+	/*
+	 * Near the end of the stream fewer bits are left than a prefix code
+	 * has. Missing bits are taken as zero, read_bits() finds codewords
+	 * exceeding the stream.
+	 */
+	next = read_bits(reader, n_peek) << (PB_PREFIX_CODE_BIT_SIZE - n_peek);
+	reader->position -= n_peek;
+
+	if (map->code_lengths[next] == PB_TRANSFER_MAP_UNUSED)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid code in stream of external sequence")));
+
+	read_bits(reader, map->code_lengths[next]);
+
+	return map->symbols[next];
+}
+
+/**
+ * read_swapped_symbol()
+ * 		Reads the next symbol from a received stream and replaces the
+ * 		master symbol by a swapped symbol, if the swap counter is zero.
+ *
+ * 	PB_BitReader* reader : reader of the stream
+ * 	PB_CodeSet* codeset : received code
+ * 	PB_TransferMap* map : map of the main code
+ * 	PB_TransferMap* swap_map : map of the swap code
+ * 	int* swap_counter : number of master symbols before the next swap
+ */
+static uint8 read_swapped_symbol(PB_BitReader* reader,
+								 const PB_CodeSet* codeset,
+								 const PB_TransferMap* map,
+								 const PB_TransferMap* swap_map,
+								 int* swap_counter)
+{
+	uint8 symbol = read_symbol(reader, map);
+
+	if (codeset->n_swapped_symbols > 0 &&
+		symbol == codeset->words[codeset->n_symbols - codeset->n_swapped_symbols].symbol)
+	{
+		if (*swap_counter > 0)
+			(*swap_counter)--;
+		else
+		{
+			symbol = read_symbol(reader, swap_map);
+			*swap_counter = read_bits(reader, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+		}
+	}
+
+	return symbol;
+}
+
+/**
+ * decode_stream()
+ * 		Decodes a received stream as described in sequence/transfer.h.
+ * 		Unlike decode() it does not trust the stream and checks every
+ * 		codeword and run-length.
+ *
+ * 	PB_BitReader* reader : reader of the stream
+ * 	PB_CodeSet* codeset : received code
+ * 	PB_TransferMap* map : map of the main code
+ * 	PB_TransferMap* swap_map : map of the swap code
+ * 	uint8* output : pointer to length characters
+ * 	uint32 length : length of the sequence
+ */
+static void decode_stream(PB_BitReader* reader,
+						  const PB_CodeSet* codeset,
+						  const PB_TransferMap* map,
+						  const PB_TransferMap* swap_map,
+						  uint8* output,
+						  uint32 length)
+{
+	uint32 position = 0;
+	int swap_counter = 0;
+
+	if (codeset->n_swapped_symbols > 0)
+		swap_counter = read_bits(reader, PB_SWAP_RUN_LENGTH_BIT_SIZE);
+
+	while (position < length)
+	{
+		uint8 symbol = read_swapped_symbol(reader, codeset, map, swap_map, &swap_counter);
+
+		if (symbol == PB_RUN_LENGTH_SYMBOL && codeset->uses_rle)
+		{
+			const uint32 run_length = read_bits(reader, PB_RUN_LENGTH_BIT_SIZE) + PB_MIN_RUN_LENGTH;
+
+			symbol = read_swapped_symbol(reader, codeset, map, swap_map, &swap_counter);
+
+			if (symbol == PB_RUN_LENGTH_SYMBOL || run_length > length - position)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						 errmsg("invalid run-length in stream of external sequence")));
+
+			memset(output + position, symbol, run_length);
+			position += run_length;
+		}
+		else
+		{
+			output[position] = symbol;
+			position++;
+		}
+	}
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * send_sequence()
+ * 		Writes the external binary representation of a sequence.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+bytea* send_sequence(Varlena* raw_seq, PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* seq;
+	StringInfoData buf;
+	PB_CodeSet* codebook = NULL;
+	uint8 flags = 0;
+	uint32 crc;
+	int n_symbols;
+	uint32 n_blocks;
+	const PB_CompressionBuffer* stream;
+	uint32 i;
+
+	PB_TRACE(errmsg("->send_sequence()"));
+
+	seq = (PB_CompressedSequence*) PG_DETOAST_DATUM(raw_seq);
+
+	/*
+	 * Codebooks are local to a database, so sequences using one are sent
+	 * with the codewords of the codebook.
+	 */
+	if (PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(seq))
+	{
+		codebook = get_codebook(*PB_COMPRESSED_SEQUENCE_CODEBOOK_ID_POINTER(seq));
+		n_symbols = codebook->n_symbols;
+	}
+	else if (seq->is_fixed)
+	{
+		flags |= PB_TRANSFER_FLAG_FIXED;
+		n_symbols = fixed_codesets[seq->n_swapped_symbols]->n_symbols;
+	}
+	else
+		n_symbols = seq->n_symbols;
+
+	if (seq->has_equal_length)
+		flags |= PB_TRANSFER_FLAG_EQUAL_LENGTH;
+	if (seq->uses_rle)
+		flags |= PB_TRANSFER_FLAG_RLE;
+
+	if (PB_COMPRESSED_SEQUENCE_HAS_HASH(seq))
+		crc = *PB_COMPRESSED_SEQUENCE_HASH_POINTER(seq);
+	else
+		crc = sequence_crc32((Varlena*) seq, fixed_codesets);
+
+	pq_begintypsend(&buf);
+	pq_sendbyte(&buf, PB_TRANSFER_FORMAT_VERSION);
+	pq_sendbyte(&buf, flags);
+	pq_sendbyte(&buf, seq->index_part_shift);
+	pq_sendint(&buf, seq->sequence_length, 4);
+	pq_sendint(&buf, crc, 4);
+
+	if (codebook != NULL)
+	{
+		pq_sendbyte(&buf, codebook->n_symbols);
+		pq_sendbyte(&buf, 0);
+
+		for (i = 0; i < codebook->n_symbols; i++)
+		{
+			pq_sendbyte(&buf, codebook->words[i].symbol);
+			pq_sendbyte(&buf, codebook->words[i].code_length);
+			pq_sendbyte(&buf, codebook->words[i].code);
+		}
+	}
+	else if (seq->is_fixed)
+		pq_sendbyte(&buf, seq->n_swapped_symbols);
+	else
+	{
+		const PB_Codeword* words = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(seq);
+
+		pq_sendbyte(&buf, seq->n_symbols);
+		pq_sendbyte(&buf, seq->n_swapped_symbols);
+
+		for (i = 0; i < seq->n_symbols; i++)
+		{
+			pq_sendbyte(&buf, words[i].symbol);
+			pq_sendbyte(&buf, words[i].code_length);
+			pq_sendbyte(&buf, words[i].code);
+		}
+	}
+
+	/*
+	 * The stream is sent without the composition behind it.
+	 */
+	n_blocks = (VARSIZE(seq) -
+				PB_COMPRESSED_SEQUENCE_STREAM_OFFSET(seq) -
+				PB_COMPRESSED_SEQUENCE_COMPOSITION_SIZE(seq, n_symbols)) /
+			   PB_COMPRESSION_BUFFER_BYTE_SIZE;
+	stream = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(seq);
+
+	enlargeStringInfo(&buf, sizeof(uint32) + n_blocks * PB_COMPRESSION_BUFFER_BYTE_SIZE);
+	pq_sendint(&buf, n_blocks, 4);
+	for (i = 0; i < n_blocks; i++)
+		pq_sendint64(&buf, stream[i]);
+
+	if ((Pointer) seq != (Pointer) raw_seq)
+		pfree(seq);
+
+	PB_TRACE(errmsg("<-send_sequence()"));
+
+	return pq_endtypsend(&buf);
+}
+
+/**
+ * receive_sequence()
+ * 		Reads the external binary representation of a sequence.
+ *
+ * 	The stream is decoded with bounds checks and verified against the
+ * 	CRC32. The characters are then encoded again with the transmitted
+ * 	code, so no statistics have to be collected and no code has to be
+ * 	built. Invalid input raises an error.
+ *
+ * 	StringInfo buf : message buffer
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ * 	unsigned int n_fixed_codesets : number of fixed codes
+ */
+PB_CompressedSequence* receive_sequence(StringInfo buf,
+										PB_CodeSet** fixed_codesets,
+										unsigned int n_fixed_codesets)
+{
+	PB_CompressedSequence* result;
+	PB_CodeSet* codeset;
+	PB_TransferMap* maps;
+	PB_SequenceInfo* info;
+	PB_BitReader reader;
+	PB_CompressionBuffer* stream;
+	uint8* plain;
+
+	int format_version;
+	uint8 flags;
+	uint8 index_part_shift;
+	uint32 sequence_length;
+	uint32 crc;
+	uint32 i;
+
+	PB_TRACE(errmsg("->receive_sequence()"));
+
+	format_version = pq_getmsgbyte(buf);
+	if (format_version != PB_TRANSFER_FORMAT_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("unsupported external sequence format version %d", format_version)));
+
+	flags = pq_getmsgbyte(buf);
+	index_part_shift = pq_getmsgbyte(buf);
+	sequence_length = pq_getmsgint(buf, 4);
+	crc = pq_getmsgint(buf, 4);
+
+	if (index_part_shift > PB_MAX_INDEX_PART_SHIFT ||
+		(flags & ~(PB_TRANSFER_FLAG_FIXED | PB_TRANSFER_FLAG_EQUAL_LENGTH | PB_TRANSFER_FLAG_RLE)) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid header of external sequence")));
+
+	if (sequence_length > PB_MAX_COMPRESSED_SEQUENCE_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("sequences are limited to %d characters", PB_MAX_COMPRESSED_SEQUENCE_SIZE)));
+
+	maps = palloc(2 * sizeof(PB_TransferMap));
+
+	if (flags & PB_TRANSFER_FLAG_FIXED)
+	{
+		const unsigned int fixed_id = pq_getmsgbyte(buf);
+
+		if (fixed_id >= n_fixed_codesets)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid fixed code id %u in external sequence", fixed_id)));
+
+		codeset = fixed_codesets[fixed_id];
+
+		if (!codeset->has_equal_length != !(flags & PB_TRANSFER_FLAG_EQUAL_LENGTH) ||
+			!codeset->uses_rle != !(flags & PB_TRANSFER_FLAG_RLE))
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid header of external sequence")));
+
+		check_codewords(codeset->words,
+						codeset->n_symbols - codeset->n_swapped_symbols,
+						codeset->uses_rle,
+						&maps[0]);
+		check_codewords(codeset->words + codeset->n_symbols - codeset->n_swapped_symbols,
+						codeset->n_swapped_symbols,
+						codeset->uses_rle,
+						&maps[1]);
+	}
+	else
+	{
+		const uint8 n_symbols = pq_getmsgbyte(buf);
+
+		codeset = palloc0(sizeof(PB_CodeSet) + sizeof(PB_Codeword) * n_symbols);
+		codeset->n_symbols = n_symbols;
+		codeset->n_swapped_symbols = pq_getmsgbyte(buf);
+		codeset->is_fixed = FALSE;
+		codeset->has_equal_length = (flags & PB_TRANSFER_FLAG_EQUAL_LENGTH) != 0;
+		codeset->uses_rle = (flags & PB_TRANSFER_FLAG_RLE) != 0;
+
+		for (i = 0; i < n_symbols; i++)
+		{
+			codeset->words[i].symbol = pq_getmsgbyte(buf);
+			codeset->words[i].code_length = pq_getmsgbyte(buf);
+			codeset->words[i].code = pq_getmsgbyte(buf);
+
+			if (codeset->max_codeword_length < codeset->words[i].code_length)
+				codeset->max_codeword_length = codeset->words[i].code_length;
+		}
+
+		check_code(codeset, &maps[0], &maps[1]);
+	}
+
+	reader.n_blocks = pq_getmsgint(buf, 4);
+	if ((uint64) reader.n_blocks * PB_COMPRESSION_BUFFER_BYTE_SIZE > buf->len - buf->cursor)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("insufficient data left in message")));
+
+	stream = palloc(reader.n_blocks * PB_COMPRESSION_BUFFER_BYTE_SIZE + 1);
+	for (i = 0; i < reader.n_blocks; i++)
+		stream[i] = pq_getmsgint64(buf);
+
+	reader.stream = stream;
+	reader.position = 0;
+
+	/*
+	 * Decode and verify.
+	 */
+	plain = palloc(sequence_length + 1);
+	decode_stream(&reader, codeset, &maps[0], &maps[1], plain, sequence_length);
+	plain[sequence_length] = '\0';
+
+	pfree(stream);
+	pfree(maps);
+
+	if (PB_CRC32_FINAL(crc32_update(PB_CRC32_INIT, plain, sequence_length)) != crc)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("CRC32 mismatch in external sequence")));
+
+	/*
+	 * Encode with the received code.
+	 */
+	info = get_sequence_info_cstring(plain,
+									 PB_SEQUENCE_INFO_CASE_SENSITIVE |
+									 (codeset->uses_rle ? PB_SEQUENCE_INFO_WITH_RLE : PB_SEQUENCE_INFO_WITHOUT_RLE));
+	info->index_part_shift = index_part_shift;
+
+	if (codeset->uses_rle && info->rle_info->rle_frequencies[PB_RUN_LENGTH_SYMBOL] > 0)
+	{
+		/*
+		 * Runs can only be encoded, if the code has a run-length symbol.
+		 */
+		bool found = FALSE;
+
+		for (i = 0; i < codeset->n_symbols; i++)
+			found |= codeset->words[i].symbol == PB_RUN_LENGTH_SYMBOL;
+
+		if (!found)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid code in external sequence")));
+	}
+
+	result = encode(plain, get_compressed_size(info, codeset), codeset, info);
+
+	PB_SEQUENCE_INFO_PFREE(info);
+	pfree(plain);
+
+	if (!codeset->is_fixed)
+		pfree(codeset);
+
+	PB_TRACE(errmsg("<-receive_sequence()"));
+
+	return result;
+}
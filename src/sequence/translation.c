@@ -0,0 +1,474 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/sequence/translation.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/tuptoaster.h"
+
+#include "sequence/sequence.h"
+#include "sequence/compression.h"
+#include "sequence/codebook.h"
+#include "sequence/translation.h"
+#include "utils/debug.h"
+
+/*
+ * Translation of nucleotide sequences into amino acid sequences.
+ *
+ * Nucleotides are mapped to their number in the translation table by a
+ * lookup, so DNA and RNA share one implementation, T being read like U.
+ *
+ * Sequences encoded with four equal length codewords of two bits, e.g.
+ * the four-letter codes, are not decoded at all. Every codon is a group
+ * of six bits in the stream, which is mapped to its amino acid with a
+ * table of 64 entries built from the code and the translation table. The
+ * same group read as reverse complement yields the amino acid of the
+ * reverse frames.
+ *
+ * Other sequences are decoded window by window. The window size is a
+ * multiple of PB_INDEX_PART_SIZE, so every window starts at an index
+ * entry, and a multiple of three, so codons do not span windows.
+ */
+
+/**
+ * Number of characters decoded at a time.
+ */
+#define PB_TRANSLATION_WINDOW_SIZE	(3 * PB_INDEX_PART_SIZE)
+
+/**
+ * Number of a nucleotide in the translation table plus one, zero
+ * for other symbols.
+ */
+static const uint8 nucleotide_numbers[PB_SOURCE_ALPHABET_SIZE] = {
+	['U'] = 1, ['u'] = 1, ['T'] = 1, ['t'] = 1,
+	['C'] = 2, ['c'] = 2,
+	['A'] = 3, ['a'] = 3,
+	['G'] = 4, ['g'] = 4
+};
+
+/**
+ * Returns the number of a nucleotide in the translation table
+ * or (-1) for other symbols.
+ */
+#define NUCLEOTIDE_NUMBER(symbol) ((int) nucleotide_numbers[(uint8) (symbol)] - 1)
+
+/**
+ * Returns the number of the complementary nucleotide.
+ * U and A as well as C and G differ in the second bit.
+ */
+#define COMPLEMENT_NUMBER(number) ((number) ^ 2)
+
+/*
+ * local function declarations
+ */
+
+static bool get_packed_code(const PB_CompressedSequence* header,
+							PB_CodeSet** fixed_codesets,
+							int* numbers);
+static void get_codon_group_maps(const PB_TranslationTable* table,
+								 const int* numbers,
+								 uint8* forward_map,
+								 uint8* reverse_map);
+static inline uint8 get_codon_group(const PB_CompressionBuffer* stream, uint64 bit);
+
+/*
+ * local functions
+ */
+
+/**
+ * get_packed_code()
+ * 		Checks, whether a sequence uses equal length codewords of two
+ * 		bits for nucleotides only. If so, the numbers of the nucleotides
+ * 		are stored by code.
+ *
+ * 	PB_CompressedSequence* header : detoasted prefix of a sequence
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ * 	int* numbers : four numbers of nucleotides by code
+ */
+static bool get_packed_code(const PB_CompressedSequence* header,
+							PB_CodeSet** fixed_codesets,
+							int* numbers)
+{
+	const PB_Codeword* words;
+	int n_symbols;
+	int i;
+
+	if (header->is_fixed)
+	{
+		const PB_CodeSet* codeset = get_fixed_codeset(header, fixed_codesets);
+
+		if (!codeset->has_equal_length || codeset->uses_rle)
+			return FALSE;
+
+		words = codeset->words;
+		n_symbols = codeset->n_symbols;
+	}
+	else
+	{
+		if (!header->has_equal_length || header->n_swapped_symbols > 0 || header->uses_rle)
+			return FALSE;
+
+		words = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(header);
+		n_symbols = header->n_symbols;
+	}
+
+	if (n_symbols > 4)
+		return FALSE;
+
+	for (i = 0; i < 4; i++)
+		numbers[i] = -1;
+
+	for (i = 0; i < n_symbols; i++)
+	{
+		if (words[i].code_length != 2 || NUCLEOTIDE_NUMBER(words[i].symbol) < 0)
+			return FALSE;
+
+		numbers[words[i].code >> 6] = NUCLEOTIDE_NUMBER(words[i].symbol);
+	}
+
+	return TRUE;
+}
+
+/**
+ * get_codon_group_maps()
+ * 		Maps every group of six bits, i.e. three codes of two bits,
+ * 		to the amino acid of the codon and of its reverse complement.
+ *
+ * 	PB_TranslationTable* table : translation table
+ * 	int* numbers : four numbers of nucleotides by code
+ * 	uint8* forward_map : 64 amino acids of codons
+ * 	uint8* reverse_map : 64 amino acids of reverse complement codons
+ */
+static void get_codon_group_maps(const PB_TranslationTable* table,
+								 const int* numbers,
+								 uint8* forward_map,
+								 uint8* reverse_map)
+{
+	int group;
+
+	for (group = 0; group < PB_N_CODONS; group++)
+	{
+		const int first = numbers[group >> 4];
+		const int second = numbers[(group >> 2) & 3];
+		const int third = numbers[group & 3];
+
+		if (first < 0 || second < 0 || third < 0)
+		{
+			forward_map[group] = PB_UNKNOWN_AMINO_ACID;
+			reverse_map[group] = PB_UNKNOWN_AMINO_ACID;
+		}
+		else
+		{
+			forward_map[group] = table->amino_acids[first * 16 + second * 4 + third];
+			reverse_map[group] = table->amino_acids[COMPLEMENT_NUMBER(third) * 16 +
+													COMPLEMENT_NUMBER(second) * 4 +
+													COMPLEMENT_NUMBER(first)];
+		}
+	}
+}
+
+/**
+ * get_codon_group()
+ * 		Reads six bits at a bit position of a stream.
+ *
+ * 	PB_CompressionBuffer* stream : stream
+ * 	uint64 bit : bit position, the first is the most significant
+ * 				 bit of the first block
+ */
+static inline uint8 get_codon_group(const PB_CompressionBuffer* stream, uint64 bit)
+{
+	const uint64 block = bit / PB_COMPRESSION_BUFFER_BIT_SIZE;
+	const int shift = bit % PB_COMPRESSION_BUFFER_BIT_SIZE;
+
+	if (shift <= PB_COMPRESSION_BUFFER_BIT_SIZE - 6)
+		return (stream[block] >> (PB_COMPRESSION_BUFFER_BIT_SIZE - 6 - shift)) & 63;
+
+	return ((stream[block] << (shift - (PB_COMPRESSION_BUFFER_BIT_SIZE - 6))) |
+			(stream[block + 1] >> (2 * PB_COMPRESSION_BUFFER_BIT_SIZE - 6 - shift))) & 63;
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * get_translation_table()
+ * 		Validates a translation table given as text of 64 characters.
+ *
+ * 	FmgrInfo* flinfo : function call info or NULL
+ * 	text* table : translation table
+ */
+PB_TranslationTable* get_translation_table(FmgrInfo* flinfo, text* table)
+{
+	PB_TranslationTable* result = flinfo != NULL ? (PB_TranslationTable*) flinfo->fn_extra : NULL;
+	const uint8* amino_acids = (uint8*) VARDATA_ANY(table);
+	int i;
+
+	if (VARSIZE_ANY_EXHDR(table) != PB_N_CODONS)
+		ereport(ERROR, (errmsg("translation table has invalid size"),
+						errdetail("The length of the this translation table is %u.", (unsigned int) VARSIZE_ANY_EXHDR(table)),
+						errhint("A translation table must be of length 64.")));
+
+	if (result != NULL && memcmp(result->amino_acids, amino_acids, PB_N_CODONS) == 0)
+		return result;
+
+	for (i = 0; i < PB_N_CODONS; i++)
+		if (amino_acids[i] != PB_STOP_CODON &&
+			!(amino_acids[i] >= 'A' && amino_acids[i] <= 'Z') &&
+			!(amino_acids[i] >= 'a' && amino_acids[i] <= 'z'))
+			ereport(ERROR, (errmsg("translation table has invalid amino acid \"%c\" at position %d", amino_acids[i], i + 1),
+							errhint("A translation table must consist of letters and \"*\" for stop codons.")));
+
+	if (result == NULL)
+	{
+		if (flinfo != NULL)
+		{
+			result = MemoryContextAlloc(flinfo->fn_mcxt, sizeof(PB_TranslationTable));
+			flinfo->fn_extra = result;
+		}
+		else
+			result = palloc(sizeof(PB_TranslationTable));
+	}
+
+	memcpy(result->amino_acids, amino_acids, PB_N_CODONS);
+
+	return result;
+}
+
+/**
+ * translate_sequence()
+ * 		Translates a nucleotide sequence up to its first stop codon.
+ *
+ * 	Varlena* raw_seq : possibly toasted DNA or RNA sequence
+ * 	PB_TranslationTable* table : translation table
+ * 	uint8* output : space for sequence_length / 3 amino acids
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+uint32 translate_sequence(Varlena* raw_seq,
+						  const PB_TranslationTable* table,
+						  uint8* output,
+						  PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* header;
+	uint32 sequence_length;
+	uint32 n_codons;
+	uint32 n_amino_acids = 0;
+	int numbers[4];
+
+	PB_TRACE(errmsg("->translate_sequence()"));
+
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(raw_seq, 0, PB_COMPRESSED_SEQUENCE_PREFIX_SIZE - VARHDRSZ);
+	sequence_length = header->sequence_length;
+	n_codons = sequence_length / 3;
+
+	if (n_codons == 0)
+	{
+		/* nothing to translate */
+	}
+	else if (get_packed_code(header, fixed_codesets, numbers))
+	{
+		PB_CompressedSequence* seq = (PB_CompressedSequence*) PG_DETOAST_DATUM(raw_seq);
+		const PB_CompressionBuffer* stream = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(seq);
+		uint8 forward_map[PB_N_CODONS];
+		uint8 reverse_map[PB_N_CODONS];
+
+		PB_DEBUG1(errmsg("translate_sequence(): translates codon groups"));
+
+		get_codon_group_maps(table, numbers, forward_map, reverse_map);
+
+		while (n_amino_acids < n_codons)
+		{
+			const uint8 amino_acid = forward_map[get_codon_group(stream, (uint64) n_amino_acids * 6)];
+
+			if (amino_acid == PB_STOP_CODON)
+				break;
+
+			output[n_amino_acids++] = amino_acid;
+		}
+
+		if ((Pointer) seq != (Pointer) raw_seq)
+			pfree(seq);
+	}
+	else
+	{
+		PB_DetoastCursor* cursor = open_detoast_cursor(raw_seq);
+		uint8* window = palloc(Min(sequence_length, PB_TRANSLATION_WINDOW_SIZE));
+		uint32 start;
+		int codon = 0;
+		int invalid = 0;
+
+		for (start = 0; start < n_codons * 3; start += PB_TRANSLATION_WINDOW_SIZE)
+		{
+			const uint32 length = Min(n_codons * 3 - start, PB_TRANSLATION_WINDOW_SIZE);
+			uint32 i;
+
+			decode_from_cursor(cursor, window, start, length, fixed_codesets);
+
+			for (i = 0; i < length; i++)
+			{
+				const int number = NUCLEOTIDE_NUMBER(window[i]);
+
+				codon = ((codon << 2) | (number & 3)) & 63;
+				invalid = ((invalid << 1) | (number < 0)) & 7;
+
+				if (i % 3 == 2)
+				{
+					const uint8 amino_acid = invalid ? PB_UNKNOWN_AMINO_ACID : table->amino_acids[codon];
+
+					if (amino_acid == PB_STOP_CODON)
+						goto done;
+
+					output[n_amino_acids++] = amino_acid;
+				}
+			}
+		}
+
+done:
+		pfree(window);
+		close_detoast_cursor(cursor);
+	}
+
+	pfree(header);
+
+	PB_TRACE(errmsg("<-translate_sequence() exits with %u amino acids", n_amino_acids));
+
+	return n_amino_acids;
+}
+
+/**
+ * translate_six_frames()
+ * 		Translates all six reading frames of a nucleotide sequence,
+ * 		including stop codons.
+ *
+ * 	Varlena* raw_seq : possibly toasted DNA or RNA sequence
+ * 	PB_TranslationTable* table : translation table
+ * 	uint8** frames : six outputs of sequence_length / 3 + 1 bytes each
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+void translate_six_frames(Varlena* raw_seq,
+						  const PB_TranslationTable* table,
+						  uint8** frames,
+						  PB_CodeSet** fixed_codesets)
+{
+	PB_CompressedSequence* header;
+	uint32 sequence_length;
+	int numbers[4];
+	int frame;
+
+	PB_TRACE(errmsg("->translate_six_frames()"));
+
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(raw_seq, 0, PB_COMPRESSED_SEQUENCE_PREFIX_SIZE - VARHDRSZ);
+	sequence_length = header->sequence_length;
+
+	for (frame = 0; frame < 6; frame++)
+		frames[frame][sequence_length > frame % 3 ? (sequence_length - frame % 3) / 3 : 0] = '\0';
+
+	if (sequence_length < 3)
+	{
+		/* no codons */
+	}
+	else if (get_packed_code(header, fixed_codesets, numbers))
+	{
+		PB_CompressedSequence* seq = (PB_CompressedSequence*) PG_DETOAST_DATUM(raw_seq);
+		const PB_CompressionBuffer* stream = PB_COMPRESSED_SEQUENCE_STREAM_POINTER(seq);
+		uint8 forward_map[PB_N_CODONS];
+		uint8 reverse_map[PB_N_CODONS];
+
+		PB_DEBUG1(errmsg("translate_six_frames(): translates codon groups"));
+
+		get_codon_group_maps(table, numbers, forward_map, reverse_map);
+
+		/*
+		 * The codons of forward frame f are the codons of reverse frame
+		 * (sequence_length - f) % 3 read backwards.
+		 */
+		for (frame = 0; frame < 3 && frame + 3 <= sequence_length; frame++)
+		{
+			const uint32 n_codons = (sequence_length - frame) / 3;
+			uint8* forward = frames[frame];
+			uint8* reverse = frames[3 + (sequence_length - frame) % 3] + n_codons;
+			uint64 bit = (uint64) frame * 2;
+			uint32 i;
+
+			for (i = 0; i < n_codons; i++, bit += 6)
+			{
+				const uint8 group = get_codon_group(stream, bit);
+
+				forward[i] = forward_map[group];
+				*--reverse = reverse_map[group];
+			}
+		}
+
+		if ((Pointer) seq != (Pointer) raw_seq)
+			pfree(seq);
+	}
+	else
+	{
+		PB_DetoastCursor* cursor = open_detoast_cursor(raw_seq);
+		uint8* window = palloc(Min(sequence_length, PB_TRANSLATION_WINDOW_SIZE));
+		uint8* forward[3];
+		uint8* reverse[3];
+		int forward_frame = 0;
+		int reverse_frame = sequence_length % 3;
+		int codon = 0;
+		int reverse_codon = 0;
+		int invalid = 0;
+		uint32 start;
+
+		for (frame = 0; frame < 3; frame++)
+		{
+			forward[frame] = frames[frame];
+			reverse[frame] = frames[3 + frame] + (sequence_length - frame) / 3;
+		}
+
+		/*
+		 * The codon ending at position p belongs to forward frame
+		 * (p - 2) % 3 and, read as reverse complement, to reverse frame
+		 * (sequence_length - 1 - p) % 3, which is filled from its end.
+		 */
+		for (start = 0; start < sequence_length; start += PB_TRANSLATION_WINDOW_SIZE)
+		{
+			const uint32 length = Min(sequence_length - start, PB_TRANSLATION_WINDOW_SIZE);
+			uint32 i;
+
+			decode_from_cursor(cursor, window, start, length, fixed_codesets);
+
+			for (i = 0; i < length; i++)
+			{
+				const int number = NUCLEOTIDE_NUMBER(window[i]);
+
+				codon = ((codon << 2) | (number & 3)) & 63;
+				reverse_codon = (reverse_codon >> 2) | (COMPLEMENT_NUMBER(number & 3) << 4);
+				invalid = ((invalid << 1) | (number < 0)) & 7;
+
+				forward_frame = forward_frame == 2 ? 0 : forward_frame + 1;
+				reverse_frame = reverse_frame == 0 ? 2 : reverse_frame - 1;
+
+				if (start + i >= 2)
+				{
+					*forward[forward_frame]++ = invalid ? PB_UNKNOWN_AMINO_ACID : table->amino_acids[codon];
+					*--reverse[reverse_frame] = invalid ? PB_UNKNOWN_AMINO_ACID : table->amino_acids[reverse_codon];
+				}
+			}
+		}
+
+		pfree(window);
+		close_detoast_cursor(cursor);
+	}
+
+	pfree(header);
+
+	PB_TRACE(errmsg("<-translate_six_frames()"));
+}
@@ -0,0 +1,655 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/aggregates.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+
+#include "sequence/sequence.h"
+#include "sequence/functions.h"
+#include "sequence/compression.h"
+#include "sequence/codebook.h"
+#include "types/alphabet.h"
+#include "types/dna_sequence.h"
+#include "types/rna_sequence.h"
+#include "types/aa_sequence.h"
+#include "types/aligned_dna_sequence.h"
+#include "types/aligned_rna_sequence.h"
+#include "types/aligned_aa_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Aggregates over sequence columns. All of them can be computed in
+ * parallel: the states of the workers are combined at the end.
+ *
+ * sequence_composition_agg(), alphabet_union_agg() and codebook_agg()
+ * share their state, the number of occurrences of each symbol. It is
+ * passed between processes as a bytea. total_length_agg() simply sums up
+ * the lengths stored in the headers.
+ *
+ * sequence_concat_agg() concatenates sequences like string_agg() does for
+ * text. The sequences are decoded into one buffer, which is compressed
+ * once at the end, instead of compressing every intermediate result. It
+ * is not parallel: the order of the sequences matters.
+ */
+
+/**
+ * Transition state of sequence_composition_agg() and alphabet_union_agg().
+ * alphabet_union_agg() only distinguishes zero and non-zero entries.
+ */
+typedef struct
+{
+	uint64 frequencies[PB_SOURCE_ALPHABET_SIZE];
+} PB_CompositionAggState;
+
+/**
+ * Transition state of sequence_concat_agg(). Holds the decoded sequences
+ * and the input function of their type, which compresses them.
+ */
+typedef struct
+{
+	StringInfoData buffer;
+	PGFunction input_function;
+} PB_ConcatAggState;
+
+Datum composition_agg_transfn_dna(PG_FUNCTION_ARGS);
+Datum composition_agg_transfn_rna(PG_FUNCTION_ARGS);
+Datum composition_agg_transfn_aa(PG_FUNCTION_ARGS);
+Datum composition_agg_transfn_aligned_dna(PG_FUNCTION_ARGS);
+Datum composition_agg_transfn_aligned_rna(PG_FUNCTION_ARGS);
+Datum composition_agg_transfn_aligned_aa(PG_FUNCTION_ARGS);
+Datum alphabet_agg_transfn_dna(PG_FUNCTION_ARGS);
+Datum alphabet_agg_transfn_rna(PG_FUNCTION_ARGS);
+Datum alphabet_agg_transfn_aa(PG_FUNCTION_ARGS);
+Datum alphabet_agg_transfn_aligned_dna(PG_FUNCTION_ARGS);
+Datum alphabet_agg_transfn_aligned_rna(PG_FUNCTION_ARGS);
+Datum alphabet_agg_transfn_aligned_aa(PG_FUNCTION_ARGS);
+Datum composition_agg_combinefn(PG_FUNCTION_ARGS);
+Datum composition_agg_serialfn(PG_FUNCTION_ARGS);
+Datum composition_agg_deserialfn(PG_FUNCTION_ARGS);
+Datum composition_agg_finalfn(PG_FUNCTION_ARGS);
+Datum alphabet_agg_finalfn(PG_FUNCTION_ARGS);
+Datum codebook_agg_finalfn(PG_FUNCTION_ARGS);
+Datum total_length_agg_transfn(PG_FUNCTION_ARGS);
+Datum concat_agg_transfn_dna(PG_FUNCTION_ARGS);
+Datum concat_agg_transfn_rna(PG_FUNCTION_ARGS);
+Datum concat_agg_transfn_aa(PG_FUNCTION_ARGS);
+Datum concat_agg_transfn_aligned_dna(PG_FUNCTION_ARGS);
+Datum concat_agg_transfn_aligned_rna(PG_FUNCTION_ARGS);
+Datum concat_agg_transfn_aligned_aa(PG_FUNCTION_ARGS);
+Datum concat_agg_finalfn(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static PB_CompositionAggState* get_agg_state(FunctionCallInfo fcinfo);
+static Datum composition_agg_transfn(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+static Datum alphabet_agg_transfn(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+static Datum concat_agg_transfn(FunctionCallInfo fcinfo,
+								PGFunction input_function,
+								PB_CodeSet** fixed_codesets);
+
+/*
+ * local functions
+ */
+
+/**
+ * get_agg_state()
+ * 		Returns the state given as first argument or a new
+ * 		state allocated in the aggregate context.
+ */
+static PB_CompositionAggState* get_agg_state(FunctionCallInfo fcinfo)
+{
+	MemoryContext aggcontext;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		ereport(ERROR,(errmsg("aggregate function called in non-aggregate context")));
+
+	if (PG_ARGISNULL(0))
+		return (PB_CompositionAggState*) MemoryContextAllocZero(aggcontext, sizeof(PB_CompositionAggState));
+
+	return (PB_CompositionAggState*) PG_GETARG_POINTER(0);
+}
+
+/**
+ * composition_agg_transfn()
+ * 		Adds the composition of a sequence to the state.
+ *
+ * 	PB_CompositionAggState* state : state or NULL
+ * 	Varlena* seq : possibly toasted sequence or NULL
+ */
+static Datum composition_agg_transfn(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	PB_CompositionAggState* state;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+
+	state = get_agg_state(fcinfo);
+	sequence_composition((Varlena*) PG_GETARG_RAW_VARLENA_P(1), state->frequencies, fixed_codesets);
+
+	PG_RETURN_POINTER(state);
+}
+
+/**
+ * alphabet_agg_transfn()
+ * 		Adds the symbols of a sequence to the state.
+ *
+ * 	PB_CompositionAggState* state : state or NULL
+ * 	Varlena* seq : possibly toasted sequence or NULL
+ */
+static Datum alphabet_agg_transfn(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	PB_CompositionAggState* state;
+	bool symbol_set[PB_SOURCE_ALPHABET_SIZE];
+	int i;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+
+	state = get_agg_state(fcinfo);
+
+	memset(symbol_set, 0, sizeof(symbol_set));
+	sequence_alphabet((Varlena*) PG_GETARG_RAW_VARLENA_P(1), symbol_set, fixed_codesets);
+
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+		if (symbol_set[i])
+			state->frequencies[i] = 1;
+
+	PG_RETURN_POINTER(state);
+}
+
+/**
+ * concat_agg_transfn()
+ * 		Appends a decoded sequence to the state.
+ *
+ * 	PB_ConcatAggState* state : state or NULL
+ * 	Varlena* seq : possibly toasted sequence or NULL
+ */
+static Datum concat_agg_transfn(FunctionCallInfo fcinfo,
+								PGFunction input_function,
+								PB_CodeSet** fixed_codesets)
+{
+	PB_ConcatAggState* state;
+	PB_CompressedSequence* header;
+	MemoryContext aggcontext;
+	MemoryContext oldcontext;
+	Varlena* seq;
+	uint32 length;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		ereport(ERROR,(errmsg("aggregate function called in non-aggregate context")));
+
+	if (PG_ARGISNULL(0))
+	{
+		oldcontext = MemoryContextSwitchTo(aggcontext);
+		state = (PB_ConcatAggState*) palloc(sizeof(PB_ConcatAggState));
+		initStringInfo(&state->buffer);
+		state->input_function = input_function;
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else
+		state = (PB_ConcatAggState*) PG_GETARG_POINTER(0);
+
+	seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(1);
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(seq, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
+	length = header->sequence_length;
+	pfree(header);
+
+	enlargeStringInfo(&state->buffer, length);
+	decode(seq, (uint8*) state->buffer.data + state->buffer.len, 0, length, fixed_codesets);
+	state->buffer.len += length;
+	state->buffer.data[state->buffer.len] = '\0';
+
+	PG_RETURN_POINTER(state);
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * composition_agg_transfn_dna()
+ * 		Transition function of sequence_composition_agg(dna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_transfn_dna);
+Datum composition_agg_transfn_dna(PG_FUNCTION_ARGS)
+{
+	return composition_agg_transfn(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * composition_agg_transfn_rna()
+ * 		Transition function of sequence_composition_agg(rna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_transfn_rna);
+Datum composition_agg_transfn_rna(PG_FUNCTION_ARGS)
+{
+	return composition_agg_transfn(fcinfo, get_fixed_rna_codes());
+}
+
+/**
+ * composition_agg_transfn_aa()
+ * 		Transition function of sequence_composition_agg(aa_sequence).
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_transfn_aa);
+Datum composition_agg_transfn_aa(PG_FUNCTION_ARGS)
+{
+	return composition_agg_transfn(fcinfo, get_fixed_aa_codes());
+}
+
+/**
+ * composition_agg_transfn_aligned_dna()
+ * 		Transition function of sequence_composition_agg(aligned_dna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_transfn_aligned_dna);
+Datum composition_agg_transfn_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return composition_agg_transfn(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * composition_agg_transfn_aligned_rna()
+ * 		Transition function of sequence_composition_agg(aligned_rna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_transfn_aligned_rna);
+Datum composition_agg_transfn_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return composition_agg_transfn(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * composition_agg_transfn_aligned_aa()
+ * 		Transition function of sequence_composition_agg(aligned_aa_sequence).
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_transfn_aligned_aa);
+Datum composition_agg_transfn_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return composition_agg_transfn(fcinfo, get_fixed_aligned_aa_codes());
+}
+
+/**
+ * alphabet_agg_transfn_dna()
+ * 		Transition function of alphabet_union_agg(dna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (alphabet_agg_transfn_dna);
+Datum alphabet_agg_transfn_dna(PG_FUNCTION_ARGS)
+{
+	return alphabet_agg_transfn(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * alphabet_agg_transfn_rna()
+ * 		Transition function of alphabet_union_agg(rna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (alphabet_agg_transfn_rna);
+Datum alphabet_agg_transfn_rna(PG_FUNCTION_ARGS)
+{
+	return alphabet_agg_transfn(fcinfo, get_fixed_rna_codes());
+}
+
+/**
+ * alphabet_agg_transfn_aa()
+ * 		Transition function of alphabet_union_agg(aa_sequence).
+ */
+PG_FUNCTION_INFO_V1 (alphabet_agg_transfn_aa);
+Datum alphabet_agg_transfn_aa(PG_FUNCTION_ARGS)
+{
+	return alphabet_agg_transfn(fcinfo, get_fixed_aa_codes());
+}
+
+/**
+ * alphabet_agg_transfn_aligned_dna()
+ * 		Transition function of alphabet_union_agg(aligned_dna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (alphabet_agg_transfn_aligned_dna);
+Datum alphabet_agg_transfn_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return alphabet_agg_transfn(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * alphabet_agg_transfn_aligned_rna()
+ * 		Transition function of alphabet_union_agg(aligned_rna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (alphabet_agg_transfn_aligned_rna);
+Datum alphabet_agg_transfn_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return alphabet_agg_transfn(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * alphabet_agg_transfn_aligned_aa()
+ * 		Transition function of alphabet_union_agg(aligned_aa_sequence).
+ */
+PG_FUNCTION_INFO_V1 (alphabet_agg_transfn_aligned_aa);
+Datum alphabet_agg_transfn_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return alphabet_agg_transfn(fcinfo, get_fixed_aligned_aa_codes());
+}
+
+/**
+ * composition_agg_combinefn()
+ * 		Merges two states of parallel workers.
+ *
+ * 	PB_CompositionAggState* state1 : state or NULL
+ * 	PB_CompositionAggState* state2 : state or NULL
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_combinefn);
+Datum composition_agg_combinefn(PG_FUNCTION_ARGS)
+{
+	PB_CompositionAggState* state1;
+	PB_CompositionAggState* state2;
+	int i;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+
+	/*
+	 * The second state may not live in the aggregate context,
+	 * so it is added to a state of our own.
+	 */
+	state1 = get_agg_state(fcinfo);
+	state2 = (PB_CompositionAggState*) PG_GETARG_POINTER(1);
+
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+		state1->frequencies[i] += state2->frequencies[i];
+
+	PG_RETURN_POINTER(state1);
+}
+
+/**
+ * composition_agg_serialfn()
+ * 		Converts a state to bytea.
+ *
+ * 	PB_CompositionAggState* state : state
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_serialfn);
+Datum composition_agg_serialfn(PG_FUNCTION_ARGS)
+{
+	PB_CompositionAggState* state = (PB_CompositionAggState*) PG_GETARG_POINTER(0);
+	bytea* result = palloc(VARHDRSZ + sizeof(PB_CompositionAggState));
+
+	SET_VARSIZE(result, VARHDRSZ + sizeof(PB_CompositionAggState));
+	memcpy(VARDATA(result), state, sizeof(PB_CompositionAggState));
+
+	PG_RETURN_BYTEA_P(result);
+}
+
+/**
+ * composition_agg_deserialfn()
+ * 		Restores a state from bytea.
+ *
+ * 	bytea* input : serialized state
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_deserialfn);
+Datum composition_agg_deserialfn(PG_FUNCTION_ARGS)
+{
+	bytea* input = PG_GETARG_BYTEA_PP(0);
+	PB_CompositionAggState* result;
+
+	if (VARSIZE_ANY_EXHDR(input) != sizeof(PB_CompositionAggState))
+		ereport(ERROR,(errmsg("invalid serialized composition state")));
+
+	result = palloc(sizeof(PB_CompositionAggState));
+	memcpy(result, VARDATA_ANY(input), sizeof(PB_CompositionAggState));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * composition_agg_finalfn()
+ * 		Returns the composition as alphabet with probabilities.
+ *
+ * 	PB_CompositionAggState* state : state or NULL
+ */
+PG_FUNCTION_INFO_V1 (composition_agg_finalfn);
+Datum composition_agg_finalfn(PG_FUNCTION_ARGS)
+{
+	PB_CompositionAggState* state;
+	PB_Alphabet* result;
+	PB_Symbol* symbols;
+	PB_SymbolProbability* probabilities;
+	uint64 total = 0;
+	int n_symbols = 0;
+	int i;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	state = (PB_CompositionAggState*) PG_GETARG_POINTER(0);
+
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+	{
+		if (state->frequencies[i])
+		{
+			n_symbols++;
+			total += state->frequencies[i];
+		}
+	}
+
+	/* only empty sequences */
+	if (n_symbols == 0)
+		PG_RETURN_NULL();
+
+	PB_ALPHABET_CREATE_WITH_PROBABILITIES(result, n_symbols);
+
+	symbols = PB_ALPHABET_SYMBOL_POINTER(result);
+	probabilities = PB_ALPHABET_SYMBOL_PROBABILITY_POINTER(result);
+
+	n_symbols = 0;
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+	{
+		if (state->frequencies[i])
+		{
+			symbols[n_symbols] = i;
+			probabilities[n_symbols] = (PB_SymbolProbability) ((double) state->frequencies[i] / total);
+			n_symbols++;
+		}
+	}
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * codebook_agg_finalfn()
+ * 		Returns a codebook trained on the composition, to be registered
+ * 		with register_codebook().
+ *
+ * 	PB_CompositionAggState* state : state or NULL
+ */
+PG_FUNCTION_INFO_V1 (codebook_agg_finalfn);
+Datum codebook_agg_finalfn(PG_FUNCTION_ARGS)
+{
+	PB_CompositionAggState* state;
+	int i;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	state = (PB_CompositionAggState*) PG_GETARG_POINTER(0);
+
+	/* only empty sequences */
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+		if (state->frequencies[i])
+			break;
+	if (i == PB_SOURCE_ALPHABET_SIZE)
+		PG_RETURN_NULL();
+
+	PG_RETURN_BYTEA_P(build_codebook(state->frequencies));
+}
+
+/**
+ * alphabet_agg_finalfn()
+ * 		Returns the union of alphabets as alphabet without probabilities.
+ *
+ * 	PB_CompositionAggState* state : state or NULL
+ */
+PG_FUNCTION_INFO_V1 (alphabet_agg_finalfn);
+Datum alphabet_agg_finalfn(PG_FUNCTION_ARGS)
+{
+	PB_CompositionAggState* state;
+	PB_Alphabet* result;
+	PB_Symbol* symbols;
+	int n_symbols = 0;
+	int i;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	state = (PB_CompositionAggState*) PG_GETARG_POINTER(0);
+
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+		if (state->frequencies[i])
+			n_symbols++;
+
+	/* only empty sequences */
+	if (n_symbols == 0)
+		PG_RETURN_NULL();
+
+	PB_ALPHABET_CREATE_WITHOUT_PROBABILITIES(result, n_symbols);
+
+	symbols = PB_ALPHABET_SYMBOL_POINTER(result);
+
+	n_symbols = 0;
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+		if (state->frequencies[i])
+			symbols[n_symbols++] = i;
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * total_length_agg_transfn()
+ * 		Adds the length of a sequence of any type to the sum.
+ * 		Only the header of the sequence is read.
+ *
+ * 	int64 sum : sum of lengths so far
+ * 	Varlena* seq : possibly toasted sequence
+ */
+PG_FUNCTION_INFO_V1 (total_length_agg_transfn);
+Datum total_length_agg_transfn(PG_FUNCTION_ARGS)
+{
+	int64 sum = PG_GETARG_INT64(0);
+	PB_CompressedSequence* header = (PB_CompressedSequence*)
+			PG_DETOAST_DATUM_SLICE(PG_GETARG_RAW_VARLENA_P(1), 0, 4);
+
+	sum += header->sequence_length;
+
+	PG_RETURN_INT64(sum);
+}
+
+/**
+ * concat_agg_transfn_dna()
+ * 		Transition function of sequence_concat_agg(dna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (concat_agg_transfn_dna);
+Datum concat_agg_transfn_dna(PG_FUNCTION_ARGS)
+{
+	return concat_agg_transfn(fcinfo, dna_sequence_in, get_fixed_dna_codes());
+}
+
+/**
+ * concat_agg_transfn_rna()
+ * 		Transition function of sequence_concat_agg(rna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (concat_agg_transfn_rna);
+Datum concat_agg_transfn_rna(PG_FUNCTION_ARGS)
+{
+	return concat_agg_transfn(fcinfo, rna_sequence_in, get_fixed_rna_codes());
+}
+
+/**
+ * concat_agg_transfn_aa()
+ * 		Transition function of sequence_concat_agg(aa_sequence).
+ */
+PG_FUNCTION_INFO_V1 (concat_agg_transfn_aa);
+Datum concat_agg_transfn_aa(PG_FUNCTION_ARGS)
+{
+	return concat_agg_transfn(fcinfo, aa_sequence_in, get_fixed_aa_codes());
+}
+
+/**
+ * concat_agg_transfn_aligned_dna()
+ * 		Transition function of sequence_concat_agg(aligned_dna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (concat_agg_transfn_aligned_dna);
+Datum concat_agg_transfn_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return concat_agg_transfn(fcinfo, aligned_dna_sequence_in, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * concat_agg_transfn_aligned_rna()
+ * 		Transition function of sequence_concat_agg(aligned_rna_sequence).
+ */
+PG_FUNCTION_INFO_V1 (concat_agg_transfn_aligned_rna);
+Datum concat_agg_transfn_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return concat_agg_transfn(fcinfo, aligned_rna_sequence_in, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * concat_agg_transfn_aligned_aa()
+ * 		Transition function of sequence_concat_agg(aligned_aa_sequence).
+ */
+PG_FUNCTION_INFO_V1 (concat_agg_transfn_aligned_aa);
+Datum concat_agg_transfn_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return concat_agg_transfn(fcinfo, aligned_aa_sequence_in, get_fixed_aligned_aa_codes());
+}
+
+/**
+ * concat_agg_finalfn()
+ * 		Compresses the concatenated sequences with the input function
+ * 		of their type.
+ *
+ * 	PB_ConcatAggState* state : state or NULL
+ */
+PG_FUNCTION_INFO_V1 (concat_agg_finalfn);
+Datum concat_agg_finalfn(PG_FUNCTION_ARGS)
+{
+	PB_ConcatAggState* state;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	state = (PB_ConcatAggState*) PG_GETARG_POINTER(0);
+
+	return DirectFunctionCall3(state->input_function,
+							   CStringGetDatum(state->buffer.data),
+							   ObjectIdGetDatum(InvalidOid),
+							   Int32GetDatum(-1));
+}
@@ -24,6 +24,7 @@
 #include "sequence/code_set_creation.h"
 #include "sequence/compression.h"
 #include "sequence/functions.h"
+#include "sequence/transfer.h"
 #include "utils/debug.h"
 #include "types/alphabet.h"
 
@@ -147,7 +148,10 @@ PB_CodeSet* get_fixed_aligned_aa_code(unsigned int fixed_code_id)
  * get_fixed_aligned_aa_codes()
  * 		Returns pointer to fixed aligned AA codes.
  */
-PB_CodeSet** get_fixed_aligned_aa_codes(void);
+PB_CodeSet** get_fixed_aligned_aa_codes(void)
+{
+	return fixed_aligned_aa_codes;
+}
 
 /**
  * compress_aligned_aa_sequence()
@@ -260,6 +264,8 @@ Datum aligned_aa_sequence_typmod_in(PG_FUNCTION_ARGS)
 	bool typeModIupac = false;
 	bool typeModFlc = false;
 	bool typeModAscii = false;
+	bool typeModDefault = false;
+	bool typeModShort = false;
 
 	int i;
 
@@ -278,6 +284,10 @@ Datum aligned_aa_sequence_typmod_in(PG_FUNCTION_ARGS)
 			typeModIupac = true;
 		} else if (!strcmp(read_pointer, "ascii")) {
 			typeModAscii = true;
+		} else if (!strcmp(read_pointer, "default")) {
+			typeModDefault = true;
+		} else if (!strcmp(read_pointer, "short")) {
+			typeModShort = true;
 		} else {
 			ereport(ERROR,(errmsg("type modifier invalid"),
 					errdetail("Can not recognize type modifier \"%s\".", read_pointer)));
@@ -296,6 +306,10 @@ Datum aligned_aa_sequence_typmod_in(PG_FUNCTION_ARGS)
 		ereport(ERROR,(errmsg("IUPAC and ASCII are mutually exclusive type modifiers.")));
 	}
 
+	if (typeModDefault && typeModShort) {
+		ereport(ERROR,(errmsg("DEFAULT and SHORT are mutually exclusive type modifiers")));
+	}
+
 	/*
 	 * Build integer value from parsed type modifiers.
 	 */
@@ -311,6 +325,12 @@ Datum aligned_aa_sequence_typmod_in(PG_FUNCTION_ARGS)
 		result.restricting_alphabet = PB_ALIGNED_AA_TYPMOD_IUPAC;
 	}
 
+	if (typeModShort) {
+		result.compression_strategy = PB_ALIGNED_AA_TYPMOD_SHORT;
+	} else {
+		result.compression_strategy = PB_ALIGNED_AA_TYPMOD_DEFAULT;
+	}
+
 	PB_TRACE(errmsg("<-aa_sequence_typmod_in() returning %d", aligned_aa_sequence_typmod_to_int(result)));
 
 	PG_RETURN_INT32(aligned_aa_sequence_typmod_to_int(result));
@@ -341,6 +361,12 @@ Datum aligned_aa_sequence_typmod_out(PG_FUNCTION_ARGS)
 	}
 	len += 5; /* strlen('ASCII') = 5, strlen('IUPAC') = 5  */
 
+	if (typmod.compression_strategy == PB_ALIGNED_AA_TYPMOD_SHORT) {
+		len += 6; /* strlen('SHORT,') = 6 */
+	} else {
+		len += 8; /* strlen('DEFAULT,') = 8 */
+	}
+
 	result = palloc0(len);
 	out = result;
 
@@ -355,6 +381,14 @@ Datum aligned_aa_sequence_typmod_out(PG_FUNCTION_ARGS)
 		out+=17;
 	}
 
+	if (typmod.compression_strategy == PB_ALIGNED_AA_TYPMOD_SHORT) {
+		strcpy(out, "SHORT,");
+		out+=6;
+	} else {
+		strcpy(out, "DEFAULT,");
+		out+=8;
+	}
+
 	if (typmod.restricting_alphabet == PB_ALIGNED_AA_TYPMOD_ASCII) {
 		strcpy(out, "ASCII");
 		out+=5;
@@ -409,6 +443,8 @@ Datum aligned_aa_sequence_in (PG_FUNCTION_ARGS)
 	 * Determine sequence info collection mode.
 	 */
 	mode = 0;
+	if (typmod.compression_strategy == PB_ALIGNED_AA_TYPMOD_DEFAULT)
+		mode = PB_SEQUENCE_INFO_WITH_RLE;
 	if (typmod.case_sensitive == PB_ALIGNED_AA_TYPMOD_CASE_SENSITIVE)
 		mode |= PB_SEQUENCE_INFO_CASE_SENSITIVE;
 
@@ -452,6 +488,8 @@ Datum aligned_aa_sequence_in_varlena (PG_FUNCTION_ARGS)
 	 * Determine sequence info collection mode.
 	 */
 	mode = 0;
+	if (typmod.compression_strategy == PB_ALIGNED_AA_TYPMOD_DEFAULT)
+		mode = PB_SEQUENCE_INFO_WITH_RLE;
 	if (typmod.case_sensitive == PB_ALIGNED_AA_TYPMOD_CASE_SENSITIVE)
 		mode |= PB_SEQUENCE_INFO_CASE_SENSITIVE;
 
@@ -492,6 +530,8 @@ Datum aligned_aa_sequence_cast (PG_FUNCTION_ARGS)
 	 * Determine sequence info collection mode.
 	 */
 	mode = 0;
+	if (typmod.compression_strategy == PB_ALIGNED_AA_TYPMOD_DEFAULT)
+		mode = PB_SEQUENCE_INFO_WITH_RLE;
 	if (typmod.case_sensitive == PB_ALIGNED_AA_TYPMOD_CASE_SENSITIVE)
 		mode |= PB_SEQUENCE_INFO_CASE_SENSITIVE;
 
@@ -563,6 +603,60 @@ Datum aligned_aa_sequence_out_varlena (PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(result);
 }
 
+/**
+ * aligned_aa_sequence_send()
+ * 		Convert a sequence to its external binary representation,
+ * 		which holds the code and the compressed stream.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+PG_FUNCTION_INFO_V1 (aligned_aa_sequence_send);
+Datum aligned_aa_sequence_send (PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	bytea* result;
+
+	PB_TRACE(errmsg("->aligned_aa_sequence_send()"));
+
+	result = send_sequence(input, fixed_aligned_aa_codes);
+
+	PB_TRACE(errmsg("<-aligned_aa_sequence_send()"));
+
+	PG_RETURN_BYTEA_P(result);
+}
+
+/**
+ * aligned_aa_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ * 		The sequence is encoded with the received code, unless type
+ * 		modifiers are given.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+PG_FUNCTION_INFO_V1 (aligned_aa_sequence_recv);
+Datum aligned_aa_sequence_recv (PG_FUNCTION_ARGS)
+{
+	StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+	int32 typmod = PG_GETARG_INT32(2);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->aligned_aa_sequence_recv()"));
+
+	result = receive_sequence(buf, fixed_aligned_aa_codes, n_fixed_aligned_aa_codes);
+
+	if ((-1) != typmod)
+		result = (PB_CompressedSequence*)
+				 DatumGetPointer(DirectFunctionCall2(aligned_aa_sequence_cast,
+													 PointerGetDatum(result),
+													 Int32GetDatum(typmod)));
+
+	PB_TRACE(errmsg("<-aligned_aa_sequence_recv()"));
+
+	PG_RETURN_POINTER(result);
+}
+
 /**
  * aligned_aa_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -580,19 +674,20 @@ Datum aligned_aa_sequence_substring (PG_FUNCTION_ARGS) {
 	int start = PG_GETARG_DATUM(1);
 	int len = PG_GETARG_DATUM(2);
 
-	PB_CompressedSequence* input_header;
+	PB_DetoastCursor* cursor;
+	uint32 sequence_length;
 
 	text* result;
 
 	PB_TRACE(errmsg("->aligned_aa_sequence_substring()"));
 
-	input_header = (PB_CompressedSequence*)
-			PG_DETOAST_DATUM_SLICE(input, 0, sizeof(PB_CompressedSequence) - VARHDRSZ);
-
 	if (len < 0) {
 		ereport(ERROR,(errmsg("negative substring length not allowed")));
 	}
 
+	cursor = open_cached_detoast_cursor(fcinfo->flinfo, input);
+	sequence_length = cursor->header->sequence_length;
+
 	/*
 	 * SQL's first position is 1, our first position is 0
 	 */
@@ -601,20 +696,21 @@ Datum aligned_aa_sequence_substring (PG_FUNCTION_ARGS) {
 		len += start;
 		start = 0;
 	}
-	if (start >= input_header->sequence_length || len < 1) {
+	if (start >= sequence_length || len < 1) {
 		result = palloc0(4);
 		SET_VARSIZE (result, 4);
+		close_detoast_cursor(cursor);
 		PG_RETURN_POINTER(result);
 	}
-	if (start + len > input_header->sequence_length) {
-		len = input_header->sequence_length - start;
+	if (start + len > sequence_length) {
+		len = sequence_length - start;
 	}
 
 	result = palloc0(len + VARHDRSZ);
 	SET_VARSIZE (result, len + VARHDRSZ);
-	decompress_aligned_aa_sequence((PB_CompressedSequence*) input,(uint8*) VARDATA(result),start,len);
+	decode_from_cursor(cursor, (uint8*) VARDATA(result), start, len, fixed_aligned_aa_codes);
 
-	pfree(input_header);
+	close_detoast_cursor(cursor);
 
 	PB_TRACE(errmsg("<-aligned_aa_sequence_substring()"));
 
@@ -630,10 +726,12 @@ Datum aligned_aa_sequence_substring (PG_FUNCTION_ARGS) {
 PG_FUNCTION_INFO_V1 (aligned_aa_sequence_char_length);
 Datum aligned_aa_sequence_char_length (PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* seq = (PB_CompressedSequence*)
-			PG_DETOAST_DATUM_SLICE(PG_GETARG_RAW_VARLENA_P(0),0,4);
+	PB_DetoastCursor* cursor = open_cached_detoast_cursor(fcinfo->flinfo, (Varlena*) PG_GETARG_RAW_VARLENA_P(0));
+	const uint32 length = cursor->header->sequence_length;
+
+	close_detoast_cursor(cursor);
 
-	PG_RETURN_INT32(seq->sequence_length);
+	PG_RETURN_INT32(length);
 }
 
 /**
@@ -841,12 +939,12 @@ Datum compare_aligned_aa(PG_FUNCTION_ARGS)
  * hash_aligned_aa()
  * 		Returns a CRC32 for a aligned AA sequence.
  *
- * 	PB_CompressedSequence* seq1 : input sequence
+ * 	Varlena* seq1 : possibly toasted input sequence
  */
 PG_FUNCTION_INFO_V1 (hash_aligned_aa);
 Datum hash_aligned_aa(PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* seq1 = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
+	Varlena* seq1 = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
 	uint32 result;
 
 	PB_TRACE(errmsg("->hash_aligned_aa()"));
@@ -865,19 +963,49 @@ Datum hash_aligned_aa(PG_FUNCTION_ARGS)
 PG_FUNCTION_INFO_V1 (strpos_aligned_aa);
 Datum strpos_aligned_aa(PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* seq = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
-	text* search = (text*) PG_GETARG_VARLENA_P(1);
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* search = (text*) PG_GETARG_TEXT_PP(1);
 	uint32 result;
 
 	PB_TRACE(errmsg("->strpos_aligned_aa()"));
 
-	result = sequence_strpos(seq, search, fixed_aligned_aa_codes);
+	result = sequence_strpos(seq,
+							 (uint8*) VARDATA_ANY(search),
+							 VARSIZE_ANY_EXHDR(search),
+							 fcinfo->flinfo,
+							 fixed_aligned_aa_codes);
 
 	PB_TRACE(errmsg("<-strpos_aligned_aa()"));
 
 	PG_RETURN_UINT32(result);
 }
 
+/**
+ * strpos_aligned_aa_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+PG_FUNCTION_INFO_V1 (strpos_aligned_aa_seq);
+Datum strpos_aligned_aa_seq(PG_FUNCTION_ARGS)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	PB_CompressedSequence* search = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(1);
+	uint8* pattern;
+	uint32 result;
+
+	PB_TRACE(errmsg("->strpos_aligned_aa_seq()"));
+
+	pattern = palloc(search->sequence_length + 1);
+	decompress_aligned_aa_sequence(search, pattern, 0, search->sequence_length);
+
+	result = sequence_strpos(seq, pattern, search->sequence_length, fcinfo->flinfo, fixed_aligned_aa_codes);
+
+	pfree(pattern);
+
+	PB_TRACE(errmsg("<-strpos_aligned_aa_seq()"));
+
+	PG_RETURN_UINT32(result);
+}
+
 /**
  * octet_length_aligned_aa()
  * 		Returns byte size of datum.
@@ -887,3 +1015,91 @@ Datum octet_length_aligned_aa(PG_FUNCTION_ARGS)
 {
 	PG_RETURN_UINT32((uint32) toast_raw_datum_size((Datum) PG_GETARG_RAW_VARLENA_P(0)));
 }
+
+/**
+ * symbol_count_aligned_aa()
+ * 		Counts the occurrences of symbols in an aligned AA sequence.
+ *
+ * 	This function mimics the behaviour of the originals substr function
+ * 	for the optional range. The first position is 1.
+ *
+ * 	Varlena* input : compressed input sequence
+ * 	text* symbols : symbols to count
+ * 	int start : optional position to start from
+ * 	int len : optional number of characters to count
+ */
+PG_FUNCTION_INFO_V1 (symbol_count_aligned_aa);
+Datum symbol_count_aligned_aa(PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* symbols = PG_GETARG_TEXT_PP(1);
+	int start = PG_NARGS() > 2 ? PG_GETARG_INT32(2) : 1;
+	int len = PG_NARGS() > 2 ? PG_GETARG_INT32(3) : PB_MAX_COMPRESSED_SEQUENCE_SIZE;
+	uint32 result;
+
+	PB_TRACE(errmsg("->symbol_count_aligned_aa()"));
+
+	result = sequence_symbol_count(input,
+								   (uint8*) VARDATA_ANY(symbols),
+								   VARSIZE_ANY_EXHDR(symbols),
+								   start,
+								   len,
+								   NULL,
+								   fixed_aligned_aa_codes);
+
+	PB_TRACE(errmsg("<-symbol_count_aligned_aa() exits with %u", result));
+
+	PG_RETURN_INT64(result);
+}
+
+/**
+ * concat_aligned_aa()
+ * 		Concatenates two aligned AA sequences.
+ *
+ * 	Varlena* seq1 : first possibly toasted sequence
+ * 	Varlena* seq2 : second possibly toasted sequence
+ */
+PG_FUNCTION_INFO_V1 (concat_aligned_aa);
+Datum concat_aligned_aa(PG_FUNCTION_ARGS)
+{
+	Varlena* seq1 = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	Varlena* seq2 = (Varlena*) PG_GETARG_RAW_VARLENA_P(1);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->concat_aligned_aa()"));
+
+	result = sequence_concat(seq1, seq2, aligned_aa_sequence_in, fixed_aligned_aa_codes);
+
+	PB_TRACE(errmsg("<-concat_aligned_aa()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * overlay_aligned_aa()
+ * 		Replaces characters of a aligned AA sequence, like overlay() does
+ * 		for texts.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	text* replacement : new characters
+ * 	int start : first position to replace, the first position is 1
+ * 	int count : optional number of characters to replace, by default
+ * 				the length of the replacement
+ */
+PG_FUNCTION_INFO_V1 (overlay_aligned_aa);
+Datum overlay_aligned_aa(PG_FUNCTION_ARGS)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* replacement = PG_GETARG_TEXT_PP(1);
+	int start = PG_GETARG_INT32(2);
+	int count = PG_NARGS() > 3 ? PG_GETARG_INT32(3) : VARSIZE_ANY_EXHDR(replacement);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->overlay_aligned_aa()"));
+
+	result = sequence_overlay(seq, replacement, start, count, aligned_aa_sequence_in, fixed_aligned_aa_codes);
+
+	PB_TRACE(errmsg("<-overlay_aligned_aa()"));
+
+	PG_RETURN_POINTER(result);
+}
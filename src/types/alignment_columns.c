@@ -0,0 +1,226 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/alignment_columns.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+#include "utils/builtins.h"
+
+#include "sequence/sequence.h"
+#include "sequence/functions.h"
+#include "types/aligned_dna_sequence.h"
+#include "types/aligned_rna_sequence.h"
+#include "types/aligned_aa_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Columns of multiple sequence alignments.
+ *
+ * alignment_column() returns the symbol of a row at a column of the
+ * alignment, alignment_column_agg() collects the symbols of all rows at a
+ * column, e.g. to score its conservation. Only the part of each row
+ * holding the symbol is decoded, it is found through the index. Positions
+ * count from 1 like those of substr().
+ */
+
+Datum alignment_column_aligned_dna(PG_FUNCTION_ARGS);
+Datum alignment_column_aligned_rna(PG_FUNCTION_ARGS);
+Datum alignment_column_aligned_aa(PG_FUNCTION_ARGS);
+Datum alignment_column_agg_transfn_aligned_dna(PG_FUNCTION_ARGS);
+Datum alignment_column_agg_transfn_aligned_rna(PG_FUNCTION_ARGS);
+Datum alignment_column_agg_transfn_aligned_aa(PG_FUNCTION_ARGS);
+Datum alignment_column_agg_finalfn(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static uint8 get_column_symbol(Varlena* seq, int32 column, PB_CodeSet** fixed_codesets);
+static Datum alignment_column(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+static Datum alignment_column_agg_transfn(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+
+/*
+ * local functions
+ */
+
+/**
+ * get_column_symbol()
+ * 		Returns the symbol of a row at a column. Raises an error for
+ * 		columns outside of the row.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32 column : column, first is 1
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+static uint8 get_column_symbol(Varlena* seq, int32 column, PB_CodeSet** fixed_codesets)
+{
+	int symbol = -1;
+
+	if (column > 0)
+		symbol = sequence_symbol_at(seq, column - 1, fixed_codesets);
+
+	if (symbol < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("alignment column %d is out of range of the row", column)));
+
+	return (uint8) symbol;
+}
+
+/**
+ * alignment_column()
+ * 		Returns the symbol of an aligned sequence of any type at a column.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32 column : column, first is 1
+ */
+static Datum alignment_column(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	int32 column = PG_GETARG_INT32(1);
+	text* result;
+
+	PB_TRACE(errmsg("->alignment_column()"));
+
+	result = palloc(VARHDRSZ + 1);
+	SET_VARSIZE(result, VARHDRSZ + 1);
+	*((uint8*) VARDATA(result)) = get_column_symbol(seq, column, fixed_codesets);
+
+	PB_TRACE(errmsg("<-alignment_column()"));
+
+	PG_RETURN_TEXT_P(result);
+}
+
+/**
+ * alignment_column_agg_transfn()
+ * 		Appends the symbol of a row at a column to the state.
+ *
+ * 	StringInfo state : state or NULL
+ * 	Varlena* seq : possibly toasted sequence or NULL
+ * 	int32 column : column, first is 1, or NULL
+ */
+static Datum alignment_column_agg_transfn(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	StringInfo state;
+	MemoryContext aggcontext;
+	MemoryContext oldcontext;
+
+	if (PG_ARGISNULL(1) || PG_ARGISNULL(2))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		ereport(ERROR,(errmsg("aggregate function called in non-aggregate context")));
+
+	if (PG_ARGISNULL(0))
+	{
+		oldcontext = MemoryContextSwitchTo(aggcontext);
+		state = makeStringInfo();
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else
+		state = (StringInfo) PG_GETARG_POINTER(0);
+
+	appendStringInfoChar(state, (char) get_column_symbol((Varlena*) PG_GETARG_RAW_VARLENA_P(1),
+														 PG_GETARG_INT32(2),
+														 fixed_codesets));
+
+	PG_RETURN_POINTER(state);
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * alignment_column_aligned_dna()
+ * 		Returns the symbol of an aligned_dna_sequence at a column.
+ */
+PG_FUNCTION_INFO_V1 (alignment_column_aligned_dna);
+Datum alignment_column_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return alignment_column(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * alignment_column_aligned_rna()
+ * 		Returns the symbol of an aligned_rna_sequence at a column.
+ */
+PG_FUNCTION_INFO_V1 (alignment_column_aligned_rna);
+Datum alignment_column_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return alignment_column(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * alignment_column_aligned_aa()
+ * 		Returns the symbol of an aligned_aa_sequence at a column.
+ */
+PG_FUNCTION_INFO_V1 (alignment_column_aligned_aa);
+Datum alignment_column_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return alignment_column(fcinfo, get_fixed_aligned_aa_codes());
+}
+
+/**
+ * alignment_column_agg_transfn_aligned_dna()
+ * 		Transition function of alignment_column_agg(aligned_dna_sequence, int4).
+ */
+PG_FUNCTION_INFO_V1 (alignment_column_agg_transfn_aligned_dna);
+Datum alignment_column_agg_transfn_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return alignment_column_agg_transfn(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * alignment_column_agg_transfn_aligned_rna()
+ * 		Transition function of alignment_column_agg(aligned_rna_sequence, int4).
+ */
+PG_FUNCTION_INFO_V1 (alignment_column_agg_transfn_aligned_rna);
+Datum alignment_column_agg_transfn_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return alignment_column_agg_transfn(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * alignment_column_agg_transfn_aligned_aa()
+ * 		Transition function of alignment_column_agg(aligned_aa_sequence, int4).
+ */
+PG_FUNCTION_INFO_V1 (alignment_column_agg_transfn_aligned_aa);
+Datum alignment_column_agg_transfn_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return alignment_column_agg_transfn(fcinfo, get_fixed_aligned_aa_codes());
+}
+
+/**
+ * alignment_column_agg_finalfn()
+ * 		Returns the collected symbols as text.
+ *
+ * 	StringInfo state : state or NULL
+ */
+PG_FUNCTION_INFO_V1 (alignment_column_agg_finalfn);
+Datum alignment_column_agg_finalfn(PG_FUNCTION_ARGS)
+{
+	StringInfo state;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	state = (StringInfo) PG_GETARG_POINTER(0);
+
+	PG_RETURN_TEXT_P(cstring_to_text_with_len(state->data, state->len));
+}
@@ -14,10 +14,16 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
 
 #include "sequence/sequence.h"
+#include "sequence/codebook.h"
 #include "sequence/decompression_iteration.h"
+#include "sequence/functions.h"
 #include "sequence/stats.h"
+#include "sequence/translation.h"
+#include "types/dna_sequence.h"
 #include "types/rna_sequence.h"
 #include "types/aa_sequence.h"
 #include "utils/debug.h"
@@ -25,6 +31,158 @@
 Datum transcribe_dna(PG_FUNCTION_ARGS);
 Datum reverse_transcribe_rna(PG_FUNCTION_ARGS);
 Datum translate_rna(PG_FUNCTION_ARGS);
+Datum translate_dna(PG_FUNCTION_ARGS);
+Datum six_frame_translate_rna(PG_FUNCTION_ARGS);
+Datum six_frame_translate_dna(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static PB_CompressedSequence* compress_translation(uint8* amino_acids, int restricting_alphabet);
+static Datum translate_nucleotides(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+static Datum six_frame_translate_nucleotides(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+
+/*
+ * local functions
+ */
+
+/**
+ * compress_translation()
+ * 		Compress a null-terminated translation.
+ *
+ * 	uint8* amino_acids : translation
+ * 	int restricting_alphabet : PB_AA_TYPMOD_IUPAC or PB_AA_TYPMOD_ASCII
+ */
+static PB_CompressedSequence* compress_translation(uint8* amino_acids, int restricting_alphabet)
+{
+	PB_SequenceInfo* info = get_sequence_info_cstring(amino_acids, PB_SEQUENCE_INFO_CASE_INSENSITIVE | PB_SEQUENCE_INFO_WITHOUT_RLE);
+	PB_AaSequenceTypMod typmod;
+
+	memset(&typmod, 0, sizeof(PB_AaSequenceTypMod));
+	typmod.case_sensitive = PB_AA_TYPMOD_CASE_INSENSITIVE;
+	typmod.restricting_alphabet = restricting_alphabet;
+
+	return compress_aa_sequence(amino_acids, typmod, info);
+}
+
+/**
+ * translate_nucleotides()
+ * 		Translate a DNA or RNA sequence up to the first stop codon.
+ *
+ * 	Varlena* input : DNA or RNA sequence
+ * 	text* table_input : translation table
+ */
+static Datum translate_nucleotides(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	PB_TranslationTable* table = get_translation_table(fcinfo->flinfo, PG_GETARG_TEXT_PP(1));
+	PB_CompressedSequence* header;
+	PB_CompressedSequence* result;
+	uint8* raw_output;
+	uint32 n_amino_acids;
+
+	PB_TRACE(errmsg("->translate_nucleotides()"));
+
+	header = (PB_CompressedSequence*)
+			 PG_DETOAST_DATUM_SLICE(input, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
+	raw_output = palloc(header->sequence_length / 3 + 1);
+	pfree(header);
+
+	n_amino_acids = translate_sequence(input, table, raw_output, fixed_codesets);
+	raw_output[n_amino_acids] = '\0';
+
+	result = compress_translation(raw_output, PB_AA_TYPMOD_IUPAC);
+
+	pfree(raw_output);
+
+	PB_TRACE(errmsg("<-translate_nucleotides() exits with %u amino acids", n_amino_acids));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * six_frame_translate_nucleotides()
+ * 		Returns the next translated frame of a DNA or RNA sequence.
+ * 		All frames are translated in the first call.
+ *
+ * 	Varlena* input : DNA or RNA sequence
+ * 	text* table_input : translation table
+ */
+static Datum six_frame_translate_nucleotides(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	static const int frame_numbers[6] = {1, 2, 3, -1, -2, -3};
+	FuncCallContext* funcctx;
+	Datum* translations;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+		Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+		PB_TranslationTable* table;
+		PB_CompressedSequence* header;
+		uint8* frames[6];
+		int i;
+
+		PB_TRACE(errmsg("->six_frame_translate_nucleotides()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		/*
+		 * fn_extra holds the state of the set-returning function,
+		 * so the table is not cached.
+		 */
+		table = get_translation_table(NULL, PG_GETARG_TEXT_PP(1));
+
+		header = (PB_CompressedSequence*)
+				 PG_DETOAST_DATUM_SLICE(input, 0, PB_COMPRESSED_SEQUENCE_MAX_HEADER_SIZE - VARHDRSZ);
+		for (i = 0; i < 6; i++)
+			frames[i] = palloc(header->sequence_length / 3 + 1);
+		pfree(header);
+
+		translate_six_frames(input, table, frames, fixed_codesets);
+
+		translations = palloc(6 * sizeof(Datum));
+		for (i = 0; i < 6; i++)
+		{
+			translations[i] = PointerGetDatum(compress_translation(frames[i], PB_AA_TYPMOD_ASCII));
+			pfree(frames[i]);
+		}
+
+		funcctx->user_fctx = translations;
+		funcctx->max_calls = 6;
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	translations = (Datum*) funcctx->user_fctx;
+
+	if (funcctx->call_cntr < funcctx->max_calls)
+	{
+		Datum values[2];
+		bool nulls[2] = {false, false};
+
+		values[0] = Int32GetDatum(frame_numbers[funcctx->call_cntr]);
+		values[1] = translations[funcctx->call_cntr];
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	PB_TRACE(errmsg("<-six_frame_translate_nucleotides()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * public functions
+ */
 
 /**
  * transcribe_dna()
@@ -49,6 +207,12 @@ Datum transcribe_dna(PG_FUNCTION_ARGS)
 	result = palloc0(mem_size);
 	memcpy(result, input, mem_size);
 
+	/*
+	 * Codebooks are shared, so their codewords cannot be rewritten.
+	 */
+	if (PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(result))
+		result = encode_without_codebook(result, get_fixed_dna_codes());
+
 	if (result->is_fixed)
 	{
 		/*
@@ -143,6 +307,8 @@ Datum transcribe_dna(PG_FUNCTION_ARGS)
 		}
 	}
 
+	invalidate_sequence_crc32(result);
+
 	PB_TRACE(errmsg("<-transcribe_dna()"));
 
 	PG_RETURN_POINTER(result);
@@ -171,6 +337,12 @@ Datum reverse_transcribe_rna(PG_FUNCTION_ARGS)
 	result = palloc0(mem_size);
 	memcpy(result, input, mem_size);
 
+	/*
+	 * Codebooks are shared, so their codewords cannot be rewritten.
+	 */
+	if (PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(result))
+		result = encode_without_codebook(result, get_fixed_rna_codes());
+
 	if (result->is_fixed)
 	{
 		/*
@@ -265,6 +437,8 @@ Datum reverse_transcribe_rna(PG_FUNCTION_ARGS)
 		}
 	}
 
+	invalidate_sequence_crc32(result);
+
 	PB_TRACE(errmsg("<-reverse_transcribe_rna()"));
 
 	PG_RETURN_POINTER(result);
@@ -275,95 +449,64 @@ Datum reverse_transcribe_rna(PG_FUNCTION_ARGS)
  * 		Translate an RNA sequence to AA sequence.
  *
  * 	The translation table must be a 64 chars long text.
+ * 	Translation stops at the first stop codon.
  *
- * 	PB_CompressedSequence* input : RNA sequence
+ * 	Varlena* input : RNA sequence
  * 	text* table_input : translation table
  */
 PG_FUNCTION_INFO_V1 (translate_rna);
 Datum translate_rna(PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* input = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
-	text* table_input = (text*) PG_GETARG_VARLENA_P(1);
-
-	uint8* raw_output = palloc0(input->sequence_length / 3 + 1);
-
-	PB_CompressedSequence* result;
-
-	PB_TRACE(errmsg("->translate_rna()"));
-
-	if (VARSIZE(table_input) - VARHDRSZ != 64)
-		ereport(ERROR, (errmsg("translation table has invalid size"),
-						errdetail("The length of the this translation table is %u.", (VARSIZE(table_input) - VARHDRSZ)),
-						errhint("A translation table must be of length 64.")));
-
-	/*
-	 * Translate, write output as cstring
-	 */
-	{
-		uint8 c = 0;
-		int codon = 0;
-		int pos = 0;
-
-		uint8* output_pointer = raw_output;
-		uint8* transl_table = (uint8*) VARDATA(table_input);
-
-		PB_BEGIN_DECODE((Varlena*) input, 0, input->sequence_length, get_fixed_rna_codes(), (c)) {
-			codon *= 4;
-
-			switch (TO_UPPER(c)) {
-			case 'U':
-				break;
-			case 'C':
-				codon += 1;
-				break;
-			case 'A':
-				codon += 2;
-				break;
-			case 'G':
-				codon += 3;
-				break;
-			default:
-				codon = 64;
-			}
-
-			pos++;
-			if (pos % 3 == 0)
-			{
-				if (codon < 64)
-				{
-					uint8 out = transl_table[codon];
-					if (out == '*')
-						out = '\0';
-
-					*output_pointer = out;
-				}
-				else
-					*output_pointer = 'X';
-
-				output_pointer++;
-				codon = 0;
-			}
-
-			PB_DEBUG2(errmsg("pos:%d c:%c codon:%d", pos, c, codon));
-		} PB_END_DECODE
-
-		*output_pointer = '\0';
-	}
-
-	/*
-	 * Compress raw output
-	 */
-	{
-		PB_SequenceInfo* info = get_sequence_info_cstring(raw_output, PB_SEQUENCE_INFO_CASE_INSENSITIVE | PB_SEQUENCE_INFO_WITHOUT_RLE);
-		PB_AaSequenceTypMod typmod;
-
-		typmod.case_sensitive = PB_AA_TYPMOD_CASE_INSENSITIVE;
-		typmod.restricting_alphabet = PB_AA_TYPMOD_IUPAC;
+	return translate_nucleotides(fcinfo, get_fixed_rna_codes());
+}
 
-		result = compress_aa_sequence(raw_output, typmod, info);
-	}
+/**
+ * translate_dna()
+ * 		Translate a DNA sequence to AA sequence. The DNA is read
+ * 		as the coding strand, i.e. T is translated like U.
+ *
+ * 	The translation table must be a 64 chars long text.
+ * 	Translation stops at the first stop codon.
+ *
+ * 	Varlena* input : DNA sequence
+ * 	text* table_input : translation table
+ */
+PG_FUNCTION_INFO_V1 (translate_dna);
+Datum translate_dna(PG_FUNCTION_ARGS)
+{
+	return translate_nucleotides(fcinfo, get_fixed_dna_codes());
+}
 
-	PB_TRACE(errmsg("<-translate_rna()"));
+/**
+ * six_frame_translate_rna()
+ * 		Translate all six reading frames of an RNA sequence.
+ *
+ * 	Returns (frame int, translation aa_sequence) rows for the
+ * 	frames 1, 2, 3 and -1, -2, -3 of the reverse complement.
+ * 	Stop codons are kept as '*'.
+ *
+ * 	Varlena* input : RNA sequence
+ * 	text* table_input : translation table
+ */
+PG_FUNCTION_INFO_V1 (six_frame_translate_rna);
+Datum six_frame_translate_rna(PG_FUNCTION_ARGS)
+{
+	return six_frame_translate_nucleotides(fcinfo, get_fixed_rna_codes());
+}
 
-	PG_RETURN_POINTER(result);
+/**
+ * six_frame_translate_dna()
+ * 		Translate all six reading frames of a DNA sequence.
+ *
+ * 	Returns (frame int, translation aa_sequence) rows for the
+ * 	frames 1, 2, 3 and -1, -2, -3 of the reverse complement.
+ * 	Stop codons are kept as '*'.
+ *
+ * 	Varlena* input : DNA sequence
+ * 	text* table_input : translation table
+ */
+PG_FUNCTION_INFO_V1 (six_frame_translate_dna);
+Datum six_frame_translate_dna(PG_FUNCTION_ARGS)
+{
+	return six_frame_translate_nucleotides(fcinfo, get_fixed_dna_codes());
 }
@@ -0,0 +1,277 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/chunks.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
+#include "utils/builtins.h"
+
+#include "sequence/sequence.h"
+#include "sequence/compression.h"
+#include "types/dna_sequence.h"
+#include "types/rna_sequence.h"
+#include "types/aa_sequence.h"
+#include "types/aligned_dna_sequence.h"
+#include "types/aligned_rna_sequence.h"
+#include "types/aligned_aa_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Streaming output of long sequences.
+ *
+ * sequence_chunks() returns a sequence as rows of (position, chunk), where
+ * every chunk but the last one holds chunk_size characters. The sequence
+ * is never decoded as a whole. Instead, a window of whole chunks is
+ * decoded at a time. decode() resumes from the last index entry before
+ * the window, so it skips at most one index part. Windows span at least
+ * PB_INDEX_PART_SIZE characters, so small chunks do not decode the same
+ * index part over and over again. Memory is bounded by the window size,
+ * independent of the length of the sequence.
+ *
+ * The sequence is read through one detoast cursor for all calls. Values
+ * stored out of line are prefetched in growing slices, inline compressed
+ * values are decompressed once.
+ */
+
+/**
+ * State of a sequence being read, kept across calls of
+ * sequence_chunks().
+ */
+typedef struct {
+	PB_DetoastCursor* cursor;
+	PB_CodeSet** fixed_codesets;
+	uint32 sequence_length;
+	uint32 chunk_size;
+	uint32 position;
+	uint8* window;
+	uint32 window_size;
+	uint32 window_start;
+	uint32 window_length;
+} PB_ChunkReader;
+
+Datum sequence_chunks_dna(PG_FUNCTION_ARGS);
+Datum sequence_chunks_rna(PG_FUNCTION_ARGS);
+Datum sequence_chunks_aa(PG_FUNCTION_ARGS);
+Datum sequence_chunks_aligned_dna(PG_FUNCTION_ARGS);
+Datum sequence_chunks_aligned_rna(PG_FUNCTION_ARGS);
+Datum sequence_chunks_aligned_aa(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static PB_ChunkReader* open_chunk_reader(Varlena* raw_seq,
+										 int32 chunk_size,
+										 PB_CodeSet** fixed_codesets);
+static Datum sequence_chunks(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+
+/*
+ * local functions
+ */
+
+/**
+ * open_chunk_reader()
+ * 		Creates the state of sequence_chunks() in the current
+ * 		memory context.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	int32 chunk_size : characters per chunk
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+static PB_ChunkReader* open_chunk_reader(Varlena* raw_seq,
+										 int32 chunk_size,
+										 PB_CodeSet** fixed_codesets)
+{
+	PB_ChunkReader* reader;
+
+	if (chunk_size < 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("chunk size must be positive")));
+
+	reader = palloc0(sizeof(PB_ChunkReader));
+	reader->fixed_codesets = fixed_codesets;
+	reader->chunk_size = chunk_size;
+
+	reader->cursor = open_detoast_cursor(raw_seq);
+	reader->sequence_length = reader->cursor->header->sequence_length;
+
+	/*
+	 * Windows hold whole chunks and span at least one index part.
+	 */
+	if (reader->chunk_size >= PB_INDEX_PART_SIZE)
+		reader->window_size = reader->chunk_size;
+	else
+		reader->window_size = reader->chunk_size *
+							  ((PB_INDEX_PART_SIZE + reader->chunk_size - 1) / reader->chunk_size);
+
+	if (reader->window_size > reader->sequence_length)
+		reader->window_size = reader->sequence_length;
+
+	reader->window = palloc(reader->window_size + 1);
+
+	return reader;
+}
+
+/**
+ * sequence_chunks()
+ * 		Returns the next chunk of a sequence.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32 chunk_size : characters per chunk
+ */
+static Datum sequence_chunks(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	FuncCallContext* funcctx;
+	PB_ChunkReader* reader;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		PB_TRACE(errmsg("->sequence_chunks()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = open_chunk_reader((Varlena*) PG_GETARG_RAW_VARLENA_P(0),
+											   PG_GETARG_INT32(1),
+											   fixed_codesets);
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	reader = (PB_ChunkReader*) funcctx->user_fctx;
+
+	if (reader->position < reader->sequence_length)
+	{
+		Datum values[2];
+		bool nulls[2] = {false, false};
+		uint32 length;
+
+		if (reader->position >= reader->window_start + reader->window_length)
+		{
+			MemoryContext oldcontext;
+
+			reader->window_start = reader->position;
+			reader->window_length = Min(reader->window_size,
+										reader->sequence_length - reader->position);
+
+			/*
+			 * Data prefetched by the cursor must survive this call.
+			 */
+			oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+			decode_from_cursor(reader->cursor,
+							   reader->window,
+							   reader->window_start,
+							   reader->window_length,
+							   reader->fixed_codesets);
+			MemoryContextSwitchTo(oldcontext);
+
+			PB_DEBUG1(errmsg("sequence_chunks(): decoded window at %u of %u characters",
+							 reader->window_start, reader->window_length));
+		}
+
+		length = Min(reader->chunk_size, reader->sequence_length - reader->position);
+
+		values[0] = Int32GetDatum(reader->position + 1);
+		values[1] = PointerGetDatum(cstring_to_text_with_len(
+						(char*) reader->window + (reader->position - reader->window_start),
+						length));
+
+		reader->position += length;
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	PB_TRACE(errmsg("<-sequence_chunks()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * sequence_chunks_dna()
+ * 		Returns a dna_sequence as (position int, chunk text)
+ * 		rows of chunk_size characters. The first position is 1.
+ */
+PG_FUNCTION_INFO_V1 (sequence_chunks_dna);
+Datum sequence_chunks_dna(PG_FUNCTION_ARGS)
+{
+	return sequence_chunks(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * sequence_chunks_rna()
+ * 		Returns a rna_sequence as (position int, chunk text)
+ * 		rows of chunk_size characters. The first position is 1.
+ */
+PG_FUNCTION_INFO_V1 (sequence_chunks_rna);
+Datum sequence_chunks_rna(PG_FUNCTION_ARGS)
+{
+	return sequence_chunks(fcinfo, get_fixed_rna_codes());
+}
+
+/**
+ * sequence_chunks_aa()
+ * 		Returns an aa_sequence as (position int, chunk text)
+ * 		rows of chunk_size characters. The first position is 1.
+ */
+PG_FUNCTION_INFO_V1 (sequence_chunks_aa);
+Datum sequence_chunks_aa(PG_FUNCTION_ARGS)
+{
+	return sequence_chunks(fcinfo, get_fixed_aa_codes());
+}
+
+/**
+ * sequence_chunks_aligned_dna()
+ * 		Returns an aligned_dna_sequence as (position int, chunk text)
+ * 		rows of chunk_size characters. The first position is 1.
+ */
+PG_FUNCTION_INFO_V1 (sequence_chunks_aligned_dna);
+Datum sequence_chunks_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return sequence_chunks(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * sequence_chunks_aligned_rna()
+ * 		Returns an aligned_rna_sequence as (position int, chunk text)
+ * 		rows of chunk_size characters. The first position is 1.
+ */
+PG_FUNCTION_INFO_V1 (sequence_chunks_aligned_rna);
+Datum sequence_chunks_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return sequence_chunks(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * sequence_chunks_aligned_aa()
+ * 		Returns an aligned_aa_sequence as (position int, chunk text)
+ * 		rows of chunk_size characters. The first position is 1.
+ */
+PG_FUNCTION_INFO_V1 (sequence_chunks_aligned_aa);
+Datum sequence_chunks_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return sequence_chunks(fcinfo, get_fixed_aligned_aa_codes());
+}
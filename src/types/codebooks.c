@@ -0,0 +1,147 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/codebooks.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "sequence/sequence.h"
+#include "sequence/codebook.h"
+#include "types/dna_sequence.h"
+#include "types/rna_sequence.h"
+#include "types/aa_sequence.h"
+#include "types/aligned_dna_sequence.h"
+#include "types/aligned_rna_sequence.h"
+#include "types/aligned_aa_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Compression with shared codebooks.
+ *
+ * codebook_compress() encodes a sequence with a codebook of the table
+ * postbis_codebook. Sequences with symbols the codebook does not contain
+ * are returned unchanged, so a codebook trained on a sample can be applied
+ * to a whole column.
+ */
+
+Datum codebook_compress_dna(PG_FUNCTION_ARGS);
+Datum codebook_compress_rna(PG_FUNCTION_ARGS);
+Datum codebook_compress_aa(PG_FUNCTION_ARGS);
+Datum codebook_compress_aligned_dna(PG_FUNCTION_ARGS);
+Datum codebook_compress_aligned_rna(PG_FUNCTION_ARGS);
+Datum codebook_compress_aligned_aa(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static Datum codebook_compress(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+
+/*
+ * local functions
+ */
+
+/**
+ * codebook_compress()
+ * 		Encodes a sequence of any type with a codebook.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32 id : id of the codebook
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+static Datum codebook_compress(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	int32 id = PG_GETARG_INT32(1);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->codebook_compress()"));
+
+	if (id <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid codebook id %d", id)));
+
+	result = encode_with_codebook(input, (uint32) id, fixed_codesets);
+
+	PB_TRACE(errmsg("<-codebook_compress()"));
+
+	if (result == NULL)
+		PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * codebook_compress_dna()
+ * 		Encodes a dna_sequence with a codebook.
+ */
+PG_FUNCTION_INFO_V1 (codebook_compress_dna);
+Datum codebook_compress_dna(PG_FUNCTION_ARGS)
+{
+	return codebook_compress(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * codebook_compress_rna()
+ * 		Encodes a rna_sequence with a codebook.
+ */
+PG_FUNCTION_INFO_V1 (codebook_compress_rna);
+Datum codebook_compress_rna(PG_FUNCTION_ARGS)
+{
+	return codebook_compress(fcinfo, get_fixed_rna_codes());
+}
+
+/**
+ * codebook_compress_aa()
+ * 		Encodes an aa_sequence with a codebook.
+ */
+PG_FUNCTION_INFO_V1 (codebook_compress_aa);
+Datum codebook_compress_aa(PG_FUNCTION_ARGS)
+{
+	return codebook_compress(fcinfo, get_fixed_aa_codes());
+}
+
+/**
+ * codebook_compress_aligned_dna()
+ * 		Encodes an aligned_dna_sequence with a codebook.
+ */
+PG_FUNCTION_INFO_V1 (codebook_compress_aligned_dna);
+Datum codebook_compress_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return codebook_compress(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * codebook_compress_aligned_rna()
+ * 		Encodes an aligned_rna_sequence with a codebook.
+ */
+PG_FUNCTION_INFO_V1 (codebook_compress_aligned_rna);
+Datum codebook_compress_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return codebook_compress(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * codebook_compress_aligned_aa()
+ * 		Encodes an aligned_aa_sequence with a codebook.
+ */
+PG_FUNCTION_INFO_V1 (codebook_compress_aligned_aa);
+Datum codebook_compress_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return codebook_compress(fcinfo, get_fixed_aligned_aa_codes());
+}
@@ -0,0 +1,542 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/dna_delta.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/tuptoaster.h"
+#include "catalog/pg_type.h"
+#include "commands/extension.h"
+#include "executor/spi.h"
+#include "lib/stringinfo.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+
+#include "sequence/sequence.h"
+#include "sequence/stats.h"
+#include "sequence/delta.h"
+#include "sequence/functions.h"
+#include "types/dna_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Type dna_delta stores a DNA sequence as edits against a reference
+ * sequence of the table postbis_reference. Near-identical sequences,
+ * e.g. strains of the same species, take a few bytes per difference.
+ *
+ * The text representation is the edit list itself, so input and output
+ * do not need the reference:
+ *
+ * 	<reference id>:<reference CRC32>:<reference length>[;<position>,<deleted>,<inserted>]*
+ *
+ * Positions are those of the reference, the first one is 1. Windows of
+ * the sequence are decoded from the covered part of the reference only.
+ * The reference is looked up once per function call site and checked
+ * against the stored CRC32, so changing a reference row is detected.
+ */
+
+#define PB_REFERENCE_TABLE		"postbis_reference"
+
+#define PB_DELTA_FIELD_SEPARATOR	':'
+#define PB_DELTA_EDIT_SEPARATOR		';'
+#define PB_DELTA_VALUE_SEPARATOR	','
+
+/**
+ * A reference sequence cached in fn_extra.
+ */
+typedef struct {
+	int32 id;
+	char* name;
+	uint32 crc32;
+	uint32 length;
+	Varlena* sequence;
+} PB_ReferenceSequence;
+
+Datum dna_delta_in(PG_FUNCTION_ARGS);
+Datum dna_delta_out(PG_FUNCTION_ARGS);
+Datum delta_compress_dna(PG_FUNCTION_ARGS);
+Datum dna_delta_to_dna_sequence(PG_FUNCTION_ARGS);
+Datum dna_delta_substring(PG_FUNCTION_ARGS);
+Datum dna_delta_char_length(PG_FUNCTION_ARGS);
+Datum dna_delta_compression_ratio(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static uint32 parse_number(char** input, int base, char separator);
+static PB_ReferenceSequence* get_reference(FunctionCallInfo fcinfo, int32 id, text* name);
+static void check_reference(const PB_DeltaSequence* delta, const PB_ReferenceSequence* reference);
+
+/*
+ * local functions
+ */
+
+/*
+ * parse_number()
+ * 		Parse an unsigned number followed by a separator and move
+ * 		the input behind the separator. The end of the input may
+ * 		take the place of an edit separator.
+ */
+static uint32 parse_number(char** input, int base, char separator)
+{
+	char* end;
+	unsigned long result;
+
+	if (!isxdigit((unsigned char) **input))
+		goto error;
+
+	errno = 0;
+	result = strtoul(*input, &end, base);
+
+	if (errno != 0 || end == *input || result > PG_UINT32_MAX)
+		goto error;
+
+	if (*end != separator && !(*end == '\0' && separator == PB_DELTA_EDIT_SEPARATOR))
+		goto error;
+
+	*input = *end == '\0' ? end : end + 1;
+
+	return (uint32) result;
+
+error:
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+			 errmsg("invalid input syntax for type dna_delta at \"%s\"", *input)));
+
+	return 0;
+}
+
+/*
+ * get_reference()
+ * 		Look up a reference sequence by id or, if given, by name. The
+ * 		last reference is cached in fn_extra. Only the possibly toasted
+ * 		datum is copied, windows are detoasted on demand.
+ */
+static PB_ReferenceSequence* get_reference(FunctionCallInfo fcinfo, int32 id, text* name)
+{
+	PB_ReferenceSequence* reference = (PB_ReferenceSequence*) fcinfo->flinfo->fn_extra;
+	char* name_cstring = name != NULL ? text_to_cstring(name) : NULL;
+	char* table;
+	Oid extension;
+	Oid argtypes[1];
+	Datum values[1];
+	Datum sequence;
+	Varlena* sequence_copy;
+	PB_CompressedSequence* header;
+	bool isnull;
+	Size size;
+	int ret;
+
+	if (reference == NULL)
+	{
+		reference = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(PB_ReferenceSequence));
+		fcinfo->flinfo->fn_extra = reference;
+	}
+	else if (reference->sequence != NULL)
+	{
+		if (name_cstring == NULL && reference->id == id)
+			return reference;
+		if (name_cstring != NULL && strcmp(reference->name, name_cstring) == 0)
+			return reference;
+
+		pfree(reference->name);
+		pfree(reference->sequence);
+		reference->name = NULL;
+		reference->sequence = NULL;
+	}
+
+	/*
+	 * The extension is relocatable, so the table is qualified with
+	 * the schema of the extension.
+	 */
+	extension = get_extension_oid("postbis", false);
+	table = quote_qualified_identifier(get_namespace_name(get_extension_schema(extension)),
+									   PB_REFERENCE_TABLE);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	if (name_cstring != NULL)
+	{
+		argtypes[0] = TEXTOID;
+		values[0] = PointerGetDatum(name);
+		ret = SPI_execute_with_args(psprintf("SELECT id, name, sequence FROM %s WHERE name = $1", table),
+									1, argtypes, values, NULL, true, 1);
+	}
+	else
+	{
+		argtypes[0] = INT4OID;
+		values[0] = Int32GetDatum(id);
+		ret = SPI_execute_with_args(psprintf("SELECT id, name, sequence FROM %s WHERE id = $1", table),
+									1, argtypes, values, NULL, true, 1);
+	}
+
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "SPI_execute_with_args returned %d", ret);
+
+	if (SPI_processed != 1)
+	{
+		if (name_cstring != NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_OBJECT),
+					 errmsg("reference sequence \"%s\" does not exist", name_cstring)));
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_OBJECT),
+					 errmsg("reference sequence %d does not exist", id)));
+	}
+
+	reference->id = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull));
+	reference->name = MemoryContextStrdup(fcinfo->flinfo->fn_mcxt,
+										  SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 2));
+
+	sequence = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 3, &isnull);
+	size = VARSIZE_ANY(DatumGetPointer(sequence));
+	sequence_copy = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, size);
+	memcpy(sequence_copy, DatumGetPointer(sequence), size);
+
+	SPI_finish();
+
+	header = (PB_CompressedSequence*) PG_DETOAST_DATUM_SLICE(sequence_copy, 0, 4);
+	reference->length = header->sequence_length;
+	reference->crc32 = sequence_crc32(sequence_copy, get_fixed_dna_codes());
+	reference->sequence = sequence_copy;
+
+	PB_DEBUG1(errmsg("get_reference(): id=%d length=%u crc32=%08x", reference->id, reference->length, reference->crc32));
+
+	return reference;
+}
+
+/*
+ * check_reference()
+ * 		Make sure a delta sequence was created against this reference.
+ */
+static void check_reference(const PB_DeltaSequence* delta, const PB_ReferenceSequence* reference)
+{
+	if (delta->reference_crc32 != reference->crc32 || delta->reference_length != reference->length)
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("reference sequence %d has changed since the delta sequence was created",
+						delta->reference_id)));
+	}
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * dna_delta_in()
+ * 		Read the text representation of the edits.
+ *
+ * 	cstring input : text representation
+ */
+PG_FUNCTION_INFO_V1 (dna_delta_in);
+Datum dna_delta_in(PG_FUNCTION_ARGS)
+{
+	char* input = PG_GETARG_CSTRING(0);
+	StringInfoData edits;
+	StringInfoData inserted;
+	PB_DeltaSequence* result;
+	uint32 result_size;
+	uint32 reference_id;
+	uint32 reference_crc32;
+	uint32 reference_length;
+	uint64 reference_end = 0;
+	uint64 sequence_end = 0;
+
+	PB_TRACE(errmsg("->dna_delta_in()"));
+
+	reference_id = parse_number(&input, 10, PB_DELTA_FIELD_SEPARATOR);
+	reference_crc32 = parse_number(&input, 16, PB_DELTA_FIELD_SEPARATOR);
+	reference_length = parse_number(&input, 10, PB_DELTA_EDIT_SEPARATOR);
+
+	if (reference_id > PG_INT32_MAX)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				 errmsg("reference id %u out of range", reference_id)));
+
+	initStringInfo(&edits);
+	initStringInfo(&inserted);
+
+	while (*input != '\0')
+	{
+		PB_DeltaEdit edit;
+		char* end;
+		uint32 position;
+
+		position = parse_number(&input, 10, PB_DELTA_VALUE_SEPARATOR);
+		edit.deleted_length = parse_number(&input, 10, PB_DELTA_VALUE_SEPARATOR);
+
+		end = strchr(input, PB_DELTA_EDIT_SEPARATOR);
+		if (end == NULL)
+			end = input + strlen(input);
+
+		if (position < 1 || position - 1 < reference_end ||
+			(uint64) position - 1 + edit.deleted_length > reference_length)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					 errmsg("edits of dna_delta must be ordered and within the reference")));
+
+		edit.reference_position = position - 1;
+		edit.sequence_position = sequence_end + (edit.reference_position - reference_end);
+		edit.inserted_length = end - input;
+		edit.inserted_offset = inserted.len;
+
+		reference_end = (uint64) edit.reference_position + edit.deleted_length;
+		sequence_end = (uint64) edit.sequence_position + edit.inserted_length;
+
+		if (sequence_end + (reference_length - reference_end) > PG_INT32_MAX)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("dna_delta sequences are limited to %d characters", PG_INT32_MAX)));
+
+		appendBinaryStringInfo(&edits, (char*) &edit, sizeof(PB_DeltaEdit));
+		appendBinaryStringInfo(&inserted, input, edit.inserted_length);
+
+		input = *end == '\0' ? end : end + 1;
+	}
+
+	result_size = sizeof(PB_DeltaSequence) + edits.len + inserted.len;
+	result = palloc0(result_size);
+	SET_VARSIZE(result, result_size);
+
+	result->sequence_length = sequence_end + (reference_length - reference_end);
+	result->reference_length = reference_length;
+	result->reference_id = reference_id;
+	result->reference_crc32 = reference_crc32;
+	result->n_edits = edits.len / sizeof(PB_DeltaEdit);
+
+	memcpy(PB_DELTA_SEQUENCE_EDIT_POINTER(result), edits.data, edits.len);
+	memcpy(PB_DELTA_SEQUENCE_INSERTED_POINTER(result), inserted.data, inserted.len);
+
+	pfree(edits.data);
+	pfree(inserted.data);
+
+	PB_TRACE(errmsg("<-dna_delta_in()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * dna_delta_out()
+ * 		Write the text representation of the edits.
+ *
+ * 	PB_DeltaSequence* input : delta sequence
+ */
+PG_FUNCTION_INFO_V1 (dna_delta_out);
+Datum dna_delta_out(PG_FUNCTION_ARGS)
+{
+	PB_DeltaSequence* input = (PB_DeltaSequence*) PG_GETARG_VARLENA_P(0);
+	const PB_DeltaEdit* edits = PB_DELTA_SEQUENCE_EDIT_POINTER(input);
+	const uint8* inserted = PB_DELTA_SEQUENCE_INSERTED_POINTER(input);
+	StringInfoData result;
+	uint32 i;
+
+	PB_TRACE(errmsg("->dna_delta_out()"));
+
+	initStringInfo(&result);
+	appendStringInfo(&result, "%d%c%08x%c%u",
+					 input->reference_id, PB_DELTA_FIELD_SEPARATOR,
+					 input->reference_crc32, PB_DELTA_FIELD_SEPARATOR,
+					 input->reference_length);
+
+	for (i = 0; i < input->n_edits; i++)
+	{
+		appendStringInfo(&result, "%c%u%c%u%c",
+						 PB_DELTA_EDIT_SEPARATOR, edits[i].reference_position + 1,
+						 PB_DELTA_VALUE_SEPARATOR, edits[i].deleted_length,
+						 PB_DELTA_VALUE_SEPARATOR);
+		appendBinaryStringInfo(&result,
+							   (const char*) inserted + edits[i].inserted_offset,
+							   edits[i].inserted_length);
+	}
+
+	PB_TRACE(errmsg("<-dna_delta_out()"));
+
+	PG_RETURN_CSTRING(result.data);
+}
+
+/**
+ * delta_compress_dna()
+ * 		Store a sequence as edits against a reference.
+ *
+ * 	PB_CompressedSequence* input : compressed input sequence
+ * 	text* name : name of the reference sequence
+ */
+PG_FUNCTION_INFO_V1 (delta_compress_dna);
+Datum delta_compress_dna(PG_FUNCTION_ARGS)
+{
+	PB_CompressedSequence* input = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
+	text* name = PG_GETARG_TEXT_PP(1);
+	PB_ReferenceSequence* reference;
+	PB_DeltaSequence* result;
+	uint8* plain_input;
+	uint8* plain_reference;
+
+	PB_TRACE(errmsg("->delta_compress_dna()"));
+
+	reference = get_reference(fcinfo, 0, name);
+
+	plain_input = palloc(input->sequence_length + 1);
+	decompress_dna_sequence(input, plain_input, 0, input->sequence_length);
+
+	plain_reference = palloc(reference->length + 1);
+	decompress_dna_sequence((PB_CompressedSequence*) reference->sequence, plain_reference, 0, reference->length);
+
+	result = delta_encode(plain_reference, reference->length, plain_input, input->sequence_length);
+	result->reference_id = reference->id;
+	result->reference_crc32 = reference->crc32;
+
+	if (memchr(PB_DELTA_SEQUENCE_INSERTED_POINTER(result), PB_DELTA_EDIT_SEPARATOR,
+			   VARSIZE(result) - (PB_DELTA_SEQUENCE_INSERTED_POINTER(result) - (uint8*) result)) != NULL)
+		ereport(ERROR,
+				(errmsg("sequences with '%c' differing from the reference cannot be delta compressed",
+						PB_DELTA_EDIT_SEPARATOR)));
+
+	pfree(plain_input);
+	pfree(plain_reference);
+
+	PB_TRACE(errmsg("<-delta_compress_dna()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * dna_delta_to_dna_sequence()
+ * 		Restore a delta sequence as dna_sequence.
+ *
+ * 	PB_DeltaSequence* input : delta sequence
+ */
+PG_FUNCTION_INFO_V1 (dna_delta_to_dna_sequence);
+Datum dna_delta_to_dna_sequence(PG_FUNCTION_ARGS)
+{
+	PB_DeltaSequence* input = (PB_DeltaSequence*) PG_GETARG_VARLENA_P(0);
+	PB_ReferenceSequence* reference;
+	PB_SequenceInfo* info;
+	PB_CompressedSequence* result;
+	uint8* plain;
+
+	PB_TRACE(errmsg("->dna_delta_to_dna_sequence()"));
+
+	reference = get_reference(fcinfo, input->reference_id, NULL);
+	check_reference(input, reference);
+
+	plain = palloc(input->sequence_length + 1);
+	delta_decode(input, reference->sequence, plain, 0, input->sequence_length, get_fixed_dna_codes());
+	plain[input->sequence_length] = '\0';
+
+	info = get_sequence_info_cstring(plain, PB_SEQUENCE_INFO_CASE_SENSITIVE);
+	result = compress_dna_sequence(plain, non_restricting_dna_typmod, info);
+
+	PB_SEQUENCE_INFO_PFREE(info);
+	pfree(plain);
+
+	PB_TRACE(errmsg("<-dna_delta_to_dna_sequence()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * dna_delta_substring()
+ * 		Decode a substring of a delta sequence.
+ *
+ * 	This function mimics the behaviour of the originals substr function.
+ * 	The first position is 1.
+ *
+ * 	PB_DeltaSequence* input : delta sequence
+ * 	int start : position to start from
+ * 	int len : length of substring
+ */
+PG_FUNCTION_INFO_V1 (dna_delta_substring);
+Datum dna_delta_substring(PG_FUNCTION_ARGS)
+{
+	PB_DeltaSequence* input = (PB_DeltaSequence*) PG_GETARG_VARLENA_P(0);
+	int start = PG_GETARG_INT32(1);
+	int len = PG_GETARG_INT32(2);
+	PB_ReferenceSequence* reference;
+	text* result;
+
+	PB_TRACE(errmsg("->dna_delta_substring()"));
+
+	if (len < 0) {
+		ereport(ERROR,(errmsg("negative substring length not allowed")));
+	}
+
+	/*
+	 * SQL's first position is 1, our first position is 0
+	 */
+	start--;
+	if (start < 0) {
+		len += start;
+		start = 0;
+	}
+	if (start >= input->sequence_length || len < 1) {
+		result = palloc0(VARHDRSZ);
+		SET_VARSIZE (result, VARHDRSZ);
+		PG_RETURN_POINTER(result);
+	}
+	if (start + len > input->sequence_length) {
+		len = input->sequence_length - start;
+	}
+
+	reference = get_reference(fcinfo, input->reference_id, NULL);
+	check_reference(input, reference);
+
+	result = palloc0(len + VARHDRSZ);
+	SET_VARSIZE (result, len + VARHDRSZ);
+	delta_decode(input, reference->sequence, (uint8*) VARDATA(result), start, len, get_fixed_dna_codes());
+
+	PB_TRACE(errmsg("<-dna_delta_substring()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * dna_delta_char_length()
+ * 		Get length of a delta sequence.
+ *
+ * 	PB_DeltaSequence* input : delta sequence
+ */
+PG_FUNCTION_INFO_V1 (dna_delta_char_length);
+Datum dna_delta_char_length(PG_FUNCTION_ARGS)
+{
+	PB_DeltaSequence* input = (PB_DeltaSequence*)
+			PG_DETOAST_DATUM_SLICE(PG_GETARG_RAW_VARLENA_P(0), 0, 4);
+
+	PG_RETURN_INT32(input->sequence_length);
+}
+
+/**
+ * dna_delta_compression_ratio()
+ * 		Get compression ratio, the size of a delta sequence divided
+ * 		by the size of the sequence as pgsql text type. The reference
+ * 		is not included.
+ *
+ * 	PB_DeltaSequence* input : delta sequence
+ */
+PG_FUNCTION_INFO_V1 (dna_delta_compression_ratio);
+Datum dna_delta_compression_ratio(PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	PB_DeltaSequence* input_header = (PB_DeltaSequence*)
+			PG_DETOAST_DATUM_SLICE(input, 0, 4);
+
+	PG_RETURN_FLOAT8((double) toast_raw_datum_size((Datum) input) /
+					 (double) (input_header->sequence_length + VARHDRSZ));
+}
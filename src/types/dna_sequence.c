@@ -11,19 +11,23 @@
 *
 *-------------------------------------------------------------------------
 */
+#include <ctype.h>
 #include "math.h"
 
 #include "postgres.h"
 #include "fmgr.h"
 #include "utils/array.h"
+#include "utils/builtins.h"
 #include "catalog/pg_type.h"
 #include "access/tuptoaster.h"
 
 #include "sequence/sequence.h"
+#include "sequence/codebook.h"
 #include "sequence/stats.h"
 #include "sequence/code_set_creation.h"
 #include "sequence/compression.h"
 #include "sequence/functions.h"
+#include "sequence/transfer.h"
 #include "utils/debug.h"
 #include "types/alphabet.h"
 
@@ -229,6 +233,47 @@ PB_DnaSequenceTypMod int_to_dna_sequence_typmod(int typmod)
 	return *((PB_DnaSequenceTypMod*) &typmod);
 }
 
+/**
+ * text_to_dna_sequence_typmod()
+ * 		Converts comma-separated type modifiers, as written in
+ * 		dna_sequence(...), to the type modifier structure.
+ *
+ * 	text* modifiers : e.g. 'REFERENCE, CASE_SENSITIVE', may be empty
+ */
+PB_DnaSequenceTypMod text_to_dna_sequence_typmod(text* modifiers)
+{
+	char* input = text_to_cstring(modifiers);
+	char* keyword;
+	char* save_pointer;
+	char* c;
+	Datum* keywords;
+	int n_keywords = 0;
+	ArrayType* array;
+
+	keywords = palloc(sizeof(Datum) * (strlen(input) / 2 + 1));
+
+	for (keyword = strtok_r(input, ", \t", &save_pointer);
+		 keyword;
+		 keyword = strtok_r(NULL, ", \t", &save_pointer))
+	{
+		for (c = keyword; *c; c++)
+			*c = tolower((unsigned char) *c);
+		keywords[n_keywords++] = CStringGetDatum(keyword);
+	}
+
+	if (n_keywords == 0)
+	{
+		pfree(keywords);
+		pfree(input);
+		return non_restricting_dna_typmod;
+	}
+
+	array = construct_array(keywords, n_keywords, CSTRINGOID, -2, false, 'c');
+
+	return int_to_dna_sequence_typmod(DatumGetInt32(DirectFunctionCall1(dna_sequence_typmod_in,
+																		PointerGetDatum(array))));
+}
+
 /**
  * get_fixed_dna_code()
  * 		Returns a fixed code for the specified id.
@@ -301,6 +346,8 @@ PB_CompressedSequence* compress_dna_sequence(uint8* input,
 
 	PB_TRACE(errmsg("->compress_dna_sequence(), typmod=%d",dna_sequence_typmod_to_int(typmod)));
 
+	info->index_part_shift = typmod.index_part_shift;
+
 	PB_DEBUG1(errmsg("compress_dna_sequence(): low bitmap:%ld high bitmap:%ld",  info->ascii_bitmap_low, info->ascii_bitmap_high));
 
 	/*
@@ -375,6 +422,49 @@ PB_CompressedSequence* compress_dna_sequence(uint8* input,
 	return result;
 }
 
+/**
+ * compress_flc_dna_sequence()
+ * 		Compress a DNA sequence with type modifiers FLC and
+ * 		CASE_INSENSITIVE.
+ *
+ * 	These always use the four-letter code, which does not depend on
+ * 	statistics. So the statistics, only needed to check the alphabet,
+ * 	are collected while encoding and the input is read once.
+ *
+ * 	uint8* input : unterminated or null-terminated input sequence
+ * 	uint32 length : length of the input sequence
+ * 	PB_DnaSequenceTypMod typmod : target type modifier
+ */
+PB_CompressedSequence* compress_flc_dna_sequence(uint8* input,
+												 uint32 length,
+												 PB_DnaSequenceTypMod typmod)
+{
+	PB_SequenceInfo* info;
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->compress_flc_dna_sequence(), typmod=%d",dna_sequence_typmod_to_int(typmod)));
+
+	info = (PB_SequenceInfo*) palloc0(sizeof(PB_SequenceInfo));
+	info->sequence_length = length;
+	info->index_part_shift = typmod.index_part_shift;
+	info->ignore_case = TRUE;
+
+	result = encode_with_stats(input, &dna_flc, info);
+
+	complete_sequence_info(info);
+
+	if (!PB_CHECK_CODESET((&dna_flc_cs),info))
+	{
+		ereport(ERROR,(errmsg("input sequence violates alphabet restrictions")));
+	}
+
+	PB_SEQUENCE_INFO_PFREE(info);
+
+	PB_TRACE(errmsg("<-compress_flc_dna_sequence()"));
+
+	return result;
+}
+
 /**
  * decompress_dna_sequence()
  * 		Decompress a DNA sequence
@@ -392,6 +482,91 @@ void decompress_dna_sequence(PB_CompressedSequence* input,
 	decode((Varlena*) input, output, from_position, length, fixed_dna_codes);
 }
 
+/**
+ * complement_dna_symbol()
+ * 		Returns the complement of a nucleotide.
+ */
+uint8 complement_dna_symbol(uint8 symbol)
+{
+	switch (symbol)
+	{
+	case 'A':
+		symbol = 'T';
+		break;
+	case 'T':
+		symbol = 'A';
+		break;
+	case 'C':
+		symbol = 'G';
+		break;
+	case 'G':
+		symbol = 'C';
+		break;
+	case 'R':
+		symbol = 'Y';
+		break;
+	case 'Y':
+		symbol = 'R';
+		break;
+	case 'M':
+		symbol = 'K';
+		break;
+	case 'K':
+		symbol = 'M';
+		break;
+	case 'D':
+		symbol = 'H';
+		break;
+	case 'H':
+		symbol = 'D';
+		break;
+	case 'V':
+		symbol = 'B';
+		break;
+	case 'B':
+		symbol = 'V';
+		break;
+	case 'a':
+		symbol = 't';
+		break;
+	case 't':
+		symbol = 'a';
+		break;
+	case 'c':
+		symbol = 'g';
+		break;
+	case 'g':
+		symbol = 'c';
+		break;
+	case 'r':
+		symbol = 'y';
+		break;
+	case 'y':
+		symbol = 'r';
+		break;
+	case 'm':
+		symbol = 'k';
+		break;
+	case 'k':
+		symbol = 'm';
+		break;
+	case 'd':
+		symbol = 'h';
+		break;
+	case 'h':
+		symbol = 'd';
+		break;
+	case 'v':
+		symbol = 'b';
+		break;
+	case 'b':
+		symbol = 'v';
+		break;
+	}
+
+	return symbol;
+}
+
 /*
  *	Section 3 - pgsql interface functions
  */
@@ -419,6 +594,9 @@ Datum dna_sequence_typmod_in(PG_FUNCTION_ARGS)
 	bool typeModShortRead = false;
 	bool typeModRef = false;
 
+	int index_part_shift = 0;
+	int shift;
+
 	int i;
 
 	PB_TRACE(errmsg("->dna_sequence_typmod_in()"));
@@ -445,6 +623,8 @@ Datum dna_sequence_typmod_in(PG_FUNCTION_ARGS)
 			typeModShortRead = true;
 		} else if (!strcmp(read_pointer, "reference")) {
 			typeModRef = true;
+		} else if ((shift = get_index_part_shift(read_pointer)) >= 0) {
+			index_part_shift = shift;
 		} else {
 			ereport(ERROR,(errmsg("type modifier invalid"),
 					errdetail("Can not recognize type modifier \"%s\".", read_pointer)));
@@ -495,6 +675,8 @@ Datum dna_sequence_typmod_in(PG_FUNCTION_ARGS)
 		result.restricting_alphabet = PB_DNA_TYPMOD_IUPAC;
 	}
 
+	result.index_part_shift = index_part_shift;
+
 	PB_TRACE(errmsg("<-dna_sequence_typmod_in() returning %d", dna_sequence_typmod_to_int(result)));
 
 	PG_RETURN_INT32(dna_sequence_typmod_to_int(result));
@@ -529,7 +711,7 @@ Datum dna_sequence_typmod_out(PG_FUNCTION_ARGS)
 	if (typmod.compression_strategy == PB_DNA_TYPMOD_SHORT) {
 		len += 11; /* strlen('SHORT_READ,') = 11 */
 	} else if (typmod.compression_strategy == PB_DNA_TYPMOD_REFERENCE) {
-		len += 9; /* strlen('REFERENCE,') = 9 */
+		len += 10; /* strlen('REFERENCE,') = 10 */
 	} else {
 		len += 8; /* strlen('DEFAULT,') = 8 */
 	}
@@ -540,6 +722,10 @@ Datum dna_sequence_typmod_out(PG_FUNCTION_ARGS)
 		len += 5; /* strlen('IUPAC') = 5, strlen('ASCII') = 5  */
 	}
 
+	if (typmod.index_part_shift > 0) {
+		len += 6; /* strlen(',32768') = 6 */
+	}
+
 	result = palloc0(len);
 	out = result;
 
@@ -559,7 +745,7 @@ Datum dna_sequence_typmod_out(PG_FUNCTION_ARGS)
 		out+=11;
 	} else if (typmod.compression_strategy == PB_DNA_TYPMOD_REFERENCE) {
 		strcpy(out, "REFERENCE,");
-		out+=19;
+		out+=10;
 	} else {
 		strcpy(out, "DEFAULT,");
 		out+=8;
@@ -576,6 +762,10 @@ Datum dna_sequence_typmod_out(PG_FUNCTION_ARGS)
 		out+=5;
 	}
 
+	if (typmod.index_part_shift > 0) {
+		out += sprintf(out, ",%d", PB_INDEX_PART_SIZE >> typmod.index_part_shift);
+	}
+
 	*out = ')';
 	out++;
 	*out = 0;
@@ -628,11 +818,18 @@ Datum dna_sequence_in (PG_FUNCTION_ARGS)
 	if (typmod.case_sensitive == PB_DNA_TYPMOD_CASE_SENSITIVE)
 		mode |= PB_SEQUENCE_INFO_CASE_SENSITIVE;
 
-	info = get_sequence_info_cstring(input, mode);
+	if (PB_DNA_TYPMOD_IS_FLC_CASE_INSENSITIVE(typmod))
+	{
+		result = compress_flc_dna_sequence(input, strlen((char*) input), typmod);
+	}
+	else
+	{
+		info = get_sequence_info_cstring(input, mode);
 
-	result = compress_dna_sequence(input, typmod, info);
+		result = compress_dna_sequence(input, typmod, info);
 
-	PB_SEQUENCE_INFO_PFREE(info);
+		PB_SEQUENCE_INFO_PFREE(info);
+	}
 
 	PB_TRACE(errmsg("<-dna_sequence_in()"));
 
@@ -672,11 +869,18 @@ Datum dna_sequence_in_varlena (PG_FUNCTION_ARGS)
 	if (typmod.case_sensitive == PB_DNA_TYPMOD_CASE_SENSITIVE)
 		mode |= PB_SEQUENCE_INFO_CASE_SENSITIVE;
 
-	info = get_sequence_info_text(input, mode);
+	if (PB_DNA_TYPMOD_IS_FLC_CASE_INSENSITIVE(typmod))
+	{
+		result = compress_flc_dna_sequence((uint8*) VARDATA(input), VARSIZE(input) - VARHDRSZ, typmod);
+	}
+	else
+	{
+		info = get_sequence_info_text(input, mode);
 
-	result = compress_dna_sequence((uint8*) VARDATA(input), typmod, info);
+		result = compress_dna_sequence((uint8*) VARDATA(input), typmod, info);
 
-	PB_SEQUENCE_INFO_PFREE(info);
+		PB_SEQUENCE_INFO_PFREE(info);
+	}
 
 	PB_TRACE(errmsg("<-dna_sequence_in_varlena()"));
 
@@ -726,10 +930,17 @@ Datum dna_sequence_cast (PG_FUNCTION_ARGS)
 	/*
 	 * Compress again.
 	 */
-	info = get_sequence_info_cstring(plain, mode);
-	result = compress_dna_sequence(plain, typmod, info);
+	if (PB_DNA_TYPMOD_IS_FLC_CASE_INSENSITIVE(typmod))
+	{
+		result = compress_flc_dna_sequence(plain, input->sequence_length, typmod);
+	}
+	else
+	{
+		info = get_sequence_info_cstring(plain, mode);
+		result = compress_dna_sequence(plain, typmod, info);
 
-	PB_SEQUENCE_INFO_PFREE(info);
+		PB_SEQUENCE_INFO_PFREE(info);
+	}
 
 	pfree(plain);
 
@@ -784,6 +995,60 @@ Datum dna_sequence_out_varlena (PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(result);
 }
 
+/**
+ * dna_sequence_send()
+ * 		Convert a sequence to its external binary representation,
+ * 		which holds the code and the compressed stream.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+PG_FUNCTION_INFO_V1 (dna_sequence_send);
+Datum dna_sequence_send (PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	bytea* result;
+
+	PB_TRACE(errmsg("->dna_sequence_send()"));
+
+	result = send_sequence(input, fixed_dna_codes);
+
+	PB_TRACE(errmsg("<-dna_sequence_send()"));
+
+	PG_RETURN_BYTEA_P(result);
+}
+
+/**
+ * dna_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ * 		The sequence is encoded with the received code, unless type
+ * 		modifiers are given.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+PG_FUNCTION_INFO_V1 (dna_sequence_recv);
+Datum dna_sequence_recv (PG_FUNCTION_ARGS)
+{
+	StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+	int32 typmod = PG_GETARG_INT32(2);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->dna_sequence_recv()"));
+
+	result = receive_sequence(buf, fixed_dna_codes, n_fixed_dna_codes);
+
+	if ((-1) != typmod)
+		result = (PB_CompressedSequence*)
+				 DatumGetPointer(DirectFunctionCall2(dna_sequence_cast,
+													 PointerGetDatum(result),
+													 Int32GetDatum(typmod)));
+
+	PB_TRACE(errmsg("<-dna_sequence_recv()"));
+
+	PG_RETURN_POINTER(result);
+}
+
 /**
  * dna_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -802,19 +1067,20 @@ Datum dna_sequence_substring (PG_FUNCTION_ARGS)
 	int start = PG_GETARG_DATUM(1);
 	int len = PG_GETARG_DATUM(2);
 
-	PB_CompressedSequence* input_header;
+	PB_DetoastCursor* cursor;
+	uint32 sequence_length;
 
 	text* result;
 
 	PB_TRACE(errmsg("->dna_sequence_substring()"));
 
-	input_header = (PB_CompressedSequence*)
-			PG_DETOAST_DATUM_SLICE(input, 0, sizeof(PB_CompressedSequence) - VARHDRSZ);
-
 	if (len < 0) {
 		ereport(ERROR,(errmsg("negative substring length not allowed")));
 	}
 
+	cursor = open_cached_detoast_cursor(fcinfo->flinfo, input);
+	sequence_length = cursor->header->sequence_length;
+
 	/*
 	 * SQL's first position is 1, our first position is 0
 	 */
@@ -823,20 +1089,21 @@ Datum dna_sequence_substring (PG_FUNCTION_ARGS)
 		len += start;
 		start = 0;
 	}
-	if (start >= input_header->sequence_length || len < 1) {
+	if (start >= sequence_length || len < 1) {
 		result = palloc0(4);
 		SET_VARSIZE (result, 4);
+		close_detoast_cursor(cursor);
 		PG_RETURN_POINTER(result);
 	}
-	if (start + len > input_header->sequence_length) {
-		len = input_header->sequence_length - start;
+	if (start + len > sequence_length) {
+		len = sequence_length - start;
 	}
 
 	result = palloc0(len + VARHDRSZ);
 	SET_VARSIZE (result, len + VARHDRSZ);
-	decompress_dna_sequence((PB_CompressedSequence*) input,(uint8*) VARDATA(result),start,len);
+	decode_from_cursor(cursor, (uint8*) VARDATA(result), start, len, fixed_dna_codes);
 
-	pfree(input_header);
+	close_detoast_cursor(cursor);
 
 	PB_TRACE(errmsg("<-dna_sequence_substring()"));
 
@@ -852,10 +1119,12 @@ Datum dna_sequence_substring (PG_FUNCTION_ARGS)
 PG_FUNCTION_INFO_V1 (dna_sequence_char_length);
 Datum dna_sequence_char_length (PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* dna_seq = (PB_CompressedSequence*)
-			PG_DETOAST_DATUM_SLICE(PG_GETARG_RAW_VARLENA_P(0),0,4);
+	PB_DetoastCursor* cursor = open_cached_detoast_cursor(fcinfo->flinfo, (Varlena*) PG_GETARG_RAW_VARLENA_P(0));
+	const uint32 length = cursor->header->sequence_length;
 
-	PG_RETURN_INT32(dna_seq->sequence_length);
+	close_detoast_cursor(cursor);
+
+	PG_RETURN_INT32(length);
 }
 
 /**
@@ -882,9 +1151,17 @@ Datum dna_sequence_compression_ratio (PG_FUNCTION_ARGS)
 	PG_RETURN_FLOAT8(cr);
 }
 
-static void complement_dna(PB_CompressedSequence* sequence)
+static PB_CompressedSequence* complement_dna(PB_CompressedSequence* sequence)
 {
-	PB_Codeword* codewords = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(sequence);
+	PB_Codeword* codewords;
+
+	/*
+	 * Codebooks are shared, so their codewords cannot be rewritten.
+	 */
+	if (PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(sequence))
+		sequence = encode_without_codebook(sequence, fixed_dna_codes);
+
+	codewords = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(sequence);
 
 	if (sequence->is_fixed)
 	{
@@ -895,86 +1172,12 @@ static void complement_dna(PB_CompressedSequence* sequence)
 		int i;
 
 		for (i = 0; i < sequence->n_symbols; i++)
-		{
-			uint8 symbol = codewords[i].symbol;
-			switch (symbol)
-			{
-			case 'A':
-				symbol = 'T';
-				break;
-			case 'T':
-				symbol = 'A';
-				break;
-			case 'C':
-				symbol = 'G';
-				break;
-			case 'G':
-				symbol = 'C';
-				break;
-			case 'R':
-				symbol = 'Y';
-				break;
-			case 'Y':
-				symbol = 'R';
-				break;
-			case 'M':
-				symbol = 'K';
-				break;
-			case 'K':
-				symbol = 'M';
-				break;
-			case 'D':
-				symbol = 'H';
-				break;
-			case 'H':
-				symbol = 'D';
-				break;
-			case 'V':
-				symbol = 'B';
-				break;
-			case 'B':
-				symbol = 'V';
-				break;
-			case 'a':
-				symbol = 't';
-				break;
-			case 't':
-				symbol = 'a';
-				break;
-			case 'c':
-				symbol = 'g';
-				break;
-			case 'g':
-				symbol = 'c';
-				break;
-			case 'r':
-				symbol = 'y';
-				break;
-			case 'y':
-				symbol = 'r';
-				break;
-			case 'm':
-				symbol = 'k';
-				break;
-			case 'k':
-				symbol = 'm';
-				break;
-			case 'd':
-				symbol = 'h';
-				break;
-			case 'h':
-				symbol = 'd';
-				break;
-			case 'v':
-				symbol = 'b';
-				break;
-			case 'b':
-				symbol = 'v';
-				break;
-			}
-			codewords[i].symbol = symbol;
-		}
+			codewords[i].symbol = complement_dna_symbol(codewords[i].symbol);
 	}
+
+	invalidate_sequence_crc32(sequence);
+
+	return sequence;
 }
 
 /**
@@ -1000,7 +1203,7 @@ Datum dna_sequence_complement(PG_FUNCTION_ARGS)
 	result = palloc0(mem_size);
 	memcpy(result, input, mem_size);
 
-	complement_dna(result);
+	result = complement_dna(result);
 
 	PB_TRACE(errmsg("<-dna_sequence_complement()"));
 
@@ -1042,7 +1245,7 @@ Datum dna_sequence_reverse_complement(PG_FUNCTION_ARGS)
 
 	result = reverse(input, fixed_dna_codes);
 
-	complement_dna(result);
+	result = complement_dna(result);
 
 	PG_RETURN_POINTER(result);
 }
@@ -1209,12 +1412,12 @@ Datum compare_dna(PG_FUNCTION_ARGS)
  * hash_dna()
  * 		Returns a CRC32 for a DNA sequence.
  *
- * 	PB_CompressedSequence* seq1 : input sequence
+ * 	Varlena* seq1 : possibly toasted input sequence
  */
 PG_FUNCTION_INFO_V1 (hash_dna);
 Datum hash_dna(PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* seq1 = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
+	Varlena* seq1 = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
 	uint32 result;
 
 	PB_TRACE(errmsg("->hash_dna()"));
@@ -1233,19 +1436,49 @@ Datum hash_dna(PG_FUNCTION_ARGS)
 PG_FUNCTION_INFO_V1 (strpos_dna);
 Datum strpos_dna(PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* seq = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
-	text* search = (text*) PG_GETARG_VARLENA_P(1);
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* search = (text*) PG_GETARG_TEXT_PP(1);
 	uint32 result;
 
 	PB_TRACE(errmsg("->strpos_dna()"));
 
-	result = sequence_strpos(seq, search, fixed_dna_codes);
+	result = sequence_strpos(seq,
+							 (uint8*) VARDATA_ANY(search),
+							 VARSIZE_ANY_EXHDR(search),
+							 fcinfo->flinfo,
+							 fixed_dna_codes);
 
 	PB_TRACE(errmsg("<-strpos_dna()"));
 
 	PG_RETURN_UINT32(result);
 }
 
+/**
+ * strpos_dna_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+PG_FUNCTION_INFO_V1 (strpos_dna_seq);
+Datum strpos_dna_seq(PG_FUNCTION_ARGS)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	PB_CompressedSequence* search = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(1);
+	uint8* pattern;
+	uint32 result;
+
+	PB_TRACE(errmsg("->strpos_dna_seq()"));
+
+	pattern = palloc(search->sequence_length + 1);
+	decompress_dna_sequence(search, pattern, 0, search->sequence_length);
+
+	result = sequence_strpos(seq, pattern, search->sequence_length, fcinfo->flinfo, fixed_dna_codes);
+
+	pfree(pattern);
+
+	PB_TRACE(errmsg("<-strpos_dna_seq()"));
+
+	PG_RETURN_UINT32(result);
+}
+
 /**
  * octet_length_dna()
  * 		Returns byte size of datum.
@@ -1255,3 +1488,132 @@ Datum octet_length_dna(PG_FUNCTION_ARGS)
 {
 	PG_RETURN_UINT32((uint32) toast_raw_datum_size((Datum) PG_GETARG_RAW_VARLENA_P(0)));
 }
+
+/**
+ * symbol_count_dna()
+ * 		Counts the occurrences of symbols in a DNA sequence.
+ *
+ * 	This function mimics the behaviour of the originals substr function
+ * 	for the optional range. The first position is 1.
+ *
+ * 	Varlena* input : compressed input sequence
+ * 	text* symbols : symbols to count
+ * 	int start : optional position to start from
+ * 	int len : optional number of characters to count
+ */
+PG_FUNCTION_INFO_V1 (symbol_count_dna);
+Datum symbol_count_dna(PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* symbols = PG_GETARG_TEXT_PP(1);
+	int start = PG_NARGS() > 2 ? PG_GETARG_INT32(2) : 1;
+	int len = PG_NARGS() > 2 ? PG_GETARG_INT32(3) : PB_MAX_COMPRESSED_SEQUENCE_SIZE;
+	uint32 result;
+
+	PB_TRACE(errmsg("->symbol_count_dna()"));
+
+	result = sequence_symbol_count(input,
+								   (uint8*) VARDATA_ANY(symbols),
+								   VARSIZE_ANY_EXHDR(symbols),
+								   start,
+								   len,
+								   NULL,
+								   fixed_dna_codes);
+
+	PB_TRACE(errmsg("<-symbol_count_dna() exits with %u", result));
+
+	PG_RETURN_INT64(result);
+}
+
+/**
+ * gc_content_dna()
+ * 		Returns the fraction of G and C in a DNA sequence.
+ * 		Returns NULL for empty ranges.
+ *
+ * 	Like gc_content(alphabet), only upper case G and C are counted.
+ *
+ * 	This function mimics the behaviour of the originals substr function
+ * 	for the optional range. The first position is 1.
+ *
+ * 	Varlena* input : compressed input sequence
+ * 	int start : optional position to start from
+ * 	int len : optional number of characters to count
+ */
+PG_FUNCTION_INFO_V1 (gc_content_dna);
+Datum gc_content_dna(PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	int start = PG_NARGS() > 1 ? PG_GETARG_INT32(1) : 1;
+	int len = PG_NARGS() > 1 ? PG_GETARG_INT32(2) : PB_MAX_COMPRESSED_SEQUENCE_SIZE;
+	uint32 n_gc;
+	uint32 n_counted;
+
+	PB_TRACE(errmsg("->gc_content_dna()"));
+
+	n_gc = sequence_symbol_count(input,
+								 (uint8*) "GC",
+								 2,
+								 start,
+								 len,
+								 &n_counted,
+								 fixed_dna_codes);
+
+	PB_TRACE(errmsg("<-gc_content_dna() counted %u of %u", n_gc, n_counted));
+
+	if (n_counted == 0)
+		PG_RETURN_NULL();
+
+	PG_RETURN_FLOAT4((float4) ((float8) n_gc / n_counted));
+}
+
+/**
+ * concat_dna()
+ * 		Concatenates two DNA sequences.
+ *
+ * 	Varlena* seq1 : first possibly toasted sequence
+ * 	Varlena* seq2 : second possibly toasted sequence
+ */
+PG_FUNCTION_INFO_V1 (concat_dna);
+Datum concat_dna(PG_FUNCTION_ARGS)
+{
+	Varlena* seq1 = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	Varlena* seq2 = (Varlena*) PG_GETARG_RAW_VARLENA_P(1);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->concat_dna()"));
+
+	result = sequence_concat(seq1, seq2, dna_sequence_in, fixed_dna_codes);
+
+	PB_TRACE(errmsg("<-concat_dna()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * overlay_dna()
+ * 		Replaces characters of a DNA sequence, like overlay() does
+ * 		for texts.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	text* replacement : new characters
+ * 	int start : first position to replace, the first position is 1
+ * 	int count : optional number of characters to replace, by default
+ * 				the length of the replacement
+ */
+PG_FUNCTION_INFO_V1 (overlay_dna);
+Datum overlay_dna(PG_FUNCTION_ARGS)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* replacement = PG_GETARG_TEXT_PP(1);
+	int start = PG_GETARG_INT32(2);
+	int count = PG_NARGS() > 3 ? PG_GETARG_INT32(3) : VARSIZE_ANY_EXHDR(replacement);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->overlay_dna()"));
+
+	result = sequence_overlay(seq, replacement, start, count, dna_sequence_in, fixed_dna_codes);
+
+	PB_TRACE(errmsg("<-overlay_dna()"));
+
+	PG_RETURN_POINTER(result);
+}
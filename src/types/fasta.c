@@ -0,0 +1,437 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/fasta.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "access/htup_details.h"
+#include "lib/stringinfo.h"
+#include "storage/fd.h"
+#include "utils/builtins.h"
+
+#include "sequence/sequence.h"
+#include "sequence/stats.h"
+#include "types/dna_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Server-side bulk loading of FASTA and FASTQ files.
+ *
+ * read_fasta() and read_fastq() stream the records of a file and compress
+ * each sequence as it is read. The sequence is collected in a buffer,
+ * that is reused for all records, and handed to compress_dna_sequence()
+ * directly, so it is never materialized as a text datum and not parsed
+ * again by the cast.
+ */
+
+/**
+ * Size of the file read buffer.
+ */
+#define PB_READ_BUFFER_SIZE		65536
+
+#define PB_FASTA_HEADER			'>'
+#define PB_FASTQ_HEADER			'@'
+#define PB_FASTQ_SEPARATOR		'+'
+
+/**
+ * State of a file being read, kept across calls of
+ * the set-returning functions.
+ */
+typedef struct {
+	FILE* file;
+	char* path;
+	char* buffer;
+	int buffer_length;
+	int position;
+	PB_DnaSequenceTypMod typmod;
+	int mode;
+	StringInfoData id;
+	StringInfoData sequence;
+	StringInfoData quality;
+} PB_SequenceFileReader;
+
+Datum read_fasta(PG_FUNCTION_ARGS);
+Datum read_fastq(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static PB_SequenceFileReader* open_reader(text* path, text* modifiers);
+static void close_reader(PB_SequenceFileReader* reader);
+static int peek_char(PB_SequenceFileReader* reader);
+static bool read_line(PB_SequenceFileReader* reader, StringInfo line);
+static bool skip_empty_lines(PB_SequenceFileReader* reader);
+static bool read_fasta_record(PB_SequenceFileReader* reader);
+static bool read_fastq_record(PB_SequenceFileReader* reader);
+static PB_CompressedSequence* compress_record(PB_SequenceFileReader* reader);
+
+/*
+ * local functions
+ */
+
+/**
+ * open_reader()
+ * 		Opens a file and allocates the buffers reused for all records.
+ * 		Must be called in a memory context living until the last record
+ * 		has been read.
+ *
+ * 	text* path : path of the file on the server
+ * 	text* modifiers : type modifiers of the resulting sequences
+ */
+static PB_SequenceFileReader* open_reader(text* path, text* modifiers)
+{
+	PB_SequenceFileReader* reader = palloc0(sizeof(PB_SequenceFileReader));
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to read files")));
+
+	reader->path = text_to_cstring(path);
+	reader->typmod = text_to_dna_sequence_typmod(modifiers);
+
+	/*
+	 * Determine sequence info collection mode, as dna_sequence_in() does.
+	 */
+	if (reader->typmod.compression_strategy == PB_DNA_TYPMOD_REFERENCE)
+		reader->mode = PB_SEQUENCE_INFO_WITH_RLE;
+	if (reader->typmod.case_sensitive == PB_DNA_TYPMOD_CASE_SENSITIVE)
+		reader->mode |= PB_SEQUENCE_INFO_CASE_SENSITIVE;
+
+	/*
+	 * AllocateFile() makes sure the file is closed at the end of the
+	 * transaction, even if not all records are fetched.
+	 */
+	reader->file = AllocateFile(reader->path, PG_BINARY_R);
+	if (!reader->file)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\" for reading: %m", reader->path)));
+
+	reader->buffer = palloc(PB_READ_BUFFER_SIZE);
+	initStringInfo(&reader->id);
+	initStringInfo(&reader->sequence);
+	initStringInfo(&reader->quality);
+
+	return reader;
+}
+
+/**
+ * close_reader()
+ * 		Closes the file of a reader.
+ */
+static void close_reader(PB_SequenceFileReader* reader)
+{
+	if (reader->file)
+		FreeFile(reader->file);
+	reader->file = NULL;
+}
+
+/**
+ * peek_char()
+ * 		Returns the next character without consuming it or EOF.
+ */
+static int peek_char(PB_SequenceFileReader* reader)
+{
+	if (reader->position == reader->buffer_length)
+	{
+		reader->buffer_length = fread(reader->buffer, 1, PB_READ_BUFFER_SIZE, reader->file);
+		reader->position = 0;
+
+		if (reader->buffer_length == 0)
+		{
+			if (ferror(reader->file))
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read file \"%s\": %m", reader->path)));
+			return EOF;
+		}
+	}
+
+	return (unsigned char) reader->buffer[reader->position];
+}
+
+/**
+ * read_line()
+ * 		Appends the rest of the current line to a buffer and consumes
+ * 		the line break. Carriage returns are dropped. Returns false at
+ * 		the end of the file.
+ *
+ * 	StringInfo line : buffer to append to
+ */
+static bool read_line(PB_SequenceFileReader* reader, StringInfo line)
+{
+	char* start;
+	char* end;
+	int length;
+
+	if (peek_char(reader) == EOF)
+		return false;
+
+	while (peek_char(reader) != EOF)
+	{
+		start = reader->buffer + reader->position;
+		end = memchr(start, '\n', reader->buffer_length - reader->position);
+		length = end ? end - start : reader->buffer_length - reader->position;
+
+		appendBinaryStringInfo(line, start, length);
+		reader->position += length;
+
+		if (end)
+		{
+			reader->position++;
+			break;
+		}
+	}
+
+	if (line->len > 0 && line->data[line->len - 1] == '\r')
+		line->data[--line->len] = '\0';
+
+	return true;
+}
+
+/**
+ * skip_empty_lines()
+ * 		Consumes empty lines. Returns false at the end of the file.
+ */
+static bool skip_empty_lines(PB_SequenceFileReader* reader)
+{
+	int c;
+
+	while ((c = peek_char(reader)) == '\n' || c == '\r')
+		reader->position++;
+
+	return c != EOF;
+}
+
+/**
+ * read_fasta_record()
+ * 		Reads header and sequence lines of the next FASTA record.
+ * 		Returns false at the end of the file.
+ */
+static bool read_fasta_record(PB_SequenceFileReader* reader)
+{
+	int c;
+
+	if (!skip_empty_lines(reader))
+		return false;
+
+	if (peek_char(reader) != PB_FASTA_HEADER)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				 errmsg("invalid FASTA file \"%s\"", reader->path),
+				 errdetail("Record does not start with \"%c\".", PB_FASTA_HEADER)));
+	reader->position++;
+
+	resetStringInfo(&reader->id);
+	read_line(reader, &reader->id);
+
+	resetStringInfo(&reader->sequence);
+	while ((c = peek_char(reader)) != EOF && c != PB_FASTA_HEADER)
+		read_line(reader, &reader->sequence);
+
+	return true;
+}
+
+/**
+ * read_fastq_record()
+ * 		Reads header, sequence and quality lines of the next FASTQ
+ * 		record. Sequence and quality may be wrapped. Quality lines are
+ * 		read until they are as long as the sequence, because they may
+ * 		start with '@'. Returns false at the end of the file.
+ */
+static bool read_fastq_record(PB_SequenceFileReader* reader)
+{
+	int c;
+
+	if (!skip_empty_lines(reader))
+		return false;
+
+	if (peek_char(reader) != PB_FASTQ_HEADER)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				 errmsg("invalid FASTQ file \"%s\"", reader->path),
+				 errdetail("Record does not start with \"%c\".", PB_FASTQ_HEADER)));
+	reader->position++;
+
+	resetStringInfo(&reader->id);
+	read_line(reader, &reader->id);
+
+	resetStringInfo(&reader->sequence);
+	while ((c = peek_char(reader)) != EOF && c != PB_FASTQ_SEPARATOR)
+		read_line(reader, &reader->sequence);
+
+	if (c == EOF)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				 errmsg("invalid FASTQ file \"%s\"", reader->path),
+				 errdetail("Record \"%s\" has no quality line.", reader->id.data)));
+
+	/*
+	 * Skip separator line, which may repeat the header.
+	 */
+	resetStringInfo(&reader->quality);
+	read_line(reader, &reader->quality);
+
+	resetStringInfo(&reader->quality);
+	while (reader->quality.len < reader->sequence.len)
+		if (!read_line(reader, &reader->quality))
+			break;
+
+	if (reader->quality.len != reader->sequence.len)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				 errmsg("invalid FASTQ file \"%s\"", reader->path),
+				 errdetail("Lengths of sequence and quality of record \"%s\" differ.", reader->id.data)));
+
+	return true;
+}
+
+/**
+ * compress_record()
+ * 		Compresses the sequence of the current record.
+ */
+static PB_CompressedSequence* compress_record(PB_SequenceFileReader* reader)
+{
+	PB_SequenceInfo* info;
+	PB_CompressedSequence* result;
+
+	if (PB_DNA_TYPMOD_IS_FLC_CASE_INSENSITIVE(reader->typmod))
+		return compress_flc_dna_sequence((uint8*) reader->sequence.data, reader->sequence.len, reader->typmod);
+
+	info = get_sequence_info_cstring((uint8*) reader->sequence.data, reader->mode);
+
+	result = compress_dna_sequence((uint8*) reader->sequence.data, reader->typmod, info);
+
+	PB_SEQUENCE_INFO_PFREE(info);
+
+	return result;
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * read_fasta()
+ * 		Returns the records of a FASTA file on the server as
+ * 		(id text, sequence dna_sequence). The id is the
+ * 		header line without '>'.
+ *
+ * 	text* path : path of the file
+ * 	text* modifiers : comma-separated dna_sequence type modifiers
+ */
+PG_FUNCTION_INFO_V1 (read_fasta);
+Datum read_fasta(PG_FUNCTION_ARGS)
+{
+	FuncCallContext* funcctx;
+	PB_SequenceFileReader* reader;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		PB_TRACE(errmsg("->read_fasta()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = open_reader(PG_GETARG_TEXT_PP(0), PG_GETARG_TEXT_PP(1));
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	reader = (PB_SequenceFileReader*) funcctx->user_fctx;
+
+	if (read_fasta_record(reader))
+	{
+		Datum values[2];
+		bool nulls[2] = {false, false};
+
+		values[0] = PointerGetDatum(cstring_to_text_with_len(reader->id.data, reader->id.len));
+		values[1] = PointerGetDatum(compress_record(reader));
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	close_reader(reader);
+
+	PB_TRACE(errmsg("<-read_fasta()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
+
+/**
+ * read_fastq()
+ * 		Returns the records of a FASTQ file on the server as
+ * 		(id text, sequence dna_sequence, quality text). The id is
+ * 		the header line without '@'.
+ *
+ * 	text* path : path of the file
+ * 	text* modifiers : comma-separated dna_sequence type modifiers
+ */
+PG_FUNCTION_INFO_V1 (read_fastq);
+Datum read_fastq(PG_FUNCTION_ARGS)
+{
+	FuncCallContext* funcctx;
+	PB_SequenceFileReader* reader;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		PB_TRACE(errmsg("->read_fastq()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = open_reader(PG_GETARG_TEXT_PP(0), PG_GETARG_TEXT_PP(1));
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	reader = (PB_SequenceFileReader*) funcctx->user_fctx;
+
+	if (read_fastq_record(reader))
+	{
+		Datum values[3];
+		bool nulls[3] = {false, false, false};
+
+		values[0] = PointerGetDatum(cstring_to_text_with_len(reader->id.data, reader->id.len));
+		values[1] = PointerGetDatum(compress_record(reader));
+		values[2] = PointerGetDatum(cstring_to_text_with_len(reader->quality.data, reader->quality.len));
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	close_reader(reader);
+
+	PB_TRACE(errmsg("<-read_fastq()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
@@ -0,0 +1,457 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/kmer_counts.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+
+#include "sequence/sequence.h"
+#include "sequence/kmer_counts.h"
+#include "types/dna_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * k-mer counting on dna_sequence.
+ *
+ * kmer_counts() returns the distinct k-mers of a sequence with their
+ * number of occurrences, ordered by k-mer. kmer_spectrum() returns how
+ * many k-mers occur how often. kmer_spectrum_agg() counts the k-mers of
+ * all rows, e.g. all reads of a sample, and returns the spectrum as a
+ * two dimensional array of {multiplicity, n_kmers} pairs.
+ *
+ * The counts of an aggregate are passed between processes as bytea: k,
+ * canonical and the number of counts, followed by the counts.
+ */
+
+/**
+ * Header of a serialized counter of kmer_spectrum_agg().
+ */
+typedef struct {
+	int32 k;
+	int32 canonical;
+	uint32 n_entries;
+	uint32 unused;
+} PB_SerializedKmerCounter;
+
+Datum kmer_counts_dna(PG_FUNCTION_ARGS);
+Datum kmer_spectrum_dna(PG_FUNCTION_ARGS);
+Datum kmer_spectrum_agg_transfn_dna(PG_FUNCTION_ARGS);
+Datum kmer_spectrum_agg_combinefn(PG_FUNCTION_ARGS);
+Datum kmer_spectrum_agg_serialfn(PG_FUNCTION_ARGS);
+Datum kmer_spectrum_agg_deserialfn(PG_FUNCTION_ARGS);
+Datum kmer_spectrum_agg_finalfn(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static PB_KmerCounter* count_kmers(Varlena* raw_seq,
+								   int k,
+								   bool canonical,
+								   PB_CodeSet** fixed_codesets);
+static Datum kmer_spectrum_agg_transfn(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+
+/*
+ * local functions
+ */
+
+/**
+ * count_kmers()
+ * 		Counts the k-mers of a sequence into a new counter.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	int k : length of k-mers
+ * 	bool canonical : count canonical k-mers
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+static PB_KmerCounter* count_kmers(Varlena* raw_seq,
+								   int k,
+								   bool canonical,
+								   PB_CodeSet** fixed_codesets)
+{
+	PB_KmerCounter* counter = new_kmer_counter(k, canonical);
+
+	count_sequence_kmers(counter, raw_seq, fixed_codesets);
+
+	return counter;
+}
+
+/**
+ * kmer_spectrum_agg_transfn()
+ * 		Adds the k-mers of a sequence to the state.
+ *
+ * 	PB_KmerCounter* state : state or NULL
+ * 	Varlena* seq : possibly toasted sequence or NULL
+ * 	int32 k : length of k-mers, the same in all rows
+ * 	bool canonical : count canonical k-mers
+ */
+static Datum kmer_spectrum_agg_transfn(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	PB_KmerCounter* state;
+	MemoryContext aggcontext;
+	int32 k;
+	bool canonical;
+
+	if (PG_ARGISNULL(1) || PG_ARGISNULL(2) || PG_ARGISNULL(3))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		ereport(ERROR,(errmsg("aggregate function called in non-aggregate context")));
+
+	k = PG_GETARG_INT32(2);
+	canonical = PG_GETARG_BOOL(3);
+
+	if (PG_ARGISNULL(0))
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(aggcontext);
+		state = new_kmer_counter(k, canonical);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else
+	{
+		state = (PB_KmerCounter*) PG_GETARG_POINTER(0);
+
+		if (state->k != k || state->canonical != canonical)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("k-mer length and canonical must be the same in all rows")));
+	}
+
+	count_sequence_kmers(state, (Varlena*) PG_GETARG_RAW_VARLENA_P(1), fixed_codesets);
+
+	PG_RETURN_POINTER(state);
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * kmer_counts_dna()
+ * 		Returns the k-mers of a dna_sequence as (kmer text, count int8)
+ * 		ordered by k-mer.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32 k : length of k-mers
+ * 	bool canonical : count canonical k-mers
+ */
+PG_FUNCTION_INFO_V1 (kmer_counts_dna);
+Datum kmer_counts_dna(PG_FUNCTION_ARGS)
+{
+	FuncCallContext* funcctx;
+	PB_KmerCounter* counter;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		PB_TRACE(errmsg("->kmer_counts_dna()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		counter = count_kmers((Varlena*) PG_GETARG_RAW_VARLENA_P(0),
+							  PG_GETARG_INT32(1),
+							  PG_GETARG_BOOL(2),
+							  get_fixed_dna_codes());
+		sort_kmer_counts(counter);
+
+		funcctx->user_fctx = counter;
+		funcctx->max_calls = counter->n_entries;
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	counter = (PB_KmerCounter*) funcctx->user_fctx;
+
+	if (funcctx->call_cntr < funcctx->max_calls)
+	{
+		const PB_KmerCount* entry = &counter->entries[funcctx->call_cntr];
+		char kmer[PB_MAX_COUNTED_KMER_LENGTH + 1];
+		Datum values[2];
+		bool nulls[2] = {false, false};
+
+		kmer_to_cstring(entry->kmer, counter->k, kmer);
+
+		values[0] = PointerGetDatum(cstring_to_text_with_len(kmer, counter->k));
+		values[1] = Int64GetDatum((int64) entry->count);
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	free_kmer_counter(counter);
+
+	PB_TRACE(errmsg("<-kmer_counts_dna()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
+
+/**
+ * kmer_spectrum_dna()
+ * 		Returns the k-mer spectrum of a dna_sequence as
+ * 		(multiplicity int8, n_kmers int8) ordered by multiplicity.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32 k : length of k-mers
+ * 	bool canonical : count canonical k-mers
+ */
+PG_FUNCTION_INFO_V1 (kmer_spectrum_dna);
+Datum kmer_spectrum_dna(PG_FUNCTION_ARGS)
+{
+	FuncCallContext* funcctx;
+	PB_KmerCount* rows;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+		PB_KmerCounter* counter;
+		uint32 n_rows;
+
+		PB_TRACE(errmsg("->kmer_spectrum_dna()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		counter = count_kmers((Varlena*) PG_GETARG_RAW_VARLENA_P(0),
+							  PG_GETARG_INT32(1),
+							  PG_GETARG_BOOL(2),
+							  get_fixed_dna_codes());
+		funcctx->user_fctx = get_kmer_spectrum(counter, &n_rows);
+		funcctx->max_calls = n_rows;
+		free_kmer_counter(counter);
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	rows = (PB_KmerCount*) funcctx->user_fctx;
+
+	if (funcctx->call_cntr < funcctx->max_calls)
+	{
+		Datum values[2];
+		bool nulls[2] = {false, false};
+
+		values[0] = Int64GetDatum((int64) rows[funcctx->call_cntr].kmer);
+		values[1] = Int64GetDatum((int64) rows[funcctx->call_cntr].count);
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	PB_TRACE(errmsg("<-kmer_spectrum_dna()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
+
+/**
+ * kmer_spectrum_agg_transfn_dna()
+ * 		Transition function of kmer_spectrum_agg(dna_sequence, int4, bool).
+ */
+PG_FUNCTION_INFO_V1 (kmer_spectrum_agg_transfn_dna);
+Datum kmer_spectrum_agg_transfn_dna(PG_FUNCTION_ARGS)
+{
+	return kmer_spectrum_agg_transfn(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * kmer_spectrum_agg_combinefn()
+ * 		Merges two states of parallel workers.
+ *
+ * 	PB_KmerCounter* state1 : state or NULL
+ * 	PB_KmerCounter* state2 : state or NULL
+ */
+PG_FUNCTION_INFO_V1 (kmer_spectrum_agg_combinefn);
+Datum kmer_spectrum_agg_combinefn(PG_FUNCTION_ARGS)
+{
+	PB_KmerCounter* state1;
+	PB_KmerCounter* state2;
+	MemoryContext aggcontext;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		ereport(ERROR,(errmsg("aggregate function called in non-aggregate context")));
+
+	state2 = (PB_KmerCounter*) PG_GETARG_POINTER(1);
+
+	/*
+	 * The second state may not live in the aggregate context,
+	 * so it is added to a state of our own.
+	 */
+	if (PG_ARGISNULL(0))
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(aggcontext);
+		state1 = new_kmer_counter(state2->k, state2->canonical);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else
+		state1 = (PB_KmerCounter*) PG_GETARG_POINTER(0);
+
+	if (state1->canonical != state2->canonical)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("k-mer length and canonical must be the same in all rows")));
+
+	merge_kmer_counters(state1, state2);
+
+	PG_RETURN_POINTER(state1);
+}
+
+/**
+ * kmer_spectrum_agg_serialfn()
+ * 		Converts a state to bytea.
+ *
+ * 	PB_KmerCounter* state : state
+ */
+PG_FUNCTION_INFO_V1 (kmer_spectrum_agg_serialfn);
+Datum kmer_spectrum_agg_serialfn(PG_FUNCTION_ARGS)
+{
+	PB_KmerCounter* state = (PB_KmerCounter*) PG_GETARG_POINTER(0);
+	const Size size = VARHDRSZ + sizeof(PB_SerializedKmerCounter) +
+					  (Size) state->n_entries * sizeof(PB_KmerCount);
+	PB_SerializedKmerCounter* header;
+	PB_KmerCount* entries;
+	bytea* result;
+	uint32 n = 0;
+	uint32 i;
+
+	if (!AllocSizeIsValid(size))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("too many distinct k-mers to pass between processes")));
+
+	result = palloc(size);
+	SET_VARSIZE(result, size);
+
+	header = (PB_SerializedKmerCounter*) VARDATA(result);
+	header->k = state->k;
+	header->canonical = state->canonical;
+	header->n_entries = state->n_entries;
+	header->unused = 0;
+
+	entries = (PB_KmerCount*) (header + 1);
+	for (i = 0; i < state->capacity; i++)
+		if (state->entries[i].count > 0)
+			entries[n++] = state->entries[i];
+
+	PG_RETURN_BYTEA_P(result);
+}
+
+/**
+ * kmer_spectrum_agg_deserialfn()
+ * 		Restores a state from bytea.
+ *
+ * 	bytea* input : serialized state
+ */
+PG_FUNCTION_INFO_V1 (kmer_spectrum_agg_deserialfn);
+Datum kmer_spectrum_agg_deserialfn(PG_FUNCTION_ARGS)
+{
+	bytea* input = PG_GETARG_BYTEA_PP(0);
+	PB_SerializedKmerCounter header;
+	const PB_KmerCount* entries;
+	PB_KmerCounter* result;
+	uint32 i;
+
+	if (VARSIZE_ANY_EXHDR(input) < sizeof(PB_SerializedKmerCounter))
+		ereport(ERROR,(errmsg("invalid serialized k-mer counts")));
+
+	memcpy(&header, VARDATA_ANY(input), sizeof(PB_SerializedKmerCounter));
+
+	if (VARSIZE_ANY_EXHDR(input) != sizeof(PB_SerializedKmerCounter) +
+									(Size) header.n_entries * sizeof(PB_KmerCount))
+		ereport(ERROR,(errmsg("invalid serialized k-mer counts")));
+
+	result = new_kmer_counter(header.k, header.canonical != 0);
+
+	entries = (const PB_KmerCount*) (VARDATA_ANY(input) + sizeof(PB_SerializedKmerCounter));
+	for (i = 0; i < header.n_entries; i++)
+	{
+		PB_KmerCount entry;
+
+		memcpy(&entry, entries + i, sizeof(PB_KmerCount));
+		add_kmer_count(result, entry.kmer, entry.count);
+	}
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * kmer_spectrum_agg_finalfn()
+ * 		Returns the spectrum as int8[][] of {multiplicity, n_kmers}
+ * 		ordered by multiplicity.
+ *
+ * 	PB_KmerCounter* state : state or NULL
+ */
+PG_FUNCTION_INFO_V1 (kmer_spectrum_agg_finalfn);
+Datum kmer_spectrum_agg_finalfn(PG_FUNCTION_ARGS)
+{
+	PB_KmerCounter* state;
+	PB_KmerCount* rows;
+	Datum* elements;
+	uint32 n_rows;
+	int dims[2];
+	int lbs[2] = {1, 1};
+	uint32 i;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	state = (PB_KmerCounter*) PG_GETARG_POINTER(0);
+
+	/*
+	 * The state is not changed, the final function may be called
+	 * again, e.g. in window aggregates.
+	 */
+	rows = get_kmer_spectrum(state, &n_rows);
+
+	if (n_rows == 0)
+		PG_RETURN_ARRAYTYPE_P(construct_empty_array(INT8OID));
+
+	elements = palloc(n_rows * 2 * sizeof(Datum));
+	for (i = 0; i < n_rows; i++)
+	{
+		elements[i * 2] = Int64GetDatum((int64) rows[i].kmer);
+		elements[i * 2 + 1] = Int64GetDatum((int64) rows[i].count);
+	}
+
+	dims[0] = n_rows;
+	dims[1] = 2;
+
+	PG_RETURN_ARRAYTYPE_P(construct_md_array(elements, NULL, 2, dims, lbs,
+											 INT8OID, sizeof(int64), FLOAT8PASSBYVAL, 'd'));
+}
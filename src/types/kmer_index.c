@@ -0,0 +1,516 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/kmer_index.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/gin.h"
+
+#include "sequence/sequence.h"
+#include "sequence/compression.h"
+#include "sequence/functions.h"
+#include "types/dna_sequence.h"
+#include "types/rna_sequence.h"
+#include "types/aa_sequence.h"
+#include "types/aligned_dna_sequence.h"
+#include "types/aligned_rna_sequence.h"
+#include "types/aligned_aa_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Containment operator seq @> pattern and GIN operator classes indexing
+ * the k-mers of sequences. A sequence containing the pattern contains all
+ * k-mers of the pattern, so the index returns candidates, which are
+ * rechecked. Patterns shorter than PB_KMER_INDEX_LENGTH have no k-mers,
+ * these queries scan the whole index.
+ *
+ * Strategy	|	Operator
+ * -----------------------------------------------------------
+ * 	1		|	@> (X_sequence, text)
+ * 	2		|	@> (X_sequence, X_sequence)
+ */
+
+/**
+ * Length of the indexed k-mers
+ */
+#define PB_KMER_INDEX_LENGTH		6
+
+#define PB_KMER_STRATEGY_TEXT		1
+#define PB_KMER_STRATEGY_SEQUENCE	2
+
+Datum contains_dna(PG_FUNCTION_ARGS);
+Datum contains_dna_seq(PG_FUNCTION_ARGS);
+Datum gin_extract_value_dna(PG_FUNCTION_ARGS);
+Datum gin_extract_query_dna(PG_FUNCTION_ARGS);
+Datum contains_rna(PG_FUNCTION_ARGS);
+Datum contains_rna_seq(PG_FUNCTION_ARGS);
+Datum gin_extract_value_rna(PG_FUNCTION_ARGS);
+Datum gin_extract_query_rna(PG_FUNCTION_ARGS);
+Datum contains_aa(PG_FUNCTION_ARGS);
+Datum contains_aa_seq(PG_FUNCTION_ARGS);
+Datum gin_extract_value_aa(PG_FUNCTION_ARGS);
+Datum gin_extract_query_aa(PG_FUNCTION_ARGS);
+Datum contains_aligned_dna(PG_FUNCTION_ARGS);
+Datum contains_aligned_dna_seq(PG_FUNCTION_ARGS);
+Datum gin_extract_value_aligned_dna(PG_FUNCTION_ARGS);
+Datum gin_extract_query_aligned_dna(PG_FUNCTION_ARGS);
+Datum contains_aligned_rna(PG_FUNCTION_ARGS);
+Datum contains_aligned_rna_seq(PG_FUNCTION_ARGS);
+Datum gin_extract_value_aligned_rna(PG_FUNCTION_ARGS);
+Datum gin_extract_query_aligned_rna(PG_FUNCTION_ARGS);
+Datum contains_aligned_aa(PG_FUNCTION_ARGS);
+Datum contains_aligned_aa_seq(PG_FUNCTION_ARGS);
+Datum gin_extract_value_aligned_aa(PG_FUNCTION_ARGS);
+Datum gin_extract_query_aligned_aa(PG_FUNCTION_ARGS);
+Datum gin_kmer_consistent(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static Datum* kmers_to_datums(uint64* kmers, int32 n_kmers);
+static uint8* decode_pattern(PB_CompressedSequence* pattern, PB_CodeSet** fixed_codesets);
+static Datum contains_text(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+static Datum contains_sequence(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+static Datum gin_extract_value(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+static Datum gin_extract_query(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets);
+
+/*
+ * local functions
+ */
+
+/**
+ * kmers_to_datums()
+ * 		Converts k-mers to int8 datums. Frees the k-mers.
+ *
+ * 	uint64* kmers : k-mers or NULL
+ * 	int32 n_kmers : number of k-mers
+ */
+static Datum* kmers_to_datums(uint64* kmers, int32 n_kmers)
+{
+	Datum* result;
+	int32 i;
+
+	if (!kmers)
+		return NULL;
+
+	result = palloc(sizeof(Datum) * Max(n_kmers, 1));
+	for (i = 0; i < n_kmers; i++)
+		result[i] = Int64GetDatum((int64) kmers[i]);
+
+	pfree(kmers);
+
+	return result;
+}
+
+/**
+ * decode_pattern()
+ * 		Decodes a pattern given as sequence.
+ *
+ * 	PB_CompressedSequence* pattern : detoasted pattern
+ */
+static uint8* decode_pattern(PB_CompressedSequence* pattern, PB_CodeSet** fixed_codesets)
+{
+	uint8* result = palloc(pattern->sequence_length + 1);
+
+	decode((Varlena*) pattern, result, 0, pattern->sequence_length, fixed_codesets);
+
+	return result;
+}
+
+/**
+ * contains_text()
+ * 		Checks whether a sequence contains a pattern given as text.
+ *
+ * 	Varlena* seq : possibly toasted sequence to search in
+ * 	text* pattern : pattern to search for
+ */
+static Datum contains_text(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* pattern = (text*) PG_GETARG_TEXT_PP(1);
+
+	PG_RETURN_BOOL(sequence_strpos(seq,
+								   (uint8*) VARDATA_ANY(pattern),
+								   VARSIZE_ANY_EXHDR(pattern),
+								   fcinfo->flinfo,
+								   fixed_codesets) > 0);
+}
+
+/**
+ * contains_sequence()
+ * 		Checks whether a sequence contains a pattern sequence.
+ *
+ * 	Varlena* seq : possibly toasted sequence to search in
+ * 	PB_CompressedSequence* pattern : pattern to search for
+ */
+static Datum contains_sequence(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	PB_CompressedSequence* pattern = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(1);
+	uint8* decoded = decode_pattern(pattern, fixed_codesets);
+	bool result;
+
+	result = sequence_strpos(seq, decoded, pattern->sequence_length, fcinfo->flinfo, fixed_codesets) > 0;
+
+	pfree(decoded);
+
+	PG_RETURN_BOOL(result);
+}
+
+/**
+ * gin_extract_value()
+ * 		Returns the k-mers of a sequence as index keys.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32* n_keys : set to number of keys
+ */
+static Datum gin_extract_value(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	int32* n_keys = (int32*) PG_GETARG_POINTER(1);
+	uint64* kmers;
+
+	PB_TRACE(errmsg("->gin_extract_value()"));
+
+	kmers = sequence_kmers(seq, PB_KMER_INDEX_LENGTH, n_keys, fixed_codesets);
+
+	PB_TRACE(errmsg("<-gin_extract_value() exits with %d keys", *n_keys));
+
+	PG_RETURN_POINTER(kmers_to_datums(kmers, *n_keys));
+}
+
+/**
+ * gin_extract_query()
+ * 		Returns the k-mers of a pattern as index keys.
+ *
+ * 	Datum pattern : text or sequence, depending on strategy
+ * 	int32* n_keys : set to number of keys
+ * 	StrategyNumber strategy : operator strategy
+ * 	int32* search_mode : set to GIN_SEARCH_MODE_ALL for short patterns
+ */
+static Datum gin_extract_query(FunctionCallInfo fcinfo, PB_CodeSet** fixed_codesets)
+{
+	int32* n_keys = (int32*) PG_GETARG_POINTER(1);
+	StrategyNumber strategy = PG_GETARG_UINT16(2);
+	int32* search_mode = (int32*) PG_GETARG_POINTER(6);
+	uint64* kmers;
+
+	PB_TRACE(errmsg("->gin_extract_query()"));
+
+	if (strategy == PB_KMER_STRATEGY_TEXT)
+	{
+		text* pattern = (text*) PG_GETARG_TEXT_PP(0);
+
+		kmers = string_kmers((uint8*) VARDATA_ANY(pattern),
+							 VARSIZE_ANY_EXHDR(pattern),
+							 PB_KMER_INDEX_LENGTH,
+							 n_keys);
+	}
+	else if (strategy == PB_KMER_STRATEGY_SEQUENCE)
+	{
+		PB_CompressedSequence* pattern = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
+		uint8* decoded = decode_pattern(pattern, fixed_codesets);
+
+		kmers = string_kmers(decoded, pattern->sequence_length, PB_KMER_INDEX_LENGTH, n_keys);
+
+		pfree(decoded);
+	}
+	else
+	{
+		ereport(ERROR,(errmsg("unrecognized strategy number: %d", strategy)));
+		kmers = NULL;
+	}
+
+	/*
+	 * Patterns shorter than a k-mer may be contained in every sequence.
+	 */
+	if (*n_keys == 0)
+		*search_mode = GIN_SEARCH_MODE_ALL;
+
+	PB_TRACE(errmsg("<-gin_extract_query() exits with %d keys", *n_keys));
+
+	PG_RETURN_POINTER(kmers_to_datums(kmers, *n_keys));
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * gin_kmer_consistent()
+ * 		A sequence may contain the pattern, if it contains all k-mers
+ * 		of the pattern. Always needs a recheck.
+ *
+ * 	bool* check : TRUE for each k-mer of the pattern contained in the sequence
+ * 	StrategyNumber strategy : operator strategy
+ * 	Datum query : pattern
+ * 	int32 n_keys : number of k-mers of the pattern
+ * 	bool* recheck : set to TRUE
+ */
+PG_FUNCTION_INFO_V1 (gin_kmer_consistent);
+Datum gin_kmer_consistent(PG_FUNCTION_ARGS)
+{
+	bool* check = (bool*) PG_GETARG_POINTER(0);
+	int32 n_keys = PG_GETARG_INT32(3);
+	bool* recheck = (bool*) PG_GETARG_POINTER(5);
+	int32 i;
+
+	*recheck = TRUE;
+
+	for (i = 0; i < n_keys; i++)
+		if (!check[i])
+			PG_RETURN_BOOL(FALSE);
+
+	PG_RETURN_BOOL(TRUE);
+}
+
+/**
+ * contains_dna()
+ * 		Implements dna_sequence @> text.
+ */
+PG_FUNCTION_INFO_V1 (contains_dna);
+Datum contains_dna(PG_FUNCTION_ARGS)
+{
+	return contains_text(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * contains_dna_seq()
+ * 		Implements dna_sequence @> dna_sequence.
+ */
+PG_FUNCTION_INFO_V1 (contains_dna_seq);
+Datum contains_dna_seq(PG_FUNCTION_ARGS)
+{
+	return contains_sequence(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * gin_extract_value_dna()
+ * 		GIN support function of dna_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_value_dna);
+Datum gin_extract_value_dna(PG_FUNCTION_ARGS)
+{
+	return gin_extract_value(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * gin_extract_query_dna()
+ * 		GIN support function of dna_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_query_dna);
+Datum gin_extract_query_dna(PG_FUNCTION_ARGS)
+{
+	return gin_extract_query(fcinfo, get_fixed_dna_codes());
+}
+
+/**
+ * contains_rna()
+ * 		Implements rna_sequence @> text.
+ */
+PG_FUNCTION_INFO_V1 (contains_rna);
+Datum contains_rna(PG_FUNCTION_ARGS)
+{
+	return contains_text(fcinfo, get_fixed_rna_codes());
+}
+
+/**
+ * contains_rna_seq()
+ * 		Implements rna_sequence @> rna_sequence.
+ */
+PG_FUNCTION_INFO_V1 (contains_rna_seq);
+Datum contains_rna_seq(PG_FUNCTION_ARGS)
+{
+	return contains_sequence(fcinfo, get_fixed_rna_codes());
+}
+
+/**
+ * gin_extract_value_rna()
+ * 		GIN support function of rna_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_value_rna);
+Datum gin_extract_value_rna(PG_FUNCTION_ARGS)
+{
+	return gin_extract_value(fcinfo, get_fixed_rna_codes());
+}
+
+/**
+ * gin_extract_query_rna()
+ * 		GIN support function of rna_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_query_rna);
+Datum gin_extract_query_rna(PG_FUNCTION_ARGS)
+{
+	return gin_extract_query(fcinfo, get_fixed_rna_codes());
+}
+
+/**
+ * contains_aa()
+ * 		Implements aa_sequence @> text.
+ */
+PG_FUNCTION_INFO_V1 (contains_aa);
+Datum contains_aa(PG_FUNCTION_ARGS)
+{
+	return contains_text(fcinfo, get_fixed_aa_codes());
+}
+
+/**
+ * contains_aa_seq()
+ * 		Implements aa_sequence @> aa_sequence.
+ */
+PG_FUNCTION_INFO_V1 (contains_aa_seq);
+Datum contains_aa_seq(PG_FUNCTION_ARGS)
+{
+	return contains_sequence(fcinfo, get_fixed_aa_codes());
+}
+
+/**
+ * gin_extract_value_aa()
+ * 		GIN support function of aa_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_value_aa);
+Datum gin_extract_value_aa(PG_FUNCTION_ARGS)
+{
+	return gin_extract_value(fcinfo, get_fixed_aa_codes());
+}
+
+/**
+ * gin_extract_query_aa()
+ * 		GIN support function of aa_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_query_aa);
+Datum gin_extract_query_aa(PG_FUNCTION_ARGS)
+{
+	return gin_extract_query(fcinfo, get_fixed_aa_codes());
+}
+
+/**
+ * contains_aligned_dna()
+ * 		Implements aligned_dna_sequence @> text.
+ */
+PG_FUNCTION_INFO_V1 (contains_aligned_dna);
+Datum contains_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return contains_text(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * contains_aligned_dna_seq()
+ * 		Implements aligned_dna_sequence @> aligned_dna_sequence.
+ */
+PG_FUNCTION_INFO_V1 (contains_aligned_dna_seq);
+Datum contains_aligned_dna_seq(PG_FUNCTION_ARGS)
+{
+	return contains_sequence(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * gin_extract_value_aligned_dna()
+ * 		GIN support function of aligned_dna_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_value_aligned_dna);
+Datum gin_extract_value_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return gin_extract_value(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * gin_extract_query_aligned_dna()
+ * 		GIN support function of aligned_dna_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_query_aligned_dna);
+Datum gin_extract_query_aligned_dna(PG_FUNCTION_ARGS)
+{
+	return gin_extract_query(fcinfo, get_fixed_aligned_dna_codes());
+}
+
+/**
+ * contains_aligned_rna()
+ * 		Implements aligned_rna_sequence @> text.
+ */
+PG_FUNCTION_INFO_V1 (contains_aligned_rna);
+Datum contains_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return contains_text(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * contains_aligned_rna_seq()
+ * 		Implements aligned_rna_sequence @> aligned_rna_sequence.
+ */
+PG_FUNCTION_INFO_V1 (contains_aligned_rna_seq);
+Datum contains_aligned_rna_seq(PG_FUNCTION_ARGS)
+{
+	return contains_sequence(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * gin_extract_value_aligned_rna()
+ * 		GIN support function of aligned_rna_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_value_aligned_rna);
+Datum gin_extract_value_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return gin_extract_value(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * gin_extract_query_aligned_rna()
+ * 		GIN support function of aligned_rna_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_query_aligned_rna);
+Datum gin_extract_query_aligned_rna(PG_FUNCTION_ARGS)
+{
+	return gin_extract_query(fcinfo, get_fixed_aligned_rna_codes());
+}
+
+/**
+ * contains_aligned_aa()
+ * 		Implements aligned_aa_sequence @> text.
+ */
+PG_FUNCTION_INFO_V1 (contains_aligned_aa);
+Datum contains_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return contains_text(fcinfo, get_fixed_aligned_aa_codes());
+}
+
+/**
+ * contains_aligned_aa_seq()
+ * 		Implements aligned_aa_sequence @> aligned_aa_sequence.
+ */
+PG_FUNCTION_INFO_V1 (contains_aligned_aa_seq);
+Datum contains_aligned_aa_seq(PG_FUNCTION_ARGS)
+{
+	return contains_sequence(fcinfo, get_fixed_aligned_aa_codes());
+}
+
+/**
+ * gin_extract_value_aligned_aa()
+ * 		GIN support function of aligned_aa_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_value_aligned_aa);
+Datum gin_extract_value_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return gin_extract_value(fcinfo, get_fixed_aligned_aa_codes());
+}
+
+/**
+ * gin_extract_query_aligned_aa()
+ * 		GIN support function of aligned_aa_sequence_kmer_ops.
+ */
+PG_FUNCTION_INFO_V1 (gin_extract_query_aligned_aa);
+Datum gin_extract_query_aligned_aa(PG_FUNCTION_ARGS)
+{
+	return gin_extract_query(fcinfo, get_fixed_aligned_aa_codes());
+}
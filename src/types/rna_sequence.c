@@ -20,10 +20,12 @@
 #include "access/tuptoaster.h"
 
 #include "sequence/sequence.h"
+#include "sequence/codebook.h"
 #include "sequence/stats.h"
 #include "sequence/code_set_creation.h"
 #include "sequence/compression.h"
 #include "sequence/functions.h"
+#include "sequence/transfer.h"
 #include "utils/debug.h"
 #include "types/alphabet.h"
 
@@ -291,6 +293,8 @@ PB_CompressedSequence* compress_rna_sequence(uint8* input,
 
 	PB_TRACE(errmsg("->compress_rna_sequence()"));
 
+	info->index_part_shift = typmod.index_part_shift;
+
 	PB_DEBUG1(errmsg("compress_rna_sequence(): low bitmap:%ld high bitmap:%ld",  info->ascii_bitmap_low, info->ascii_bitmap_high));
 
 	/*
@@ -405,6 +409,9 @@ Datum rna_sequence_typmod_in(PG_FUNCTION_ARGS) {
 	bool typeModFlc = false;
 	bool typeModAscii = false;
 
+	int index_part_shift = 0;
+	int shift;
+
 	int i;
 
 	PB_TRACE(errmsg("->rna_sequence_typmod_in()"));
@@ -424,6 +431,8 @@ Datum rna_sequence_typmod_in(PG_FUNCTION_ARGS) {
 			typeModFlc = true;
 		} else if (!strcmp(read_pointer, "ascii")) {
 			typeModAscii = true;
+		} else if ((shift = get_index_part_shift(read_pointer)) >= 0) {
+			index_part_shift = shift;
 		} else {
 			ereport(ERROR,(errmsg("type modifier invalid"),
 					errdetail("Can not recognize type modifier \"%s\".", read_pointer)));
@@ -459,6 +468,8 @@ Datum rna_sequence_typmod_in(PG_FUNCTION_ARGS) {
 		result.restricting_alphabet = PB_RNA_TYPMOD_IUPAC;
 	}
 
+	result.index_part_shift = index_part_shift;
+
 	PB_TRACE(errmsg("<-rna_sequence_typmod_in() returning %d", rna_sequence_typmod_to_int(result)));
 
 	PG_RETURN_INT32(rna_sequence_typmod_to_int(result));
@@ -493,6 +504,10 @@ Datum rna_sequence_typmod_out(PG_FUNCTION_ARGS) {
 		len += 5; /* strlen('IUPAC') = 5, strlen('ASCII') = 5  */
 	}
 
+	if (typmod.index_part_shift > 0) {
+		len += 6; /* strlen(',32768') = 6 */
+	}
+
 	result = palloc0(len);
 	out = result;
 
@@ -518,6 +533,10 @@ Datum rna_sequence_typmod_out(PG_FUNCTION_ARGS) {
 		out+=5;
 	}
 
+	if (typmod.index_part_shift > 0) {
+		out += sprintf(out, ",%d", PB_INDEX_PART_SIZE >> typmod.index_part_shift);
+	}
+
 	*out = ')';
 	out++;
 	*out = 0;
@@ -715,6 +734,60 @@ Datum rna_sequence_out_varlena (PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(result);
 }
 
+/**
+ * rna_sequence_send()
+ * 		Convert a sequence to its external binary representation,
+ * 		which holds the code and the compressed stream.
+ *
+ * 	Varlena* input : possibly toasted compressed input sequence
+ */
+PG_FUNCTION_INFO_V1 (rna_sequence_send);
+Datum rna_sequence_send (PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	bytea* result;
+
+	PB_TRACE(errmsg("->rna_sequence_send()"));
+
+	result = send_sequence(input, fixed_rna_codes);
+
+	PB_TRACE(errmsg("<-rna_sequence_send()"));
+
+	PG_RETURN_BYTEA_P(result);
+}
+
+/**
+ * rna_sequence_recv()
+ * 		Convert a sequence from its external binary representation.
+ * 		The sequence is encoded with the received code, unless type
+ * 		modifiers are given.
+ *
+ * 	StringInfo buf : message buffer
+ * 	Oid oid : oid of the sequence type
+ * 	int typmod : single value representing target type modifier
+ */
+PG_FUNCTION_INFO_V1 (rna_sequence_recv);
+Datum rna_sequence_recv (PG_FUNCTION_ARGS)
+{
+	StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+	int32 typmod = PG_GETARG_INT32(2);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->rna_sequence_recv()"));
+
+	result = receive_sequence(buf, fixed_rna_codes, n_fixed_rna_codes);
+
+	if ((-1) != typmod)
+		result = (PB_CompressedSequence*)
+				 DatumGetPointer(DirectFunctionCall2(rna_sequence_cast,
+													 PointerGetDatum(result),
+													 Int32GetDatum(typmod)));
+
+	PB_TRACE(errmsg("<-rna_sequence_recv()"));
+
+	PG_RETURN_POINTER(result);
+}
+
 /**
  * rna_sequence_substring()
  * 		Decompress a substring of a sequence.
@@ -733,19 +806,20 @@ Datum rna_sequence_substring (PG_FUNCTION_ARGS)
 	int start = PG_GETARG_DATUM(1);
 	int len = PG_GETARG_DATUM(2);
 
-	PB_CompressedSequence* input_header;
+	PB_DetoastCursor* cursor;
+	uint32 sequence_length;
 
 	text* result;
 
 	PB_TRACE(errmsg("->rna_sequence_substring()"));
 
-	input_header = (PB_CompressedSequence*)
-			PG_DETOAST_DATUM_SLICE(input, 0, sizeof(PB_CompressedSequence) - VARHDRSZ);
-
 	if (len < 0) {
 		ereport(ERROR,(errmsg("negative substring length not allowed")));
 	}
 
+	cursor = open_cached_detoast_cursor(fcinfo->flinfo, input);
+	sequence_length = cursor->header->sequence_length;
+
 	/*
 	 * SQL's first position is 1, our first position is 0
 	 */
@@ -754,20 +828,21 @@ Datum rna_sequence_substring (PG_FUNCTION_ARGS)
 		len += start;
 		start = 0;
 	}
-	if (start >= input_header->sequence_length || len < 1) {
+	if (start >= sequence_length || len < 1) {
 		result = palloc0(4);
 		SET_VARSIZE (result, 4);
+		close_detoast_cursor(cursor);
 		PG_RETURN_POINTER(result);
 	}
-	if (start + len > input_header->sequence_length) {
-		len = input_header->sequence_length - start;
+	if (start + len > sequence_length) {
+		len = sequence_length - start;
 	}
 
 	result = palloc0(len + VARHDRSZ);
 	SET_VARSIZE (result, len + VARHDRSZ);
-	decompress_rna_sequence((PB_CompressedSequence*) input,(uint8*) VARDATA(result),start,len);
+	decode_from_cursor(cursor, (uint8*) VARDATA(result), start, len, fixed_rna_codes);
 
-	pfree(input_header);
+	close_detoast_cursor(cursor);
 
 	PB_TRACE(errmsg("<-rna_sequence_substring()"));
 
@@ -782,10 +857,12 @@ Datum rna_sequence_substring (PG_FUNCTION_ARGS)
  */
 PG_FUNCTION_INFO_V1 (rna_sequence_char_length);
 Datum rna_sequence_char_length (PG_FUNCTION_ARGS) {
-	PB_CompressedSequence* rna_seq = (PB_CompressedSequence*)
-			PG_DETOAST_DATUM_SLICE(PG_GETARG_RAW_VARLENA_P(0),0,4);
+	PB_DetoastCursor* cursor = open_cached_detoast_cursor(fcinfo->flinfo, (Varlena*) PG_GETARG_RAW_VARLENA_P(0));
+	const uint32 length = cursor->header->sequence_length;
 
-	PG_RETURN_INT32(rna_seq->sequence_length);
+	close_detoast_cursor(cursor);
+
+	PG_RETURN_INT32(length);
 }
 
 /**
@@ -811,9 +888,17 @@ Datum rna_sequence_compression_ratio (PG_FUNCTION_ARGS) {
 	PG_RETURN_FLOAT8(cr);
 }
 
-static void complement_rna(PB_CompressedSequence* sequence)
+static PB_CompressedSequence* complement_rna(PB_CompressedSequence* sequence)
 {
-	PB_Codeword* codewords = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(sequence);
+	PB_Codeword* codewords;
+
+	/*
+	 * Codebooks are shared, so their codewords cannot be rewritten.
+	 */
+	if (PB_COMPRESSED_SEQUENCE_USES_CODEBOOK(sequence))
+		sequence = encode_without_codebook(sequence, fixed_rna_codes);
+
+	codewords = PB_COMPRESSED_SEQUENCE_SYMBOL_POINTER(sequence);
 
 	if (sequence->is_fixed)
 	{
@@ -904,6 +989,10 @@ static void complement_rna(PB_CompressedSequence* sequence)
 			codewords[i].symbol = symbol;
 		}
 	}
+
+	invalidate_sequence_crc32(sequence);
+
+	return sequence;
 }
 
 /**
@@ -929,7 +1018,7 @@ Datum rna_sequence_complement(PG_FUNCTION_ARGS)
 	result = palloc0(mem_size);
 	memcpy(result, input, mem_size);
 
-	complement_rna(result);
+	result = complement_rna(result);
 
 	PB_TRACE(errmsg("<-rna_sequence_complement()"));
 
@@ -971,7 +1060,7 @@ Datum rna_sequence_reverse_complement(PG_FUNCTION_ARGS)
 
 	result = reverse(input, fixed_rna_codes);
 
-	complement_rna(result);
+	result = complement_rna(result);
 
 	PG_RETURN_POINTER(result);
 }
@@ -1138,12 +1227,12 @@ Datum compare_rna(PG_FUNCTION_ARGS)
  * hash_rna()
  * 		Returns a CRC32 for a RNA sequence.
  *
- * 	PB_CompressedSequence* seq1 : input sequence
+ * 	Varlena* seq1 : possibly toasted input sequence
  */
 PG_FUNCTION_INFO_V1 (hash_rna);
 Datum hash_rna(PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* seq1 = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
+	Varlena* seq1 = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
 	uint32 result;
 
 	PB_TRACE(errmsg("->hash_rna()"));
@@ -1162,19 +1251,49 @@ Datum hash_rna(PG_FUNCTION_ARGS)
 PG_FUNCTION_INFO_V1 (strpos_rna);
 Datum strpos_rna(PG_FUNCTION_ARGS)
 {
-	PB_CompressedSequence* seq = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(0);
-	text* search = (text*) PG_GETARG_VARLENA_P(1);
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* search = (text*) PG_GETARG_TEXT_PP(1);
 	uint32 result;
 
 	PB_TRACE(errmsg("->strpos_rna()"));
 
-	result = sequence_strpos(seq, search, fixed_rna_codes);
+	result = sequence_strpos(seq,
+							 (uint8*) VARDATA_ANY(search),
+							 VARSIZE_ANY_EXHDR(search),
+							 fcinfo->flinfo,
+							 fixed_rna_codes);
 
 	PB_TRACE(errmsg("<-strpos_rna()"));
 
 	PG_RETURN_UINT32(result);
 }
 
+/**
+ * strpos_rna_seq()
+ * 		Finds the first occurrence of a pattern sequence in a sequence.
+ */
+PG_FUNCTION_INFO_V1 (strpos_rna_seq);
+Datum strpos_rna_seq(PG_FUNCTION_ARGS)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	PB_CompressedSequence* search = (PB_CompressedSequence*) PG_GETARG_VARLENA_P(1);
+	uint8* pattern;
+	uint32 result;
+
+	PB_TRACE(errmsg("->strpos_rna_seq()"));
+
+	pattern = palloc(search->sequence_length + 1);
+	decompress_rna_sequence(search, pattern, 0, search->sequence_length);
+
+	result = sequence_strpos(seq, pattern, search->sequence_length, fcinfo->flinfo, fixed_rna_codes);
+
+	pfree(pattern);
+
+	PB_TRACE(errmsg("<-strpos_rna_seq()"));
+
+	PG_RETURN_UINT32(result);
+}
+
 /**
  * octet_length_rna()
  * 		Returns byte size of datum.
@@ -1185,3 +1304,131 @@ Datum octet_length_rna(PG_FUNCTION_ARGS)
 	PG_RETURN_UINT32((uint32) toast_raw_datum_size((Datum) PG_GETARG_RAW_VARLENA_P(0)));
 }
 
+/**
+ * symbol_count_rna()
+ * 		Counts the occurrences of symbols in an RNA sequence.
+ *
+ * 	This function mimics the behaviour of the originals substr function
+ * 	for the optional range. The first position is 1.
+ *
+ * 	Varlena* input : compressed input sequence
+ * 	text* symbols : symbols to count
+ * 	int start : optional position to start from
+ * 	int len : optional number of characters to count
+ */
+PG_FUNCTION_INFO_V1 (symbol_count_rna);
+Datum symbol_count_rna(PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* symbols = PG_GETARG_TEXT_PP(1);
+	int start = PG_NARGS() > 2 ? PG_GETARG_INT32(2) : 1;
+	int len = PG_NARGS() > 2 ? PG_GETARG_INT32(3) : PB_MAX_COMPRESSED_SEQUENCE_SIZE;
+	uint32 result;
+
+	PB_TRACE(errmsg("->symbol_count_rna()"));
+
+	result = sequence_symbol_count(input,
+								   (uint8*) VARDATA_ANY(symbols),
+								   VARSIZE_ANY_EXHDR(symbols),
+								   start,
+								   len,
+								   NULL,
+								   fixed_rna_codes);
+
+	PB_TRACE(errmsg("<-symbol_count_rna() exits with %u", result));
+
+	PG_RETURN_INT64(result);
+}
+
+/**
+ * gc_content_rna()
+ * 		Returns the fraction of G and C in an RNA sequence.
+ * 		Returns NULL for empty ranges.
+ *
+ * 	Like gc_content(alphabet), only upper case G and C are counted.
+ *
+ * 	This function mimics the behaviour of the originals substr function
+ * 	for the optional range. The first position is 1.
+ *
+ * 	Varlena* input : compressed input sequence
+ * 	int start : optional position to start from
+ * 	int len : optional number of characters to count
+ */
+PG_FUNCTION_INFO_V1 (gc_content_rna);
+Datum gc_content_rna(PG_FUNCTION_ARGS)
+{
+	Varlena* input = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	int start = PG_NARGS() > 1 ? PG_GETARG_INT32(1) : 1;
+	int len = PG_NARGS() > 1 ? PG_GETARG_INT32(2) : PB_MAX_COMPRESSED_SEQUENCE_SIZE;
+	uint32 n_gc;
+	uint32 n_counted;
+
+	PB_TRACE(errmsg("->gc_content_rna()"));
+
+	n_gc = sequence_symbol_count(input,
+								 (uint8*) "GC",
+								 2,
+								 start,
+								 len,
+								 &n_counted,
+								 fixed_rna_codes);
+
+	PB_TRACE(errmsg("<-gc_content_rna() counted %u of %u", n_gc, n_counted));
+
+	if (n_counted == 0)
+		PG_RETURN_NULL();
+
+	PG_RETURN_FLOAT4((float4) ((float8) n_gc / n_counted));
+}
+
+/**
+ * concat_rna()
+ * 		Concatenates two RNA sequences.
+ *
+ * 	Varlena* seq1 : first possibly toasted sequence
+ * 	Varlena* seq2 : second possibly toasted sequence
+ */
+PG_FUNCTION_INFO_V1 (concat_rna);
+Datum concat_rna(PG_FUNCTION_ARGS)
+{
+	Varlena* seq1 = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	Varlena* seq2 = (Varlena*) PG_GETARG_RAW_VARLENA_P(1);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->concat_rna()"));
+
+	result = sequence_concat(seq1, seq2, rna_sequence_in, fixed_rna_codes);
+
+	PB_TRACE(errmsg("<-concat_rna()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * overlay_rna()
+ * 		Replaces characters of a RNA sequence, like overlay() does
+ * 		for texts.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	text* replacement : new characters
+ * 	int start : first position to replace, the first position is 1
+ * 	int count : optional number of characters to replace, by default
+ * 				the length of the replacement
+ */
+PG_FUNCTION_INFO_V1 (overlay_rna);
+Datum overlay_rna(PG_FUNCTION_ARGS)
+{
+	Varlena* seq = (Varlena*) PG_GETARG_RAW_VARLENA_P(0);
+	text* replacement = PG_GETARG_TEXT_PP(1);
+	int start = PG_GETARG_INT32(2);
+	int count = PG_NARGS() > 3 ? PG_GETARG_INT32(3) : VARSIZE_ANY_EXHDR(replacement);
+	PB_CompressedSequence* result;
+
+	PB_TRACE(errmsg("->overlay_rna()"));
+
+	result = sequence_overlay(seq, replacement, start, count, rna_sequence_in, fixed_rna_codes);
+
+	PB_TRACE(errmsg("<-overlay_rna()"));
+
+	PG_RETURN_POINTER(result);
+}
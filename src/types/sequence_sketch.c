@@ -0,0 +1,681 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/sequence_sketch.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/gist.h"
+#include "lib/stringinfo.h"
+
+#include "sequence/sequence.h"
+#include "sequence/sketch.h"
+#include "types/dna_sequence.h"
+#include "types/rna_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Type sequence_sketch holds a MinHash sketch of a nucleotide sequence,
+ * computed by sketch(seq, k, size). Sketches estimate the Jaccard index
+ * of the k-mer sets of two sequences and the Mash distance derived from
+ * it, without decoding the sequences.
+ *
+ * The text representation lists the hashes in hexadecimal:
+ *
+ * 	<k>:<size>:[<hash>[,<hash>]*]
+ *
+ * The GiST operator class stores signatures, bitmaps of the hashes of
+ * sketches, and summarizes subtrees by their union. A query hash, whose
+ * bit is not set, is in none of the sketches below. Counting the query
+ * hashes with set bits bounds the shared hashes from above, so the bound
+ * of the Jaccard index gives a lower bound of the distance. Leaves are
+ * lossy, the index rechecks them.
+ *
+ * Strategy	|	Operator
+ * -----------------------------------------------------------
+ * 	3		|	&& (sequence_sketch, sequence_sketch)
+ * 	15		|	<-> (sequence_sketch, sequence_sketch), ORDER BY
+ */
+
+#define PB_SKETCH_FIELD_SEPARATOR	':'
+#define PB_SKETCH_HASH_SEPARATOR	','
+
+#define PB_SKETCH_SIGNATURE_SIZE \
+	(PB_SKETCH_HEADER_SIZE + PB_SKETCH_SIGNATURE_WORDS * sizeof(uint64))
+
+#define PB_SKETCH_SIGNATURE_WORD(signature, hash) \
+	((signature)->data[PB_SKETCH_SIGNATURE_BIT(hash) / 64])
+
+#define PB_SKETCH_SIGNATURE_MASK(hash) \
+	(((uint64) 1) << (PB_SKETCH_SIGNATURE_BIT(hash) % 64))
+
+Datum sequence_sketch_in(PG_FUNCTION_ARGS);
+Datum sequence_sketch_out(PG_FUNCTION_ARGS);
+Datum sketch_dna(PG_FUNCTION_ARGS);
+Datum sketch_rna(PG_FUNCTION_ARGS);
+Datum sketch_k(PG_FUNCTION_ARGS);
+Datum sketch_n_hashes(PG_FUNCTION_ARGS);
+Datum sketch_jaccard_index(PG_FUNCTION_ARGS);
+Datum sketch_mash_distance(PG_FUNCTION_ARGS);
+Datum sketch_overlap(PG_FUNCTION_ARGS);
+Datum gist_sketch_compress(PG_FUNCTION_ARGS);
+Datum gist_sketch_decompress(PG_FUNCTION_ARGS);
+Datum gist_sketch_consistent(PG_FUNCTION_ARGS);
+Datum gist_sketch_union(PG_FUNCTION_ARGS);
+Datum gist_sketch_penalty(PG_FUNCTION_ARGS);
+Datum gist_sketch_picksplit(PG_FUNCTION_ARGS);
+Datum gist_sketch_same(PG_FUNCTION_ARGS);
+Datum gist_sketch_distance(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static uint64 parse_field(char** input, int base, char separator, bool last);
+static inline int popcount64(uint64 word);
+static PB_Sketch* new_signature(void);
+static PB_Sketch* make_signature(const PB_Sketch* sketch);
+static void add_to_signature(PB_Sketch* signature, const PB_Sketch* key);
+static int added_bits(const PB_Sketch* signature, const PB_Sketch* key);
+static uint32 matched_hashes(const PB_Sketch* signature, const PB_Sketch* query);
+
+/*
+ * local functions
+ */
+
+/**
+ * parse_field()
+ * 		Parses an unsigned number followed by a separator and moves
+ * 		the input behind the separator. The last field may also end
+ * 		at the end of the input.
+ */
+static uint64 parse_field(char** input, int base, char separator, bool last)
+{
+	char* end;
+	unsigned long long result;
+
+	if (!isxdigit((unsigned char) **input))
+		goto error;
+
+	errno = 0;
+	result = strtoull(*input, &end, base);
+
+	if (errno != 0 || end == *input)
+		goto error;
+
+	if (*end != separator && !(*end == '\0' && last))
+		goto error;
+
+	*input = *end == '\0' ? end : end + 1;
+
+	return (uint64) result;
+
+error:
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+			 errmsg("invalid input syntax for type sequence_sketch at \"%s\"", *input)));
+
+	return 0;
+}
+
+/**
+ * popcount64()
+ * 		Counts the set bits of a word.
+ */
+static inline int popcount64(uint64 word)
+{
+	word = word - ((word >> 1) & UINT64CONST(0x5555555555555555));
+	word = (word & UINT64CONST(0x3333333333333333)) + ((word >> 2) & UINT64CONST(0x3333333333333333));
+	word = (word + (word >> 4)) & UINT64CONST(0x0f0f0f0f0f0f0f0f);
+
+	return (int) ((word * UINT64CONST(0x0101010101010101)) >> 56);
+}
+
+/**
+ * new_signature()
+ * 		Returns an empty signature, that any key can be added to.
+ */
+static PB_Sketch* new_signature(void)
+{
+	PB_Sketch* result = palloc0(PB_SKETCH_SIGNATURE_SIZE);
+
+	SET_VARSIZE(result, PB_SKETCH_SIGNATURE_SIZE);
+	result->flags = PB_SKETCH_SIGNATURE;
+	result->n_hashes = PG_UINT32_MAX;
+
+	return result;
+}
+
+/**
+ * make_signature()
+ * 		Returns the signature of a sketch.
+ *
+ * 	PB_Sketch* sketch : detoasted sketch
+ */
+static PB_Sketch* make_signature(const PB_Sketch* sketch)
+{
+	PB_Sketch* result = new_signature();
+	uint32 i;
+
+	result->k = sketch->k;
+	result->size = sketch->size;
+	result->n_hashes = sketch->n_hashes;
+
+	for (i = 0; i < sketch->n_hashes; i++)
+		PB_SKETCH_SIGNATURE_WORD(result, sketch->data[i]) |= PB_SKETCH_SIGNATURE_MASK(sketch->data[i]);
+
+	return result;
+}
+
+/**
+ * add_to_signature()
+ * 		Adds a signature to another one.
+ *
+ * 	PB_Sketch* signature : signature to extend
+ * 	PB_Sketch* key : detoasted signature
+ */
+static void add_to_signature(PB_Sketch* signature, const PB_Sketch* key)
+{
+	int i;
+
+	signature->k = Max(signature->k, key->k);
+	signature->size = Max(signature->size, key->size);
+	signature->n_hashes = Min(signature->n_hashes, key->n_hashes);
+
+	for (i = 0; i < PB_SKETCH_SIGNATURE_WORDS; i++)
+		signature->data[i] |= key->data[i];
+}
+
+/**
+ * added_bits()
+ * 		Counts the bits a signature gains from another one.
+ *
+ * 	PB_Sketch* signature : detoasted signature
+ * 	PB_Sketch* key : detoasted signature to add
+ */
+static int added_bits(const PB_Sketch* signature, const PB_Sketch* key)
+{
+	int result = 0;
+	int i;
+
+	for (i = 0; i < PB_SKETCH_SIGNATURE_WORDS; i++)
+		result += popcount64(key->data[i] & ~signature->data[i]);
+
+	return result;
+}
+
+/**
+ * matched_hashes()
+ * 		Counts the hashes of a sketch, whose bits are set in a signature.
+ *
+ * 	PB_Sketch* signature : detoasted signature
+ * 	PB_Sketch* query : detoasted sketch
+ */
+static uint32 matched_hashes(const PB_Sketch* signature, const PB_Sketch* query)
+{
+	uint32 result = 0;
+	uint32 i;
+
+	for (i = 0; i < query->n_hashes; i++)
+		if (PB_SKETCH_SIGNATURE_WORD(signature, query->data[i]) & PB_SKETCH_SIGNATURE_MASK(query->data[i]))
+			result++;
+
+	return result;
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * sequence_sketch_in()
+ * 		Parses the text representation of a sketch.
+ *
+ * 	cstring input : text representation
+ */
+PG_FUNCTION_INFO_V1 (sequence_sketch_in);
+Datum sequence_sketch_in(PG_FUNCTION_ARGS)
+{
+	char* input = PG_GETARG_CSTRING(0);
+	PB_Sketch* result;
+	uint64 k;
+	uint64 size;
+	uint32 n_hashes = 0;
+
+	PB_TRACE(errmsg("->sequence_sketch_in()"));
+
+	k = parse_field(&input, 10, PB_SKETCH_FIELD_SEPARATOR, false);
+	size = parse_field(&input, 10, PB_SKETCH_FIELD_SEPARATOR, false);
+
+	if (k < 1 || k > PB_SKETCH_MAX_KMER_LENGTH || size < 1 || size > PB_SKETCH_MAX_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				 errmsg("k-mer length or size of sequence_sketch out of range")));
+
+	result = palloc0(PB_SKETCH_HEADER_SIZE + size * sizeof(uint64));
+	result->k = k;
+	result->size = size;
+
+	while (*input != '\0')
+	{
+		const uint64 hash = parse_field(&input, 16, PB_SKETCH_HASH_SEPARATOR, true);
+
+		if (n_hashes == size || (n_hashes > 0 && hash <= result->data[n_hashes - 1]))
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					 errmsg("hashes of sequence_sketch must be ascending and at most size many")));
+
+		result->data[n_hashes++] = hash;
+	}
+
+	result->n_hashes = n_hashes;
+	SET_VARSIZE(result, PB_SKETCH_HEADER_SIZE + n_hashes * sizeof(uint64));
+
+	PB_TRACE(errmsg("<-sequence_sketch_in()"));
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * sequence_sketch_out()
+ * 		Returns the text representation of a sketch.
+ *
+ * 	PB_Sketch* input : sketch
+ */
+PG_FUNCTION_INFO_V1 (sequence_sketch_out);
+Datum sequence_sketch_out(PG_FUNCTION_ARGS)
+{
+	PB_Sketch* input = (PB_Sketch*) PG_GETARG_VARLENA_P(0);
+	StringInfoData result;
+	uint32 i;
+
+	PB_TRACE(errmsg("->sequence_sketch_out()"));
+
+	initStringInfo(&result);
+	appendStringInfo(&result, "%u%c%u%c",
+					 input->k, PB_SKETCH_FIELD_SEPARATOR,
+					 input->size, PB_SKETCH_FIELD_SEPARATOR);
+
+	for (i = 0; i < input->n_hashes; i++)
+	{
+		if (i > 0)
+			appendStringInfoChar(&result, PB_SKETCH_HASH_SEPARATOR);
+		appendStringInfo(&result, "%016" INT64_MODIFIER "x", input->data[i]);
+	}
+
+	PB_TRACE(errmsg("<-sequence_sketch_out()"));
+
+	PG_RETURN_CSTRING(result.data);
+}
+
+/**
+ * sketch_dna()
+ * 		Computes the sketch of a DNA sequence.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32 k : length of k-mers
+ * 	int32 size : maximum number of hashes
+ */
+PG_FUNCTION_INFO_V1 (sketch_dna);
+Datum sketch_dna(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(sequence_sketch((Varlena*) PG_GETARG_RAW_VARLENA_P(0),
+									  PG_GETARG_INT32(1),
+									  PG_GETARG_INT32(2),
+									  get_fixed_dna_codes()));
+}
+
+/**
+ * sketch_rna()
+ * 		Computes the sketch of an RNA sequence. U is sketched as T, so
+ * 		sketches of DNA and RNA sequences can be compared.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	int32 k : length of k-mers
+ * 	int32 size : maximum number of hashes
+ */
+PG_FUNCTION_INFO_V1 (sketch_rna);
+Datum sketch_rna(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(sequence_sketch((Varlena*) PG_GETARG_RAW_VARLENA_P(0),
+									  PG_GETARG_INT32(1),
+									  PG_GETARG_INT32(2),
+									  get_fixed_rna_codes()));
+}
+
+/**
+ * sketch_k()
+ * 		Returns the k-mer length of a sketch.
+ */
+PG_FUNCTION_INFO_V1 (sketch_k);
+Datum sketch_k(PG_FUNCTION_ARGS)
+{
+	PB_Sketch* input = (PB_Sketch*) PG_DETOAST_DATUM_SLICE(PG_GETARG_DATUM(0), 0, PB_SKETCH_HEADER_SIZE - VARHDRSZ);
+
+	PG_RETURN_INT32(input->k);
+}
+
+/**
+ * sketch_n_hashes()
+ * 		Returns the number of hashes of a sketch.
+ */
+PG_FUNCTION_INFO_V1 (sketch_n_hashes);
+Datum sketch_n_hashes(PG_FUNCTION_ARGS)
+{
+	PB_Sketch* input = (PB_Sketch*) PG_DETOAST_DATUM_SLICE(PG_GETARG_DATUM(0), 0, PB_SKETCH_HEADER_SIZE - VARHDRSZ);
+
+	PG_RETURN_INT32(input->n_hashes);
+}
+
+/**
+ * sketch_jaccard_index()
+ * 		Estimates the Jaccard index of the k-mer sets of two sketches.
+ */
+PG_FUNCTION_INFO_V1 (sketch_jaccard_index);
+Datum sketch_jaccard_index(PG_FUNCTION_ARGS)
+{
+	PB_Sketch* a = (PB_Sketch*) PG_GETARG_VARLENA_P(0);
+	PB_Sketch* b = (PB_Sketch*) PG_GETARG_VARLENA_P(1);
+
+	PG_RETURN_FLOAT8(sketch_jaccard(a, b));
+}
+
+/**
+ * sketch_mash_distance()
+ * 		Returns the Mash distance of two sketches.
+ */
+PG_FUNCTION_INFO_V1 (sketch_mash_distance);
+Datum sketch_mash_distance(PG_FUNCTION_ARGS)
+{
+	PB_Sketch* a = (PB_Sketch*) PG_GETARG_VARLENA_P(0);
+	PB_Sketch* b = (PB_Sketch*) PG_GETARG_VARLENA_P(1);
+
+	PG_RETURN_FLOAT8(jaccard_to_mash_distance(sketch_jaccard(a, b), a->k));
+}
+
+/**
+ * sketch_overlap()
+ * 		Checks whether two sketches share a hash.
+ */
+PG_FUNCTION_INFO_V1 (sketch_overlap);
+Datum sketch_overlap(PG_FUNCTION_ARGS)
+{
+	PB_Sketch* a = (PB_Sketch*) PG_GETARG_VARLENA_P(0);
+	PB_Sketch* b = (PB_Sketch*) PG_GETARG_VARLENA_P(1);
+	uint32 i = 0;
+	uint32 j = 0;
+
+	while (i < a->n_hashes && j < b->n_hashes)
+	{
+		if (a->data[i] == b->data[j])
+			PG_RETURN_BOOL(true);
+		else if (a->data[i] < b->data[j])
+			i++;
+		else
+			j++;
+	}
+
+	PG_RETURN_BOOL(false);
+}
+
+/**
+ * gist_sketch_compress()
+ * 		Replaces sketches of leaves by their signatures.
+ */
+PG_FUNCTION_INFO_V1 (gist_sketch_compress);
+Datum gist_sketch_compress(PG_FUNCTION_ARGS)
+{
+	GISTENTRY* entry = (GISTENTRY*) PG_GETARG_POINTER(0);
+	GISTENTRY* result;
+	PB_Sketch* sketch;
+
+	if (!entry->leafkey)
+		PG_RETURN_POINTER(entry);
+
+	sketch = (PB_Sketch*) PG_DETOAST_DATUM(entry->key);
+
+	result = palloc(sizeof(GISTENTRY));
+	gistentryinit(*result, PointerGetDatum(make_signature(sketch)),
+				  entry->rel, entry->page, entry->offset, false);
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * gist_sketch_decompress()
+ * 		Detoasts signatures.
+ */
+PG_FUNCTION_INFO_V1 (gist_sketch_decompress);
+Datum gist_sketch_decompress(PG_FUNCTION_ARGS)
+{
+	GISTENTRY* entry = (GISTENTRY*) PG_GETARG_POINTER(0);
+	GISTENTRY* result;
+	PB_Sketch* key = (PB_Sketch*) PG_DETOAST_DATUM(entry->key);
+
+	if (key == (PB_Sketch*) DatumGetPointer(entry->key))
+		PG_RETURN_POINTER(entry);
+
+	result = palloc(sizeof(GISTENTRY));
+	gistentryinit(*result, PointerGetDatum(key),
+				  entry->rel, entry->page, entry->offset, false);
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * gist_sketch_consistent()
+ * 		Checks whether sketches below a signature may share a hash with
+ * 		the query.
+ *
+ * 	GISTENTRY* entry : entry holding a signature
+ * 	PB_Sketch* query : sketch searched for
+ * 	StrategyNumber strategy : operator strategy
+ * 	bool* recheck : set to TRUE, signatures are lossy
+ */
+PG_FUNCTION_INFO_V1 (gist_sketch_consistent);
+Datum gist_sketch_consistent(PG_FUNCTION_ARGS)
+{
+	GISTENTRY* entry = (GISTENTRY*) PG_GETARG_POINTER(0);
+	PB_Sketch* query = (PB_Sketch*) PG_GETARG_VARLENA_P(1);
+	bool* recheck = (bool*) PG_GETARG_POINTER(4);
+	PB_Sketch* key = (PB_Sketch*) DatumGetPointer(entry->key);
+
+	*recheck = true;
+
+	PG_RETURN_BOOL(matched_hashes(key, query) > 0);
+}
+
+/**
+ * gist_sketch_union()
+ * 		Returns the union of signatures.
+ *
+ * 	GistEntryVector* entries : entries holding signatures
+ * 	int* size : set to the size of the union
+ */
+PG_FUNCTION_INFO_V1 (gist_sketch_union);
+Datum gist_sketch_union(PG_FUNCTION_ARGS)
+{
+	GistEntryVector* entries = (GistEntryVector*) PG_GETARG_POINTER(0);
+	int* size = (int*) PG_GETARG_POINTER(1);
+	PB_Sketch* result = new_signature();
+	int i;
+
+	for (i = 0; i < entries->n; i++)
+		add_to_signature(result, (PB_Sketch*) DatumGetPointer(entries->vector[i].key));
+
+	*size = VARSIZE(result);
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * gist_sketch_penalty()
+ * 		Returns the number of bits a signature gains.
+ *
+ * 	GISTENTRY* original : entry of the signature
+ * 	GISTENTRY* new : entry of the signature to add
+ * 	float* penalty : set to the penalty
+ */
+PG_FUNCTION_INFO_V1 (gist_sketch_penalty);
+Datum gist_sketch_penalty(PG_FUNCTION_ARGS)
+{
+	GISTENTRY* original = (GISTENTRY*) PG_GETARG_POINTER(0);
+	GISTENTRY* new = (GISTENTRY*) PG_GETARG_POINTER(1);
+	float* penalty = (float*) PG_GETARG_POINTER(2);
+
+	*penalty = added_bits((PB_Sketch*) DatumGetPointer(original->key),
+						  (PB_Sketch*) DatumGetPointer(new->key));
+
+	PG_RETURN_POINTER(penalty);
+}
+
+/**
+ * gist_sketch_picksplit()
+ * 		Splits a page. The two signatures differing in most bits seed
+ * 		both sides, the other ones join the side gaining less bits.
+ *
+ * 	GistEntryVector* entries : entries of the page
+ * 	GIST_SPLITVEC* split : set to the split
+ */
+PG_FUNCTION_INFO_V1 (gist_sketch_picksplit);
+Datum gist_sketch_picksplit(PG_FUNCTION_ARGS)
+{
+	GistEntryVector* entries = (GistEntryVector*) PG_GETARG_POINTER(0);
+	GIST_SPLITVEC* split = (GIST_SPLITVEC*) PG_GETARG_POINTER(1);
+	const OffsetNumber max_offset = entries->n - 1;
+	PB_Sketch* left;
+	PB_Sketch* right;
+	OffsetNumber seed_left = FirstOffsetNumber;
+	OffsetNumber seed_right = FirstOffsetNumber + 1;
+	int max_difference = -1;
+	OffsetNumber i;
+	OffsetNumber j;
+
+	PB_TRACE(errmsg("->gist_sketch_picksplit()"));
+
+	for (i = FirstOffsetNumber; i < max_offset; i = OffsetNumberNext(i))
+	{
+		const PB_Sketch* a = (PB_Sketch*) DatumGetPointer(entries->vector[i].key);
+
+		for (j = OffsetNumberNext(i); j <= max_offset; j = OffsetNumberNext(j))
+		{
+			const PB_Sketch* b = (PB_Sketch*) DatumGetPointer(entries->vector[j].key);
+			const int difference = added_bits(a, b) + added_bits(b, a);
+
+			if (difference > max_difference)
+			{
+				max_difference = difference;
+				seed_left = i;
+				seed_right = j;
+			}
+		}
+	}
+
+	split->spl_left = palloc(sizeof(OffsetNumber) * entries->n);
+	split->spl_right = palloc(sizeof(OffsetNumber) * entries->n);
+	split->spl_nleft = 0;
+	split->spl_nright = 0;
+
+	left = new_signature();
+	right = new_signature();
+	add_to_signature(left, (PB_Sketch*) DatumGetPointer(entries->vector[seed_left].key));
+	add_to_signature(right, (PB_Sketch*) DatumGetPointer(entries->vector[seed_right].key));
+
+	for (i = FirstOffsetNumber; i <= max_offset; i = OffsetNumberNext(i))
+	{
+		const PB_Sketch* key = (PB_Sketch*) DatumGetPointer(entries->vector[i].key);
+		bool to_left;
+
+		if (i == seed_left)
+			to_left = true;
+		else if (i == seed_right)
+			to_left = false;
+		else
+		{
+			const int left_bits = added_bits(left, key);
+			const int right_bits = added_bits(right, key);
+
+			to_left = left_bits < right_bits ||
+					  (left_bits == right_bits && split->spl_nleft <= split->spl_nright);
+		}
+
+		if (to_left)
+		{
+			add_to_signature(left, key);
+			split->spl_left[split->spl_nleft++] = i;
+		}
+		else
+		{
+			add_to_signature(right, key);
+			split->spl_right[split->spl_nright++] = i;
+		}
+	}
+
+	split->spl_ldatum = PointerGetDatum(left);
+	split->spl_rdatum = PointerGetDatum(right);
+
+	PB_TRACE(errmsg("<-gist_sketch_picksplit() exits with %d left and %d right", split->spl_nleft, split->spl_nright));
+
+	PG_RETURN_POINTER(split);
+}
+
+/**
+ * gist_sketch_same()
+ * 		Checks whether two signatures are equal.
+ */
+PG_FUNCTION_INFO_V1 (gist_sketch_same);
+Datum gist_sketch_same(PG_FUNCTION_ARGS)
+{
+	PB_Sketch* a = (PB_Sketch*) PG_GETARG_POINTER(0);
+	PB_Sketch* b = (PB_Sketch*) PG_GETARG_POINTER(1);
+	bool* result = (bool*) PG_GETARG_POINTER(2);
+
+	*result = VARSIZE(a) == VARSIZE(b) && memcmp(a, b, VARSIZE(a)) == 0;
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * gist_sketch_distance()
+ * 		Returns a lower bound of the Mash distance between the query and
+ * 		the sketches below a signature.
+ *
+ * 	GISTENTRY* entry : entry holding a signature
+ * 	PB_Sketch* query : sketch searched for
+ * 	StrategyNumber strategy : operator strategy
+ * 	bool* recheck : set to TRUE for leaves
+ */
+PG_FUNCTION_INFO_V1 (gist_sketch_distance);
+Datum gist_sketch_distance(PG_FUNCTION_ARGS)
+{
+	GISTENTRY* entry = (GISTENTRY*) PG_GETARG_POINTER(0);
+	PB_Sketch* query = (PB_Sketch*) PG_GETARG_VARLENA_P(1);
+	bool* recheck = (bool*) PG_GETARG_POINTER(4);
+	PB_Sketch* key = (PB_Sketch*) DatumGetPointer(entry->key);
+	const uint32 n_union = Min(query->n_hashes, key->n_hashes);
+	double jaccard;
+
+	/*
+	 * Shared hashes are among the matched ones and the union of two
+	 * sketches has at least as many hashes as the smaller one. Hashes
+	 * only match for sketches with hashes.
+	 */
+	jaccard = Min(1.0, (double) matched_hashes(key, query) / Max(n_union, 1));
+
+	if (GIST_LEAF(entry))
+		*recheck = true;
+
+	PG_RETURN_FLOAT8(jaccard_to_mash_distance(jaccard, query->k));
+}
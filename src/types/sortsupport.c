@@ -0,0 +1,341 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/sortsupport.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/hash.h"
+#include "lib/hyperloglog.h"
+#include "utils/sortsupport.h"
+
+#include "sequence/sequence.h"
+#include "sequence/compression.h"
+#include "sequence/detoast_cursor.h"
+#include "sequence/functions.h"
+#include "types/dna_sequence.h"
+#include "types/rna_sequence.h"
+#include "types/aa_sequence.h"
+#include "types/aligned_dna_sequence.h"
+#include "types/aligned_rna_sequence.h"
+#include "types/aligned_aa_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Sort support for the btree operator classes.
+ *
+ * Sorts, e.g. for CREATE INDEX or ORDER BY, compare abbreviated keys
+ * first, that hold the first symbols of a sequence. Only if these are
+ * equal, the sequences are compared with sequence_compare(), which
+ * decodes them. The key of a sequence is computed once from the first
+ * symbols, which are decoded from the header and the start of the stream.
+ *
+ * Sequences are ordered by their bytes. Each byte is mapped to a rank
+ * of a few bits, that keeps this order. The symbols, that are common for
+ * a type, get a rank of their own, all bytes between two of them share
+ * a rank. The key ends after the first symbol of a shared rank, so two
+ * keys can only be different, if the sequences are. The rank 0 fills
+ * the key after its end, so prefixes are sorted first.
+ */
+
+/**
+ * Bits of an abbreviated key.
+ */
+#define PB_ABBREV_KEY_BITS	(SIZEOF_DATUM * BITS_PER_BYTE)
+
+/**
+ * Abbreviation is given up, if on average more than this many
+ * tuples share a key. The estimate is checked at increasing numbers
+ * of tuples, starting with PB_ABBREV_MIN_TUPLES.
+ */
+#define PB_ABBREV_MAX_TUPLES_PER_KEY	1000
+#define PB_ABBREV_MIN_TUPLES			10000
+
+/**
+ * Symbols with a rank of their own, sorted by byte.
+ */
+#define PB_DNA_RANKED_SYMBOLS			"ACGNT"
+#define PB_RNA_RANKED_SYMBOLS			"ACGNU"
+#define PB_AA_RANKED_SYMBOLS			"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+#define PB_ALIGNED_DNA_RANKED_SYMBOLS	"-.ACGNT"
+#define PB_ALIGNED_RNA_RANKED_SYMBOLS	"-.ACGNU"
+#define PB_ALIGNED_AA_RANKED_SYMBOLS	"-.ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+
+/**
+ * State of a sort.
+ *
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ * 	uint8 ranks : rank of each byte, odd ranks are shared
+ * 	int rank_bits : bits per rank
+ * 	int n_key_symbols : symbols per key
+ * 	uint8* buffer : space for the decoded symbols of a key
+ * 	hyperLogLogState n_distinct_keys : estimate of the distinct keys
+ * 	int next_check : number of tuples at the next abort check
+ */
+typedef struct {
+	PB_CodeSet** fixed_codesets;
+	uint8 ranks[PB_SOURCE_ALPHABET_SIZE];
+	int rank_bits;
+	int n_key_symbols;
+	uint8* buffer;
+	hyperLogLogState n_distinct_keys;
+	int next_check;
+} PB_SortSupportState;
+
+Datum sortsupport_dna(PG_FUNCTION_ARGS);
+Datum sortsupport_rna(PG_FUNCTION_ARGS);
+Datum sortsupport_aa(PG_FUNCTION_ARGS);
+Datum sortsupport_aligned_dna(PG_FUNCTION_ARGS);
+Datum sortsupport_aligned_rna(PG_FUNCTION_ARGS);
+Datum sortsupport_aligned_aa(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static int sequence_fastcmp(Datum x, Datum y, SortSupport ssup);
+static int abbrev_compare(Datum x, Datum y, SortSupport ssup);
+static Datum abbrev_convert(Datum original, SortSupport ssup);
+static bool abbrev_abort(int memtupcount, SortSupport ssup);
+static void init_sortsupport(SortSupport ssup,
+							 const char* ranked_symbols,
+							 PB_CodeSet** fixed_codesets);
+
+/*
+ * local functions
+ */
+
+/**
+ * sequence_fastcmp()
+ * 		Compares two sequences as a whole.
+ */
+static int sequence_fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+	PB_SortSupportState* state = (PB_SortSupportState*) ssup->ssup_extra;
+
+	return sequence_compare((Varlena*) DatumGetPointer(x),
+							(Varlena*) DatumGetPointer(y),
+							state->fixed_codesets);
+}
+
+/**
+ * abbrev_compare()
+ * 		Compares two abbreviated keys.
+ */
+static int abbrev_compare(Datum x, Datum y, SortSupport ssup)
+{
+	return (x > y) - (x < y);
+}
+
+/**
+ * abbrev_convert()
+ * 		Computes the abbreviated key of a sequence.
+ *
+ * 	Datum original : possibly toasted sequence
+ */
+static Datum abbrev_convert(Datum original, SortSupport ssup)
+{
+	PB_SortSupportState* state = (PB_SortSupportState*) ssup->ssup_extra;
+	PB_DetoastCursor* cursor;
+	uint32 length;
+	Datum result = 0;
+	uint32 i;
+
+	cursor = open_detoast_cursor((Varlena*) DatumGetPointer(original));
+	length = Min(cursor->header->sequence_length, state->n_key_symbols);
+	decode_from_cursor(cursor, state->buffer, 0, length, state->fixed_codesets);
+	close_detoast_cursor(cursor);
+
+	for (i = 0; i < length; i++)
+	{
+		const uint8 rank = state->ranks[state->buffer[i]];
+
+		result |= ((Datum) rank) << (PB_ABBREV_KEY_BITS - (i + 1) * state->rank_bits);
+
+		/*
+		 * A shared rank does not tell, which of its bytes is behind it.
+		 */
+		if (rank & 1)
+			break;
+	}
+
+#if SIZEOF_DATUM == 8
+	addHyperLogLog(&state->n_distinct_keys,
+				   DatumGetUInt32(hash_uint32((uint32) (result ^ (result >> 32)))));
+#else
+	addHyperLogLog(&state->n_distinct_keys, DatumGetUInt32(hash_uint32((uint32) result)));
+#endif
+
+	return result;
+}
+
+/**
+ * abbrev_abort()
+ * 		Returns TRUE, if too many tuples share an abbreviated key
+ * 		for abbreviation to pay off.
+ *
+ * 	int memtupcount : number of tuples converted so far
+ */
+static bool abbrev_abort(int memtupcount, SortSupport ssup)
+{
+	PB_SortSupportState* state = (PB_SortSupportState*) ssup->ssup_extra;
+	double n_distinct;
+
+	if (memtupcount < state->next_check)
+		return FALSE;
+
+	state->next_check = memtupcount * 2;
+
+	n_distinct = estimateHyperLogLog(&state->n_distinct_keys);
+
+	PB_DEBUG1(errmsg("abbrev_abort(): %f distinct keys in %d tuples", n_distinct, memtupcount));
+
+	return n_distinct * PB_ABBREV_MAX_TUPLES_PER_KEY < memtupcount;
+}
+
+/**
+ * init_sortsupport()
+ * 		Sets up sorting of a type.
+ *
+ * 	SortSupport ssup : sort support to fill
+ * 	char* ranked_symbols : symbols with a rank of their own, sorted by byte
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+static void init_sortsupport(SortSupport ssup,
+							 const char* ranked_symbols,
+							 PB_CodeSet** fixed_codesets)
+{
+	PB_SortSupportState* state;
+	MemoryContext oldcontext;
+	const int n_ranked = strlen(ranked_symbols);
+	int rank;
+	int i;
+
+	oldcontext = MemoryContextSwitchTo(ssup->ssup_cxt);
+
+	state = palloc0(sizeof(PB_SortSupportState));
+	state->fixed_codesets = fixed_codesets;
+
+	/*
+	 * Ranked symbols get even ranks from 2, the bytes before, between
+	 * and after them odd ranks.
+	 */
+	rank = 1;
+	for (i = 0; i < PB_SOURCE_ALPHABET_SIZE; i++)
+	{
+		if (rank / 2 < n_ranked && i == (uint8) ranked_symbols[rank / 2])
+		{
+			state->ranks[i] = rank + 1;
+			rank += 2;
+		}
+		else
+			state->ranks[i] = rank;
+	}
+
+	state->rank_bits = 1;
+	while ((1 << state->rank_bits) <= 2 * n_ranked + 1)
+		state->rank_bits++;
+	state->n_key_symbols = PB_ABBREV_KEY_BITS / state->rank_bits;
+	state->buffer = palloc(state->n_key_symbols);
+	state->next_check = PB_ABBREV_MIN_TUPLES;
+
+	ssup->ssup_extra = state;
+	ssup->comparator = sequence_fastcmp;
+
+	if (ssup->abbreviate)
+	{
+		initHyperLogLog(&state->n_distinct_keys, 10);
+
+		ssup->abbrev_full_comparator = ssup->comparator;
+		ssup->comparator = abbrev_compare;
+		ssup->abbrev_converter = abbrev_convert;
+		ssup->abbrev_abort = abbrev_abort;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * sortsupport_dna()
+ * 		Sort support of dna_sequence.
+ */
+PG_FUNCTION_INFO_V1 (sortsupport_dna);
+Datum sortsupport_dna(PG_FUNCTION_ARGS)
+{
+	init_sortsupport((SortSupport) PG_GETARG_POINTER(0), PB_DNA_RANKED_SYMBOLS, get_fixed_dna_codes());
+
+	PG_RETURN_VOID();
+}
+
+/**
+ * sortsupport_rna()
+ * 		Sort support of rna_sequence.
+ */
+PG_FUNCTION_INFO_V1 (sortsupport_rna);
+Datum sortsupport_rna(PG_FUNCTION_ARGS)
+{
+	init_sortsupport((SortSupport) PG_GETARG_POINTER(0), PB_RNA_RANKED_SYMBOLS, get_fixed_rna_codes());
+
+	PG_RETURN_VOID();
+}
+
+/**
+ * sortsupport_aa()
+ * 		Sort support of aa_sequence.
+ */
+PG_FUNCTION_INFO_V1 (sortsupport_aa);
+Datum sortsupport_aa(PG_FUNCTION_ARGS)
+{
+	init_sortsupport((SortSupport) PG_GETARG_POINTER(0), PB_AA_RANKED_SYMBOLS, get_fixed_aa_codes());
+
+	PG_RETURN_VOID();
+}
+
+/**
+ * sortsupport_aligned_dna()
+ * 		Sort support of aligned_dna_sequence.
+ */
+PG_FUNCTION_INFO_V1 (sortsupport_aligned_dna);
+Datum sortsupport_aligned_dna(PG_FUNCTION_ARGS)
+{
+	init_sortsupport((SortSupport) PG_GETARG_POINTER(0), PB_ALIGNED_DNA_RANKED_SYMBOLS, get_fixed_aligned_dna_codes());
+
+	PG_RETURN_VOID();
+}
+
+/**
+ * sortsupport_aligned_rna()
+ * 		Sort support of aligned_rna_sequence.
+ */
+PG_FUNCTION_INFO_V1 (sortsupport_aligned_rna);
+Datum sortsupport_aligned_rna(PG_FUNCTION_ARGS)
+{
+	init_sortsupport((SortSupport) PG_GETARG_POINTER(0), PB_ALIGNED_RNA_RANKED_SYMBOLS, get_fixed_aligned_rna_codes());
+
+	PG_RETURN_VOID();
+}
+
+/**
+ * sortsupport_aligned_aa()
+ * 		Sort support of aligned_aa_sequence.
+ */
+PG_FUNCTION_INFO_V1 (sortsupport_aligned_aa);
+Datum sortsupport_aligned_aa(PG_FUNCTION_ARGS)
+{
+	init_sortsupport((SortSupport) PG_GETARG_POINTER(0), PB_ALIGNED_AA_RANKED_SYMBOLS, get_fixed_aligned_aa_codes());
+
+	PG_RETURN_VOID();
+}
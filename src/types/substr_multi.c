@@ -0,0 +1,377 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/types/substr_multi.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/rangetypes.h"
+#include "utils/typcache.h"
+
+#include "sequence/sequence.h"
+#include "sequence/compression.h"
+#include "types/dna_sequence.h"
+#include "utils/debug.h"
+
+/*
+ * Extraction of many intervals of one sequence.
+ *
+ * substr_multi() returns the intervals given as int4range[] as rows of
+ * (n, subsequence), where n is the position of the interval in the
+ * array. The intervals are sorted by their start and the rows are
+ * returned in this order, so the sequence is read from front to back
+ * through one detoast cursor.
+ *
+ * Intervals are decoded in windows. A window starts at an interval and
+ * takes the following intervals, as long as they start less than an
+ * index part behind its end: decoding the gap is cheaper than starting
+ * again at an index entry, which decodes up to an index part. Windows
+ * are bounded by PB_SUBSTR_MULTI_WINDOW_SIZE or the longest interval.
+ * Overlapping and nested intervals are cut from the same window.
+ */
+
+/**
+ * Maximum number of characters of a window, unless one interval is longer.
+ */
+#define PB_SUBSTR_MULTI_WINDOW_SIZE	(4 * 1024 * 1024)
+
+/**
+ * An interval to extract.
+ *
+ * 	uint32 start : first position, the first position is 0
+ * 	uint32 length : number of characters, 0 for empty intervals
+ * 	int32 n : position of the interval in the array, starting at 1
+ * 	bool is_null : TRUE for NULL ranges
+ * 	bool reverse_complement : TRUE to return the reverse complement
+ */
+typedef struct {
+	uint32 start;
+	uint32 length;
+	int32 n;
+	bool is_null;
+	bool reverse_complement;
+} PB_Interval;
+
+/**
+ * State of substr_multi() kept across calls.
+ */
+typedef struct {
+	PB_DetoastCursor* cursor;
+	PB_CodeSet** fixed_codesets;
+	PB_Interval* intervals;
+	int n_intervals;
+	int next;
+	uint8* window;
+	uint32 window_capacity;
+	uint32 window_start;
+	uint32 window_length;
+} PB_IntervalReader;
+
+Datum substr_multi_dna(PG_FUNCTION_ARGS);
+
+/*
+ * local function declarations
+ */
+
+static int compare_intervals(const void* a, const void* b);
+static PB_IntervalReader* open_interval_reader(Varlena* raw_seq,
+											   ArrayType* ranges,
+											   ArrayType* reverse_complement,
+											   PB_CodeSet** fixed_codesets);
+static void decode_window(PB_IntervalReader* reader, const PB_Interval* interval);
+static text* get_interval(PB_IntervalReader* reader, const PB_Interval* interval);
+
+/*
+ * local functions
+ */
+
+/**
+ * compare_intervals()
+ * 		qsort() comparator ordering intervals by start and position
+ * 		in the array.
+ */
+static int compare_intervals(const void* a, const void* b)
+{
+	const PB_Interval* x = (const PB_Interval*) a;
+	const PB_Interval* y = (const PB_Interval*) b;
+
+	if (x->start != y->start)
+		return x->start < y->start ? -1 : 1;
+
+	return x->n < y->n ? -1 : (x->n > y->n ? 1 : 0);
+}
+
+/**
+ * open_interval_reader()
+ * 		Creates the state of substr_multi() in the current memory context.
+ *
+ * 	Varlena* raw_seq : possibly toasted sequence
+ * 	ArrayType* ranges : int4range[] of positions, the first position is 1
+ * 	ArrayType* reverse_complement : bool[] with an element per range or empty
+ * 	PB_CodeSet** fixed_codesets : fixed codes of the type
+ */
+static PB_IntervalReader* open_interval_reader(Varlena* raw_seq,
+											   ArrayType* ranges,
+											   ArrayType* reverse_complement,
+											   PB_CodeSet** fixed_codesets)
+{
+	PB_IntervalReader* reader;
+	TypeCacheEntry* typcache;
+	Datum* range_datums;
+	bool* range_nulls;
+	Datum* strand_datums = NULL;
+	bool* strand_nulls = NULL;
+	int n_strands = 0;
+	int16 typlen;
+	bool typbyval;
+	char typalign;
+	uint32 sequence_length;
+	int i;
+
+	reader = palloc0(sizeof(PB_IntervalReader));
+	reader->fixed_codesets = fixed_codesets;
+
+	typcache = lookup_type_cache(ARR_ELEMTYPE(ranges), TYPECACHE_RANGE_INFO);
+	get_typlenbyvalalign(ARR_ELEMTYPE(ranges), &typlen, &typbyval, &typalign);
+	deconstruct_array(ranges, ARR_ELEMTYPE(ranges), typlen, typbyval, typalign,
+					  &range_datums, &range_nulls, &reader->n_intervals);
+
+	if (ArrayGetNItems(ARR_NDIM(reverse_complement), ARR_DIMS(reverse_complement)) > 0)
+	{
+		deconstruct_array(reverse_complement, BOOLOID, 1, true, 'c',
+						  &strand_datums, &strand_nulls, &n_strands);
+
+		if (n_strands != reader->n_intervals)
+			ereport(ERROR,
+					(errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+					 errmsg("ranges and reverse_complement must have the same number of elements")));
+	}
+
+	reader->cursor = open_detoast_cursor(raw_seq);
+	sequence_length = reader->cursor->header->sequence_length;
+
+	reader->intervals = palloc0(Max(reader->n_intervals, 1) * sizeof(PB_Interval));
+	for (i = 0; i < reader->n_intervals; i++)
+	{
+		PB_Interval* interval = &reader->intervals[i];
+		RangeBound lower;
+		RangeBound upper;
+		bool empty;
+		int64 start = 1;
+		int64 end = (int64) sequence_length + 1;
+
+		interval->n = i + 1;
+		interval->reverse_complement = n_strands > 0 && !strand_nulls[i] && DatumGetBool(strand_datums[i]);
+
+		if (range_nulls[i])
+		{
+			interval->is_null = TRUE;
+			continue;
+		}
+
+		/*
+		 * int4range is canonical, the lower bound is inclusive and the
+		 * upper bound exclusive.
+		 */
+		range_deserialize(typcache, DatumGetRangeTypeP(range_datums[i]), &lower, &upper, &empty);
+
+		if (empty)
+			continue;
+		if (!lower.infinite)
+			start = Max(start, DatumGetInt32(lower.val));
+		if (!upper.infinite)
+			end = Min(end, DatumGetInt32(upper.val));
+
+		if (end > start)
+		{
+			interval->start = start - 1;
+			interval->length = end - start;
+		}
+		else if (start <= sequence_length)
+			interval->start = start - 1;
+		else
+			interval->start = sequence_length;
+	}
+
+	qsort(reader->intervals, reader->n_intervals, sizeof(PB_Interval), compare_intervals);
+
+	PB_DEBUG1(errmsg("open_interval_reader(): %d intervals of a sequence of %u characters",
+					 reader->n_intervals, sequence_length));
+
+	return reader;
+}
+
+/**
+ * decode_window()
+ * 		Decodes the window starting with an interval.
+ */
+static void decode_window(PB_IntervalReader* reader, const PB_Interval* interval)
+{
+	const uint32 window_start = interval->start;
+	uint64 window_end = (uint64) interval->start + interval->length;
+	int i;
+
+	for (i = reader->next + 1; i < reader->n_intervals; i++)
+	{
+		const PB_Interval* next = &reader->intervals[i];
+		const uint64 next_end = (uint64) next->start + next->length;
+
+		if (next->is_null || next->length == 0)
+			continue;
+
+		if (next->start > window_end + PB_INDEX_PART_SIZE ||
+			Max(window_end, next_end) - window_start > PB_SUBSTR_MULTI_WINDOW_SIZE)
+			break;
+
+		window_end = Max(window_end, next_end);
+	}
+
+	reader->window_start = window_start;
+	reader->window_length = window_end - window_start;
+
+	if (reader->window_length > reader->window_capacity)
+	{
+		if (reader->window)
+			pfree(reader->window);
+		reader->window_capacity = reader->window_length;
+		reader->window = palloc(reader->window_capacity);
+	}
+
+	decode_from_cursor(reader->cursor,
+					   reader->window,
+					   reader->window_start,
+					   reader->window_length,
+					   reader->fixed_codesets);
+
+	PB_DEBUG1(errmsg("decode_window(): decoded %u characters at %u",
+					 reader->window_length, reader->window_start));
+}
+
+/**
+ * get_interval()
+ * 		Returns an interval from the window as text.
+ */
+static text* get_interval(PB_IntervalReader* reader, const PB_Interval* interval)
+{
+	const uint8* input = reader->window + (interval->start - reader->window_start);
+	text* result;
+	uint8* output;
+	uint32 i;
+
+	if (!interval->reverse_complement)
+		return cstring_to_text_with_len((const char*) input, interval->length);
+
+	result = palloc(interval->length + VARHDRSZ);
+	SET_VARSIZE(result, interval->length + VARHDRSZ);
+	output = (uint8*) VARDATA(result);
+
+	for (i = 0; i < interval->length; i++)
+		output[i] = complement_dna_symbol(input[interval->length - 1 - i]);
+
+	return result;
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * substr_multi_dna()
+ * 		Returns intervals of a dna_sequence as (n int, subsequence text)
+ * 		ordered by start.
+ *
+ * 	Varlena* seq : possibly toasted sequence
+ * 	ArrayType* ranges : int4range[] of positions, the first position is 1
+ * 	ArrayType* reverse_complement : bool[] with an element per range or empty
+ */
+PG_FUNCTION_INFO_V1 (substr_multi_dna);
+Datum substr_multi_dna(PG_FUNCTION_ARGS)
+{
+	FuncCallContext* funcctx;
+	PB_IntervalReader* reader;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		PB_TRACE(errmsg("->substr_multi_dna()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = open_interval_reader((Varlena*) PG_GETARG_RAW_VARLENA_P(0),
+												  PG_GETARG_ARRAYTYPE_P(1),
+												  PG_GETARG_ARRAYTYPE_P(2),
+												  get_fixed_dna_codes());
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	reader = (PB_IntervalReader*) funcctx->user_fctx;
+
+	if (reader->next < reader->n_intervals)
+	{
+		const PB_Interval* interval = &reader->intervals[reader->next];
+		Datum values[2];
+		bool nulls[2] = {false, false};
+
+		values[0] = Int32GetDatum(interval->n);
+
+		if (interval->is_null)
+		{
+			values[1] = (Datum) 0;
+			nulls[1] = true;
+		}
+		else
+		{
+			if (interval->length > 0 &&
+				(interval->start < reader->window_start ||
+				 interval->start + interval->length > reader->window_start + reader->window_length))
+			{
+				/*
+				 * The window and data prefetched by the cursor must
+				 * survive this call.
+				 */
+				MemoryContext oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+				decode_window(reader, interval);
+				MemoryContextSwitchTo(oldcontext);
+			}
+
+			values[1] = PointerGetDatum(interval->length > 0 ?
+										get_interval(reader, interval) :
+										cstring_to_text_with_len("", 0));
+		}
+
+		reader->next++;
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	close_detoast_cursor(reader->cursor);
+
+	PB_TRACE(errmsg("<-substr_multi_dna()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
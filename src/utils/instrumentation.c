@@ -0,0 +1,259 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   src/utils/instrumentation.c
+*
+*-------------------------------------------------------------------------
+*/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "access/htup_details.h"
+#include "access/xact.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+
+#include "utils/instrumentation.h"
+#include "utils/debug.h"
+
+/*
+ * Every backend counts into pb_counters. If the library is loaded through
+ * shared_preload_libraries, the increase of the counters is added to
+ * counters in shared memory at the end of each transaction, so the work
+ * of all backends can be seen from any of them. Without preloading the
+ * cluster wide counters are NULL.
+ */
+
+Datum postbis_stat(PG_FUNCTION_ARGS);
+Datum postbis_stat_reset(PG_FUNCTION_ARGS);
+
+/**
+ * Counters in shared memory.
+ *
+ * 	slock_t mutex : protects counters
+ * 	PB_Counters counters : sum of the counters of all backends
+ */
+typedef struct {
+	slock_t mutex;
+	PB_Counters counters;
+} PB_SharedCounters;
+
+PB_Counters pb_counters;
+
+/*
+ * Names of the counters in the order of PB_Counters.
+ */
+static const char* const counter_names[PB_N_COUNTERS] = {
+	"symbols_encoded_equal_length",
+	"symbols_encoded_huffman",
+	"symbols_encoded_rle",
+	"symbols_encoded_swapped",
+	"symbols_encoded_swapped_rle",
+	"symbols_decoded_equal_length",
+	"symbols_decoded_huffman",
+	"symbols_decoded_rle",
+	"symbols_decoded_swapped",
+	"symbols_decoded_swapped_rle",
+	"bytes_detoasted",
+	"bytes_read",
+	"toast_slice_fetches",
+	"cursor_cache_hits",
+	"decoding_map_builds",
+	"huffman_code_builds",
+	"strpos_searches",
+	"strpos_state_bytes"
+};
+
+static PB_SharedCounters* shared_counters = NULL;
+static PB_Counters flushed_counters;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+/*
+ * local function declarations
+ */
+
+static void shared_counters_startup(void);
+static void flush_counters(void);
+static void counters_xact_callback(XactEvent event, void* arg);
+
+/*
+ * local functions
+ */
+
+/**
+ * shared_counters_startup()
+ * 		Attaches to the shared counters, creates them in the first backend.
+ */
+static void shared_counters_startup(void)
+{
+	bool found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	shared_counters = ShmemInitStruct("postbis counters", sizeof(PB_SharedCounters), &found);
+	if (!found)
+	{
+		SpinLockInit(&shared_counters->mutex);
+		memset(&shared_counters->counters, 0, sizeof(PB_Counters));
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/**
+ * flush_counters()
+ * 		Adds the increase of the backend counters since the last flush to
+ * 		the shared counters.
+ */
+static void flush_counters(void)
+{
+	const uint64* current = (const uint64*) &pb_counters;
+	const uint64* flushed = (const uint64*) &flushed_counters;
+	uint64* shared;
+	int i;
+
+	if (shared_counters == NULL)
+		return;
+
+	SpinLockAcquire(&shared_counters->mutex);
+	shared = (uint64*) &shared_counters->counters;
+	for (i = 0; i < PB_N_COUNTERS; i++)
+		shared[i] += current[i] - flushed[i];
+	SpinLockRelease(&shared_counters->mutex);
+
+	flushed_counters = pb_counters;
+}
+
+/**
+ * counters_xact_callback()
+ * 		Flushes the counters at the end of a transaction.
+ */
+static void counters_xact_callback(XactEvent event, void* arg)
+{
+	if (event != XACT_EVENT_COMMIT &&
+		event != XACT_EVENT_ABORT &&
+		event != XACT_EVENT_PREPARE)
+		return;
+
+	flush_counters();
+}
+
+/*
+ * public functions
+ */
+
+/**
+ * init_shared_counters()
+ * 		Requests shared memory for counters of all backends, if the
+ * 		library is loaded through shared_preload_libraries.
+ */
+void init_shared_counters(void)
+{
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	RequestAddinShmemSpace(MAXALIGN(sizeof(PB_SharedCounters)));
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = shared_counters_startup;
+
+	RegisterXactCallback(counters_xact_callback, NULL);
+}
+
+/**
+ * postbis_stat()
+ * 		Returns the counters as rows of (counter, backend, cluster).
+ * 		cluster is NULL, if the library was not preloaded.
+ */
+PG_FUNCTION_INFO_V1 (postbis_stat);
+Datum postbis_stat(PG_FUNCTION_ARGS)
+{
+	FuncCallContext* funcctx;
+	uint64* cluster;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc tupdesc;
+
+		PB_TRACE(errmsg("->postbis_stat()"));
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			ereport(ERROR,(errmsg("function returning record called in context that cannot accept type record")));
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		/*
+		 * Take a snapshot of the shared counters including this backend.
+		 */
+		if (shared_counters)
+		{
+			flush_counters();
+
+			cluster = palloc(sizeof(PB_Counters));
+			SpinLockAcquire(&shared_counters->mutex);
+			memcpy(cluster, &shared_counters->counters, sizeof(PB_Counters));
+			SpinLockRelease(&shared_counters->mutex);
+
+			funcctx->user_fctx = cluster;
+		}
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	cluster = (uint64*) funcctx->user_fctx;
+
+	if (funcctx->call_cntr < PB_N_COUNTERS)
+	{
+		const int i = funcctx->call_cntr;
+		Datum values[3];
+		bool nulls[3] = {false, false, cluster == NULL};
+
+		values[0] = CStringGetTextDatum(counter_names[i]);
+		values[1] = Int64GetDatum((int64) ((uint64*) &pb_counters)[i]);
+		values[2] = cluster ? Int64GetDatum((int64) cluster[i]) : (Datum) 0;
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+	}
+
+	PB_TRACE(errmsg("<-postbis_stat()"));
+
+	SRF_RETURN_DONE(funcctx);
+}
+
+/**
+ * postbis_stat_reset()
+ * 		Sets the counters of this backend and the shared counters to zero.
+ */
+PG_FUNCTION_INFO_V1 (postbis_stat_reset);
+Datum postbis_stat_reset(PG_FUNCTION_ARGS)
+{
+	memset(&pb_counters, 0, sizeof(PB_Counters));
+	memset(&flushed_counters, 0, sizeof(PB_Counters));
+
+	if (shared_counters)
+	{
+		SpinLockAcquire(&shared_counters->mutex);
+		memset(&shared_counters->counters, 0, sizeof(PB_Counters));
+		SpinLockRelease(&shared_counters->mutex);
+	}
+
+	PG_RETURN_VOID();
+}
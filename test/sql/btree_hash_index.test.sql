@@ -36,6 +36,11 @@ SELECT 'ACGT'::dna_sequence >= 'ACGT'::dna_sequence; /* t */
 SELECT 'ACGT'::dna_sequence >= 'ACTT'::dna_sequence; /* f */
 SELECT 'ACGT'::dna_sequence >= 'ACGTA'::dna_sequence; /* f */
 SELECT 'ACGT'::dna_sequence >= 'ACG'::dna_sequence; /* t */
+SELECT 'ACGT'::dna_sequence = 'acgt'::dna_sequence(CASE_SENSITIVE); /* f */
+SELECT 'ACGN'::dna_sequence = 'ACGN'::dna_sequence(ASCII); /* t */
+SELECT 'TGCA'::dna_sequence < 'TGCN'::dna_sequence; /* t */
+SELECT 'ACGT'::dna_sequence(CASE_SENSITIVE) > 'acgt'::dna_sequence(CASE_SENSITIVE); /* f */
+SELECT 'ACGTN'::dna_sequence(ASCII) < 'ACGT'::dna_sequence; /* f */
 
 DROP TABLE IF EXISTS idx_test;
 CREATE TABLE idx_test (
@@ -1392,6 +1392,37 @@ INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
     WHERE result = FALSE
   ) AS a;
 
+/* hashes of complemented and transcribed sequences */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'dna_sequence_test_reference' AS test_set,
+         'complement hash' AS test_type,
+         seq AS raw_sequence
+  FROM (
+    SELECT seq FROM (
+      SELECT raw_sequence AS seq,
+             (hash_dna(complement(compressed_sequence)) = hash_dna(complement(compressed_sequence)::text::dna_sequence)
+              AND hash_dna(reverse_complement(compressed_sequence)) = hash_dna(reverse_complement(raw_sequence::dna_sequence))
+              AND hash_rna(transcribe(compressed_sequence)) = hash_rna(transcribe(compressed_sequence)::text::rna_sequence)) AS result
+      FROM dna_sequence_test_reference
+    ) AS b
+    WHERE result = FALSE
+  ) AS a;
+SET enable_sort = off;
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'dna_sequence_test_reference' AS test_set,
+         'complement hash aggregate' AS test_type,
+         NULL AS raw_sequence
+  FROM (
+    SELECT count(*) = (SELECT count(DISTINCT raw_sequence) FROM dna_sequence_test_reference) AS result
+    FROM (
+      SELECT complement(compressed_sequence)
+      FROM dna_sequence_test_reference
+      GROUP BY 1
+    ) AS b
+  ) AS a
+  WHERE result = FALSE;
+RESET enable_sort;
+
 /* strpos function */
 INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
   SELECT 'dna_sequence_test_reference' AS test_set,
@@ -1405,6 +1436,646 @@ INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
     WHERE result = FALSE
   ) AS a;
 
+/* symbol count functions */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'dna_sequence_test_reference' AS test_set,
+         'symbol counting' AS test_type,
+         seq AS raw_sequence
+  FROM (
+    SELECT seq FROM (
+      SELECT raw_sequence AS seq,
+             (symbol_count(compressed_sequence, 'N') = char_length(raw_sequence) - char_length(replace(raw_sequence, 'N', ''))
+              AND symbol_count(compressed_sequence, 'A', 70000, 140000) = char_length(substr(raw_sequence, 70000, 140000)) - char_length(replace(substr(raw_sequence, 70000, 140000), 'A', ''))
+              AND gc_content(compressed_sequence) = ((char_length(raw_sequence) - char_length(replace(replace(raw_sequence, 'G', ''), 'C', '')))::float8 / char_length(raw_sequence))::real
+              AND abs(gc_content(compressed_sequence) - gc_content(get_alphabet(compressed_sequence))) < 0.00001) AS result
+      FROM dna_sequence_test_reference
+    ) AS b
+    WHERE result = FALSE
+  ) AS a;
+
+/* index granularity */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'dna_sequence_test_reference' AS test_set,
+         'index part size' AS test_type,
+         seq AS raw_sequence
+  FROM (
+    SELECT seq FROM (
+      SELECT raw_sequence AS seq,
+             (substr(raw_sequence::dna_sequence(REFERENCE, 4096), 70000, 100) = substr(raw_sequence, 70000, 100)
+              AND substr(raw_sequence::dna_sequence(REFERENCE, 512), 4000, 100) = substr(raw_sequence, 4000, 100)
+              AND raw_sequence::dna_sequence(REFERENCE, 512) = compressed_sequence) AS result
+      FROM dna_sequence_test_reference
+    ) AS b
+    WHERE result = FALSE
+  ) AS a;
+
+/* strpos with long patterns */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'dna_sequence_test_reference' AS test_set,
+         'strpos long pattern' AS test_type,
+         seq AS raw_sequence
+  FROM (
+    SELECT seq FROM (
+      SELECT raw_sequence AS seq,
+             (strpos(compressed_sequence, substr(raw_sequence, 100000, 300)) = strpos(raw_sequence, substr(raw_sequence, 100000, 300))
+              AND strpos(compressed_sequence, substr(raw_sequence, 100000, 300)::dna_sequence) = strpos(raw_sequence, substr(raw_sequence, 100000, 300))) AS result
+      FROM dna_sequence_test_reference
+      WHERE len >= 100300
+    ) AS b
+    WHERE result = FALSE
+  ) AS a;
+
+/* aggregates */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'dna_sequence_test_reference' AS test_set,
+         'aggregates' AS test_type,
+         NULL AS raw_sequence
+  FROM (
+    SELECT (total_length_agg(compressed_sequence) = sum(char_length(raw_sequence))
+            AND alphabet_union_agg(compressed_sequence)::text = '{A,C,G,N,T}'
+            AND (sequence_composition_agg(compressed_sequence)::text[])[1:1] = '{{A,C,G,N,T}}') AS result
+    FROM dna_sequence_test_reference
+  ) AS a
+  WHERE result = FALSE;
+
+/* k-mer index */
+CREATE INDEX dna_sequence_test_reference_kmer ON dna_sequence_test_reference USING gin (compressed_sequence dna_sequence_kmer_ops);
+SET enable_seqscan = off;
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'dna_sequence_test_reference' AS test_set,
+         'kmer index' AS test_type,
+         seq AS raw_sequence
+  FROM (
+    SELECT seq FROM (
+      SELECT raw_sequence AS seq,
+             ((SELECT count(*) FROM dna_sequence_test_reference AS b WHERE b.compressed_sequence @> substr(a.raw_sequence, 1000, 20))
+               = (SELECT count(*) FROM dna_sequence_test_reference AS b WHERE strpos(b.raw_sequence, substr(a.raw_sequence, 1000, 20)) > 0)
+              AND (SELECT count(*) FROM dna_sequence_test_reference AS b WHERE b.compressed_sequence @> substr(a.raw_sequence, 1000, 3)::dna_sequence)
+               = (SELECT count(*) FROM dna_sequence_test_reference AS b WHERE strpos(b.raw_sequence, substr(a.raw_sequence, 1000, 3)) > 0)) AS result
+      FROM dna_sequence_test_reference AS a
+      WHERE id <= 10 AND len >= 1020
+    ) AS b
+    WHERE result = FALSE
+  ) AS a;
+RESET enable_seqscan;
+
+/* empty sequences */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'empty sequences' AS test_set,
+         'decode' AS test_type,
+         typmod AS raw_sequence
+  FROM (
+    SELECT typmod, (seq::text = '' AND substr(seq, 1, 10) = '' AND char_length(seq) = 0) AS result
+    FROM (
+      SELECT 'SHORT, FLC, CASE_INSENSITIVE' AS typmod, ''::dna_sequence(SHORT,FLC,CASE_INSENSITIVE) AS seq
+      UNION ALL SELECT 'SHORT, FLC, CASE_SENSITIVE', ''::dna_sequence(SHORT,FLC,CASE_SENSITIVE)
+      UNION ALL SELECT 'SHORT, IUPAC, CASE_INSENSITIVE', ''::dna_sequence(SHORT,iupac,CASE_INSENSITIVE)
+      UNION ALL SELECT 'SHORT, IUPAC, CASE_SENSITIVE', ''::dna_sequence(SHORT,iupac,CASE_SENSITIVE)
+      UNION ALL SELECT 'SHORT, ASCII, CASE_INSENSITIVE', ''::dna_sequence(SHORT,ascii,CASE_INSENSITIVE)
+      UNION ALL SELECT 'SHORT, ASCII, CASE_SENSITIVE', ''::dna_sequence(SHORT,ascii,CASE_SENSITIVE)
+      UNION ALL SELECT 'DEFAULT', ''::dna_sequence
+      UNION ALL SELECT 'DEFAULT, CASE_SENSITIVE', ''::dna_sequence(CASE_SENSITIVE)
+      UNION ALL SELECT 'REFERENCE', ''::dna_sequence(REFERENCE)
+    ) AS b
+  ) AS a
+  WHERE result IS DISTINCT FROM TRUE;
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'empty sequences' AS test_set,
+         'reverse' AS test_type,
+         typmod AS raw_sequence
+  FROM (
+    SELECT typmod, (reverse(seq)::text = '' AND reverse_complement(seq)::text = ''
+                    AND char_length(reverse(seq)) = 0 AND char_length(reverse_complement(seq)) = 0) AS result
+    FROM (
+      SELECT 'SHORT, FLC, CASE_INSENSITIVE' AS typmod, ''::dna_sequence(SHORT,FLC,CASE_INSENSITIVE) AS seq
+      UNION ALL SELECT 'SHORT, FLC, CASE_SENSITIVE', ''::dna_sequence(SHORT,FLC,CASE_SENSITIVE)
+      UNION ALL SELECT 'SHORT, IUPAC, CASE_INSENSITIVE', ''::dna_sequence(SHORT,iupac,CASE_INSENSITIVE)
+      UNION ALL SELECT 'SHORT, IUPAC, CASE_SENSITIVE', ''::dna_sequence(SHORT,iupac,CASE_SENSITIVE)
+      UNION ALL SELECT 'SHORT, ASCII, CASE_INSENSITIVE', ''::dna_sequence(SHORT,ascii,CASE_INSENSITIVE)
+      UNION ALL SELECT 'SHORT, ASCII, CASE_SENSITIVE', ''::dna_sequence(SHORT,ascii,CASE_SENSITIVE)
+      UNION ALL SELECT 'DEFAULT', ''::dna_sequence
+      UNION ALL SELECT 'DEFAULT, CASE_SENSITIVE', ''::dna_sequence(CASE_SENSITIVE)
+      UNION ALL SELECT 'REFERENCE', ''::dna_sequence(REFERENCE)
+      UNION ALL SELECT 'ASCII', ''::dna_sequence(ascii)
+      UNION ALL SELECT 'REFERENCE, ASCII, CASE_SENSITIVE', ''::dna_sequence(REFERENCE,ascii,CASE_SENSITIVE)
+    ) AS b
+  ) AS a
+  WHERE result IS DISTINCT FROM TRUE;
+
+/* FASTA and FASTQ loading */
+COPY (VALUES ('>seq1 first'), ('ACGT'), ('acgtn'), (''), ('>seq2'), ('GGG')) TO '/tmp/postbis_test.fasta';
+COPY (VALUES ('@r1'), ('ACGT'), ('+'), ('@@II'), ('@r2'), ('AC'), ('+r2'), ('II')) TO '/tmp/postbis_test.fastq';
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'files' AS test_set,
+         'read_fasta' AS test_type,
+         NULL AS raw_sequence
+  FROM (
+    SELECT array_agg(id || ':' || sequence::text) = '{"seq1 first:ACGTacgtn",seq2:GGG}' AS result
+    FROM read_fasta('/tmp/postbis_test.fasta')
+  ) AS a
+  WHERE result IS DISTINCT FROM TRUE;
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'files' AS test_set,
+         'read_fastq' AS test_type,
+         NULL AS raw_sequence
+  FROM (
+    SELECT array_agg(id || ':' || sequence::text || ':' || quality) = '{r1:ACGT:@@II,r2:AC:II}' AS result
+    FROM read_fastq('/tmp/postbis_test.fastq', 'FLC, SHORT')
+  ) AS a
+  WHERE result IS DISTINCT FROM TRUE;
+
+/* Delta compression against a reference */
+INSERT INTO postbis_reference (name, sequence)
+  SELECT 'test', raw_sequence::dna_sequence FROM dna_sequence_test_reference WHERE id = 1;
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'delta' AS test_set,
+         'roundtrip' AS test_type,
+         raw_sequence
+  FROM (
+    SELECT raw_sequence, delta_compress(raw_sequence::dna_sequence, 'test')::text::dna_delta AS delta
+    FROM (
+      SELECT overlay(raw_sequence placing 'ACGTTGCA' from g * 1000 for g) AS raw_sequence
+      FROM dna_sequence_test_reference, generate_series(1, 20) AS g
+      WHERE id = 1
+      UNION ALL
+      SELECT raw_sequence FROM dna_sequence_test_reference WHERE id = 2
+    ) AS a
+  ) AS b
+  WHERE delta::dna_sequence::text <> raw_sequence
+     OR substr(delta, 990, 40) <> substr(raw_sequence, 990, 40)
+     OR char_length(delta) <> char_length(raw_sequence);
+DELETE FROM postbis_reference;
+
+/* Concatenation */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'concat' AS test_set,
+         'operator' AS test_type,
+         a.raw_sequence
+  FROM dna_sequence_test_reference AS a, dna_sequence_test_reference AS b
+  WHERE a.id <= 5 AND b.id <= 5
+    AND (a.compressed_sequence || b.compressed_sequence)::text <> a.raw_sequence || b.raw_sequence;
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'concat' AS test_set,
+         'spliced' AS test_type,
+         raw_sequence
+  FROM (
+    SELECT repeat('ACGT', g * 5000) || 'AC' AS raw_sequence
+    FROM generate_series(1, 5) AS g
+  ) AS a
+  WHERE NOT (raw_sequence::dna_sequence(FLC) || raw_sequence::dna_sequence(FLC)) = (raw_sequence || raw_sequence)::dna_sequence(FLC)
+     OR (raw_sequence::dna_sequence(FLC) || raw_sequence::dna_sequence(FLC))::text <> raw_sequence || raw_sequence;
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'concat' AS test_set,
+         'aggregate' AS test_type,
+         NULL AS raw_sequence
+  FROM (
+    SELECT sequence_concat_agg(compressed_sequence ORDER BY id)::text = string_agg(raw_sequence, '' ORDER BY id) AS result
+    FROM dna_sequence_test_reference
+    WHERE id <= 10
+  ) AS a
+  WHERE result IS DISTINCT FROM TRUE;
+
+/* Chunks */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'chunks' AS test_set,
+         s.chunk_size::text AS test_type,
+         a.raw_sequence
+  FROM dna_sequence_test_reference AS a, (VALUES (1000), (70000)) AS s (chunk_size)
+  WHERE a.id <= 10
+    AND (a.raw_sequence IS DISTINCT FROM (SELECT string_agg(c.chunk, '' ORDER BY c.position) FROM sequence_chunks(a.compressed_sequence, s.chunk_size) AS c)
+         OR EXISTS (SELECT 1 FROM sequence_chunks(a.compressed_sequence, s.chunk_size) AS c
+                    WHERE char_length(c.chunk) <> least(s.chunk_size, char_length(a.raw_sequence) - c.position + 1)));
+
+/* Translation */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'translate' AS test_set,
+         'rna' AS test_type,
+         raw_sequence
+  FROM dna_sequence_test_reference
+  WHERE id <= 10
+    AND translate(compressed_sequence)::text <> translate(replace(raw_sequence, 'T', 'U')::rna_sequence)::text;
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'translate' AS test_set,
+         'six frames' AS test_type,
+         a.raw_sequence
+  FROM (
+    SELECT raw_sequence, compressed_sequence FROM dna_sequence_test_reference WHERE id <= 10
+    UNION ALL
+    SELECT seq, seq::dna_sequence(FLC) FROM (SELECT generate_sequence(dna_flc(), 9000 + g) AS seq FROM generate_series(1, 3) AS g) AS b
+  ) AS a, six_frame_translate(a.compressed_sequence) AS f
+  WHERE char_length(f.translation) <> (char_length(a.raw_sequence) - abs(f.frame) + 1) / 3
+     OR split_part(f.translation::text, '*', 1) <>
+        translate(substr(CASE WHEN f.frame > 0 THEN a.raw_sequence ELSE reverse_complement(a.compressed_sequence)::text END, abs(f.frame))::dna_sequence)::text;
+
+/* Codebooks */
+CREATE TEMP TABLE dna_sequence_codebook AS
+  SELECT register_codebook(codebook_agg(compressed_sequence)) AS id
+  FROM dna_sequence_test_reference
+  WHERE id <= 10;
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'codebook' AS test_set,
+         'compress' AS test_type,
+         raw_sequence
+  FROM (
+    SELECT a.raw_sequence, a.compressed_sequence, codebook_compress(a.compressed_sequence, c.id) AS codebook_sequence
+    FROM dna_sequence_test_reference AS a, dna_sequence_codebook AS c
+    WHERE a.id <= 20
+  ) AS b
+  WHERE codebook_sequence::text <> raw_sequence
+     OR NOT codebook_sequence = compressed_sequence
+     OR substr(codebook_sequence, 1000, 5000)::text <> substr(raw_sequence, 1000, 5000)
+     OR reverse(codebook_sequence)::text <> reverse(raw_sequence)
+     OR complement(codebook_sequence)::text <> complement(compressed_sequence)::text
+     OR reverse_complement(codebook_sequence)::text <> reverse_complement(compressed_sequence)::text
+     OR transcribe(codebook_sequence)::text <> replace(raw_sequence, 'T', 'U')
+     OR (codebook_sequence || codebook_sequence)::text <> raw_sequence || raw_sequence;
+
+/* codebook of a single symbol */
+CREATE TEMP TABLE dna_sequence_single_symbol AS
+  SELECT g AS id, repeat('A', 1000 * g) AS raw_sequence
+  FROM generate_series(1, 10) AS g;
+
+INSERT INTO dna_sequence_codebook
+  SELECT register_codebook(codebook_agg(raw_sequence::dna_sequence))
+  FROM dna_sequence_single_symbol;
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'codebook' AS test_set,
+         'single symbol' AS test_type,
+         raw_sequence
+  FROM (
+    SELECT a.raw_sequence, codebook_compress(a.raw_sequence::dna_sequence, c.id) AS codebook_sequence
+    FROM dna_sequence_single_symbol AS a, dna_sequence_codebook AS c
+    WHERE c.id = (SELECT max(id) FROM dna_sequence_codebook)
+  ) AS b
+  WHERE codebook_sequence::text <> raw_sequence
+     OR substr(codebook_sequence, 500, 100)::text <> substr(raw_sequence, 500, 100)
+     OR reverse(codebook_sequence)::text <> raw_sequence
+     OR NOT codebook_sequence = raw_sequence::dna_sequence;
+
+DROP TABLE dna_sequence_single_symbol;
+
+DELETE FROM postbis_codebook;
+
+DROP TABLE dna_sequence_codebook;
+
+/* Alignment columns */
+CREATE TEMP TABLE dna_sequence_alignment AS
+  SELECT id, seq AS raw_sequence, seq::aligned_dna_sequence AS aligned_sequence, seq::aligned_dna_sequence(SHORT) AS short_sequence
+  FROM (
+    SELECT id, repeat('-', 700 * id) || substr(raw_sequence, 1, 5000) || repeat('-', 5000 - 700 * id) AS seq
+    FROM dna_sequence_test_reference
+    WHERE id <= 5
+  ) AS a;
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'alignment' AS test_set,
+         'gap runs' AS test_type,
+         raw_sequence
+  FROM dna_sequence_alignment
+  WHERE aligned_sequence::text <> raw_sequence
+     OR short_sequence::text <> raw_sequence
+     OR substr(aligned_sequence, 700 * id - 10, 20)::text <> substr(raw_sequence, 700 * id - 10, 20)
+     OR octet_length(aligned_sequence) >= octet_length(short_sequence);
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'alignment' AS test_set,
+         'column' AS test_type,
+         c::text AS raw_sequence
+  FROM generate_series(1, 10000, 333) AS c
+  WHERE (SELECT alignment_column_agg(aligned_sequence, c ORDER BY id) FROM dna_sequence_alignment)
+        IS DISTINCT FROM (SELECT string_agg(substr(raw_sequence, c, 1), '' ORDER BY id) FROM dna_sequence_alignment)
+     OR EXISTS (SELECT 1 FROM dna_sequence_alignment WHERE alignment_column(aligned_sequence, c) <> substr(raw_sequence, c, 1));
+
+SELECT alignment_column(aligned_sequence, 10001) FROM dna_sequence_alignment WHERE id = 1;
+
+DROP TABLE dna_sequence_alignment;
+
+/* Instrumentation */
+SELECT postbis_stat_reset();
+
+SELECT count(*) > 0 FROM dna_sequence_test_reference WHERE strpos(compressed_sequence, 'ACGTA') >= 0;
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'instrumentation' AS test_set,
+         'counters' AS test_type,
+         counter AS raw_sequence
+  FROM pg_stat_postbis
+  WHERE backend < 0
+     OR (counter IN ('strpos_searches', 'strpos_state_bytes', 'bytes_detoasted', 'bytes_read') AND backend = 0)
+     OR (counter = 'symbols_encoded_huffman' AND backend <> 0);
+
+SELECT count(*) FROM pg_stat_postbis;
+
+/* resetting the counters is not granted to PUBLIC */
+CREATE ROLE postbis_test_unprivileged;
+SET ROLE postbis_test_unprivileged;
+SELECT postbis_stat_reset();
+RESET ROLE;
+DROP ROLE postbis_test_unprivileged;
+
+/* Cursor cache */
+CREATE TEMP TABLE dna_sequence_cache AS
+  SELECT sequence, sequence::text AS raw_sequence
+  FROM generate_dna_sequences('{A,C,G,N,T}'::alphabet, 100000, 2, '', 5);
+
+SELECT postbis_stat_reset();
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'cursor cache' AS test_set,
+         'repeated calls' AS test_type,
+         c.raw_sequence
+  FROM dna_sequence_cache AS c
+  WHERE EXISTS (
+    SELECT 1
+    FROM generate_series(1, 100000, 997) AS i
+    WHERE substr(c.sequence, i, 50) <> substr(c.raw_sequence, i, 50)
+       OR strpos(c.sequence, substr(c.raw_sequence, i, 20)) <> strpos(c.raw_sequence, substr(c.raw_sequence, i, 20))
+       OR char_length(c.sequence) <> 100000);
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'cursor cache' AS test_set,
+         'hits' AS test_type,
+         backend::text AS raw_sequence
+  FROM pg_stat_postbis
+  WHERE counter = 'cursor_cache_hits' AND backend < 100;
+
+DROP TABLE dna_sequence_cache;
+
+/* Sequence generation */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'generation' AS test_set,
+         'seeded' AS test_type,
+         s.sequence::text AS raw_sequence
+  FROM generate_dna_sequences(dna_iupac(), 5000, 10, 'REFERENCE', 42) AS s
+  WHERE char_length(s.sequence) <> 5000
+     OR (s.id = 1 AND s.sequence::text <> generate_dna_sequence(dna_iupac(), 5000, 'REFERENCE', 42)::text)
+     OR s.sequence::text = generate_dna_sequence(dna_iupac(), 5000, 'REFERENCE', 43)::text
+     OR s.sequence::text <> (SELECT t.sequence::text FROM generate_dna_sequences(dna_iupac(), 5000, 10, '', 42) AS t WHERE t.id = s.id);
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'generation' AS test_set,
+         'fixed code' AS test_type,
+         s.sequence::text AS raw_sequence
+  FROM generate_dna_sequences(dna_flc(), 100000, 3, 'FLC', 7) AS s
+  WHERE s.sequence::text <> (SELECT t.sequence::text FROM generate_dna_sequences(dna_flc(), 100000, 3, '', 7) AS t WHERE t.id = s.id);
+
+SELECT count(*) FROM generate_dna_sequences(dna_flc(), 10, 3);
+
+SELECT generate_dna_sequence('{A,C,G,T,N}'::alphabet, 1000, 'FLC', 1);
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'generation' AS test_set,
+         'unseeded' AS test_type,
+         s AS raw_sequence
+  FROM (SELECT generate_sequence('{{G,A,C},{0,0.5,0.5}}'::alphabet, 100000) AS s) AS a
+  WHERE char_length(s) <> 100000
+     OR s !~ '^[AC]*$'
+     OR char_length(replace(s, 'A', '')) NOT BETWEEN 45000 AND 55000
+     OR s = generate_sequence('{{G,A,C},{0,0.5,0.5}}'::alphabet, 100000);
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'generation' AS test_set,
+         'seeded text' AS test_type,
+         s AS raw_sequence
+  FROM (SELECT generate_sequence('{A,C,G,T}'::alphabet, 40, 42) AS s) AS a
+  WHERE s <> 'AGCCTGCTTGCGCCACTTTCATTCTTGTGAGCGCACATGT'
+     OR s = generate_sequence('{A,C,G,T}'::alphabet, 40, 43)
+     OR char_length(generate_sequence(dna_iupac(), 5000, 42)) <> 5000;
+
+/* Sorting */
+CREATE TEMP TABLE dna_sequence_sort AS
+  SELECT id, s AS raw_sequence, s::dna_sequence AS compressed_sequence
+  FROM (
+    SELECT id, repeat('ACGT', (random() * 6)::int) || generate_sequence(dna_iupac(), (random() * 40)::int) AS s
+    FROM generate_series(1, 20000) AS id
+  ) AS a;
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'sort' AS test_set,
+         'order by' AS test_type,
+         raw_sequence
+  FROM (
+    SELECT raw_sequence, lag(raw_sequence) OVER (ORDER BY compressed_sequence) AS previous
+    FROM dna_sequence_sort
+  ) AS a
+  WHERE previous COLLATE "C" > raw_sequence COLLATE "C";
+
+CREATE INDEX dna_sequence_sort_idx ON dna_sequence_sort (compressed_sequence);
+
+SET enable_seqscan = off;
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'sort' AS test_set,
+         'index' AS test_type,
+         a.raw_sequence
+  FROM dna_sequence_sort AS a
+  WHERE a.id <= 200
+    AND (SELECT count(*) FROM dna_sequence_sort AS b WHERE b.compressed_sequence = a.compressed_sequence)
+        <> (SELECT count(*) FROM dna_sequence_sort AS c WHERE c.raw_sequence = a.raw_sequence);
+
+RESET enable_seqscan;
+
+DROP TABLE dna_sequence_sort;
+
+/* Sketches */
+CREATE TEMP TABLE dna_sequence_sketch AS
+  SELECT id, sequence, sketch(sequence, 16, 200) AS sketch
+  FROM generate_dna_sequences('{A,C,G,T}'::alphabet, 5000, 200, '', 7);
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'sketch' AS test_set,
+         'sketch' AS test_type,
+         sequence::text AS raw_sequence
+  FROM dna_sequence_sketch
+  WHERE n_hashes(sketch) <> 200
+     OR kmer_length(sketch) <> 16
+     OR jaccard(sketch, sketch(reverse_complement(sequence), 16, 200)) <> 1
+     OR (sketch <-> sketch(substr(sequence, 1, 4000)::dna_sequence, 16, 200)) NOT BETWEEN 0 AND 0.05
+     OR sketch::text::sequence_sketch::text <> sketch::text;
+
+CREATE INDEX dna_sequence_sketch_idx ON dna_sequence_sketch USING gist (sketch);
+
+SET enable_seqscan = off;
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'sketch' AS test_set,
+         'sketch index' AS test_type,
+         a.sequence::text AS raw_sequence
+  FROM dna_sequence_sketch AS a
+  WHERE a.id <= 20
+    AND ((SELECT b.id FROM dna_sequence_sketch AS b ORDER BY b.sketch <-> a.sketch LIMIT 1) <> a.id
+         OR (SELECT count(*) FROM dna_sequence_sketch AS b WHERE b.sketch && a.sketch)
+            <> (SELECT count(*) FROM dna_sequence_sketch AS b WHERE sketch_overlap(b.sketch, a.sketch)));
+
+RESET enable_seqscan;
+
+DROP TABLE dna_sequence_sketch;
+
+SELECT sketch('ACGTTGCAN'::dna_sequence, 4, 3);
+
+SELECT sketch('ACGT'::dna_sequence, 33);
+
+SELECT sketch('ACGTACGT'::dna_sequence, 3) <-> sketch('ACGTACGT'::dna_sequence, 4);
+
+/* k-mer counts */
+CREATE TEMP TABLE dna_sequence_kmers AS
+  SELECT id, sequence::text AS raw_sequence, sequence
+  FROM generate_dna_sequences('{A,C,G,T}'::alphabet, 2000, 20, '', 11)
+  UNION ALL
+  SELECT 1000 + id, raw_sequence, compressed_sequence
+  FROM dna_sequence_test_reference
+  WHERE id <= 10 AND char_length(raw_sequence) <= 20000;
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'kmer counts' AS test_set,
+         k.k::text AS test_type,
+         a.raw_sequence
+  FROM dna_sequence_kmers AS a, (VALUES (1), (5), (11), (32)) AS k (k)
+  WHERE EXISTS (
+    (SELECT kmer, count FROM kmer_counts(a.sequence, k.k)
+     EXCEPT
+     SELECT substr(upper(a.raw_sequence), i, k.k), count(*)
+     FROM generate_series(1, char_length(a.raw_sequence) - k.k + 1) AS i
+     WHERE substr(upper(a.raw_sequence), i, k.k) ~ '^[ACGT]+$'
+     GROUP BY 1)
+    UNION ALL
+    (SELECT substr(upper(a.raw_sequence), i, k.k), count(*)
+     FROM generate_series(1, char_length(a.raw_sequence) - k.k + 1) AS i
+     WHERE substr(upper(a.raw_sequence), i, k.k) ~ '^[ACGT]+$'
+     GROUP BY 1
+     EXCEPT
+     SELECT kmer, count FROM kmer_counts(a.sequence, k.k)));
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'kmer counts' AS test_set,
+         'canonical' AS test_type,
+         a.raw_sequence
+  FROM dna_sequence_kmers AS a
+  WHERE EXISTS (
+    SELECT c.kmer
+    FROM kmer_counts(a.sequence, 7, true) AS c
+    FULL JOIN (
+      SELECT least(f.kmer COLLATE "C", reverse_complement(f.kmer::dna_sequence)::text) AS kmer,
+             sum(f.count)::int8 AS count
+      FROM kmer_counts(a.sequence, 7) AS f
+      GROUP BY 1) AS r ON r.kmer = c.kmer
+    WHERE c.count IS DISTINCT FROM r.count);
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'kmer counts' AS test_set,
+         'spectrum' AS test_type,
+         a.raw_sequence
+  FROM dna_sequence_kmers AS a
+  WHERE (SELECT sum(multiplicity * n_kmers) FROM kmer_spectrum(a.sequence, 9))
+        IS DISTINCT FROM (SELECT sum(count) FROM kmer_counts(a.sequence, 9))
+     OR (SELECT sum(n_kmers) FROM kmer_spectrum(a.sequence, 9))
+        IS DISTINCT FROM (SELECT count(*) FROM kmer_counts(a.sequence, 9));
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'kmer counts' AS test_set,
+         'aggregate' AS test_type,
+         NULL AS raw_sequence
+  FROM (
+    SELECT (SELECT kmer_spectrum_agg(sequence, 9, true) FROM dna_sequence_kmers)
+           = (SELECT array_agg(ARRAY[multiplicity, n_kmers] ORDER BY multiplicity)
+              FROM (SELECT count AS multiplicity, count(*) AS n_kmers
+                    FROM (SELECT c.kmer, sum(c.count)::int8 AS count
+                          FROM dna_sequence_kmers AS a, kmer_counts(a.sequence, 9, true) AS c
+                          GROUP BY c.kmer) AS t
+                    GROUP BY count) AS s) AS result
+  ) AS r
+  WHERE result IS DISTINCT FROM TRUE;
+
+DROP TABLE dna_sequence_kmers;
+
+SELECT * FROM kmer_counts('ACGTTGCANACGT'::dna_sequence, 3, true);
+
+SELECT * FROM kmer_spectrum('ACGTTGCANACGT'::dna_sequence, 3, true);
+
+SELECT kmer_spectrum_agg(sequence, 2, false) FROM (VALUES ('AAAA'::dna_sequence), ('ACGT'::dna_sequence)) AS t (sequence);
+
+SELECT * FROM kmer_counts('ACGT'::dna_sequence, 33);
+
+/* substr_multi */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'substr multi' AS test_set,
+         'intervals' AS test_type,
+         a.raw_sequence
+  FROM dna_sequence_test_reference AS a, LATERAL (
+    SELECT array_agg(start ORDER BY i) AS starts,
+           array_agg(length ORDER BY i) AS lengths,
+           array_agg(int4range(start, start + length) ORDER BY i) AS ranges,
+           array_agg(i % 3 = 0 ORDER BY i) AS minus
+    FROM (SELECT i,
+                 (i * 7919) % (a.len + 20) - 9 AS start,
+                 (i * 104729) % 3000 AS length
+          FROM generate_series(1, 50) AS i) AS t) AS r
+  WHERE a.id % 10 = 1
+    AND ((SELECT count(*) FROM substr_multi(a.compressed_sequence, r.ranges, r.minus)) <> 50
+     OR EXISTS (
+      SELECT m.n
+      FROM substr_multi(a.compressed_sequence, r.ranges, r.minus) AS m
+      WHERE m.subsequence IS DISTINCT FROM
+            CASE WHEN r.minus[m.n] AND substr(a.compressed_sequence, r.starts[m.n], r.lengths[m.n]) <> ''
+                 THEN reverse_complement(substr(a.compressed_sequence, r.starts[m.n], r.lengths[m.n])::dna_sequence)::text
+                 ELSE substr(a.compressed_sequence, r.starts[m.n], r.lengths[m.n]) END));
+
+SELECT * FROM substr_multi('ACGTTGCANACGT'::dna_sequence, '{"[8,12)","[1,5)",NULL,"[3,3)","[10,)","(,3)"}', '{t,f,f,f,f,t}');
+
+SELECT * FROM substr_multi('ACGT'::dna_sequence, '{"[1,2)"}', '{t,f}');
+
+/* sequence_overlay */
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'overlay' AS test_set,
+         'reference' AS test_type,
+         a.raw_sequence
+  FROM dna_sequence_test_reference AS a, LATERAL (
+    SELECT (a.id * 7919) % (a.len + 10) - 4 AS start,
+           (a.id * 104729) % 3 - 1 + length(t.replacement) AS count,
+           t.replacement
+    FROM (SELECT generate_sequence(dna_flc(), (a.id * 31337) % 70000 + 1) || repeat('N', a.id % 40) AS replacement) AS t) AS r
+  WHERE a.id % 10 = 2
+    AND r.start > 0
+    AND (sequence_overlay(a.compressed_sequence, r.replacement, r.start)::text
+         IS DISTINCT FROM overlay(a.raw_sequence PLACING r.replacement FROM r.start)
+     OR sequence_overlay(a.compressed_sequence, r.replacement, r.start, r.count)::text
+        IS DISTINCT FROM overlay(a.raw_sequence PLACING r.replacement FROM r.start FOR r.count)
+     OR sequence_overlay(a.compressed_sequence, r.replacement, r.start)
+        <> overlay(a.raw_sequence PLACING r.replacement FROM r.start)::dna_sequence
+     OR symbol_count(sequence_overlay(a.compressed_sequence, r.replacement, r.start), 'AN')
+        <> symbol_count(overlay(a.raw_sequence PLACING r.replacement FROM r.start)::dna_sequence, 'AN'));
+
+INSERT INTO dna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'overlay' AS test_set,
+         'fixed' AS test_type,
+         s.raw_sequence
+  FROM (SELECT generate_sequence(alphabet, 200000) AS raw_sequence
+        FROM (VALUES (dna_flc()), (dna_iupac())) AS t (alphabet)) AS s,
+       LATERAL (
+    SELECT (i * 7919) % 200000 + 1 AS start,
+           generate_sequence(dna_flc(), (i * 104729) % 70000 + 1) AS replacement
+    FROM generate_series(1, 5) AS i) AS r
+  WHERE sequence_overlay(s.raw_sequence::dna_sequence, r.replacement, r.start)::text
+        IS DISTINCT FROM overlay(s.raw_sequence PLACING r.replacement FROM r.start)
+     OR sequence_overlay(s.raw_sequence::dna_sequence, r.replacement, r.start)
+        <> overlay(s.raw_sequence PLACING r.replacement FROM r.start)::dna_sequence
+     OR symbol_count(sequence_overlay(s.raw_sequence::dna_sequence, r.replacement, r.start), 'AN')
+        <> symbol_count(overlay(s.raw_sequence PLACING r.replacement FROM r.start)::dna_sequence, 'AN');
+
+SELECT sequence_overlay('ACGTTGCANACGT'::dna_sequence, 'ttt', 3);
+
+SELECT sequence_overlay('ACGTTGCANACGT'::dna_sequence, 'N', 13);
+
+SELECT sequence_overlay('ACGTTGCANACGT'::dna_sequence, 'GG', 5, 0);
+
+SELECT sequence_overlay('ACGTTGCANACGT'::dna_sequence, '', 9, 5);
+
+SELECT sequence_overlay('ACGT'::dna_sequence, 'CC', 7);
+
+SELECT sequence_overlay('ACGT'::dna_sequence, 'CC', 0);
+
 DROP TABLE dna_sequence_test_reference;
 
 SELECT test_set, test_type, count(*) FROM dna_sequence_errors GROUP BY test_set, test_type;
@@ -151,6 +151,19 @@ INSERT INTO rna_sequence_errors (test_set, test_type, raw_sequence, details)
   ) AS a
   WHERE result = FALSE;
 
+/* gc_content function */
+INSERT INTO rna_sequence_errors (test_set, test_type, raw_sequence)
+  SELECT 'rna_sequence_test_flc_ic' AS test_set,
+         'gc_content' AS test_type,
+         raw_sequence
+  FROM (
+    SELECT raw_sequence,
+          (gc_content(compressed_sequence) = ((char_length(raw_sequence) - char_length(replace(replace(raw_sequence, 'G', ''), 'C', '')))::float8 / char_length(raw_sequence))::real
+           AND abs(gc_content(compressed_sequence) - gc_content(get_alphabet(compressed_sequence))) < 0.00001) AS result
+    FROM rna_sequence_test_flc_ic
+  ) AS a
+  WHERE result = FALSE;
+
 DROP TABLE rna_sequence_test_flc_ic;
 
 /*
@@ -0,0 +1,128 @@
+/*-------------------------------------------------------------------------
+*
+* Copyright (c) 2013, Max Planck Institute for Marine Microbiology
+*
+* This software is released under the PostgreSQL License
+*
+* Author: Michael Schneider <mschneid@mpi-bremen.de>
+*
+* IDENTIFICATION
+*   sql/upgrade.test.sql
+*
+*-------------------------------------------------------------------------
+*/
+SET client_min_messages = warning;
+DROP EXTENSION IF EXISTS postbis CASCADE;
+RESET client_min_messages;
+
+/*
+* Objects of the extension, with the properties an upgrade could get wrong.
+*/
+CREATE TEMP VIEW postbis_objects AS
+  SELECT pg_describe_object(d.classid, d.objid, d.objsubid) AS object
+  FROM pg_depend d
+  JOIN pg_extension e ON e.oid = d.refobjid
+  WHERE d.refclassid = 'pg_extension'::regclass
+    AND d.deptype = 'e'
+    AND e.extname = 'postbis'
+  UNION ALL
+  SELECT format('%s(%s) returns %s language %s as %s %s %s %s %s',
+                p.proname, pg_get_function_arguments(p.oid), pg_get_function_result(p.oid),
+                l.lanname, p.prosrc, p.provolatile, p.proisstrict, p.proparallel, p.proacl)
+  FROM pg_proc p
+  JOIN pg_language l ON l.oid = p.prolang
+  JOIN pg_depend d ON d.classid = 'pg_proc'::regclass AND d.objid = p.oid
+  JOIN pg_extension e ON e.oid = d.refobjid
+  WHERE d.refclassid = 'pg_extension'::regclass
+    AND d.deptype = 'e'
+    AND e.extname = 'postbis'
+  UNION ALL
+  SELECT format('%s %s %s %s %s %s %s %s %s',
+                t.oid::regtype, t.typinput, t.typoutput, t.typreceive, t.typsend,
+                t.typmodin, t.typmodout, t.typalign, t.typstorage)
+  FROM pg_type t
+  JOIN pg_depend d ON d.classid = 'pg_type'::regclass AND d.objid = t.oid
+  JOIN pg_extension e ON e.oid = d.refobjid
+  WHERE d.refclassid = 'pg_extension'::regclass
+    AND d.deptype = 'e'
+    AND e.extname = 'postbis'
+  UNION ALL
+  SELECT pg_describe_object('pg_amproc'::regclass, a.oid, 0)
+  FROM pg_amproc a
+  JOIN pg_depend d ON d.classid = 'pg_opfamily'::regclass AND d.objid = a.amprocfamily
+  JOIN pg_extension e ON e.oid = d.refobjid
+  WHERE d.refclassid = 'pg_extension'::regclass
+    AND d.deptype = 'e'
+    AND e.extname = 'postbis'
+  UNION ALL
+  SELECT pg_describe_object('pg_amop'::regclass, a.oid, 0)
+  FROM pg_amop a
+  JOIN pg_depend d ON d.classid = 'pg_opfamily'::regclass AND d.objid = a.amopfamily
+  JOIN pg_extension e ON e.oid = d.refobjid
+  WHERE d.refclassid = 'pg_extension'::regclass
+    AND d.deptype = 'e'
+    AND e.extname = 'postbis'
+  UNION ALL
+  SELECT format('configuration %s', c::regclass)
+  FROM pg_extension e, unnest(e.extconfig) AS c
+  WHERE e.extname = 'postbis';
+
+/*
+* Sequences stored with version 1.0
+*/
+CREATE EXTENSION postbis VERSION '1.0';
+
+CREATE TABLE upgrade_test AS
+  SELECT id, s AS raw_sequence, s::dna_sequence AS compressed_sequence
+  FROM (
+    SELECT id, generate_sequence(dna_iupac(), 1000 + id) AS s
+    FROM generate_series(1, 100) AS id
+  ) AS a;
+
+CREATE INDEX upgrade_test_idx ON upgrade_test USING btree (compressed_sequence);
+
+ALTER EXTENSION postbis UPDATE;
+
+SELECT extversion FROM pg_extension WHERE extname = 'postbis';
+
+/*
+* The stored sequences can be read with the new functions
+*/
+SELECT count(*) FROM upgrade_test
+  WHERE compressed_sequence::text <> raw_sequence
+     OR (compressed_sequence || compressed_sequence)::text <> raw_sequence || raw_sequence
+     OR strpos(compressed_sequence, substr(raw_sequence, 100, 20)::dna_sequence) <> strpos(raw_sequence, substr(raw_sequence, 100, 20))
+     OR NOT compressed_sequence @> substr(raw_sequence, 500, 30)
+     OR symbol_count(compressed_sequence, 'A') <> char_length(raw_sequence) - char_length(replace(raw_sequence, 'A', ''))
+     OR abs(gc_content(compressed_sequence) - gc_content(get_alphabet(compressed_sequence))) >= 0.00001;
+
+SELECT count(*) FROM pg_amproc
+  WHERE amprocnum = 2
+    AND amprocfamily IN (SELECT oid FROM pg_opfamily WHERE opfname LIKE '%sequence_btree_ops');
+
+SELECT count(*) FROM pg_type
+  WHERE typname IN ('dna_sequence', 'rna_sequence', 'aa_sequence', 'aligned_dna_sequence', 'aligned_rna_sequence', 'aligned_aa_sequence')
+    AND typreceive::text = typname || '_recv'
+    AND typsend::text = typname || '_send';
+
+/*
+* An updated installation has the same objects as a new one
+*/
+CREATE TEMP TABLE upgraded_objects AS
+  SELECT object FROM postbis_objects;
+
+DROP TABLE upgrade_test;
+DROP EXTENSION postbis;
+CREATE EXTENSION postbis;
+
+SELECT object FROM (
+  (SELECT object FROM postbis_objects EXCEPT ALL SELECT object FROM upgraded_objects)
+  UNION ALL
+  (SELECT object FROM upgraded_objects EXCEPT ALL SELECT object FROM postbis_objects)
+) AS a ORDER BY object;
+
+SELECT count(*) > 0 FROM upgraded_objects;
+
+DROP TABLE upgraded_objects;
+DROP VIEW postbis_objects;
+DROP EXTENSION postbis;